@@ -30,6 +30,7 @@
 #include "../../src/filezilla/webui/templated_index_wrapper.hpp"
 
 #include "../../src/filezilla/authentication/file_based_authenticator.hpp"
+#include "../../src/filezilla/rate_limit/sharded_manager.hpp"
 
 #include "../../src/filezilla/util/filesystem.hpp"
 #include "../../src/filezilla/authentication/token_manager.hpp"
@@ -103,8 +104,11 @@ int main(int argc, char *argv[])
 
 	event_loop loop {fz::event_loop::threadless};
 	thread_pool pool;
+	rate_limit::sharded_manager rlm(loop);
 	event_loop_pool loop_pool(loop, pool, num_threads);
-	rate_limit_manager rlm(loop);
+	loop_pool.add_release_hook([&rlm](event_loop &l) {
+		rlm.release(l);
+	});
 	logger::stdio logger {stderr};
 	authentication::file_based_authenticator file_auth(pool, loop, logger, rlm);
 
@@ -147,7 +151,7 @@ int main(int argc, char *argv[])
 	tcp::server::context context(pool, loop);
 	tcp::binary_address_list disallowed_ips;
 	tcp::binary_address_list allowed_ips;
-	authentication::autobanner autobanner(loop);
+	authentication::autobanner autobanner;
 
 	auto tls = securable_socket::cert_info::generate_selfsigned({}, util::get_own_executable_directory(), logger);
 
@@ -66,7 +66,7 @@ client::challenger::internal::internal(thread_pool &pool, event_loop &loop, logg
 	: logger_(logger, "Internal challenger")
 	, how_(how)
 	, context_(pool, loop)
-	, server_(context_, logger, *this)
+	, server_(context_, logger, *this, "acme")
 {
 	server_.set_listen_address_infos(how_.addresses_info.begin(), how_.addresses_info.end());
 	server_.start();
@@ -5,21 +5,28 @@
 
 namespace fz::authentication {
 
-autobanner::autobanner(event_loop &loop, options opts)
-	: event_handler(loop)
+autobanner::autobanner(options opts)
+	: opts_(std::move(opts))
+	, ipv4_failures_(expiry_loop_, tracker_options<std::uint32_t>())
+	, ipv6_failures_(expiry_loop_, tracker_options<std::uint64_t>())
 {
-	set_options(std::move(opts));
 }
 
-autobanner::~autobanner()
+template <typename Key>
+typename failure_tracker<Key>::options autobanner::tracker_options() const
 {
-	remove_handler();
+	return typename failure_tracker<Key>::options()
+		.window(opts_.login_failures_time_window())
+		.max_entries(opts_.max_tracked_addresses());
 }
 
 void autobanner::set_options(options opts)
 {
 	scoped_lock lock(mutex_);
 	opts_ = std::move(opts);
+
+	ipv4_failures_.set_options(tracker_options<std::uint32_t>());
+	ipv6_failures_.set_options(tracker_options<std::uint64_t>());
 }
 
 void autobanner::add_event_handler(event_handler &handler)
@@ -38,30 +45,31 @@ void autobanner::remove_event_handler(event_handler &handler)
 
 bool autobanner::is_banned(std::string_view address, address_type type)
 {
-	if (opts_.max_login_failures() == 0)
-		return false;
-
-	scoped_lock lock(mutex_);
+	{
+		scoped_lock lock(mutex_);
 
-	auto impl = [this](const auto &map, auto ip) {
-		if (auto it = map.find(ip); it != map.end())
-			return it->second.failed_timepoints.size() >= opts_.max_login_failures();
+		if (opts_.max_login_failures() == 0)
+			return false;
+	}
 
-		return false;
+	auto impl = [](auto &tracker, auto ip) {
+		return tracker.with_existing(ip, [now = monotonic_clock::now()](auto *e) {
+			return e && now < e->hold_until();
+		});
 	};
 
 	if (type == address_type::ipv4) {
 		util::parseable_range r(address);
 
 		if (hostaddress::ipv4_host h; parse_ip(r, h) && eol(r))
-			return impl(ipv4_map_, h.to_uint32());
+			return impl(ipv4_failures_, h.to_uint32());
 	}
 	else
 	if (type == address_type::ipv6) {
 		util::parseable_range r(address);
 
 		if (hostaddress::ipv6_host h; parse_ip(r, h) && eol(r))
-			return impl(ipv6_map_, h.high_to_uint64());
+			return impl(ipv6_failures_, h.high_to_uint64());
 	}
 
 	return true;
@@ -69,79 +77,63 @@ bool autobanner::is_banned(std::string_view address, address_type type)
 
 bool autobanner::set_failed_login(std::string_view address, address_type type)
 {
-	if (opts_.max_login_failures() == 0)
-		return false;
+	std::size_t max_login_failures;
+	duration ban_duration;
 
-	scoped_lock lock(mutex_);
+	{
+		scoped_lock lock(mutex_);
 
-	auto add_timer = [&](auto &map, auto ip, auto &handle, duration d) {
-		handle.timer_id = this->add_timer(d, true);
-		map.emplace(std::piecewise_construct,
-			std::forward_as_tuple(handle.timer_id),
-			std::forward_as_tuple(ip)
-		);
-	};
+		max_login_failures = opts_.max_login_failures();
+		ban_duration = opts_.ban_duration();
+	}
 
-	auto impl = [&](auto &map, auto &timer_map, auto ip) {
-		auto &handle = map[ip];
+	if (max_login_failures == 0)
+		return false;
+
+	enum result { not_banned, already_banned, newly_banned };
 
-		if (handle.failed_timepoints.size() >= opts_.max_login_failures())
-			return true;
+	auto impl = [&](auto &tracker, auto ip) {
+		auto res = tracker.with(ip, [&](auto &e) {
+			auto now = monotonic_clock::now();
 
-		stop_timer(handle.timer_id);
+			if (now < e.hold_until())
+				return already_banned;
 
-		handle.failed_timepoints.push_back(monotonic_clock::now());
+			if (e.add_failure(now) < max_login_failures)
+				return not_banned;
 
-		if (handle.failed_timepoints.size() >= opts_.max_login_failures()) {
-			if (handle.failed_timepoints.back() - handle.failed_timepoints.front() <= opts_.login_failures_time_window()) {
-				add_timer(timer_map, ip, handle, opts_.ban_duration());
+			// Once the ban is over, the address starts over with a clean record.
+			e.clear_failures();
+			e.hold(now + ban_duration);
 
-				for (auto eh: handlers_)
-					eh->send_event<banned_event>(address, type);
+			return newly_banned;
+		});
 
-				return true;
-			}
+		if (res == newly_banned) {
+			scoped_lock lock(mutex_);
 
-			handle.failed_timepoints.pop_front();
+			for (auto eh: handlers_)
+				eh->send_event<banned_event>(address, type);
 		}
 
-		add_timer(timer_map, ip, handle, opts_.login_failures_time_window());
-		return false;
+		return res != not_banned;
 	};
 
-
 	if (type == address_type::ipv4) {
 		util::parseable_range r(address);
 
 		if (hostaddress::ipv4_host h; parse_ip(r, h) && eol(r))
-			return impl(ipv4_map_, ipv4_timer_map_, h.to_uint32());
+			return impl(ipv4_failures_, h.to_uint32());
 	}
 	else
 	if (type == address_type::ipv6) {
 		util::parseable_range r(address);
 
 		if (hostaddress::ipv6_host h; parse_ip(r, h) && eol(r))
-			return impl(ipv6_map_, ipv6_timer_map_, h.high_to_uint64());
+			return impl(ipv6_failures_, h.high_to_uint64());
 	}
 
 	return true;
 }
 
-void autobanner::operator()(const event_base &ev)
-{
-	fz::dispatch<timer_event>(ev, [this](timer_id id) {
-		scoped_lock lock(mutex_);
-
-		if (auto it = ipv4_timer_map_.find(id); it != ipv4_timer_map_.end()) {
-			ipv4_map_.erase(it->second);
-			ipv4_timer_map_.erase(it);
-		}
-		else
-		if (auto it = ipv6_timer_map_.find(id); it != ipv6_timer_map_.end()) {
-			ipv6_map_.erase(it->second);
-			ipv6_timer_map_.erase(it);
-		}
-	});
-}
-
 }
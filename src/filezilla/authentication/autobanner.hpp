@@ -2,18 +2,19 @@
 #define FZ_AUTHENTICATION_AUTOBANNER_HPP
 
 #include <cstdint>
-#include <unordered_map>
-#include <deque>
 #include <string_view>
+#include <vector>
 
 #include <libfilezilla/iputils.hpp>
 #include <libfilezilla/event_handler.hpp>
+#include <libfilezilla/event_loop.hpp>
 
 #include "../util/options.hpp"
+#include "failure_tracker.hpp"
 
 namespace fz::authentication {
 
-class autobanner: private event_handler
+class autobanner
 {
 public:
 	struct options: util::options<options, autobanner>
@@ -22,13 +23,15 @@ public:
 		opt<duration> login_failures_time_window = o(duration::from_milliseconds(100));
 		opt<duration> ban_duration               = o(duration::from_minutes(5));
 
+		/// Beyond this number of tracked addresses, per IP family, the least recently seen ones are forgotten.
+		opt<std::size_t> max_tracked_addresses   = o(std::size_t(1) << 20);
+
 		options() {}
 	};
 
 	using banned_event = simple_event<autobanner, std::string /*address*/, address_type /* type */>;
 
-	autobanner(event_loop &loop, options opts = {});
-	~autobanner() override;
+	autobanner(options opts = {});
 
 	void set_options(options opts);
 
@@ -43,14 +46,8 @@ private:
 	void add_event_handler(event_handler &target_handler);
 	void remove_event_handler(event_handler &target_handler);
 
-	void operator()(const event_base &ev) override;
-
-	struct handle
-	{
-		std::deque<monotonic_clock> failed_timepoints;
-		fz::timer_id timer_id{};
-	};
-
+	template <typename Key>
+	typename failure_tracker<Key>::options tracker_options() const;
 
 	fz::mutex mutex_;
 
@@ -58,10 +55,10 @@ private:
 
 	std::vector<event_handler *> handlers_{};
 
-	std::unordered_map<std::uint32_t, handle> ipv4_map_;
-	std::unordered_map<std::uint64_t, handle> ipv6_map_;
-	std::unordered_map<timer_id, std::uint32_t> ipv4_timer_map_;
-	std::unordered_map<timer_id, std::uint64_t> ipv6_timer_map_;
+	// The expiry of the tracked addresses is handled on a thread of its own.
+	event_loop expiry_loop_;
+	failure_tracker<std::uint32_t> ipv4_failures_;
+	failure_tracker<std::uint64_t> ipv6_failures_;
 };
 
 class autobanner::with_events
@@ -0,0 +1,361 @@
+#ifndef FZ_AUTHENTICATION_FAILURE_TRACKER_HPP
+#define FZ_AUTHENTICATION_FAILURE_TRACKER_HPP
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+#include <libfilezilla/event_handler.hpp>
+#include <libfilezilla/mutex.hpp>
+
+#include "../util/options.hpp"
+#include "../util/timing_wheel.hpp"
+
+namespace fz::authentication {
+
+/// \brief Keeps track of the failed logins of a possibly huge number of peers, identified by a Key.
+///
+/// Each entry counts the failures within a sliding time window by means of a fixed-size ring of counters,
+/// each of which covers 1/slots of the window: the memory taken by an entry doesn't depend on the number of failures.
+/// Besides, each entry can be put on hold until a given time, which the users of the tracker interpret as they see fit.
+///
+/// Entries are removed once they have neither failures within the window nor a pending hold. Expiry is driven by
+/// a timing wheel, which is advanced by a single timer on the given event loop: the number of entries
+/// doesn't affect the number of timers. The entries are distributed among independently locked shards,
+/// and when there are more than max_entries of them, the least recently used ones are dropped.
+template <typename Key, typename Hash = std::hash<Key>>
+class failure_tracker: private event_handler
+{
+public:
+	static constexpr std::size_t slots = 16;
+	static constexpr std::size_t shards = 16;
+
+	/// The resolution of the expiry.
+	static constexpr std::int64_t tick_ms = 100;
+
+	struct options: util::options<options, failure_tracker>
+	{
+		FZ_UTIL_OPTIONS_INIT_TEMPLATE(options, failure_tracker)
+
+		opt<duration>    window      = o(duration::from_seconds(60));
+		opt<std::size_t> max_entries = o(std::size_t(1) << 20);
+
+		options() {}
+	};
+
+	class entry
+	{
+	public:
+		/// Records a failure at time \p now.
+		/// \returns the number of failures within the window, including this one.
+		std::size_t add_failure(monotonic_clock now)
+		{
+			rotate(now);
+
+			auto &c = counters_[std::size_t(head_ % slots)];
+			if (c < std::numeric_limits<counter>::max())
+				++c;
+
+			last_failure_ = now;
+
+			return count();
+		}
+
+		/// \returns the number of failures within the window.
+		std::size_t failures(monotonic_clock now)
+		{
+			rotate(now);
+			return count();
+		}
+
+		void clear_failures()
+		{
+			counters_ = {};
+			last_failure_ = {};
+		}
+
+		/// Keeps the entry alive until \p until, even if it has no failures within the window.
+		void hold(monotonic_clock until)
+		{
+			hold_until_ = until;
+		}
+
+		const monotonic_clock &hold_until() const
+		{
+			return hold_until_;
+		}
+
+	private:
+		friend failure_tracker;
+
+		using counter = std::uint16_t;
+
+		explicit entry(const failure_tracker &owner)
+			: owner_(&owner)
+		{}
+
+		void rotate(monotonic_clock now)
+		{
+			auto s = owner_->slot_of(now);
+
+			if (s - head_ >= std::int64_t(slots))
+				counters_ = {};
+			else {
+				for (auto i = head_ + 1; i <= s; ++i)
+					counters_[std::size_t(i % slots)] = 0;
+			}
+
+			if (s > head_)
+				head_ = s;
+		}
+
+		std::size_t count() const
+		{
+			std::size_t sum = 0;
+			for (auto c: counters_)
+				sum += c;
+
+			return sum;
+		}
+
+		monotonic_clock expiry() const
+		{
+			monotonic_clock e = hold_until_;
+
+			if (last_failure_) {
+				if (auto f = last_failure_ + owner_->window_; !e || e < f)
+					e = f;
+			}
+
+			return e;
+		}
+
+		const failure_tracker *owner_;
+		std::array<counter, slots> counters_{};
+		std::int64_t head_{};
+		monotonic_clock last_failure_{};
+		monotonic_clock hold_until_{};
+		std::uint64_t scheduled_{};
+		typename std::list<Key>::iterator lru_{};
+	};
+
+	/// \param clock where the current time is taken from. Tests replace it, to control the passing of time.
+	failure_tracker(event_loop &loop, options opts = {}, std::function<monotonic_clock()> clock = &monotonic_clock::now)
+		: event_handler(loop)
+		, opts_(std::move(opts))
+		, window_(opts_.window())
+		, clock_(std::move(clock))
+		, start_(clock_())
+	{
+		add_timer(duration::from_milliseconds(tick_ms), false);
+	}
+
+	~failure_tracker() override
+	{
+		remove_handler();
+	}
+
+	/// Changing the window resets the failures counted so far, but not the holds.
+	void set_options(options opts)
+	{
+		for (auto &s: shards_)
+			s.mutex.lock();
+
+		bool reset = opts.window() != opts_.window();
+
+		opts_ = std::move(opts);
+		window_ = opts_.window();
+
+		if (reset) {
+			for (auto &s: shards_) {
+				for (auto &[_, e]: s.entries)
+					e.clear_failures();
+			}
+		}
+
+		for (auto &s: shards_)
+			s.mutex.unlock();
+	}
+
+	/// Invokes \p f(entry &) with the entry for \p key, creating it if it doesn't exist yet.
+	/// \returns whatever \p f returns.
+	template <typename F>
+	decltype(auto) with(const Key &key, F &&f)
+	{
+		auto &s = shard_of(key);
+		scoped_lock lock(s.mutex);
+
+		auto it = s.entries.find(key);
+		if (it == s.entries.end()) {
+			evict_if_full(s);
+
+			it = s.entries.emplace(key, entry(*this)).first;
+			s.lru.push_front(key);
+			it->second.lru_ = s.lru.begin();
+		}
+		else
+			s.lru.splice(s.lru.begin(), s.lru, it->second.lru_);
+
+		struct reschedule
+		{
+			~reschedule()
+			{
+				self.schedule(s, k, e);
+			}
+
+			failure_tracker &self;
+			shard &s;
+			const Key &k;
+			entry &e;
+		} r{*this, s, it->first, it->second};
+
+		return std::forward<F>(f)(it->second);
+	}
+
+	/// Invokes \p f(entry *) with the entry for \p key, or with nullptr if there's no entry for \p key.
+	/// \returns whatever \p f returns.
+	template <typename F>
+	decltype(auto) with_existing(const Key &key, F &&f)
+	{
+		auto &s = shard_of(key);
+		scoped_lock lock(s.mutex);
+
+		auto it = s.entries.find(key);
+		if (it == s.entries.end())
+			return std::forward<F>(f)(static_cast<entry *>(nullptr));
+
+		struct reschedule
+		{
+			~reschedule()
+			{
+				self.schedule(s, k, e);
+			}
+
+			failure_tracker &self;
+			shard &s;
+			const Key &k;
+			entry &e;
+		} r{*this, s, it->first, it->second};
+
+		return std::forward<F>(f)(&it->second);
+	}
+
+	/// Removes the entries whose time has come, as the timer does every tick.
+	void expire()
+	{
+		auto now = clock_();
+		auto tick = typename wheel::tick_type((now - start_).get_milliseconds() / tick_ms);
+
+		for (auto &s: shards_) {
+			scoped_lock lock(s.mutex);
+
+			s.expiry.advance(tick, [&](Key &&key, typename wheel::tick_type when) {
+				auto it = s.entries.find(key);
+
+				// Stale: the entry was dropped, or rescheduled to an earlier tick.
+				if (it == s.entries.end() || it->second.scheduled_ != when)
+					return;
+
+				auto &e = it->second;
+				e.scheduled_ = 0;
+
+				if (e.expiry() <= now) {
+					s.lru.erase(e.lru_);
+					s.entries.erase(it);
+				}
+				else
+					schedule(s, it->first, e);
+			});
+		}
+	}
+
+	std::size_t size() const
+	{
+		std::size_t ret = 0;
+
+		for (auto &s: shards_) {
+			scoped_lock lock(s.mutex);
+			ret += s.entries.size();
+		}
+
+		return ret;
+	}
+
+private:
+	using wheel = util::timing_wheel<Key>;
+
+	struct shard
+	{
+		mutable fz::mutex mutex{false};
+		std::unordered_map<Key, entry, Hash> entries;
+		std::list<Key> lru; ///< most recently used first
+		wheel expiry;
+	};
+
+	shard &shard_of(const Key &key)
+	{
+		// Mix the bits, since the hash of integral types is often the identity.
+		auto h = std::uint64_t(Hash{}(key)) * 0x9E3779B97F4A7C15ull;
+		return shards_[std::size_t(h >> 60) % shards];
+	}
+
+	std::int64_t slot_of(monotonic_clock t) const
+	{
+		auto slot_ms = std::max<std::int64_t>(window_.get_milliseconds() / std::int64_t(slots), 1);
+		return (t - start_).get_milliseconds() / slot_ms;
+	}
+
+	typename wheel::tick_type tick_of(monotonic_clock t) const
+	{
+		auto ms = (t - start_).get_milliseconds();
+
+		// Round up, an entry must not expire before its time.
+		return typename wheel::tick_type(std::max<std::int64_t>((ms + tick_ms - 1) / tick_ms, 0));
+	}
+
+	void schedule(shard &s, const Key &key, entry &e)
+	{
+		auto when = tick_of(e.expiry());
+
+		// Expiry hardly ever moves backward: when it moves forward, the entry is rescheduled once its current tick comes.
+		if (e.scheduled_ == 0 || when < e.scheduled_) {
+			e.scheduled_ = std::max(when, s.expiry.now() + 1);
+			s.expiry.schedule(key, e.scheduled_);
+		}
+	}
+
+	void evict_if_full(shard &s)
+	{
+		auto max = std::max<std::size_t>(opts_.max_entries() / shards, 1);
+
+		while (s.entries.size() >= max) {
+			s.entries.erase(s.lru.back());
+			s.lru.pop_back();
+		}
+	}
+
+	void operator()(const event_base &ev) override
+	{
+		fz::dispatch<timer_event>(ev, this, &failure_tracker::on_timer);
+	}
+
+	void on_timer(timer_id)
+	{
+		expire();
+	}
+
+	options opts_;
+	duration window_;
+	const std::function<monotonic_clock()> clock_;
+	const monotonic_clock start_;
+
+	std::array<shard, shards> shards_;
+};
+
+}
+
+#endif // FZ_AUTHENTICATION_FAILURE_TRACKER_HPP
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <optional>
 #include <unordered_set>
 
 #include <libfilezilla/util.hpp>
@@ -11,6 +12,8 @@
 #include "../impersonator/client.hpp"
 #include "../remove_event.hpp"
 #include "../logger/type.hpp"
+#include "../metrics/registry.hpp"
+#include "../util/binary_snapshot.hpp"
 
 namespace fz::authentication {
 
@@ -127,7 +130,7 @@ file_based_authenticator::worker::operation::operation(worker &w, shared_user &&
 		w.logger_.log_u(logmsg::debug_debug, L"Worker %p created new operation %p, with shared_user = %p, methods = [%s], error = %d", &w, this, shared_user_.get(), methods_, int(error_));
 }
 
-file_based_authenticator::file_based_authenticator(thread_pool &thread_pool, event_loop &event_loop, logger_interface &logger, rate_limit_manager &rlm, native_string impersonator_exe)
+file_based_authenticator::file_based_authenticator(thread_pool &thread_pool, event_loop &event_loop, logger_interface &logger, rate_limit::sharded_manager &rlm, native_string impersonator_exe)
 	: thread_pool_(thread_pool)
 	, event_loop_(event_loop)
 	, logger_(logger, "File-based Authenticator")
@@ -135,12 +138,17 @@ file_based_authenticator::file_based_authenticator(thread_pool &thread_pool, eve
 	, workers_(std::make_unique<workers>())
 	, impersonator_exe_(std::move(impersonator_exe))
 {
+	publish_users();
+	publish_temp_users();
 }
 
-file_based_authenticator::file_based_authenticator(thread_pool &thread_pool, event_loop &event_loop, logger_interface &logger, rate_limit_manager &rlm, native_string groups_path, native_string users_path, native_string impersonator_exe)
+file_based_authenticator::file_based_authenticator(thread_pool &thread_pool, event_loop &event_loop, logger_interface &logger, rate_limit::sharded_manager &rlm, native_string groups_path, native_string users_path, native_string impersonator_exe)
 	: file_based_authenticator(thread_pool, event_loop, logger, rlm, impersonator_exe)
 {
-	auto a = std::make_unique<xml_archiver>(rlm.event_loop_);
+	groups_path_ = groups_path;
+	users_path_ = users_path;
+
+	auto a = std::make_unique<xml_archiver>(event_loop);
 	a->set_values(
 		{groups_, { "", groups_path }},
 		{users_, { "", users_path }}
@@ -152,10 +160,13 @@ file_based_authenticator::file_based_authenticator(thread_pool &thread_pool, eve
 }
 
 
-file_based_authenticator::file_based_authenticator(thread_pool &thread_pool, event_loop &event_loop, logger_interface &logger, rate_limit_manager &rlm, native_string groups_path, fz::authentication::file_based_authenticator::groups &&groups, native_string users_path, fz::authentication::file_based_authenticator::users &&users, native_string impersonator_exe)
+file_based_authenticator::file_based_authenticator(thread_pool &thread_pool, event_loop &event_loop, logger_interface &logger, rate_limit::sharded_manager &rlm, native_string groups_path, fz::authentication::file_based_authenticator::groups &&groups, native_string users_path, fz::authentication::file_based_authenticator::users &&users, native_string impersonator_exe)
 	: file_based_authenticator(thread_pool, event_loop, logger, rlm, impersonator_exe)
 {
-	auto a = std::make_unique<xml_archiver>(rlm.event_loop_, fz::duration::from_milliseconds(100), &mutex_);
+	groups_path_ = groups_path;
+	users_path_ = users_path;
+
+	auto a = std::make_unique<xml_archiver>(event_loop, fz::duration::from_milliseconds(100), &mutex_);
 
 	a->set_values(
 		{groups_, { "", groups_path }},
@@ -171,13 +182,69 @@ file_based_authenticator::~file_based_authenticator()
 {
 }
 
+void file_based_authenticator::set_snapshot_path(native_string path)
+{
+	snapshot_path_ = std::move(path);
+}
+
 serialization::xml_input_archive::error_t file_based_authenticator::load_into(fz::authentication::file_based_authenticator::groups &groups, fz::authentication::file_based_authenticator::users &users)
 {
-	if (xml_archiver *a = static_cast<xml_archiver *>(xml_archiver_.get())) {
-		return a->load_into(groups, users);
+	xml_archiver *a = static_cast<xml_archiver *>(xml_archiver_.get());
+	if (!a)
+		return { EINVAL, "file_based_authenticator was constructed without paths to the users and groups files." };
+
+	metrics::stopwatch sw;
+
+	if (snapshot_path_.empty()) {
+		auto err = a->load_into(groups, users);
+		if (!err)
+			report_load_time(logger_, false, sw.elapsed_us(), groups, users);
+
+		return err;
+	}
+
+	util::binary_snapshot snapshot(snapshot_path_, {groups_path_, users_path_}, logger_);
+
+	if (snapshot.load(groups, users)) {
+		report_load_time(logger_, true, sw.elapsed_us(), groups, users);
+		return {};
+	}
+
+	// A corrupted snapshot might have left the values half-loaded.
+	groups = {};
+	users = {};
+
+	if (auto err = a->load_into(groups, users))
+		return err;
+
+	report_load_time(logger_, false, sw.elapsed_us(), groups, users);
+	snapshot.save(groups, users);
+
+	return {};
+}
+
+namespace {
+
+struct load_metrics
+{
+	metrics::histogram &from_snapshot = metrics::registry::global().get_histogram("fz_auth_users_load_duration_seconds", "Time taken to load the users and groups.", metrics::unit::microseconds, {{"source", "snapshot"}});
+	metrics::histogram &from_xml = metrics::registry::global().get_histogram("fz_auth_users_load_duration_seconds", "Time taken to load the users and groups.", metrics::unit::microseconds, {{"source", "xml"}});
+
+	static load_metrics &get()
+	{
+		static load_metrics m;
+		return m;
 	}
+};
+
+}
+
+void file_based_authenticator::report_load_time(logger_interface &logger, bool from_snapshot, std::uint64_t elapsed_us, const groups &groups, const users &users)
+{
+	auto &stats = load_metrics::get();
+	(from_snapshot ? stats.from_snapshot : stats.from_xml).record(elapsed_us);
 
-	return { EINVAL, "file_based_authenticator was constructed without paths to the users and groups files." };
+	logger.log_u(logmsg::status, L"Loaded %d users and %d groups from the %s in %d ms.", users.size(), groups.size(), from_snapshot ? L"snapshot" : L"XML files", elapsed_us / 1000);
 }
 
 bool file_based_authenticator::load()
@@ -209,6 +276,11 @@ void file_based_authenticator::set_save_result_event_handler(event_handler *hand
 	}
 }
 
+void file_based_authenticator::set_credentials_cache_options(verified_credentials_cache::options opts)
+{
+	verified_credentials_.set_options(std::move(opts));
+}
+
 void file_based_authenticator::save_later()
 {
 	if (xml_archiver_) {
@@ -306,14 +378,11 @@ void file_based_authenticator::sanitize(file_based_authenticator::groups &groups
 			return group_doesnt_exist || duplicated;
 		}), u.second.groups.end());
 
+		// Whether the methods match the credentials is checked, and logged, when the users are published.
 		if (!u.second.methods.is_auth_possible()) {
 			u.second.methods = u.second.credentials.get_most_secure_methods();
 			logger->log_u(logmsg::debug_info, L"User \"%s\" did not have any auth methods configured, defaulting to the most secure ones based on the available credentials: [%s].", u.first, u.second.methods);
 		}
-		else
-		if (!u.second.credentials.is_valid_for(u.second.methods, logger)) {
-			logger->log_u(logmsg::warning, L"User \"%s\" has auth methods [%s] that do not match the credentials. Login will not be possible.", u.first, u.second.methods);
-		}
 
 		it = ++it;
 	}
@@ -326,10 +395,80 @@ void file_based_authenticator::sanitize(file_based_authenticator::groups &groups
 	}
 }
 
+file_based_authenticator::database::database(const file_based_authenticator::groups &groups, const file_based_authenticator::users &users, std::uint64_t credentials_version, logger_interface *logger)
+	: group_entries(groups)
+	, user_entries(users)
+	, credentials_version(credentials_version)
+{
+	for (const auto &[name, u]: user_entries) {
+		auto &info = infos[name];
+
+		info.entry = &u;
+		info.methods_match_credentials = u.credentials.is_valid_for(u.methods, logger);
+
+		if (!info.methods_match_credentials && logger)
+			logger->log_u(logmsg::warning, L"User \"%s\" has auth methods [%s] that do not match the credentials. Login will not be possible.", name, u.methods);
+
+		auto add_filters = [&info](const auth_entry &e) {
+			if (e.disallowed_ips.size() > 0)
+				info.disallowed_ips.push_back(&e.disallowed_ips);
+
+			if (e.allowed_ips.size() > 0)
+				info.allowed_ips.push_back(&e.allowed_ips);
+		};
+
+		add_filters(u);
+
+		for (const auto &n: u.groups) {
+			if (auto git = group_entries.find(n); git != group_entries.end())
+				add_filters(git->second);
+		}
+	}
+}
+
+const file_based_authenticator::database::user_info *file_based_authenticator::database::find(const std::string &name) const
+{
+	if (auto it = infos.find(name); it != infos.end())
+		return &it->second;
+
+	return nullptr;
+}
+
+void file_based_authenticator::publish_users()
+{
+	std::atomic_store(&database_, std::shared_ptr<const database>(std::make_shared<database>(groups_, users_, credentials_version_, &logger_)));
+}
+
+void file_based_authenticator::publish_temp_users()
+{
+	std::atomic_store(&temp_database_, std::shared_ptr<const database>(std::make_shared<database>(groups_, temp_users_, credentials_version_, &logger_)));
+}
+
+void file_based_authenticator::convert_old_style_password(const std::string &name, std::string_view password)
+{
+	// Only the copy that gets saved is converted: the published one keeps verifying the old style password just as well,
+	// and republishing all the users for each of them logging in would be way too expensive.
+	if (auto it = users_.find(name); it != users_.end()) {
+		if (auto pwd = it->second.credentials.password.get(); pwd && !pwd->is<default_password>()) {
+			logger_.log_u(logmsg::status, L"User '%s' has old style password, converting it into the new style one.", name);
+			*pwd = default_password(password);
+			save_later();
+		}
+	}
+}
+
 void file_based_authenticator::update()
 {
 	sanitize(groups_, users_, &logger_);
 
+	// Credentials might have changed: whatever was verified with the previous ones mustn't be trusted anymore.
+	++credentials_version_;
+	verified_credentials_.clear();
+
+	// The temporary users can belong to the groups too.
+	publish_users();
+	publish_temp_users();
+
 	for (auto l_it = group_limiters_.begin(); l_it != group_limiters_.end();) {
 		if (auto g_it = groups_.find(l_it->first); g_it == groups_.end()) {
 			l_it = group_limiters_.erase(l_it);
@@ -454,6 +593,7 @@ std::pair<std::string, std::string> file_based_authenticator::make_temp_user(tvf
 		name = hex_encode<std::string>(random_bytes(16));
 
 		if (users_.count(name) == 0 && temp_users_.try_emplace(name, std::move(ue)).second) {
+			publish_temp_users();
 			logger_.log_u(logmsg::status, L"Successfully created temporary user '%s'.", name);
 			return {std::move(name), std::move(password)};
 		}
@@ -468,6 +608,7 @@ bool file_based_authenticator::remove_temp_user(const std::string &name)
 	scoped_lock lock(mutex_);
 
 	if (temp_users_.erase(name)) {
+		publish_temp_users();
 		logger_.log_u(logmsg::status, L"Succefully removed temporary user '%s'.", name);
 		return true;
 	}
@@ -478,12 +619,17 @@ bool file_based_authenticator::remove_temp_user(const std::string &name)
 
 void file_based_authenticator::authenticate(std::string_view name, const methods_list &methods, address_type family, std::string_view ip, event_handler &target, logger::modularized::meta_map meta_for_logging)
 {
-	scoped_lock lock(mutex_);
+	worker *w{};
 
-	auto &worker = workers_->emplace_front(*this, name, family, ip, &target, std::move(meta_for_logging));
-	worker.self_in_workers_ = workers_->begin();
+	{
+		scoped_lock lock(mutex_);
+
+		w = &workers_->emplace_front(*this, name, family, ip, &target, std::move(meta_for_logging));
+		w->self_in_workers_ = workers_->begin();
+	}
 
-	worker.authenticate(methods, {});
+	// The worker can only go away through stop_ongoing_authentications() or operation::stop(), which are invoked on behalf of the target itself.
+	w->authenticate(methods, {});
 }
 
 void file_based_authenticator::stop_ongoing_authentications(event_handler &target)
@@ -510,13 +656,18 @@ void file_based_authenticator::update_shared_user(user &user, const user_entry &
 	}, logger);
 
 	if (!user.limiter)
-		user.limiter = std::make_shared<rate_limiter>(&rlm_);
+		user.limiter = std::make_shared<rate_limit::shared_limiter>(rlm_);
 
 	user.limiter->set_limits(entry.rate_limits.inbound, entry.rate_limits.outbound);
 
 	user.session_inbound_limit = entry.rate_limits.session_inbound;
 	user.session_outbound_limit = entry.rate_limits.session_outbound;
 
+	user.bandwidth_weight = entry.rate_limits.weight;
+	user.bandwidth_group.clear();
+	user.bandwidth_group_weight = 1;
+	user.bandwidth_group_limiter.reset();
+
 	user.session_open_limits.files = entry.session_open_limits.files;
 	user.session_open_limits.directories = entry.session_open_limits.directories;
 
@@ -545,6 +696,11 @@ void file_based_authenticator::update_shared_user(user &user, const user_entry &
 			user.extra_limiters.push_back(gl.shared_rate_limiter);
 			user.extra_session_count_limiters.push_back(gl.session_count_limiter);
 
+			// Groups are visited last to first, so that the bandwidth is eventually shared within the first group the user belongs to.
+			user.bandwidth_group = g->first;
+			user.bandwidth_group_weight = g->second.rate_limits.weight;
+			user.bandwidth_group_limiter = gl.shared_rate_limiter;
+
 			update_limit(g->second.rate_limits.session_inbound, user.session_inbound_limit, rate::unlimited);
 			update_limit(g->second.rate_limits.session_outbound, user.session_outbound_limit, rate::unlimited);
 
@@ -607,7 +763,7 @@ file_based_authenticator::group_limiters &file_based_authenticator::get_or_make_
 		bool inserted;
 
 		std::tie(it, inserted) = group_limiters_.insert({g.first, {
-			std::make_shared<rate_limiter>(&rlm_),
+			std::make_shared<rate_limit::shared_limiter>(rlm_),
 			std::make_shared<util::limited_copies_counter>(fz::sprintf("group «%s»", g.first))
 		}});
 
@@ -654,6 +810,11 @@ file_based_authenticator::users::impersonator::native *file_based_authenticator:
 	return std::get_if<impersonator::native>(this);
 }
 
+const file_based_authenticator::users::impersonator::native *file_based_authenticator::users::impersonator::any::native() const
+{
+	return std::get_if<impersonator::native>(this);
+}
+
 impersonation_token file_based_authenticator::users::impersonator::any::get_token() const
 {
 	return std::visit([](const auto &i) { return i.get_token(); }, static_cast<const variant &>(*this));
@@ -663,157 +824,206 @@ impersonation_token file_based_authenticator::users::impersonator::any::get_toke
 /******************************************************************/
 
 
-void file_based_authenticator::worker::authenticate(const methods_list &methods, available_methods &&available_methods)
+namespace {
+
+struct auth_metrics
 {
-	error error{};
+	metrics::histogram &queue_wait = metrics::registry::global().get_histogram("fz_auth_queue_wait_seconds", "Time the authentications waited for the users database to become available.", metrics::unit::microseconds);
+	metrics::histogram &verify_duration = metrics::registry::global().get_histogram("fz_auth_verify_duration_seconds", "Time taken to verify the credentials.", metrics::unit::microseconds);
+	metrics::counter &cache_hits = metrics::registry::global().get_counter("fz_auth_verified_credentials_cache_hits_total", "Verifications skipped because the credentials had been recently verified.");
+
+	static auth_metrics &get()
+	{
+		static auth_metrics m;
+		return m;
+	}
+};
 
-	scoped_lock lock(owner_.mutex_);
+}
+
+void file_based_authenticator::worker::authenticate(const methods_list &methods, available_methods &&available_methods)
+{
+	auto &stats = auth_metrics::get();
 
 	if (logger_.should_log(logmsg::debug_debug))
 		logger_.log_u(logmsg::debug_debug, "Invoked authenticate(%s) on worker %p, with available methods = [%s]", methods, this, available_methods);
 
-	user_entry *u{};
-	bool is_from_system{};
-	shared_user shared_user;
+	const auto initial_available_methods = available_methods;
 
-	if (auto it = owner_.users_.find(name_); it != owner_.users_.end()) {
-		u = &it->second;
-	}
-	else
-	if (it = owner_.temp_users_.find(name_); it != owner_.temp_users_.end()) {
-		u = &it->second;
-	}
-	else
-	if (it = owner_.users_.find(owner_.users_.system_user_name); it != owner_.users_.end())  {
-		if (it->second.enabled) {
-			u = &it->second;
-			is_from_system = true;
-		}
-	}
+	// The users and groups are looked up, and the credentials verified, on the published databases, without taking any lock.
+	// Nothing is changed until the mutex is taken at the end: if the databases have been replaced by then, the authentication starts over.
+	for (;;) {
+		auto db = std::atomic_load(&owner_.database_);
+		auto temp_db = std::atomic_load(&owner_.temp_database_);
 
-	if (!u)
-		error = error::user_nonexisting;
+		error error{};
+		bool is_from_system{};
+		bool complete{};
+		std::optional<impersonation_token> verified_impersonation_token;
+		std::string old_style_password;
 
-	if (!error && !u->enabled)
-		error = error::user_disabled;
+		const database::user_info *info = db->find(name_);
 
-	if (!error && !u->credentials.is_valid_for(u->methods, &logger_)) {
-		logger_.log_u(logmsg::error, L"User \"%s\" has auth methods [%s] that do not match the credentials. Login is not possible. This is an internal error, inform the administrator.", name_, u->methods);
-		error = error::internal;
-	}
+		if (!info)
+			info = temp_db->find(name_);
 
-	if (!error) {
-		// Check whether user's ip is disallowed
-		if (u->disallowed_ips.contains(ip_, family_))
-			error = error::ip_disallowed;
+		if (!info) {
+			if (info = db->find(users::system_user_name); info && info->entry->enabled)
+				is_from_system = true;
+			else
+				info = nullptr;
+		}
 
-		if (!error) {
-			for (const auto &n: u->groups) {
-				if (const auto git = owner_.groups_.find(n); git != owner_.groups_.end()) {
-					const auto &g = git->second;
+		const user_entry *u = info ? info->entry : nullptr;
 
-					if (g.disallowed_ips.contains(ip_, family_)) {
-						error = error::ip_disallowed;
-						break;
-					}
-				}
-			}
+		if (!u)
+			error = error::user_nonexisting;
+
+		if (!error && !u->enabled)
+			error = error::user_disabled;
+
+		if (!error && !info->methods_match_credentials) {
+			logger_.log_u(logmsg::error, L"User \"%s\" has auth methods [%s] that do not match the credentials. Login is not possible. This is an internal error, inform the administrator.", name_, u->methods);
+			error = error::internal;
 		}
 
-		// If it is, check whether there are exceptions
-		if (error) {
-			if (u->allowed_ips.contains(ip_, family_))
-				error = error::none;
+		if (!error) {
+			auto contains_ip = [&](const std::vector<const tcp::binary_address_list *> &lists) {
+				return std::any_of(lists.begin(), lists.end(), [&](const tcp::binary_address_list *l) {
+					return l->contains(ip_, family_);
+				});
+			};
 
-			if (error) {
-				for (const auto &n: u->groups) {
-					if (const auto git = owner_.groups_.find(n); git != owner_.groups_.end()) {
-						const auto &g = git->second;
+			// Check whether user's ip is disallowed, and if it is, whether there are exceptions
+			if (contains_ip(info->disallowed_ips) && !contains_ip(info->allowed_ips))
+				error = error::ip_disallowed;
+		}
 
-						if (g.allowed_ips.contains(ip_, family_)) {
-							error = error::none;
-							break;
-						}
-					}
-				}
-			}
+		if (!error && !available_methods.is_auth_possible()) {
+			available_methods = u->methods;
 		}
-	}
 
-	if (!error && !available_methods.is_auth_possible()) {
-		available_methods = u->methods;
-	}
+		if (!error && !methods.empty()) {
+			if (logger_.should_log(logmsg::debug_verbose))
+				logger_.log_u(logmsg::debug_verbose, "Authenticating user '%s'. Methods requested: %s. Available methods: [%s].", name_, methods, available_methods);
 
-	if (!error && !methods.empty()) {
-		if (logger_.should_log(logmsg::debug_verbose))
-			logger_.log_u(logmsg::debug_verbose, "Authenticating user '%s'. Methods requested: %s. Available methods: [%s].", name_, methods, available_methods);
+			if (!available_methods.can_verify(methods))
+				error = error::auth_method_not_supported;
 
-		if (!available_methods.can_verify(methods))
-			error = error::auth_method_not_supported;
+			if (error)
+				logger_.log_u(logmsg::debug_verbose, "Authenticating user '%s' is not possible, no matching authentication methods are available.", name_);
 
-		if (error)
-			logger_.log_u(logmsg::debug_verbose, "Authenticating user '%s' is not possible, no matching authentication methods are available.", name_);
+			if (!error && available_methods.is_auth_necessary()) {
+				impersonation_token impersonation_token;
 
-		if (!error && available_methods.is_auth_necessary()) {
-			impersonation_token impersonation_token;
+				// Users verified by the system must keep being verified by it, since they need an impersonation token anyway.
+				bool can_use_cache = !is_from_system && u->credentials.password.get();
 
-			for (auto &method: methods) {
-				if (!u->credentials.verify(name_, method, impersonation_token, logger_)) {
-					error = error::invalid_credentials;
+				auto verify = [&](const any_method &method) {
+					auto m = method.is<method::password>();
 
-					if (logger_.should_log(logmsg::debug_verbose)) {
-						logger_.log_u(logmsg::debug_verbose, "Auth method %s NOT passed for user '%s'. Invalid credentials.", method, name_);
+					if (can_use_cache && m && owner_.verified_credentials_.contains(name_, m->data, db->credentials_version)) {
+						if (logger_.should_log(logmsg::debug_verbose))
+							logger_.log_u(logmsg::debug_verbose, "Credentials of user '%s' were recently verified, skipping the verification.", name_);
+
+						stats.cache_hits.add();
+						return true;
 					}
 
-					break;
-				}
+					metrics::stopwatch verify_time;
+					bool verified = u->credentials.verify(name_, method, impersonation_token, logger_);
+					stats.verify_duration.record(verify_time);
 
-				if (logger_.should_log(logmsg::debug_verbose)) {
-					logger_.log_u(logmsg::debug_verbose, "Auth method %s passed for user '%s'.", method, name_);
-				}
+					if (!verified)
+						return false;
+
+					if (can_use_cache && m)
+						owner_.verified_credentials_.insert(name_, m->data, db->credentials_version);
+
+					return true;
+				};
+
+				for (auto &method: methods) {
+					if (!verify(method)) {
+						error = error::invalid_credentials;
+
+						if (logger_.should_log(logmsg::debug_verbose)) {
+							logger_.log_u(logmsg::debug_verbose, "Auth method %s NOT passed for user '%s'. Invalid credentials.", method, name_);
+						}
+
+						break;
+					}
 
-				if (auto m = method.is<method::password>()) {
 					if (logger_.should_log(logmsg::debug_verbose)) {
-						logger_.log_u(logmsg::debug_verbose, L"impersonation_token: { username: \"%s\", home: \"%s\" }", impersonation_token.username(), impersonation_token.home());
+						logger_.log_u(logmsg::debug_verbose, "Auth method %s passed for user '%s'.", method, name_);
 					}
 
-					if (auto impersonation = u->credentials.password.get_impersonation(); impersonation && impersonation_token) {
-						if (impersonation->login_only)
-							impersonation_token = {};
+					if (auto m = method.is<method::password>()) {
+						if (logger_.should_log(logmsg::debug_verbose)) {
+							logger_.log_u(logmsg::debug_verbose, L"impersonation_token: { username: \"%s\", home: \"%s\" }", impersonation_token.username(), impersonation_token.home());
+						}
+
+						if (auto impersonation = u->credentials.password.get_impersonation(); impersonation && impersonation_token) {
+							if (impersonation->login_only)
+								impersonation_token = {};
 
-						impersonation_token_ = std::move(impersonation_token);
+							verified_impersonation_token = std::move(impersonation_token);
+						}
+						else
+						if (auto pwd = u->credentials.password.get(); pwd && !pwd->is<default_password>()) {
+							old_style_password = m->data;
+						}
 					}
-					else
-					if (auto pwd = u->credentials.password.get(); pwd && !pwd->is<default_password>()) {
-						logger_.log_u(logmsg::status, L"User '%s' has old style password, converting it into the new style one.", name_);
-						*pwd = default_password(m->data);
-						owner_.save_later();
+				}
+
+				// Only erase the methods from the list of available methods if all of the methods have been validated.
+				if (!error && !methods.just_verify()) {
+					for (auto &method: methods) {
+						available_methods.set_verified(method);
 					}
 				}
 			}
+		}
 
-			// Only erase the methods from the list of available methods if all of the methods have been validated.
-			if (!error && !methods.just_verify()) {
-				for (auto &method: methods) {
-					available_methods.set_verified(method);
+		if (!error) {
+			if ((methods.empty() && available_methods.is_auth_possible()) || available_methods.is_auth_necessary()) {
+				if (logger_.should_log(logmsg::debug_debug))
+					logger_.log_u(logmsg::debug_debug, "Authentication for user '%s' not complete. Remaning methods: [%s]", name_, available_methods);
+			}
+			else {
+				if (!methods.empty()) {
+					if (logger_.should_log(logmsg::debug_verbose))
+						logger_.log_u(logmsg::debug_verbose, "Authentication for user '%s' is complete.", name_);
+
+					complete = true;
 				}
 			}
 		}
-	}
 
-	if (!error) {
-		if ((methods.empty() && available_methods.is_auth_possible()) || available_methods.is_auth_necessary()) {
-			if (logger_.should_log(logmsg::debug_debug))
-				logger_.log_u(logmsg::debug_debug, "Authentication for user '%s' not complete. Remaning methods: [%s]", name_, available_methods);
-		}
-		else {
-			if (!methods.empty()) {
-				if (logger_.should_log(logmsg::debug_verbose))
-					logger_.log_u(logmsg::debug_verbose, "Authentication for user '%s' is complete.", name_);
+		shared_user shared_user;
 
+		{
+			metrics::stopwatch wait;
+			scoped_lock lock(owner_.mutex_);
+			stats.queue_wait.record(wait);
+
+			if (db != owner_.database_ || temp_db != owner_.temp_database_) {
+				logger_.log_u(logmsg::debug_debug, "The users have changed while authenticating user '%s'. Starting over.", name_);
+
+				available_methods = initial_available_methods;
+				continue;
+			}
+
+			if (verified_impersonation_token)
+				impersonation_token_ = std::move(*verified_impersonation_token);
+
+			if (!old_style_password.empty())
+				owner_.convert_old_style_password(name_, old_style_password);
+
+			if (complete) {
 				// Maybe use the default impersonator
 				if (!impersonation_token_) {
-					if (auto imp = owner_.users_.default_impersonator.native(); imp && imp->enabled) {
+					if (auto imp = db->user_entries.default_impersonator.native(); imp && imp->enabled) {
 						logger_.log_u(logmsg::debug_verbose, "User '%s' has no filesystem impersonator of its own but a default one for system user '%s' has been defined.", name_, imp->name);
 
 						impersonation_token_ = imp->get_token();
@@ -837,32 +1047,34 @@ void file_based_authenticator::worker::authenticate(const methods_list &methods,
 					}
 				}
 			}
-		}
-	}
 
-	if (shared_user) {
-		if (auto u = shared_user->lock()) {
-			logger_.log_u(logmsg::debug_verbose, L"impersonation_token: { username: \"%s\", home: \"%s\" }", u->get_impersonation_token().username(), u->get_impersonation_token().home());
+			if (shared_user) {
+				if (auto u = shared_user->lock()) {
+					logger_.log_u(logmsg::debug_verbose, L"impersonation_token: { username: \"%s\", home: \"%s\" }", u->get_impersonation_token().username(), u->get_impersonation_token().home());
 
-			auto op = std::make_unique<operation>(*this, std::move(shared_user), std::move(available_methods), error);
+					auto op = std::make_unique<operation>(*this, std::move(shared_user), std::move(available_methods), error);
 
-			// Clients of the authenticator MUST invoke stop_ongoing_authentications() when the handler for the authentication is about to be killed.
-			// When that happens, the handler for the next async op will be deleted too, which in turn will avoid dispatching the completion event.
-			// Hence, it's safe to use target.event_loop_, because the async handler will live less than the target handler, which will live less than its loop.
-			return tvfs::async_autocreate_directories(u->mount_tree, u->impersonator, async_receive(owner_.async_handlers_.try_emplace(target_, target_->event_loop_).first->second)
-			>> [t = target_, o = &owner_, op = std::move(op)]() mutable {
-				t->send_event<operation::result_event>(*o, std::move(op));
-			});
-		}
-		else {
-			logger_.log_u(logmsg::error, L"Authentication succeeded but the shared_user couldn't be locked. This is an internal error, inform the administrator.");
-			shared_user.reset();
-			error = error::internal;
+					// Clients of the authenticator MUST invoke stop_ongoing_authentications() when the handler for the authentication is about to be killed.
+					// When that happens, the handler for the next async op will be deleted too, which in turn will avoid dispatching the completion event.
+					// Hence, it's safe to use target.event_loop_, because the async handler will live less than the target handler, which will live less than its loop.
+					return tvfs::async_autocreate_directories(u->mount_tree, u->impersonator, async_receive(owner_.async_handlers_.try_emplace(target_, target_->event_loop_).first->second)
+					>> [t = target_, o = &owner_, op = std::move(op)]() mutable {
+						t->send_event<operation::result_event>(*o, std::move(op));
+					});
+				}
+				else {
+					logger_.log_u(logmsg::error, L"Authentication succeeded but the shared_user couldn't be locked. This is an internal error, inform the administrator.");
+					shared_user.reset();
+					error = error::internal;
+				}
+			}
 		}
-	}
 
-	auto op = std::make_unique<operation>(*this, std::move(shared_user), std::move(available_methods), error);
-	target_->send_event<operation::result_event>(owner_, std::move(op));
+		auto op = std::make_unique<operation>(*this, std::move(shared_user), std::move(available_methods), error);
+		target_->send_event<operation::result_event>(owner_, std::move(op));
+
+		return;
+	}
 }
 
 }
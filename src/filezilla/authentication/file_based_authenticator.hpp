@@ -20,6 +20,7 @@
 #include "../util/copies_counter.hpp"
 
 #include "credentials.hpp"
+#include "verified_credentials_cache.hpp"
 
 #include "../tcp/binary_address_list.hpp"
 
@@ -33,6 +34,7 @@ public:
 		rate::type outbound{rate::unlimited};
 		rate::type session_inbound{rate::unlimited};
 		rate::type session_outbound{rate::unlimited};
+		std::uint32_t weight{1};
 
 		struct rate_type {
 			rate::type &value;
@@ -45,7 +47,8 @@ public:
 			ar.optional_attribute(rate_type{inbound}, "inbound")
 			  .optional_attribute(rate_type{outbound}, "outbound")
 			  .optional_attribute(rate_type{session_inbound}, "session_inbound")
-			  .optional_attribute(rate_type{session_outbound}, "session_outbound");
+			  .optional_attribute(rate_type{session_outbound}, "session_outbound")
+			  .optional_attribute(weight, "weight");
 		}
 	};
 
@@ -176,6 +179,7 @@ public:
 				impersonator::msw *msw();
 				impersonator::nix *nix();
 				impersonator::native *native();
+				const impersonator::native *native() const;
 
 				impersonation_token get_token() const;
 			};
@@ -193,9 +197,9 @@ public:
 		}
 	};
 
-	file_based_authenticator(thread_pool &thread_pool, event_loop &event_loop, logger_interface &logger, rate_limit_manager &rlm, native_string impersonator_exe = {});
-	file_based_authenticator(thread_pool &thread_pool, event_loop &event_loop, logger_interface &logger, rate_limit_manager &rlm, native_string groups_path, native_string users_path, native_string impersonator_exe = {});
-	file_based_authenticator(thread_pool &thread_pool, event_loop &event_loop, logger_interface &logger, rate_limit_manager &rlm, native_string groups_path, groups &&groups, native_string users_path, users &&users, native_string impersonator_exe = {});
+	file_based_authenticator(thread_pool &thread_pool, event_loop &event_loop, logger_interface &logger, rate_limit::sharded_manager &rlm, native_string impersonator_exe = {});
+	file_based_authenticator(thread_pool &thread_pool, event_loop &event_loop, logger_interface &logger, rate_limit::sharded_manager &rlm, native_string groups_path, native_string users_path, native_string impersonator_exe = {});
+	file_based_authenticator(thread_pool &thread_pool, event_loop &event_loop, logger_interface &logger, rate_limit::sharded_manager &rlm, native_string groups_path, groups &&groups, native_string users_path, users &&users, native_string impersonator_exe = {});
 	~file_based_authenticator() override;
 
 	void set_groups_and_users(groups &&groups, users &&users);
@@ -214,8 +218,19 @@ public:
 
 	void set_save_result_event_handler(fz::event_handler *handler);
 
+	/// Successful password verifications can be remembered for a short while, so that clients
+	/// logging in repeatedly with the same credentials don't pay for a full key derivation each time.
+	void set_credentials_cache_options(verified_credentials_cache::options opts);
+
+	/// If set, the users and groups are loaded from the binary snapshot at \p path whenever it matches the XML files,
+	/// and the snapshot is refreshed each time the XML files have to be parsed instead.
+	void set_snapshot_path(native_string path);
+
 	serialization::xml_input_archive::error_t load_into(fz::authentication::file_based_authenticator::groups &groups, fz::authentication::file_based_authenticator::users &users);
 
+	/// Logs how long loading the users and groups took, and where they were loaded from, and records it in the metrics.
+	static void report_load_time(logger_interface &logger, bool from_snapshot, std::uint64_t elapsed_us, const groups &groups, const users &users);
+
 	static bool save(const native_string &groups_path, const groups &groups, const native_string &users_path, const users &users);
 
 	void authenticate(std::string_view name, const methods_list &methods, address_type family, std::string_view ip, event_handler &target, logger::modularized::meta_map meta_for_logging = {}) override;
@@ -223,10 +238,41 @@ public:
 
 private:
 	struct group_limiters {
-		std::shared_ptr<rate_limiter> shared_rate_limiter;
+		std::shared_ptr<rate_limit::shared_limiter> shared_rate_limiter;
 		std::shared_ptr<util::limited_copies_counter> session_count_limiter;
 	};
 
+	/// \brief An immutable copy of the users and groups, which the authentications read without taking any lock.
+	///
+	/// Whenever the users or groups change, a new one is made and atomically swapped with the current one:
+	/// authentications still in progress keep using the one they started with.
+	struct database
+	{
+		/// What an authentication needs to know about a user, worked out in advance.
+		struct user_info
+		{
+			const user_entry *entry{};
+			bool methods_match_credentials{};
+
+			// The IP filters of the user, followed by the ones of their groups. Empty filters are left out.
+			std::vector<const tcp::binary_address_list *> disallowed_ips{};
+			std::vector<const tcp::binary_address_list *> allowed_ips{};
+		};
+
+		/// The users whose methods don't match their credentials are logged to \p logger, together with the reason, if it's given.
+		database(const file_based_authenticator::groups &groups, const file_based_authenticator::users &users, std::uint64_t credentials_version, logger_interface *logger = nullptr);
+
+		database(const database &) = delete;
+		database &operator=(const database &) = delete;
+
+		const user_info *find(const std::string &name) const;
+
+		file_based_authenticator::groups group_entries;
+		file_based_authenticator::users user_entries;
+		users_map<user_info> infos;
+		std::uint64_t credentials_version{};
+	};
+
 	static void sanitize(groups &groups, users &users, logger_interface *logger = nullptr);
 
 	void update_shared_user(authentication::user &user, const user_entry &entry);
@@ -235,28 +281,42 @@ private:
 	group_limiters &get_or_make_group_limiters(const groups::value_type &g);
 	void save_later();
 	void update();
+	void publish_users();
+	void publish_temp_users();
+	void convert_old_style_password(const std::string &name, std::string_view password);
 
 	mutable fz::mutex mutex_{true};
 
 	thread_pool &thread_pool_;
 	event_loop &event_loop_;
 	logger::modularized logger_;
-	rate_limit_manager &rlm_;
+	rate_limit::sharded_manager &rlm_;
 	std::unordered_map<event_handler *, async_handler> async_handlers_;
 
 	class worker;
 	using workers = std::list<worker>;
 	std::unique_ptr<workers> workers_{};
 
+	// Only ever changed with the mutex held. The authentications read the published databases instead.
 	groups groups_{};
 	users users_{};
 	users temp_users_{};
 
+	std::shared_ptr<const database> database_;
+	std::shared_ptr<const database> temp_database_;
+
 	std::unordered_map<std::string, group_limiters> group_limiters_;
 	users_map<weak_user> weak_users_map_;
 
+	verified_credentials_cache verified_credentials_;
+	std::uint64_t credentials_version_{};
+
 	native_string impersonator_exe_;
 
+	native_string groups_path_;
+	native_string users_path_;
+	native_string snapshot_path_;
+
 	std::unique_ptr<util::xml_archiver_base> xml_archiver_;
 };
 
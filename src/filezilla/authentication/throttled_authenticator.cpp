@@ -3,6 +3,7 @@
 #include "throttled_authenticator.hpp"
 #include "../remove_event.hpp"
 #include "../hostaddress.hpp"
+#include "../event_loop_monitor.hpp"
 
 namespace fz::authentication {
 
@@ -143,57 +144,19 @@ throttled_authenticator::worker::operation::operation(worker &w, std::unique_ptr
 }
 
 
-bool throttled_authenticator::failures_t::add(duration delay, duration cap, std::size_t max_failures, duration failures_window)
+template <typename Key>
+void throttled_authenticator::set_next_try(typename failure_tracker<Key>::entry &e, monotonic_clock now, std::size_t failures, const options &opts)
 {
-	auto now = monotonic_clock::now();
-
-	if (max_failures > 0) {
-		purge_old(now, failures_window);
-
-		if (timepoints_.size() < max_failures)
-			timepoints_.push_back(now);
-		else
-			timepoints_.back() = now;
-	}
-
-	return set_next_try(now, delay, cap, max_failures);
-}
-
-bool throttled_authenticator::failures_t::purge_old(monotonic_clock now, duration failures_window)
-{
-	if (timepoints_.size()) {
-		auto oldest_useful_timepoint = (monotonic_clock(now) -= failures_window);
-
-		do {
-			if (oldest_useful_timepoint < timepoints_.front())
-				break;
-
-			timepoints_.pop_front();
-		} while (timepoints_.size());
-	}
-
-	return timepoints_.empty();
-}
-
-const monotonic_clock &throttled_authenticator::failures_t::next_try() const
-{
-	return next_try_;
-}
-
-bool throttled_authenticator::failures_t::set_next_try(monotonic_clock now, duration delay, duration cap, std::size_t max_failures)
-{
-	auto must_be_delayed = timepoints_.size() >= max_failures;
-
-	if (must_be_delayed)
-		next_try_ = std::min(std::max(next_try_, now) + delay, now + cap);
+	if (failures >= opts.max_failures())
+		e.hold(std::min(std::max(e.hold_until(), now) + opts.delay(), now + opts.cap()));
 	else
-		next_try_ = now;
-
-	return must_be_delayed;
+		e.hold(now);
 }
 
 void throttled_authenticator::worker::operator()(const event_base &ev)
 {
+	event_loop_monitor::dispatch_scope monitored(*this, ev);
+
 	dispatch<
 		operation::result_event
 	>(ev, this,
@@ -246,14 +209,19 @@ bool throttled_authenticator::worker::try_to_authenticate(const methods_list &me
 	auto now = monotonic_clock::now();
 	auto next_try = now;
 
-	auto update_next_try = [&next_try, &now, this](auto &map, const auto &key) {
-		if (auto it = map.find(key); it != map.end()) {
-			if (next_try < it->second.next_try())
-				next_try = it->second.next_try();
+	auto update_next_try = [&next_try, &now, this](auto &tracker, const auto &key) {
+		using key_type = std::decay_t<decltype(key)>;
 
-			if (now < it->second.next_try())
-				it->second.set_next_try(now, owner_.opts_.delay(), owner_.opts_.cap(), owner_.opts_.max_failures());
-		}
+		tracker.with_existing(key, [&](auto *e) {
+			if (!e)
+				return;
+
+			if (next_try < e->hold_until())
+				next_try = e->hold_until();
+
+			if (now < e->hold_until())
+				set_next_try<key_type>(*e, now, e->failures(now), owner_.opts_);
+		});
 	};
 
 	if (family_ == address_type::ipv4) {
@@ -270,7 +238,7 @@ bool throttled_authenticator::worker::try_to_authenticate(const methods_list &me
 			update_next_try(owner_.ipv6_failures_, h.high_to_uint64());
 	}
 
-	update_next_try(owner_.users_failures_, name_);
+	update_next_try(owner_.users_failures_, user_key(name_));
 
 	if (next_try == now)
 		return authenticate();
@@ -304,17 +272,25 @@ void throttled_authenticator::worker::record_failure()
 {
 	logger_.log_u(logmsg::debug_info, L"Recording failed login for user %s from IP %s.", name_, ip_);
 
-	auto add_failure = [&](auto &map, const auto &key) -> duration {
-		auto &f = map[key];
-		bool must_be_delayed = f.add(owner_.opts_.delay(), owner_.opts_.cap(), owner_.opts_.max_failures(), owner_.opts_.failures_window());
+	auto add_failure = [&](auto &tracker, const auto &key) -> duration {
+		using key_type = std::decay_t<decltype(key)>;
+
+		return tracker.with(key, [&](auto &e) -> duration {
+			auto now = monotonic_clock::now();
+			auto &opts = owner_.opts_;
 
-		if (must_be_delayed)
-			return f.next_try() - monotonic_clock::now();
+			// With max_failures == 0, every login is delayed.
+			auto failures = opts.max_failures() > 0 ? e.add_failure(now) : 0;
+			set_next_try<key_type>(e, now, failures, opts);
 
-		return {};
+			if (failures >= opts.max_failures())
+				return e.hold_until() - now;
+
+			return {};
+		});
 	};
 
-	if (auto delta = add_failure(owner_.users_failures_, name_))
+	if (auto delta = add_failure(owner_.users_failures_, user_key(name_)))
 		logger_.log_u(logmsg::debug_warning, L"User %s has failed login too many times (>= %d) within a %ds time window. Next login will be delayed %ds from now.",
 							 name_, owner_.opts_.max_failures(), owner_.opts_.failures_window().get_seconds(), delta.get_seconds());
 
@@ -340,17 +316,17 @@ void throttled_authenticator::worker::record_failure()
 	else {
 		logger_.log_u(logmsg::error, L"Internal error: wrong IP family type %d.", family_);
 	}
-
-	if (owner_.purging_timer_id_ == 0)
-		owner_.purging_timer_id_ = owner_.add_timer(owner_.opts_.failures_window(), true);
 }
 
 throttled_authenticator::throttled_authenticator(fz::event_loop &loop, fz::authentication::authenticator &wrapped, logger_interface &logger, options opts)
 	: event_handler(loop)
 	, wrapped_(wrapped)
 	, logger_(logger, "Throttled Authenticator")
+	, opts_(std::move(opts))
+	, ipv4_failures_(expiry_loop_, tracker_options<std::uint32_t>())
+	, ipv6_failures_(expiry_loop_, tracker_options<std::uint64_t>())
+	, users_failures_(expiry_loop_, tracker_options<std::string>())
 {
-	set_options(std::move(opts));
 }
 
 throttled_authenticator::~throttled_authenticator()
@@ -386,10 +362,33 @@ void throttled_authenticator::set_options(throttled_authenticator::options opts)
 	fz::scoped_lock lock(mutex_);
 
 	opts_ = std::move(opts);
+
+	ipv4_failures_.set_options(tracker_options<std::uint32_t>());
+	ipv6_failures_.set_options(tracker_options<std::uint64_t>());
+	users_failures_.set_options(tracker_options<std::string>());
+}
+
+template <typename Key>
+typename failure_tracker<Key>::options throttled_authenticator::tracker_options() const
+{
+	return typename failure_tracker<Key>::options()
+		.window(opts_.failures_window())
+		.max_entries(opts_.max_tracked());
+}
+
+std::string throttled_authenticator::user_key(std::string_view name)
+{
+#if FZ_AUTHENTICATION_AUTHENTICATOR_USERS_CASE_INSENSITIVE
+	return fz::to_utf8(fz::str_tolower(fz::to_wstring_from_utf8(name)));
+#else
+	return std::string(name);
+#endif
 }
 
 void throttled_authenticator::operator()(const event_base &ev)
 {
+	event_loop_monitor::dispatch_scope monitored(*this, ev);
+
 	fz::dispatch<timer_event>(ev, [&](timer_id id) {
 		auto now = fz::monotonic_clock::now();
 
@@ -416,31 +415,6 @@ void throttled_authenticator::operator()(const event_base &ev)
 			}
 			logger_.log_u(logmsg::debug_debug, L"Number of waiting auths after cycle: %d.", waiting_workers_.size());
 		}
-		else
-		if (id == purging_timer_id_) {
-			purging_timer_id_ = 0;
-
-			auto purge = [&](auto &map, const wchar_t *name) {
-				logger_.log_u(logmsg::debug_debug, L"Number of %s failures before purging cycle: %d.", name, map.size());
-
-				for (auto it = map.begin(); it != map.end();) {
-					auto next = std::next(it);
-
-					if (it->second.purge_old(now, opts_.failures_window()))
-						map.erase(it);
-
-					it = next;
-				}
-				logger_.log_u(logmsg::debug_debug, L"Number of %s failures after purging cycle: %d.", name, map.size());
-			};
-
-			purge(ipv4_failures_, L"IPv4");
-			purge(ipv6_failures_, L"IPv6");
-			purge(users_failures_, L"users");
-
-			if (!users_failures_.empty() || !ipv4_failures_.empty() || !ipv6_failures_.empty())
-				purging_timer_id_ = add_timer(opts_.failures_window(), true);
-		}
 	});
 }
 
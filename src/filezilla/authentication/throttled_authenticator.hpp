@@ -2,15 +2,15 @@
 #define FZ_AUTHENTICATION_THROTTLED_AUTHENTICATOR_HPP
 
 #include <list>
-#include <unordered_map>
 #include <map>
-#include <set>
-#include <deque>
+
+#include <libfilezilla/event_loop.hpp>
 
 #include "../filezilla/logger/modularized.hpp"
 #include "../filezilla/util/options.hpp"
 
 #include "authenticator.hpp"
+#include "failure_tracker.hpp"
 
 namespace fz::authentication
 {
@@ -25,6 +25,9 @@ public:
 		opt<duration>    delay           = o(duration::from_seconds(5));
 		opt<duration>    cap             = o(duration::from_seconds(60));
 
+		/// Beyond this number of tracked addresses or users, each, the least recently seen ones are forgotten.
+		opt<std::size_t> max_tracked     = o(std::size_t(1) << 20);
+
 		options(){}
 	};
 
@@ -51,33 +54,28 @@ private:
 	void operator()(const event_base &ev) override;
 
 	fz::timer_id auth_timer_id_{};
-	fz::timer_id purging_timer_id_{};
 
 private:
-	class failures_t
-	{
-	public:
-		bool add(duration delay, duration cap, std::size_t max_failures, duration failures_window);
-		bool purge_old(monotonic_clock now, duration failures_window);
-		bool set_next_try(monotonic_clock now, duration delay, duration cap, std::size_t max_failures);
-		const monotonic_clock &next_try() const;
-
-	private:
-		std::deque<monotonic_clock> timepoints_;
-		fz::monotonic_clock next_try_;
-	};
+	// The next try of a peer is the hold of its entry in the failure trackers.
+	template <typename Key>
+	static void set_next_try(typename failure_tracker<Key>::entry &e, monotonic_clock now, std::size_t failures, const options &opts);
+
+	template <typename Key>
+	typename failure_tracker<Key>::options tracker_options() const;
+
+	static std::string user_key(std::string_view name);
 
 	using waiting_workers_t = std::multimap<fz::monotonic_clock, workers_t::iterator>;
-	using ipv4_failures_t = std::unordered_map<std::uint32_t, failures_t>;
-	using ipv6_failures_t = std::unordered_map<std::uint64_t, failures_t>;
-	using users_failures_t = users_map<failures_t>;
 
 	waiting_workers_t waiting_workers_;
-	ipv4_failures_t ipv4_failures_;
-	ipv6_failures_t ipv6_failures_;
-	users_failures_t users_failures_;
 
 	options opts_;
+
+	// The expiry of the failures is handled on a thread of its own.
+	event_loop expiry_loop_;
+	failure_tracker<std::uint32_t> ipv4_failures_;
+	failure_tracker<std::uint64_t> ipv6_failures_;
+	failure_tracker<std::string> users_failures_;
 };
 
 }
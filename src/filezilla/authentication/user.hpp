@@ -4,7 +4,6 @@
 #include <string>
 #include <unordered_set>
 
-#include <libfilezilla/rate_limiter.hpp>
 #include <libfilezilla/impersonation.hpp>
 
 #include "../util/locking_wrapper.hpp"
@@ -12,6 +11,7 @@
 #include "../tvfs/mount.hpp"
 #include "../tvfs/limits.hpp"
 #include "../util/copies_counter.hpp"
+#include "../rate_limit/shared_limiter.hpp"
 
 namespace fz::impersonator {
 	class client;
@@ -25,10 +25,14 @@ public:
 	std::string name{};
 	std::shared_ptr<tvfs::mount_tree> mount_tree{};
 	std::shared_ptr<impersonator::client> impersonator{};
-	std::shared_ptr<rate_limiter> limiter;
-	std::vector<std::shared_ptr<rate_limiter>> extra_limiters{}; ///< sorted in ascending order
+	std::shared_ptr<rate_limit::shared_limiter> limiter;
+	std::vector<std::shared_ptr<rate_limit::shared_limiter>> extra_limiters{}; ///< sorted in ascending order
 	rate::type session_inbound_limit{rate::unlimited};
 	rate::type session_outbound_limit{rate::unlimited};
+	std::uint32_t bandwidth_weight{1};
+	std::string bandwidth_group{}; ///< the group whose share of the bandwidth the user's share is taken from, if any
+	std::uint32_t bandwidth_group_weight{1};
+	std::shared_ptr<rate_limit::shared_limiter> bandwidth_group_limiter{};
 	tvfs::open_limits session_open_limits{};
 	util::limited_copies_counter session_count_limiter;
 	std::vector<std::shared_ptr<util::limited_copies_counter>> extra_session_count_limiters;
@@ -0,0 +1,101 @@
+#include <libfilezilla/hash.hpp>
+#include <libfilezilla/util.hpp>
+
+#include "verified_credentials_cache.hpp"
+
+namespace fz::authentication {
+
+verified_credentials_cache::verified_credentials_cache(options opts, std::function<monotonic_clock()> clock)
+	: opts_(std::move(opts))
+	, hmac_key_(random_bytes(32))
+	, clock_(std::move(clock))
+{
+}
+
+void verified_credentials_cache::set_options(options opts)
+{
+	scoped_lock lock(mutex_);
+
+	opts_ = std::move(opts);
+
+	if (opts_.capacity() == 0) {
+		index_.clear();
+		entries_.clear();
+	}
+	else
+		prune(clock_());
+}
+
+std::string verified_credentials_cache::make_key(std::string_view username, std::string_view password, std::uint64_t version) const
+{
+	// The username is length-prefixed, so that no two different pairs of username and password are fed to the HMAC as the same data.
+	std::string data;
+	data.reserve(2*sizeof(std::uint64_t) + username.size() + password.size());
+
+	auto append = [&data](std::uint64_t v) {
+		for (std::size_t i = 0; i < sizeof(v); ++i)
+			data += char((v >> (8*i)) & 0xff);
+	};
+
+	append(version);
+	append(username.size());
+	data.append(username);
+	data.append(password);
+
+	auto mac = hmac_sha256(hmac_key_, data);
+	return std::string(mac.begin(), mac.end());
+}
+
+void verified_credentials_cache::prune(const monotonic_clock &now)
+{
+	while (!entries_.empty() && (entries_.size() > opts_.capacity() || now - entries_.back().second >= opts_.ttl())) {
+		index_.erase(entries_.back().first);
+		entries_.pop_back();
+	}
+}
+
+bool verified_credentials_cache::contains(std::string_view username, std::string_view password, std::uint64_t version)
+{
+	scoped_lock lock(mutex_);
+
+	if (opts_.capacity() == 0)
+		return false;
+
+	auto now = clock_();
+	prune(now);
+
+	return index_.count(make_key(username, password, version)) > 0;
+}
+
+void verified_credentials_cache::insert(std::string_view username, std::string_view password, std::uint64_t version)
+{
+	scoped_lock lock(mutex_);
+
+	if (opts_.capacity() == 0)
+		return;
+
+	auto key = make_key(username, password, version);
+	auto now = clock_();
+
+	if (auto it = index_.find(key); it != index_.end()) {
+		// Only full verifications get here, hence the ttl is measured since the last of them.
+		entries_.splice(entries_.begin(), entries_, it->second);
+		entries_.front().second = now;
+	}
+	else {
+		entries_.emplace_front(std::move(key), now);
+		index_.emplace(entries_.front().first, entries_.begin());
+	}
+
+	prune(now);
+}
+
+void verified_credentials_cache::clear()
+{
+	scoped_lock lock(mutex_);
+
+	index_.clear();
+	entries_.clear();
+}
+
+}
@@ -0,0 +1,68 @@
+#ifndef FZ_AUTHENTICATION_VERIFIED_CREDENTIALS_CACHE_HPP
+#define FZ_AUTHENTICATION_VERIFIED_CREDENTIALS_CACHE_HPP
+
+#include <functional>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <libfilezilla/mutex.hpp>
+#include <libfilezilla/time.hpp>
+
+#include "../util/options.hpp"
+
+namespace fz::authentication {
+
+/// \brief Remembers, for a short while, the username/password pairs that were successfully verified.
+///
+/// Clients that log in over and over with the same credentials would otherwise pay for a full key derivation each time.
+/// No password is retained: the entries are keyed by an HMAC of username, password and credentials version,
+/// computed with a random key that is generated anew by each process.
+///
+/// Only successful verifications must be inserted. The cache is disabled by default.
+class verified_credentials_cache
+{
+public:
+	struct options: util::options<options, verified_credentials_cache>
+	{
+		/// Maximum number of entries. 0 disables the cache.
+		opt<std::size_t> capacity = o(0);
+
+		/// How long a successful verification is remembered for.
+		opt<duration> ttl         = o(duration::from_minutes(1));
+
+		options() {}
+	};
+
+	/// \param clock where the current time is taken from. Tests replace it, to control the passing of time.
+	verified_credentials_cache(options opts = {}, std::function<monotonic_clock()> clock = &monotonic_clock::now);
+
+	void set_options(options opts);
+
+	/// \returns true if the given credentials have been verified within the ttl, for the given credentials version.
+	bool contains(std::string_view username, std::string_view password, std::uint64_t version);
+
+	void insert(std::string_view username, std::string_view password, std::uint64_t version);
+
+	void clear();
+
+private:
+	using entries = std::list<std::pair<std::string, monotonic_clock>>;
+
+	std::string make_key(std::string_view username, std::string_view password, std::uint64_t version) const;
+	void prune(const monotonic_clock &now);
+
+	fz::mutex mutex_;
+	options opts_;
+	const std::vector<std::uint8_t> hmac_key_;
+	const std::function<monotonic_clock()> clock_;
+
+	entries entries_; ///< most recently inserted first
+	std::unordered_map<std::string_view, entries::iterator> index_;
+};
+
+}
+
+#endif // FZ_AUTHENTICATION_VERIFIED_CREDENTIALS_CACHE_HPP
@@ -19,16 +19,33 @@ namespace fz::buffer_operator {
 			, logger_(logger)
 		{}
 
+		/// Makes the reader read only \p size bytes, starting at \p offset.
+		/// \returns false if the file couldn't be seeked to \p offset.
+		bool set_range(std::int64_t offset, std::int64_t size)
+		{
+			if (file_.seek(offset, file::begin) != offset)
+				return false;
+
+			remaining_ = size;
+			return true;
+		}
+
 		int add_to_buffer() override {
 			auto buffer = get_buffer();
 			if (!buffer)
 				return EFAULT;
 
+			if (remaining_ == 0)
+				return ENODATA;
+
 			if (max_buffer_size_ <= buffer->size() )
 				return ENOBUFS;
 
 			std::size_t to_read = max_buffer_size_ - buffer->size();
 
+			if (remaining_ > 0 && std::uint64_t(remaining_) < to_read)
+				to_read = std::size_t(remaining_);
+
 			auto result = file_.read2(buffer->get(to_read), to_read);
 			if (result.error_) {
 				if (logger_) {
@@ -39,8 +56,20 @@ namespace fz::buffer_operator {
 				return EIO;
 			}
 
-			if (!result.value_)
+			if (!result.value_) {
+				if (remaining_ > 0) {
+					// The file has shrunk: what's been promised can't be delivered anymore.
+					if (logger_)
+						logger_->log_u(logmsg::error, L"File ended %d bytes before the end of the range.", remaining_);
+
+					return EIO;
+				}
+
 				return ENODATA;
+			}
+
+			if (remaining_ > 0)
+				remaining_ -= std::int64_t(result.value_);
 
 			buffer->add(result.value_);
 			return 0;
@@ -50,6 +79,7 @@ namespace fz::buffer_operator {
 		file &file_;
 		unsigned int max_buffer_size_;
 		logger_interface *logger_;
+		std::int64_t remaining_{-1};
 	};
 
 }
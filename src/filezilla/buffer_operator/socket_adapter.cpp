@@ -1,10 +1,26 @@
 #include "socket_adapter.hpp"
+#include "../event_loop_monitor.hpp"
+#include "../metrics/registry.hpp"
 
 namespace {
 
 struct shutdown_event_tag{};
 using shutdown_event = fz::simple_event<shutdown_event_tag>;
 
+struct channel_metrics
+{
+	fz::metrics::counter &read_bytes = fz::metrics::registry::global().get_counter("fz_channel_read_bytes_total", "Bytes read from the sockets of the channels.");
+	fz::metrics::counter &written_bytes = fz::metrics::registry::global().get_counter("fz_channel_written_bytes_total", "Bytes written to the sockets of the channels.");
+	fz::metrics::counter &read_stalls = fz::metrics::registry::global().get_counter("fz_channel_read_stalls_total", "Times reading from a socket was suspended because the data read was not being consumed fast enough.");
+	fz::metrics::counter &write_stalls = fz::metrics::registry::global().get_counter("fz_channel_write_stalls_total", "Times writing to a socket had to wait for it to become writable again.");
+
+	static channel_metrics &get()
+	{
+		static channel_metrics m;
+		return m;
+	}
+};
+
 }
 
 fz::buffer_operator::socket_adapter::socket_adapter(fz::event_handler &target_handler, std::size_t max_readable_amount, std::size_t max_writable_amount_left_before_reading_again)
@@ -63,6 +79,7 @@ int fz::buffer_operator::socket_adapter::consume_buffer() {
 
 	if (written >= 0) {
 		buffer->consume(size_t(written));
+		channel_metrics::get().written_bytes.add(std::uint64_t(written));
 
 		if (shutting_down_) {
 			on_shutdown_event();
@@ -74,8 +91,10 @@ int fz::buffer_operator::socket_adapter::consume_buffer() {
 		}
 	}
 
-	if (error == EAGAIN)
+	if (error == EAGAIN) {
 		waiting_for_write_event_ = true;
+		channel_metrics::get().write_stalls.add();
+	}
 
 	return error;
 }
@@ -93,6 +112,7 @@ int fz::buffer_operator::socket_adapter::add_to_buffer() {
 
 		if (con_buffer->size() > max_writable_amount_left_before_reading_again_) {
 			adder_waiting_for_consumable_amount_to_be_low_enough_ = true;
+			channel_metrics::get().read_stalls.add();
 			return EAGAIN;
 		}
 	}
@@ -107,8 +127,10 @@ int fz::buffer_operator::socket_adapter::add_to_buffer() {
 	if (amount_to_read > 0) {
 		int read = si_->read(buffer->get(amount_to_read), static_cast<unsigned int>(amount_to_read), error);
 
-		if (read > 0)
+		if (read > 0) {
 			buffer->add(size_t(read));
+			channel_metrics::get().read_bytes.add(std::uint64_t(read));
+		}
 		else
 		if (read == 0)
 			error = ENODATA;
@@ -123,6 +145,8 @@ int fz::buffer_operator::socket_adapter::add_to_buffer() {
 }
 
 void fz::buffer_operator::socket_adapter::operator()(const fz::event_base &ev) {
+	fz::event_loop_monitor::dispatch_scope monitored(*this, ev);
+
 	fz::dispatch<
 		fz::socket_event,
 		shutdown_event
@@ -1,4 +1,5 @@
 #include "channel.hpp"
+#include "event_loop_monitor.hpp"
 
 namespace fz {
 
@@ -94,6 +95,8 @@ void channel::clear()
 
 void channel::operator()(const event_base &event)
 {
+	event_loop_monitor::dispatch_scope monitored(*this, event);
+
 	dispatch<
 		pipe::done_event
 	>(event, this,
@@ -0,0 +1,299 @@
+#include <algorithm>
+
+#include <libfilezilla/format.hpp>
+
+#include "event_loop_monitor.hpp"
+#include "util/demangle.hpp"
+
+namespace fz {
+
+namespace {
+
+struct probe_event_tag{};
+using probe_event = simple_event<probe_event_tag, metrics::stopwatch>;
+
+std::int64_t now_us()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void update_max(std::atomic<std::uint64_t> &max, std::uint64_t v)
+{
+	auto cur = max.load(std::memory_order_relaxed);
+	while (v > cur && !max.compare_exchange_weak(cur, v, std::memory_order_relaxed));
+}
+
+std::string session_suffix(std::uint64_t session_id)
+{
+	if (!session_id)
+		return {};
+
+	return fz::sprintf(" of session %d", session_id);
+}
+
+struct type_pair_hash
+{
+	std::size_t operator()(const std::pair<std::type_index, std::type_index> &p) const noexcept
+	{
+		return std::hash<std::type_index>()(p.first) * 31 + std::hash<std::type_index>()(p.second);
+	}
+};
+
+}
+
+struct event_loop_monitor::common
+{
+	common(logger_interface &logger)
+		: logger(logger)
+	{}
+
+	logger_interface &logger;
+	std::atomic<std::uint64_t> stall_threshold_us{};
+};
+
+struct event_loop_monitor::loop_state
+{
+	loop_state(std::shared_ptr<event_loop_monitor::common> common, std::string name)
+		: common(std::move(common))
+		, name(std::move(name))
+		, lag(metrics::registry::global().get_histogram("fz_event_loop_lag_seconds", "Time the events wait in the queue of the event loops before being dispatched.", metrics::unit::microseconds, {{"loop", this->name}}))
+		, dispatch_duration(metrics::registry::global().get_histogram("fz_event_loop_dispatch_duration_seconds", "Time the event loops spend dispatching a single event to a monitored handler.", metrics::unit::microseconds, {{"loop", this->name}}))
+		, stalls(metrics::registry::global().get_counter("fz_event_loop_stalls_total", "Dispatches that took longer than the stall threshold.", {{"loop", this->name}}))
+	{}
+
+	const std::shared_ptr<event_loop_monitor::common> common;
+	const std::string name;
+
+	metrics::histogram &lag;
+	metrics::histogram &dispatch_duration;
+	metrics::counter &stalls;
+	std::atomic<std::uint64_t> lag_max_us{};
+	std::atomic<std::uint64_t> dispatch_max_us{};
+
+	// Written by the thread of the loop, read by the watchdog.
+	std::atomic<std::uint64_t> dispatch_seq{};
+	std::atomic<std::int64_t> dispatch_start_us{}; ///< 0 when not dispatching.
+	std::atomic<const std::type_info *> handler_type{};
+	std::atomic<const std::type_info *> event_type{};
+	std::atomic<std::uint64_t> session_id{};
+
+	// Only accessed by the watchdog, with the monitor's mutex held.
+	std::uint64_t reported_seq{};
+
+	// Only accessed by the thread of the loop.
+	unsigned int nesting{};
+	std::unordered_map<std::pair<std::type_index, std::type_index>, metrics::histogram *, type_pair_hash> handler_durations{};
+};
+
+thread_local std::weak_ptr<event_loop_monitor::loop_state> event_loop_monitor::current_state_{};
+
+event_loop_monitor::event_loop_monitor(thread_pool &pool, logger_interface &logger, options opts)
+	: common_(std::make_shared<common>(logger))
+{
+	set_options(opts);
+
+	task_ = pool.spawn([this] { watch(); });
+}
+
+event_loop_monitor::~event_loop_monitor()
+{
+	{
+		scoped_lock lock(mutex_);
+		quit_ = true;
+		condition_.signal(lock);
+	}
+
+	task_.join();
+}
+
+void event_loop_monitor::set_options(const options &opts)
+{
+	scoped_lock lock(mutex_);
+
+	opts_ = opts;
+	common_->stall_threshold_us = std::uint64_t(std::max<std::int64_t>(opts_.stall_threshold().get_microseconds(), 0));
+	probe_interval_ms_ = std::max<std::int64_t>(opts_.probe_interval().get_milliseconds(), 10);
+
+	// The watchdog must adapt its pace to the new threshold.
+	condition_.signal(lock);
+}
+
+event_loop_monitor::options event_loop_monitor::get_options() const
+{
+	scoped_lock lock(mutex_);
+	return opts_;
+}
+
+std::vector<event_loop_monitor::loop_summary> event_loop_monitor::get_summary() const
+{
+	scoped_lock lock(mutex_);
+
+	std::vector<loop_summary> summary;
+
+	for (auto &s: states_) {
+		metrics::family::sample lag, dispatch;
+		s->lag.collect(lag);
+		s->dispatch_duration.collect(dispatch);
+
+		auto &l = summary.emplace_back();
+		l.name = s->name;
+		l.lag_p50_us = metrics::quantile(lag, 0.5);
+		l.lag_p99_us = metrics::quantile(lag, 0.99);
+		l.lag_max_us = s->lag_max_us;
+		l.dispatches = dispatch.count;
+		l.dispatch_p99_us = metrics::quantile(dispatch, 0.99);
+		l.dispatch_max_us = s->dispatch_max_us;
+		l.stalls = s->stalls.value();
+	}
+
+	return summary;
+}
+
+void event_loop_monitor::watch()
+{
+	scoped_lock lock(mutex_);
+
+	while (!quit_) {
+		auto threshold_us = common_->stall_threshold_us.load();
+
+		// Check often enough to notice a stall soon after it crosses the threshold.
+		condition_.wait(lock, threshold_us ? duration::from_milliseconds(std::max<std::int64_t>(std::int64_t(threshold_us) / 2000, 10)) : duration::from_seconds(1));
+
+		if (quit_ || !threshold_us)
+			continue;
+
+		auto now = now_us();
+
+		for (auto &s: states_) {
+			auto seq = s->dispatch_seq.load(std::memory_order_acquire);
+			auto start = s->dispatch_start_us.load(std::memory_order_acquire);
+
+			if (!start || seq == s->reported_seq || std::uint64_t(now - start) < threshold_us)
+				continue;
+
+			auto handler = s->handler_type.load(std::memory_order_relaxed);
+			auto event = s->event_type.load(std::memory_order_relaxed);
+			auto session_id = s->session_id.load(std::memory_order_relaxed);
+
+			// The dispatch ended meanwhile, and what was just read might belong to another one.
+			if (seq != s->dispatch_seq.load(std::memory_order_acquire) || !handler || !event)
+				continue;
+
+			s->reported_seq = seq;
+
+			common_->logger.log_u(logmsg::warning, L"Event loop \"%s\" has been busy for %d ms dispatching %s to %s%s.",
+				s->name, (now - start) / 1000, util::demangle(event->name()), util::demangle(handler->name()), session_suffix(session_id));
+		}
+	}
+}
+
+event_loop_monitor::probe::probe(event_loop_monitor &monitor, event_loop &loop, std::string name)
+	: event_handler(loop)
+	, monitor_(monitor)
+	, state_(std::make_shared<loop_state>(monitor.common_, std::move(name)))
+{
+	{
+		scoped_lock lock(monitor_.mutex_);
+		monitor_.states_.push_back(state_);
+	}
+
+	send_event<probe_event>(metrics::stopwatch());
+}
+
+event_loop_monitor::probe::~probe()
+{
+	remove_handler();
+
+	// The thread of the loop may still point to the state, but it won't get hold of it anymore.
+	scoped_lock lock(monitor_.mutex_);
+	monitor_.states_.erase(std::find(monitor_.states_.begin(), monitor_.states_.end(), state_));
+}
+
+void event_loop_monitor::probe::operator()(const event_base &ev)
+{
+	fz::dispatch<
+		timer_event,
+		probe_event
+	>(ev, this,
+		&probe::on_timer,
+		&probe::on_probe
+	);
+}
+
+void event_loop_monitor::probe::on_timer(timer_id)
+{
+	send_event<probe_event>(metrics::stopwatch());
+}
+
+void event_loop_monitor::probe::on_probe(const metrics::stopwatch &sent)
+{
+	current_state_ = state_;
+
+	auto lag = sent.elapsed_us();
+	state_->lag.record(lag);
+	update_max(state_->lag_max_us, lag);
+
+	add_timer(duration::from_milliseconds(monitor_.probe_interval_ms_), true);
+}
+
+event_loop_monitor::dispatch_scope::dispatch_scope(const event_handler &handler, const event_base &ev, std::uint64_t session_id) noexcept
+	: state_(current_state_.lock())
+{
+	if (!state_)
+		return;
+
+	if (state_->nesting++ > 0) {
+		// Only the outermost scope accounts for the dispatch, but all of them must leave the nesting as they found it.
+		start_us_ = 0;
+		return;
+	}
+
+	state_->handler_type.store(&typeid(handler), std::memory_order_relaxed);
+	state_->event_type.store(&typeid(ev), std::memory_order_relaxed);
+	state_->session_id.store(session_id, std::memory_order_relaxed);
+	state_->dispatch_seq.fetch_add(1, std::memory_order_release);
+
+	start_us_ = now_us();
+	state_->dispatch_start_us.store(start_us_, std::memory_order_release);
+}
+
+event_loop_monitor::dispatch_scope::~dispatch_scope()
+{
+	if (!state_)
+		return;
+
+	--state_->nesting;
+
+	if (!start_us_)
+		return;
+
+	state_->dispatch_start_us.store(0, std::memory_order_release);
+
+	auto elapsed = std::uint64_t(now_us() - start_us_);
+
+	state_->dispatch_duration.record(elapsed);
+	update_max(state_->dispatch_max_us, elapsed);
+
+	auto handler = state_->handler_type.load(std::memory_order_relaxed);
+	auto event = state_->event_type.load(std::memory_order_relaxed);
+
+	auto &h = state_->handler_durations[{std::type_index(*handler), std::type_index(*event)}];
+	if (!h) {
+		h = &metrics::registry::global().get_histogram(
+			"fz_event_handler_duration_seconds", "Time the monitored handlers spend processing a single event, per handler and event type.", metrics::unit::microseconds,
+			{{"handler", util::demangle(handler->name())}, {"event", util::demangle(event->name())}}
+		);
+	}
+
+	h->record(elapsed);
+
+	auto threshold_us = state_->common->stall_threshold_us.load(std::memory_order_relaxed);
+	if (threshold_us && elapsed >= threshold_us) {
+		state_->stalls.add();
+
+		state_->common->logger.log_u(logmsg::warning, L"Event loop \"%s\" took %d ms dispatching %s to %s%s.",
+			state_->name, elapsed / 1000, util::demangle(event->name()), util::demangle(handler->name()), session_suffix(state_->session_id.load(std::memory_order_relaxed)));
+	}
+}
+
+}
@@ -0,0 +1,131 @@
+#ifndef FZ_EVENT_LOOP_MONITOR_HPP
+#define FZ_EVENT_LOOP_MONITOR_HPP
+
+#include <memory>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+#include <libfilezilla/event_handler.hpp>
+#include <libfilezilla/logger.hpp>
+#include <libfilezilla/thread_pool.hpp>
+
+#include "metrics/registry.hpp"
+#include "util/options.hpp"
+
+namespace fz {
+
+/// \brief Tells what the event loops are busy with.
+///
+/// Each monitored loop is periodically sent a probe event, whose queuing delay is the loop's scheduling lag.
+/// The handlers that wrap their dispatching in a dispatch_scope have their execution time measured, per handler and event type,
+/// and a watchdog logs the dispatches that take longer than the stall threshold, while they are still running and once they're done.
+class event_loop_monitor
+{
+	struct common;
+	struct loop_state;
+
+public:
+	struct options: util::options<options, event_loop_monitor>
+	{
+		/// How often the scheduling lag of the loops is measured.
+		opt<duration> probe_interval  = o(duration::from_milliseconds(500));
+
+		/// Dispatches taking longer than this are logged. 0 disables the logging.
+		opt<duration> stall_threshold = o(duration::from_milliseconds(250));
+
+		options() {}
+	};
+
+	struct loop_summary
+	{
+		std::string name{};
+
+		std::uint64_t lag_p50_us{};
+		std::uint64_t lag_p99_us{};
+		std::uint64_t lag_max_us{};
+
+		std::uint64_t dispatches{};
+		std::uint64_t dispatch_p99_us{};
+		std::uint64_t dispatch_max_us{};
+		std::uint64_t stalls{};
+
+		template <typename Archive>
+		void serialize(Archive &ar)
+		{
+			ar(FZ_NVP(name), FZ_NVP(lag_p50_us), FZ_NVP(lag_p99_us), FZ_NVP(lag_max_us),
+			   FZ_NVP(dispatches), FZ_NVP(dispatch_p99_us), FZ_NVP(dispatch_max_us), FZ_NVP(stalls));
+		}
+	};
+
+	class probe;
+	class dispatch_scope;
+
+	event_loop_monitor(thread_pool &pool, logger_interface &logger, options opts = {});
+	~event_loop_monitor();
+
+	void set_options(const options &opts);
+	options get_options() const;
+
+	/// \returns the summary of each of the loops currently monitored.
+	std::vector<loop_summary> get_summary() const;
+
+private:
+	void watch();
+
+	// Shared with the states, which the dispatches still running might keep alive after the monitor is gone.
+	const std::shared_ptr<common> common_;
+
+	mutable fz::mutex mutex_;
+	fz::condition condition_;
+	options opts_;
+	std::atomic<std::int64_t> probe_interval_ms_{};
+
+	// The states of the loops whose probe is alive.
+	std::vector<std::shared_ptr<loop_state>> states_;
+
+	bool quit_{};
+	fz::async_task task_;
+
+	// The state of the loop run by the current thread, set by its probe. It expires together with the probe.
+	static thread_local std::weak_ptr<loop_state> current_state_;
+};
+
+/// Keeps measuring the scheduling lag of an event loop, for as long as it lives.
+/// It must be destroyed before the loop it probes.
+class event_loop_monitor::probe final: private event_handler
+{
+public:
+	probe(event_loop_monitor &monitor, event_loop &loop, std::string name);
+	~probe() override;
+
+private:
+	void operator()(const event_base &ev) override;
+	void on_timer(timer_id);
+	void on_probe(const metrics::stopwatch &sent);
+
+	event_loop_monitor &monitor_;
+	const std::shared_ptr<loop_state> state_;
+};
+
+/// \brief Measures the dispatching of an event to a handler, for the handler's loop.
+///
+/// Meant to be put at the top of the handlers' operator(). Nested scopes, on the same thread, only account for the outermost one.
+/// It does nothing on the threads whose loop isn't monitored.
+class event_loop_monitor::dispatch_scope
+{
+public:
+	dispatch_scope(const event_handler &handler, const event_base &ev, std::uint64_t session_id = 0) noexcept;
+	~dispatch_scope();
+
+	dispatch_scope(const dispatch_scope &) = delete;
+	dispatch_scope &operator=(const dispatch_scope &) = delete;
+
+private:
+	std::shared_ptr<loop_state> state_;
+	std::int64_t start_us_{};
+};
+
+}
+
+#endif // FZ_EVENT_LOOP_MONITOR_HPP
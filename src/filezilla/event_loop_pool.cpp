@@ -1,16 +1,38 @@
+#include <libfilezilla/format.hpp>
 #include <libfilezilla/util.hpp>
 
 #include "event_loop_pool.hpp"
 
 namespace fz {
 
-event_loop_pool::event_loop_pool(fz::event_loop &main_loop, fz::thread_pool &pool, uint32_t max_num_of_loops)
+event_loop_pool::event_loop_pool(fz::event_loop &main_loop, fz::thread_pool &pool, uint32_t max_num_of_loops, event_loop_monitor *monitor)
 	: main_loop_(main_loop)
 	, pool_(pool)
+	, monitor_(monitor)
 {
+	if (monitor_)
+		probes_.push_back(std::make_unique<event_loop_monitor::probe>(*monitor_, main_loop_, "main"));
+
 	set_max_num_of_loops(max_num_of_loops);
 }
 
+event_loop_pool::~event_loop_pool()
+{
+	probes_.clear();
+
+	for (auto &l: loops_) {
+		for (auto &hook: release_hooks_)
+			hook(*l);
+	}
+}
+
+void event_loop_pool::add_release_hook(std::function<void (event_loop &)> hook)
+{
+	scoped_lock lock(mutex_);
+
+	release_hooks_.push_back(std::move(hook));
+}
+
 void event_loop_pool::set_max_num_of_loops(std::uint32_t max)
 {
 	scoped_lock lock(mutex_);
@@ -22,6 +44,9 @@ void event_loop_pool::set_max_num_of_loops(std::uint32_t max)
 
 		while (loops_.size() < max_num_of_loops_) {
 			loops_.push_back(std::make_unique<event_loop>(pool_));
+
+			if (monitor_)
+				probes_.push_back(std::make_unique<event_loop_monitor::probe>(*monitor_, *loops_.back(), fz::sprintf("sessions %d", loops_.size())));
 		}
 	}
 }
@@ -1,26 +1,46 @@
 #ifndef FZ_EVENT_LOOP_POOL_HPP
 #define FZ_EVENT_LOOP_POOL_HPP
 
+#include <functional>
+
 #include <libfilezilla/event_loop.hpp>
 #include <libfilezilla/thread_pool.hpp>
 
+#include "event_loop_monitor.hpp"
+
 namespace fz {
 
 class event_loop_pool
 {
 public:
-	event_loop_pool(event_loop &main_loop, thread_pool &pool, std::uint32_t max_num_of_loops = 0);
+	/// If \p monitor is not null, the main loop and all the loops of the pool are monitored by it.
+	event_loop_pool(event_loop &main_loop, thread_pool &pool, std::uint32_t max_num_of_loops = 0, event_loop_monitor *monitor = nullptr);
+	~event_loop_pool();
+
+	/// \p hook is invoked with each loop of the pool right before the loop is destroyed, so that whatever is bound to it can be disposed of first.
+	/// It is not invoked with the main loop, which the pool doesn't own.
+	void add_release_hook(std::function<void(event_loop &loop)> hook);
 
 	void set_max_num_of_loops(std::uint32_t max);
 	event_loop &get_loop();
 
+	event_loop_monitor *get_monitor() const
+	{
+		return monitor_;
+	}
+
 private:
 	fz::mutex mutex_;
 
 	event_loop &main_loop_;
 	thread_pool &pool_;
+	event_loop_monitor *monitor_;
 	std::uint32_t max_num_of_loops_;
 	std::vector<std::unique_ptr<event_loop>> loops_;
+	std::vector<std::function<void(event_loop &loop)>> release_hooks_;
+
+	// Must be destroyed before the loops they probe.
+	std::vector<std::unique_ptr<event_loop_monitor::probe>> probes_;
 };
 
 }
@@ -7,6 +7,7 @@
 #include "../util/parser.hpp"
 #include "../build_info.hpp"
 #include "../strresult.hpp"
+#include "../event_loop_monitor.hpp"
 
 #include "commander.hpp"
 
@@ -305,10 +306,32 @@ bool commander::is_executing_command() const
 	return current_cmd_ != commands_.cend();
 }
 
+metrics::histogram &commander::command_duration_metric(std::string_view name)
+{
+	// The set of commands is fixed, so are their histograms: look them all up just once.
+	static const auto histograms = [] {
+		std::unordered_map<std::string_view, metrics::histogram *> h;
+
+		for (auto &c: commands_) {
+			h.emplace(c.first, &metrics::registry::global().get_histogram(
+				"fz_ftp_command_duration_seconds", "Time taken by the FTP commands, from their reception to their final reply.",
+				metrics::unit::microseconds, {{"command", std::string(c.first)}}
+			));
+		}
+
+		return h;
+	}();
+
+	return *histograms.at(name);
+}
+
 void commander::act_upon_command_reply(command_reply reply)
 {
 	if (reply != positive_preliminary_reply) {
 		// Command has finished execution.
+		if (current_cmd_ != commands_.cend())
+			command_duration_metric(current_cmd_->first).record(current_cmd_stopwatch_);
+
 		current_cmd_ = commands_.cend();
 
 		if (a_cmd_has_been_queued_) {
@@ -447,6 +470,7 @@ int commander::process_buffer_line(buffer_string_view line, bool there_is_more_d
 		}
 
 		current_cmd_ = new_cmd;
+		current_cmd_stopwatch_ = {};
 
 		if (current_cmd_->second.flags & needs_arg && arg.empty()) {
 			respond<501>() << "Missing required argument";
@@ -494,6 +518,8 @@ int commander::process_buffer_line(buffer_string_view line, bool there_is_more_d
 
 void commander::operator()(const event_base &event)
 {
+	event_loop_monitor::dispatch_scope monitored(*this, event, controller_.get_session_id());
+
 	if (on_invoker_event(event))
 		return;
 
@@ -523,12 +549,19 @@ void commander::notify_channel_socket_read_amount(const monotonic_clock &time_po
 {
 	last_activity_ = time_point;
 	notifier_.notify_entry_write(0, amount, -1);
+
+	// The amount is cumulative, and starts over if the channel is given another socket.
+	controller_.add_control_transferred(direction::inbound, amount >= previous_read_amount_ ? amount - previous_read_amount_ : amount);
+	previous_read_amount_ = amount;
 }
 
 void commander::notify_channel_socket_written_amount(const monotonic_clock &time_point, int64_t amount)
 {
 	last_activity_ = time_point;
 	notifier_.notify_entry_read(0, amount, -1);
+
+	controller_.add_control_transferred(direction::outbound, amount >= previous_written_amount_ ? amount - previous_written_amount_ : amount);
+	previous_written_amount_ = amount;
 }
 
 FTP_CMD(FEAT, none) {
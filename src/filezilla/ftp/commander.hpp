@@ -16,6 +16,7 @@
 #include "../tvfs/engine.hpp"
 #include "../tcp/session.hpp"
 #include "../util/welcome_message.hpp"
+#include "../metrics/registry.hpp"
 
 #include "controller.hpp"
 
@@ -192,6 +193,9 @@ private:
 
 	decltype(commands_)::const_iterator current_cmd_ { commands_.cend() };
 	decltype(commands_)::const_iterator cmd_being_aborted_ { commands_.cend() };
+	metrics::stopwatch current_cmd_stopwatch_{};
+
+	static metrics::histogram &command_duration_metric(std::string_view name);
 
 	class responder;
 	template <unsigned int XYZ>
@@ -219,6 +223,8 @@ private:
 	timer_id timer_id_{};
 	monotonic_clock start_time_{};
 	monotonic_clock &last_activity_;
+	std::int64_t previous_read_amount_{};
+	std::int64_t previous_written_amount_{};
 	bool needs_security_before_user_cmd_{};
 
 	// authenticate_user_response_handler interface
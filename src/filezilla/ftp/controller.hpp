@@ -6,6 +6,7 @@
 
 #include <libfilezilla/iputils.hpp>
 #include <libfilezilla/local_filesys.hpp>
+#include <libfilezilla/rate_limiter.hpp>
 
 #include "../hostaddress.hpp"
 #include "../authentication/authenticator.hpp"
@@ -21,6 +22,7 @@ public:
 	virtual ~controller() = default;
 
 	virtual fz::address_type get_control_socket_address_family() const = 0;
+	virtual std::uint64_t get_session_id() const = 0;
 
 	class authenticate_user_response_handler {
 	public:
@@ -89,6 +91,9 @@ public:
 	/// \Returns the status of the connection before the call
 	virtual data_connection_status close_data_connection() = 0;
 	virtual bool must_downgrade_log_level() = 0;
+
+	/// Accounts the traffic of the control channel, like the data channel's, against the limits shared with other sessions.
+	virtual void add_control_transferred(direction::type d, std::int64_t amount) = 0;
 };
 
 }
@@ -13,7 +13,8 @@ namespace fz::ftp {
 server::server(tcp::server::context &context, event_loop_pool &loop_pool,
 			   logger_interface &nonsession_logger, logger_interface &session_logger,
 			   authentication::authenticator &authenticator,
-			   rate_limit_manager &rate_limit_manager,
+			   rate_limit::sharded_manager &rate_limit_manager,
+			   rate_limit::fair_share_scheduler &bandwidth_scheduler,
 			   tcp::address_list &disallowed_ips, tcp::address_list &allowed_ips,
 			   authentication::autobanner &autobanner,
 			   port_manager &port_manager,
@@ -26,9 +27,11 @@ server::server(tcp::server::context &context, event_loop_pool &loop_pool,
 	, session_logger_(session_logger, "FTP Server")
 	, authenticator_(authenticator)
 	, rate_limit_manager_(rate_limit_manager)
+	, bandwidth_scheduler_(bandwidth_scheduler)
 	, autobanner_(autobanner, *this)
 	, port_manager_(port_manager)
-	, tcp_server_(context, nonsession_logger_, *this)
+	, hostname_cache_(pool_, context.loop(), nonsession_logger_)
+	, tcp_server_(context, nonsession_logger_, *this, "ftp")
 {
 	set_options(std::move(opts));
 }
@@ -92,6 +95,11 @@ void server::set_timeouts(const duration &login_timeout, const duration &activit
 	activity_timeout_ = activity_timeout;
 }
 
+void server::set_hostname_cache_options(tcp::hostname_cache::options opts)
+{
+	hostname_cache_.set_options(std::move(opts));
+}
+
 void server::set_notifier_factory(session::notifier::factory &nf)
 {
 	scoped_lock lock(mutex_);
@@ -124,6 +132,7 @@ std::unique_ptr<tcp::session> server::make_session(event_handler &target_handler
 		loop,
 		target_handler,
 		rate_limit_manager_,
+		bandwidth_scheduler_,
 		std::move(notifier),
 		session_id,
 		startdate,
@@ -132,6 +141,7 @@ std::unique_ptr<tcp::session> server::make_session(event_handler &target_handler
 		autobanner_,
 		authenticator_,
 		port_manager_,
+		hostname_cache_,
 		opts_.welcome_message(),
 		refuse_message_,
 		opts_.sessions()
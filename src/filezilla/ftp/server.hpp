@@ -55,7 +55,8 @@ public:
 	server(tcp::server::context &context, event_loop_pool &loop_pool,
 		   logger_interface &nonsession_logger, logger_interface &session_logger,
 		   authentication::authenticator &authenticator,
-		   rate_limit_manager &rate_limit_manager,
+		   rate_limit::sharded_manager &rate_limit_manager,
+		   rate_limit::fair_share_scheduler &bandwidth_scheduler,
 		   tcp::address_list &disallowed_ips, tcp::address_list &allowed_ips,
 		   authentication::autobanner &autobanner,
 		   port_manager &port_manager,
@@ -77,6 +78,9 @@ public:
 	//! Set the timeouts
 	void set_timeouts(const duration &login_timeout, const duration &activity_timeout);
 
+	//! Set the options of the cache of the hostnames the sessions resolve, like the PASV host override
+	void set_hostname_cache_options(tcp::hostname_cache::options opts);
+
 	void set_notifier_factory(session::notifier::factory &nf);
 
 private:
@@ -86,9 +90,11 @@ private:
 	logger::modularized nonsession_logger_;
 	logger::modularized session_logger_;
 	authentication::authenticator &authenticator_;
-	fz::rate_limit_manager &rate_limit_manager_;
+	rate_limit::sharded_manager &rate_limit_manager_;
+	rate_limit::fair_share_scheduler &bandwidth_scheduler_;
 	authentication::autobanner::with_events autobanner_;
 	port_manager &port_manager_;
+	tcp::hostname_cache hostname_cache_;
 
 	options opts_;
 
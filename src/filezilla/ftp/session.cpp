@@ -2,7 +2,6 @@
 #include <libfilezilla/buffer.hpp>
 #include <libfilezilla/local_filesys.hpp>
 #include <libfilezilla/rate_limited_layer.hpp>
-#include <libfilezilla/hostname_lookup.hpp>
 
 #include "../authentication/authenticator.hpp"
 #include "../authentication/error.hpp"
@@ -16,6 +15,7 @@
 #include "../ftp/session.hpp"
 #include "../ftp/ascii_layer.hpp"
 #include "../util/thread_id.hpp"
+#include "../event_loop_monitor.hpp"
 
 namespace fz::ftp {
 
@@ -39,7 +39,8 @@ std::string session::protocol_info::get_name() const
 }
 
 session::session(fz::thread_pool &pool, event_loop &loop, event_handler &target_event_handler,
-				 rate_limit_manager &rate_limit_manager,
+				 rate_limit::sharded_manager &rate_limit_manager,
+				 rate_limit::fair_share_scheduler &bandwidth_scheduler,
 				 std::unique_ptr<notifier> notifier,
 				 id id,
 				 datetime start,
@@ -48,17 +49,20 @@ session::session(fz::thread_pool &pool, event_loop &loop, event_handler &target_
 				 authentication::autobanner &autobanner,
 				 authentication::authenticator &authenticator,
 				 port_manager &port_manager,
+				 tcp::hostname_cache &hostname_cache,
 				 const commander::welcome_message &welcome_message, const std::string &refuse_message,
 				 options opts)
 	: tcp::session(target_event_handler, id, {control_socket->peer_ip(), control_socket->address_family()})
 	, event_handler(loop)
-	, session_limiter_(&rate_limit_manager)
+	, session_limiter_(&rate_limit_manager.get(loop))
+	, bandwidth_share_(bandwidth_scheduler, loop, session_limiter_)
 	, pool_(pool)
 	, notifier_{std::move(notifier)}
 	, logger_(notifier_->logger(), "FTP Session", {{"id", std::to_string(id)}, {"host", control_socket->peer_ip()}}, logger_info_to_string)
 	, start_datetime_{start}
 	, control_socket_(loop, this, std::move(control_socket), logger_)
 	, port_manager_(port_manager)
+	, hostname_cache_(hostname_cache)
 	, opts_(std::move(opts))
 	, tvfs_(logger_)
 	, autobanner_(autobanner)
@@ -88,6 +92,7 @@ session::session(fz::thread_pool &pool, event_loop &loop, event_handler &target_
 }
 
 session::~session() {
+	hostname_cache_.cancel(*this);
 	remove_handler();
 
 	logger_.log_u(logmsg::debug_info, L"Session %p with ID %zu destroyed.", this, id_);
@@ -130,13 +135,24 @@ void session::on_shared_user_changed_event(const authentication::weak_user &su)
 	tvfs_.set_backend(user->impersonator);
 	tvfs_.set_open_limits(user->session_open_limits);
 
-	session_limiter_.set_limits(user->session_inbound_limit, user->session_outbound_limit);
+	bandwidth_share_.set_class(
+		{ user->name, user->bandwidth_weight, user->limiter },
+		{ user->bandwidth_group, user->bandwidth_group_weight, user->bandwidth_group_limiter },
+		user->session_inbound_limit, user->session_outbound_limit
+	);
 	user_limiter_ = user->limiter;
 
 	update_limits(control_limiter_, &user->extra_limiters);
 	update_limits(data_limiter_, &user->extra_limiters);
 
 	extra_limiters_ = user->extra_limiters;
+
+	limiter_shards_.clear();
+	for (auto &l: extra_limiters_)
+		limiter_shards_.push_back(&l->get(event_loop_));
+
+	if (user_limiter_)
+		limiter_shards_.push_back(&user_limiter_->get(event_loop_));
 }
 
 void session::on_timer_event(timer_id id)
@@ -212,6 +228,11 @@ void session::stop_ongoing_user_authentication()
 	authenticator_.stop_ongoing_authentications(*this);
 }
 
+std::uint64_t session::get_session_id() const
+{
+	return get_id();
+}
+
 bool session::is_authenticated() const
 {
 	FZ_UTIL_THREAD_CHECK
@@ -335,19 +356,21 @@ void session::get_data_local_info(address_type family, bool do_resolve_hostname,
 		return handler.handle_data_local_info(std::pair{ data_listen_socket_->local_ip(), std::uint16_t(port) });
 	}
 
-	if (!hostname_lookup_)
-		hostname_lookup_ = std::make_unique<hostname_lookup>(pool_, *static_cast<event_handler*>(this));
-
-	hostname_lookup_->reset();
-
-	data_local_info_handler_ = &handler;
-	logger_.log(logmsg::debug_info, L"Looking up host '%s' for PASV mode.", opts_.pasv.host_override);
-	if (!hostname_lookup_->lookup(opts_.pasv.host_override, family)) {
-		logger_.log(logmsg::error, L"Host '%s' lookup failed.", opts_.pasv.host_override);
+	auto ip = hostname_cache_.lookup(opts_.pasv.host_override, family, *this);
+	if (!ip) {
+		logger_.log(logmsg::debug_info, L"Waiting for host '%s' to be resolved for PASV mode.", opts_.pasv.host_override);
+		data_local_info_handler_ = &handler;
+		return;
+	}
 
-		data_local_info_handler_ = nullptr;
+	int error;
+	int port = data_listen_socket_->local_port(error);
+	if (port < 0) {
+		logger_.log_u(logmsg::error, "data_listen_socket_->local_port() failed. Reason: %s.", socket_error_description(error));
 		return handler.handle_data_local_info(std::nullopt);
 	}
+
+	handler.handle_data_local_info(std::pair{std::move(*ip), std::uint16_t(port)});
 }
 
 bool session::set_data_peer_hostaddress(hostaddress h)
@@ -457,6 +480,7 @@ void session::notify_channel_socket_read_amount(const monotonic_clock &time_poin
 {
 	last_activity_ = time_point;
 
+	add_transferred(direction::inbound, amount - data_previous_read_amount_);
 	notifier_->notify_entry_write(1, amount - data_previous_read_amount_, -1);
 	data_previous_read_amount_ = amount;
 }
@@ -464,6 +488,7 @@ void session::notify_channel_socket_read_amount(const monotonic_clock &time_poin
 void session::notify_channel_socket_written_amount(const monotonic_clock &time_point, int64_t amount)
 {
 	last_activity_ = time_point;
+	add_transferred(direction::outbound, amount - data_previous_written_amount_);
 	notifier_->notify_entry_read(1, amount - data_previous_written_amount_, -1);
 	data_previous_written_amount_ = amount;
 }
@@ -795,30 +820,31 @@ void session::on_socket_event(fz::socket_event_source *source, fz::socket_event_
 	}
 }
 
-void session::on_hostname_lookup_event(hostname_lookup *, int error, const std::vector<std::string> &ips)
+void session::on_hostname_cache_result_event(const std::optional<std::string> &ip)
 {
-	assert(data_local_info_handler_ != nullptr && data_listen_socket_ != nullptr);
+	FZ_UTIL_THREAD_CHECK
+
+	if (!data_local_info_handler_)
+		return;
+
+	assert(data_listen_socket_ != nullptr);
 
 	auto &handler = *data_local_info_handler_;
 	data_local_info_handler_ = nullptr;
 
-	if (error) {
-		logger_.log(logmsg::error, L"Host '%s' lookup failed. Reason: %s.", opts_.pasv.host_override, socket_error_description(error));
-		return handler.handle_data_local_info(std::nullopt);
-	}
-
-	if (ips.empty()) {
-		logger_.log(logmsg::error, L"Host '%s' lookup returned no IPs.", opts_.pasv.host_override);
+	if (!ip) {
+		logger_.log(logmsg::error, L"Host '%s' lookup failed.", opts_.pasv.host_override);
 		return handler.handle_data_local_info(std::nullopt);
 	}
 
+	int error;
 	int port = data_listen_socket_->local_port(error);
 	if (port < 0) {
 		logger_.log_u(logmsg::error, "data_listen_socket_->local_port() failed. Reason: %s.", socket_error_description(error));
 		return handler.handle_data_local_info(std::nullopt);
 	}
 
-	handler.handle_data_local_info(std::pair{ips[0], std::uint16_t(port)});
+	handler.handle_data_local_info(std::pair{*ip, std::uint16_t(port)});
 }
 
 void session::on_channel_done_event(channel &ch [[maybe_unused]], channel::error_type error)
@@ -863,24 +889,39 @@ void session::operator()(const event_base &ev)
 {
 	FZ_UTIL_THREAD_CHECK
 
+	event_loop_monitor::dispatch_scope monitored(*this, ev, get_id());
+
 	dispatch<
 		socket_event,
 		channel::done_event,
 		authentication::authenticator::operation::result_event,
-		hostname_lookup_event,
+		tcp::hostname_cache::result_event,
 		authentication::shared_user_changed_event,
 		timer_event
 	>(ev, this,
 		&session::on_socket_event,
 		&session::on_channel_done_event,
 		&session::on_authenticator_operation_result,
-		&session::on_hostname_lookup_event,
+		&session::on_hostname_cache_result_event,
 		&session::on_shared_user_changed_event,
 		&session::on_timer_event
 	);
 }
 
-void session::update_limits(compound_rate_limited_layer *crll, std::vector<std::shared_ptr<rate_limiter>> *extra)
+void session::add_transferred(direction::type d, std::int64_t amount)
+{
+	bandwidth_share_.add_transferred(d, amount);
+
+	for (auto s: limiter_shards_)
+		s->add_transferred(d, amount);
+}
+
+rate_limiter *session::local_limiter(const std::shared_ptr<rate_limit::shared_limiter> &l)
+{
+	return l ? &l->get(event_loop_).limiter() : nullptr;
+}
+
+void session::update_limits(compound_rate_limited_layer *crll, std::vector<std::shared_ptr<rate_limit::shared_limiter>> *extra)
 {
 	FZ_UTIL_THREAD_CHECK
 
@@ -893,12 +934,12 @@ void session::update_limits(compound_rate_limited_layer *crll, std::vector<std::
 
 		while (our_it != extra_limiters_.end() && their_it != extra->end()) {
 			if (*our_it < *their_it) {
-				crll->remove_limiter(our_it->get());
+				crll->remove_limiter(local_limiter(*our_it));
 				++our_it;
 			}
 			else
 			if (*their_it < *our_it) {
-				crll->add_limiter(their_it->get());
+				crll->add_limiter(local_limiter(*their_it));
 				++their_it;
 			}
 			else {
@@ -908,19 +949,24 @@ void session::update_limits(compound_rate_limited_layer *crll, std::vector<std::
 		}
 
 		for (;our_it != extra_limiters_.end(); ++our_it)
-			crll->remove_limiter(our_it->get());
+			crll->remove_limiter(local_limiter(*our_it));
 
 		for (;their_it != extra->end(); ++their_it)
-			crll->add_limiter(their_it->get());
+			crll->add_limiter(local_limiter(*their_it));
 	}
 	else
 	for (auto &rl: extra_limiters_)
-		crll->add_limiter(rl.get());
+		crll->add_limiter(local_limiter(rl));
 
-	crll->add_limiter(user_limiter_.get());
+	crll->add_limiter(local_limiter(user_limiter_));
 	crll->add_limiter(&session_limiter_);
 }
 
+void session::add_control_transferred(direction::type d, std::int64_t amount)
+{
+	add_transferred(d, amount);
+}
+
 bool session::must_downgrade_log_level()
 {
 	return
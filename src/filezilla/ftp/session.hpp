@@ -11,6 +11,8 @@
 #include "../util/invoke_later.hpp"
 #include "../port_randomizer.hpp"
 #include "../logger/modularized.hpp"
+#include "../tcp/hostname_cache.hpp"
+#include "../rate_limit/fair_share_scheduler.hpp"
 
 #include "controller.hpp"
 #include "commander.hpp"
@@ -19,7 +21,6 @@
 namespace fz {
 
 class compound_rate_limited_layer;
-class hostname_lookup;
 
 }
 
@@ -91,7 +92,8 @@ public:
 	};
 
 	session(fz::thread_pool &pool, event_loop &loop, event_handler &target_event_handler,
-			rate_limit_manager &rate_limit_manager,
+			rate_limit::sharded_manager &rate_limit_manager,
+			rate_limit::fair_share_scheduler &bandwidth_scheduler,
 			std::unique_ptr<notifier> notifier,
 			id id,
 			datetime start,
@@ -100,6 +102,7 @@ public:
 			authentication::autobanner &autobanner,
 			authentication::authenticator &authenticator,
 			port_manager &port_manager,
+			tcp::hostname_cache &hostname_cache,
 			const commander::welcome_message &welcome_message,
 			const std::string &refuse_message,
 			options opts = {});
@@ -119,12 +122,16 @@ public:
 
 private:
 	protocol_info get_protocol_info() const;
-	void update_limits(compound_rate_limited_layer *crll, std::vector<std::shared_ptr<rate_limiter> > *extra = {});
+	void update_limits(compound_rate_limited_layer *crll, std::vector<std::shared_ptr<rate_limit::shared_limiter>> *extra = {});
+	rate_limiter *local_limiter(const std::shared_ptr<rate_limit::shared_limiter> &l);
+	void add_transferred(direction::type d, std::int64_t amount);
 	void do_set_buffer_sizes();
 
 	rate_limiter session_limiter_;
-	std::shared_ptr<rate_limiter> user_limiter_{};
-	std::vector<std::shared_ptr<rate_limiter>> extra_limiters_{};
+	rate_limit::fair_share_scheduler::leaf bandwidth_share_;
+	std::shared_ptr<rate_limit::shared_limiter> user_limiter_{};
+	std::vector<std::shared_ptr<rate_limit::shared_limiter>> extra_limiters_{};
+	std::vector<rate_limit::shared_limiter::shard *> limiter_shards_{};
 	compound_rate_limited_layer *control_limiter_{};
 	compound_rate_limited_layer *data_limiter_{};
 
@@ -137,6 +144,7 @@ private:
 	datetime start_datetime_;
 	securable_socket control_socket_;
 	port_manager &port_manager_;
+	tcp::hostname_cache &hostname_cache_;
 
 	options opts_;
 	std::int32_t receive_buffer_size_ = -1;
@@ -152,6 +160,7 @@ private:
 	// controller interface
 public:
 	fz::address_type get_control_socket_address_family() const override;
+	std::uint64_t get_session_id() const override;
 
 	void authenticate_user(std::string_view user, const authentication::methods_list &method, authenticate_user_response_handler *response_handler) override;
 	void stop_ongoing_user_authentication() override;
@@ -183,7 +192,6 @@ private:
 	int64_t data_previous_read_amount_{};
 	int64_t data_previous_written_amount_{};
 
-	std::unique_ptr<hostname_lookup> hostname_lookup_{};
 	controller::data_local_info_handler *data_local_info_handler_{};
 
 	hostaddress data_peer_hostaddress_{};
@@ -191,6 +199,7 @@ private:
 
 private:
 	bool must_downgrade_log_level() override;
+	void add_control_transferred(direction::type d, std::int64_t amount) override;
 
 private:
 	void notify_channel_socket_read_amount(const monotonic_clock &time_point, std::int64_t) override;
@@ -203,7 +212,7 @@ private:
 	void on_make_secure_event(controller::make_secure_response_handler *response_handler);
 	void on_channel_done_event(channel &, channel::error_type error);
 	void on_authenticator_operation_result(authentication::authenticator &, std::unique_ptr<authentication::authenticator::operation> &op);
-	void on_hostname_lookup_event(hostname_lookup*, int, const std::vector<std::string> &ips);
+	void on_hostname_cache_result_event(const std::optional<std::string> &ip);
 	void on_shared_user_changed_event(const authentication::weak_user &su);
 	void on_timer_event(timer_id id);
 
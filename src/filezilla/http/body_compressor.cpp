@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <utility>
+
+#include <zlib.h>
+
+#include <libfilezilla/string.hpp>
+
+#include "body_compressor.hpp"
+
+namespace fz::http {
+
+namespace {
+
+std::atomic<unsigned int> tickets_in_use{};
+
+unsigned int max_tickets()
+{
+	// Leave at least half of the cores to everything else.
+	static const unsigned int max = std::max(1u, std::thread::hardware_concurrency() / 2);
+	return max;
+}
+
+constexpr int compression_level = 5;
+constexpr std::size_t output_chunk_size = 64*1024;
+
+}
+
+body_compressor::ticket body_compressor::ticket::acquire(bool even_if_exhausted)
+{
+	ticket t;
+
+	if (even_if_exhausted) {
+		tickets_in_use.fetch_add(1, std::memory_order_relaxed);
+		t.acquired_ = true;
+		return t;
+	}
+
+	for (auto in_use = tickets_in_use.load(std::memory_order_relaxed); in_use < max_tickets();) {
+		if (tickets_in_use.compare_exchange_weak(in_use, in_use + 1, std::memory_order_relaxed)) {
+			t.acquired_ = true;
+			break;
+		}
+	}
+
+	return t;
+}
+
+body_compressor::ticket::ticket(ticket &&rhs) noexcept
+	: acquired_(std::exchange(rhs.acquired_, false))
+{
+}
+
+body_compressor::ticket &body_compressor::ticket::operator=(ticket &&rhs) noexcept
+{
+	if (this != &rhs) {
+		if (acquired_)
+			tickets_in_use.fetch_sub(1, std::memory_order_relaxed);
+
+		acquired_ = std::exchange(rhs.acquired_, false);
+	}
+
+	return *this;
+}
+
+body_compressor::ticket::~ticket()
+{
+	if (acquired_)
+		tickets_in_use.fetch_sub(1, std::memory_order_relaxed);
+}
+
+struct body_compressor::stream
+{
+	stream()
+	{
+		// 16 more window bits make zlib write the gzip header and trailer.
+		ok = deflateInit2(&zs, compression_level, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+	}
+
+	~stream()
+	{
+		if (ok)
+			deflateEnd(&zs);
+	}
+
+	bool deflate_into(const unsigned char *data, std::size_t size, fz::buffer &out, bool finish)
+	{
+		if (!ok)
+			return false;
+
+		zs.next_in = const_cast<unsigned char *>(data);
+		zs.avail_in = uInt(size);
+
+		int flush = finish ? Z_FINISH : Z_NO_FLUSH;
+
+		do {
+			zs.next_out = out.get(output_chunk_size);
+			zs.avail_out = uInt(output_chunk_size);
+
+			auto res = deflate(&zs, flush);
+			if (res != Z_OK && res != Z_STREAM_END && res != Z_BUF_ERROR)
+				return false;
+
+			out.add(output_chunk_size - zs.avail_out);
+		} while (zs.avail_out == 0);
+
+		return true;
+	}
+
+	z_stream zs{};
+	bool ok{};
+};
+
+body_compressor::body_compressor(adder_interface &to_compress, ticket t)
+	: to_compress_(to_compress)
+	, ticket_(std::move(t))
+	, stream_(std::make_unique<stream>())
+{
+	to_compress_.set_buffer(&uncompressed_buffer_);
+}
+
+body_compressor::~body_compressor()
+{
+}
+
+void body_compressor::set_event_handler(event_handler *eh)
+{
+	adder::set_event_handler(eh);
+	to_compress_.set_event_handler(eh);
+}
+
+int body_compressor::add_to_buffer()
+{
+	if (finished_)
+		return ENODATA;
+
+	if (!ticket_)
+		ticket_ = ticket::acquire(true);
+
+	int res = to_compress_.add_to_buffer();
+	if (res != 0 && res != ENODATA) {
+		// Nothing to compress for now.
+		ticket_ = {};
+		return res;
+	}
+
+	auto buffer = get_buffer();
+	if (!buffer)
+		return EFAULT;
+
+	auto uncompressed = uncompressed_buffer_.lock();
+
+	if (!stream_->deflate_into(uncompressed->get(), uncompressed->size(), *buffer, res == ENODATA))
+		return EFAULT;
+
+	uncompressed->clear();
+
+	if (res == ENODATA) {
+		finished_ = true;
+		stream_.reset();
+	}
+
+	// Until it's called again, the compressor is idle: hand the ticket to someone else meanwhile.
+	ticket_ = {};
+
+	return res;
+}
+
+bool body_compressor::is_compressible(std::string_view content_type)
+{
+	content_type = content_type.substr(0, content_type.find(';'));
+	content_type = fz::trimmed(content_type);
+
+	static constexpr std::string_view compressible[] = {
+		"application/javascript",
+		"application/json",
+		"application/ndjson",
+		"application/xml",
+		"image/svg+xml",
+	};
+
+	if (fz::starts_with<true>(content_type, std::string_view("text/")))
+		return true;
+
+	for (auto c: compressible) {
+		if (fz::equal_insensitive_ascii(content_type, c))
+			return true;
+	}
+
+	return false;
+}
+
+bool body_compressor::is_negotiable(std::string_view content_type, std::uint64_t size_of_body)
+{
+	if (size_of_body != unknown_size && (size_of_body < min_body_size || size_of_body > max_body_size))
+		return false;
+
+	return is_compressible(content_type);
+}
+
+bool body_compressor::compress(std::string_view in, fz::buffer &out)
+{
+	stream s;
+	return s.deflate_into(reinterpret_cast<const unsigned char *>(in.data()), in.size(), out, true);
+}
+
+}
@@ -0,0 +1,78 @@
+#ifndef FZ_HTTP_BODY_COMPRESSOR_HPP
+#define FZ_HTTP_BODY_COMPRESSOR_HPP
+
+#include <memory>
+
+#include "../buffer_operator/adder.hpp"
+
+namespace fz::http {
+
+/// \brief Compresses with gzip, on the fly, what the adder it wraps adds to the buffer.
+/// It can in turn be wrapped by the body_chunker.
+class body_compressor: public buffer_operator::adder
+{
+public:
+	/// Bodies smaller than this aren't worth the gzip header and trailer.
+	static inline constexpr std::uint64_t min_body_size = 1024;
+
+	/// Bodies bigger than this are never compressed on the fly, since the CPU they take is better spent elsewhere.
+	/// Bodies whose size isn't known in advance, like directory listings, are compressed anyway.
+	static inline constexpr std::uint64_t max_body_size = 8*1024*1024;
+
+	/// The size of the bodies that aren't known in advance.
+	static inline constexpr std::uint64_t unknown_size = std::uint64_t(-1);
+
+	/// \brief A permission to compress a body, of which only so many are granted at once across all the sessions.
+	/// This caps the CPU the server spends on compression: bodies for which no ticket is available are sent as they are.
+	/// A compressor holds its ticket only while it's at work, not while it waits for the client or for the data,
+	/// hence slow clients don't keep the others from having their bodies compressed.
+	class ticket
+	{
+	public:
+		ticket() = default;
+		ticket(ticket &&rhs) noexcept;
+		ticket &operator=(ticket &&rhs) noexcept;
+		~ticket();
+
+		/// \param even_if_exhausted makes the ticket granted even when the cap has been reached, still counting it:
+		/// a compressor that has started can't stop, but the bodies that come after it are then sent as they are.
+		static ticket acquire(bool even_if_exhausted = false);
+
+		explicit operator bool() const
+		{
+			return acquired_;
+		}
+
+	private:
+		bool acquired_{};
+	};
+
+	body_compressor(adder_interface &to_compress, ticket t);
+	~body_compressor() override;
+
+	void set_event_handler(event_handler *eh) override;
+	int add_to_buffer() override;
+
+	/// \returns whether bodies of the given content type compress well. Archives, media and binaries in general don't.
+	static bool is_compressible(std::string_view content_type);
+
+	/// \returns whether the compression of a 200 response, whose body has the given content type and size, is negotiated with the client:
+	/// such a response varies on Accept-Encoding, and so must the 304 that stands for it.
+	static bool is_negotiable(std::string_view content_type, std::uint64_t size_of_body);
+
+	/// Compresses all of \p in at once, appending it to \p out.
+	static bool compress(std::string_view in, fz::buffer &out);
+
+private:
+	struct stream;
+
+	buffer_operator::unsafe_locking_buffer uncompressed_buffer_;
+	adder_interface &to_compress_;
+	ticket ticket_;
+	std::unique_ptr<stream> stream_;
+	bool finished_{};
+};
+
+}
+
+#endif // FZ_HTTP_BODY_COMPRESSOR_HPP
@@ -0,0 +1,89 @@
+#include <libfilezilla/format.hpp>
+#include <libfilezilla/string.hpp>
+
+#include "entity_tag.hpp"
+
+namespace fz::http {
+
+entity_tag::entity_tag(std::string opaque, bool weak)
+	: opaque_(std::move(opaque))
+	, weak_(weak)
+{
+}
+
+entity_tag entity_tag::from_entry(std::uint64_t size, const datetime &mtime, bool weak, std::string_view variant)
+{
+	if (mtime.empty())
+		return {};
+
+	auto const mtime_ms = std::uint64_t(std::int64_t(mtime.get_time_t()) * 1000 + mtime.get_milliseconds());
+
+	if (variant.empty())
+		return { fz::sprintf("%x-%x", size, mtime_ms), weak };
+
+	return { fz::sprintf("%x-%x-%s", size, mtime_ms, variant), weak };
+}
+
+std::string entity_tag::to_string() const
+{
+	return fz::sprintf(weak_ ? "W/\"%s\"" : "\"%s\"", opaque_);
+}
+
+namespace {
+
+// Invokes f(opaque, weak) on each of the tags of a comma-separated list, until it returns true.
+template <typename F>
+bool any_tag_of(std::string_view list, F &&f)
+{
+	for (std::size_t pos = 0; pos < list.size();) {
+		if (auto c = list[pos]; c == ' ' || c == '\t' || c == ',') {
+			++pos;
+			continue;
+		}
+
+		bool weak = list.compare(pos, 2, "W/") == 0;
+		if (weak)
+			pos += 2;
+
+		if (pos >= list.size() || list[pos] != '"')
+			return false;
+
+		auto end = list.find('"', pos + 1);
+		if (end == list.npos)
+			return false;
+
+		if (f(list.substr(pos + 1, end - pos - 1), weak))
+			return true;
+
+		pos = end + 1;
+	}
+
+	return false;
+}
+
+}
+
+bool entity_tag::matches_any_of(std::string_view list) const
+{
+	if (opaque_.empty())
+		return false;
+
+	if (fz::trimmed(list) == "*")
+		return true;
+
+	return any_tag_of(list, [&](std::string_view opaque, bool) {
+		return opaque == opaque_;
+	});
+}
+
+bool entity_tag::strongly_matches(std::string_view value) const
+{
+	if (opaque_.empty() || weak_)
+		return false;
+
+	value = fz::trimmed(value);
+
+	return value.size() >= 2 && value.front() == '"' && value.back() == '"' && value.substr(1, value.size() - 2) == opaque_;
+}
+
+}
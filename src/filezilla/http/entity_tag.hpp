@@ -0,0 +1,52 @@
+#ifndef FZ_HTTP_ENTITY_TAG_HPP
+#define FZ_HTTP_ENTITY_TAG_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <libfilezilla/time.hpp>
+
+namespace fz::http {
+
+/// \brief An entity tag, as sent with the ETag header and compared against the ones in the If-None-Match and If-Range headers.
+class entity_tag
+{
+public:
+	entity_tag() = default;
+
+	/// \param opaque must be made only of visible ASCII characters other than the double quote.
+	entity_tag(std::string opaque, bool weak);
+
+	/// \brief The tag of a representation of an entry, made out of the entry's size and modification time.
+	/// \param variant tells apart different representations of the same entry, like the formats of a directory listing.
+	/// \returns an empty tag if \p mtime is empty, since the entry can't then be told apart from its later versions.
+	static entity_tag from_entry(std::uint64_t size, const datetime &mtime, bool weak = false, std::string_view variant = {});
+
+	explicit operator bool() const
+	{
+		return !opaque_.empty();
+	}
+
+	bool is_weak() const
+	{
+		return weak_;
+	}
+
+	/// \returns the tag in the form it's sent with the ETag header.
+	std::string to_string() const;
+
+	/// \returns whether any of the tags in the value of an If-None-Match header match this one, using the weak comparison. "*" matches any tag.
+	bool matches_any_of(std::string_view list) const;
+
+	/// \returns whether the value of an If-Range header is this very tag, using the strong comparison: weak tags never match.
+	bool strongly_matches(std::string_view value) const;
+
+private:
+	std::string opaque_;
+	bool weak_{};
+};
+
+}
+
+#endif // FZ_HTTP_ENTITY_TAG_HPP
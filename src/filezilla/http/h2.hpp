@@ -0,0 +1,123 @@
+#ifndef FZ_HTTP_H2_HPP
+#define FZ_HTTP_H2_HPP
+
+#include <cstdint>
+#include <string_view>
+
+#include <libfilezilla/buffer.hpp>
+
+/*
+ * The framing layer of HTTP/2, as per RFC 9113.
+ */
+
+namespace fz::http::h2 {
+
+/// What a client sends first on a connection, before any frame.
+inline constexpr std::string_view preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+enum class frame_type: std::uint8_t
+{
+	data = 0x0,
+	headers = 0x1,
+	priority = 0x2,
+	rst_stream = 0x3,
+	settings = 0x4,
+	push_promise = 0x5,
+	ping = 0x6,
+	goaway = 0x7,
+	window_update = 0x8,
+	continuation = 0x9
+};
+
+namespace flags {
+
+inline constexpr std::uint8_t end_stream = 0x1;
+inline constexpr std::uint8_t ack = 0x1;
+inline constexpr std::uint8_t end_headers = 0x4;
+inline constexpr std::uint8_t padded = 0x8;
+inline constexpr std::uint8_t priority = 0x20;
+
+}
+
+enum class error_code: std::uint32_t
+{
+	no_error = 0x0,
+	protocol_error = 0x1,
+	internal_error = 0x2,
+	flow_control_error = 0x3,
+	settings_timeout = 0x4,
+	stream_closed = 0x5,
+	frame_size_error = 0x6,
+	refused_stream = 0x7,
+	cancel = 0x8,
+	compression_error = 0x9,
+	connect_error = 0xa,
+	enhance_your_calm = 0xb,
+	inadequate_security = 0xc,
+	http_1_1_required = 0xd
+};
+
+enum class setting: std::uint16_t
+{
+	header_table_size = 0x1,
+	enable_push = 0x2,
+	max_concurrent_streams = 0x3,
+	initial_window_size = 0x4,
+	max_frame_size = 0x5,
+	max_header_list_size = 0x6
+};
+
+inline constexpr std::uint32_t default_window_size = 65535;
+inline constexpr std::uint32_t max_window_size = 0x7fffffff;
+inline constexpr std::uint32_t default_max_frame_size = 16384;
+inline constexpr std::uint32_t max_max_frame_size = 0xffffff;
+
+struct frame_header
+{
+	static constexpr std::size_t size = 9;
+
+	std::uint32_t length{};
+	frame_type type{};
+	std::uint8_t flags{};
+	std::uint32_t stream_id{};
+
+	/// Parses the first frame_header::size bytes of \p p.
+	static frame_header parse(const unsigned char *p)
+	{
+		frame_header h;
+
+		h.length = std::uint32_t(p[0]) << 16 | std::uint32_t(p[1]) << 8 | std::uint32_t(p[2]);
+		h.type = frame_type(p[3]);
+		h.flags = p[4];
+		h.stream_id = (std::uint32_t(p[5]) << 24 | std::uint32_t(p[6]) << 16 | std::uint32_t(p[7]) << 8 | std::uint32_t(p[8])) & 0x7fffffff;
+
+		return h;
+	}
+
+	void append_to(fz::buffer &out) const
+	{
+		out.append(std::uint8_t(length >> 16));
+		out.append(std::uint8_t(length >> 8));
+		out.append(std::uint8_t(length));
+		out.append(std::uint8_t(type));
+		out.append(flags);
+		append_uint32(out, stream_id);
+	}
+
+	static void append_uint32(fz::buffer &out, std::uint32_t v)
+	{
+		out.append(std::uint8_t(v >> 24));
+		out.append(std::uint8_t(v >> 16));
+		out.append(std::uint8_t(v >> 8));
+		out.append(std::uint8_t(v));
+	}
+
+	static std::uint32_t parse_uint32(const unsigned char *p)
+	{
+		return std::uint32_t(p[0]) << 24 | std::uint32_t(p[1]) << 16 | std::uint32_t(p[2]) << 8 | std::uint32_t(p[3]);
+	}
+};
+
+}
+
+#endif // FZ_HTTP_H2_HPP
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <map>
+
 #include <libfilezilla/json.hpp>
 #include <libfilezilla/encryption.hpp>
 
@@ -10,6 +13,17 @@
 namespace fz::http::handlers
 {
 
+namespace {
+
+// How many bearers each worker remembers at most.
+constexpr std::size_t max_cached_bearers = 1024;
+
+// How often the workers drop what's no longer valid from their cache. The entries keep the users and their custom data alive,
+// which otherwise would linger for as long as nobody asked for the same bearer again.
+constexpr auto cache_purge_interval = duration::from_seconds(30);
+
+}
+
 struct authorizator::worker: event_handler
 {
 	using continuation_type = std::function<void(authentication::session_user session_user)>;
@@ -18,6 +32,7 @@ struct authorizator::worker: event_handler
 		: event_handler(loop)
 		, a_(a)
 	{
+		add_timer(cache_purge_interval, false);
 	}
 
 	void authenticate(std::string_view username, std::string_view password, http::server::request &req, http::server::shared_transaction t, continuation_type continuation)
@@ -42,7 +57,89 @@ struct authorizator::worker: event_handler
 		remove_handler();
 	}
 
+	// The cache is only ever accessed from the loop of the worker, hence it needs no locking.
+	std::optional<authorization_data<>> get_cached(std::string_view bearer, custom_authorization_data_factory *adf)
+	{
+		auto it = cache_.find(bearer);
+		if (it == cache_.end()) {
+			return std::nullopt;
+		}
+
+		auto &e = it->second;
+
+		if (!e.is_valid(monotonic_clock::now())) {
+			cache_.erase(it);
+			return std::nullopt;
+		}
+
+		auto cit = std::find_if(e.custom.begin(), e.custom.end(), [adf](auto &c) { return c.first == adf; });
+		if (cit == e.custom.end()) {
+			return std::nullopt;
+		}
+
+		return authorization_data<>{ e.id, e.user, cit->second };
+	}
+
+	/// Must be called with the mutex of the shard locked, the same lock \p data has been got with.
+	void cache(std::string_view bearer, custom_authorization_data_factory *adf, const authorization &a, const authorization_data<> &data)
+	{
+		auto &s = a.get_shard();
+		auto generation = s.generation_.load(std::memory_order_acquire);
+
+		auto it = cache_.find(bearer);
+
+		if (it != cache_.end() && (it->second.generation != generation || it->second.origin != &s)) {
+			cache_.erase(it);
+			it = cache_.end();
+		}
+
+		if (it == cache_.end()) {
+			if (cache_.size() >= max_cached_bearers) {
+				purge();
+
+				// All still valid: they're just too many, start over.
+				if (cache_.size() >= max_cached_bearers) {
+					cache_.clear();
+				}
+			}
+
+			it = cache_.emplace(std::string(bearer), entry{ &s, generation, a.get_expiration(), data.id, data.user, {} }).first;
+		}
+
+		it->second.custom.emplace_back(adf, data.custom);
+	}
+
 private:
+	struct entry
+	{
+		const shard *origin;
+		std::uint64_t generation;
+		monotonic_clock expiration;
+
+		std::size_t id;
+		authentication::shared_user user;
+		std::vector<std::pair<custom_authorization_data_factory *, std::shared_ptr<void>>> custom;
+
+		bool is_valid(const monotonic_clock &now) const
+		{
+			return now < expiration && origin->generation_.load(std::memory_order_acquire) == generation;
+		}
+	};
+
+	void purge()
+	{
+		auto now = monotonic_clock::now();
+
+		for (auto it = cache_.begin(); it != cache_.end();) {
+			if (it->second.is_valid(now)) {
+				++it;
+			}
+			else {
+				it = cache_.erase(it);
+			}
+		}
+	}
+
 	void on_auth_result(authentication::authenticator &, std::unique_ptr<authentication::authenticator::operation> &op)
 	{
 		auto session_user = authentication::session_user(std::move(op), a_.logger_);
@@ -66,18 +163,28 @@ private:
 		continuation_ = nullptr;
 	}
 
+	void on_timer(timer_id)
+	{
+		purge();
+	}
+
 	void operator()(const event_base &ev) override
 	{
 		fz::dispatch<
-			authentication::authenticator::operation::result_event
+			authentication::authenticator::operation::result_event,
+			timer_event
 		>(ev, this,
-			&worker::on_auth_result
+			&worker::on_auth_result,
+			&worker::on_timer
 		);
 	}
 
 	authorizator &a_;
 	http::server::shared_transaction t_{};
 	continuation_type continuation_{};
+
+	// From the raw bearer to what it's been validated to.
+	std::map<std::string, entry, std::less<>> cache_;
 };
 
 authorizator::authorizator(event_loop &loop, authentication::authenticator &auth, authentication::token_manager &tm, logger_interface &logger)
@@ -86,9 +193,8 @@ authorizator::authorizator(event_loop &loop, authentication::authenticator &auth
 	, auth_(auth)
 	, tm_(tm)
 	, logger_(logger, "Authorizator")
-	, authorizations_p_(std::make_unique<std::unordered_map<std::size_t, authorization>>())
+	, shards_(std::make_unique<shard[]>(shard_count))
 	, workers_p_(std::make_unique<std::unordered_map<event_loop *, worker>>())
-	, authorizations_(*authorizations_p_)
 	, workers_(*workers_p_)
 {}
 
@@ -97,6 +203,18 @@ authorizator::~authorizator()
 	remove_handler();
 }
 
+authorizator::shard &authorizator::get_shard(std::uint64_t access_id)
+{
+	return shards_[access_id % shard_count];
+}
+
+authorizator::worker &authorizator::get_worker(event_loop &loop)
+{
+	scoped_lock lock(mutex_);
+
+	return workers_.try_emplace(&loop, *this, loop).first->second;
+}
+
 std::optional<std::string_view> authorizator::get_access_token_bearer(server::request &req)
 {
 	auto bearer = [](std::string_view authorization) -> field::component_view {
@@ -154,15 +272,17 @@ util::locked_proxy<authorizator::authorization> authorizator::get_authorization(
 
 util::locked_proxy<authorizator::authorization> authorizator::get_authorization(const authentication::access_token &access_token)
 {
-	mutex_.lock();
+	auto &s = get_shard(access_token.id);
+
+	s.mutex_.lock();
 
-	auto it = authorizations_.find(access_token.id);
-	if (it == authorizations_.end() || access_token != it->second.get_refresh_token().access) {
-		mutex_.unlock();
+	auto it = s.authorizations_.find(access_token.id);
+	if (it == s.authorizations_.end() || access_token != it->second.get_refresh_token().access) {
+		s.mutex_.unlock();
 		return {};
 	}
 
-	return {&it->second, &mutex_};
+	return {&it->second, &s.mutex_};
 }
 
 util::locked_proxy<authorizator::authorization> authorizator::make_authorization(authentication::session_user session_user, authentication::refresh_token refresh_token)
@@ -185,22 +305,24 @@ util::locked_proxy<authorizator::authorization> authorizator::make_authorization
 		return {};
 	}
 
-	mutex_.lock();
+	auto access_id = refresh_token.access.id;
+	auto &s = get_shard(access_id);
+
+	s.mutex_.lock();
 	logger_.log(logmsg::debug_info, L"Authorization for user %s with id (%d, %d) created.", refresh_token.username, refresh_token.access.id, refresh_token.access.refresh_id);
 
-	auto access_id = refresh_token.access.id;
-	auto res = authorizations_.try_emplace(access_id, std::move(session_user), std::move(refresh_token), *this);
+	auto res = s.authorizations_.try_emplace(access_id, std::move(session_user), std::move(refresh_token), *this, s);
 
 	if (!res.second) {
 		logger_.log(logmsg::error, L"Couldn't store the authorization for user %s. This is an internal error.", refresh_token.username);
 		tm_.destroy(refresh_token);
 
-		mutex_.unlock();
+		s.mutex_.unlock();
 		return {};
 	}
 
 
-	return {&res.first->second, &mutex_};
+	return {&res.first->second, &s.mutex_};
 }
 
 std::optional<authorizator::authorization_data<>> authorizator::get_authorization_data(const server::shared_transaction &t, custom_authorization_data_factory *adf)
@@ -210,14 +332,26 @@ std::optional<authorizator::authorization_data<>> authorizator::get_authorizatio
 		return std::nullopt;
 	}
 
-	auto ret = [&]() -> std::optional<authorizator::authorization_data<>> {
-		auto authorization = get_authorization(*bearer);
-		if (!authorization) {
-			return std::nullopt;
-		}
+	// Parallel requests of the same client carry the same bearer: those that follow the first one neither decrypt it nor lock anything.
+	auto &w = get_worker(t->get_event_loop());
 
-		return authorization->get_data(adf);
-	}();
+	auto ret = w.get_cached(*bearer, adf);
+
+	if (!ret) {
+		ret = [&]() -> std::optional<authorizator::authorization_data<>> {
+			auto authorization = get_authorization(*bearer);
+			if (!authorization) {
+				return std::nullopt;
+			}
+
+			auto data = authorization->get_data(adf);
+			if (data) {
+				w.cache(*bearer, adf, *authorization, *data);
+			}
+
+			return data;
+		}();
+	}
 
 	if (!ret) {
 		auto &res = t->res();
@@ -245,7 +379,7 @@ void authorizator::authorize(const authentication::refresh_token &refresh_token,
 		return continuation(std::move(ret));
 	}
 
-	workers_.try_emplace(&loop, *this, loop).first->second.authenticate(refresh_token, req, nullptr,
+	get_worker(loop).authenticate(refresh_token, req, nullptr,
 	[this, adf, refresh_token, continuation = std::move(continuation)](authentication::session_user session_user) mutable {
 		if (auto authorization = make_authorization(std::move(session_user), std::move(refresh_token))) {
 			continuation(authorization->get_data(adf));
@@ -266,10 +400,20 @@ void authorizator::set_timeouts(duration access_token_timeout, duration refresh_
 
 void authorizator::reset()
 {
-	scoped_lock lock(mutex_);
-
 	logger_.log(logmsg::debug_info, L"Revoking all authorizations.");
-	authorizations_.clear();
+
+	for (std::size_t i = 0; i < shard_count; ++i) {
+		auto &s = shards_[i];
+
+		// Destroyed only once the lock is released.
+		decltype(s.authorizations_) removed;
+
+		scoped_lock lock(s.mutex_);
+		s.generation_.fetch_add(1, std::memory_order_release);
+		removed.swap(s.authorizations_);
+	}
+
+	scoped_lock lock(mutex_);
 	tm_.reset();
 }
 
@@ -403,8 +547,13 @@ void authorizator::do_revoke(query_string q, const server::shared_transaction &t
 	}();
 
 	if (access_token) {
-		scoped_lock lock(mutex_);
-		if (authorizations_.erase(access_token.id)) {
+		auto &s = get_shard(access_token.id);
+
+		shard::removed removed;
+
+		scoped_lock lock(s.mutex_);
+		if ((removed = s.authorizations_.extract(access_token.id))) {
+			s.generation_.fetch_add(1, std::memory_order_release);
 			logger_.log(logmsg::debug_info, L"Revoked access token with id (%d,%d).", access_token.id, access_token.refresh_id);
 		}
 	}
@@ -437,7 +586,7 @@ void authorizator::do_token_password(std::string username, std::string password,
 		return send_auth_error(res, "invalid_request", "username empty or absent");
 	}
 
-	workers_.try_emplace(&t->get_event_loop(), *this, t->get_event_loop()).first->second.authenticate(std::move(username), std::move(password), req, t,
+	get_worker(t->get_event_loop()).authenticate(std::move(username), std::move(password), req, t,
 	[=](authentication::session_user session_user) {
 		auto authorization = make_authorization(std::move(session_user));
 		send_auth_tokens(std::move(authorization), std::move(cookie_path), t);
@@ -462,7 +611,7 @@ void authorizator::do_token_refresh(std::string bearer, std::string cookie_path,
 		return send_auth_error(t->res(), "invalid_request", "refresh token corrupted or absent");
 	}
 
-	workers_.try_emplace(&t->get_event_loop(), *this, t->get_event_loop()).first->second.authenticate(refresh_token, req, t,
+	get_worker(t->get_event_loop()).authenticate(refresh_token, req, t,
 	[this, refresh_token, cookie_path=std::move(cookie_path), t](authentication::session_user session_user) {
 		auto authorization = get_authorization(refresh_token.access);
 		if (authorization) {
@@ -539,12 +688,17 @@ void authorizator::send_auth_tokens(util::locked_proxy<authorization> authorizat
 void authorizator::operator()(const event_base &ev)
 {
 	fz::dispatch<authorization::expired_event>(ev, [&](authorization &a) {
-		scoped_lock lock(mutex_);
+		auto &s = a.get_shard();
+
+		shard::removed removed;
+
+		scoped_lock lock(s.mutex_);
 
 		auto access_token = a.get_refresh_token().access;
 
 		logger_.log_u(logmsg::debug_info, L"Erasing authorization with id (%d, %d).", access_token.id, access_token.refresh_id);
-		authorizations_.erase(access_token.id);
+		s.generation_.fetch_add(1, std::memory_order_release);
+		removed = s.authorizations_.extract(access_token.id);
 	});
 }
 
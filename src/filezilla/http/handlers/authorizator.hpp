@@ -70,6 +70,13 @@ public:
 
 private:
 	struct worker;
+	struct shard;
+
+	/// The authorizations are spread among this many shards, by id, each with a mutex of its own.
+	static constexpr std::size_t shard_count = 16;
+
+	[[nodiscard]] shard &get_shard(std::uint64_t access_id);
+	[[nodiscard]] worker &get_worker(event_loop &loop);
 
 	[[nodiscard]] std::optional<std::string_view> get_access_token_bearer(server::request &req);
 	[[nodiscard]] util::locked_proxy<authorization> get_authorization(std::string_view bearer);
@@ -88,6 +95,7 @@ private:
 	void do_revoke(query_string q, const server::shared_transaction &t);
 	void handle_transaction(const server::shared_transaction &t) override;
 
+	// Guards the timeouts and the workers. The authorizations are guarded by the mutexes of their shards.
 	mutable mutex mutex_;
 
 	symmetric_key key_;
@@ -96,10 +104,9 @@ private:
 
 	logger::modularized logger_;
 
-	std::unique_ptr<std::unordered_map<std::size_t, authorization>> authorizations_p_;
+	std::unique_ptr<shard[]> shards_;
 	std::unique_ptr<std::unordered_map<event_loop *, worker>> workers_p_;
 
-	std::unordered_map<std::size_t, authorization> &authorizations_;
 	std::unordered_map<event_loop *, worker> &workers_;
 
 	duration access_token_timeout_ = duration::from_seconds(300);
@@ -3,9 +3,10 @@
 namespace fz::http::handlers
 {
 
-authorizator::authorization::authorization(authentication::session_user session_user, authentication::refresh_token refresh_token, authorizator &owner)
+authorizator::authorization::authorization(authentication::session_user session_user, authentication::refresh_token refresh_token, authorizator &owner, shard &shard)
 	: event_handler(owner.event_loop_)
 	, owner_(owner)
+	, shard_(shard)
 {
 	set(std::move(session_user), std::move(refresh_token));
 }
@@ -18,7 +19,7 @@ authorizator::authorization::~authorization()
 
 std::optional<authorizator::authorization_data<>> authorizator::authorization::get_data(custom_authorization_data_factory *adf)
 {
-	scoped_lock lock(owner_.mutex_);
+	scoped_lock lock(shard_.mutex_);
 
 	if (!refresh_token_) {
 		return std::nullopt;
@@ -67,9 +68,10 @@ void authorizator::authorization::set_session_user(authentication::session_user
 
 void authorizator::authorization::set(authentication::session_user session_user, authentication::refresh_token refresh_token)
 {
-	scoped_lock lock(owner_.mutex_);
+	scoped_lock lock(shard_.mutex_);
 
 	stop_timer(std::exchange(timer_id_, 0));
+	invalidate();
 
 	if (!session_user) {
 		owner_.logger_.log_u(logmsg::debug_info, L"Authorization with id (%d,%d) for user [%s] has been nullified.", refresh_token_.access.id, refresh_token_.access.refresh_id, refresh_token_.username);
@@ -87,19 +89,32 @@ void authorizator::authorization::set(authentication::session_user session_user,
 	session_user_ = std::move(session_user);
 	subscribe(session_user_, *this);
 
-	timer_id_ = add_timer(owner_.access_token_timeout_, true);
-	return;
+	auto timeout = [&] {
+		scoped_lock lock(owner_.mutex_);
+		return owner_.access_token_timeout_;
+	}();
+
+	timer_id_ = add_timer(timeout, true);
+	expiration_ = monotonic_clock::now() + timeout;
 }
 
 void authorizator::authorization::expire()
 {
+	scoped_lock lock(shard_.mutex_);
+
 	stop_timer(std::exchange(timer_id_, 0));
+	invalidate();
 
 	unsubscribe(session_user_, *this);
 
 	owner_.send_persistent_event(&expired_event_);
 }
 
+void authorizator::authorization::invalidate()
+{
+	shard_.generation_.fetch_add(1, std::memory_order_release);
+}
+
 void authorizator::authorization::operator()(const event_base &ev)
 {
 	fz::dispatch<
@@ -123,6 +138,11 @@ void authorizator::authorization::on_user_changed(authentication::weak_user &wu)
 		if (auto u = su->lock()) {
 			if (u->id.empty()) {
 				owner_.logger_.log_u(logmsg::debug_info, L"Authorization with id (%d,%d) for user [%s] has been terminated.", refresh_token_.access.id, refresh_token_.access.refresh_id, refresh_token_.username);
+
+				// The cached copies must not outlive the user, even for as long as it takes for the event to be processed.
+				// No need to lock the shard for that, the generation is atomic.
+				invalidate();
+
 				owner_.send_persistent_event(&expired_event_);
 			}
 		}
@@ -1,6 +1,8 @@
 #ifndef FZ_HTTP_HANDLERS_AUTHORIZATOR_AUTHORIZATION_HPP
 #define FZ_HTTP_HANDLERS_AUTHORIZATOR_AUTHORIZATION_HPP
 
+#include <atomic>
+
 #include "../authorizator.hpp"
 
 namespace fz::http::handlers
@@ -10,7 +12,7 @@ struct authorizator::authorization: protected event_handler
 {
 	using expired_event = simple_event<authorization, authorization &>;
 
-	authorization(authentication::session_user session_user, authentication::refresh_token refresh_token, authorizator &owner);
+	authorization(authentication::session_user session_user, authentication::refresh_token refresh_token, authorizator &owner, shard &shard);
 	authorization(authorization &&) = delete;
 
 	~authorization() override;
@@ -22,6 +24,17 @@ struct authorizator::authorization: protected event_handler
 		return refresh_token_;
 	}
 
+	shard &get_shard() const
+	{
+		return shard_;
+	}
+
+	/// When the access token is due to expire, unless refreshed before.
+	const monotonic_clock &get_expiration() const
+	{
+		return expiration_;
+	}
+
 	void set_session_user(authentication::session_user session_user);
 
 private:
@@ -33,16 +46,34 @@ private:
 	void on_timer(timer_id);
 	void on_user_changed(authentication::weak_user &u);
 
+	void invalidate();
+
 	expired_event expired_event_{*this};
 	authorizator &owner_;
+	shard &shard_;
 
 	authentication::refresh_token refresh_token_{};
 	authentication::session_user session_user_{};
 	timer_id timer_id_{};
+	monotonic_clock expiration_{};
 
 	std::unordered_map<custom_authorization_data_factory*, std::shared_ptr<void>> data_;
 };
 
+struct authorizator::shard
+{
+	mutable mutex mutex_;
+	std::unordered_map<std::size_t, authorization> authorizations_;
+
+	/// Bumped whenever any of the authorizations of the shard changes or goes away.
+	/// What the workers have cached from the shard is valid only as long as this stays the same.
+	std::atomic<std::uint64_t> generation_{};
+
+	/// Authorizations must never be destroyed with the mutex locked: their destructor waits for their handler,
+	/// which may itself be waiting for the mutex. Hence they're taken out of the map first, and destroyed once it's unlocked.
+	using removed = decltype(authorizations_)::node_type;
+};
+
 }
 
 #endif // FZ_HTTP_HANDLERS_AUTHORIZATOR_AUTHORIZATION_HPP
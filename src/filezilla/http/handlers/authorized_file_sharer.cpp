@@ -137,7 +137,10 @@ authorized_file_sharer::authorized_file_sharer(authorizator &auth, logger_interf
 
 std::shared_ptr<void> authorized_file_sharer::make_custom_authorization_data()
 {
-	return std::make_shared<custom_authorization_data>(logger_, opts_);
+	auto c = std::make_shared<custom_authorization_data>(logger_, opts_);
+	c->fs.set_tvfs_owner(c);
+
+	return c;
 }
 
 void authorized_file_sharer::handle_transaction(const server::shared_transaction &t)
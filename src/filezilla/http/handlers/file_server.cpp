@@ -1,7 +1,16 @@
+#include <algorithm>
 #include <map>
+#include <optional>
+
+#include <libfilezilla/encode.hpp>
+#include <libfilezilla/hash.hpp>
+#include <libfilezilla/util.hpp>
 
 #include "file_server.hpp"
 #include "../server/responder.hpp"
+#include "../body_compressor.hpp"
+#include "../resumable_upload.hpp"
+#include "../zip_archiver.hpp"
 
 #include "../../strresult.hpp"
 #include "../../string.hpp"
@@ -121,26 +130,217 @@ field::value file_server::negotiate_content_type(server::request &req, server::r
 
 result file_server::send_file(server::request &req, server::responder &res, std::string_view path)
 {
+	auto mime = mime_from_name(req.headers.get(headers::X_FZ_INT_File_Name, path));
+	auto rep = select_representation(req, path);
+
+	// A client revalidating its copy gets its answer from the metadata alone, without the file being opened at all.
+	if (req.headers.get(headers::If_None_Match) || req.headers.get(headers::If_Modified_Since)) {
+		auto entry = tvfs_.get_entry(rep.path);
+
+		if (entry.first && entry.second.is_file() && (entry.second.perms() & tvfs::permissions::read)) {
+			auto &mtime = entry.second.mtime();
+			auto etag = entity_tag::from_entry(std::uint64_t(std::max(entry.second.size(), tvfs::entry_size(0))), mtime, false, rep.encoding);
+
+			if (is_not_modified(req, etag, mtime)) {
+				if (negotiate_content_type(req, res, {mime})) {
+					// Files are served with byte ranges, hence never compressed on the fly.
+					send_not_modified(res, path, etag, mtime, false);
+				}
+
+				return entry.first;
+			}
+		}
+	}
+
 	tvfs::file_holder file;
-	auto result = tvfs_.open_file(file, path, file::reading, 0);
+	auto result = tvfs_.open_file(file, rep.path, file::reading, 0);
 
 
 	if (result) {
-		auto content_type = negotiate_content_type(req, res, {mime_from_name(req.headers.get(headers::X_FZ_INT_File_Name, path))});
+		auto content_type = negotiate_content_type(req, res, {mime});
 
 		if (content_type) {
-			res.send_status(200, "Ok") &&
-			res.send_header(http::headers::Content_Type, content_type) &&
-			res.send_header(http::headers::Last_Modified, file->get_modification_time().get_rfc822()) &&
-			res.send_header(http::headers::Vary, http::headers::Accept) &&
-			send_disposition_header(req, res) &&
-			res.send_body(std::move(file));
+			auto size = std::uint64_t(std::max(file->size(), std::int64_t(0)));
+			auto mtime = file->get_modification_time();
+			auto etag = entity_tag::from_entry(size, mtime, false, rep.encoding);
+
+			byte_ranges ranges;
+			auto ranges_result = byte_ranges::ignored;
+
+			// Ranges only apply to GET, and only if the file is still the one the client got the other parts of.
+			if (auto range = req.headers.get(headers::Range); range && req.method == "GET" && if_range_matches(req, etag, mtime)) {
+				ranges_result = ranges.parse(range, size);
+			}
+
+			if (ranges_result == byte_ranges::unsatisfiable) {
+				res.send_status(416, "Range Not Satisfiable") &&
+				res.send_header(http::headers::Content_Range, fz::sprintf("bytes */%d", size)) &&
+				res.send_end();
+			}
+			else
+			if (ranges_result == byte_ranges::satisfiable) {
+				std::string boundary;
+
+				if (ranges.size() > 1) {
+					boundary = fz::hex_encode<std::string>(fz::random_bytes(16));
+				}
+
+				res.send_status(206, "Partial Content") && [&] {
+					if (ranges.size() == 1) {
+						return
+							res.send_header(http::headers::Content_Type, content_type) &&
+							res.send_header(http::headers::Content_Range, ranges.front().content_range(size));
+					}
+
+					return res.send_header(http::headers::Content_Type, fz::sprintf("multipart/byteranges; boundary=%s", boundary));
+				}() &&
+				res.send_header(http::headers::Accept_Ranges, "bytes") &&
+				(rep.encoding.empty() || res.send_header(http::headers::Content_Encoding, rep.encoding)) &&
+				send_validators(res, path, etag, mtime) &&
+				res.send_header(http::headers::Vary, vary()) &&
+				send_disposition_header(req, res) &&
+				res.send_body(std::move(file), ranges, boundary, content_type);
+			}
+			else {
+				res.send_status(200, "Ok") &&
+				res.send_header(http::headers::Content_Type, content_type) &&
+				res.send_header(http::headers::Accept_Ranges, "bytes") &&
+				(rep.encoding.empty() || res.send_header(http::headers::Content_Encoding, rep.encoding)) &&
+				send_validators(res, path, etag, mtime) &&
+				res.send_header(http::headers::Vary, vary()) &&
+				send_disposition_header(req, res) &&
+				res.send_body(std::move(file));
+			}
 		}
 	}
 
 	return result;
 }
 
+file_server::representation file_server::select_representation(server::request &req, std::string_view path)
+{
+	static constexpr std::pair<std::string_view, std::string_view> siblings[] = {
+		{ "br", ".br" },
+		{ "gzip", ".gz" }
+	};
+
+	if (opts_.precompressed()) {
+		for (auto &[encoding, extension]: siblings) {
+			if (!req.headers.accepts_encoding(encoding)) {
+				continue;
+			}
+
+			auto sibling = std::string(path).append(extension);
+
+			if (auto entry = tvfs_.get_entry(sibling); entry.first && entry.second.is_file()) {
+				return { std::move(sibling), encoding };
+			}
+		}
+	}
+
+	return { std::string(path), {} };
+}
+
+field::value_view file_server::vary(bool negotiates_compression) const
+{
+	if (opts_.precompressed() || negotiates_compression) {
+		return "Accept, Accept-Encoding";
+	}
+
+	return http::headers::Accept;
+}
+
+bool file_server::if_range_matches(server::request &req, const entity_tag &etag, const datetime &mtime)
+{
+	auto if_range = req.headers.get(headers::If_Range);
+	if (!if_range) {
+		return true;
+	}
+
+	if (std::string_view(if_range).find('"') != std::string_view::npos) {
+		return etag.strongly_matches(if_range);
+	}
+
+	datetime date;
+	if (mtime.empty() || !date.set_rfc822(if_range)) {
+		return false;
+	}
+
+	// Last-Modified is sent with a resolution of one second.
+	return date == datetime(mtime.get_time_t(), datetime::seconds);
+}
+
+entity_tag file_server::listing_tag(const std::vector<tvfs::entry> &entries, std::string_view next_cursor, std::string_view variant, const datetime &dir_mtime, datetime &latest)
+{
+	hash_accumulator acc(hash_algorithm::md5);
+	latest = dir_mtime;
+
+	for (auto &e: entries) {
+		auto &mtime = e.mtime();
+		auto mtime_ms = mtime.empty() ? std::int64_t(-1) : std::int64_t(mtime.get_time_t()) * 1000 + mtime.get_milliseconds();
+
+		// Names can't contain slashes, hence nothing here can be mistaken for something else.
+		acc.update(fz::sprintf("%s/%d/%d/%d\n", e.name(), int(e.type()), e.size(), mtime_ms));
+
+		if (!mtime.empty() && (latest.empty() || latest < mtime)) {
+			latest = mtime;
+		}
+	}
+
+	acc.update(next_cursor);
+
+	return { fz::sprintf("%s-%s", hex_encode<std::string>(acc.digest()), variant), true };
+}
+
+bool file_server::is_not_modified(server::request &req, const entity_tag &etag, const datetime &mtime)
+{
+	// If-Modified-Since is only looked at when If-None-Match is missing, since entity tags are the more precise of the two.
+	if (auto if_none_match = req.headers.get(headers::If_None_Match)) {
+		return etag.matches_any_of(if_none_match);
+	}
+
+	if (auto if_modified_since = req.headers.get(headers::If_Modified_Since)) {
+		datetime date;
+		if (mtime.empty() || !date.set_rfc822(if_modified_since)) {
+			return false;
+		}
+
+		return datetime(mtime.get_time_t(), datetime::seconds) <= date;
+	}
+
+	return false;
+}
+
+std::string_view file_server::cache_control_for(const options &opts, std::string_view path)
+{
+	for (auto &prefix: opts.immutable_prefixes()) {
+		if (!prefix.empty() && fz::starts_with(path, std::string_view(prefix))) {
+			return "public, max-age=31536000, immutable";
+		}
+	}
+
+	return opts.cache_control();
+}
+
+bool file_server::send_validators(server::responder &res, std::string_view path, const entity_tag &etag, const datetime &mtime)
+{
+	auto cache_control = cache_control_for(opts_, path);
+
+	return
+		(!etag || res.send_header(http::headers::ETag, etag.to_string())) &&
+		(mtime.empty() || res.send_header(http::headers::Last_Modified, mtime.get_rfc822())) &&
+		(cache_control.empty() || res.send_header(http::headers::Cache_Control, cache_control));
+}
+
+bool file_server::send_not_modified(server::responder &res, std::string_view path, const entity_tag &etag, const datetime &mtime, bool negotiates_compression)
+{
+	return
+		res.send_status(304, "Not Modified") &&
+		send_validators(res, path, etag, mtime) &&
+		res.send_header(http::headers::Vary, vary(negotiates_compression)) &&
+		res.send_end();
+}
+
 bool file_server::send_disposition_header(server::request &req, server::responder &res)
 {
 	auto disposition = [&]() -> std::string_view {
@@ -163,6 +363,18 @@ bool file_server::send_disposition_header(server::request &req, server::responde
 
 void file_server::do_get(server::request &req, server::responder &res)
 {
+	if (auto action = req.headers.get(headers::X_FZ_Action); action.is("upload-status")) {
+		return do_get_upload_status(req, res, action);
+	}
+
+	if (opts_.can_zip() && !req.uri.query_.empty()) {
+		query_string q(req.uri.query_);
+
+		if (auto zip = q.pairs().find("zip"); zip != q.pairs().end()) {
+			return do_get_zip(req, res, zip->second);
+		}
+	}
+
 	tvfs::entries_iterator it;
 	auto result = tvfs_.get_entries(it, req.uri.path_, tvfs::traversal_mode::only_children);
 
@@ -211,17 +423,58 @@ void file_server::do_get(server::request &req, server::responder &res)
 				});
 
 				if (content_type) {
-					res.send_status(200, "Ok") &&
-					res.send_header(http::headers::Content_Type, content_type) &&
-					res.send_header(http::headers::Vary, http::headers::Accept) && [&] {
-						if (it.mtime()) {
-							return res.send_header(http::headers::Last_Modified, it.mtime().get_rfc822());
+					listing_cache::page_request page;
+					auto paging = page.parse(req.uri.query_);
+
+					if (paging == page.invalid) {
+						res.send_status(400, "Bad Request") &&
+						res.send_body("Invalid listing parameters.\n");
+
+						return;
+					}
+
+					std::optional<tvfs::entries_iterator> page_it;
+					std::string next_cursor;
+
+					std::string_view type = content_type;
+					auto variant = type.substr(type.find('/') + 1);
+
+					// The directory's mtime doesn't change when the files in it are merely written to, hence the tags are weak ones.
+					// A page is in memory already, so its validators are made out of its entries; a whole listing is streamed instead,
+					// since reading it all just to digest it would hold back its first byte, and so gets a tag out of the directory's mtime.
+					entity_tag etag;
+					datetime mtime;
+
+					if (paging == page.valid) {
+						std::vector<tvfs::entry> entries;
+
+						if (!listing_cache_.get(req.uri.path_, it)->get_page(page, entries, next_cursor)) {
+							res.send_status(400, "Bad Request") &&
+							res.send_body("Invalid cursor.\n");
+
+							return;
 						}
 
-						return true;
-					}() &&
+						etag = listing_tag(entries, next_cursor, variant, it.mtime(), mtime);
+						page_it.emplace(tvfs::entries_iterator::from_entries(std::move(entries), req.uri.path_, it.mtime()));
+					}
+					else {
+						mtime = it.mtime();
+						etag = entity_tag::from_entry(0, mtime, true, variant);
+					}
+
+					if (is_not_modified(req, etag, mtime)) {
+						send_not_modified(res, req.uri.path_, etag, mtime, body_compressor::is_negotiable(content_type, body_compressor::unknown_size));
+						return;
+					}
+
+					res.send_status(200, "Ok") &&
+					res.send_header(http::headers::Content_Type, content_type) &&
+					res.send_header(http::headers::Vary, http::headers::Accept) &&
+					(next_cursor.empty() || res.send_header(http::headers::X_FZ_Next_Cursor, next_cursor)) &&
+					send_validators(res, req.uri.path_, etag, mtime) &&
 					send_disposition_header(req, res) &&
-					res.send_body(std::move(it));
+					res.send_body(page_it ? std::move(*page_it) : std::move(it));
 				}
 
 				return;
@@ -242,6 +495,54 @@ void file_server::do_get(server::request &req, server::responder &res)
 	send_response_from_result(res, result);
 }
 
+void file_server::do_get_zip(server::request &req, server::responder &res, std::string_view method)
+{
+	std::vector<std::string> names;
+
+	// Not through query_string, which keeps only the last of the parameters with the same name.
+	for (auto param: fz::strtok_view(req.uri.query_, "&")) {
+		if (!fz::starts_with(param, std::string_view("name="))) {
+			continue;
+		}
+
+		auto name = percent_decode_s(param.substr(5), false, true);
+		if (name.empty() || name == "." || name == ".." || name.find('/') != std::string::npos) {
+			res.send_status(400, "Bad Request") &&
+			res.send_body(fz::sprintf("Invalid name: `%s'.\n", name));
+
+			return;
+		}
+
+		names.push_back(std::move(name));
+	}
+
+	tvfs::entries_iterator it;
+	if (auto result = tvfs_.get_entries(it, req.uri.path_, tvfs::traversal_mode::only_children); !result) {
+		send_response_from_result(res, result);
+		return;
+	}
+
+	it.end_iteration();
+
+	std::string_view path = req.uri.path_;
+	while (!path.empty() && path.back() == '/') {
+		path.remove_suffix(1);
+	}
+
+	auto archive_name = std::string(path.substr(path.rfind('/') + 1));
+	if (archive_name.empty()) {
+		archive_name = "files";
+	}
+
+	auto m = method == "deflate" ? zip_archiver::method::deflated : zip_archiver::method::stored;
+
+	res.send_status(200, "Ok") &&
+	res.send_header(http::headers::Content_Type, "application/zip") &&
+	res.send_header(http::headers::Content_Disposition, fz::sprintf("attachment; filename*=UTF-8''%s", percent_encode(archive_name + ".zip"))) &&
+	res.send_header(http::headers::Cache_Control, "no-store") &&
+	res.send_body(std::make_unique<zip_archiver>(tvfs_, req.uri.path_, std::move(names), m, logger_, tvfs_owner_.lock()));
+}
+
 void file_server::do_put(server::request &req, server::responder &res)
 {
 	if (auto action = req.headers.get(headers::X_FZ_Action)) {
@@ -255,6 +556,18 @@ void file_server::do_put(server::request &req, server::responder &res)
 			}
 		}
 
+		if (action.is("upload-begin")) {
+			return do_put_upload_begin(req, res, action);
+		}
+
+		if (action.is("upload-chunk")) {
+			return do_put_upload_chunk(req, res, action);
+		}
+
+		if (action.is("upload-end")) {
+			return do_put_upload_end(req, res, action);
+		}
+
 		logger_.log(logmsg::error, L"Invalid %s header.", headers::X_FZ_Action);
 
 		res.send_status(404, "Bad Request") &&
@@ -288,6 +601,10 @@ void file_server::do_put(server::request &req, server::responder &res)
 
 void file_server::do_delete(server::request &req, server::responder &res)
 {
+	if (auto action = req.headers.get(headers::X_FZ_Action); action.is("upload-abort")) {
+		return do_delete_upload(req, res, action);
+	}
+
 	fz::result result;
 
 	if (req.uri.path_.back() == '/') {
@@ -353,6 +670,165 @@ void file_server::do_put_copy(server::request &, server::responder &res, std::st
 	res.send_end();
 }
 
+bool file_server::find_upload_or_send_error(server::request &req, server::responder &res, field::value_view action, resumable_upload &upload)
+{
+	auto id = action.get_param("id");
+	if (!id || !resumable_upload::is_valid_id(*id)) {
+		res.send_status(400, "Bad Request") &&
+		res.send_body("Missing or invalid upload id.\n");
+
+		return false;
+	}
+
+	if (auto result = resumable_upload::find(upload, tvfs_, req.uri.path_, *id); !result) {
+		send_response_from_result(res, result);
+		return false;
+	}
+
+	return true;
+}
+
+void file_server::do_put_upload_begin(server::request &req, server::responder &res, field::value_view action)
+{
+	auto size = fz::to_integral<std::uint64_t>(action.get_param("size").value_or(field::component_view()).str(), std::uint64_t(-1));
+	if (size == std::uint64_t(-1)) {
+		res.send_status(400, "Bad Request") &&
+		res.send_body("Missing or invalid upload size.\n");
+
+		return;
+	}
+
+	if (auto path = util::fs::absolute_unix_path(req.uri.path_)) {
+		resumable_upload::remove_stale(tvfs_, path.parent().str(), opts_.stale_upload_age());
+	}
+
+	resumable_upload upload;
+	if (auto result = resumable_upload::begin(upload, tvfs_, req.uri.path_, size, opts_.max_upload_size()); !result) {
+		if (result.error_ == result.resource_limit) {
+			res.send_status(413, "Content Too Large") &&
+			res.send_body(fz::sprintf("The upload can't be bigger than %d bytes.\n", opts_.max_upload_size()));
+
+			return;
+		}
+
+		return send_response_from_result(res, result);
+	}
+
+	res.send_status(201, "Created") &&
+	res.send_header(headers::X_FZ_Upload_Id, upload.id()) &&
+	res.send_end();
+}
+
+void file_server::do_put_upload_chunk(server::request &req, server::responder &res, field::value_view action)
+{
+	resumable_upload upload;
+	if (!find_upload_or_send_error(req, res, action, upload)) {
+		return;
+	}
+
+	auto offset = fz::to_integral<std::uint64_t>(action.get_param("offset").value_or(field::component_view()).str(), std::uint64_t(-1));
+	if (offset == std::uint64_t(-1)) {
+		res.send_status(400, "Bad Request") &&
+		res.send_body("Missing or invalid chunk offset.\n");
+
+		return;
+	}
+
+	// The length must be known upfront, for the chunk to be checked against the upload and recorded once it's been received.
+	auto length = fz::to_integral<std::uint64_t>(req.headers.get(headers::Content_Length).str(), std::uint64_t(-1));
+	if (length == std::uint64_t(-1)) {
+		res.send_status(411, "Length Required") &&
+		res.send_end();
+
+		return;
+	}
+
+	if (offset > upload.size() || length > upload.size() - offset) {
+		res.send_status(400, "Bad Request") &&
+		res.send_body(fz::sprintf("The chunk doesn't fit in the upload, which is %d bytes long.\n", upload.size()));
+
+		return;
+	}
+
+	tvfs::file_holder file;
+	if (auto result = upload.open_part(file, offset); !result) {
+		return send_response_from_result(res, result);
+	}
+
+	req.receive_body(std::move(file), [&res, upload, offset, length, owner = tvfs_owner_.lock(), &logger = logger_](tvfs::file_holder file, bool success) mutable {
+		// Only once the data is on disk can the chunk be told to have been received, else a crash could leave holes in the file that nobody knows about.
+		if (success && length > 0) {
+			success = file->fsync() && upload.add_received({offset, offset + length - 1});
+		}
+
+		if (success) {
+			res.send_status(204, "No Content") &&
+			res.send_end();
+
+			return;
+		}
+
+		logger.log_u(logmsg::error, L"Couldn't store the chunk at offset %d of upload %s.", offset, upload.id());
+
+		res.send_status(500, "Internal Server Error") &&
+		res.send_header(http::headers::Connection, "close") &&
+		res.send_end();
+	});
+}
+
+void file_server::do_put_upload_end(server::request &req, server::responder &res, field::value_view action)
+{
+	resumable_upload upload;
+	if (!find_upload_or_send_error(req, res, action, upload)) {
+		return;
+	}
+
+	byte_ranges received;
+	if (auto result = upload.get_received(received); !result) {
+		return send_response_from_result(res, result);
+	}
+
+	if (!received.covers(upload.size())) {
+		res.send_status(409, "Conflict") &&
+		res.send_header(headers::X_FZ_Upload_Size, std::to_string(upload.size())) &&
+		res.send_header(headers::X_FZ_Upload_Ranges, received.to_string()) &&
+		res.send_body("The upload isn't complete yet.\n");
+
+		return;
+	}
+
+	send_response_from_result(res, upload.end());
+}
+
+void file_server::do_get_upload_status(server::request &req, server::responder &res, field::value_view action)
+{
+	resumable_upload upload;
+	if (!find_upload_or_send_error(req, res, action, upload)) {
+		return;
+	}
+
+	byte_ranges received;
+	if (auto result = upload.get_received(received); !result) {
+		return send_response_from_result(res, result);
+	}
+
+	res.send_status(200, "Ok") &&
+	res.send_header(headers::X_FZ_Upload_Size, std::to_string(upload.size())) &&
+	res.send_header(headers::X_FZ_Upload_Ranges, received.to_string()) &&
+	res.send_header(headers::Cache_Control, "no-store") &&
+	res.send_end();
+}
+
+void file_server::do_delete_upload(server::request &req, server::responder &res, field::value_view action)
+{
+	resumable_upload upload;
+	if (!find_upload_or_send_error(req, res, action, upload)) {
+		return;
+	}
+
+	send_response_from_result(res, upload.abort());
+}
+
 void file_server::handle_transaction(const server::shared_transaction &t) {
 	auto &req = t->req();
 	auto &res = t->res();
@@ -2,6 +2,15 @@
 #define FZ_HTTP_SERVER_FILE_SERVER_HPP
 
 #include "../server/transaction.hpp"
+#include "../entity_tag.hpp"
+#include "../field.hpp"
+#include "../listing_cache.hpp"
+
+namespace fz::http {
+
+class resumable_upload;
+
+}
 
 namespace fz::http::handlers {
 
@@ -16,15 +25,53 @@ namespace fz::http::handlers {
  *			2) text/html
  *			3) application/ndjson
  *
+ *		If the entry is a file, parts of it can be requested with the Range: request header, optionally conditioned
+ *		by an If-Range: request header holding the ETag or the Last-Modified date of the file.
+ *		Multiple ranges are returned as a multipart/byteranges body.
+ *
+ *		The response body may be compressed, according to the Accept-Encoding: request header.
+ *
+ *		If the entry is a directory, its listing can be asked for one page at a time, with the following query parameters:
+ *			limit=<n>                 - At most n entries are listed.
+ *			sort=<name|size|mtime>    - The key the entries are sorted by. Ties are broken by name. Defaults to name.
+ *			order=<asc|desc>          - The order the entries are sorted in. Defaults to asc.
+ *			filter=<glob>             - Only the entries whose name matches the glob are listed. * matches any sequence of characters,
+ *			                            ? any single character. Case insensitive, for ASCII letters.
+ *			cursor=<cursor>           - The listing continues after the last entry of the previous page.
+ *
+ *		If there are more entries after the page, the X-FZ-Next-Cursor response header holds the cursor for the next page.
+ *		A cursor is only valid with the same sort and order it was returned with.
+ *
+ *		If the entry is a directory and the query has a "zip" parameter, the content is instead a ZIP archive of the directory,
+ *		made while it's being sent. If the query has "name" parameters, the archive holds only the entries of the directory they name.
+ *		The files in the archive are deflated if the "zip" parameter is set to "deflate", and stored as they are otherwise.
+ *		Entries that can't be read are left out of the archive.
+ *
+ *		Files are sent with a strong ETag, and listings with a weak one. If the If-None-Match: request header matches it,
+ *		or in its absence if the entry hasn't been modified since the date of the If-Modified-Since: request header,
+ *		the entry's content isn't sent at all.
+ *
+ *		If the X-FZ-Action request header is "upload-status; id=<id>", the status of the resumable upload with the given id,
+ *		started for the entry, is returned instead, with no body: the X-FZ-Upload-Size response header tells the size
+ *		of the upload, and the X-FZ-Upload-Ranges response header the ranges received so far, like "0-1048575, 4194304-5242879".
+ *
  *		Status Codes:
  *			200 OK - Successful retrieval
+ *			206 Partial Content - Successful retrieval of the requested ranges
+ *			304 Not Modified - The client's copy of the entry is still current
  *			404 Not Found - Entry not found
  *			406 Not Acceptable - Requested format not supported
+ *			400 Bad Request - One of the "name" parameters of a ZIP archive request isn't the name of an entry,
+ *			                  or one of the listing parameters is invalid
+ *			416 Range Not Satisfiable - None of the requested ranges is within the file
  *
  *	DELETE /path/to/entry
  *		Deletes the entry.
  *		If the entry is a directory and the FZ-Action-Recursive header is set to true, the deletion will be recursive.
  *
+ *		If the X-FZ-Action request header is "upload-abort; id=<id>", the resumable upload with the given id is aborted instead,
+ *		and whatever was received of it is deleted.
+ *
  *		Status Codes:
  *			204 No Content - Successful deletion
  *			404 Not Found - Entry not found
@@ -43,10 +90,29 @@ namespace fz::http::handlers {
  *			If the action is "mkdir":
  *				The entry is created as a directory. The request MUST not have a body.
  *
+ *			If the action is "upload-begin; size=<size>":
+ *				A resumable upload of <size> bytes is started, and its id is returned in the X-FZ-Upload-Id response header.
+ *				The entry itself is left untouched until the upload ends. The request MUST not have a body.
+ *
+ *			If the action is "upload-chunk; id=<id>; offset=<offset>":
+ *				The body of the request is written at <offset> of the upload with the given id. The request MUST have a Content-Length.
+ *				Chunks can be sent in any order, and at the same time over different connections. A chunk is recorded
+ *				as received only once it's been stored: a chunk whose response never arrived must be sent again.
+ *
+ *			If the action is "upload-end; id=<id>":
+ *				The upload with the given id, whose chunks must all have been received, replaces the entry. The request MUST not have a body.
+ *
+ *			Resumable uploads are kept, next to the entry, across restarts of the server, until they are ended or aborted,
+ *			or until they're found not to have been written to for longer than the stale_upload_age option.
+ *
  *		Status Codes:
+ *			201 Created - Resumable upload started
  *			204 No Content - Successful creation without a response body
  *			400 Bad Request - Invalid request
- *			409 Conflict - conflict while copying
+ *			404 Not Found - The resumable upload doesn't exist
+ *			409 Conflict - conflict while copying, or not all of the chunks of the resumable upload have been received yet
+ *			411 Length Required - A chunk of a resumable upload was sent without a Content-Length
+ *			413 Content Too Large - The resumable upload is bigger than the max_upload_size option allows
  *
  *	POST /path/to/directory
  *		Performs a non-idempotent operation in the context of the given target.
@@ -80,10 +146,30 @@ public:
 		opt<bool> can_post = o(false);
 		opt<bool> can_list_dir = o(false);
 
+		/// Directories can be downloaded as ZIP archives. See the API documentation above.
+		opt<bool> can_zip = o(false);
+
 		opt<bool> honor_406 = o(false);
 		opt<std::vector<std::string>> default_index = o();
 		opt<std::string> default_charset = o();
 
+		/// The Cache-Control of the files and of the listings. Not sent, if empty.
+		opt<std::string> cache_control = o();
+
+		/// Files whose path begins with one of these prefixes never change, since their name changes with their content instead,
+		/// like the hashed assets of a web application: clients can keep them for as long as they like, without revalidating them.
+		opt<std::vector<std::string>> immutable_prefixes = o();
+
+		/// If the client accepts it, a file is sent as its .br or .gz sibling, when there's one, with the matching Content-Encoding.
+		/// Only for trees where such siblings are known to be compressed copies of the files, like those of a web application.
+		opt<bool> precompressed = o(false);
+
+		/// Resumable uploads bigger than this are refused, since their temporary file is given their whole size straight away.
+		opt<std::uint64_t> max_upload_size = o(std::uint64_t(64) << 30);
+
+		/// Resumable uploads that haven't been written to for this long are removed, whenever another one begins in the same directory.
+		opt<duration> stale_upload_age = o(duration::from_days(7));
+
 		options(){}
 	};
 
@@ -93,21 +179,65 @@ public:
 
 	local_filesys::type get_file_type_or_send_error(std::string_view path, http::server::responder &res);
 
+	const options &get_options() const
+	{
+		return opts_;
+	}
+
+	/// ZIP archives keep \p owner alive while they're being sent, since they use the tvfs engine until their very end,
+	/// well after the transaction has been handled. Needed only if \p owner owns the engine and can go away meanwhile.
+	void set_tvfs_owner(std::weak_ptr<void> owner)
+	{
+		tvfs_owner_ = std::move(owner);
+	}
+
 	static std::string_view mime_from_name(std::string_view name);
 	static void send_response_from_result(http::server::responder &res, fz::result result);
 
+	/// \returns the Cache-Control of the file at \p path, according to \p opts. Empty if none is to be sent.
+	static std::string_view cache_control_for(const options &opts, std::string_view path);
+
+	/// \returns whether the conditional headers of \p req say that the client's copy of the entry is still current.
+	static bool is_not_modified(http::server::request &req, const entity_tag &etag, const datetime &mtime);
+
 private:
 	fz::http::field::value negotiate_content_type(http::server::request &req, http::server::responder &res, std::initializer_list<std::string_view> list);
 	result send_file(http::server::request &req, http::server::responder &res, std::string_view path);
 	bool send_disposition_header(http::server::request &req, http::server::responder &res);
+	struct representation
+	{
+		std::string path;
+		std::string_view encoding;
+	};
+
+	representation select_representation(http::server::request &req, std::string_view path);
+
+	/// \param negotiates_compression whether the 200 the header goes with has its compression negotiated by the session,
+	/// which then sends the Vary on Accept-Encoding by itself: a 304 standing for such a 200 must carry it too.
+	field::value_view vary(bool negotiates_compression = false) const;
+	bool if_range_matches(http::server::request &req, const entity_tag &etag, const datetime &mtime);
+	bool send_validators(http::server::responder &res, std::string_view path, const entity_tag &etag, const datetime &mtime);
+	bool send_not_modified(http::server::responder &res, std::string_view path, const entity_tag &etag, const datetime &mtime, bool negotiates_compression);
+
+	/// \returns the tag of a listing made of \p entries, out of a digest of their names, types, sizes and mtimes, and of \p next_cursor.
+	/// \param latest is set to the most recent of \p dir_mtime and the mtimes of the entries.
+	static entity_tag listing_tag(const std::vector<tvfs::entry> &entries, std::string_view next_cursor, std::string_view variant, const datetime &dir_mtime, datetime &latest);
 
 	void do_get(http::server::request &req, http::server::responder &res);
+	void do_get_zip(http::server::request &req, http::server::responder &res, std::string_view method);
 	void do_put(http::server::request &req, http::server::responder &res);
 	void do_delete(http::server::request &req, http::server::responder &res);
 	void do_post(http::server::request &req, http::server::responder &res);
 	void do_put_mkdir(http::server::request &req, http::server::responder &res);
 	void do_put_copy(http::server::request &req, http::server::responder &res, std::string_view source);
 
+	bool find_upload_or_send_error(http::server::request &req, http::server::responder &res, field::value_view action, resumable_upload &upload);
+	void do_put_upload_begin(http::server::request &req, http::server::responder &res, field::value_view action);
+	void do_put_upload_chunk(http::server::request &req, http::server::responder &res, field::value_view action);
+	void do_put_upload_end(http::server::request &req, http::server::responder &res, field::value_view action);
+	void do_get_upload_status(http::server::request &req, http::server::responder &res, field::value_view action);
+	void do_delete_upload(http::server::request &req, http::server::responder &res, field::value_view action);
+
 	#undef DELETE
 	enum verbs {
 		PUT    = 0b0001,
@@ -124,7 +254,9 @@ private:
 private:
 	options opts_;
 	tvfs::engine &tvfs_;
+	std::weak_ptr<void> tvfs_owner_;
 	logger_interface &logger_;
+	listing_cache listing_cache_;
 };
 
 }
@@ -0,0 +1,38 @@
+#include "metrics_exporter.hpp"
+
+#include "../server/responder.hpp"
+#include "../../metrics/exposition.hpp"
+
+namespace fz::http::handlers {
+
+void metrics_exporter::handle_transaction(const server::shared_transaction &t)
+{
+	auto &req = t->req();
+	auto &res = t->res();
+
+	if (!enabled_ || req.uri.path_ != "/") {
+		res.send_status(404, "Not Found") &&
+		res.send_end();
+
+		return;
+	}
+
+	if (req.method != "GET") {
+		res.send_status(405, "Method Not Allowed") &&
+		res.send_header(fz::http::headers::Allowed, "GET") &&
+		res.send_end();
+
+		return;
+	}
+
+	auto text = metrics::to_text(registry_.collect());
+
+	res.send_status(200, "Ok") &&
+	res.send_headers({
+		{ headers::Content_Type, metrics::text_content_type },
+		{ headers::Cache_Control, "no-store" }
+	}) &&
+	res.send_body(text);
+}
+
+}
@@ -0,0 +1,35 @@
+#ifndef FZ_HTTP_HANDLERS_METRICS_EXPORTER_HPP
+#define FZ_HTTP_HANDLERS_METRICS_EXPORTER_HPP
+
+#include <atomic>
+
+#include "../server/transaction.hpp"
+#include "../../metrics/registry.hpp"
+
+namespace fz::http::handlers {
+
+/// \brief Exposes the metrics of a registry in the Prometheus text format, to be scraped with GET requests.
+///
+/// It's disabled by default, in which case it answers as if it didn't exist.
+class metrics_exporter: public http::server::transaction_handler
+{
+public:
+	metrics_exporter(metrics::registry &registry)
+		: registry_(registry)
+	{}
+
+	void handle_transaction(const server::shared_transaction &t) override;
+
+	void set_enabled(bool enabled)
+	{
+		enabled_ = enabled;
+	}
+
+private:
+	metrics::registry &registry_;
+	std::atomic<bool> enabled_{};
+};
+
+}
+
+#endif // FZ_HTTP_HANDLERS_METRICS_EXPORTER_HPP
@@ -74,6 +74,24 @@ field::value headers::match_preferred_content_type(std::initializer_list<std::st
 	return best_match;
 }
 
+bool headers::accepts_encoding(std::string_view coding) const
+{
+	auto accept = get(Accept_Encoding).as_list();
+
+	auto v = accept.get(coding);
+	if (!v) {
+		v = accept.get("*");
+	}
+
+	if (!v) {
+		return false;
+	}
+
+	std::string_view q_value = v.get_param("q").value_or("1");
+
+	return q_value.find_first_not_of("0.") != std::string_view::npos;
+}
+
 const std::string &headers::default_user_agent()
 {
 	static const auto user_agent = [] {
@@ -157,19 +175,28 @@ std::string headers::make_cookie(field::component_view name, field::component_vi
 using namespace std::string_view_literals;
 
 const headers::key_type headers::Accept = "Accept"sv;
+const headers::key_type headers::Accept_Encoding = "Accept-Encoding"sv;
+const headers::key_type headers::Accept_Ranges = "Accept-Ranges"sv;
 const headers::key_type headers::Allowed = "Allowed"sv;
 const headers::key_type headers::Authorization = "Authorization"sv;
 const headers::key_type headers::Cache_Control = "Cache-Control"sv;
 const headers::key_type headers::Connection = "Connection"sv;
 const headers::key_type headers::Content_Disposition = "Content-Disposition"sv;
+const headers::key_type headers::Content_Encoding = "Content-Encoding"sv;
 const headers::key_type headers::Content_Length = "Content-Length"sv;
+const headers::key_type headers::Content_Range = "Content-Range"sv;
 const headers::key_type headers::Content_Type = "Content-Type"sv;
 const headers::key_type headers::Cookie = "Cookie"sv;
+const headers::key_type headers::ETag = "ETag"sv;
 const headers::key_type headers::Expect = "Expect"sv;
 const headers::key_type headers::Host = "Host"sv;
+const headers::key_type headers::If_Modified_Since = "If-Modified-Since"sv;
+const headers::key_type headers::If_None_Match = "If-None-Match"sv;
+const headers::key_type headers::If_Range = "If-Range"sv;
 const headers::key_type headers::Last_Modified = "Last-Modified"sv;
 const headers::key_type headers::Location = "Location"sv;
 const headers::key_type headers::Pragma = "Pragma"sv;
+const headers::key_type headers::Range = "Range"sv;
 const headers::key_type headers::Set_Cookie = "Set-Cookie"sv;
 const headers::key_type headers::Transfer_Encoding = "Transfer-Encoding"sv;
 const headers::key_type headers::User_Agent = "User-Agent"sv;
@@ -178,6 +205,10 @@ const headers::key_type headers::WWW_Authenticate = "WWW-Authenticate"sv;
 const headers::key_type headers::X_FZ_INT_Original_Path = "X-FZ-INT-Original-Path"sv;
 const headers::key_type headers::X_FZ_INT_File_Name = "X-FZ-INT-File-Name"sv;
 const headers::key_type headers::X_FZ_Action = "X-FZ-Action"sv;
+const headers::key_type headers::X_FZ_Next_Cursor = "X-FZ-Next-Cursor"sv;
 const headers::key_type headers::X_FZ_Recursive = "X-FZ-Recursive"sv;
+const headers::key_type headers::X_FZ_Upload_Id = "X-FZ-Upload-Id"sv;
+const headers::key_type headers::X_FZ_Upload_Ranges = "X-FZ-Upload-Ranges"sv;
+const headers::key_type headers::X_FZ_Upload_Size = "X-FZ-Upload-Size"sv;
 
 }
@@ -15,19 +15,28 @@ class headers: public std::map<field::name, field::value>
 {
 public:
 	static const key_type Accept;
+	static const key_type Accept_Encoding;
+	static const key_type Accept_Ranges;
 	static const key_type Allowed;
 	static const key_type Authorization;
 	static const key_type Connection;
 	static const key_type Cache_Control;
 	static const key_type Content_Disposition;
+	static const key_type Content_Encoding;
 	static const key_type Content_Length;
+	static const key_type Content_Range;
 	static const key_type Content_Type;
 	static const key_type Cookie;
+	static const key_type ETag;
 	static const key_type Expect;
 	static const key_type Host;
+	static const key_type If_Modified_Since;
+	static const key_type If_None_Match;
+	static const key_type If_Range;
 	static const key_type Last_Modified;
 	static const key_type Location;
 	static const key_type Pragma;
+	static const key_type Range;
 	static const key_type Set_Cookie;
 	static const key_type Transfer_Encoding;
 	static const key_type User_Agent;
@@ -36,7 +45,11 @@ public:
 	static const key_type X_FZ_INT_Original_Path;
 	static const key_type X_FZ_INT_File_Name;
 	static const key_type X_FZ_Action;
+	static const key_type X_FZ_Next_Cursor;
 	static const key_type X_FZ_Recursive;
+	static const key_type X_FZ_Upload_Id;
+	static const key_type X_FZ_Upload_Ranges;
+	static const key_type X_FZ_Upload_Size;
 
 public:
 	using map::map;
@@ -62,6 +75,9 @@ public:
 
 	field::value match_preferred_content_type(std::initializer_list<std::string_view> list);
 
+	/// \returns whether the Accept-Encoding header lists \p coding, or *, with a non-zero q value.
+	bool accepts_encoding(std::string_view coding) const;
+
 	static const std::string &default_user_agent();
 
 	field::component_view get_cookie(field::component_view name, bool secure);
@@ -0,0 +1,462 @@
+#include "hpack.hpp"
+
+namespace fz::http::hpack {
+
+namespace {
+
+// RFC 7541, Appendix A.
+constexpr std::pair<std::string_view, std::string_view> static_table[] = {
+	{ ":authority", "" },
+	{ ":method", "GET" },
+	{ ":method", "POST" },
+	{ ":path", "/" },
+	{ ":path", "/index.html" },
+	{ ":scheme", "http" },
+	{ ":scheme", "https" },
+	{ ":status", "200" },
+	{ ":status", "204" },
+	{ ":status", "206" },
+	{ ":status", "304" },
+	{ ":status", "400" },
+	{ ":status", "404" },
+	{ ":status", "500" },
+	{ "accept-charset", "" },
+	{ "accept-encoding", "gzip, deflate" },
+	{ "accept-language", "" },
+	{ "accept-ranges", "" },
+	{ "accept", "" },
+	{ "access-control-allow-origin", "" },
+	{ "age", "" },
+	{ "allow", "" },
+	{ "authorization", "" },
+	{ "cache-control", "" },
+	{ "content-disposition", "" },
+	{ "content-encoding", "" },
+	{ "content-language", "" },
+	{ "content-length", "" },
+	{ "content-location", "" },
+	{ "content-range", "" },
+	{ "content-type", "" },
+	{ "cookie", "" },
+	{ "date", "" },
+	{ "etag", "" },
+	{ "expect", "" },
+	{ "expires", "" },
+	{ "from", "" },
+	{ "host", "" },
+	{ "if-match", "" },
+	{ "if-modified-since", "" },
+	{ "if-none-match", "" },
+	{ "if-range", "" },
+	{ "if-unmodified-since", "" },
+	{ "last-modified", "" },
+	{ "link", "" },
+	{ "location", "" },
+	{ "max-forwards", "" },
+	{ "proxy-authenticate", "" },
+	{ "proxy-authorization", "" },
+	{ "range", "" },
+	{ "referer", "" },
+	{ "refresh", "" },
+	{ "retry-after", "" },
+	{ "server", "" },
+	{ "set-cookie", "" },
+	{ "strict-transport-security", "" },
+	{ "transfer-encoding", "" },
+	{ "user-agent", "" },
+	{ "vary", "" },
+	{ "via", "" },
+	{ "www-authenticate", "" },
+};
+
+constexpr std::size_t static_table_size = sizeof(static_table)/sizeof(static_table[0]);
+
+// The size the RFC accounts for each entry of the dynamic table, on top of its name and value.
+constexpr std::size_t entry_overhead = 32;
+
+// RFC 7541, Appendix B: the length of the code of each symbol, the last one being EOS.
+// The code is canonical, hence the codes themselves follow from their lengths.
+constexpr std::uint8_t huffman_lengths[257] = {
+	13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+	28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+	6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+	5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+	13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+	7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+	15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+	6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+	20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+	24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+	22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+	21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+	26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+	19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+	20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+	26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+	30,
+};
+
+constexpr std::uint16_t eos = 256;
+constexpr int max_code_length = 30;
+
+struct huffman_code
+{
+	huffman_code()
+	{
+		// Codes of the same length are consecutive, in the order of their symbols, and follow the shorter ones.
+		std::uint16_t n = 0;
+		std::uint32_t code = 0;
+
+		for (int len = 1; len <= max_code_length; ++len) {
+			first_code[len] = code;
+			first_index[len] = n;
+
+			for (std::uint16_t s = 0; s <= eos; ++s) {
+				if (huffman_lengths[s] == len) {
+					codes[s] = code++;
+					symbols[n++] = s;
+				}
+			}
+
+			count[len] = std::uint16_t(n - first_index[len]);
+			code <<= 1;
+		}
+	}
+
+	std::uint32_t codes[eos + 1]{};
+
+	std::uint32_t first_code[max_code_length + 1]{};
+	std::uint16_t first_index[max_code_length + 1]{};
+	std::uint16_t count[max_code_length + 1]{};
+	std::uint16_t symbols[eos + 1]{};
+};
+
+const huffman_code &huffman()
+{
+	static const huffman_code code;
+	return code;
+}
+
+void encode_integer(std::uint64_t v, int prefix_bits, std::uint8_t first_byte, fz::buffer &out)
+{
+	std::uint64_t const max_prefix = (1u << prefix_bits) - 1;
+
+	if (v < max_prefix) {
+		out.append(std::uint8_t(first_byte | v));
+		return;
+	}
+
+	out.append(std::uint8_t(first_byte | max_prefix));
+	v -= max_prefix;
+
+	while (v >= 128) {
+		out.append(std::uint8_t((v % 128) | 128));
+		v /= 128;
+	}
+
+	out.append(std::uint8_t(v));
+}
+
+bool decode_integer(std::string_view &in, int prefix_bits, std::uint64_t &v)
+{
+	if (in.empty()) {
+		return false;
+	}
+
+	std::uint64_t const max_prefix = (1u << prefix_bits) - 1;
+
+	v = std::uint8_t(in.front()) & max_prefix;
+	in.remove_prefix(1);
+
+	if (v < max_prefix) {
+		return true;
+	}
+
+	// Nothing in a header block is legitimately bigger than what 4 more bytes can tell.
+	for (int shift = 0; shift <= 21; shift += 7) {
+		if (in.empty()) {
+			return false;
+		}
+
+		auto b = std::uint8_t(in.front());
+		in.remove_prefix(1);
+
+		v += std::uint64_t(b & 127) << shift;
+
+		if (!(b & 128)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void encode_string(std::string_view s, fz::buffer &out)
+{
+	if (auto size = huffman_encoded_size(s); size < s.size()) {
+		encode_integer(size, 7, 0x80, out);
+		huffman_encode(s, out);
+	}
+	else {
+		encode_integer(s.size(), 7, 0x00, out);
+		out.append(s);
+	}
+}
+
+bool decode_string(std::string_view &in, std::string &out)
+{
+	if (in.empty()) {
+		return false;
+	}
+
+	bool const is_huffman = std::uint8_t(in.front()) & 0x80;
+
+	std::uint64_t size{};
+	if (!decode_integer(in, 7, size) || size > in.size()) {
+		return false;
+	}
+
+	auto s = in.substr(0, std::size_t(size));
+	in.remove_prefix(std::size_t(size));
+
+	out.clear();
+
+	if (is_huffman) {
+		return huffman_decode(s, out);
+	}
+
+	out.assign(s);
+	return true;
+}
+
+}
+
+void huffman_encode(std::string_view s, fz::buffer &out)
+{
+	auto &h = huffman();
+
+	std::uint64_t bits{};
+	int num_bits{};
+
+	for (unsigned char c: s) {
+		bits = (bits << huffman_lengths[c]) | h.codes[c];
+		num_bits += huffman_lengths[c];
+
+		while (num_bits >= 8) {
+			num_bits -= 8;
+			out.append(std::uint8_t(bits >> num_bits));
+		}
+
+		bits &= (std::uint64_t(1) << num_bits) - 1;
+	}
+
+	// Padded with the most significant bits of EOS, which are all ones.
+	if (num_bits > 0) {
+		out.append(std::uint8_t((bits << (8 - num_bits)) | (0xffu >> num_bits)));
+	}
+}
+
+std::size_t huffman_encoded_size(std::string_view s)
+{
+	std::size_t num_bits{};
+
+	for (unsigned char c: s) {
+		num_bits += huffman_lengths[c];
+	}
+
+	return (num_bits + 7) / 8;
+}
+
+bool huffman_decode(std::string_view s, std::string &out)
+{
+	auto &h = huffman();
+
+	std::uint32_t code{};
+	int len{};
+
+	for (unsigned char c: s) {
+		for (int bit = 7; bit >= 0; --bit) {
+			code = (code << 1) | ((c >> bit) & 1);
+			++len;
+
+			if (code >= h.first_code[len] && code - h.first_code[len] < h.count[len]) {
+				auto symbol = h.symbols[h.first_index[len] + (code - h.first_code[len])];
+
+				if (symbol == eos) {
+					return false;
+				}
+
+				out += char(symbol);
+
+				code = 0;
+				len = 0;
+			}
+			else
+			if (len == max_code_length) {
+				return false;
+			}
+		}
+	}
+
+	// The padding must be shorter than a byte, and made of the most significant bits of EOS.
+	return len < 8 && code == (std::uint32_t(1) << len) - 1;
+}
+
+decoder::decoder(std::size_t max_table_size, std::size_t max_list_size)
+	: max_table_size_(max_table_size)
+	, max_list_size_(max_list_size)
+	, current_max_table_size_(max_table_size)
+{
+}
+
+bool decoder::get_field(std::size_t index, header_field &out) const
+{
+	if (index == 0) {
+		return false;
+	}
+
+	if (index <= static_table_size) {
+		out.name = static_table[index-1].first;
+		out.value = static_table[index-1].second;
+		return true;
+	}
+
+	index -= static_table_size + 1;
+
+	if (index >= table_.size()) {
+		return false;
+	}
+
+	out = table_[index];
+	return true;
+}
+
+void decoder::evict_to(std::size_t size)
+{
+	while (table_size_ > size && !table_.empty()) {
+		table_size_ -= table_.back().name.size() + table_.back().value.size() + entry_overhead;
+		table_.pop_back();
+	}
+}
+
+void decoder::insert(header_field f)
+{
+	auto size = f.name.size() + f.value.size() + entry_overhead;
+
+	// An entry bigger than the whole table empties it, and isn't added.
+	if (size > current_max_table_size_) {
+		evict_to(0);
+		return;
+	}
+
+	evict_to(current_max_table_size_ - size);
+
+	table_size_ += size;
+	table_.push_front(std::move(f));
+}
+
+bool decoder::decode(std::string_view block, std::vector<header_field> &out)
+{
+	std::size_t list_size{};
+	bool got_fields{};
+
+	while (!block.empty()) {
+		auto first = std::uint8_t(block.front());
+
+		if ((first & 0xe0) == 0x20) {
+			// Dynamic table size update: it must come before the fields.
+			std::uint64_t size{};
+			if (got_fields || !decode_integer(block, 5, size) || size > max_table_size_) {
+				return false;
+			}
+
+			current_max_table_size_ = std::size_t(size);
+			evict_to(current_max_table_size_);
+			continue;
+		}
+
+		header_field f;
+
+		if (first & 0x80) {
+			// Indexed field.
+			std::uint64_t index{};
+			if (!decode_integer(block, 7, index) || !get_field(std::size_t(index), f)) {
+				return false;
+			}
+		}
+		else {
+			// Literal field: with incremental indexing, without indexing, or never indexed.
+			bool const indexing = (first & 0xc0) == 0x40;
+
+			std::uint64_t index{};
+			if (!decode_integer(block, indexing ? 6 : 4, index)) {
+				return false;
+			}
+
+			if (index == 0) {
+				if (!decode_string(block, f.name)) {
+					return false;
+				}
+			}
+			else {
+				header_field indexed;
+				if (!get_field(std::size_t(index), indexed)) {
+					return false;
+				}
+
+				f.name = std::move(indexed.name);
+			}
+
+			if (!decode_string(block, f.value)) {
+				return false;
+			}
+
+			if (indexing) {
+				insert(f);
+			}
+		}
+
+		list_size += f.name.size() + f.value.size() + entry_overhead;
+		if (list_size > max_list_size_) {
+			return false;
+		}
+
+		got_fields = true;
+		out.push_back(std::move(f));
+	}
+
+	return true;
+}
+
+void encoder::encode(std::string_view name, std::string_view value, fz::buffer &out)
+{
+	std::size_t name_index{};
+
+	for (std::size_t i = 0; i < static_table_size; ++i) {
+		if (static_table[i].first != name) {
+			continue;
+		}
+
+		if (static_table[i].second == value) {
+			encode_integer(i + 1, 7, 0x80, out);
+			return;
+		}
+
+		if (!name_index) {
+			name_index = i + 1;
+		}
+	}
+
+	// Cookies and credentials are marked as never to be indexed, should an intermediary recompress them.
+	bool const sensitive = name == "set-cookie" || name == "authorization" || name == "www-authenticate";
+
+	encode_integer(name_index, 4, sensitive ? 0x10 : 0x00, out);
+
+	if (!name_index) {
+		encode_string(name, out);
+	}
+
+	encode_string(value, out);
+}
+
+}
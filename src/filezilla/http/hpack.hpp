@@ -0,0 +1,72 @@
+#ifndef FZ_HTTP_HPACK_HPP
+#define FZ_HTTP_HPACK_HPP
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <libfilezilla/buffer.hpp>
+
+/*
+ * The compression of the header fields of HTTP/2, as per RFC 7541.
+ */
+
+namespace fz::http::hpack {
+
+struct header_field
+{
+	std::string name;
+	std::string value;
+};
+
+/// \brief Decodes the header blocks received on a connection. It keeps the dynamic table of the connection,
+/// hence all the blocks received on it must be decoded, in the order they were received, by the same decoder.
+class decoder
+{
+public:
+	/// \param max_table_size the size the peer's encoder is allowed to grow the dynamic table to, as told it with SETTINGS_HEADER_TABLE_SIZE.
+	/// \param max_list_size how big the decoded fields of a block can be at most, counted as RFC 9113 does for SETTINGS_MAX_HEADER_LIST_SIZE.
+	explicit decoder(std::size_t max_table_size = 4096, std::size_t max_list_size = 64*1024);
+
+	/// Appends the fields of the whole header block \p block to \p out.
+	/// \returns false if the block is malformed or too big. The state of the decoder is then undefined, and the connection must be closed.
+	bool decode(std::string_view block, std::vector<header_field> &out);
+
+private:
+	bool get_field(std::size_t index, header_field &out) const;
+	void insert(header_field f);
+	void evict_to(std::size_t size);
+
+	std::size_t max_table_size_;
+	std::size_t max_list_size_;
+	std::size_t table_size_{};
+	std::size_t current_max_table_size_;
+	std::deque<header_field> table_;
+};
+
+/// \brief Encodes header blocks.
+/// It never adds to the dynamic table, hence it keeps no state and needs no dynamic table size update ever to be sent,
+/// whatever the size of the table the peer allows: the fields are referenced from the static table where they can be,
+/// and otherwise their names are, and their values are Huffman coded when that makes them shorter.
+class encoder
+{
+public:
+	/// Appends the encoding of the field to \p out. The name must be in lower case already.
+	static void encode(std::string_view name, std::string_view value, fz::buffer &out);
+};
+
+/// Appends the Huffman coding of \p s to \p out.
+void huffman_encode(std::string_view s, fz::buffer &out);
+
+/// \returns the size of the Huffman coding of \p s, in bytes.
+std::size_t huffman_encoded_size(std::string_view s);
+
+/// Appends the decoding of the Huffman coded \p s to \p out.
+/// \returns false if \p s is not a valid coding.
+bool huffman_decode(std::string_view s, std::string &out);
+
+}
+
+#endif // FZ_HTTP_HPACK_HPP
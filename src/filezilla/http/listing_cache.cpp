@@ -0,0 +1,326 @@
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <tuple>
+
+#include <libfilezilla/encode.hpp>
+#include <libfilezilla/format.hpp>
+#include <libfilezilla/uri.hpp>
+
+#include "listing_cache.hpp"
+
+namespace fz::http {
+
+namespace {
+
+struct key_value
+{
+	std::int64_t value{};
+	std::string_view name;
+
+	bool operator<(const key_value &rhs) const
+	{
+		return std::tie(value, name) < std::tie(rhs.value, rhs.name);
+	}
+};
+
+std::int64_t milliseconds_of(const datetime &t)
+{
+	if (t.empty()) {
+		return -1;
+	}
+
+	return (t - datetime(0, datetime::milliseconds)).get_milliseconds();
+}
+
+key_value key_of(const tvfs::entry &e, listing_cache::sort_key k)
+{
+	switch (k) {
+		case listing_cache::sort_key::size:
+			return { e.size(), e.name() };
+
+		case listing_cache::sort_key::mtime:
+			return { milliseconds_of(e.mtime()), e.name() };
+
+		case listing_cache::sort_key::name:
+			break;
+	}
+
+	return { 0, e.name() };
+}
+
+// The first two characters tell which order the cursor belongs to.
+std::string order_tag(const listing_cache::page_request &req)
+{
+	static constexpr char keys[] = { 'n', 's', 'm' };
+
+	return { keys[std::size_t(req.key)], req.descending ? 'd' : 'a' };
+}
+
+std::string encode_cursor(const listing_cache::page_request &req, const key_value &k)
+{
+	return base64_encode(fz::sprintf("%s%d/%s", order_tag(req), k.value, k.name), base64_type::url, false);
+}
+
+bool decode_cursor(const listing_cache::page_request &req, std::string &decoded, key_value &k)
+{
+	decoded = base64_decode_s(req.cursor);
+
+	auto tag = order_tag(req);
+	if (decoded.size() < tag.size() || decoded.compare(0, tag.size(), tag) != 0) {
+		return false;
+	}
+
+	auto slash = decoded.find('/', tag.size());
+	if (slash == std::string::npos) {
+		return false;
+	}
+
+	auto value = std::string_view(decoded).substr(tag.size(), slash - tag.size());
+	k.value = fz::to_integral<std::int64_t>(value, std::numeric_limits<std::int64_t>::min());
+	k.name = std::string_view(decoded).substr(slash + 1);
+
+	return k.value != std::numeric_limits<std::int64_t>::min();
+}
+
+char lower(char c)
+{
+	return (c >= 'A' && c <= 'Z') ? char(c - 'A' + 'a') : c;
+}
+
+bool glob_matches(std::string_view pattern, std::string_view s)
+{
+	std::size_t p = 0, i = 0;
+	std::size_t star = std::string_view::npos, star_i = 0;
+
+	while (i < s.size()) {
+		if (p < pattern.size() && (pattern[p] == '?' || lower(pattern[p]) == lower(s[i]))) {
+			++p;
+			++i;
+		}
+		else
+		if (p < pattern.size() && pattern[p] == '*') {
+			star = p++;
+			star_i = i;
+		}
+		else
+		if (star != std::string_view::npos) {
+			p = star + 1;
+			i = ++star_i;
+		}
+		else {
+			return false;
+		}
+	}
+
+	while (p < pattern.size() && pattern[p] == '*') {
+		++p;
+	}
+
+	return p == pattern.size();
+}
+
+}
+
+listing_cache::page_request::result listing_cache::page_request::parse(std::string_view query)
+{
+	*this = {};
+
+	if (query.empty()) {
+		return ignored;
+	}
+
+	query_string q(query);
+	auto &pairs = q.pairs();
+
+	bool found = false;
+
+	if (auto it = pairs.find("limit"); it != pairs.end()) {
+		found = true;
+		limit = fz::to_integral<std::size_t>(it->second, std::size_t(-1));
+		if (limit == std::size_t(-1)) {
+			return invalid;
+		}
+	}
+
+	if (auto it = pairs.find("cursor"); it != pairs.end()) {
+		found = true;
+		cursor = it->second;
+	}
+
+	if (auto it = pairs.find("sort"); it != pairs.end()) {
+		found = true;
+
+		if (it->second == "name") {
+			key = sort_key::name;
+		}
+		else
+		if (it->second == "size") {
+			key = sort_key::size;
+		}
+		else
+		if (it->second == "mtime") {
+			key = sort_key::mtime;
+		}
+		else {
+			return invalid;
+		}
+	}
+
+	if (auto it = pairs.find("order"); it != pairs.end()) {
+		found = true;
+
+		if (it->second == "desc") {
+			descending = true;
+		}
+		else
+		if (it->second != "asc") {
+			return invalid;
+		}
+	}
+
+	if (auto it = pairs.find("filter"); it != pairs.end()) {
+		found = true;
+		filter = it->second;
+	}
+
+	return found ? valid : ignored;
+}
+
+bool listing_cache::snapshot::get_page(const page_request &req, std::vector<tvfs::entry> &out, std::string &next_cursor) const
+{
+	out.clear();
+	next_cursor.clear();
+
+	auto entry_at = [&](std::size_t pos) -> const tvfs::entry & {
+		switch (req.key) {
+			case sort_key::size: return entries_[by_size_[pos]];
+			case sort_key::mtime: return entries_[by_mtime_[pos]];
+			case sort_key::name: break;
+		}
+
+		return entries_[pos];
+	};
+
+	// The position of the first entry whose key isn't less than k, or, if after is true, whose key is greater than k.
+	auto bound = [&](const key_value &k, bool after) {
+		std::size_t lo = 0, hi = entries_.size();
+
+		while (lo < hi) {
+			auto mid = lo + (hi - lo) / 2;
+			auto mk = key_of(entry_at(mid), req.key);
+
+			if (after ? !(k < mk) : mk < k) {
+				lo = mid + 1;
+			}
+			else {
+				hi = mid;
+			}
+		}
+
+		return lo;
+	};
+
+	std::size_t pos = req.descending ? entries_.size() : 0;
+
+	if (!req.cursor.empty()) {
+		std::string decoded;
+		key_value k;
+
+		if (!decode_cursor(req, decoded, k)) {
+			return false;
+		}
+
+		pos = bound(k, !req.descending);
+	}
+
+	while (req.descending ? pos > 0 : pos < entries_.size()) {
+		auto &e = entry_at(req.descending ? --pos : pos++);
+
+		if (!req.filter.empty() && !glob_matches(req.filter, e.name())) {
+			continue;
+		}
+
+		if (req.limit && out.size() == req.limit) {
+			next_cursor = encode_cursor(req, key_of(out.back(), req.key));
+			break;
+		}
+
+		out.push_back(e);
+	}
+
+	return true;
+}
+
+listing_cache::listing_cache(std::size_t max_snapshots, duration max_age)
+	: max_snapshots_(std::max(max_snapshots, std::size_t(1)))
+	, max_age_(max_age)
+{
+}
+
+std::shared_ptr<const listing_cache::snapshot> listing_cache::get(std::string_view tvfs_path, tvfs::entries_iterator &it)
+{
+	scoped_lock lock(mutex_);
+
+	if (auto s = snapshots_.find(tvfs_path); s != snapshots_.end()) {
+		auto &snap = *s->second;
+
+		if (!it.mtime().empty() && snap.mtime_ == it.mtime() && monotonic_clock::now() - snap.taken_ < max_age_) {
+			return s->second;
+		}
+	}
+
+	// The directory is read without holding the lock, since it can take long and other directories may be asked for meanwhile.
+	lock.unlock();
+
+	auto snap = std::make_shared<snapshot>();
+	snap->mtime_ = it.mtime();
+	snap->taken_ = monotonic_clock::now();
+
+	while (it.has_next()) {
+		if (auto e = it.next()) {
+			snap->entries_.push_back(std::move(e));
+		}
+	}
+
+	auto &entries = snap->entries_;
+
+	std::sort(entries.begin(), entries.end(), [](const tvfs::entry &lhs, const tvfs::entry &rhs) {
+		return lhs.name() < rhs.name();
+	});
+
+	// Since the entries are sorted by name already, a stable sort breaks the ties by name.
+	snap->by_size_.resize(entries.size());
+	std::iota(snap->by_size_.begin(), snap->by_size_.end(), 0);
+	std::stable_sort(snap->by_size_.begin(), snap->by_size_.end(), [&](std::uint32_t lhs, std::uint32_t rhs) {
+		return entries[lhs].size() < entries[rhs].size();
+	});
+
+	std::vector<std::int64_t> mtimes(entries.size());
+	std::transform(entries.begin(), entries.end(), mtimes.begin(), [](const tvfs::entry &e) {
+		return milliseconds_of(e.mtime());
+	});
+
+	snap->by_mtime_.resize(entries.size());
+	std::iota(snap->by_mtime_.begin(), snap->by_mtime_.end(), 0);
+	std::stable_sort(snap->by_mtime_.begin(), snap->by_mtime_.end(), [&](std::uint32_t lhs, std::uint32_t rhs) {
+		return mtimes[lhs] < mtimes[rhs];
+	});
+
+	lock.lock();
+
+	if (snapshots_.size() >= max_snapshots_ && !snapshots_.count(tvfs_path)) {
+		auto oldest = std::min_element(snapshots_.begin(), snapshots_.end(), [](const auto &lhs, const auto &rhs) {
+			return lhs.second->taken_ < rhs.second->taken_;
+		});
+
+		snapshots_.erase(oldest);
+	}
+
+	auto &slot = snapshots_[std::string(tvfs_path)];
+	slot = std::move(snap);
+
+	return slot;
+}
+
+}
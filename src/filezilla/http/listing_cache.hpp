@@ -0,0 +1,109 @@
+#ifndef FZ_HTTP_LISTING_CACHE_HPP
+#define FZ_HTTP_LISTING_CACHE_HPP
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <libfilezilla/mutex.hpp>
+#include <libfilezilla/time.hpp>
+
+#include "../tvfs/entry.hpp"
+
+namespace fz::http {
+
+/// \brief Serves directory listings one page at a time, sorted and filtered as asked.
+///
+/// The first request for a directory takes a snapshot of it, sorted by each of the keys at once.
+/// The following requests, as long as the directory doesn't change, are served from the snapshot:
+/// finding where a page begins takes a binary search, whatever its number, hence a page costs
+/// as much as its own entries, not as much as the whole directory.
+///
+/// Pages are chained with cursors, which tell the last entry of the previous page, rather than its position:
+/// a cursor stays valid across snapshots, and entries being added or removed meanwhile never cause other
+/// entries to be skipped or to be listed twice.
+class listing_cache
+{
+public:
+	enum class sort_key
+	{
+		name,
+		size,
+		mtime
+	};
+
+	struct page_request
+	{
+		sort_key key{sort_key::name};
+		bool descending{};
+
+		/// A glob, where * matches any sequence of characters and ? any single character. Case insensitive, for ASCII letters.
+		std::string filter;
+
+		/// The maximum number of entries in a page. 0 means no limit.
+		std::size_t limit{};
+
+		/// The cursor returned along with the previous page. Empty for the first page.
+		std::string cursor;
+
+		enum result {
+			/// The query doesn't ask for a page: the whole directory must be listed, the usual way.
+			ignored,
+
+			/// The query asks for a page.
+			valid,
+
+			/// The query asks for a page, but some of its parameters are malformed.
+			invalid
+		};
+
+		/// Parses the "limit", "cursor", "sort", "order" and "filter" parameters of \p query.
+		result parse(std::string_view query);
+	};
+
+	class snapshot
+	{
+	public:
+		/// Fills \p out with the page \p req asks for, and \p next_cursor with the cursor of the page that follows, if any.
+		/// \returns false if the cursor is malformed, or was returned for a different sort order.
+		bool get_page(const page_request &req, std::vector<tvfs::entry> &out, std::string &next_cursor) const;
+
+		const datetime &mtime() const
+		{
+			return mtime_;
+		}
+
+	private:
+		friend listing_cache;
+
+		datetime mtime_;
+		monotonic_clock taken_;
+
+		// Sorted by name.
+		std::vector<tvfs::entry> entries_;
+
+		// Indices into entries_, sorted by size and by mtime. Ties are broken by name.
+		std::vector<std::uint32_t> by_size_;
+		std::vector<std::uint32_t> by_mtime_;
+	};
+
+	/// \param max_snapshots how many directories are kept at most. The least recently taken snapshot makes room for a new one.
+	/// \param max_age how long a snapshot is used at most. Files written to don't change the mtime of their directory,
+	///        hence their size and mtime in the snapshot would otherwise never be updated.
+	listing_cache(std::size_t max_snapshots = 16, duration max_age = duration::from_seconds(30));
+
+	/// \returns the snapshot of the directory at \p tvfs_path, taking a new one if there's none yet or if the one there is stale.
+	/// \param it an iterator over the children of the directory, just obtained from the tvfs engine. It's used only if a new snapshot is taken.
+	std::shared_ptr<const snapshot> get(std::string_view tvfs_path, tvfs::entries_iterator &it);
+
+private:
+	std::size_t max_snapshots_;
+	duration max_age_;
+
+	fz::mutex mutex_;
+	std::map<std::string, std::shared_ptr<const snapshot>, std::less<>> snapshots_;
+};
+
+}
+
+#endif // FZ_HTTP_LISTING_CACHE_HPP
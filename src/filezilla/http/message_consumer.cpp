@@ -128,6 +128,11 @@ void message_consumer::expect_no_body()
 	remaining_chunk_size_ = 0;
 }
 
+bool message_consumer::expects_body() const
+{
+	return transfer_encoding_ == chunked || remaining_chunk_size_ != 0;
+}
+
 void message_consumer::set_body_consumer(consumer_interface &body_consumer)
 {
 	body_consumer_ = &body_consumer;
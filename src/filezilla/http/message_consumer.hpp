@@ -26,6 +26,10 @@ protected:
 	int consume_buffer() override;
 
 	void expect_no_body();
+
+	/// \returns whether a body follows the headers of the message being received. Meaningful only once the headers have all been received.
+	bool expects_body() const;
+
 	void set_body_consumer(buffer_operator::consumer_interface &body_consumer);
 
 private:
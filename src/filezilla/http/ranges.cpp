@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <charconv>
+
+#include <libfilezilla/format.hpp>
+#include <libfilezilla/string.hpp>
+
+#include "ranges.hpp"
+
+namespace fz::http {
+
+std::string byte_range::content_range(std::uint64_t complete_size) const
+{
+	return fz::sprintf("bytes %d-%d/%d", first, last, complete_size);
+}
+
+namespace {
+
+bool parse_number(std::string_view s, std::uint64_t &n)
+{
+	if (s.empty())
+		return false;
+
+	auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), n);
+	return ec == std::errc() && end == s.data() + s.size();
+}
+
+}
+
+byte_ranges::result byte_ranges::parse(std::string_view value, std::uint64_t size, std::size_t max_ranges)
+{
+	clear();
+
+	static constexpr std::string_view unit = "bytes=";
+
+	value = fz::trimmed(value);
+	if (value.size() < unit.size() || !fz::equal_insensitive_ascii(value.substr(0, unit.size()), unit))
+		return ignored;
+
+	value.remove_prefix(unit.size());
+
+	auto malformed = [this] {
+		clear();
+		return ignored;
+	};
+
+	std::size_t count = 0;
+
+	for (auto spec: fz::strtokenizer(value, ",", true)) {
+		spec = fz::trimmed(spec);
+		if (spec.empty())
+			continue;
+
+		if (++count > max_ranges)
+			return malformed();
+
+		auto dash = spec.find('-');
+		if (dash == std::string_view::npos)
+			return malformed();
+
+		auto first_s = fz::trimmed(spec.substr(0, dash));
+		auto last_s = fz::trimmed(spec.substr(dash + 1));
+
+		std::uint64_t first{}, last{};
+
+		if (first_s.empty()) {
+			// A suffix range: the last N bytes.
+			std::uint64_t suffix{};
+			if (!parse_number(last_s, suffix))
+				return malformed();
+
+			if (suffix == 0 || size == 0)
+				continue;
+
+			first = size > suffix ? size - suffix : 0;
+			last = size - 1;
+		}
+		else {
+			if (!parse_number(first_s, first))
+				return malformed();
+
+			if (last_s.empty())
+				last = std::uint64_t(-1);
+			else
+			if (!parse_number(last_s, last) || last < first)
+				return malformed();
+
+			if (first >= size)
+				continue;
+
+			last = std::min(last, size - 1);
+		}
+
+		push_back({first, last});
+	}
+
+	if (count == 0)
+		return ignored;
+
+	if (empty())
+		return unsatisfiable;
+
+	merge();
+
+	return satisfiable;
+}
+
+void byte_ranges::add(const byte_range &r)
+{
+	if (r.last < r.first)
+		return;
+
+	push_back(r);
+	merge();
+}
+
+bool byte_ranges::covers(std::uint64_t complete_size) const
+{
+	if (complete_size == 0)
+		return true;
+
+	return size() == 1 && front().first == 0 && front().last >= complete_size - 1;
+}
+
+std::string byte_ranges::to_string() const
+{
+	std::string res;
+
+	for (auto &r: *this) {
+		if (!res.empty())
+			res += ", ";
+
+		res += fz::sprintf("%d-%d", r.first, r.last);
+	}
+
+	return res;
+}
+
+void byte_ranges::merge()
+{
+	if (empty())
+		return;
+
+	std::sort(begin(), end(), [](const byte_range &a, const byte_range &b) {
+		return a.first < b.first;
+	});
+
+	auto merged = begin();
+
+	for (auto it = begin() + 1; it < end(); ++it) {
+		if (it->first <= merged->last + 1)
+			merged->last = std::max(merged->last, it->last);
+		else
+			*++merged = *it;
+	}
+
+	erase(merged + 1, end());
+}
+
+}
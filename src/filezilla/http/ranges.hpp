@@ -0,0 +1,66 @@
+#ifndef FZ_HTTP_RANGES_HPP
+#define FZ_HTTP_RANGES_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fz::http {
+
+/// \brief A range of bytes of a representation, as requested with the Range header. Both ends are inclusive.
+struct byte_range
+{
+	std::uint64_t first{};
+	std::uint64_t last{};
+
+	std::uint64_t size() const
+	{
+		return last - first + 1;
+	}
+
+	/// \returns the value of the Content-Range header for this range of a representation of \p complete_size bytes.
+	std::string content_range(std::uint64_t complete_size) const;
+
+	bool operator==(const byte_range &rhs) const
+	{
+		return first == rhs.first && last == rhs.last;
+	}
+};
+
+class byte_ranges: public std::vector<byte_range>
+{
+public:
+	using vector::vector;
+
+	enum result {
+		/// The Range header is missing, malformed or asks for too many ranges: the whole representation must be sent.
+		ignored,
+
+		/// At least one of the ranges overlaps the representation: a 206 Partial Content response must be sent.
+		satisfiable,
+
+		/// None of the ranges overlap the representation: a 416 Range Not Satisfiable response must be sent.
+		unsatisfiable
+	};
+
+	/// \brief Parses the value of a Range header, against a representation of \p size bytes.
+	/// The resulting ranges are clamped to the representation, sorted, and overlapping or adjacent ones are merged.
+	result parse(std::string_view value, std::uint64_t size, std::size_t max_ranges = 16);
+
+	/// Adds \p r, keeping the ranges sorted and merging it with those it overlaps or is adjacent to.
+	void add(const byte_range &r);
+
+	/// \returns whether the ranges cover all of the bytes from 0 to \p complete_size - 1.
+	bool covers(std::uint64_t complete_size) const;
+
+	/// \returns the ranges as a comma separated list of first-last pairs, like "0-99, 200-299".
+	std::string to_string() const;
+
+private:
+	void merge();
+};
+
+}
+
+#endif // FZ_HTTP_RANGES_HPP
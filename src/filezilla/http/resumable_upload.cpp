@@ -0,0 +1,300 @@
+#include <limits>
+#include <map>
+
+#include <libfilezilla/encode.hpp>
+#include <libfilezilla/format.hpp>
+#include <libfilezilla/mutex.hpp>
+#include <libfilezilla/util.hpp>
+
+#include "resumable_upload.hpp"
+
+#include "../util/filesystem.hpp"
+#include "../util/io.hpp"
+
+namespace fz::http {
+
+namespace {
+
+constexpr std::string_view data_suffix = ".fzupload";
+constexpr std::string_view log_suffix = ".ranges";
+constexpr std::size_t id_size = 26;
+
+// Serializes the appends to the logs, since parts of the same upload can be received at the same time by different sessions.
+fz::mutex log_mutex;
+
+/// \returns the name of the temporary file \p name belongs to, be it the temporary file itself or its log, or an empty view if it's neither.
+std::string_view data_name_of(std::string_view name)
+{
+	if (fz::ends_with(name, log_suffix)) {
+		name.remove_suffix(log_suffix.size());
+	}
+
+	// A dot, the target's name, a dot, the id and the suffix.
+	if (name.size() < 2 + id_size + data_suffix.size() + 1 || name.front() != '.' || !fz::ends_with(name, data_suffix)) {
+		return {};
+	}
+
+	auto id = name.substr(name.size() - data_suffix.size() - id_size, id_size);
+	if (name[name.size() - data_suffix.size() - id_size - 1] != '.' || !resumable_upload::is_valid_id(id)) {
+		return {};
+	}
+
+	return name;
+}
+
+}
+
+resumable_upload::resumable_upload(tvfs::engine &tvfs, std::string_view tvfs_path, std::string id, std::uint64_t size)
+	: tvfs_(&tvfs)
+	, target_path_(tvfs_path)
+	, id_(std::move(id))
+	, size_(size)
+{
+	auto target = util::fs::absolute_unix_path(tvfs_path);
+
+	data_path_ = (target.parent() / fz::sprintf(".%s.%s%s", target.base().str(), id_, data_suffix)).str();
+	log_path_ = data_path_;
+	log_path_ += log_suffix;
+}
+
+bool resumable_upload::is_valid_id(std::string_view id)
+{
+	if (id.size() != id_size) {
+		return false;
+	}
+
+	for (auto c: id) {
+		if (!(c >= 'a' && c <= 'z') && !(c >= '0' && c <= '9')) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+result resumable_upload::begin(resumable_upload &out, tvfs::engine &tvfs, std::string_view tvfs_path, std::uint64_t size, std::uint64_t max_size)
+{
+	if (!util::fs::absolute_unix_path(tvfs_path) || tvfs_path.back() == '/' || size > std::uint64_t(std::numeric_limits<std::int64_t>::max())) {
+		return { result::invalid };
+	}
+
+	if (size > max_size) {
+		return { result::resource_limit };
+	}
+
+	auto id = fz::base32_encode(fz::random_bytes(16), fz::base32_type::locale_safe, false);
+	resumable_upload u(tvfs, tvfs_path, std::move(id), size);
+
+	tvfs::file_holder data;
+	if (auto res = tvfs.open_file(data, u.data_path_, file::writing, 0); !res) {
+		return res;
+	}
+
+	// The file gets its final size straight away, so that parts can be written anywhere in it. Where the filesystem allows it,
+	// the file is sparse, hence this costs nothing, but the space isn't reserved either.
+	if (data->seek(std::int64_t(size), file::seek_mode::begin) != std::int64_t(size) || !data->truncate()) {
+		data = {};
+		(void)tvfs.remove_file(u.data_path_);
+		return { result::other };
+	}
+
+	data = {};
+
+	tvfs::file_holder log;
+	if (auto res = tvfs.open_file(log, u.log_path_, file::writing, 0); !res) {
+		(void)tvfs.remove_file(u.data_path_);
+		return res;
+	}
+
+	out = std::move(u);
+	return { result::ok };
+}
+
+void resumable_upload::remove_stale(tvfs::engine &tvfs, std::string_view tvfs_dir, duration max_age)
+{
+	auto dir = util::fs::absolute_unix_path(tvfs_dir);
+	if (!dir) {
+		return;
+	}
+
+	// The most recent mtime of the two files of each upload: an upload is stale only if neither of them has been written to lately.
+	std::map<std::string, datetime> uploads;
+
+	{
+		tvfs::entries_iterator it;
+		if (!tvfs.get_entries(it, dir.str(), tvfs::traversal_mode::only_children)) {
+			return;
+		}
+
+		while (it.has_next()) {
+			auto e = it.next();
+			if (!e || e.type() != local_filesys::file) {
+				continue;
+			}
+
+			auto data_name = data_name_of(e.name());
+			if (data_name.empty()) {
+				continue;
+			}
+
+			auto &latest = uploads[std::string(data_name)];
+			if (e.mtime().empty() || latest.empty() || latest < e.mtime()) {
+				latest = e.mtime().empty() ? datetime::now() : e.mtime();
+			}
+		}
+	}
+
+	auto now = datetime::now();
+
+	for (auto &[data_name, latest]: uploads) {
+		if (now - latest < max_age) {
+			continue;
+		}
+
+		auto data_path = (dir / data_name).str();
+
+		// The log goes first, like when aborting: once it's gone, the upload can't be found anymore.
+		(void)tvfs.remove_file(data_path + std::string(log_suffix));
+		(void)tvfs.remove_file(data_path);
+	}
+}
+
+result resumable_upload::find(resumable_upload &out, tvfs::engine &tvfs, std::string_view tvfs_path, std::string_view id)
+{
+	if (!is_valid_id(id) || !util::fs::absolute_unix_path(tvfs_path) || tvfs_path.back() == '/') {
+		return { result::invalid };
+	}
+
+	resumable_upload u(tvfs, tvfs_path, std::string(id), 0);
+
+	// Without the log there's no upload, whatever the temporary file that may be left.
+	if (auto log = tvfs.get_entry(u.log_path_); !log.first) {
+		return log.first;
+	}
+
+	auto [res, e] = tvfs.get_entry(u.data_path_);
+	if (!res) {
+		return res;
+	}
+
+	if (e.type() != local_filesys::file || e.size() < 0) {
+		return { result::nofile };
+	}
+
+	u.size_ = std::uint64_t(e.size());
+
+	out = std::move(u);
+	return { result::ok };
+}
+
+result resumable_upload::get_received(byte_ranges &out) const
+{
+	out.clear();
+
+	if (!tvfs_) {
+		return { result::invalid };
+	}
+
+	tvfs::file_holder log;
+	if (auto res = tvfs_->open_file(log, log_path_, file::reading, 0); !res) {
+		return res;
+	}
+
+	fz::buffer buf;
+	if (!util::io::read(*log, buf)) {
+		return { result::other };
+	}
+
+	auto content = buf.to_view();
+
+	// Only complete lines count: a line cut short by a crash belongs to a part whose reception was never confirmed to the client.
+	while (true) {
+		auto eol = content.find('\n');
+		if (eol == std::string_view::npos) {
+			break;
+		}
+
+		auto line = content.substr(0, eol);
+		content.remove_prefix(eol + 1);
+
+		auto dash = line.find('-');
+		if (dash == std::string_view::npos) {
+			continue;
+		}
+
+		auto first = fz::to_integral<std::uint64_t>(line.substr(0, dash), std::uint64_t(-1));
+		auto last = fz::to_integral<std::uint64_t>(line.substr(dash + 1), std::uint64_t(-1));
+
+		if (first > last || last >= size_) {
+			continue;
+		}
+
+		out.add({first, last});
+	}
+
+	return { result::ok };
+}
+
+result resumable_upload::open_part(tvfs::file_holder &out, std::uint64_t offset)
+{
+	if (!tvfs_ || offset > size_) {
+		return { result::invalid };
+	}
+
+	return tvfs_->open_file_at(out, data_path_, std::int64_t(offset));
+}
+
+result resumable_upload::add_received(const byte_range &r)
+{
+	if (!tvfs_ || r.first > r.last || r.last >= size_) {
+		return { result::invalid };
+	}
+
+	scoped_lock lock(log_mutex);
+
+	tvfs::file_holder log;
+	if (auto res = tvfs_->open_file(log, log_path_, file::writing, tvfs::rest_mode::append); !res) {
+		return res;
+	}
+
+	if (!util::io::write(*log, fz::sprintf("%d-%d\n", r.first, r.last)) || !log->fsync()) {
+		return { result::other };
+	}
+
+	return { result::ok };
+}
+
+result resumable_upload::end()
+{
+	if (!tvfs_) {
+		return { result::invalid };
+	}
+
+	if (auto res = tvfs_->rename(data_path_, target_path_); !res) {
+		return res;
+	}
+
+	(void)tvfs_->remove_file(log_path_);
+
+	*this = {};
+	return { result::ok };
+}
+
+result resumable_upload::abort()
+{
+	if (!tvfs_) {
+		return { result::invalid };
+	}
+
+	// The log goes first: once it's gone, the upload can't be found anymore.
+	if (auto res = tvfs_->remove_file(log_path_); !res) {
+		return res;
+	}
+
+	(void)tvfs_->remove_file(data_path_);
+
+	*this = {};
+	return { result::ok };
+}
+
+}
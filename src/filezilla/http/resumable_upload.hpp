@@ -0,0 +1,79 @@
+#ifndef FZ_HTTP_RESUMABLE_UPLOAD_HPP
+#define FZ_HTTP_RESUMABLE_UPLOAD_HPP
+
+#include "../tvfs/engine.hpp"
+
+#include "ranges.hpp"
+
+namespace fz::http {
+
+/// \brief An upload whose parts can be sent in any order, possibly at the same time, and resumed after any interruption.
+///
+/// The data is written, at the offsets the parts belong to, into a temporary file that sits next to the target,
+/// and which is renamed to the target once the whole of it has been received. The ranges received so far are
+/// appended, once they're on disk, to a log that sits next to the temporary file. All of the state of the upload
+/// is in those two files, hence it survives a restart of the server.
+///
+/// Both files are accessed through the tvfs engine, hence with the permissions of the user the upload belongs to.
+class resumable_upload
+{
+public:
+	resumable_upload() = default;
+
+	/// Starts an upload of \p size bytes, which will end up at \p tvfs_path.
+	/// Uploads bigger than \p max_size are refused with result::resource_limit, since the temporary file is extended to their size straight away.
+	[[nodiscard]] static result begin(resumable_upload &out, tvfs::engine &tvfs, std::string_view tvfs_path, std::uint64_t size, std::uint64_t max_size);
+
+	/// Finds the upload with the given \p id, which was started for \p tvfs_path.
+	[[nodiscard]] static result find(resumable_upload &out, tvfs::engine &tvfs, std::string_view tvfs_path, std::string_view id);
+
+	static bool is_valid_id(std::string_view id);
+
+	/// Removes the uploads in \p tvfs_dir, and what's left of them, that haven't been written to for longer than \p max_age:
+	/// those whose client went away for good would otherwise be kept forever.
+	static void remove_stale(tvfs::engine &tvfs, std::string_view tvfs_dir, duration max_age);
+
+	explicit operator bool() const
+	{
+		return tvfs_ != nullptr;
+	}
+
+	const std::string &id() const
+	{
+		return id_;
+	}
+
+	std::uint64_t size() const
+	{
+		return size_;
+	}
+
+	/// \returns in \p out the ranges received so far.
+	[[nodiscard]] result get_received(byte_ranges &out) const;
+
+	/// Opens the temporary file for writing at \p offset, leaving everything else in it as it is.
+	[[nodiscard]] result open_part(tvfs::file_holder &out, std::uint64_t offset);
+
+	/// Records that \p r has been received. The data must have already been synced to disk.
+	[[nodiscard]] result add_received(const byte_range &r);
+
+	/// Moves the temporary file to the target and forgets about the upload. It's up to the caller to make sure it's complete.
+	[[nodiscard]] result end();
+
+	/// Removes the temporary file and forgets about the upload.
+	[[nodiscard]] result abort();
+
+private:
+	resumable_upload(tvfs::engine &tvfs, std::string_view tvfs_path, std::string id, std::uint64_t size);
+
+	tvfs::engine *tvfs_{};
+	std::string target_path_;
+	std::string data_path_;
+	std::string log_path_;
+	std::string id_;
+	std::uint64_t size_{};
+};
+
+}
+
+#endif // FZ_HTTP_RESUMABLE_UPLOAD_HPP
@@ -5,13 +5,14 @@
 namespace fz::http {
 
 server::server(tcp::server::context &context, event_loop_pool &event_loop_pool, transaction_handler &transaction_handler,
-	tcp::address_list &disallowed_ips, tcp::address_list &allowed_ips, authentication::autobanner &autobanner, logger_interface &logger
+	tcp::address_list &disallowed_ips, tcp::address_list &allowed_ips, authentication::autobanner &autobanner, logger_interface &logger,
+	std::string_view name
 )
 	: tcp::server::delegate<server>(tcp_server_)
 	, tcp::session::factory::base(event_loop_pool, disallowed_ips, allowed_ips, autobanner, logger, "HTTP Server")
 	, transaction_handler_(transaction_handler)
 	, logger_(logger, "HTTP Server")
-	, tcp_server_(context, logger_, *this)
+	, tcp_server_(context, logger_, *this, name)
 {
 }
 
@@ -21,7 +21,8 @@ public:
 	using shared_transaction = std::shared_ptr<transaction>;
 
 	server(tcp::server::context &context, event_loop_pool &event_loop_pool, transaction_handler &request_handler,
-		   tcp::address_list &disallowed_ips, tcp::address_list &allowed_ips, authentication::autobanner &autobanner, logger_interface &logger);
+		   tcp::address_list &disallowed_ips, tcp::address_list &allowed_ips, authentication::autobanner &autobanner, logger_interface &logger,
+		   std::string_view name = "http");
 
 	void set_security_info(const securable_socket::info &info);
 
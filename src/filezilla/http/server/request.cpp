@@ -53,7 +53,7 @@ server::request::~request()
 void server::request::receive_body(std::string &&body, std::function<void (std::string, bool)> on_end)
 {
 	if (auto s = t_.get_session()) {
-		s->receive_body({}, std::move(body), std::move(on_end));
+		s->receive_body({}, t_, std::move(body), std::move(on_end));
 	}
 	else {
 		on_end(std::move(body), false);
@@ -63,7 +63,7 @@ void server::request::receive_body(std::string &&body, std::function<void (std::
 void server::request::receive_body(tvfs::file_holder &&file, std::function<void (tvfs::file_holder, bool)> on_end)
 {
 	if (auto s = t_.get_session()) {
-		s->receive_body({}, std::move(file), std::move(on_end));
+		s->receive_body({}, t_, std::move(file), std::move(on_end));
 	}
 	else {
 		on_end(std::move(file), false);
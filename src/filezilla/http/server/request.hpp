@@ -23,7 +23,8 @@ public:
 
 	enum versions {
 		version_1_0,
-		version_1_1
+		version_1_1,
+		version_2
 	} version {};
 
 	request(server::transaction &t);
@@ -3,6 +3,7 @@
 
 #include "../server.hpp"
 #include "../field.hpp"
+#include "../ranges.hpp"
 
 namespace fz::tvfs {
 
@@ -11,6 +12,12 @@ class file_holder;
 
 }
 
+namespace fz::buffer_operator {
+
+class adder_interface;
+
+}
+
 namespace fz::http {
 
 /// \brief Inteface for sending HTTP responses
@@ -39,6 +46,14 @@ public:
 	/// \note After invoking this method, the request handler won't be invoked anymore for the current request.
 	virtual bool send_body(tvfs::file_holder file) = 0;
 
+	/// \brief sends the given ranges of the file as the body of the response
+	/// \note A single range is sent as it is. More ranges are sent as the parts of a multipart/byteranges body delimited by \p boundary,
+	///       each part having \p content_type and its own Content-Range.
+	/// \note The headers describing the ranges are up to the caller: Content-Range for a single range, Content-Type: multipart/byteranges otherwise.
+	/// \note Ends the headers before sending the body, and after sending the body implictly ends the response itself.
+	/// \note After invoking this method, the request handler won't be invoked anymore for the current request.
+	virtual bool send_body(tvfs::file_holder file, const byte_ranges &ranges, std::string_view boundary, std::string_view content_type) = 0;
+
 	/// \brief sends the given tvfs entries listing as the body of the response.
 	/// \note Ends the headers before sending the body, and after sending the body implictly ends the response itself.
 	/// \note After invoking this method, the request handler won't be invoked anymore for the current request.
@@ -47,6 +62,13 @@ public:
 	///       If not set, it will default to text/html.
 	virtual bool send_body(tvfs::entries_iterator it) = 0;
 
+	/// \brief sends whatever \p adder adds to the buffer as the body of the response.
+	/// \note Since the size of the body isn't known in advance, it is sent chunked.
+	/// \note If Content-Type is not set, it will default to application/octet-stream.
+	/// \note Ends the headers before sending the body, and after sending the body implictly ends the response itself.
+	/// \note After invoking this method, the request handler won't be invoked anymore for the current request.
+	virtual bool send_body(std::unique_ptr<buffer_operator::adder_interface> adder) = 0;
+
 	/// \brief Ends the headers and the response itself, and then prepares the session for the next request, unless the "Connection" header was set to close
 	/// in which case it also ends the session.
 	virtual bool send_end() = 0;
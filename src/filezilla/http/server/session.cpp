@@ -1,8 +1,12 @@
+#include <algorithm>
+
 #include "session.hpp"
 #include "session/transaction.hpp"
+#include "session/h2_connection.hpp"
 
 #include "../../util/parser.hpp"
 #include "../../string.hpp"
+#include "../../event_loop_monitor.hpp"
 
 namespace fz::http {
 
@@ -31,8 +35,6 @@ server::session::session(
 	socket_.set_flags(socket::flag_keepalive);
 	socket_.set_keepalive_interval(duration::from_seconds(30));
 
-	shared_transaction_ = std::make_shared<transaction>(event_loop_, *this);
-
 	last_activity_ = monotonic_clock::now();
 
 	if (security_info) {
@@ -43,7 +45,15 @@ server::session::session(
 			channel_.set_buffer_consumer(this);
 			socket_.set_event_handler(this);
 
-			if (!socket_.make_secure_server(security_info_.min_tls_ver, security_info_.cert, {}, {}, {"http/1.1"})) {
+			// HTTP/2 can't be spoken over anything older than TLS 1.2 (RFC 9113, 9.2): it's offered only if nothing older can be negotiated.
+			std::vector<std::string> alpns;
+			if (security_info_.min_tls_ver >= tls_ver::v1_2) {
+				alpns.push_back("h2");
+			}
+
+			alpns.push_back("http/1.1");
+
+			if (!socket_.make_secure_server(security_info_.min_tls_ver, security_info_.cert, {}, {}, std::move(alpns))) {
 				logger_.log_u(logmsg::error, L"socket_.make_secure_server() failed. Shutting down.");
 
 				channel_.set_socket(&socket_);
@@ -66,7 +76,17 @@ server::session::~session()
 {
 	logger_.log_u(logmsg::debug_debug, L"Session destroyed, with ID %d", get_id());
 	remove_handler();
-	shared_transaction_->detach();
+
+	for (auto &t: transactions_) {
+		t->detach();
+	}
+
+	if (h2_) {
+		// The streams must be detached while the channel, whose pipes their bodies send events to, is still there.
+		channel_.set_buffer_adder(nullptr);
+		channel_.set_buffer_consumer(nullptr);
+		h2_.reset();
+	}
 }
 
 void server::session::set_timeouts(const duration &keepalive_timeout, const duration &activity_timeout)
@@ -99,6 +119,11 @@ void server::session::on_timer_event(timer_id id)
 {
 	if (id == keepalive_timer_id_) {
 		logger_.log(logmsg::debug_info, L"Keep Alive timeout (%dms) has expired", keepalive_timeout_.get_milliseconds());
+
+		if (h2_) {
+			h2_->go_away(h2::error_code::no_error);
+		}
+
 		return shutdown(0);
 	}
 	else
@@ -108,10 +133,23 @@ void server::session::on_timer_event(timer_id id)
 		if (delta >= activity_timeout_) {
 			logger_.log(logmsg::debug_info, L"Activity timeout has expired");
 
-			if (shared_transaction_->response_.status_ == transaction::response::waiting_for_code_and_reason) {
-				send_status(408, "Request Timeout") &&
-				send_header(headers::Connection, "close") &&
-				send_end();
+			if (h2_) {
+				// There's no status to tell the client about it: the streams still open are just abandoned.
+				h2_->go_away(h2::error_code::no_error);
+				return shutdown(0);
+			}
+
+			if (transactions_.empty()) {
+				// No request has been received yet: the 408 has one to be the response to, nonetheless.
+				transactions_.push_back(std::make_shared<transaction>(event_loop_, *this));
+			}
+
+			auto &t = *transactions_.front();
+
+			if (t.response_.status_ == transaction::response::waiting_for_code_and_reason) {
+				send_status(t, 408, "Request Timeout") &&
+				send_header(t, headers::Connection, "close") &&
+				send_end(t);
 			}
 			else {
 				shutdown(0);
@@ -135,15 +173,51 @@ void server::session::notify_channel_socket_written_amount(const monotonic_clock
 }
 
 
-void server::session::receive_body(badge<server::request>, std::string &&body, std::function<void (std::string, bool)> on_end)
+void server::session::receive_body(badge<server::request>, server::transaction &st, std::string &&body, std::function<void (std::string, bool)> on_end)
 {
-	auto &consumer = shared_transaction_->request_.body_writer_.emplace<transaction::string_writer>(std::move(body), std::move(on_end));
+	auto &t = static_cast<transaction &>(st);
+
+	if (t.stream_id_) {
+		t.request_.body_writer_.emplace<transaction::string_writer>(std::move(body), std::move(on_end));
+
+		if (!h2_->receive_body(t)) {
+			std::get<transaction::string_writer>(t.request_.body_writer_).on_end(false);
+			t.request_.body_writer_.emplace<transaction::no_writer>();
+		}
+
+		return;
+	}
+
+	if (receiving_ != &t) {
+		on_end(std::move(body), false);
+		return;
+	}
+
+	auto &consumer = t.request_.body_writer_.emplace<transaction::string_writer>(std::move(body), std::move(on_end));
 	set_body_consumer(consumer);
 }
 
-void server::session::receive_body(badge<server::request>, tvfs::file_holder &&file, std::function<void (tvfs::file_holder, bool)> on_end)
+void server::session::receive_body(badge<server::request>, server::transaction &st, tvfs::file_holder &&file, std::function<void (tvfs::file_holder, bool)> on_end)
 {
-	auto &consumer = shared_transaction_->request_.body_writer_.emplace<transaction::file_writer>(std::move(file), logger_, std::move(on_end));
+	auto &t = static_cast<transaction &>(st);
+
+	if (t.stream_id_) {
+		t.request_.body_writer_.emplace<transaction::file_writer>(std::move(file), logger_, std::move(on_end));
+
+		if (!h2_->receive_body(t)) {
+			std::get<transaction::file_writer>(t.request_.body_writer_).on_end(false);
+			t.request_.body_writer_.emplace<transaction::no_writer>();
+		}
+
+		return;
+	}
+
+	if (receiving_ != &t) {
+		on_end(std::move(file), false);
+		return;
+	}
+
+	auto &consumer = t.request_.body_writer_.emplace<transaction::file_writer>(std::move(file), logger_, std::move(on_end));
 	set_body_consumer(consumer);
 }
 
@@ -160,6 +234,16 @@ void server::session::on_socket_event(fz::socket_event_source *source, fz::socke
 
 	if (type == socket_event_flag::connection) {
 		if (source != source->root() && source->root() == socket_.root()) {
+			if (socket_.get_alpn() == "h2") {
+				logger_.log_u(logmsg::debug_info, L"HTTP/2 has been negotiated.");
+
+				// From now on, the connection speaks HTTP/2 frames: they're dealt with by the h2_connection, in place of the session.
+				h2_ = std::make_unique<h2_connection>(*this);
+				channel_.set_buffer_adder(h2_.get());
+				channel_.set_buffer_consumer(h2_.get());
+				h2_->start();
+			}
+
 			// All fine, hand the socket down to the channel.
 			channel_.set_socket(&socket_);
 			return;
@@ -185,47 +269,47 @@ bool server::session::is_alive() const
 
 void server::session::shutdown(int err)
 {
-	shared_transaction_->request_.waiting_for_consumer_event_ = false;
+	waiting_for_consumer_event_ = false;
+	no_more_requests_ = true;
 	channel_.set_buffer_consumer(nullptr);
 	channel_.shutdown(err);
 }
 
 void server::session::operator ()(const event_base &ev)
 {
+	event_loop_monitor::dispatch_scope monitored(*this, ev, get_id());
+
 	if (on_invoker_event(ev))
 		return;
 
 	fz::dispatch<
 		channel::done_event,
 		fz::socket_event,
-		timer_event
+		timer_event,
+		buffer_operator::consumer::event
 	>(ev, this,
 		&session::on_channel_done_event,
 		&session::on_socket_event,
-		&session::on_timer_event
+		&session::on_timer_event,
+		&session::on_body_writer_event
 	);
 }
 
-int server::session::consume_buffer()
+void server::session::on_body_writer_event(buffer_operator::consumer_interface *, int error)
 {
-	if (shared_transaction_must_be_made_) {
-		shared_transaction_must_be_made_ = false;
-		shared_transaction_ = std::make_shared<transaction>(event_loop_, *this);
+	// Only the body writers of the HTTP/2 streams send their events here: those of HTTP/1.x requests send them to the channel.
+	if (!h2_) {
+		return;
 	}
-	else
-	// FIXME: at the moment we do not process a new request if the response is being sent.
-	// Doing otherwise would need a temporary buffer to append the new response to, and a queue of responses.
-	// We'll do this as a future improvement.
-	if (shared_transaction_->request_.got_end_of_message_) {
-		// This can only be true if the responder has not finished yet
-		shared_transaction_->request_.waiting_for_consumer_event_ = true;
-		return EAGAIN;
+
+	if (error) {
+		return shutdown(error);
 	}
 
-	return message_consumer::consume_buffer();
+	h2_->on_body_writer_event();
 }
 
-int server::session::process_message_start_line(std::string_view line)
+void server::session::switch_to_activity_timer()
 {
 	if (activity_timeout_) {
 		activity_timer_id_ = stop_add_timer(std::exchange(keepalive_timer_id_, 0), last_activity_ + activity_timeout_ - monotonic_clock::now(), true);
@@ -234,6 +318,32 @@ int server::session::process_message_start_line(std::string_view line)
 		stop_timer(keepalive_timer_id_);
 		keepalive_timer_id_ = 0;
 	}
+}
+
+void server::session::switch_to_keepalive_timer()
+{
+	keepalive_timer_id_ = stop_add_timer(std::exchange(activity_timer_id_, 0), keepalive_timeout_, true);
+}
+
+int server::session::consume_buffer()
+{
+	if (!receiving_ && (no_more_requests_ || transactions_.size() >= max_pipelined_requests)) {
+		// The next request is received once the responses to enough of the previous ones have been sent.
+		waiting_for_consumer_event_ = true;
+		return EAGAIN;
+	}
+
+	return message_consumer::consume_buffer();
+}
+
+int server::session::process_message_start_line(std::string_view line)
+{
+	receiving_ = transactions_.emplace_back(std::make_shared<transaction>(event_loop_, *this)).get();
+
+	if (transactions_.size() == 1) {
+		// Otherwise, the responses to the previous requests keep the activity timer going already.
+		switch_to_activity_timer();
+	}
 
 	util::parseable_range r(line);
 
@@ -249,8 +359,8 @@ int server::session::process_message_start_line(std::string_view line)
 		return process_error(EINVAL, "Malformed message start line.");
 	}
 
-	auto &request_ = shared_transaction_->request_;
-	auto &response_ = shared_transaction_->response_;
+	auto &request_ = receiving_->request_;
+	auto &response_ = receiving_->response_;
 
 	if (version == http_1_0) {
 		request_.version = request_.version_1_0;
@@ -266,21 +376,8 @@ int server::session::process_message_start_line(std::string_view line)
 		return process_error(EINVAL, "Unsupported HTTP version.");
 	}
 
-	if (!request_.uri.parse(path)) {
-		return process_error(EINVAL, "Couldn't parse the request target URI.");
-	}
-
-	bool must_append_slash = request_.uri.path_.back() == '/';
-
-	// This serves also for path normalization
-	request_.uri.path_ = util::fs::absolute_unix_path(std::move(request_.uri.path_), util::fs::unix_format);
-	if (request_.uri.path_.empty()) {
-		return process_error(EINVAL, "The request target path is invalid");
-	}
-
-	if (must_append_slash) {
-		// Restore the trailing slash, removed by the above normalization.
-		request_.uri.path_ += '/';
+	if (auto error = parse_request_target(request_.uri, path); !error.empty()) {
+		return process_error(EINVAL, error);
 	}
 
 	request_.method = method;
@@ -292,7 +389,7 @@ int server::session::process_message_start_line(std::string_view line)
 
 int server::session::process_message_header(field::name_view name, field::value_view value)
 {
-	auto &request_ = shared_transaction_->request_;
+	auto &request_ = receiving_->request_;
 
 	if (request_.headers.size() >= max_headers_count) {
 		return process_error(EINVAL, "Too many headers.");
@@ -326,22 +423,32 @@ int server::session::process_message_header(field::name_view name, field::value_
 
 int server::session::process_end_of_message_headers()
 {
-	transaction_handler_.handle_transaction(shared_transaction_);
+	if (!is_responding(*receiving_) && !may_be_handled_ahead(*receiving_)) {
+		// The headers get processed again, from here, once it's the turn of this request.
+		waiting_for_consumer_event_ = true;
+		return EAGAIN;
+	}
+
+	transaction_handler_.handle_transaction(transactions_.back());
 	return 0;
 }
 
 
 int server::session::process_end_of_message()
 {
-	auto &request_ = shared_transaction_->request_;
+	auto &request_ = std::exchange(receiving_, nullptr)->request_;
 
 	request_.got_end_of_message_ = true;
 
+	if (request_.close_connection_) {
+		no_more_requests_ = true;
+	}
+
 	std::visit([&](auto &writer) {
 		writer.on_end(true);
 	}, request_.body_writer_);
 
-	maybe_accept_next_request();
+	maybe_send_next_response();
 
 	return 0;
 }
@@ -358,22 +465,55 @@ int server::session::process_error(int err, std::string_view msg)
 		reason = "Internal Server Error";
 	}
 
-	auto &request_ = shared_transaction_->request_;
-	auto &response_ = shared_transaction_->response_;
+	if (!receiving_) {
+		receiving_ = transactions_.emplace_back(std::make_shared<transaction>(event_loop_, *this)).get();
+	}
+
+	auto &t = *receiving_;
 
 	std::visit([&](auto &writer) {
 		writer.on_end(false);
-	}, request_.body_writer_);
+	}, t.request_.body_writer_);
+
+	// Whatever follows can't be told apart from the rest of this request anymore.
+	no_more_requests_ = true;
+	channel_.set_buffer_consumer(nullptr);
 
-	if (response_.status_ <= transaction::response::waiting_for_code_and_reason) {
-		send_status(code, reason) &&
-		send_headers({{headers::Connection, "close"}}) &&
-		send_end();
+	if (t.response_.status_ <= transaction::response::waiting_for_code_and_reason) {
+		send_status(t, code, reason) &&
+		send_headers(t, {{headers::Connection, "close"}}) &&
+		send_end(t);
+	}
+	else {
+		t.response_.close_connection_ = true;
+		maybe_send_next_response();
 	}
 
 	return 0;
 }
 
+std::string_view server::session::parse_request_target(fz::uri &uri, std::string_view target)
+{
+	if (!uri.parse(target) || uri.path_.empty()) {
+		return "Couldn't parse the request target URI.";
+	}
+
+	bool must_append_slash = uri.path_.back() == '/';
+
+	// This serves also for path normalization
+	uri.path_ = util::fs::absolute_unix_path(std::move(uri.path_), util::fs::unix_format);
+	if (uri.path_.empty()) {
+		return "The request target path is invalid";
+	}
+
+	if (must_append_slash) {
+		// Restore the trailing slash, removed by the above normalization.
+		uri.path_ += '/';
+	}
+
+	return {};
+}
+
 void server::session::transaction::html_entry_stats::stream_name_to(util::buffer_streamer &bs) const
 {
 	bs << "<a href=\"" << fz::percent_encode(e_.name());
@@ -385,35 +525,101 @@ void server::session::transaction::html_entry_stats::stream_name_to(util::buffer
 	bs << "\">" << fz::html_encoded(e_.name()) << "</a>";
 }
 
-void server::session::maybe_accept_next_request()
+bool server::session::is_responding(const transaction &t) const
+{
+	return !transactions_.empty() && transactions_.front().get() == &t;
+}
+
+bool server::session::may_be_handled_ahead(const transaction &t) const
+{
+	// Only safe requests, with no body, are handled while the responses to the previous ones haven't been sent yet,
+	// and only if all of the previous ones are safe too: handling them in any order has then the same effects.
+	if (expects_body() || t.request_.headers.get(headers::Expect)) {
+		return false;
+	}
+
+	return std::all_of(transactions_.begin(), transactions_.end(), [](const std::shared_ptr<transaction> &p) {
+		return p->request_.method == "GET" || p->request_.method == "HEAD";
+	});
+}
+
+util::buffer_streamer server::session::output_stream(transaction &t)
+{
+	if (t.stream_id_) {
+		return h2_->output_stream(t);
+	}
+
+	if (!is_responding(t)) {
+		return { t.response_.pending_output_ };
+	}
+
+	return buffer_stream();
+}
+
+void server::session::start_response(transaction &t)
+{
+	auto &response_ = t.response_;
+
+	if (!response_.pending_output_.empty()) {
+		buffer_stream() << std::move(response_.pending_output_);
+	}
+
+	if (auto body = std::exchange(response_.pending_body_, nullptr)) {
+		send_body(t, *body);
+	}
+}
+
+void server::session::maybe_send_next_response()
 {
-	auto &request_ = shared_transaction_->request_;
-	auto &response_ = shared_transaction_->response_;
+	while (!transactions_.empty()) {
+		auto &t = *transactions_.front();
 
-	if (request_.got_end_of_message_ && response_.status_ == transaction::response::ended) {
-		if (request_.waiting_for_consumer_event_) {
-			request_.waiting_for_consumer_event_ = false;
-			consumer::send_event(0);
+		if (t.response_.status_ != transaction::response::ended) {
+			break;
 		}
 
+		if (t.response_.close_connection_) {
+			shutdown(0);
+			return;
+		}
+
+		if (!t.request_.got_end_of_message_) {
+			// The rest of the request must be received before the next one.
+			break;
+		}
 
-		shared_transaction_->detach();
-		shared_transaction_must_be_made_ = true;
+		t.detach();
+		transactions_.pop_front();
 
-		keepalive_timer_id_ = stop_add_timer(std::exchange(activity_timer_id_, 0), keepalive_timeout_, true);
+		if (transactions_.empty()) {
+			switch_to_keepalive_timer();
+			break;
+		}
+
+		start_response(*transactions_.front());
+	}
+
+	if (waiting_for_consumer_event_) {
+		waiting_for_consumer_event_ = false;
+		consumer::send_event(0);
 	}
 }
 
 /***************************************************************************************************/
 
-auto server::session::stream_headers(std::initializer_list<std::pair<field::name_view, field::value_view>> list) {
-	return [this, list](util::buffer_streamer &streamer) {
+auto server::session::stream_headers(transaction &t, std::initializer_list<std::pair<field::name_view, field::value_view>> list) {
+	return [this, &t, list](util::buffer_streamer &streamer) {
 		for (auto h: list) {
 			if (h.first.empty()) {
 				continue;
 			}
 
-			auto &response_ = shared_transaction_->response_;
+			auto &response_ = t.response_;
+
+			if (t.stream_id_ && (h.first == headers::Transfer_Encoding || h.first == headers::Connection || h.first == "Keep-Alive")) {
+				// HTTP/2 has framing and connection management of its own, these must not be sent.
+				continue;
+			}
 
 			if (h.first == headers::Transfer_Encoding) {
 				if (h.second.as_list().last() == "chunked") {
@@ -434,6 +640,20 @@ auto server::session::stream_headers(std::initializer_list<std::pair<field::name
 			if (h.first == headers::Content_Type) {
 				response_.content_type = h.second;
 			}
+			else
+			if (h.first == headers::Content_Encoding) {
+				response_.content_encoding = h.second;
+			}
+			else
+			if (h.first == headers::Accept_Ranges) {
+				response_.accepts_ranges_ = !h.second.is("none");
+			}
+			else
+			if (h.first == headers::ETag) {
+				// Held back until the headers are flushed, since compressing the body on the fly weakens it.
+				response_.etag = h.second;
+				continue;
+			}
 
 			if (reslog_.should_log(logmsg::debug_debug)) {
 				std::string_view log_value
@@ -448,27 +668,39 @@ auto server::session::stream_headers(std::initializer_list<std::pair<field::name
 	};
 }
 
-void server::session::flush_headers(body_size_type size_of_body)
+void server::session::flush_headers(transaction &t, body_size_type size_of_body)
 {
-	auto streamer = buffer_stream();
+	auto &request_ = t.request_;
+	auto &response_ = t.response_;
 
-	auto &request_ = shared_transaction_->request_;
-	auto &response_ = shared_transaction_->response_;
+	if (t.stream_id_) {
+		return flush_h2_headers(t, size_of_body);
+	}
+
+	auto streamer = output_stream(t);
 
 	streamer << std::move(response_.headers_buffer_);
 
-	if (!response_.chunked_encoding_requested_) {
+	if (response_.etag) {
+		reslog_.log(logmsg::debug_debug, L"[Status: %d] %s: %s", response_.status_, headers::ETag.str(), response_.etag.str());
+		streamer << headers::ETag.str() << ": " << response_.etag.str() << "\r\n";
+	}
+
+	// 204 and 304 responses never have a body, hence nothing must tell its size.
+	bool const may_have_body = response_.code_ != 204 && response_.code_ != 304;
+
+	if (may_have_body && !response_.chunked_encoding_requested_) {
 		if (size_of_body == body_size_type(-1)) {
 			if (response_.chunked_encoding_is_supported_) {
-				streamer << stream_headers({{headers::Transfer_Encoding, "chunked"}});
+				streamer << stream_headers(t, {{headers::Transfer_Encoding, "chunked"}});
 			}
 			else
 			if (!response_.close_connection_) {
-				streamer << stream_headers({{headers::Connection, "close"}});
+				streamer << stream_headers(t, {{headers::Connection, "close"}});
 			}
 		}
 		else {
-			streamer << stream_headers({{headers::Content_Length, std::to_string(size_of_body)}});
+			streamer << stream_headers(t, {{headers::Content_Length, std::to_string(size_of_body)}});
 		}
 	}
 
@@ -489,9 +721,92 @@ void server::session::flush_headers(body_size_type size_of_body)
 	response_.status_ = transaction::response::waiting_for_body;
 }
 
-bool server::session::send_status(unsigned int code, std::string_view reason)
+void server::session::flush_h2_headers(transaction &t, body_size_type size_of_body)
+{
+	auto &response_ = t.response_;
+
+	std::vector<hpack::header_field> fields;
+	fields.push_back({":status", std::to_string(response_.code_)});
+
+	// The headers have been streamed already the way HTTP/1.1 has them, past the status line: they're turned into fields,
+	// whose names must be in lower case.
+	std::string_view text(reinterpret_cast<const char *>(response_.headers_buffer_.get()), response_.headers_buffer_.size());
+
+	for (bool status_line = true; !text.empty(); status_line = false) {
+		auto eol = text.find("\r\n");
+		auto line = text.substr(0, eol);
+		text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 2);
+
+		auto colon = line.find(':');
+		if (status_line || colon == std::string_view::npos) {
+			continue;
+		}
+
+		auto value = line.substr(colon + 1);
+		while (!value.empty() && value.front() == ' ') {
+			value.remove_prefix(1);
+		}
+
+		fields.push_back({fz::str_tolower_ascii(line.substr(0, colon)), std::string(value)});
+	}
+
+	response_.headers_buffer_.clear();
+
+	if (response_.etag) {
+		reslog_.log(logmsg::debug_debug, L"[Status: %d] %s: %s", response_.status_, headers::ETag.str(), response_.etag.str());
+		fields.push_back({"etag", response_.etag.str()});
+	}
+
+	// Bodies whose size isn't known upfront just end with the stream.
+	if (response_.code_ != 204 && response_.code_ != 304 && size_of_body != body_size_type(-1)) {
+		fields.push_back({"content-length", std::to_string(size_of_body)});
+	}
+
+	h2_->send_headers(t, fields);
+
+	response_.status_ = transaction::response::waiting_for_body;
+}
+
+bool server::session::negotiate_compression(transaction &t, body_size_type size_of_body)
 {
-	auto &response_ = shared_transaction_->response_;
+	auto &request_ = t.request_;
+	auto &response_ = t.response_;
+
+	// A client resuming the body with a Range request would get the identity bytes, and mix them up with the compressed ones it got already.
+	if (response_.code_ != 200 || response_.content_encoding || response_.accepts_ranges_) {
+		return false;
+	}
+
+	if (!body_compressor::is_negotiable(response_.content_type, size_of_body == body_size_type(-1) ? body_compressor::unknown_size : std::uint64_t(size_of_body))) {
+		return false;
+	}
+
+	// From here on, what's sent depends on the client's Accept-Encoding.
+	if (!send_header(t, headers::Vary, headers::Accept_Encoding)) {
+		return false;
+	}
+
+	if (request_.method == "HEAD" || !request_.headers.accepts_encoding("gzip")) {
+		return false;
+	}
+
+	response_.compression_ticket_ = body_compressor::ticket::acquire();
+	if (!response_.compression_ticket_) {
+		reslog_.log_raw(logmsg::debug_verbose, L"Too many bodies are being compressed already, sending this one as it is.");
+		return false;
+	}
+
+	// The compressed body isn't byte for byte the same as the file the tag was made for: a strong tag would let ranges of the two be mixed up.
+	if (response_.etag && !fz::starts_with(response_.etag.str(), std::string("W/"))) {
+		response_.etag = "W/" + response_.etag.str();
+	}
+
+	return send_header(t, headers::Content_Encoding, "gzip");
+}
+
+bool server::session::send_status(transaction &t, unsigned int code, std::string_view reason)
+{
+	auto &response_ = t.response_;
 
 	if (response_.status_ > response_.status::waiting_for_code_and_reason) {
 		reslog_.log_raw(logmsg::error, L"Response code and reason have already been sent.");
@@ -503,10 +818,14 @@ bool server::session::send_status(unsigned int code, std::string_view reason)
 		reslog_.log(logmsg::debug_debug, L"[Status: %d] HTTP/1.1 %s %s", response_.status_, code, reason);
 	}
 
+	if (code == 100 && t.stream_id_) {
+		h2_->send_informational(t, code);
+	}
+	else
 	if (code == 100) {
 		// The 100 Continue response must be sent immediately and doesn't alter the state of the response itself.
 
-		buffer_stream() <<
+		output_stream(t) <<
 			"HTTP/1.1 100 " << reason << "\r\n" <<
 			"\r\n";
 	}
@@ -517,14 +836,15 @@ bool server::session::send_status(unsigned int code, std::string_view reason)
 			"Date: "   << datetime::now().get_rfc822()  << "\r\n";
 
 		response_.status_ = transaction::response::status::waiting_for_headers;
+		response_.code_ = code;
 	}
 
 	return true;
 }
 
-bool server::session::send_headers(std::initializer_list<std::pair<field::name_view, field::value_view> > list)
+bool server::session::send_headers(transaction &t, std::initializer_list<std::pair<field::name_view, field::value_view> > list)
 {
-	auto &response_ = shared_transaction_->response_;
+	auto &response_ = t.response_;
 
 	if (response_.status_ < transaction::response::status::waiting_for_headers) {
 		reslog_.log_raw(logmsg::error, L"Cannot send headers yet.");
@@ -539,15 +859,20 @@ bool server::session::send_headers(std::initializer_list<std::pair<field::name_v
 	}
 
 	util::buffer_streamer(response_.headers_buffer_)
-		<< stream_headers(list);
+		<< stream_headers(t, list);
 
 	return true;
 }
 
-bool server::session::send_body(std::string_view str)
+bool server::session::send_header(transaction &t, field::name_view name, field::value_view value)
 {
-	auto &request_ = shared_transaction_->request_;
-	auto &response_ = shared_transaction_->response_;
+	return send_headers(t, {{name, value}});
+}
+
+bool server::session::send_body(transaction &t, std::string_view str)
+{
+	auto &request_ = t.request_;
+	auto &response_ = t.response_;
 
 	if (response_.status_ < transaction::response::status::waiting_for_headers) {
 		reslog_.log_raw(logmsg::error, L"Cannot send body yet.");
@@ -556,24 +881,44 @@ bool server::session::send_body(std::string_view str)
 	}
 
 	if (!response_.content_type) {
-		send_header(headers::Content_Type, "text/plain; charset=utf-8");
+		send_header(t, headers::Content_Type, "text/plain; charset=utf-8");
 	}
 
-	flush_headers(str.size());
+	if (negotiate_compression(t, str.size())) {
+		fz::buffer compressed;
+
+		bool success = body_compressor::compress(str, compressed);
+		response_.compression_ticket_ = {};
+
+		if (!success) {
+			abort_send(t, "Failed compressing the body.");
+			return false;
+		}
+
+		flush_headers(t, compressed.size());
+
+		output_stream(t) << std::move(compressed);
+
+		response_.status_ = transaction::response::status::sent_body;
+
+		return send_end(t);
+	}
+
+	flush_headers(t, str.size());
 
 	if (request_.method != "HEAD") {
-		buffer_stream() << str;
+		output_stream(t) << str;
 
 		response_.status_ = transaction::response::status::sent_body;
 	}
 
-	return send_end();
+	return send_end(t);
 }
 
-bool server::session::send_body(tvfs::file_holder file)
+bool server::session::send_body(transaction &t, tvfs::file_holder file)
 {
-	auto &request_ = shared_transaction_->request_;
-	auto &response_ = shared_transaction_->response_;
+	auto &request_ = t.request_;
+	auto &response_ = t.response_;
 
 	if (response_.status_ < transaction::response::status::waiting_for_headers) {
 		reslog_.log_raw(logmsg::error, L"Cannot send body yet.");
@@ -582,25 +927,87 @@ bool server::session::send_body(tvfs::file_holder file)
 	}
 
 	if (!response_.content_type) {
-		send_header(headers::Content_Type, "application/octet-stream");
+		send_header(t, headers::Content_Type, "application/octet-stream");
 	}
 
-	flush_headers(body_size_type(file->size()));
+	if (negotiate_compression(t, body_size_type(file->size()))) {
+		flush_headers(t, body_size_type(-1));
+	}
+	else {
+		flush_headers(t, body_size_type(file->size()));
+	}
 
 	if (request_.method == "HEAD") {
-		send_end();
+		send_end(t);
 		return true;
 	}
 
 	auto &reader = response_.body_reader_.emplace<transaction::file_reader>(std::move(file), logger_);
 
-	return send_body(reader);
+	return send_body(t, reader);
 }
 
-bool server::session::send_body(tvfs::entries_iterator it)
+bool server::session::send_body(transaction &t, tvfs::file_holder file, const byte_ranges &ranges, std::string_view boundary, std::string_view content_type)
 {
-	auto &request_ = shared_transaction_->request_;
-	auto &response_ = shared_transaction_->response_;
+	auto &request_ = t.request_;
+	auto &response_ = t.response_;
+
+	if (response_.status_ < transaction::response::status::waiting_for_headers) {
+		reslog_.log_raw(logmsg::error, L"Cannot send body yet.");
+		shutdown(EINVAL);
+		return false;
+	}
+
+	if (ranges.empty()) {
+		reslog_.log_raw(logmsg::error, L"No ranges to send.");
+		shutdown(EINVAL);
+		return false;
+	}
+
+	if (!response_.content_type) {
+		send_header(t, headers::Content_Type, "application/octet-stream");
+	}
+
+	std::vector<transaction::ranges_reader::part> parts;
+	std::string epilogue;
+
+	if (ranges.size() == 1) {
+		parts.push_back({{}, ranges.front()});
+	}
+	else {
+		auto complete_size = std::uint64_t(file->size());
+
+		parts.reserve(ranges.size());
+
+		for (const auto &r: ranges) {
+			parts.push_back({fz::sprintf("%s--%s\r\nContent-Type: %s\r\nContent-Range: %s\r\n\r\n", parts.empty() ? "" : "\r\n", boundary, content_type, r.content_range(complete_size)), r});
+		}
+
+		epilogue = fz::sprintf("\r\n--%s--\r\n", boundary);
+	}
+
+	body_size_type body_size = epilogue.size();
+
+	for (const auto &p: parts) {
+		body_size += p.header.size() + p.range.size();
+	}
+
+	flush_headers(t, body_size);
+
+	if (request_.method == "HEAD") {
+		send_end(t);
+		return true;
+	}
+
+	auto &reader = response_.body_reader_.emplace<transaction::ranges_reader>(std::move(file), logger_, std::move(parts), std::move(epilogue));
+
+	return send_body(t, reader);
+}
+
+bool server::session::send_body(transaction &t, tvfs::entries_iterator it)
+{
+	auto &request_ = t.request_;
+	auto &response_ = t.response_;
 
 	if (response_.status_ < transaction::response::status::waiting_for_headers) {
 		reslog_.log_raw(logmsg::error, L"Cannot send body yet.");
@@ -613,7 +1020,7 @@ bool server::session::send_body(tvfs::entries_iterator it)
 
 	if (response_.content_type.empty()) {
 		format_is_html = true;
-		send_header(headers::Content_Type, "text/html; charset=utf-8");
+		send_header(t, headers::Content_Type, "text/html; charset=utf-8");
 	}
 	else
 	if (response_.content_type.is("text/html")) {
@@ -630,10 +1037,11 @@ bool server::session::send_body(tvfs::entries_iterator it)
 		return false;
 	}
 
-	flush_headers(std::size_t(-1));
+	negotiate_compression(t, body_size_type(-1));
+	flush_headers(t, body_size_type(-1));
 
 	if (request_.method == "HEAD") {
-		send_end();
+		send_end(t);
 		return true;
 	}
 
@@ -649,25 +1057,71 @@ bool server::session::send_body(tvfs::entries_iterator it)
 		return response_.body_reader_.emplace<transaction::plain_entries_reader>(event_loop_, std::move(it));
 	}();
 
-	return send_body(reader);
+	return send_body(t, reader);
+}
+
+bool server::session::send_body(transaction &t, std::unique_ptr<adder_interface> adder)
+{
+	auto &request_ = t.request_;
+	auto &response_ = t.response_;
+
+	if (response_.status_ < transaction::response::status::waiting_for_headers) {
+		reslog_.log_raw(logmsg::error, L"Cannot send body yet.");
+		shutdown(EINVAL);
+		return false;
+	}
+
+	if (!adder) {
+		reslog_.log_raw(logmsg::error, L"No adder to send the body from.");
+		shutdown(EINVAL);
+		return false;
+	}
+
+	if (!response_.content_type) {
+		send_header(t, headers::Content_Type, "application/octet-stream");
+	}
+
+	flush_headers(t, body_size_type(-1));
+
+	if (request_.method == "HEAD") {
+		send_end(t);
+		return true;
+	}
+
+	auto &reader = response_.body_reader_.emplace<transaction::custom_reader>(std::move(adder));
+
+	return send_body(t, reader);
 }
 
-bool server::session::send_body(adder_interface &adder)
+bool server::session::send_body(transaction &t, adder_interface &adder)
 {
-	auto &response_ = shared_transaction_->response_;
+	auto &response_ = t.response_;
+
+	if (!t.stream_id_ && !is_responding(t)) {
+		// Started once the responses to the previous requests have been sent.
+		response_.pending_body_ = &adder;
+		return true;
+	}
 
 	auto &reader = [&]() -> buffer_operator::adder_interface & {
+		// The body is compressed first, then the compressed data is chunked.
+		auto *outermost = &adder;
+
+		if (response_.compression_ticket_) {
+			outermost = &response_.body_compressor_.emplace(*outermost, std::move(response_.compression_ticket_));
+		}
+
 		if (response_.chunked_encoding_requested_) {
-			return response_.body_chunker_.emplace(adder);
+			outermost = &response_.body_chunker_.emplace(*outermost);
 		}
 
-		return adder;
+		return *outermost;
 	}();
 
 	response_.status_ = transaction::response::status::sending_body;
 
-	process_nested_adder_until_eof(reader, [this](int err) {
-		auto &response_ = shared_transaction_->response_;
+	auto on_eof = [this, &t](int err) {
+		auto &response_ = t.response_;
 
 		if (err) {
 			reslog_.log_u(logmsg::error, L"Error while sending body: %d (%s).", err, std::generic_category().message(err));
@@ -675,46 +1129,67 @@ bool server::session::send_body(adder_interface &adder)
 		}
 
 		response_.body_chunker_.reset();
+		response_.body_compressor_.reset();
 		response_.body_reader_.emplace<transaction::no_reader>();
 
 		response_.status_ = transaction::response::status::sent_body;
 
-		send_end();
+		send_end(t);
 
 		return 0;
-	});
+	};
+
+	if (t.stream_id_) {
+		// Each stream pulls its own body, as its flow control allows.
+		h2_->send_body(t, reader, std::move(on_eof));
+	}
+	else {
+		process_nested_adder_until_eof(reader, std::move(on_eof));
+	}
 
 	return true;
 }
 
-bool server::session::send_end()
+bool server::session::send_end(transaction &t)
 {
-	auto &response_ = shared_transaction_->response_;
+	auto &response_ = t.response_;
 
 	if (response_.status_ < transaction::response::status::waiting_for_headers) {
-		abort_send("Cannot send end of message yet.");
+		abort_send(t, "Cannot send end of message yet.");
 		return false;
 	}
 
 	if (response_.status_ == transaction::response::waiting_for_headers) {
-		flush_headers(0);
+		flush_headers(t, 0);
 	}
 
 	response_.status_ = transaction::response::status::ended;
 
-	if (response_.close_connection_) {
-		shutdown(0);
+	if (t.stream_id_) {
+		h2_->send_end(t);
+		return true;
 	}
-	else {
-		maybe_accept_next_request();
+
+	if (response_.close_connection_) {
+		// Nothing is received after this request, and its response closes the connection once it's sent.
+		no_more_requests_ = true;
 	}
 
+	maybe_send_next_response();
+
 	return true;
 }
 
-void server::session::abort_send(std::string_view msg)
+void server::session::abort_send(transaction &t, std::string_view msg)
 {
 	reslog_.log_u(logmsg::error, L"ABORTING: %s", msg);
+
+	if (t.stream_id_) {
+		// Only the stream is reset, the others carry on.
+		h2_->abort(t);
+		return;
+	}
+
 	shutdown(EINVAL);
 }
 
@@ -772,6 +1247,50 @@ int server::session::transaction::html_entries_reader::add_to_buffer()
 	return res;
 }
 
+int server::session::transaction::ranges_reader::add_to_buffer()
+{
+	while (current_ < parts_.size()) {
+		auto &p = parts_[current_];
+
+		if (!started_) {
+			if (!fr_.set_range(std::int64_t(p.range.first), std::int64_t(p.range.size()))) {
+				return EIO;
+			}
+
+			started_ = true;
+
+			if (!p.header.empty()) {
+				auto b = get_buffer();
+				if (!b) {
+					return EFAULT;
+				}
+
+				b->append(p.header);
+			}
+		}
+
+		int res = fr_.add_to_buffer();
+		if (res != ENODATA) {
+			return res;
+		}
+
+		++current_;
+		started_ = false;
+	}
+
+	if (!epilogue_.empty()) {
+		auto b = get_buffer();
+		if (!b) {
+			return EFAULT;
+		}
+
+		b->append(epilogue_);
+		epilogue_.clear();
+	}
+
+	return ENODATA;
+}
+
 void server::session::transaction::ndjson_entry::operator()(util::buffer_streamer &bs) const
 {
 	static auto escaped = [](std::string_view s)
@@ -1,6 +1,8 @@
 #ifndef FZ_HTTP_SERVER_SESSION_HPP
 #define FZ_HTTP_SERVER_SESSION_HPP
 
+#include <deque>
+
 #include "../../buffer_operator/streamed_adder.hpp"
 #include "../../buffer_operator/file_reader.hpp"
 #include "../../buffer_operator/file_writer.hpp"
@@ -14,6 +16,7 @@
 #include "../server.hpp"
 #include "../message_consumer.hpp"
 #include "../body_chunker.hpp"
+#include "../body_compressor.hpp"
 
 #include "responder.hpp"
 #include "request.hpp"
@@ -25,7 +28,6 @@ class server::session
 	, private util::invoker_handler
 	, private buffer_operator::streamed_adder
 	, private message_consumer
-	, private server::responder
 	, private channel::progress_notifier
 {
 public:
@@ -41,8 +43,8 @@ public:
 	bool is_secure() const;
 	event_loop &get_event_loop() const;
 
-	void receive_body(badge<server::request>, std::string &&body, std::function<void(std::string body, bool success)> on_end);
-	void receive_body(badge<server::request>, tvfs::file_holder &&file, std::function<void(tvfs::file_holder file, bool success)> on_end);
+	void receive_body(badge<server::request>, server::transaction &t, std::string &&body, std::function<void(std::string body, bool success)> on_end);
+	void receive_body(badge<server::request>, server::transaction &t, tvfs::file_holder &&file, std::function<void(tvfs::file_holder file, bool success)> on_end);
 
 	// progress_notifier interface
 private:
@@ -67,31 +69,51 @@ private:
 	void on_socket_event(fz::socket_event_source *source, fz::socket_event_flag type, int error);
 	void on_channel_done_event(channel &, channel::error_type error);
 	void on_timer_event(timer_id id);
+	void on_body_writer_event(buffer_operator::consumer_interface *source, int error);
+
+	void switch_to_activity_timer();
+	void switch_to_keepalive_timer();
 
 	// session interface
 private:
 	bool is_alive() const override;
 	void shutdown(int err) override;
 
-	// server::responder interface
+	// responses
 private:
+	struct transaction;
+	struct h2_connection;
+
+	/// Parses and normalizes the target of a request into \p uri.
+	/// \returns an empty string on success, else why the target is invalid.
+	static std::string_view parse_request_target(fz::uri &uri, std::string_view target);
+
 	using body_size_type = std::conditional_t<
 		(std::numeric_limits<std::size_t>::max() > std::numeric_limits<std::uint64_t>::max()),
 		std::size_t,
 		std::uint64_t
 	>;
 
-	void flush_headers(body_size_type size_of_body);
-	auto stream_headers(std::initializer_list<std::pair<field::name_view, field::value_view> > list);
-	bool send_body(buffer_operator::adder_interface &adder);
-
-	bool send_status(unsigned int code, std::string_view reason) override;
-	bool send_headers(std::initializer_list<std::pair<field::name_view, field::value_view>>) override;
-	bool send_body(std::string_view str) override;
-	bool send_body(tvfs::file_holder file) override;
-	bool send_body(tvfs::entries_iterator it) override;
-	bool send_end() override;
-	void abort_send(std::string_view msg) override;
+	bool is_responding(const transaction &t) const;
+	util::buffer_streamer output_stream(transaction &t);
+	void start_response(transaction &t);
+
+	void flush_headers(transaction &t, body_size_type size_of_body);
+	void flush_h2_headers(transaction &t, body_size_type size_of_body);
+	bool negotiate_compression(transaction &t, body_size_type size_of_body);
+	auto stream_headers(transaction &t, std::initializer_list<std::pair<field::name_view, field::value_view> > list);
+	bool send_body(transaction &t, buffer_operator::adder_interface &adder);
+
+	bool send_status(transaction &t, unsigned int code, std::string_view reason);
+	bool send_headers(transaction &t, std::initializer_list<std::pair<field::name_view, field::value_view>>);
+	bool send_header(transaction &t, field::name_view name, field::value_view value);
+	bool send_body(transaction &t, std::string_view str);
+	bool send_body(transaction &t, tvfs::file_holder file);
+	bool send_body(transaction &t, tvfs::file_holder file, const byte_ranges &ranges, std::string_view boundary, std::string_view content_type);
+	bool send_body(transaction &t, tvfs::entries_iterator it);
+	bool send_body(transaction &t, std::unique_ptr<buffer_operator::adder_interface> adder);
+	bool send_end(transaction &t);
+	void abort_send(transaction &t, std::string_view msg);
 
 private:
 	transaction_handler &transaction_handler_;
@@ -102,6 +124,10 @@ private:
 	logger::modularized reslog_;
 
 	securable_socket socket_;
+
+	// Set once HTTP/2 has been negotiated, in which case it's the adder and the consumer of the channel, in place of the session.
+	std::unique_ptr<h2_connection> h2_;
+
 	channel channel_;
 
 	monotonic_clock last_activity_;
@@ -110,11 +136,21 @@ private:
 	timer_id keepalive_timer_id_{};
 	timer_id activity_timer_id_{};
 
-	void maybe_accept_next_request();
+	bool may_be_handled_ahead(const transaction &t) const;
+	void maybe_send_next_response();
 
-	struct transaction;
-	std::shared_ptr<transaction> shared_transaction_;
-	bool shared_transaction_must_be_made_{false};
+	/// How many requests are received, at most, while the response to the first of them hasn't been sent yet.
+	static constexpr std::size_t max_pipelined_requests = 8;
+
+	// The transactions whose response hasn't been sent yet, in the order their requests were received.
+	// The response of the first one is the one being sent; those of the others, if they're made already, wait in memory for their turn.
+	std::deque<std::shared_ptr<transaction>> transactions_;
+
+	// The transaction whose request is being received, if any. It's always the last one of transactions_.
+	transaction *receiving_{};
+
+	bool waiting_for_consumer_event_{};
+	bool no_more_requests_{};
 };
 
 }
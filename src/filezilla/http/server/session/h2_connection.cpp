@@ -0,0 +1,1189 @@
+#include <algorithm>
+
+#include <libfilezilla/format.hpp>
+
+#include "h2_connection.hpp"
+
+namespace fz::http {
+
+namespace {
+
+constexpr std::uint32_t max_concurrent_streams = 100;
+
+// What the client may send of the body of a request, ahead of what its body writer has consumed.
+constexpr std::uint32_t stream_receive_window = 256*1024;
+
+// What the client may send across all streams, ahead of what's been received. Given back as soon as it's received,
+// since the windows of the streams already cap how much is held in memory.
+constexpr std::uint32_t connection_receive_window = 1024*1024;
+
+constexpr std::size_t max_header_list_size = 64*1024;
+
+// How much of a response body is read ahead of what the flow control lets be sent.
+constexpr std::size_t max_buffered_body = 128*1024;
+
+// How much is added to the channel's buffer, at most, before it's written out to the socket.
+constexpr std::size_t max_buffered_output = 128*1024;
+
+// How much of the frames not bound to any stream, like the acknowledgments of PINGs and SETTINGS, may wait to be sent.
+// Past that, the frames of the client aren't processed until it reads what it's been sent already.
+constexpr std::size_t max_control_size = 64*1024;
+
+// How many streams the client may reset within client_reset_window, before it's told to calm down and the connection is closed.
+// Opening streams only to reset them straight away would otherwise have the server work for nothing, at no cost for the client.
+constexpr unsigned int max_client_resets = 2*max_concurrent_streams;
+constexpr auto client_reset_window = duration::from_seconds(10);
+
+constexpr std::string_view connection_specific_headers[] = {
+	"connection", "keep-alive", "proxy-connection", "transfer-encoding", "upgrade"
+};
+
+bool strip_padding(const h2::frame_header &h, std::string_view &payload)
+{
+	if (!(h.flags & h2::flags::padded)) {
+		return true;
+	}
+
+	if (payload.empty()) {
+		return false;
+	}
+
+	std::size_t padding = std::uint8_t(payload.front());
+	payload.remove_prefix(1);
+
+	if (padding > payload.size()) {
+		return false;
+	}
+
+	payload.remove_suffix(padding);
+	return true;
+}
+
+const unsigned char *bytes_of(std::string_view s)
+{
+	return reinterpret_cast<const unsigned char *>(s.data());
+}
+
+// As per RFC 9218: the u parameter of the Priority header, if any, from 0 to 7.
+int urgency_of(field::value_view priority)
+{
+	for (auto p: priority.as_list().iterable()) {
+		auto s = p.str();
+
+		if (s.size() == 3 && s[0] == 'u' && s[1] == '=' && s[2] >= '0' && s[2] <= '7') {
+			return s[2] - '0';
+		}
+	}
+
+	return 3;
+}
+
+}
+
+server::session::h2_connection::h2_connection(session &s)
+	: s_(s)
+	, decoder_(4096, max_header_list_size)
+	, connection_receive_window_(connection_receive_window)
+{
+}
+
+server::session::h2_connection::~h2_connection()
+{
+	for (auto &[id, s]: streams_) {
+		s.t_->detach();
+	}
+}
+
+void server::session::h2_connection::start()
+{
+	static constexpr std::pair<h2::setting, std::uint32_t> settings[] = {
+		{ h2::setting::max_concurrent_streams, max_concurrent_streams },
+		{ h2::setting::initial_window_size, stream_receive_window },
+		{ h2::setting::max_header_list_size, std::uint32_t(max_header_list_size) },
+	};
+
+	h2::frame_header{std::uint32_t(6*std::size(settings)), h2::frame_type::settings, 0, 0}.append_to(control_);
+
+	for (auto &[id, value]: settings) {
+		control_.append(std::uint8_t(std::uint16_t(id) >> 8));
+		control_.append(std::uint8_t(id));
+		h2::frame_header::append_uint32(control_, value);
+	}
+
+	append_window_update(control_, 0, connection_receive_window - h2::default_window_size);
+
+	wake();
+}
+
+void server::session::h2_connection::go_away(h2::error_code code)
+{
+	if (going_away_) {
+		return;
+	}
+
+	going_away_ = true;
+
+	auto buffer = adder::get_buffer();
+	if (!buffer) {
+		return;
+	}
+
+	buffer->append(control_);
+	control_.clear();
+
+	h2::frame_header{8, h2::frame_type::goaway, 0, 0}.append_to(*buffer);
+	h2::frame_header::append_uint32(*buffer, last_stream_id_);
+	h2::frame_header::append_uint32(*buffer, std::uint32_t(code));
+
+	// For the pipe to notice there's more to be written.
+	wake();
+}
+
+server::session::h2_connection::stream *server::session::h2_connection::find_stream(const transaction &t)
+{
+	if (auto it = streams_.find(t.stream_id_); it != streams_.end() && it->second.t_.get() == &t) {
+		return &it->second;
+	}
+
+	return nullptr;
+}
+
+void server::session::h2_connection::wake()
+{
+	if (!wake_pending_) {
+		wake_pending_ = adder::send_event(0);
+	}
+}
+
+util::buffer_streamer server::session::h2_connection::output_stream(transaction &t)
+{
+	if (auto s = find_stream(t)) {
+		return { *s->response_body_.lock(), [this] { wake(); } };
+	}
+
+	// The stream is gone already: whatever is written is dropped along with the transaction.
+	return { t.response_.pending_output_ };
+}
+
+void server::session::h2_connection::send_informational(transaction &t, unsigned int code)
+{
+	auto s = find_stream(t);
+	if (!s || s->headers_sent_) {
+		return;
+	}
+
+	fz::buffer block;
+	hpack::encoder::encode(":status", std::to_string(code), block);
+
+	append_header_block(control_, s->id_, block, false);
+	wake();
+}
+
+void server::session::h2_connection::send_headers(transaction &t, const std::vector<hpack::header_field> &fields)
+{
+	auto s = find_stream(t);
+	if (!s) {
+		return;
+	}
+
+	for (auto &f: fields) {
+		hpack::encoder::encode(f.name, f.value, s->header_block_);
+	}
+
+	s->headers_ready_ = true;
+	wake();
+}
+
+void server::session::h2_connection::send_body(transaction &t, buffer_operator::adder_interface &source, std::function<int(int)> on_eof)
+{
+	auto s = find_stream(t);
+	if (!s) {
+		return;
+	}
+
+	s->body_source_ = &source;
+	s->on_body_end_ = std::move(on_eof);
+
+	source.set_buffer(&s->response_body_);
+
+	// The source tells the out pipe when it's got more to add, and the pipe in turn asks this connection for it.
+	source.set_event_handler(adder::get_event_handler().get());
+
+	wake();
+}
+
+void server::session::h2_connection::send_end(transaction &t)
+{
+	if (find_stream(t)) {
+		wake();
+	}
+}
+
+void server::session::h2_connection::abort(transaction &t)
+{
+	if (auto s = find_stream(t)) {
+		reset_stream(s->id_, h2::error_code::internal_error);
+	}
+}
+
+bool server::session::h2_connection::receive_body(transaction &t)
+{
+	auto s = find_stream(t);
+	if (!s || s->body_writer_set_ || s->discarding_body_) {
+		return false;
+	}
+
+	std::visit([&](buffer_operator::consumer_interface &writer) {
+		writer.set_buffer(&s->request_body_);
+		writer.set_event_handler(&s_);
+	}, t.request_.body_writer_);
+
+	s->body_writer_set_ = true;
+
+	// Some of the body may have been received already, or all of it: the writer gets it once the handler is done with the request,
+	// as it would be with HTTP/1.x.
+	std::visit([](buffer_operator::consumer_interface &writer) {
+		writer.send_event(0);
+	}, t.request_.body_writer_);
+
+	return true;
+}
+
+void server::session::h2_connection::on_body_writer_event()
+{
+	for (auto &[id, s]: streams_) {
+		drain_request_body(s);
+	}
+
+	sweep();
+}
+
+void server::session::h2_connection::drain_request_body(stream &s)
+{
+	if (s.body_writer_set_) {
+		auto &writer = s.t_->request_.body_writer_;
+
+		int err = 0;
+
+		for (;;) {
+			auto size = s.request_body_.lock()->size();
+			if (size == 0) {
+				break;
+			}
+
+			err = std::visit([](buffer_operator::consumer_interface &w) {
+				return w.consume_buffer();
+			}, writer);
+
+			auto consumed = size - s.request_body_.lock()->size();
+			s.unacknowledged_ += std::uint32_t(consumed);
+
+			if (err || consumed == 0) {
+				break;
+			}
+		}
+
+		if (err && err != EAGAIN && err != ENODATA) {
+			if (err != ECANCELED) {
+				s_.reqlog_.log_u(logmsg::error, L"Error while consuming the body of the request on stream %d: %s.", s.id_, std::generic_category().message(err));
+			}
+
+			// What's left of the body is received and dropped, so that the response can still be sent.
+			s.body_writer_set_ = false;
+			s.discarding_body_ = true;
+			s.unacknowledged_ += std::uint32_t(s.request_body_.lock()->size());
+			s.request_body_.lock()->clear();
+
+			std::visit([&](auto &w) {
+				w.on_end(err == ECANCELED);
+			}, writer);
+		}
+		else
+		if (s.end_stream_received_ && s.request_body_.lock()->empty()) {
+			s.body_writer_set_ = false;
+
+			std::visit([](auto &w) {
+				w.on_end(true);
+			}, writer);
+
+			return;
+		}
+	}
+	else
+	if (!s.discarding_body_) {
+		// The body waits for the handler to tell where it goes. Meanwhile, the window isn't given back.
+		return;
+	}
+
+	if (!s.end_stream_received_ && !s.reset_ && s.unacknowledged_ >= stream_receive_window / 2) {
+		append_window_update(control_, s.id_, s.unacknowledged_);
+		s.receive_window_ += s.unacknowledged_;
+		s.unacknowledged_ = 0;
+
+		wake();
+	}
+}
+
+void server::session::h2_connection::acknowledge_received(std::uint32_t amount)
+{
+	connection_unacknowledged_ += amount;
+
+	if (connection_unacknowledged_ >= connection_receive_window / 2) {
+		append_window_update(control_, 0, connection_unacknowledged_);
+		connection_receive_window_ += connection_unacknowledged_;
+		connection_unacknowledged_ = 0;
+
+		wake();
+	}
+}
+
+void server::session::h2_connection::reset_stream(std::uint32_t id, h2::error_code code)
+{
+	if (auto it = streams_.find(id); it != streams_.end()) {
+		if (it->second.reset_) {
+			return;
+		}
+
+		it->second.reset_ = true;
+	}
+
+	append_rst_stream(control_, id, code);
+	wake();
+}
+
+void server::session::h2_connection::connection_error(h2::error_code code, std::string_view msg)
+{
+	s_.reqlog_.log_u(logmsg::error, L"HTTP/2 connection error %d: %s", std::uint32_t(code), msg);
+
+	go_away(code);
+
+	stopped_ = true;
+	s_.shutdown(0);
+}
+
+void server::session::h2_connection::sweep()
+{
+	bool const had_streams = !streams_.empty();
+
+	for (auto it = streams_.begin(); it != streams_.end();) {
+		auto &s = it->second;
+
+		// The streams reset by the client keep counting against the limit of concurrent streams until their handler has responded,
+		// so that opening and resetting them in a row can't have more requests handled at once than the limit allows.
+		bool const done = s.reset_
+			? !s.reset_by_client_ || s.headers_ready_ || s.t_->response_.status_ == transaction::response::ended
+			: s.end_stream_sent_ && s.end_stream_received_ && !s.body_writer_set_;
+
+		if (!done) {
+			++it;
+			continue;
+		}
+
+		if (s.body_source_) {
+			s.body_source_->set_event_handler(nullptr);
+		}
+
+		s.t_->detach();
+		it = streams_.erase(it);
+	}
+
+	if (!streams_.empty() || stopped_) {
+		return;
+	}
+
+	if (peer_going_away_) {
+		go_away(h2::error_code::no_error);
+
+		stopped_ = true;
+		s_.shutdown(0);
+
+		return;
+	}
+
+	if (had_streams) {
+		s_.switch_to_keepalive_timer();
+	}
+}
+
+/***************************************************************************************************/
+
+int server::session::h2_connection::consume_buffer()
+{
+	auto buffer = consumer::get_buffer();
+	if (!buffer) {
+		return EFAULT;
+	}
+
+	if (!got_preface_) {
+		auto size = std::min(buffer->size(), h2::preface.size());
+
+		if (std::string_view(reinterpret_cast<const char *>(buffer->get()), size) != h2::preface.substr(0, size)) {
+			connection_error(h2::error_code::protocol_error, "Invalid connection preface.");
+			return 0;
+		}
+
+		if (size < h2::preface.size()) {
+			return ENODATA;
+		}
+
+		buffer->consume(size);
+		got_preface_ = true;
+	}
+
+	while (!stopped_ && !buffer->empty()) {
+		// The client keeps asking for replies it doesn't read: it'll be listened to again once it does.
+		if (control_.size() >= max_control_size) {
+			reading_paused_ = true;
+			sweep();
+
+			return EAGAIN;
+		}
+
+		if (buffer->size() < h2::frame_header::size) {
+			return ENODATA;
+		}
+
+		auto h = h2::frame_header::parse(buffer->get());
+
+		// Nothing bigger than the default has ever been allowed.
+		if (h.length > h2::default_max_frame_size) {
+			connection_error(h2::error_code::frame_size_error, "Frame too big.");
+			break;
+		}
+
+		if (buffer->size() < h2::frame_header::size + h.length) {
+			return ENODATA;
+		}
+
+		process_frame(h, {reinterpret_cast<const char *>(buffer->get()) + h2::frame_header::size, h.length});
+		buffer->consume(h2::frame_header::size + h.length);
+	}
+
+	sweep();
+
+	return 0;
+}
+
+void server::session::h2_connection::process_frame(const h2::frame_header &h, std::string_view payload)
+{
+	if (expecting_continuation_ && h.type != h2::frame_type::continuation) {
+		return connection_error(h2::error_code::protocol_error, "Expected a CONTINUATION frame.");
+	}
+
+	switch (h.type) {
+		case h2::frame_type::data: return process_data(h, payload);
+		case h2::frame_type::headers: return process_headers(h, payload);
+		case h2::frame_type::priority: return process_priority(h, payload);
+		case h2::frame_type::rst_stream: return process_rst_stream(h, payload);
+		case h2::frame_type::settings: return process_settings(h, payload);
+		case h2::frame_type::push_promise: return connection_error(h2::error_code::protocol_error, "Clients must not send PUSH_PROMISE frames.");
+		case h2::frame_type::ping: return process_ping(h, payload);
+		case h2::frame_type::goaway: return process_goaway(h, payload);
+		case h2::frame_type::window_update: return process_window_update(h, payload);
+		case h2::frame_type::continuation: return process_continuation(h, payload);
+	}
+
+	// Frames of unknown types must be ignored.
+}
+
+void server::session::h2_connection::process_data(const h2::frame_header &h, std::string_view payload)
+{
+	if (h.stream_id == 0) {
+		return connection_error(h2::error_code::protocol_error, "DATA frame on stream 0.");
+	}
+
+	if (h.length > connection_receive_window_) {
+		return connection_error(h2::error_code::flow_control_error, "The connection window has been exceeded.");
+	}
+
+	connection_receive_window_ -= h.length;
+	acknowledge_received(h.length);
+
+	auto it = streams_.find(h.stream_id);
+	if (it == streams_.end()) {
+		if (h.stream_id > last_stream_id_) {
+			return connection_error(h2::error_code::protocol_error, "DATA frame on an idle stream.");
+		}
+
+		// The stream has been closed already, what's still in flight is of no use anymore.
+		return;
+	}
+
+	auto &s = it->second;
+
+	if (s.reset_) {
+		return;
+	}
+
+	if (s.end_stream_received_) {
+		return reset_stream(h.stream_id, h2::error_code::stream_closed);
+	}
+
+	if (h.length > s.receive_window_) {
+		return reset_stream(h.stream_id, h2::error_code::flow_control_error);
+	}
+
+	s.receive_window_ -= h.length;
+
+	if (!strip_padding(h, payload)) {
+		return connection_error(h2::error_code::protocol_error, "Invalid padding.");
+	}
+
+	// The padding is never consumed by the body writer, hence it's given back straight away.
+	s.unacknowledged_ += h.length - std::uint32_t(payload.size());
+
+	s.received_body_size_ += payload.size();
+
+	// A body that doesn't add up to the declared content-length makes the request malformed (RFC 9113, 8.1.1).
+	if (s.declared_body_size_) {
+		auto declared = *s.declared_body_size_;
+
+		if (s.received_body_size_ > declared || ((h.flags & h2::flags::end_stream) && s.received_body_size_ < declared)) {
+			s_.reqlog_.log_u(logmsg::error, L"The body of the request on stream %d doesn't match its content-length of %d.", h.stream_id, declared);
+			return reset_stream(h.stream_id, h2::error_code::protocol_error);
+		}
+	}
+
+	if (s.discarding_body_) {
+		s.unacknowledged_ += std::uint32_t(payload.size());
+	}
+	else {
+		s.request_body_.lock()->append(payload);
+	}
+
+	if (h.flags & h2::flags::end_stream) {
+		s.end_stream_received_ = true;
+		s.t_->request_.got_end_of_message_ = true;
+	}
+
+	drain_request_body(s);
+}
+
+void server::session::h2_connection::process_headers(const h2::frame_header &h, std::string_view payload)
+{
+	if (h.stream_id == 0) {
+		return connection_error(h2::error_code::protocol_error, "HEADERS frame on stream 0.");
+	}
+
+	if (!strip_padding(h, payload)) {
+		return connection_error(h2::error_code::protocol_error, "Invalid padding.");
+	}
+
+	if (h.flags & h2::flags::priority) {
+		// The RFC 7540 priority scheme is deprecated, the Priority header is looked at instead.
+		if (payload.size() < 5) {
+			return connection_error(h2::error_code::frame_size_error, "HEADERS frame too short for its priority fields.");
+		}
+
+		payload.remove_prefix(5);
+	}
+
+	header_block_.assign(payload);
+	header_block_stream_ = h.stream_id;
+	header_block_ends_stream_ = h.flags & h2::flags::end_stream;
+
+	if (h.flags & h2::flags::end_headers) {
+		process_end_of_header_block();
+	}
+	else {
+		expecting_continuation_ = true;
+	}
+}
+
+void server::session::h2_connection::process_continuation(const h2::frame_header &h, std::string_view payload)
+{
+	if (!expecting_continuation_ || h.stream_id != header_block_stream_) {
+		return connection_error(h2::error_code::protocol_error, "Unexpected CONTINUATION frame.");
+	}
+
+	if (header_block_.size() + payload.size() > max_header_list_size) {
+		return connection_error(h2::error_code::enhance_your_calm, "Header block too big.");
+	}
+
+	header_block_.append(payload);
+
+	if (h.flags & h2::flags::end_headers) {
+		expecting_continuation_ = false;
+		process_end_of_header_block();
+	}
+}
+
+void server::session::h2_connection::process_end_of_header_block()
+{
+	std::vector<hpack::header_field> fields;
+
+	// Blocks are decoded even when they're to be ignored, for the dynamic table to stay in sync with the client's.
+	if (!decoder_.decode(header_block_, fields)) {
+		return connection_error(h2::error_code::compression_error, "Couldn't decode a header block.");
+	}
+
+	header_block_.clear();
+
+	auto id = header_block_stream_;
+
+	if (auto it = streams_.find(id); it != streams_.end()) {
+		auto &s = it->second;
+
+		if (s.reset_) {
+			return;
+		}
+
+		// Trailers: they must end the stream, and so the body, which must by then be as long as declared. Nothing in them is of any use here.
+		if (s.end_stream_received_ || !header_block_ends_stream_ || (s.declared_body_size_ && s.received_body_size_ != *s.declared_body_size_)) {
+			return reset_stream(id, h2::error_code::protocol_error);
+		}
+
+		s.end_stream_received_ = true;
+		s.t_->request_.got_end_of_message_ = true;
+
+		return drain_request_body(s);
+	}
+
+	if (id <= last_stream_id_) {
+		return connection_error(h2::error_code::stream_closed, "HEADERS frame on a closed stream.");
+	}
+
+	if (id % 2 == 0) {
+		return connection_error(h2::error_code::protocol_error, "Clients must open streams with odd identifiers.");
+	}
+
+	last_stream_id_ = id;
+
+	if (going_away_) {
+		return;
+	}
+
+	if (streams_.size() >= max_concurrent_streams) {
+		return reset_stream(id, h2::error_code::refused_stream);
+	}
+
+	open_stream(id, fields, header_block_ends_stream_);
+}
+
+void server::session::h2_connection::open_stream(std::uint32_t id, const std::vector<hpack::header_field> &fields, bool end_stream)
+{
+	auto t = std::make_shared<transaction>(s_.event_loop_, s_);
+	t->stream_id_ = id;
+	t->request_.version = request::version_2;
+	t->request_.got_end_of_message_ = end_stream;
+	t->response_.chunked_encoding_is_supported_ = false;
+
+	std::optional<std::uint64_t> content_length;
+
+	// A request that ends with its headers has no body: it can't declare to have one.
+	if (!parse_request(t->request_, fields, content_length) || (end_stream && content_length.value_or(0) != 0)) {
+		t->detach();
+		return reset_stream(id, h2::error_code::protocol_error);
+	}
+
+	auto &s = streams_.try_emplace(id).first->second;
+	s.id_ = id;
+	s.t_ = t;
+	s.send_window_ = peer_initial_window_size_;
+	s.receive_window_ = stream_receive_window;
+	s.end_stream_received_ = end_stream;
+	s.declared_body_size_ = content_length;
+	s.urgency_ = urgency_of(t->request_.headers.get("priority"));
+
+	if (streams_.size() == 1) {
+		s_.switch_to_activity_timer();
+	}
+
+	s_.transaction_handler_.handle_transaction(t);
+}
+
+bool server::session::h2_connection::parse_request(transaction::request &r, const std::vector<hpack::header_field> &fields, std::optional<std::uint64_t> &content_length)
+{
+	const std::string *method{}, *scheme{}, *path{}, *authority{};
+	bool got_regular_field = false;
+	std::string cookie;
+
+	auto malformed = [&](std::string_view why) {
+		s_.reqlog_.log_u(logmsg::error, L"Malformed request: %s", why);
+		return false;
+	};
+
+	for (auto &f: fields) {
+		if (!f.name.empty() && f.name.front() == ':') {
+			if (got_regular_field) {
+				return malformed("pseudo-header field after a regular one.");
+			}
+
+			auto pseudo
+				= f.name == ":method" ? &method
+				: f.name == ":scheme" ? &scheme
+				: f.name == ":path" ? &path
+				: f.name == ":authority" ? &authority
+				: nullptr;
+
+			if (!pseudo || *pseudo) {
+				return malformed(fz::sprintf("unknown or repeated pseudo-header field %s.", f.name));
+			}
+
+			*pseudo = &f.value;
+			continue;
+		}
+
+		got_regular_field = true;
+
+		if (std::any_of(f.name.begin(), f.name.end(), [](char c) { return c >= 'A' && c <= 'Z'; })) {
+			return malformed("upper case field name.");
+		}
+
+		if (std::find(std::begin(connection_specific_headers), std::end(connection_specific_headers), f.name) != std::end(connection_specific_headers)) {
+			return malformed(fz::sprintf("connection-specific field %s.", f.name));
+		}
+
+		if (f.name == "te" && f.value != "trailers") {
+			return malformed("TE field with a value other than trailers.");
+		}
+
+		if (f.name == "cookie") {
+			// Cookies may be split across fields, to compress better: they're joined back the way HTTP/1.1 has them.
+			cookie += cookie.empty() ? "" : "; ";
+			cookie += f.value;
+			continue;
+		}
+
+		auto [it, emplaced] = r.headers.try_emplace(f.name, f.value);
+		if (!emplaced) {
+			it->second.as_list().append(field::value_view(f.value));
+		}
+	}
+
+	if (!method || !scheme || !path || path->empty()) {
+		return malformed("missing pseudo-header fields.");
+	}
+
+	if (auto cl = r.headers.get(headers::Content_Length)) {
+		// Repeated fields have been joined into a list, which doesn't parse as a number either.
+		auto size = fz::to_integral<std::uint64_t>(cl.str(), std::uint64_t(-1));
+		if (size == std::uint64_t(-1)) {
+			return malformed("invalid content-length field.");
+		}
+
+		content_length = size;
+	}
+
+	if (!cookie.empty()) {
+		r.headers.try_emplace(headers::Cookie, std::move(cookie));
+	}
+
+	if (authority && !r.headers.get(headers::Host)) {
+		r.headers.try_emplace(headers::Host, *authority);
+	}
+
+	r.method = *method;
+
+	if (auto error = session::parse_request_target(r.uri, *path); !error.empty()) {
+		return malformed(error);
+	}
+
+	return true;
+}
+
+void server::session::h2_connection::process_priority(const h2::frame_header &h, std::string_view payload)
+{
+	if (h.stream_id == 0) {
+		return connection_error(h2::error_code::protocol_error, "PRIORITY frame on stream 0.");
+	}
+
+	if (payload.size() != 5) {
+		return reset_stream(h.stream_id, h2::error_code::frame_size_error);
+	}
+}
+
+void server::session::h2_connection::process_rst_stream(const h2::frame_header &h, std::string_view payload)
+{
+	if (h.stream_id == 0) {
+		return connection_error(h2::error_code::protocol_error, "RST_STREAM frame on stream 0.");
+	}
+
+	if (payload.size() != 4) {
+		return connection_error(h2::error_code::frame_size_error, "RST_STREAM frame of the wrong size.");
+	}
+
+	if (h.stream_id > last_stream_id_) {
+		return connection_error(h2::error_code::protocol_error, "RST_STREAM frame on an idle stream.");
+	}
+
+	if (auto it = streams_.find(h.stream_id); it != streams_.end() && !it->second.reset_) {
+		s_.reqlog_.log(logmsg::debug_verbose, L"Stream %d has been reset by the client, with error code %d.", h.stream_id, h2::frame_header::parse_uint32(bytes_of(payload)));
+		it->second.reset_ = true;
+		it->second.reset_by_client_ = true;
+
+		auto now = monotonic_clock::now();
+		if (!client_resets_window_start_ || now - client_resets_window_start_ >= client_reset_window) {
+			client_resets_window_start_ = now;
+			client_resets_ = 0;
+		}
+
+		if (++client_resets_ > max_client_resets) {
+			return connection_error(h2::error_code::enhance_your_calm, "Too many streams reset by the client.");
+		}
+	}
+}
+
+void server::session::h2_connection::process_settings(const h2::frame_header &h, std::string_view payload)
+{
+	if (h.stream_id != 0) {
+		return connection_error(h2::error_code::protocol_error, "SETTINGS frame on a stream other than 0.");
+	}
+
+	if (h.flags & h2::flags::ack) {
+		if (!payload.empty()) {
+			return connection_error(h2::error_code::frame_size_error, "SETTINGS acknowledgment with a payload.");
+		}
+
+		return;
+	}
+
+	if (payload.size() % 6 != 0) {
+		return connection_error(h2::error_code::frame_size_error, "SETTINGS frame of the wrong size.");
+	}
+
+	for (; !payload.empty(); payload.remove_prefix(6)) {
+		auto p = bytes_of(payload);
+		auto id = h2::setting(std::uint16_t(p[0] << 8 | p[1]));
+		auto value = h2::frame_header::parse_uint32(p + 2);
+
+		switch (id) {
+			case h2::setting::enable_push:
+				if (value > 1) {
+					return connection_error(h2::error_code::protocol_error, "Invalid SETTINGS_ENABLE_PUSH.");
+				}
+				break;
+
+			case h2::setting::initial_window_size: {
+				if (value > h2::max_window_size) {
+					return connection_error(h2::error_code::flow_control_error, "Invalid SETTINGS_INITIAL_WINDOW_SIZE.");
+				}
+
+				// The change applies to the windows of the open streams too.
+				auto delta = std::int64_t(value) - std::int64_t(peer_initial_window_size_);
+				peer_initial_window_size_ = value;
+
+				for (auto &[id, s]: streams_) {
+					s.send_window_ += delta;
+
+					if (s.send_window_ > h2::max_window_size) {
+						return connection_error(h2::error_code::flow_control_error, "A stream window has overflowed.");
+					}
+				}
+			} break;
+
+			case h2::setting::max_frame_size:
+				if (value < h2::default_max_frame_size || value > h2::max_max_frame_size) {
+					return connection_error(h2::error_code::protocol_error, "Invalid SETTINGS_MAX_FRAME_SIZE.");
+				}
+
+				peer_max_frame_size_ = value;
+				break;
+
+			// The encoder never uses the dynamic table, and no stream is ever pushed: the rest is of no interest.
+			default:
+				break;
+		}
+	}
+
+	h2::frame_header{0, h2::frame_type::settings, h2::flags::ack, 0}.append_to(control_);
+	wake();
+}
+
+void server::session::h2_connection::process_ping(const h2::frame_header &h, std::string_view payload)
+{
+	if (h.stream_id != 0) {
+		return connection_error(h2::error_code::protocol_error, "PING frame on a stream other than 0.");
+	}
+
+	if (payload.size() != 8) {
+		return connection_error(h2::error_code::frame_size_error, "PING frame of the wrong size.");
+	}
+
+	if (h.flags & h2::flags::ack) {
+		return;
+	}
+
+	h2::frame_header{8, h2::frame_type::ping, h2::flags::ack, 0}.append_to(control_);
+	control_.append(payload);
+	wake();
+}
+
+void server::session::h2_connection::process_goaway(const h2::frame_header &h, std::string_view payload)
+{
+	if (h.stream_id != 0) {
+		return connection_error(h2::error_code::protocol_error, "GOAWAY frame on a stream other than 0.");
+	}
+
+	if (payload.size() < 8) {
+		return connection_error(h2::error_code::frame_size_error, "GOAWAY frame too short.");
+	}
+
+	// The streams already open are served still, the connection is closed once they're done.
+	s_.reqlog_.log(logmsg::debug_verbose, L"The client is going away, with error code %d.", h2::frame_header::parse_uint32(bytes_of(payload) + 4));
+	peer_going_away_ = true;
+}
+
+void server::session::h2_connection::process_window_update(const h2::frame_header &h, std::string_view payload)
+{
+	if (payload.size() != 4) {
+		return connection_error(h2::error_code::frame_size_error, "WINDOW_UPDATE frame of the wrong size.");
+	}
+
+	auto increment = h2::frame_header::parse_uint32(bytes_of(payload)) & 0x7fffffff;
+
+	if (h.stream_id == 0) {
+		if (increment == 0) {
+			return connection_error(h2::error_code::protocol_error, "WINDOW_UPDATE with a zero increment.");
+		}
+
+		connection_send_window_ += increment;
+
+		if (connection_send_window_ > h2::max_window_size) {
+			return connection_error(h2::error_code::flow_control_error, "The connection window has overflowed.");
+		}
+
+		return wake();
+	}
+
+	auto it = streams_.find(h.stream_id);
+	if (it == streams_.end()) {
+		if (h.stream_id > last_stream_id_) {
+			return connection_error(h2::error_code::protocol_error, "WINDOW_UPDATE frame on an idle stream.");
+		}
+
+		return;
+	}
+
+	auto &s = it->second;
+
+	if (increment == 0) {
+		return reset_stream(h.stream_id, h2::error_code::protocol_error);
+	}
+
+	s.send_window_ += increment;
+
+	if (s.send_window_ > h2::max_window_size) {
+		return reset_stream(h.stream_id, h2::error_code::flow_control_error);
+	}
+
+	wake();
+}
+
+/***************************************************************************************************/
+
+int server::session::h2_connection::add_to_buffer()
+{
+	wake_pending_ = false;
+
+	if (going_away_) {
+		return EAGAIN;
+	}
+
+	auto buffer = adder::get_buffer();
+	if (!buffer) {
+		return EFAULT;
+	}
+
+	if (buffer->size() >= max_buffered_output) {
+		return ENOBUFS;
+	}
+
+	auto const size_before = buffer->size();
+
+	buffer->append(control_);
+	control_.clear();
+
+	if (reading_paused_) {
+		reading_paused_ = false;
+		consumer::send_event(0);
+	}
+
+	std::vector<stream *> order;
+	order.reserve(streams_.size());
+
+	for (auto &[id, s]: streams_) {
+		if (!s.reset_ && !s.end_stream_sent_) {
+			order.push_back(&s);
+		}
+	}
+
+	// The map is sorted by stream id already: the stable sort keeps the older streams first, among those of the same urgency.
+	std::stable_sort(order.begin(), order.end(), [](const stream *lhs, const stream *rhs) {
+		return lhs->urgency_ < rhs->urgency_;
+	});
+
+	// Streams of a lower urgency get served only when those of a higher one have nothing they can send.
+	// Those of the same urgency take turns, a frame each, so that they all make progress.
+	for (std::size_t i = 0; i < order.size() && buffer->size() < max_buffered_output;) {
+		auto end = i;
+		while (end < order.size() && order[end]->urgency_ == order[i]->urgency_) {
+			++end;
+		}
+
+		for (bool progress = true; progress && buffer->size() < max_buffered_output;) {
+			progress = false;
+
+			for (auto k = i; k < end && buffer->size() < max_buffered_output; ++k) {
+				progress |= write_frame(*order[k], *buffer);
+			}
+		}
+
+		i = end;
+	}
+
+	// The frames queued meanwhile, like RST_STREAMs, go out on the next round.
+	bool const added = buffer->size() > size_before;
+
+	sweep();
+
+	return added ? 0 : EAGAIN;
+}
+
+void server::session::h2_connection::pull_response_body(stream &s)
+{
+	for (int i = 0; s.body_source_ && i < 4 && s.response_body_.lock()->size() < max_buffered_body; ++i) {
+		int res = s.body_source_->add_to_buffer();
+
+		if (res == 0) {
+			continue;
+		}
+
+		if (res == EAGAIN || res == ENOBUFS) {
+			break;
+		}
+
+		std::exchange(s.body_source_, nullptr)->set_event_handler(nullptr);
+		auto on_end = std::move(s.on_body_end_);
+
+		if (res == ENODATA) {
+			res = 0;
+		}
+
+		if (on_end) {
+			res = on_end(res);
+		}
+
+		if (res) {
+			reset_stream(s.id_, h2::error_code::internal_error);
+		}
+
+		break;
+	}
+}
+
+bool server::session::h2_connection::write_frame(stream &s, fz::buffer &out)
+{
+	auto const &response = s.t_->response_;
+
+	if (s.reset_ || s.end_stream_sent_) {
+		return false;
+	}
+
+	pull_response_body(s);
+
+	if (s.reset_) {
+		return false;
+	}
+
+	auto body = s.response_body_.lock();
+	bool const last = response.status_ == transaction::response::ended && !s.body_source_;
+
+	auto finish = [&] {
+		s.end_stream_sent_ = true;
+
+		if (!s.end_stream_received_) {
+			// The response is complete before the request is: the client is told to stop sending it.
+			append_rst_stream(out, s.id_, h2::error_code::no_error);
+			s.reset_ = true;
+		}
+	};
+
+	if (!s.headers_sent_) {
+		if (!s.headers_ready_) {
+			return false;
+		}
+
+		bool const end = last && body->empty();
+
+		append_header_block(out, s.id_, s.header_block_, end);
+		s.header_block_.clear();
+		s.headers_sent_ = true;
+
+		if (end) {
+			finish();
+		}
+
+		return true;
+	}
+
+	if (body->empty()) {
+		if (!last) {
+			return false;
+		}
+
+		h2::frame_header{0, h2::frame_type::data, h2::flags::end_stream, s.id_}.append_to(out);
+		finish();
+
+		return true;
+	}
+
+	auto n = std::min({std::int64_t(body->size()), s.send_window_, connection_send_window_, std::int64_t(peer_max_frame_size_)});
+	if (n <= 0) {
+		return false;
+	}
+
+	bool const end = last && std::size_t(n) == body->size();
+
+	h2::frame_header{std::uint32_t(n), h2::frame_type::data, end ? h2::flags::end_stream : std::uint8_t(0), s.id_}.append_to(out);
+	out.append(body->get(), std::size_t(n));
+	body->consume(std::size_t(n));
+
+	s.send_window_ -= n;
+	connection_send_window_ -= n;
+
+	if (end) {
+		finish();
+	}
+
+	return true;
+}
+
+void server::session::h2_connection::append_header_block(fz::buffer &out, std::uint32_t id, const fz::buffer &block, bool end_stream)
+{
+	// The block is split in a HEADERS frame followed by as many CONTINUATION frames as needed, back to back.
+	std::size_t offset = 0;
+
+	do {
+		auto n = std::min(block.size() - offset, std::size_t(peer_max_frame_size_));
+		bool const first = offset == 0;
+		bool const last = offset + n == block.size();
+
+		std::uint8_t flags = 0;
+		if (first && end_stream) {
+			flags |= h2::flags::end_stream;
+		}
+		if (last) {
+			flags |= h2::flags::end_headers;
+		}
+
+		h2::frame_header{std::uint32_t(n), first ? h2::frame_type::headers : h2::frame_type::continuation, flags, id}.append_to(out);
+		out.append(block.get() + offset, n);
+
+		offset += n;
+	} while (offset < block.size());
+}
+
+void server::session::h2_connection::append_window_update(fz::buffer &out, std::uint32_t id, std::uint32_t increment)
+{
+	h2::frame_header{4, h2::frame_type::window_update, 0, id}.append_to(out);
+	h2::frame_header::append_uint32(out, increment);
+}
+
+void server::session::h2_connection::append_rst_stream(fz::buffer &out, std::uint32_t id, h2::error_code code)
+{
+	h2::frame_header{4, h2::frame_type::rst_stream, 0, id}.append_to(out);
+	h2::frame_header::append_uint32(out, std::uint32_t(code));
+}
+
+}
@@ -0,0 +1,143 @@
+#ifndef FZ_HTTP_SERVER_SESSION_H2_CONNECTION_HPP
+#define FZ_HTTP_SERVER_SESSION_H2_CONNECTION_HPP
+
+#include <map>
+#include <optional>
+
+#include <libfilezilla/time.hpp>
+
+#include "../../h2.hpp"
+#include "../../hpack.hpp"
+
+#include "transaction.hpp"
+
+namespace fz::http {
+
+/// \brief Serves the streams of a connection over which HTTP/2 has been negotiated.
+/// It takes the place of the session as both the adder and the consumer of the channel. Each stream gets a transaction of the session,
+/// which the transaction_handler handles just like the ones of HTTP/1.x requests: the session routes what the responder is told to the stream.
+struct server::session::h2_connection final: public buffer_operator::adder, public buffer_operator::consumer
+{
+	explicit h2_connection(session &s);
+	~h2_connection() override;
+
+	/// Sends the server's own preface, made of its settings.
+	void start();
+
+	/// Sends a GOAWAY straight away, ahead of anything that's not been added to the channel's buffer yet.
+	void go_away(h2::error_code code);
+
+	util::buffer_streamer output_stream(transaction &t);
+	void send_informational(transaction &t, unsigned int code);
+	void send_headers(transaction &t, const std::vector<hpack::header_field> &fields);
+	void send_body(transaction &t, buffer_operator::adder_interface &source, std::function<int(int)> on_eof);
+	void send_end(transaction &t);
+	void abort(transaction &t);
+
+	/// Hands the request body of \p t, both what's been received already and what will be, to its body_writer_.
+	bool receive_body(transaction &t);
+
+	/// A body writer that had returned EAGAIN can consume again.
+	void on_body_writer_event();
+
+	int add_to_buffer() override;
+	int consume_buffer() override;
+
+private:
+	struct stream
+	{
+		std::uint32_t id_{};
+		std::shared_ptr<transaction> t_;
+
+		buffer_operator::unsafe_locking_buffer request_body_;
+		buffer_operator::unsafe_locking_buffer response_body_;
+		buffer_operator::adder_interface *body_source_{};
+		std::function<int(int)> on_body_end_;
+		fz::buffer header_block_;
+
+		std::int64_t send_window_{};
+		std::uint32_t receive_window_{};
+		std::uint32_t unacknowledged_{};
+
+		// The content-length of the request, if it came with one, which the DATA frames must add up to.
+		std::optional<std::uint64_t> declared_body_size_;
+		std::uint64_t received_body_size_{};
+
+		// RFC 9218 urgency: the lower, the sooner the stream is served.
+		int urgency_ = 3;
+
+		bool headers_ready_{};
+		bool headers_sent_{};
+		bool end_stream_sent_{};
+		bool end_stream_received_{};
+		bool body_writer_set_{};
+		bool discarding_body_{};
+		bool reset_{};
+		bool reset_by_client_{};
+	};
+
+	stream *find_stream(const transaction &t);
+	void wake();
+	void sweep();
+
+	void process_frame(const h2::frame_header &h, std::string_view payload);
+	void process_data(const h2::frame_header &h, std::string_view payload);
+	void process_headers(const h2::frame_header &h, std::string_view payload);
+	void process_continuation(const h2::frame_header &h, std::string_view payload);
+	void process_priority(const h2::frame_header &h, std::string_view payload);
+	void process_rst_stream(const h2::frame_header &h, std::string_view payload);
+	void process_settings(const h2::frame_header &h, std::string_view payload);
+	void process_ping(const h2::frame_header &h, std::string_view payload);
+	void process_goaway(const h2::frame_header &h, std::string_view payload);
+	void process_window_update(const h2::frame_header &h, std::string_view payload);
+
+	void process_end_of_header_block();
+	void open_stream(std::uint32_t id, const std::vector<hpack::header_field> &fields, bool end_stream);
+	bool parse_request(transaction::request &r, const std::vector<hpack::header_field> &fields, std::optional<std::uint64_t> &content_length);
+
+	void drain_request_body(stream &s);
+	void acknowledge_received(std::uint32_t amount);
+	void pull_response_body(stream &s);
+	bool write_frame(stream &s, fz::buffer &out);
+	void append_header_block(fz::buffer &out, std::uint32_t id, const fz::buffer &block, bool end_stream);
+	void append_window_update(fz::buffer &out, std::uint32_t id, std::uint32_t increment);
+	void append_rst_stream(fz::buffer &out, std::uint32_t id, h2::error_code code);
+
+	void reset_stream(std::uint32_t id, h2::error_code code);
+	void connection_error(h2::error_code code, std::string_view msg);
+
+	session &s_;
+	hpack::decoder decoder_;
+
+	std::map<std::uint32_t, stream> streams_;
+	std::uint32_t last_stream_id_{};
+
+	// The frames not bound to the flow of any stream, sent ahead of everything else.
+	fz::buffer control_;
+
+	std::string header_block_;
+	std::uint32_t header_block_stream_{};
+	bool header_block_ends_stream_{};
+	bool expecting_continuation_{};
+
+	std::int64_t connection_send_window_ = h2::default_window_size;
+	std::uint32_t connection_receive_window_{};
+	std::uint32_t connection_unacknowledged_{};
+
+	std::uint32_t peer_initial_window_size_ = h2::default_window_size;
+	std::uint32_t peer_max_frame_size_ = h2::default_max_frame_size;
+
+	monotonic_clock client_resets_window_start_;
+	unsigned int client_resets_{};
+
+	bool got_preface_{};
+	bool going_away_{};
+	bool peer_going_away_{};
+	bool stopped_{};
+	bool wake_pending_{};
+	bool reading_paused_{};
+};
+
+}
+
+#endif // FZ_HTTP_SERVER_SESSION_H2_CONNECTION_HPP
@@ -49,6 +49,11 @@ void server::session::transaction::detach()
 		adder.set_event_handler(nullptr);
 	}, response_.body_reader_);
 
+	if (response_.body_compressor_) {
+		response_.body_compressor_->set_buffer(nullptr);
+		response_.body_compressor_->set_event_handler(nullptr);
+	}
+
 	if (response_.body_chunker_) {
 		response_.body_chunker_->set_buffer(nullptr);
 		response_.body_chunker_->set_event_handler(nullptr);
@@ -58,7 +63,7 @@ void server::session::transaction::detach()
 bool server::session::transaction::send_status(unsigned int code, std::string_view reason)
 {
 	if (auto s = get_session()) {
-		return s->send_status(code, reason);
+		return s->send_status(*this, code, reason);
 	}
 
 	return false;
@@ -67,7 +72,7 @@ bool server::session::transaction::send_status(unsigned int code, std::string_vi
 bool server::session::transaction::send_headers(std::initializer_list<std::pair<field::name_view, field::value_view>> list)
 {
 	if (auto s = get_session()) {
-		return s->send_headers(list);
+		return s->send_headers(*this, list);
 	}
 
 	return false;
@@ -76,7 +81,7 @@ bool server::session::transaction::send_headers(std::initializer_list<std::pair<
 bool server::session::transaction::send_body(std::string_view body)
 {
 	if (auto s = get_session()) {
-		return s->send_body(body);
+		return s->send_body(*this, body);
 	}
 
 	return false;
@@ -85,7 +90,16 @@ bool server::session::transaction::send_body(std::string_view body)
 bool server::session::transaction::send_body(tvfs::file_holder file)
 {
 	if (auto s = get_session()) {
-		return s->send_body(std::move(file));
+		return s->send_body(*this, std::move(file));
+	}
+
+	return false;
+}
+
+bool server::session::transaction::send_body(tvfs::file_holder file, const byte_ranges &ranges, std::string_view boundary, std::string_view content_type)
+{
+	if (auto s = get_session()) {
+		return s->send_body(*this, std::move(file), ranges, boundary, content_type);
 	}
 
 	return false;
@@ -94,7 +108,16 @@ bool server::session::transaction::send_body(tvfs::file_holder file)
 bool server::session::transaction::send_body(tvfs::entries_iterator it)
 {
 	if (auto s = get_session()) {
-		return s->send_body(std::move(it));
+		return s->send_body(*this, std::move(it));
+	}
+
+	return false;
+}
+
+bool server::session::transaction::send_body(std::unique_ptr<buffer_operator::adder_interface> adder)
+{
+	if (auto s = get_session()) {
+		return s->send_body(*this, std::move(adder));
 	}
 
 	return false;
@@ -103,7 +126,7 @@ bool server::session::transaction::send_body(tvfs::entries_iterator it)
 bool server::session::transaction::send_end()
 {
 	if (auto s = get_session()) {
-		return s->send_end();
+		return s->send_end(*this);
 	}
 
 	return false;
@@ -112,7 +135,7 @@ bool server::session::transaction::send_end()
 void server::session::transaction::abort_send(std::string_view msg)
 {
 	if (auto s = get_session()) {
-		s->abort_send(msg);
+		s->abort_send(*this, msg);
 	}
 }
 
@@ -21,6 +21,33 @@ struct server::session::transaction: public server::transaction, private server:
 		buffer_operator::file_reader fr_;
 	};
 
+	struct ranges_reader: buffer_operator::delegate_adder
+	{
+		struct part
+		{
+			std::string header;
+			byte_range range;
+		};
+
+		ranges_reader(tvfs::file_holder file, logger_interface &logger, std::vector<part> parts, std::string epilogue)
+			: delegate_adder(fr_)
+			, file_(std::move(file))
+			, fr_(*file_, 128*1024, &logger)
+			, parts_(std::move(parts))
+			, epilogue_(std::move(epilogue))
+		{}
+
+		int add_to_buffer() override;
+
+	private:
+		tvfs::file_holder file_;
+		buffer_operator::file_reader fr_;
+		std::vector<part> parts_;
+		std::string epilogue_;
+		std::size_t current_{};
+		bool started_{};
+	};
+
 	struct plain_entries_reader: fz::buffer_operator::tvfs_entries_lister<fz::buffer_operator::with_suffix<tvfs::entry_stats>, std::string_view>
 	{
 		plain_entries_reader(event_loop &loop, tvfs::entries_iterator it)
@@ -80,6 +107,17 @@ struct server::session::transaction: public server::transaction, private server:
 		using no_adder::no_adder;
 	};
 
+	struct custom_reader: buffer_operator::delegate_adder
+	{
+		custom_reader(std::unique_ptr<buffer_operator::adder_interface> adder)
+			: delegate_adder(*adder)
+			, adder_(std::move(adder))
+		{}
+
+	private:
+		std::unique_ptr<buffer_operator::adder_interface> adder_;
+	};
+
 
 	struct response {
 		enum status {
@@ -92,15 +130,25 @@ struct server::session::transaction: public server::transaction, private server:
 		};
 
 		status status_{};
+		unsigned int code_{};
 		fz::buffer headers_buffer_;
 
-		std::variant<no_reader, file_reader, plain_entries_reader, html_entries_reader, ndjson_entries_reader> body_reader_;
+		// What's made of the response before it's its turn to be sent.
+		fz::buffer pending_output_;
+		buffer_operator::adder_interface *pending_body_{};
+
+		std::variant<no_reader, file_reader, ranges_reader, plain_entries_reader, html_entries_reader, ndjson_entries_reader, custom_reader> body_reader_;
+		std::optional<body_compressor> body_compressor_;
 		std::optional<body_chunker> body_chunker_;
+		body_compressor::ticket compression_ticket_;
 
 		bool chunked_encoding_is_supported_{true};
 		bool chunked_encoding_requested_{false};
 		bool close_connection_{};
+		bool accepts_ranges_{};
 		headers::mapped_type content_type;
+		headers::mapped_type content_encoding;
+		headers::mapped_type etag;
 	};
 
 	struct no_writer: buffer_operator::no_consumer
@@ -175,7 +223,6 @@ struct server::session::transaction: public server::transaction, private server:
 
 		bool close_connection_{};
 		bool got_end_of_message_{};
-		bool waiting_for_consumer_event_{};
 
 		std::variant<no_writer, file_writer, string_writer> body_writer_{};
 	};
@@ -193,6 +240,7 @@ struct server::session::transaction: public server::transaction, private server:
 
 private:
 	friend session;
+	friend h2_connection;
 
 	event_loop &event_loop_;
 	mutex mutex_;
@@ -201,12 +249,17 @@ private:
 	request request_;
 	response response_;
 
+	// The HTTP/2 stream the transaction is carried by, or 0 for HTTP/1.x.
+	std::uint32_t stream_id_{};
+
 private:
 	bool send_status(unsigned int code, std::string_view reason) override;
 	bool send_headers(std::initializer_list<std::pair<field::name_view, field::value_view> >) override;
 	bool send_body(std::string_view) override;
 	bool send_body(tvfs::file_holder file) override;
+	bool send_body(tvfs::file_holder file, const byte_ranges &ranges, std::string_view boundary, std::string_view content_type) override;
 	bool send_body(tvfs::entries_iterator it) override;
+	bool send_body(std::unique_ptr<buffer_operator::adder_interface> adder) override;
 	bool send_end() override;
 	void abort_send(std::string_view msg) override;
 
@@ -0,0 +1,531 @@
+#include <algorithm>
+
+#include <zlib.h>
+
+#include "zip_archiver.hpp"
+
+#include "../strresult.hpp"
+
+namespace fz::http {
+
+namespace {
+
+constexpr std::size_t max_buffer_size = 128*1024;
+constexpr std::size_t read_size = 64*1024;
+constexpr std::size_t output_chunk_size = 64*1024;
+constexpr int compression_level = 5;
+
+// 4.5 is the first version of the format with ZIP64.
+constexpr std::uint16_t version_needed = 45;
+constexpr std::uint16_t version_made_by = (3 << 8) | version_needed; // 3 is Unix, for the permissions in the external attributes.
+
+constexpr std::uint16_t flag_data_descriptor = 1 << 3;
+constexpr std::uint16_t flag_utf8 = 1 << 11;
+
+// Tells that the actual value is in the ZIP64 extra field.
+constexpr std::uint32_t zip64_marker = 0xFFFFFFFF;
+
+constexpr std::uint16_t zip64_extra_id = 0x0001;
+constexpr std::uint16_t timestamp_extra_id = 0x5455;
+
+std::pair<std::uint16_t /*time*/, std::uint16_t /*date*/> to_dos(const datetime &t)
+{
+	if (!t.empty()) {
+		auto tm = t.get_tm(datetime::local);
+
+		if (tm.tm_year >= 80 && tm.tm_year < 80+128) {
+			return {
+				std::uint16_t((tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2)),
+				std::uint16_t(((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday)
+			};
+		}
+	}
+
+	// 1980-01-01, the earliest date there is.
+	return { 0, (1 << 5) | 1 };
+}
+
+// The DOS time is local and has a resolution of two seconds: the extended timestamp field tells the exact UTC time, to the clients that know about it.
+std::optional<std::uint32_t> to_unix(const datetime &t)
+{
+	if (!t.empty()) {
+		auto u = t.get_time_t();
+
+		if (u >= 0 && std::uint64_t(u) <= std::uint64_t(0xFFFFFFFF)) {
+			return std::uint32_t(u);
+		}
+	}
+
+	return std::nullopt;
+}
+
+}
+
+class zip_archiver::writer
+{
+public:
+	writer(fz::buffer &buffer, std::uint64_t &offset)
+		: buffer_(buffer)
+		, offset_(offset)
+	{}
+
+	writer &u8(std::uint8_t v)
+	{
+		return le(v, 1);
+	}
+
+	writer &u16(std::uint16_t v)
+	{
+		return le(v, 2);
+	}
+
+	writer &u32(std::uint32_t v)
+	{
+		return le(v, 4);
+	}
+
+	writer &u64(std::uint64_t v)
+	{
+		return le(v, 8);
+	}
+
+	writer &bytes(std::string_view s)
+	{
+		buffer_.append(s);
+		offset_ += s.size();
+		return *this;
+	}
+
+	unsigned char *get(std::size_t size)
+	{
+		return buffer_.get(size);
+	}
+
+	void add(std::size_t size)
+	{
+		buffer_.add(size);
+		offset_ += size;
+	}
+
+	std::size_t size() const
+	{
+		return buffer_.size();
+	}
+
+	/// \returns the offset, from the beginning of the archive, of the next byte to be written.
+	std::uint64_t offset() const
+	{
+		return offset_;
+	}
+
+private:
+	writer &le(std::uint64_t v, std::size_t size)
+	{
+		auto p = buffer_.get(size);
+
+		for (std::size_t i = 0; i < size; ++i) {
+			p[i] = static_cast<unsigned char>(v >> (8*i));
+		}
+
+		add(size);
+		return *this;
+	}
+
+	fz::buffer &buffer_;
+	std::uint64_t &offset_;
+};
+
+struct zip_archiver::deflater
+{
+	deflater()
+	{
+		// Negative window bits make zlib write a raw deflate stream: the ZIP headers take the place of the zlib ones.
+		ok = deflateInit2(&zs, compression_level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+	}
+
+	~deflater()
+	{
+		if (ok)
+			deflateEnd(&zs);
+	}
+
+	void reset()
+	{
+		deflateReset(&zs);
+	}
+
+	bool deflate_into(const unsigned char *data, std::size_t size, writer &w, bool finish)
+	{
+		zs.next_in = const_cast<unsigned char *>(data);
+		zs.avail_in = uInt(size);
+
+		int flush = finish ? Z_FINISH : Z_NO_FLUSH;
+
+		do {
+			zs.next_out = w.get(output_chunk_size);
+			zs.avail_out = uInt(output_chunk_size);
+
+			auto res = deflate(&zs, flush);
+			if (res != Z_OK && res != Z_STREAM_END && res != Z_BUF_ERROR)
+				return false;
+
+			w.add(output_chunk_size - zs.avail_out);
+		} while (zs.avail_out == 0);
+
+		return true;
+	}
+
+	z_stream zs{};
+	bool ok{};
+};
+
+zip_archiver::zip_archiver(tvfs::engine &tvfs, std::string_view base_path, std::vector<std::string> names, method m, logger_interface &logger, std::shared_ptr<void> tvfs_owner)
+	: tvfs_(tvfs)
+	, tvfs_owner_(std::move(tvfs_owner))
+	, logger_(logger)
+	, base_path_(base_path)
+	, names_(std::move(names))
+{
+	while (!base_path_.empty() && base_path_.back() == '/') {
+		base_path_.pop_back();
+	}
+
+	if (m == method::deflated) {
+		ticket_ = body_compressor::ticket::acquire();
+
+		if (ticket_) {
+			deflater_ = std::make_unique<deflater>();
+
+			if (!deflater_->ok) {
+				deflater_.reset();
+			}
+			else {
+				deflater_input_.resize(read_size);
+			}
+		}
+		else {
+			logger_.log_raw(logmsg::debug_verbose, L"Too many bodies are being compressed already, storing the files of the archive as they are.");
+		}
+	}
+
+	if (names_.empty()) {
+		tvfs::entries_iterator it;
+
+		if (auto res = tvfs_.get_entries(it, base_path_.empty() ? "/" : base_path_, tvfs::traversal_mode::only_children)) {
+			directories_.push_back({std::move(it), base_path_, {}});
+		}
+		else {
+			logger_.log_u(logmsg::error, L"Couldn't list %s: %s. The archive will be empty.", base_path_, strresult(res));
+		}
+	}
+}
+
+zip_archiver::~zip_archiver()
+{
+}
+
+int zip_archiver::add_to_buffer()
+{
+	auto buffer = get_buffer();
+	if (!buffer)
+		return EFAULT;
+
+	if (finished_)
+		return ENODATA;
+
+	if (buffer->size() >= max_buffer_size)
+		return ENOBUFS;
+
+	writer w(*buffer, offset_);
+
+	while (w.size() < max_buffer_size) {
+		if (file_) {
+			if (int res = add_file_data(w); res != 0)
+				return res;
+
+			continue;
+		}
+
+		if (walking_) {
+			if (!add_next_entry(w)) {
+				walking_ = false;
+				central_offset_ = w.offset();
+			}
+
+			continue;
+		}
+
+		if (next_central_ < central_.size()) {
+			write_central_header(w, central_[next_central_++]);
+			continue;
+		}
+
+		write_end_records(w);
+		finished_ = true;
+		break;
+	}
+
+	return 0;
+}
+
+bool zip_archiver::add_next_entry(writer &w)
+{
+	while (!directories_.empty()) {
+		auto &d = directories_.back();
+
+		if (!d.it.has_next()) {
+			directories_.pop_back();
+			continue;
+		}
+
+		auto e = d.it.next();
+		if (!e) {
+			continue;
+		}
+
+		add_entry(w, d.path + "/" + e.name(), d.prefix + e.name(), e);
+		return true;
+	}
+
+	if (next_name_ < names_.size()) {
+		auto &name = names_[next_name_++];
+		auto path = base_path_ + "/" + name;
+
+		auto [res, e] = tvfs_.get_entry(path);
+		if (!res) {
+			logger_.log_u(logmsg::debug_warning, L"Leaving %s out of the archive: %s.", path, strresult(res));
+			return true;
+		}
+
+		add_entry(w, path, name, e);
+		return true;
+	}
+
+	return false;
+}
+
+void zip_archiver::add_entry(writer &w, const std::string &path, std::string name, const tvfs::entry &e)
+{
+	// Not even 0xFFFF will do, since directories get a slash appended.
+	if (name.size() >= 0xFFFF) {
+		logger_.log_u(logmsg::debug_warning, L"Leaving %s out of the archive: its name is too long.", path);
+		return;
+	}
+
+	if (e.is_symlink()) {
+		// Links to files are archived as the files they point to. Links to directories aren't followed, so that no loop can ever be walked.
+		auto [res, target] = tvfs_.get_entry(path);
+		if (!res) {
+			logger_.log_u(logmsg::debug_warning, L"Leaving %s out of the archive: %s.", path, strresult(res));
+			return;
+		}
+
+		if (!target.is_file()) {
+			logger_.log_u(logmsg::debug_warning, L"Leaving %s out of the archive: it's a link to a directory.", path);
+			return;
+		}
+
+		return add_entry(w, path, std::move(name), target);
+	}
+
+	if (e.is_directory()) {
+		tvfs::entries_iterator it;
+
+		if (auto res = tvfs_.get_entries(it, path, tvfs::traversal_mode::only_children); !res) {
+			logger_.log_u(logmsg::debug_warning, L"Leaving %s out of the archive: %s.", path, strresult(res));
+			return;
+		}
+
+		name += '/';
+
+		auto &c = central_.emplace_back();
+		c.name = name;
+		c.offset = w.offset();
+		c.flags = flag_utf8;
+		c.m = method::stored;
+		c.mtime = e.mtime();
+		c.is_dir = true;
+
+		write_local_header(w, c);
+
+		directories_.push_back({std::move(it), path, std::move(name)});
+	}
+	else
+	if (e.is_file()) {
+		tvfs::file_holder file;
+
+		if (auto res = tvfs_.open_file(file, path, file::reading, 0); !res) {
+			logger_.log_u(logmsg::debug_warning, L"Leaving %s out of the archive: %s.", path, strresult(res));
+			return;
+		}
+
+		auto &c = central_.emplace_back();
+		c.name = std::move(name);
+		c.offset = w.offset();
+		c.flags = flag_utf8 | flag_data_descriptor;
+		c.m = deflater_ ? method::deflated : method::stored;
+		c.mtime = e.mtime();
+
+		if (deflater_) {
+			deflater_->reset();
+		}
+
+		write_local_header(w, c);
+
+		file_ = std::move(file);
+	}
+}
+
+int zip_archiver::add_file_data(writer &w)
+{
+	auto &c = central_.back();
+
+	auto to_read = deflater_ ? deflater_input_.size() : std::min(read_size, max_buffer_size - w.size());
+	auto p = deflater_ ? deflater_input_.data() : w.get(to_read);
+
+	auto r = file_->read2(p, to_read);
+	if (!r) {
+		// The headers have been sent already: the archive can only be cut short, which the client will notice.
+		logger_.log_u(logmsg::error, L"Error while reading %s for the archive: %s.", c.name, strresult(r));
+		return EIO;
+	}
+
+	c.crc = std::uint32_t(crc32(c.crc, p, uInt(r.value_)));
+	c.uncompressed_size += r.value_;
+
+	if (deflater_) {
+		auto before = w.offset();
+
+		if (!deflater_->deflate_into(p, r.value_, w, r.value_ == 0)) {
+			logger_.log_u(logmsg::error, L"Failed compressing %s for the archive.", c.name);
+			return EFAULT;
+		}
+
+		c.compressed_size += w.offset() - before;
+	}
+	else {
+		w.add(r.value_);
+		c.compressed_size += r.value_;
+	}
+
+	if (r.value_ == 0) {
+		w
+			.u32(0x08074b50)
+			.u32(c.crc)
+			.u64(c.compressed_size)
+			.u64(c.uncompressed_size);
+
+		file_ = {};
+	}
+
+	return 0;
+}
+
+void zip_archiver::write_local_header(writer &w, const central_entry &e)
+{
+	auto [time, date] = to_dos(e.mtime);
+	auto unix_time = to_unix(e.mtime);
+
+	// The CRC and the sizes are in the data descriptor that follows the data. Directories have none of those.
+	w
+		.u32(0x04034b50)
+		.u16(version_needed)
+		.u16(e.flags)
+		.u16(std::uint16_t(e.m))
+		.u16(time)
+		.u16(date)
+		.u32(0)
+		.u32(zip64_marker)
+		.u32(zip64_marker)
+		.u16(std::uint16_t(e.name.size()))
+		.u16(std::uint16_t(4+16 + (unix_time ? 4+5 : 0)))
+		.bytes(e.name)
+		.u16(zip64_extra_id).u16(16)
+			.u64(0)
+			.u64(0);
+
+	if (unix_time) {
+		w.u16(timestamp_extra_id).u16(5)
+			.u8(1)
+			.u32(*unix_time);
+	}
+}
+
+void zip_archiver::write_central_header(writer &w, const central_entry &e)
+{
+	auto [time, date] = to_dos(e.mtime);
+	auto unix_time = to_unix(e.mtime);
+
+	std::uint32_t external_attributes = e.is_dir
+		? (040755u << 16) | 0x10
+		: (0100644u << 16);
+
+	w
+		.u32(0x02014b50)
+		.u16(version_made_by)
+		.u16(version_needed)
+		.u16(e.flags)
+		.u16(std::uint16_t(e.m))
+		.u16(time)
+		.u16(date)
+		.u32(e.crc)
+		.u32(zip64_marker)
+		.u32(zip64_marker)
+		.u16(std::uint16_t(e.name.size()))
+		.u16(std::uint16_t(4+24 + (unix_time ? 4+5 : 0)))
+		.u16(0) // Comment length
+		.u16(0) // Disk number
+		.u16(0) // Internal attributes
+		.u32(external_attributes)
+		.u32(zip64_marker)
+		.bytes(e.name)
+		.u16(zip64_extra_id).u16(24)
+			.u64(e.uncompressed_size)
+			.u64(e.compressed_size)
+			.u64(e.offset);
+
+	if (unix_time) {
+		w.u16(timestamp_extra_id).u16(5)
+			.u8(1)
+			.u32(*unix_time);
+	}
+}
+
+void zip_archiver::write_end_records(writer &w)
+{
+	auto central_size = w.offset() - central_offset_;
+	auto zip64_end_offset = w.offset();
+
+	// ZIP64 end of central directory record
+	w
+		.u32(0x06064b50)
+		.u64(44) // Size of the rest of the record
+		.u16(version_made_by)
+		.u16(version_needed)
+		.u32(0)  // Number of this disk
+		.u32(0)  // Disk where the central directory starts
+		.u64(central_.size())
+		.u64(central_.size())
+		.u64(central_size)
+		.u64(central_offset_);
+
+	// ZIP64 end of central directory locator
+	w
+		.u32(0x07064b50)
+		.u32(0)
+		.u64(zip64_end_offset)
+		.u32(1); // Total number of disks
+
+	// End of central directory record, whose values are all in the ZIP64 one.
+	w
+		.u32(0x06054b50)
+		.u16(0)
+		.u16(0)
+		.u16(0xFFFF)
+		.u16(0xFFFF)
+		.u32(zip64_marker)
+		.u32(zip64_marker)
+		.u16(0); // Comment length
+}
+
+}
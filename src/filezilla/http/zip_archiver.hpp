@@ -0,0 +1,99 @@
+#ifndef FZ_HTTP_ZIP_ARCHIVER_HPP
+#define FZ_HTTP_ZIP_ARCHIVER_HPP
+
+#include <memory>
+#include <vector>
+
+#include <libfilezilla/logger.hpp>
+
+#include "../buffer_operator/adder.hpp"
+#include "../tvfs/engine.hpp"
+
+#include "body_compressor.hpp"
+
+namespace fz::http {
+
+/// \brief Adds to the buffer a ZIP64 archive of a tvfs directory, or of a selection of its entries, walking them recursively as it goes.
+///
+/// Nothing is written to disk and nothing is held in memory beyond the file being read and the central directory,
+/// which takes a few dozen bytes per entry. Since the sizes and the CRCs of the files are only known once they have
+/// been read, each file is followed by a data descriptor, which makes the archive suitable for being sent chunked.
+///
+/// Each entry is listed and opened through the tvfs engine, hence with the permissions of the user it belongs to:
+/// entries that can't be listed or opened are left out of the archive.
+class zip_archiver: public buffer_operator::adder
+{
+public:
+	enum class method: std::uint16_t
+	{
+		stored = 0,
+		deflated = 8
+	};
+
+	/// \param base_path the tvfs path of the directory whose entries are archived.
+	/// \param names the entries of \p base_path to archive. If empty, all of them are.
+	/// \param m the compression method. Deflate falls back to stored if no body_compressor::ticket is available.
+	/// \param tvfs_owner kept alive as long as the archiver is, since the \p tvfs engine is used until the very end.
+	zip_archiver(tvfs::engine &tvfs, std::string_view base_path, std::vector<std::string> names, method m, logger_interface &logger, std::shared_ptr<void> tvfs_owner = {});
+	~zip_archiver() override;
+
+	int add_to_buffer() override;
+
+private:
+	struct central_entry
+	{
+		std::string name;
+		std::uint64_t offset{};
+		std::uint64_t compressed_size{};
+		std::uint64_t uncompressed_size{};
+		std::uint32_t crc{};
+		std::uint16_t flags{};
+		method m{};
+		datetime mtime;
+		bool is_dir{};
+	};
+
+	struct directory
+	{
+		tvfs::entries_iterator it;
+		std::string path;
+		std::string prefix;
+	};
+
+	struct deflater;
+	class writer;
+
+	bool add_next_entry(writer &w);
+	void add_entry(writer &w, const std::string &path, std::string name, const tvfs::entry &e);
+	int add_file_data(writer &w);
+
+	static void write_local_header(writer &w, const central_entry &e);
+	static void write_central_header(writer &w, const central_entry &e);
+	void write_end_records(writer &w);
+
+	tvfs::engine &tvfs_;
+	std::shared_ptr<void> tvfs_owner_;
+	logger_interface &logger_;
+
+	std::string base_path_;
+	std::vector<std::string> names_;
+	std::size_t next_name_{};
+	std::vector<directory> directories_;
+
+	body_compressor::ticket ticket_;
+	std::unique_ptr<deflater> deflater_;
+
+	tvfs::file_holder file_;
+	std::vector<unsigned char> deflater_input_;
+	std::vector<central_entry> central_;
+	std::uint64_t offset_{};
+	bool walking_{true};
+
+	std::size_t next_central_{};
+	std::uint64_t central_offset_{};
+	bool finished_{};
+};
+
+}
+
+#endif // FZ_HTTP_ZIP_ARCHIVER_HPP
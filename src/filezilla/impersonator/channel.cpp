@@ -10,6 +10,7 @@
 #include "../mpl/for_each.hpp"
 #include "../logger/type.hpp"
 #include "../strsyserror.hpp"
+#include "../event_loop_monitor.hpp"
 
 namespace fz::impersonator {
 
@@ -386,6 +387,8 @@ void caller::on_can_recv()
 					logger_.log_u(logmsg::debug_info, L"[%s]: dispatching message", util::type_name<T>());
 				}
 
+				round_trip_metric_.record(res.sent_);
+
 				using E = make_receiver_event_t<T>;
 
 				std::apply([&](auto &&... args) {
@@ -427,6 +430,8 @@ void caller::on_can_send()
 				return;
 			}
 
+			req.res_.sent_ = {};
+
 			if (timeout_) {
 				req.res_.deadline_ = monotonic_clock::now() + timeout_;
 
@@ -474,6 +479,8 @@ void caller::on_timer(timer_id id)
 
 void caller::operator()(const event_base &ev)
 {
+	event_loop_monitor::dispatch_scope monitored(*this, ev);
+
 	fz::dispatch<
 		channel::ready,
 		channel::error,
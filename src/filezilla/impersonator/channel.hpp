@@ -11,6 +11,7 @@
 #include "../util/locking_wrapper.hpp"
 #include "../enum_bitops.hpp"
 #include "../receiver/glue/rmp.hpp"
+#include "../metrics/registry.hpp"
 
 namespace fz::impersonator {
 
@@ -83,6 +84,10 @@ struct caller: private event_handler
 		: event_handler(loop)
 		, logger_(logger)
 		, timeout_(timeout)
+		, round_trip_metric_(metrics::registry::global().get_histogram(
+			"fz_impersonator_round_trip_seconds", "Time elapsed between sending a request to the impersonator and receiving its response.",
+			metrics::unit::microseconds
+		))
 		, channel_(loop, logger_, std::move(rw))
 	{
 		channel_.set_event_handler(this);
@@ -116,6 +121,7 @@ private:
 		receiver_handle_base receiver_handle_;
 		std::size_t expected_in_msg_id_{};
 		monotonic_clock deadline_{};
+		metrics::stopwatch sent_{};
 	};
 
 	struct reqres
@@ -127,6 +133,7 @@ private:
 	mutex mutex_;
 	logger_interface &logger_;
 	duration timeout_;
+	metrics::histogram &round_trip_metric_;
 	timer_id timer_id_{};
 
 	std::deque<reqres> send_queue_;
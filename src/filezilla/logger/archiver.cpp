@@ -0,0 +1,641 @@
+#include <algorithm>
+#include <limits>
+
+#include <zlib.h>
+
+#include <libfilezilla/buffer.hpp>
+#include <libfilezilla/file.hpp>
+#include <libfilezilla/local_filesys.hpp>
+
+#include "../logger/archiver.hpp"
+
+#include "../util/io.hpp"
+#include "../util/scope_guard.hpp"
+
+namespace fz::logger {
+
+namespace {
+
+constexpr std::string_view index_magic = "FZLOGIX1";
+
+// The index is made of LEB128 varints, the offsets, times and session ids being stored as deltas from the previous ones.
+void put_varint(buffer &b, std::uint64_t v)
+{
+	while (v >= 0x80) {
+		b.append(std::uint8_t(v | 0x80));
+		v >>= 7;
+	}
+
+	b.append(std::uint8_t(v));
+}
+
+void put_signed_varint(buffer &b, std::int64_t v)
+{
+	put_varint(b, (std::uint64_t(v) << 1) ^ std::uint64_t(v >> 63));
+}
+
+bool get_varint(const unsigned char *&p, const unsigned char *end, std::uint64_t &v)
+{
+	v = 0;
+
+	for (unsigned shift = 0; p != end && shift < 64; shift += 7) {
+		auto c = *p++;
+		v |= std::uint64_t(c & 0x7f) << shift;
+
+		if (!(c & 0x80))
+			return true;
+	}
+
+	return false;
+}
+
+bool get_signed_varint(const unsigned char *&p, const unsigned char *end, std::int64_t &v)
+{
+	std::uint64_t u;
+	if (!get_varint(p, end, u))
+		return false;
+
+	v = std::int64_t(u >> 1) ^ -std::int64_t(u & 1);
+	return true;
+}
+
+std::int64_t ms_since_epoch(const datetime &dt)
+{
+	static const datetime epoch(0, datetime::milliseconds);
+
+	return (dt - epoch).get_milliseconds();
+}
+
+bool parse_digits(std::string_view s, std::size_t pos, std::size_t count, int &v)
+{
+	v = 0;
+
+	for (auto end = pos + count; pos < end; ++pos) {
+		if (s[pos] < '0' || s[pos] > '9')
+			return false;
+
+		v = v*10 + (s[pos] - '0');
+	}
+
+	return true;
+}
+
+// Delivers the lines of data that match the filter, returns false if the handler asked to stop.
+bool filter_lines(std::string_view data, const archiver::filter &f, std::int64_t from_ms, std::int64_t to_ms, const archiver::line_handler &on_line)
+{
+	while (!data.empty()) {
+		auto eol = data.find('\n');
+		auto line = data.substr(0, eol);
+		data.remove_prefix(eol == std::string_view::npos ? data.size() : eol + 1);
+
+		std::int64_t ms;
+		std::uint64_t session_id;
+		archiver::parse_line(line, ms, session_id);
+
+		if (f.session_id && session_id != f.session_id)
+			continue;
+
+		// Lines whose time is unknown can't be excluded.
+		if (ms && (ms < from_ms || ms > to_ms))
+			continue;
+
+		if (!on_line(line))
+			return false;
+	}
+
+	return true;
+}
+
+}
+
+archiver::archiver(logger_interface &logger)
+	: logger_(logger)
+{
+}
+
+archiver::~archiver()
+{
+	quit_ = true;
+	task_.join();
+}
+
+void archiver::compress(native_string name)
+{
+	scoped_lock lock(mutex_);
+
+	queue_.push_back(std::move(name));
+
+	if (!running_) {
+		// The previous task, if any, is done by now: it only needs to return.
+		task_.join();
+
+		running_ = true;
+		task_ = pool_.spawn([this] { run(); });
+	}
+}
+
+void archiver::run()
+{
+	for (;;) {
+		native_string name;
+
+		{
+			scoped_lock lock(mutex_);
+
+			if (queue_.empty() || quit_) {
+				running_ = false;
+				return;
+			}
+
+			name = std::move(queue_.front());
+			queue_.pop_front();
+		}
+
+		// It might have been queued again, or removed by the rotation.
+		if (local_filesys::get_file_type(name) != local_filesys::file)
+			continue;
+
+		if (!compress_file(name, default_block_size, quit_)) {
+			if (!quit_)
+				logger_.log_u(logmsg::error, L"Could not compress the rotated log file %s.", name);
+
+			continue;
+		}
+
+		// The file could have been removed by the rotation in the meanwhile, in which case its compressed version must go too.
+		if (local_filesys::get_file_type(name) == local_filesys::unknown) {
+			fz::remove_file(compressed_name(name), false);
+			fz::remove_file(index_name(name), false);
+			continue;
+		}
+
+		fz::remove_file(name, false);
+		logger_.log_u(logmsg::debug_info, L"Compressed the rotated log file %s.", name);
+	}
+}
+
+native_string archiver::compressed_name(native_string_view name)
+{
+	return native_string(name).append(fzT(".gz"));
+}
+
+native_string archiver::index_name(native_string_view name)
+{
+	return native_string(name).append(fzT(".gz.idx"));
+}
+
+bool archiver::compress_file(const native_string &name, std::size_t block_size)
+{
+	static const std::atomic<bool> never_stop{false};
+
+	return compress_file(name, block_size, never_stop);
+}
+
+bool archiver::compress_file(const native_string &name, std::size_t block_size, const std::atomic<bool> &stop)
+{
+	fz::file in(name, fz::file::reading, fz::file::existing);
+	if (!in.opened())
+		return false;
+
+	auto out_name = compressed_name(name);
+	fz::file out(out_name, fz::file::writing, fz::file::empty | fz::file::current_user_and_admins_only);
+	if (!out.opened())
+		return false;
+
+	bool success = false;
+
+	FZ_SCOPE_GUARD {
+		if (!success) {
+			out.close();
+			fz::remove_file(out_name, false);
+		}
+	};
+
+	z_stream zs{};
+	if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return false;
+
+	FZ_SCOPE_GUARD {
+		deflateEnd(&zs);
+	};
+
+	// A gzip header without name nor time: the raw deflate stream follows.
+	static constexpr unsigned char gzip_header[] = { 0x1f, 0x8b, Z_DEFLATED, 0, 0, 0, 0, 0, 0, 0xff };
+
+	if (!util::io::write(out, gzip_header, sizeof(gzip_header)))
+		return false;
+
+	std::uint64_t out_offset = sizeof(gzip_header);
+	unsigned char out_chunk[64*1024];
+
+	auto deflate_into_file = [&](const unsigned char *data, std::size_t size, int flush) {
+		zs.next_in = const_cast<unsigned char *>(data);
+		zs.avail_in = uInt(size);
+
+		do {
+			zs.next_out = out_chunk;
+			zs.avail_out = sizeof(out_chunk);
+
+			auto res = deflate(&zs, flush);
+			if (res != Z_OK && res != Z_STREAM_END && res != Z_BUF_ERROR)
+				return false;
+
+			auto produced = sizeof(out_chunk) - zs.avail_out;
+			if (!util::io::write(out, out_chunk, produced))
+				return false;
+
+			out_offset += produced;
+		} while (zs.avail_out == 0);
+
+		return true;
+	};
+
+	index idx;
+	uLong crc = crc32(0, Z_NULL, 0);
+	std::uint32_t in_size = 0;
+
+	buffer pending;
+	std::size_t wanted = block_size;
+	bool eof = false;
+
+	while (!eof || !pending.empty()) {
+		if (stop)
+			return false;
+
+		while (!eof && pending.size() < wanted) {
+			auto read = in.read(pending.get(block_size), std::int64_t(block_size));
+			if (read < 0)
+				return false;
+
+			if (read == 0)
+				eof = true;
+			else
+				pending.add(std::size_t(read));
+		}
+
+		// Blocks are made of whole lines: a line longer than a block makes for a bigger block.
+		auto data = std::string_view(reinterpret_cast<const char *>(pending.get()), pending.size());
+		auto size = data.size();
+
+		if (!eof || size > block_size) {
+			auto eol = data.rfind('\n', block_size - 1);
+			if (eol == std::string_view::npos)
+				eol = data.find('\n', block_size);
+
+			if (eol != std::string_view::npos)
+				size = eol + 1;
+			else
+			if (!eof) {
+				wanted = data.size() + block_size;
+				continue;
+			}
+		}
+
+		wanted = block_size;
+		data = data.substr(0, size);
+
+		auto &b = idx.blocks.emplace_back();
+		b.offset = out_offset;
+
+		std::int64_t last_ms = idx.blocks.size() > 1 ? idx.blocks[idx.blocks.size()-2].last_ms : 0;
+
+		for (auto rest = data; !rest.empty();) {
+			auto eol = rest.find('\n');
+			auto line = rest.substr(0, eol);
+			rest.remove_prefix(eol == std::string_view::npos ? rest.size() : eol + 1);
+
+			std::int64_t ms;
+			std::uint64_t session_id;
+			parse_line(line, ms, session_id);
+
+			if (ms) {
+				if (!b.first_ms)
+					b.first_ms = ms;
+
+				last_ms = ms;
+			}
+
+			if (session_id)
+				b.sessions.push_back(session_id);
+		}
+
+		if (b.first_ms)
+			b.last_ms = last_ms;
+
+		std::sort(b.sessions.begin(), b.sessions.end());
+		b.sessions.erase(std::unique(b.sessions.begin(), b.sessions.end()), b.sessions.end());
+
+		// The full flush resets the compressor state, so that inflating can start from the beginning of any block.
+		auto bytes = reinterpret_cast<const unsigned char *>(data.data());
+		if (!deflate_into_file(bytes, data.size(), Z_FULL_FLUSH))
+			return false;
+
+		crc = crc32(crc, bytes, uInt(data.size()));
+		in_size += std::uint32_t(data.size());
+
+		pending.consume(size);
+	}
+
+	idx.end = out_offset;
+
+	if (!deflate_into_file(nullptr, 0, Z_FINISH))
+		return false;
+
+	unsigned char gzip_trailer[8];
+	for (int i = 0; i < 4; ++i) {
+		gzip_trailer[i] = (crc >> (8*i)) & 0xff;
+		gzip_trailer[4+i] = (in_size >> (8*i)) & 0xff;
+	}
+
+	if (!util::io::write(out, gzip_trailer, sizeof(gzip_trailer)) || !out.fsync())
+		return false;
+
+	// The index is written last: its presence tells the compressed file is complete.
+	buffer idx_buf;
+	idx_buf.append(index_magic);
+	put_varint(idx_buf, idx.blocks.size());
+
+	const block *prev = nullptr;
+
+	for (auto &b: idx.blocks) {
+		put_varint(idx_buf, b.offset - (prev ? prev->offset : 0));
+		put_signed_varint(idx_buf, b.first_ms - (prev ? prev->first_ms : 0));
+		put_signed_varint(idx_buf, b.last_ms - b.first_ms);
+		put_varint(idx_buf, b.sessions.size());
+
+		std::uint64_t prev_session = 0;
+		for (auto s: b.sessions) {
+			put_varint(idx_buf, s - prev_session);
+			prev_session = s;
+		}
+
+		prev = &b;
+	}
+
+	put_varint(idx_buf, idx.end - (prev ? prev->offset : 0));
+
+	if (!util::io::write(index_name(name), idx_buf)) {
+		fz::remove_file(index_name(name), false);
+		return false;
+	}
+
+	success = true;
+	return true;
+}
+
+bool archiver::load_index(const native_string &name, index &idx)
+{
+	fz::file f(index_name(name), fz::file::reading, fz::file::existing);
+	if (!f.opened())
+		return false;
+
+	buffer b;
+	if (!util::io::read(f, b))
+		return false;
+
+	if (b.size() < index_magic.size() || std::string_view(reinterpret_cast<const char *>(b.get()), index_magic.size()) != index_magic)
+		return false;
+
+	const unsigned char *p = b.get() + index_magic.size();
+	const unsigned char *end = b.get() + b.size();
+
+	std::uint64_t count;
+	if (!get_varint(p, end, count) || count > b.size())
+		return false;
+
+	idx.blocks.clear();
+	idx.blocks.reserve(count);
+
+	const block *prev = nullptr;
+
+	for (std::uint64_t i = 0; i < count; ++i) {
+		block bl;
+		std::uint64_t offset_delta, sessions_count;
+		std::int64_t first_delta, span;
+
+		if (!get_varint(p, end, offset_delta) || !get_signed_varint(p, end, first_delta) || !get_signed_varint(p, end, span) || !get_varint(p, end, sessions_count))
+			return false;
+
+		if (sessions_count > std::uint64_t(end - p))
+			return false;
+
+		bl.offset = (prev ? prev->offset : 0) + offset_delta;
+		bl.first_ms = (prev ? prev->first_ms : 0) + first_delta;
+		bl.last_ms = bl.first_ms + span;
+
+		bl.sessions.reserve(sessions_count);
+
+		std::uint64_t session = 0;
+		for (std::uint64_t s = 0; s < sessions_count; ++s) {
+			std::uint64_t delta;
+			if (!get_varint(p, end, delta))
+				return false;
+
+			session += delta;
+			bl.sessions.push_back(session);
+		}
+
+		prev = &idx.blocks.emplace_back(std::move(bl));
+	}
+
+	std::uint64_t end_delta;
+	if (!get_varint(p, end, end_delta))
+		return false;
+
+	idx.end = (prev ? prev->offset : 0) + end_delta;
+
+	return true;
+}
+
+bool archiver::read(const native_string &name, const filter &f, const line_handler &on_line)
+{
+	index idx;
+	if (!load_index(name, idx))
+		return false;
+
+	fz::file in(compressed_name(name), fz::file::reading, fz::file::existing);
+	if (!in.opened())
+		return false;
+
+	auto from_ms = f.from.empty() ? std::numeric_limits<std::int64_t>::min() : ms_since_epoch(f.from);
+	auto to_ms = f.to.empty() ? std::numeric_limits<std::int64_t>::max() : ms_since_epoch(f.to);
+
+	buffer compressed;
+	buffer inflated;
+
+	for (std::size_t i = 0; i < idx.blocks.size(); ++i) {
+		auto &b = idx.blocks[i];
+
+		if (f.session_id && !std::binary_search(b.sessions.begin(), b.sessions.end(), f.session_id))
+			continue;
+
+		if (b.first_ms && (b.last_ms < from_ms || b.first_ms > to_ms))
+			continue;
+
+		auto end = i+1 < idx.blocks.size() ? idx.blocks[i+1].offset : idx.end;
+		if (end < b.offset)
+			return false;
+
+		auto size = std::size_t(end - b.offset);
+
+		compressed.clear();
+		if (in.seek(std::int64_t(b.offset), fz::file::seek_mode::begin) != std::int64_t(b.offset))
+			return false;
+
+		std::size_t effective_read = 0;
+		if (!util::io::read(in, compressed.get(size), size, nullptr, &effective_read) || effective_read != size)
+			return false;
+
+		compressed.add(size);
+
+		z_stream zs{};
+		if (inflateInit2(&zs, -MAX_WBITS) != Z_OK)
+			return false;
+
+		FZ_SCOPE_GUARD {
+			inflateEnd(&zs);
+		};
+
+		zs.next_in = compressed.get();
+		zs.avail_in = uInt(compressed.size());
+
+		inflated.clear();
+
+		do {
+			static constexpr std::size_t chunk_size = 64*1024;
+
+			zs.next_out = inflated.get(chunk_size);
+			zs.avail_out = chunk_size;
+
+			auto res = inflate(&zs, Z_NO_FLUSH);
+			if (res != Z_OK && res != Z_STREAM_END && res != Z_BUF_ERROR)
+				return false;
+
+			inflated.add(chunk_size - zs.avail_out);
+
+			if (res != Z_OK)
+				break;
+		} while (zs.avail_in > 0 || zs.avail_out == 0);
+
+		if (!filter_lines(std::string_view(reinterpret_cast<const char *>(inflated.get()), inflated.size()), f, from_ms, to_ms, on_line))
+			break;
+	}
+
+	return true;
+}
+
+bool archiver::scan(const native_string &name, const filter &f, const line_handler &on_line)
+{
+	fz::file in(name, fz::file::reading, fz::file::existing);
+	if (!in.opened())
+		return false;
+
+	auto from_ms = f.from.empty() ? std::numeric_limits<std::int64_t>::min() : ms_since_epoch(f.from);
+	auto to_ms = f.to.empty() ? std::numeric_limits<std::int64_t>::max() : ms_since_epoch(f.to);
+
+	static constexpr std::size_t chunk_size = 256*1024;
+
+	buffer pending;
+
+	for (;;) {
+		auto read = in.read(pending.get(chunk_size), std::int64_t(chunk_size));
+		if (read < 0)
+			return false;
+
+		if (read == 0)
+			break;
+
+		pending.add(std::size_t(read));
+
+		// Only whole lines, the rest is left for the next round.
+		auto data = std::string_view(reinterpret_cast<const char *>(pending.get()), pending.size());
+		auto eol = data.rfind('\n');
+
+		if (eol == std::string_view::npos)
+			continue;
+
+		if (!filter_lines(data.substr(0, eol + 1), f, from_ms, to_ms, on_line))
+			return true;
+
+		pending.consume(eol + 1);
+	}
+
+	filter_lines(std::string_view(reinterpret_cast<const char *>(pending.get()), pending.size()), f, from_ms, to_ms, on_line);
+
+	return true;
+}
+
+bool archiver::search(const native_string &name, const filter &f, const line_handler &on_line)
+{
+	if (local_filesys::get_file_type(index_name(name)) == local_filesys::file)
+		return read(name, f, on_line);
+
+	if (scan(name, f, on_line))
+		return true;
+
+	// It might have just been compressed.
+	return read(name, f, on_line);
+}
+
+void archiver::parse_line(std::string_view line, std::int64_t &ms, std::uint64_t &session_id)
+{
+	ms = 0;
+	session_id = 0;
+
+	// Debug builds prefix the lines with the id of the thread.
+	if (!line.empty() && line[0] == '{') {
+		if (auto end = line.find("} "); end != std::string_view::npos)
+			line.remove_prefix(end + 2);
+	}
+
+	// 2024-01-31T12:34:56.789Z
+	if (line.size() > 24 && line[4] == '-' && line[7] == '-' && line[10] == 'T' && line[13] == ':' && line[16] == ':' && line[19] == '.' && line[23] == 'Z' && line[24] == ' ') {
+		int year, month, day, hour, minute, second, millisecond;
+
+		bool valid =
+			parse_digits(line, 0, 4, year) && parse_digits(line, 5, 2, month) && parse_digits(line, 8, 2, day) &&
+			parse_digits(line, 11, 2, hour) && parse_digits(line, 14, 2, minute) && parse_digits(line, 17, 2, second) &&
+			parse_digits(line, 20, 3, millisecond);
+
+		if (valid) {
+			datetime dt(datetime::utc, year, month, day, hour, minute, second, millisecond);
+
+			if (!dt.empty())
+				ms = ms_since_epoch(dt);
+		}
+
+		line.remove_prefix(25);
+	}
+
+	// The type tag is followed by the prefix of the modularized loggers, if any: [FTP Session 12 10.0.0.1 user]
+	auto tag_end = line.find(' ');
+	if (tag_end == std::string_view::npos)
+		return;
+
+	if (tag_end + 1 >= line.size() || line[tag_end + 1] != '[') {
+		// The long type tags can be made of more than one word, but they all end with a colon.
+		tag_end = line.find(": ");
+		if (tag_end == std::string_view::npos || ++tag_end + 1 >= line.size() || line[tag_end + 1] != '[')
+			return;
+	}
+
+	auto prefix = line.substr(tag_end + 2);
+	prefix = prefix.substr(0, prefix.find(']'));
+
+	static constexpr std::string_view session_tag = "Session ";
+
+	auto pos = prefix.find(session_tag);
+	if (pos == std::string_view::npos)
+		return;
+
+	pos += session_tag.size();
+
+	std::uint64_t id = 0;
+	for (; pos < prefix.size() && prefix[pos] >= '0' && prefix[pos] <= '9'; ++pos)
+		id = id*10 + std::uint64_t(prefix[pos] - '0');
+
+	if (pos == prefix.size() || prefix[pos] == ' ')
+		session_id = id;
+}
+
+}
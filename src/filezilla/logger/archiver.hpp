@@ -0,0 +1,99 @@
+#ifndef FZ_LOGGER_ARCHIVER_HPP
+#define FZ_LOGGER_ARCHIVER_HPP
+
+#include <atomic>
+#include <deque>
+#include <functional>
+
+#include <libfilezilla/logger.hpp>
+#include <libfilezilla/mutex.hpp>
+#include <libfilezilla/thread_pool.hpp>
+#include <libfilezilla/time.hpp>
+
+namespace fz::logger {
+
+/// \brief Compresses the rotated log files in the background, indexing them so that the lines of a session
+/// within a time frame can later be retrieved without inflating the whole file.
+///
+/// A compressed file is a regular gzip file, whose deflate stream is made of blocks of whole lines, each of which can be inflated on its own.
+/// Its index, stored beside it, records for each block where it starts in the compressed file, the time span of its lines
+/// and the ids of the sessions that logged them.
+class archiver
+{
+public:
+	struct block
+	{
+		std::uint64_t offset{};                ///< Where the block starts in the compressed file.
+		std::int64_t first_ms{};               ///< Milliseconds since the epoch of the first line of the block, 0 if unknown.
+		std::int64_t last_ms{};                ///< Milliseconds since the epoch of the last line of the block, 0 if unknown.
+		std::vector<std::uint64_t> sessions{}; ///< Sorted.
+	};
+
+	struct index
+	{
+		std::vector<block> blocks{};
+		std::uint64_t end{}; ///< Where the last block ends in the compressed file.
+	};
+
+	/// Which lines read(), scan() and search() deliver.
+	struct filter
+	{
+		std::uint64_t session_id{}; ///< 0 means any session.
+		datetime from{};            ///< Empty means unbounded.
+		datetime to{};              ///< Empty means unbounded.
+	};
+
+	using line_handler = std::function<bool(std::string_view line)>;
+
+	static constexpr std::size_t default_block_size = 64*1024;
+
+	explicit archiver(logger_interface &logger);
+
+	/// Stops compressing as soon as possible. The files not compressed yet are left as they are.
+	~archiver();
+
+	/// Queues \p name to be compressed on a thread of the archiver's own pool, one file at a time. Once done, \p name is removed.
+	void compress(native_string name);
+
+	static native_string compressed_name(native_string_view name);
+	static native_string index_name(native_string_view name);
+
+	/// Compresses \p name into compressed_name(name) and writes its index into index_name(name). \p name is left untouched.
+	static bool compress_file(const native_string &name, std::size_t block_size = default_block_size);
+
+	/// Loads the index of the compressed version of \p name.
+	static bool load_index(const native_string &name, index &idx);
+
+	/// Invokes \p on_line for each of the lines of the compressed version of \p name that match \p f, only inflating the blocks that can hold them.
+	/// Stops as soon as \p on_line returns false.
+	/// \returns false if the compressed file or its index couldn't be read.
+	static bool read(const native_string &name, const filter &f, const line_handler &on_line);
+
+	/// Same as read(), for the uncompressed file \p name, which is scanned in full.
+	static bool scan(const native_string &name, const filter &f, const line_handler &on_line);
+
+	/// Reads the compressed version of \p name if it's complete, scans \p name otherwise.
+	static bool search(const native_string &name, const filter &f, const line_handler &on_line);
+
+	/// Extracts the time and the session id from a line formatted by logger::stdio. Either is 0 if not found.
+	static void parse_line(std::string_view line, std::int64_t &ms, std::uint64_t &session_id);
+
+private:
+	static bool compress_file(const native_string &name, std::size_t block_size, const std::atomic<bool> &stop);
+
+	void run();
+
+	logger_interface &logger_;
+
+	fz::thread_pool pool_;
+	fz::async_task task_;
+
+	fz::mutex mutex_;
+	std::deque<native_string> queue_;
+	bool running_{};
+	std::atomic<bool> quit_{};
+};
+
+}
+
+#endif // FZ_LOGGER_ARCHIVER_HPP
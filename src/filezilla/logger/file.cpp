@@ -1,58 +1,278 @@
+#include <thread>
+#include <tuple>
+
 #include <libfilezilla/format.hpp>
+#include <libfilezilla/thread.hpp>
 
 #include "../logger/file.hpp"
+#include "../logger/archiver.hpp"
 
 #include "../util/filesystem.hpp"
 #include "../util/parser.hpp"
+#include "../util/mpsc_ring.hpp"
 #include "../build_info.hpp"
 
 namespace fz::logger {
 
+class file::async_writer
+{
+public:
+	struct record
+	{
+		datetime when{};
+		std::string data{};
+	};
+
+	async_writer(file &owner, std::size_t queue_size, enum overflow_policy policy)
+		: owner_(owner)
+		, policy_(policy)
+		, ring_(queue_size)
+		, reported_dropped_(owner.dropped_.load(std::memory_order_relaxed))
+	{
+		thread_.run([this] { run(); });
+	}
+
+	/// Writes out whatever has been queued so far, then returns.
+	~async_writer()
+	{
+		{
+			scoped_lock lock(mutex_);
+			quit_ = true;
+			wakeup_.signal(lock);
+		}
+
+		thread_.join();
+	}
+
+	void push(logmsg::type t, record &&r)
+	{
+		while (!ring_.try_push(std::move(r))) {
+			static constexpr auto debug_types = logmsg::debug_warning | logmsg::debug_info | logmsg::debug_verbose | logmsg::debug_debug;
+
+			if (policy_ == overflow_policy::drop || (policy_ == overflow_policy::drop_debug && (t & debug_types))) {
+				owner_.dropped_.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+
+			wake_up();
+			std::this_thread::yield();
+		}
+
+		// Pairs with the fence in run(): either the writer sees the record, or we see it's going to sleep.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (sleeping_.load(std::memory_order_relaxed))
+			wake_up();
+	}
+
+private:
+	// Batches are flushed when they get this big, or when there's nothing more in the queue.
+	static constexpr std::size_t max_batch_size = 256*1024;
+
+	void wake_up()
+	{
+		scoped_lock lock(mutex_);
+		wakeup_.signal(lock);
+	}
+
+	void run()
+	{
+		fz::buffer batch;
+		record r;
+
+		for (;;) {
+			datetime last;
+
+			while (batch.size() < max_batch_size && ring_.try_pop(r)) {
+				batch.append(r.data);
+				last = r.when;
+			}
+
+			if (auto dropped = owner_.dropped_.load(std::memory_order_relaxed); dropped != reported_dropped_) {
+				fz::buffer notice;
+				last = stdio::format_message(notice, logmsg::warning, fz::sprintf(L"%d log messages were dropped because the logging queue was full.", dropped - reported_dropped_));
+				batch.append(notice.get(), notice.size());
+				reported_dropped_ = dropped;
+			}
+
+			if (!batch.empty()) {
+				auto lock = owner_.buffer_.lock();
+				owner_.write(batch, last);
+				batch.clear();
+
+				continue;
+			}
+
+			scoped_lock lock(mutex_);
+
+			if (quit_ && ring_.empty())
+				return;
+
+			sleeping_.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			if (ring_.empty() && !quit_)
+				wakeup_.wait(lock);
+
+			sleeping_.store(false, std::memory_order_relaxed);
+		}
+	}
+
+	file &owner_;
+	enum overflow_policy policy_;
+
+	util::mpsc_ring<record> ring_;
+	std::uint64_t reported_dropped_{};
+
+	fz::mutex mutex_{false};
+	fz::condition wakeup_;
+	std::atomic<bool> sleeping_{};
+	bool quit_{};
+
+	fz::thread thread_;
+};
+
 file::file(file::options opts)
 	: stdio(stderr)
 {
 	set_options(std::move(opts));
 }
 
+file::~file()
+{
+	set_async(0, {});
+
+	// Not under the lock: the archiver logs through this very logger.
+	archiver_.reset();
+}
+
 void file::set_options(const file::options &opts)
 {
 	bool emit_start_line = opts.start_line() && opts.name() != opts_.name();
+	bool async_changed = opts.async_queue_size() != opts_.async_queue_size() || opts.overflow_policy() != opts_.overflow_policy();
+
 	set_all(opts.enabled_types());
 
 	{
 		auto lock = buffer_.lock();
 		opts_ = opts;
 
+		if (opts_.compress_rotated() && !archiver_)
+			archiver_ = std::make_unique<archiver>(*this);
+
+		// The naming might have changed, and there might be rotated files left to compress.
+		rotated_.clear();
+		rotated_found_ = false;
+
+		if (opts_.max_amount_of_rotated_files() > 0)
+			find_rotated_files();
+
+		include_headers_ = opts_.include_headers();
+		short_type_tag_ = opts_.short_type_tag();
+		remove_cntrl_ = opts_.remove_cntrl();
+		split_lines_ = opts_.split_lines();
+
 		open(fz::file::creation_flags::existing);
 	}
 
+	// Outside of the lock, since the writer needs it to write out what's still queued.
+	if (async_changed)
+		set_async(opts.async_queue_size(), opts.overflow_policy());
+
 	if (emit_start_line)
 		log_u(logmsg::status, L"===== %s %s new logging started =====", fz::build_info::package_name, fz::build_info::version);
 }
 
+std::uint64_t file::dropped() const
+{
+	return dropped_.load(std::memory_order_relaxed);
+}
+
+std::vector<native_string> file::log_files()
+{
+	auto lock = buffer_.lock();
+
+	std::vector<native_string> files;
+
+	if (opts_.name().empty())
+		return files;
+
+	if (opts_.max_amount_of_rotated_files() > 0) {
+		find_rotated_files();
+		files.assign(rotated_.begin(), rotated_.end());
+	}
+
+	files.push_back(opts_.name());
+
+	return files;
+}
+
+void file::set_async(std::size_t queue_size, enum overflow_policy policy)
+{
+	auto old = async_.exchange(queue_size > 0 ? new async_writer(*this, queue_size, policy) : nullptr);
+	auto epoch = epoch_.fetch_add(1) & 1;
+
+	if (old) {
+		// Wait for those that are still queueing into the old writer: they all counted themselves in the old epoch.
+		while (producers_[epoch].load() != 0)
+			std::this_thread::yield();
+
+		delete old;
+	}
+}
+
 void file::do_log(logmsg::type t, std::wstring &&msg)
 {
+	// Count in the current epoch. Should it change meanwhile, the writer being replaced might not wait for us: try again.
+	auto epoch = epoch_.load();
+	while (producers_[epoch & 1].fetch_add(1), epoch_.load() != epoch) {
+		producers_[epoch & 1].fetch_sub(1);
+		epoch = epoch_.load();
+	}
+
+	auto &producers = producers_[epoch & 1];
+
+	if (auto async = async_.load()) {
+		thread_local fz::buffer buffer;
+
+		async_writer::record r;
+		r.when = format_message(buffer, t, std::move(msg), include_headers_, short_type_tag_, remove_cntrl_, split_lines_);
+		r.data.assign(reinterpret_cast<const char *>(buffer.get()), buffer.size());
+
+		async->push(t, std::move(r));
+		producers.fetch_sub(1);
+
+		return;
+	}
+
+	producers.fetch_sub(1);
+
 	auto buffer = buffer_.lock();
 
 	auto now = format_message(*buffer, t, std::move(msg), opts_.include_headers(), opts_.short_type_tag(), opts_.remove_cntrl(), opts_.split_lines());
+	write(*buffer, now);
+}
+
+void file::write(fz::buffer &buf, const datetime &now)
+{
 	if (!file_.opened()) {
-		stdio::log_formatted_message(*buffer);
+		stdio::log_formatted_message(buf);
 		return;
 	}
 
 	maybe_rotate(now);
 
-	while (buffer->size()) {
-		auto to_consume = file_.write(buffer->get(), (int64_t)buffer->size());
+	while (buf.size()) {
+		auto to_consume = file_.write(buf.get(), (int64_t)buf.size());
 
 		if (to_consume < 0) {
-			stdio::log_formatted_message(*buffer);
+			stdio::log_formatted_message(buf);
 			break;
 		}
 
 		file_size_ += to_consume;
 
-		buffer->consume((std::size_t)to_consume);
+		buf.consume((std::size_t)to_consume);
 	}
 }
 
@@ -97,120 +317,165 @@ void file::maybe_rotate(const datetime &now)
 	file_.close();
 	file_size_ = 0;
 
-	if (native_string_view name = opts_.name(); !name.empty()) {
-		std::vector<std::pair<native_string /* date */, std::size_t /* index */>> suffixes;
+	if (!opts_.name().empty()) {
+		find_rotated_files();
 
-		native_string_view suffix;
+		native_string date_suffix;
+		if (opts_.date_in_name())
+			date_suffix = fzT(".") + file_dt_.format(fzT("%Y-%m-%d"), datetime::utc);
 
-		if (auto dotpos = name.rfind(fzT(".")); dotpos != native_string_view::npos) {
-			suffix = name.substr(dotpos);
-			name.remove_suffix(suffix.size());
-		}
+		// Indices only ever grow, so that no other file needs to be renamed.
+		auto name = rotated_name(date_suffix, next_index_++);
 
-		auto parse_date_suffix = [this](auto &&r, native_string_view &date) {
-			if (!opts_.date_in_name()) {
-				date = {};
-				return true;
-			}
+		if (fz::rename_file(opts_.name(), name)) {
+			rotated_.push_back(name);
 
-			std::uint16_t year;
-			std::uint8_t month;
-			std::uint8_t day;
+			if (archiver_ && opts_.compress_rotated())
+				archiver_->compress(std::move(name));
+		}
 
-			static constexpr std::uint8_t days_in_month[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+		// Remove the excess files
+		while (rotated_.size() > opts_.max_amount_of_rotated_files()) {
+			auto &oldest = rotated_.front();
 
-			auto begin = r.it;
+			fz::remove_file(oldest, false);
+			fz::remove_file(archiver::compressed_name(oldest), false);
+			fz::remove_file(archiver::index_name(oldest), false);
 
-			bool matched = lit(r, '.') &&
-				parse_int(r, 4, year) && lit(r, '-') &&
-				parse_int(r, 2, month) && month >= 1 && month <= 12 && lit(r, '-') &&
-				parse_int(r, 2, day) && day >= 1 && (day <= ((month == 2 && year % 4 == 0) ? 29 : days_in_month[month - 1]));
+			rotated_.pop_front();
+		}
+	}
 
-			if (matched) {
-				date = native_string_view(&*begin, std::size_t(r.it - begin));
-				return true;
-			}
+	// Create the new file
+	open(fz::file::creation_flags::empty);
+}
 
-			return false;
-		};
+native_string file::rotated_name(native_string_view date_suffix, std::size_t index) const
+{
+	native_string_view name = opts_.name();
+	native_string_view suffix;
 
-		auto parse_index_suffix = [this](auto &&r, std::size_t &index) {
-			auto begin = r.it;
+	if (auto dotpos = name.rfind(fzT(".")); dotpos != native_string_view::npos) {
+		suffix = name.substr(dotpos);
+		name.remove_suffix(suffix.size());
+	}
 
-			if (lit(r, '.')) {
-				if (parse_int(r, index) && index > 0)
-					return true;
+	auto full_name = native_string(name).append(date_suffix);
 
-				r.it = begin;
-			}
+	if (index)
+		full_name.append(fzT(".")).append(fz::toString<fz::native_string>(index));
 
-			index = 0;
-			return opts_.date_in_name();
-		};
+	full_name.append(suffix);
 
-		auto make_name = [&name, &suffix](const native_string &date_suffix, std::size_t index_suffix)	{
-			auto full_name = native_string(name) + date_suffix;
+	return full_name;
+}
 
-			if (index_suffix)
-				full_name.append(fzT(".")).append(fz::toString<fz::native_string>(index_suffix));
+void file::find_rotated_files()
+{
+	if (rotated_found_)
+		return;
 
-			full_name.append(suffix);
+	rotated_found_ = true;
+	rotated_.clear();
+	next_index_ = 1;
 
-			return full_name;
-		};
+	native_string_view name = opts_.name();
+	if (name.empty())
+		return;
 
-		for (const auto &file: util::fs::native_path(opts_.name()).parent()) {
-			util::parseable_range r(file.str());
+	native_string_view suffix;
 
-			native_string_view date;
-			std::size_t index;
+	if (auto dotpos = name.rfind(fzT(".")); dotpos != native_string_view::npos) {
+		suffix = name.substr(dotpos);
+		name.remove_suffix(suffix.size());
+	}
 
-			if (match_string(r, name) && parse_date_suffix(r, date) && parse_index_suffix(r, index) && match_string(r, suffix) && eol(r))
-				suffixes.emplace_back(native_string(date), index);
+	auto parse_date_suffix = [this](auto &&r, native_string_view &date) {
+		if (!opts_.date_in_name()) {
+			date = {};
+			return true;
 		}
 
-		std::sort(suffixes.begin(), suffixes.end(), [](auto &s1, auto &s2) {
-			if (s1.first == s2.first) {
-				return s1.second < s2.second;
-			}
+		std::uint16_t year;
+		std::uint8_t month;
+		std::uint8_t day;
 
-			return s2.first < s1.first;
-		});
+		static constexpr std::uint8_t days_in_month[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
 
-		// Remove the excess files
-		if (suffixes.size() >= opts_.max_amount_of_rotated_files()) {
-			for (auto it = suffixes.begin() + opts_.max_amount_of_rotated_files()-1; it != suffixes.end(); ++it)
-				fz::remove_file(make_name(it->first, it->second), false);
+		auto begin = r.it;
+
+		bool matched = lit(r, '.') &&
+			parse_int(r, 4, year) && lit(r, '-') &&
+			parse_int(r, 2, month) && month >= 1 && month <= 12 && lit(r, '-') &&
+			parse_int(r, 2, day) && day >= 1 && (day <= ((month == 2 && year % 4 == 0) ? 29 : days_in_month[month - 1]));
 
-			suffixes.resize(opts_.max_amount_of_rotated_files()-1);
+		if (matched) {
+			date = native_string_view(&*begin, std::size_t(r.it - begin));
+			return true;
 		}
 
-		// Determine the new suffixes
-		native_string date_suffix;
-		std::size_t index_suffix = 1;
+		return false;
+	};
 
-		if (opts_.date_in_name()) {
-			date_suffix = fzT(".") + file_dt_.format(fzT("%Y-%m-%d"), datetime::utc);
-			if (suffixes.size() == 0 || suffixes[0].first != date_suffix)
-				index_suffix = 0;
+	auto parse_index_suffix = [this](auto &&r, std::size_t &index) {
+		auto begin = r.it;
+
+		if (lit(r, '.')) {
+			if (parse_int(r, index) && index > 0)
+				return true;
+
+			r.it = begin;
 		}
 
-		// Rename the indices
-		if (index_suffix && suffixes.size() > 0) {
-			auto rename_end = suffixes.begin();
+		index = 0;
+		return opts_.date_in_name();
+	};
+
+	struct found
+	{
+		native_string date;
+		std::size_t index;
+		bool compressed;
+	};
 
-			while (rename_end != suffixes.end() && rename_end->first == date_suffix)
-				++rename_end;
+	std::vector<found> files;
 
-			for (auto it = std::make_reverse_iterator(rename_end); it != suffixes.rend(); ++it)
-				fz::rename_file(make_name(it->first, it->second), make_name(it->first, it->second+1));
-		}
+	static constexpr native_string_view compressed_suffix = fzT(".gz");
+
+	for (const auto &file: util::fs::native_path(opts_.name()).parent()) {
+		util::parseable_range r(file.str());
+
+		native_string_view date;
+		std::size_t index;
 
-		fz::rename_file(opts_.name(), make_name(date_suffix, index_suffix));
+		if (match_string(r, name) && parse_date_suffix(r, date) && parse_index_suffix(r, index) && match_string(r, suffix)) {
+			if (eol(r))
+				files.push_back({native_string(date), index, false});
+			else
+			if (match_string(r, compressed_suffix) && eol(r))
+				files.push_back({native_string(date), index, true});
+		}
 	}
 
-	// Create the new file
-	open(fz::file::creation_flags::empty);
+	// From the oldest to the newest, but for the files named by older versions, which shifted the indices at each rotation:
+	// those are in reverse order among themselves, still all before the newer ones.
+	std::sort(files.begin(), files.end(), [](auto &f1, auto &f2) {
+		return std::tie(f1.date, f1.index, f1.compressed) < std::tie(f2.date, f2.index, f2.compressed);
+	});
+
+	for (auto &f: files) {
+		auto rotated = rotated_name(f.date, f.index);
+
+		// A file found both compressed and not is still being compressed, or its compression got interrupted.
+		if (!rotated_.empty() && rotated_.back() == rotated)
+			continue;
+
+		rotated_.push_back(rotated);
+		next_index_ = std::max(next_index_, f.index + 1);
+
+		if (!f.compressed && archiver_ && opts_.compress_rotated() && local_filesys::get_file_type(archiver::index_name(rotated)) != local_filesys::file)
+			archiver_->compress(std::move(rotated));
+	}
 }
 
 }
@@ -1,6 +1,11 @@
 #ifndef FZ_LOGGER_FILE_HPP
 #define FZ_LOGGER_FILE_HPP
 
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+
 #include <libfilezilla/logger.hpp>
 #include <libfilezilla/file.hpp>
 #include <libfilezilla/buffer.hpp>
@@ -13,6 +18,8 @@
 
 namespace fz::logger {
 
+class archiver;
+
 class file: public logger::stdio {
 public:
 	enum rotation_type {
@@ -20,6 +27,13 @@ public:
 		daily
 	};
 
+	/// What to do with a message when the asynchronous queue is full.
+	enum overflow_policy {
+		block,     ///< Wait for the writer to make room.
+		drop,      ///< Drop the message.
+		drop_debug ///< Drop the message if it's a debug one, wait otherwise.
+	};
+
 	struct options: util::options<options, logger::file> {
 		enum: std::int64_t {
 			max_possible_size = std::numeric_limits<std::int64_t>::max()
@@ -37,25 +51,72 @@ public:
 		opt<bool>               date_in_name                = o(false);
 		opt<bool>               short_type_tag              = o(true);
 
+		/// If > 0, messages are formatted by the threads that log them and queued, up to this many,
+		/// to be written in batches by a dedicated thread. If 0, they're written right away by the threads that log them.
+		opt<std::size_t>           async_queue_size         = o(0);
+		opt<enum overflow_policy>  overflow_policy          = o(overflow_policy::block);
+
+		/// If true, the rotated files are compressed in the background and indexed. See logger::archiver.
+		opt<bool>                  compress_rotated         = o(false);
+
 		options(){}
 	};
 
 	file(options opts = {});
+	~file() override;
 
 	void set_options(const options &opts);
 
+	/// \returns the number of messages dropped so far because the asynchronous queue was full.
+	std::uint64_t dropped() const;
+
+	/// \returns the names of the log files, from the oldest rotated one to the current one.
+	/// The rotated files are named as they were before being compressed, see archiver::search().
+	std::vector<native_string> log_files();
+
 protected:
 	void do_log(logmsg::type t, std::wstring &&msg) override;
 
 private:
+	class async_writer;
+
+	/// Writes out the formatted messages in \p buf, rotating the file first if needed. Must be invoked with buffer_ locked.
+	void write(fz::buffer &buf, const fz::datetime &now);
+
+	void set_async(std::size_t queue_size, enum overflow_policy policy);
 	void maybe_rotate(const fz::datetime &now);
 	void open(fz::file::creation_flags flags);
 
+	/// Lists the rotated files once, so that the rotations that follow only need to rename the current file.
+	void find_rotated_files();
+	native_string rotated_name(native_string_view date_suffix, std::size_t index) const;
+
 	options opts_;
 
+	// The producers count guards the writer, so that it's not destroyed while somebody is queueing into it.
+	// There's one count per epoch: a replaced writer only waits for those that entered before the swap,
+	// not for those that keep coming in and already see the new one.
+	std::atomic<async_writer *> async_{};
+	std::atomic<std::size_t> producers_[2]{};
+	std::atomic<unsigned int> epoch_{};
+	std::atomic<std::uint64_t> dropped_{};
+
+	// The formatting options are read without locking by the producers, in asynchronous mode.
+	std::atomic<bool> include_headers_{};
+	std::atomic<bool> short_type_tag_{};
+	std::atomic<bool> remove_cntrl_{};
+	std::atomic<bool> split_lines_{};
+
 	fz::file file_{};
 	int64_t file_size_{};
 	fz::datetime file_dt_{};
+
+	// The rotated files, from the oldest to the newest, numbered with increasing indices.
+	std::deque<native_string> rotated_{};
+	std::size_t next_index_{};
+	bool rotated_found_{};
+
+	std::unique_ptr<archiver> archiver_;
 };
 
 }
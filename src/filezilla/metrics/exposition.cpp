@@ -0,0 +1,121 @@
+#include <cstdio>
+
+#include "exposition.hpp"
+
+namespace fz::metrics {
+
+namespace {
+
+void append_escaped(std::string &out, std::string_view v, bool is_help)
+{
+	for (auto c: v) {
+		if (c == '\\')
+			out.append("\\\\");
+		else
+		if (c == '\n')
+			out.append("\\n");
+		else
+		if (c == '"' && !is_help)
+			out.append("\\\"");
+		else
+			out.push_back(c);
+	}
+}
+
+void append_labels(std::string &out, const labels &l, std::string_view le = {})
+{
+	if (l.empty() && le.empty())
+		return;
+
+	out.push_back('{');
+
+	const char *sep = "";
+
+	for (auto &[name, value]: l) {
+		out.append(sep).append(name).append("=\"");
+		append_escaped(out, value, false);
+		out.push_back('"');
+		sep = ",";
+	}
+
+	if (!le.empty())
+		out.append(sep).append("le=\"").append(le).append("\"");
+
+	out.push_back('}');
+}
+
+std::string format_value(std::uint64_t v, unit u)
+{
+	if (u == unit::microseconds) {
+		char buf[32];
+		std::snprintf(buf, sizeof(buf), "%.9g", double(v) / 1e6);
+		return buf;
+	}
+
+	return std::to_string(v);
+}
+
+}
+
+std::string to_text(const snapshot &s)
+{
+	std::string out;
+
+	for (auto &f: s) {
+		out.append("# HELP ").append(f.name).append(" ");
+		append_escaped(out, f.help, true);
+		out.append("\n# TYPE ").append(f.name).append(" ");
+
+		switch (f.type) {
+			case type::counter: out.append("counter\n"); break;
+			case type::gauge: out.append("gauge\n"); break;
+			case type::histogram: out.append("histogram\n"); break;
+		}
+
+		for (auto &sample: f.samples) {
+			if (f.type != type::histogram) {
+				out.append(f.name);
+				append_labels(out, sample.labels);
+				out.append(" ").append(std::to_string(sample.value)).append("\n");
+				continue;
+			}
+
+			constexpr std::uint64_t top_bound = std::uint64_t(1) << 63;
+
+			std::uint64_t cumulative = 0;
+			auto it = sample.buckets.begin();
+
+			// The buckets past the top bound are only accounted for by the +Inf one.
+			while (it != sample.buckets.end() && it->first <= top_bound) {
+				// The smallest power of 2 that is the bound of this bucket or of a following one.
+				std::uint64_t bound = 1;
+				while (bound < it->first)
+					bound <<= 1;
+
+				for (; it != sample.buckets.end() && it->first <= bound; ++it)
+					cumulative += it->second;
+
+				// The bounds of the buckets are exclusive, while le is inclusive: the values are integers, hence the largest one below the bound.
+				out.append(f.name).append("_bucket");
+				append_labels(out, sample.labels, format_value(bound - 1, f.unit));
+				out.append(" ").append(std::to_string(cumulative)).append("\n");
+			}
+
+			out.append(f.name).append("_bucket");
+			append_labels(out, sample.labels, "+Inf");
+			out.append(" ").append(std::to_string(sample.count)).append("\n");
+
+			out.append(f.name).append("_sum");
+			append_labels(out, sample.labels);
+			out.append(" ").append(format_value(sample.sum, f.unit)).append("\n");
+
+			out.append(f.name).append("_count");
+			append_labels(out, sample.labels);
+			out.append(" ").append(std::to_string(sample.count)).append("\n");
+		}
+	}
+
+	return out;
+}
+
+}
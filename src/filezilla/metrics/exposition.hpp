@@ -0,0 +1,17 @@
+#ifndef FZ_METRICS_EXPOSITION_HPP
+#define FZ_METRICS_EXPOSITION_HPP
+
+#include "registry.hpp"
+
+namespace fz::metrics {
+
+/// The content type of what to_text() returns.
+inline constexpr std::string_view text_content_type = "text/plain; version=0.0.4; charset=utf-8";
+
+/// \returns the snapshot in the Prometheus text exposition format, which OpenMetrics scrapers accept too.
+/// The buckets of the histograms are merged at each power of 2, which are bucket boundaries already, so that their counts stay exact.
+std::string to_text(const snapshot &s);
+
+}
+
+#endif // FZ_METRICS_EXPOSITION_HPP
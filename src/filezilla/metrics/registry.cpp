@@ -0,0 +1,173 @@
+#include <cassert>
+#include <limits>
+
+#include "registry.hpp"
+
+namespace fz::metrics {
+
+std::size_t detail::shard_index()
+{
+	static std::atomic<std::size_t> next_index{};
+	thread_local std::size_t index = next_index.fetch_add(1, std::memory_order_relaxed) % shards_count;
+
+	return index;
+}
+
+std::uint64_t quantile(const family::sample &s, double q)
+{
+	if (s.count == 0)
+		return 0;
+
+	auto rank = std::uint64_t(q * double(s.count));
+	if (rank >= s.count)
+		rank = s.count - 1;
+
+	std::uint64_t cumulative = 0;
+
+	for (auto &[bound, count]: s.buckets) {
+		cumulative += count;
+
+		if (cumulative > rank)
+			return bound;
+	}
+
+	return s.buckets.empty() ? 0 : s.buckets.back().first;
+}
+
+std::uint64_t counter::value() const
+{
+	std::uint64_t v = 0;
+
+	for (auto &s: shards_)
+		v += s.value.load(std::memory_order_relaxed);
+
+	return v;
+}
+
+std::size_t histogram::bucket_index(std::uint64_t v)
+{
+	if (v < sub_buckets_count)
+		return std::size_t(v);
+
+	unsigned msb = 63;
+	while (!(v >> msb))
+		--msb;
+
+	auto shift = msb - sub_bucket_bits;
+	auto sub_bucket = std::size_t(v >> shift) & (sub_buckets_count - 1);
+
+	return (shift + 1) * sub_buckets_count + sub_bucket;
+}
+
+std::uint64_t histogram::bucket_upper_bound(std::size_t index)
+{
+	if (index < sub_buckets_count)
+		return index + 1;
+
+	auto shift = index / sub_buckets_count - 1;
+	auto sub_bucket = index % sub_buckets_count;
+
+	// The very last bucket ends past the range.
+	if (index == buckets_count - 1)
+		return std::numeric_limits<std::uint64_t>::max();
+
+	return std::uint64_t(sub_buckets_count + sub_bucket + 1) << shift;
+}
+
+void histogram::collect(family::sample &s) const
+{
+	s.buckets.clear();
+	s.count = 0;
+
+	for (std::size_t i = 0; i < buckets_count; ++i) {
+		if (auto c = buckets_[i].load(std::memory_order_relaxed)) {
+			s.buckets.emplace_back(bucket_upper_bound(i), c);
+			s.count += c;
+		}
+	}
+
+	s.sum = sum_.value();
+}
+
+template <typename T>
+T &registry::get(std::map<labels, std::unique_ptr<T>> entry::*map, metrics::type type, metrics::unit unit, std::string_view name, std::string_view help, const labels &l)
+{
+	scoped_lock lock(mutex_);
+
+	auto it = families_.find(name);
+	if (it == families_.end()) {
+		it = families_.emplace(std::string(name), entry()).first;
+		it->second.type = type;
+		it->second.unit = unit;
+		it->second.help = help;
+	}
+
+	assert(it->second.type == type && "A family's metrics must all be of the same type");
+
+	auto &m = (it->second.*map)[l];
+	if (!m)
+		m = std::make_unique<T>();
+
+	return *m;
+}
+
+counter &registry::get_counter(std::string_view name, std::string_view help, const labels &l)
+{
+	return get(&entry::counters, type::counter, unit::none, name, help, l);
+}
+
+gauge &registry::get_gauge(std::string_view name, std::string_view help, const labels &l)
+{
+	return get(&entry::gauges, type::gauge, unit::none, name, help, l);
+}
+
+histogram &registry::get_histogram(std::string_view name, std::string_view help, metrics::unit unit, const labels &l)
+{
+	return get(&entry::histograms, type::histogram, unit, name, help, l);
+}
+
+snapshot registry::collect() const
+{
+	scoped_lock lock(mutex_);
+
+	snapshot s;
+	s.reserve(families_.size());
+
+	for (auto &[name, e]: families_) {
+		auto &f = s.emplace_back();
+		f.name = name;
+		f.help = e.help;
+		f.type = e.type;
+		f.unit = e.unit;
+
+		switch (e.type) {
+			case type::counter:
+				for (auto &[l, c]: e.counters)
+					f.samples.push_back({l, std::int64_t(c->value())});
+				break;
+
+			case type::gauge:
+				for (auto &[l, g]: e.gauges)
+					f.samples.push_back({l, g->value()});
+				break;
+
+			case type::histogram:
+				for (auto &[l, h]: e.histograms) {
+					auto &sample = f.samples.emplace_back();
+					sample.labels = l;
+					h->collect(sample);
+				}
+				break;
+		}
+	}
+
+	return s;
+}
+
+registry &registry::global()
+{
+	static registry r;
+	return r;
+}
+
+}
@@ -0,0 +1,228 @@
+#ifndef FZ_METRICS_REGISTRY_HPP
+#define FZ_METRICS_REGISTRY_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <libfilezilla/mutex.hpp>
+#include <libfilezilla/time.hpp>
+
+#include "../serialization/helpers.hpp"
+
+namespace fz::metrics {
+
+using labels = std::vector<std::pair<std::string, std::string>>;
+
+enum class type: std::uint8_t {
+	counter,
+	gauge,
+	histogram
+};
+
+enum class unit: std::uint8_t {
+	none,
+	microseconds ///< Exposed in seconds.
+};
+
+/// The values of all the metrics of a family, as collected by registry::collect().
+struct family
+{
+	struct sample
+	{
+		metrics::labels labels{};
+
+		/// For counters and gauges.
+		std::int64_t value{};
+
+		/// For histograms: the exclusive upper bound and the count of each non empty bucket, in increasing order, plus the overall count and sum.
+		std::vector<std::pair<std::uint64_t, std::uint64_t>> buckets{};
+		std::uint64_t count{};
+		std::uint64_t sum{};
+
+		template <typename Archive>
+		void serialize(Archive &ar)
+		{
+			ar(FZ_NVP(labels), FZ_NVP(value), FZ_NVP(buckets), FZ_NVP(count), FZ_NVP(sum));
+		}
+	};
+
+	std::string name{};
+	std::string help{};
+	metrics::type type{};
+	metrics::unit unit{};
+	std::vector<sample> samples{};
+
+	template <typename Archive>
+	void serialize(Archive &ar)
+	{
+		ar(FZ_NVP(name), FZ_NVP(help), FZ_NVP(type), FZ_NVP(unit), FZ_NVP(samples));
+	}
+};
+
+using snapshot = std::vector<family>;
+
+/// \returns the exclusive upper bound of the bucket holding the \p q quantile of the values recorded by the histogram \p s, 0 if no values were recorded.
+std::uint64_t quantile(const family::sample &s, double q);
+
+/// \brief Measures the time elapsed since its construction.
+///
+/// The difference of two monotonic_clock only has a resolution of milliseconds, which is too coarse for most of what the histograms measure.
+class stopwatch
+{
+public:
+	stopwatch() noexcept
+		: start_(clock::now())
+	{}
+
+	std::uint64_t elapsed_us() const noexcept
+	{
+		return std::uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start_).count());
+	}
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	clock::time_point start_;
+};
+
+namespace detail {
+
+	/// Spreads the updating threads among shards, so that they seldom contend on the same cache line.
+	inline constexpr std::size_t shards_count = 16;
+	std::size_t shard_index();
+
+	struct alignas(64) shard
+	{
+		std::atomic<std::uint64_t> value{};
+	};
+
+}
+
+/// A monotonically increasing count. Adding to it is wait-free and only touches the calling thread's shard.
+class counter
+{
+public:
+	void add(std::uint64_t v = 1)
+	{
+		shards_[detail::shard_index()].value.fetch_add(v, std::memory_order_relaxed);
+	}
+
+	std::uint64_t value() const;
+
+private:
+	std::array<detail::shard, detail::shards_count> shards_{};
+};
+
+/// A value that can go up and down, like the number of active sessions.
+class gauge
+{
+public:
+	void add(std::int64_t v = 1)
+	{
+		value_.fetch_add(v, std::memory_order_relaxed);
+	}
+
+	void sub(std::int64_t v = 1)
+	{
+		value_.fetch_sub(v, std::memory_order_relaxed);
+	}
+
+	void set(std::int64_t v)
+	{
+		value_.store(v, std::memory_order_relaxed);
+	}
+
+	std::int64_t value() const
+	{
+		return value_.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<std::int64_t> value_{};
+};
+
+/// \brief A log-linear histogram, in the manner of HdrHistogram.
+///
+/// Each power of 2 is split into 2^sub_bucket_bits linear buckets, so that the relative error of any recorded value is at most 1/2^sub_bucket_bits,
+/// over the whole range of 64 bits, with a fixed amount of memory and without any locking.
+class histogram
+{
+public:
+	static constexpr unsigned sub_bucket_bits = 3;
+	static constexpr std::size_t sub_buckets_count = std::size_t(1) << sub_bucket_bits;
+	static constexpr std::size_t buckets_count = (64 - sub_bucket_bits + 1) * sub_buckets_count;
+
+	void record(std::uint64_t v)
+	{
+		buckets_[bucket_index(v)].fetch_add(1, std::memory_order_relaxed);
+		sum_.add(v);
+	}
+
+	/// Records the duration in microseconds.
+	void record(duration d)
+	{
+		auto us = d.get_microseconds();
+		record(us > 0 ? std::uint64_t(us) : 0);
+	}
+
+	/// Records the time elapsed on the stopwatch, in microseconds.
+	void record(const stopwatch &sw)
+	{
+		record(sw.elapsed_us());
+	}
+
+	static std::size_t bucket_index(std::uint64_t v);
+
+	/// \returns the exclusive upper bound of the bucket.
+	static std::uint64_t bucket_upper_bound(std::size_t index);
+
+	void collect(family::sample &s) const;
+
+private:
+	std::array<std::atomic<std::uint64_t>, buckets_count> buckets_{};
+	counter sum_;
+};
+
+/// \brief Holds the metrics, grouped in families by name, each metric of a family being told apart by its labels.
+///
+/// The metrics are created on their first request and live as long as the registry does:
+/// the instrumented code is meant to look them up once and keep the reference.
+class registry
+{
+public:
+	counter &get_counter(std::string_view name, std::string_view help, const labels &l = {});
+	gauge &get_gauge(std::string_view name, std::string_view help, const labels &l = {});
+	histogram &get_histogram(std::string_view name, std::string_view help, metrics::unit unit, const labels &l = {});
+
+	snapshot collect() const;
+
+	/// The registry the server components report to.
+	static registry &global();
+
+private:
+	struct entry
+	{
+		metrics::type type{};
+		metrics::unit unit{};
+		std::string help{};
+
+		std::map<labels, std::unique_ptr<counter>> counters{};
+		std::map<labels, std::unique_ptr<gauge>> gauges{};
+		std::map<labels, std::unique_ptr<histogram>> histograms{};
+	};
+
+	template <typename T>
+	T &get(std::map<labels, std::unique_ptr<T>> entry::*map, metrics::type type, metrics::unit unit, std::string_view name, std::string_view help, const labels &l);
+
+	mutable fz::mutex mutex_;
+	std::map<std::string, entry, std::less<>> families_;
+};
+
+}
+
+#endif // FZ_METRICS_REGISTRY_HPP
@@ -1,13 +1,38 @@
 #include "port_randomizer.hpp"
+#include "hostaddress.hpp"
+#include "util/bits.hpp"
 
 #include <random>
 
 namespace fz {
 
+namespace {
+
+constexpr std::uint64_t port_bit(int p)
+{
+	return std::uint64_t(1) << (p % 64);
+}
+
+}
+
+port_lease::peer_key port_lease::peer_key::from_ip(std::string_view ip)
+{
+	hostaddress h(ip, hostaddress::format::ipvx);
+
+	if (auto v4 = h.ipv4())
+		return { 0, 0xffff00000000ull | v4->to_uint32() };
+
+	if (auto v6 = h.ipv6())
+		return { v6->high_to_uint64(), v6->low_to_uint64() };
+
+	// Peer addresses come from the sockets, so this should never happen. Still, keep unparseable peers apart from each other.
+	return { ~std::uint64_t(0), std::hash<std::string_view>()(ip) };
+}
+
 port_randomizer::port_randomizer(port_manager & manager, std::string const& peer_ip, int min_port, int max_port)
 	: min_(min_port)
 	, max_(max_port)
-	, peer_ip_(peer_ip)
+	, peer_(port_lease::peer_key::from_ip(peer_ip))
 	, manager_(manager)
 {
 	if (min_ > max_) {
@@ -33,114 +58,191 @@ port_randomizer::port_randomizer(port_manager & manager, std::string const& peer
 
 port_lease port_randomizer::get_port()
 {
-	return port_lease(do_get_port(), peer_ip_, manager_);
+	return port_lease(manager_.acquire(*this), peer_, manager_);
 }
 
-int port_randomizer::do_get_port()
+
+duration const port_manager::wheel_resolution_ = duration::from_seconds(1);
+duration const port_manager::time_wait_ = duration::from_minutes(4);
+
+port_manager::port_manager()
+	: peers_per_port_(65536)
+	, wheel_time_(fz::monotonic_clock::now())
 {
-	auto now = fz::monotonic_clock::now();
+}
 
-	while (true) {
-		if (!prev_port_) {
-			prev_port_ = first_port_;
-		}
-		else {
-			++prev_port_;
-			if (prev_port_ < min_ || prev_port_ > max_) {
-				prev_port_ = min_;
+int port_manager::acquire(port_randomizer &r)
+{
+	fz::scoped_lock l(mutex_);
+
+	expire(fz::monotonic_clock::now());
+
+	int const n = r.max_ - r.min_ + 1;
+
+	while (r.reuse_ != port_randomizer::reuse::exhausted) {
+		while (r.scanned_ < n) {
+			// A round goes from first_port_ up to max_, then wraps around from min_ up to just before first_port_.
+			int from = r.first_port_ + r.scanned_;
+			if (from > r.max_) {
+				from -= n;
 			}
-			if (prev_port_ == first_port_) {
-				// Wraparound, relax requirements
-				if (!allow_reuse_other_) {
-					// Should not be a problem other than when using server-to-server transfers
-					allow_reuse_other_ = true;
-				}
-				else if (!allow_reuse_same_) {
-					// This can be problematic in case peer port is the same due to the socket pair's TIME_WAIT state.
-					allow_reuse_same_ = true;
-				}
-				else {
-					// Give up
-					break;
-				}
+
+			int to = from < r.first_port_ ? r.first_port_ - 1 : r.max_;
+
+			if (int p = find_port(from, to, r.reuse_, r.peer_); p != 0) {
+				r.scanned_ += p - from + 1;
+				lease_port(p, r.peer_);
+				return p;
 			}
+
+			r.scanned_ += to - from + 1;
 		}
 
-		fz::scoped_lock l(manager_.mutex_[prev_port_]);
+		// Wraparound, relax requirements.
+		// Reusing ports of other peers should not be a problem other than when using server-to-server transfers.
+		// Reusing ports of the same peer can be problematic in case peer port is the same due to the socket pair's TIME_WAIT state.
+		// After that, give up.
+		r.reuse_ = port_randomizer::reuse(int(r.reuse_) + 1);
+		r.scanned_ = 0;
+	}
 
-		if (!manager_.connecting_[prev_port_].exchange(1)) {
-			if (!allow_reuse_other_ && !allow_reuse_same_) {
-				manager_.prune(prev_port_, now);
-			}
+	return 0;
+}
 
-			auto& es = manager_.entries_[prev_port_];
-			auto it = std::find_if(es.begin(), es.end(), [&](port_manager::entry const& e){ return e.peer_ == peer_ip_; });
-			if (it != es.end()) {
-				if (allow_reuse_same_) {
-					++it->leases_;
-					return prev_port_;
-				}
-			}
-			else if (es.empty() || allow_reuse_other_) {
-				port_manager::entry e;
-				e.leases_ = 1;
-				e.peer_ = peer_ip_;
-				es.push_back(e);
-				return prev_port_;
+int port_manager::find_port(int from, int to, port_randomizer::reuse reuse, peer_key const& peer) const
+{
+	ports_map const* peer_ports{};
+
+	if (reuse == port_randomizer::reuse::other_peer) {
+		if (auto it = peers_.find(peer); it != peers_.end()) {
+			peer_ports = &it->second;
+		}
+	}
+
+	for (int w = from / 64, last_w = to / 64; w <= last_w; ++w) {
+		// Ports still in the listening stage are never handed out again.
+		std::uint64_t candidates = ~connecting_[std::size_t(w)];
+
+		if (reuse == port_randomizer::reuse::none) {
+			candidates &= ~occupied_[std::size_t(w)];
+		}
+
+		if (w == from / 64) {
+			candidates &= ~std::uint64_t(0) << (from % 64);
+		}
+
+		if (w == last_w && to % 64 != 63) {
+			candidates &= port_bit(to + 1) - 1;
+		}
+
+		for (; candidates; candidates &= candidates - 1) {
+			int p = w * 64 + int(util::count_trailing_zeros(candidates));
+
+			// When reusing the ports of other peers, the ones this same peer is using must still be avoided.
+			if (!peer_ports || peer_ports->find(std::uint16_t(p)) == peer_ports->end()) {
+				return p;
 			}
-			manager_.connecting_[prev_port_] = 0;
 		}
 	}
 
 	return 0;
 }
 
+void port_manager::lease_port(int p, peer_key const& peer)
+{
+	connecting_[std::size_t(p / 64)] |= port_bit(p);
+
+	auto [it, inserted] = peers_[peer].try_emplace(std::uint16_t(p));
+	if (inserted && peers_per_port_[std::size_t(p)]++ == 0) {
+		occupied_[std::size_t(p / 64)] |= port_bit(p);
+	}
+
+	++it->second.leases_;
+}
 
-void port_manager::release(int p, std::string const& peer, bool connected)
+void port_manager::release(int p, peer_key const& peer, bool connected)
 {
-	if (p && p < 65536) {
-		{
-			fz::scoped_lock l(mutex_[p]);
+	if (p <= 0 || p >= 65536) {
+		return;
+	}
 
-			auto& es = entries_[p];
-			auto it = std::find_if(es.begin(), es.end(), [&](entry const& e) { return e.peer_ == peer; });
-			if (it != es.end() && it->leases_) {
-				--it->leases_;
-				it->expiry_ = fz::monotonic_clock::now() + fz::duration::from_minutes(4); // 4 minute TIME_WAIT
+	fz::scoped_lock l(mutex_);
+
+	auto now = fz::monotonic_clock::now();
+	expire(now);
+
+	if (auto pit = peers_.find(peer); pit != peers_.end()) {
+		if (auto it = pit->second.find(std::uint16_t(p)); it != pit->second.end() && it->second.leases_) {
+			if (--it->second.leases_ == 0) {
+				// Keep the port around for the TIME_WAIT duration.
+				// The slot is chosen so that it gets visited no earlier than the expiry time.
+				it->second.expiry_ = now + time_wait_;
+
+				auto ticks = std::size_t((it->second.expiry_ - wheel_time_).get_milliseconds() / wheel_resolution_.get_milliseconds()) + 1;
+				wheel_[(wheel_pos_ + ticks) % wheel_slots_].emplace_back(std::uint16_t(p), peer);
 			}
 		}
+	}
 
-		if (!connected) {
-			connecting_[p] = 0;
-		}
+	if (!connected) {
+		connecting_[std::size_t(p / 64)] &= ~port_bit(p);
 	}
 }
 
-
-void port_manager::set_connected(int p, const std::string &)
+void port_manager::set_connected(int p)
 {
-	if (p && p < 65536) {
-		connecting_[p] = 0;
+	if (p <= 0 || p >= 65536) {
+		return;
 	}
-}
 
+	fz::scoped_lock l(mutex_);
 
-void port_manager::prune(int port, const fz::monotonic_clock &now)
+	connecting_[std::size_t(p / 64)] &= ~port_bit(p);
+}
+
+void port_manager::expire(monotonic_clock const& now)
 {
-	auto const predicate = [&now](entry const& e) {
-		return !e.leases_ && e.expiry_ < now;
-	};
+	for (std::size_t i = 0; i < wheel_slots_ && now - wheel_time_ >= wheel_resolution_; ++i) {
+		wheel_time_ += wheel_resolution_;
+		wheel_pos_ = (wheel_pos_ + 1) % wheel_slots_;
+
+		auto &slot = wheel_[wheel_pos_];
+
+		for (auto const& [p, peer]: slot) {
+			auto pit = peers_.find(peer);
+			if (pit == peers_.end()) {
+				continue;
+			}
+
+			// The port might have been leased again in the meanwhile, in which case there's a later slot for it, if any.
+			auto it = pit->second.find(p);
+			if (it == pit->second.end() || it->second.leases_ || now < it->second.expiry_) {
+				continue;
+			}
 
-	entries_[port].erase(
-		std::remove_if(entries_[port].begin(), entries_[port].end(), predicate),
-		entries_[port].end()
-	);
+			pit->second.erase(it);
+			if (pit->second.empty()) {
+				peers_.erase(pit);
+			}
+
+			if (--peers_per_port_[p] == 0) {
+				occupied_[p / 64] &= ~port_bit(p);
+			}
+		}
+
+		slot.clear();
+	}
+
+	// If nothing happened for longer than a whole turn of the wheel, every slot has been visited already.
+	if (now - wheel_time_ >= wheel_resolution_) {
+		wheel_time_ = now;
+	}
 }
 
 
 port_lease::port_lease(port_lease && lease)
 	: port_(lease.port_)
-	, peer_ip_(std::move(lease.peer_ip_))
+	, peer_(lease.peer_)
 	, port_manager_(lease.port_manager_)
 	, connected_(lease.connected_)
 {
@@ -150,10 +252,10 @@ port_lease::port_lease(port_lease && lease)
 port_lease& port_lease::operator=(port_lease && lease)
 {
 	if (port_manager_)
-		port_manager_->release(port_, peer_ip_, connected_);
+		port_manager_->release(port_, peer_, connected_);
 
 	port_ = lease.port_;
-	peer_ip_ = std::move(lease.peer_ip_);
+	peer_ = lease.peer_;
 	port_manager_ = lease.port_manager_;
 	connected_ = lease.connected_;
 	lease.port_ = 0;
@@ -163,12 +265,12 @@ port_lease& port_lease::operator=(port_lease && lease)
 port_lease::~port_lease()
 {
 	if (port_manager_)
-		port_manager_->release(port_, peer_ip_, connected_);
+		port_manager_->release(port_, peer_, connected_);
 }
 
-port_lease::port_lease(int p, std::string const& peer, port_manager & manager)
+port_lease::port_lease(int p, peer_key const& peer, port_manager & manager)
 	: port_(p)
-	, peer_ip_(peer)
+	, peer_(peer)
 	, port_manager_(&manager)
 {
 }
@@ -177,12 +279,8 @@ void port_lease::set_connected()
 {
 	if (port_manager_ && !connected_) {
 		connected_ = true;
-		port_manager_->set_connected(port_, peer_ip_);
+		port_manager_->set_connected(port_);
 	}
 }
 
-fz::mutex port_manager::mutex_[65536];
-std::vector<port_manager::entry> port_manager::entries_[65536];
-std::atomic_char port_manager::connecting_[65536];
-
 }
@@ -1,12 +1,18 @@
 #ifndef FZ_PORT_RANDOMIZER_HPP
 #define FZ_PORT_RANDOMIZER_HPP
 
-// Ported almost verbatim from old filezilla server's sources.
+// Originally ported from old filezilla server's sources.
 
-#include <atomic>
+#include <array>
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include <libfilezilla/mutex.hpp>
+#include <libfilezilla/time.hpp>
 
 /*
 FTP suffers from connection stealing attacks. The only actual solution
@@ -22,6 +28,11 @@ said port is not in the listening stage.
 
 As last resort, it reuses a busy port from the same peer.
 
+The port manager keeps track of which ports are in use, or in TIME_WAIT, with bitmaps,
+so that finding a candidate port costs one bit scan over the range rather than one lock per port.
+The ports held by each peer are kept in a hash map keyed by the numeric peer address,
+and TIME_WAIT expiry is driven by a timing wheel.
+
 */
 
 namespace fz {
@@ -46,10 +57,23 @@ private:
 	friend class port_randomizer;
 	friend class port_manager;
 
-	port_lease(int p, std::string const& peer, port_manager & manager);
+	struct peer_key
+	{
+		std::uint64_t high{};
+		std::uint64_t low{};
+
+		bool operator==(const peer_key &rhs) const
+		{
+			return high == rhs.high && low == rhs.low;
+		}
+
+		static peer_key from_ip(std::string_view ip);
+	};
+
+	port_lease(int p, peer_key const& peer, port_manager & manager);
 
 	int port_{};
-	std::string peer_ip_;
+	peer_key peer_;
 	port_manager * port_manager_{};
 	bool connected_{};
 };
@@ -70,18 +94,25 @@ public:
 	port_lease get_port();
 
 private:
-	int do_get_port();
+	friend class port_manager;
+
+	enum class reuse: std::uint8_t {
+		none,
+		other_peer,
+		same_peer,
+		exhausted
+	};
 
 	int min_{};
 	int max_{};
 
 	int first_port_{};
-	int prev_port_{};
 
-	bool allow_reuse_other_{};
-	bool allow_reuse_same_{};
+	// How many ports of the current round, starting from first_port_, have already been considered.
+	int scanned_{};
+	reuse reuse_{};
 
-	std::string const peer_ip_;
+	port_lease::peer_key const peer_;
 
 	port_manager& manager_;
 };
@@ -90,7 +121,7 @@ private:
 class port_manager final
 {
 public:
-	port_manager() = default;
+	port_manager();
 	port_manager(port_manager const&) = delete;
 	port_manager& operator=(port_manager const&) = delete;
 
@@ -98,21 +129,52 @@ private:
 	friend class port_lease;
 	friend class port_randomizer;
 
-	void release(int p, const std::string &peer, bool connected);
-	void set_connected(int p, std::string const&);
+	using peer_key = port_lease::peer_key;
+
+	int acquire(port_randomizer &r);
+	void release(int p, peer_key const& peer, bool connected);
+	void set_connected(int p);
 
-	void prune(int port, const fz::monotonic_clock &now);
+	int find_port(int from, int to, port_randomizer::reuse reuse, peer_key const& peer) const;
+	void lease_port(int p, peer_key const& peer);
+	void expire(monotonic_clock const& now);
 
 	struct entry
 	{
-		std::string peer_;
-		int leases_{};
+		std::uint32_t leases_{};
 		fz::monotonic_clock expiry_{};
 	};
 
-	static fz::mutex mutex_[65536];
-	static std::vector<entry> entries_[65536];
-	static std::atomic_char connecting_[65536];
+	struct peer_key_hash
+	{
+		std::size_t operator()(peer_key const& k) const noexcept
+		{
+			return std::hash<std::uint64_t>()(k.high ^ (k.low * 0x9e3779b97f4a7c15ull));
+		}
+	};
+
+	using bitmap = std::array<std::uint64_t, 65536/64>;
+	using ports_map = std::unordered_map<std::uint16_t, entry>;
+
+	static constexpr std::size_t wheel_slots_ = 512;
+	static duration const wheel_resolution_;
+	static duration const time_wait_;
+
+	fz::mutex mutex_;
+
+	// Ports having at least one entry, either leased or in TIME_WAIT.
+	bitmap occupied_{};
+
+	// Ports that have been handed out and are still waiting for the peer to connect.
+	bitmap connecting_{};
+
+	// How many peers have an entry for each port. Every peer can have one, hence 16 bits wouldn't be enough.
+	std::vector<std::uint32_t> peers_per_port_;
+	std::unordered_map<peer_key, ports_map, peer_key_hash> peers_;
+
+	std::array<std::vector<std::pair<std::uint16_t, peer_key>>, wheel_slots_> wheel_;
+	std::size_t wheel_pos_{};
+	monotonic_clock wheel_time_;
 };
 
 }
@@ -0,0 +1,570 @@
+#include <algorithm>
+
+#include "fair_share_scheduler.hpp"
+
+namespace fz::rate_limit {
+
+namespace {
+
+// Below this, a session would hardly be able to make any progress at all.
+constexpr rate::type min_leaf_rate = 1024;
+
+constexpr direction::type directions[] = { direction::inbound, direction::outbound };
+
+rate::type saturating_add(rate::type a, rate::type b)
+{
+	return a > rate::unlimited - b ? rate::unlimited : a + b;
+}
+
+rate::type proportion(rate::type r, std::uint64_t num, std::uint64_t den)
+{
+	if (r == rate::unlimited || den == 0)
+		return r;
+
+	return rate::type(double(r) * double(num) / double(den));
+}
+
+struct claim
+{
+	std::uint32_t weight{1};
+	rate::type ceiling{rate::unlimited};
+	rate::type want{};
+	rate::type share{rate::unlimited};
+};
+
+// Weighted max-min fairness: the classes that want less than their weighted part of the capacity get all they want,
+// what they leave is split among the others, in proportion to their weights.
+// No class is granted more than its fair allocation. What's left once every class got what it wants
+// is lent to them in proportion to their weights, up to their ceilings, so that they can ramp up.
+void fill(rate::type capacity, std::vector<claim *> &claims)
+{
+	std::uint64_t total_weight = 0;
+	for (auto c: claims)
+		total_weight += c->weight;
+
+	std::sort(claims.begin(), claims.end(), [](const claim *a, const claim *b) {
+		return double(a->want) / a->weight < double(b->want) / b->weight;
+	});
+
+	auto remaining = capacity;
+	auto remaining_weight = total_weight;
+
+	for (auto c: claims) {
+		auto allocation = std::min({c->want, proportion(remaining, c->weight, remaining_weight), remaining, c->ceiling});
+
+		remaining -= allocation;
+		remaining_weight -= c->weight;
+
+		c->share = allocation;
+	}
+
+	if (remaining == 0)
+		return;
+
+	auto headroom = [](const claim *c) {
+		return c->ceiling == rate::unlimited ? rate::unlimited : c->ceiling - c->share;
+	};
+
+	std::sort(claims.begin(), claims.end(), [&headroom](const claim *a, const claim *b) {
+		return double(headroom(a)) / a->weight < double(headroom(b)) / b->weight;
+	});
+
+	remaining_weight = total_weight;
+
+	for (auto c: claims) {
+		auto extra = std::min({headroom(c), proportion(remaining, c->weight, remaining_weight), remaining});
+
+		remaining -= extra;
+		remaining_weight -= c->weight;
+
+		c->share += extra;
+	}
+}
+}
+
+struct fair_share_scheduler::node
+{
+	explicit node(std::string name)
+		: name(std::move(name))
+	{}
+
+	const std::string name;
+
+	// Only accessed with the scheduler's mutex held.
+	std::uint32_t weight{1};
+	std::shared_ptr<shared_limiter> limiter{};
+	std::shared_ptr<node> parent{};
+
+	// Updated by the shards, read by the global pass.
+	std::atomic<std::int64_t> sessions{};
+	std::atomic<std::int64_t> saturated[2]{};
+	std::atomic<std::int64_t> demand[2]{};
+	std::atomic<std::int64_t> transferred[2]{};
+
+	// Updated by the global pass, read by the shards.
+	std::atomic<rate::type> leaf_rate[2]{rate::unlimited, rate::unlimited};
+};
+
+class fair_share_scheduler::shard: private event_handler
+{
+public:
+	shard(event_loop &loop, const std::function<monotonic_clock()> &clock)
+		: event_handler(loop)
+		, clock_(clock)
+	{}
+
+	~shard() override
+	{
+		remove_handler();
+	}
+
+	void start(duration tick)
+	{
+		scoped_lock lock(mutex_);
+
+		stop_timer(timer_id_);
+		timer_id_ = add_timer(tick, false);
+		last_tick_ = clock_();
+	}
+
+	void add(leaf &l)
+	{
+		scoped_lock lock(mutex_);
+
+		l.index_ = leaves_.size();
+		leaves_.push_back(&l);
+	}
+
+	void remove(leaf &l)
+	{
+		scoped_lock lock(mutex_);
+
+		leaves_.back()->index_ = l.index_;
+		leaves_[l.index_] = leaves_.back();
+		leaves_.pop_back();
+	}
+
+	void tick()
+	{
+		scoped_lock lock(mutex_);
+
+		auto now = clock_();
+		auto elapsed = (now - last_tick_).get_milliseconds();
+		if (elapsed <= 0)
+			return;
+
+		last_tick_ = now;
+
+		for (auto l: leaves_)
+			l->tick(elapsed);
+	}
+
+	fz::mutex mutex_;
+
+private:
+	void operator()(const event_base &ev) override
+	{
+		fz::dispatch<timer_event>(ev, this, &shard::on_timer);
+	}
+
+	void on_timer(timer_id)
+	{
+		tick();
+	}
+
+	const std::function<monotonic_clock()> &clock_;
+	timer_id timer_id_{};
+	monotonic_clock last_tick_;
+	std::vector<leaf *> leaves_;
+};
+
+fair_share_scheduler::fair_share_scheduler(event_loop &loop, options opts, std::function<monotonic_clock()> clock)
+	: event_handler(loop)
+	, opts_(std::move(opts))
+	, clock_(std::move(clock))
+{
+	timer_id_ = add_timer(opts_.tick(), false);
+	last_update_ = clock_();
+}
+
+fair_share_scheduler::~fair_share_scheduler()
+{
+	remove_handler();
+}
+
+void fair_share_scheduler::set_options(options opts)
+{
+	scoped_lock lock(mutex_);
+
+	opts_ = std::move(opts);
+
+	stop_timer(timer_id_);
+	timer_id_ = add_timer(opts_.tick(), false);
+
+	for (auto &[_, s]: shards_)
+		s->start(opts_.tick());
+}
+
+void fair_share_scheduler::step()
+{
+	scoped_lock lock(mutex_);
+
+	for (auto &[_, s]: shards_)
+		s->tick();
+
+	update();
+}
+
+void fair_share_scheduler::release(event_loop &loop)
+{
+	scoped_lock lock(mutex_);
+
+	shards_.erase(&loop);
+}
+
+std::vector<fair_share_scheduler::class_stats> fair_share_scheduler::get_stats() const
+{
+	scoped_lock lock(mutex_);
+
+	return stats_;
+}
+
+std::shared_ptr<fair_share_scheduler::node> fair_share_scheduler::get_node(nodes &map, const share &s)
+{
+	auto &n = map[s.name];
+	if (!n)
+		n = std::make_shared<node>(s.name);
+
+	n->weight = std::max(s.weight, std::uint32_t(1));
+	n->limiter = s.limiter;
+
+	return n;
+}
+
+fair_share_scheduler::shard &fair_share_scheduler::get_shard(event_loop &loop)
+{
+	scoped_lock lock(mutex_);
+
+	auto &s = shards_[&loop];
+	if (!s) {
+		s = std::make_unique<shard>(loop, clock_);
+		s->start(opts_.tick());
+	}
+
+	return *s;
+}
+
+void fair_share_scheduler::operator()(const event_base &ev)
+{
+	fz::dispatch<timer_event>(ev, this, &fair_share_scheduler::on_timer);
+}
+
+void fair_share_scheduler::on_timer(timer_id)
+{
+	scoped_lock lock(mutex_);
+
+	update();
+}
+
+void fair_share_scheduler::update()
+{
+	auto now = clock_();
+	auto elapsed = (now - last_update_).get_milliseconds();
+	if (elapsed <= 0)
+		return;
+
+	last_update_ = now;
+
+	// Forget about the classes no session belongs to anymore.
+	auto prune = [](nodes &map) {
+		for (auto it = map.begin(); it != map.end();) {
+			if (it->second.use_count() == 1)
+				it = map.erase(it);
+			else
+				++it;
+		}
+	};
+
+	prune(users_);
+	prune(groups_);
+
+	struct entry
+	{
+		node *n;
+		claim claims[2];
+		rate::type rates[2];
+		std::vector<entry *> children{};
+	};
+
+	entry server{};
+	std::vector<entry> groups;
+	std::vector<entry> users;
+
+	groups.reserve(groups_.size());
+	users.reserve(users_.size());
+
+	std::vector<entry *> ungrouped;
+	std::unordered_map<node *, entry *> group_entries;
+
+	for (auto &[_, g]: groups_)
+		group_entries[g.get()] = &groups.emplace_back(entry{g.get(), {}, {}});
+
+	for (auto &[_, u]: users_) {
+		auto &e = users.emplace_back(entry{u.get(), {}, {}});
+
+		if (auto it = group_entries.find(u->parent.get()); it != group_entries.end())
+			it->second->children.push_back(&e);
+		else
+			ungrouped.push_back(&e);
+	}
+
+	for (auto &g: groups)
+		server.children.push_back(&g);
+
+	server.children.insert(server.children.end(), ungrouped.begin(), ungrouped.end());
+
+	rate::type const capacities[2] = { opts_.inbound_capacity(), opts_.outbound_capacity() };
+
+	for (auto d: directions) {
+		auto ceiling = [d](node *n) {
+			return n->limiter ? n->limiter->limit(d) : rate::unlimited;
+		};
+
+		for (auto &u: users) {
+			auto &c = u.claims[d];
+
+			c.weight = u.n->weight;
+			c.ceiling = ceiling(u.n);
+			c.want = std::min(u.n->saturated[d] > 0 ? rate::unlimited : rate::type(std::max<std::int64_t>(u.n->demand[d], 0)), c.ceiling);
+
+			u.rates[d] = rate::type(std::max<std::int64_t>(u.n->transferred[d].exchange(0, std::memory_order_relaxed), 0) * 1000 / elapsed);
+		}
+
+		for (auto &g: groups) {
+			auto &c = g.claims[d];
+
+			c.weight = g.n->weight;
+			c.ceiling = ceiling(g.n);
+			c.want = 0;
+			g.rates[d] = 0;
+
+			for (auto u: g.children) {
+				c.want = saturating_add(c.want, u->claims[d].want);
+				g.rates[d] = saturating_add(g.rates[d], u->rates[d]);
+			}
+
+			c.want = std::min(c.want, c.ceiling);
+		}
+
+		server.claims[d].share = capacities[d];
+		server.rates[d] = 0;
+
+		for (auto c: server.children)
+			server.rates[d] = saturating_add(server.rates[d], c->rates[d]);
+
+		if (capacities[d] != rate::unlimited) {
+			auto fill_children = [d](entry &parent) {
+				std::vector<claim *> claims;
+				claims.reserve(parent.children.size());
+
+				for (auto c: parent.children)
+					claims.push_back(&c->claims[d]);
+
+				fill(parent.claims[d].share, claims);
+			};
+
+			fill_children(server);
+
+			for (auto &g: groups)
+				fill_children(g);
+		}
+		else {
+			for (auto &g: groups)
+				g.claims[d].share = rate::unlimited;
+
+			for (auto &u: users)
+				u.claims[d].share = rate::unlimited;
+		}
+
+		// The sessions that aren't using all of their share keep what they use, the others split evenly what's left.
+		for (auto &u: users) {
+			auto share = u.claims[d].share;
+			auto rate = share;
+
+			if (share != rate::unlimited) {
+				auto sessions = rate::type(std::max<std::int64_t>(u.n->sessions, 1));
+				auto saturated = rate::type(std::max<std::int64_t>(u.n->saturated[d], 0));
+				auto demand = rate::type(std::max<std::int64_t>(u.n->demand[d], 0));
+
+				if (demand >= share)
+					rate = share / sessions;
+				else
+				if (saturated > 0)
+					rate = std::max((share - demand) / saturated, share / sessions);
+
+				rate = std::max(rate, min_leaf_rate);
+			}
+
+			u.n->leaf_rate[d].store(rate, std::memory_order_relaxed);
+		}
+	}
+
+	auto make_stats = [](class_stats::kind_t kind, const entry &e, const std::string &parent) {
+		class_stats s;
+
+		s.kind = kind;
+		s.name = e.n ? e.n->name : std::string();
+		s.parent = parent;
+		s.weight = e.n ? e.n->weight : 1;
+		s.inbound_rate = e.rates[direction::inbound];
+		s.outbound_rate = e.rates[direction::outbound];
+		s.inbound_share = e.claims[direction::inbound].share;
+		s.outbound_share = e.claims[direction::outbound].share;
+
+		return s;
+	};
+
+	// Sessions are only counted by the users, groups and server add them up.
+	auto add_users = [&](const std::vector<entry *> &children, const std::string &parent) {
+		std::size_t sessions = 0;
+
+		for (auto u: children) {
+			auto &s = stats_.emplace_back(make_stats(class_stats::user, *u, parent));
+			s.sessions = std::size_t(std::max<std::int64_t>(u->n->sessions, 0));
+			sessions += s.sessions;
+		}
+
+		return sessions;
+	};
+
+	stats_.clear();
+	stats_.reserve(1 + groups.size() + users.size());
+	stats_.push_back(make_stats(class_stats::server, server, {}));
+
+	std::size_t sessions = 0;
+
+	for (auto &g: groups) {
+		auto index = stats_.size();
+		stats_.push_back(make_stats(class_stats::group, g, {}));
+
+		stats_[index].sessions = add_users(g.children, g.n->name);
+		sessions += stats_[index].sessions;
+	}
+
+	sessions += add_users(ungrouped, {});
+	stats_.front().sessions = sessions;
+}
+
+fair_share_scheduler::leaf::leaf(fair_share_scheduler &scheduler, event_loop &loop, rate_limiter &limiter)
+	: scheduler_(scheduler)
+	, shard_(scheduler.get_shard(loop))
+	, limiter_(limiter)
+{
+	shard_.add(*this);
+}
+
+fair_share_scheduler::leaf::~leaf()
+{
+	// Once removed from the shard, the leaf isn't ticked anymore.
+	shard_.remove(*this);
+	leave();
+}
+
+void fair_share_scheduler::leaf::set_class(share user, share group, rate::type session_inbound_limit, rate::type session_outbound_limit)
+{
+	std::shared_ptr<node> n;
+
+	if (!user.name.empty()) {
+		scoped_lock lock(scheduler_.mutex_);
+
+		n = scheduler_.get_node(scheduler_.users_, user);
+		n->parent = group.name.empty() ? nullptr : scheduler_.get_node(scheduler_.groups_, group);
+	}
+
+	scoped_lock lock(shard_.mutex_);
+
+	if (n != user_) {
+		leave();
+
+		user_ = std::move(n);
+		if (user_)
+			++user_->sessions;
+	}
+
+	session_limits_[direction::inbound] = session_inbound_limit;
+	session_limits_[direction::outbound] = session_outbound_limit;
+
+	apply();
+}
+
+void fair_share_scheduler::leaf::tick(std::int64_t elapsed_ms)
+{
+	for (auto d: directions) {
+		auto amount = transferred_[d].exchange(0, std::memory_order_relaxed);
+
+		if (!user_)
+			continue;
+
+		user_->transferred[d].fetch_add(amount, std::memory_order_relaxed);
+
+		auto rate = std::max<std::int64_t>(amount, 0) * 1000 / elapsed_ms;
+		auto limit = applied_limits_[d];
+
+		// A session is saturated if it's going as fast as its share allows.
+		// If it's its own session limit that holds it back, though, it would make no use of a bigger share.
+		bool saturated = limit != rate::unlimited && !capped_[d] && rate::type(rate) >= limit - limit / 10;
+		std::int64_t demand = saturated ? 0 : rate;
+
+		if (saturated != saturated_[d]) {
+			saturated_[d] = saturated;
+			user_->saturated[d].fetch_add(saturated ? 1 : -1, std::memory_order_relaxed);
+		}
+
+		if (demand != demand_[d]) {
+			user_->demand[d].fetch_add(demand - demand_[d], std::memory_order_relaxed);
+			demand_[d] = demand;
+		}
+	}
+
+	apply();
+}
+
+void fair_share_scheduler::leaf::apply()
+{
+	rate::type limits[2];
+
+	for (auto d: directions) {
+		auto share = user_ ? user_->leaf_rate[d].load(std::memory_order_relaxed) : rate::unlimited;
+
+		capped_[d] = session_limits_[d] != rate::unlimited && session_limits_[d] <= share;
+		limits[d] = std::min(share, session_limits_[d]);
+	}
+
+	if (limits[direction::inbound] != applied_limits_[direction::inbound] || limits[direction::outbound] != applied_limits_[direction::outbound]) {
+		applied_limits_[direction::inbound] = limits[direction::inbound];
+		applied_limits_[direction::outbound] = limits[direction::outbound];
+
+		limiter_.set_limits(limits[direction::inbound], limits[direction::outbound]);
+	}
+}
+
+void fair_share_scheduler::leaf::leave()
+{
+	if (!user_)
+		return;
+
+	for (auto d: directions) {
+		if (saturated_[d])
+			user_->saturated[d].fetch_sub(1, std::memory_order_relaxed);
+
+		user_->demand[d].fetch_sub(demand_[d], std::memory_order_relaxed);
+
+		saturated_[d] = false;
+		demand_[d] = 0;
+	}
+
+	--user_->sessions;
+	user_.reset();
+}
+
+}
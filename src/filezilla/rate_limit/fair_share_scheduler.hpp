@@ -0,0 +1,184 @@
+#ifndef FZ_RATE_LIMIT_FAIR_SHARE_SCHEDULER_HPP
+#define FZ_RATE_LIMIT_FAIR_SHARE_SCHEDULER_HPP
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <libfilezilla/event_handler.hpp>
+#include <libfilezilla/mutex.hpp>
+#include <libfilezilla/rate_limiter.hpp>
+
+#include "../serialization/helpers.hpp"
+#include "../util/options.hpp"
+#include "shared_limiter.hpp"
+
+namespace fz::rate_limit {
+
+/// \brief Shares the server bandwidth among groups, users and sessions, in a weighted fair manner.
+///
+/// The classes are arranged in a hierarchy: server → group → user → session.
+/// Whenever a class cannot get all the bandwidth it asks for, its parent's capacity is split among the siblings
+/// proportionally to their weights, and whatever a class doesn't use is lent to the siblings that need more.
+/// The sessions of a user split the user's share evenly, so that opening more connections doesn't get a user a bigger share.
+///
+/// The scheduler doesn't move any data by itself: it enforces the shares by setting the limits of each session's own rate_limiter.
+/// The rate limits configured for users and groups keep being enforced by their own limiters, and are taken as ceilings of the classes.
+///
+/// The sessions are measured, and their limits applied, by a shard that runs on the event loop of the sessions themselves.
+/// The global pass, which runs on the scheduler's loop, only deals with groups and users.
+class fair_share_scheduler: private event_handler
+{
+public:
+	struct options: util::options<options, fair_share_scheduler>
+	{
+		/// The capacity the scheduler shares, per direction, in bytes per second.
+		/// If unlimited, nothing is shared in that direction and the sessions are only subject to their own limits.
+		opt<rate::type> inbound_capacity  = o(rate::unlimited);
+		opt<rate::type> outbound_capacity = o(rate::unlimited);
+
+		/// How often the usage is measured and the shares recomputed.
+		opt<duration> tick                = o(duration::from_milliseconds(250));
+
+		options() {}
+	};
+
+	/// Identifies a class of the hierarchy, as seen by a session.
+	struct share
+	{
+		std::string name{};
+		std::uint32_t weight{1};
+
+		/// The limiter that enforces the configured limits of the class, if any.
+		std::shared_ptr<shared_limiter> limiter{};
+	};
+
+	/// The throughput of a class, as measured during the last tick.
+	struct class_stats
+	{
+		enum kind_t: std::uint8_t {
+			server,
+			group,
+			user
+		};
+
+		kind_t kind{};
+		std::string name{};
+		std::string parent{};
+		std::uint32_t weight{};
+		std::size_t sessions{};
+		rate::type inbound_rate{};
+		rate::type outbound_rate{};
+		rate::type inbound_share{rate::unlimited};
+		rate::type outbound_share{rate::unlimited};
+
+		template <typename Archive>
+		void serialize(Archive &ar)
+		{
+			ar(
+				FZ_NVP(kind), FZ_NVP(name), FZ_NVP(parent), FZ_NVP(weight), FZ_NVP(sessions),
+				FZ_NVP(inbound_rate), FZ_NVP(outbound_rate),
+				FZ_NVP(inbound_share), FZ_NVP(outbound_share)
+			);
+		}
+	};
+
+	class leaf;
+
+	/// \param clock where the current time is taken from. Tests replace it, to control the passing of time.
+	fair_share_scheduler(event_loop &loop, options opts = {}, std::function<monotonic_clock()> clock = &monotonic_clock::now);
+	~fair_share_scheduler() override;
+
+	void set_options(options opts);
+
+	/// Measures the sessions and recomputes the shares right away, as each tick does.
+	/// Together with the clock passed to the constructor, it lets tests drive the scheduler without waiting for its timers.
+	void step();
+
+	/// Drops the shard bound to \p loop. Must be invoked before the loop is destroyed, once none of the sessions running on it is left.
+	void release(event_loop &loop);
+
+	/// \returns the server class first, then each group followed by its users, then the users that don't belong to any group.
+	std::vector<class_stats> get_stats() const;
+
+private:
+	struct node;
+	class shard;
+
+	using nodes = std::map<std::string, std::shared_ptr<node>>;
+
+	std::shared_ptr<node> get_node(nodes &map, const share &s);
+	shard &get_shard(event_loop &loop);
+
+	void operator()(const event_base &ev) override;
+	void on_timer(timer_id id);
+
+	void update();
+
+	mutable fz::mutex mutex_;
+	options opts_;
+	const std::function<monotonic_clock()> clock_;
+
+	timer_id timer_id_{};
+	monotonic_clock last_update_;
+
+	nodes groups_;
+	nodes users_;
+	std::unordered_map<event_loop *, std::unique_ptr<shard>> shards_;
+
+	std::vector<class_stats> stats_;
+};
+
+/// \brief The session's handle into the scheduler.
+///
+/// The session must report the amount of data it transfers, and the scheduler sets the limits of the session's rate_limiter accordingly.
+/// All methods must be invoked from within the event loop the leaf was created for.
+class fair_share_scheduler::leaf
+{
+public:
+	leaf(fair_share_scheduler &scheduler, event_loop &loop, rate_limiter &limiter);
+	~leaf();
+
+	leaf(const leaf &) = delete;
+	leaf &operator=(const leaf &) = delete;
+
+	/// Makes the session belong to the given user class, in turn belonging to the given group class.
+	/// If the group name is empty, the user class belongs directly to the server.
+	/// The session limits keep being applied, on top of the share the session gets.
+	void set_class(share user, share group, rate::type session_inbound_limit, rate::type session_outbound_limit);
+
+	void add_transferred(direction::type d, std::int64_t amount)
+	{
+		transferred_[d].fetch_add(amount, std::memory_order_relaxed);
+	}
+
+private:
+	friend shard;
+
+	void tick(std::int64_t elapsed_ms);
+	void apply();
+	void leave();
+
+	fair_share_scheduler &scheduler_;
+	shard &shard_;
+	rate_limiter &limiter_;
+	std::size_t index_{};
+
+	std::shared_ptr<node> user_;
+
+	rate::type session_limits_[2]{rate::unlimited, rate::unlimited};
+	rate::type applied_limits_[2]{rate::unlimited, rate::unlimited};
+	bool capped_[2]{};
+	bool saturated_[2]{};
+	std::int64_t demand_[2]{};
+
+	std::atomic<std::int64_t> transferred_[2]{};
+};
+
+}
+
+#endif // FZ_RATE_LIMIT_FAIR_SHARE_SCHEDULER_HPP
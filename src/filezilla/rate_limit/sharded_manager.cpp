@@ -0,0 +1,76 @@
+#include <algorithm>
+
+#include "sharded_manager.hpp"
+#include "shared_limiter.hpp"
+
+namespace fz::rate_limit {
+
+sharded_manager::sharded_manager(event_loop &loop, options opts)
+	: event_handler(loop)
+	, opts_(std::move(opts))
+	, last_reconcile_(monotonic_clock::now())
+{
+	add_timer(opts_.reconcile_interval(), false);
+}
+
+sharded_manager::~sharded_manager()
+{
+	remove_handler();
+}
+
+rate_limit_manager &sharded_manager::get(event_loop &loop)
+{
+	scoped_lock lock(mutex_);
+
+	auto &m = managers_[&loop];
+	if (!m)
+		m = std::make_unique<rate_limit_manager>(loop);
+
+	return *m;
+}
+
+void sharded_manager::release(event_loop &loop)
+{
+	scoped_lock lock(mutex_);
+
+	managers_.erase(&loop);
+}
+
+void sharded_manager::add(shared_limiter &l)
+{
+	scoped_lock lock(mutex_);
+
+	limiters_.push_back(&l);
+}
+
+void sharded_manager::remove(shared_limiter &l)
+{
+	scoped_lock lock(mutex_);
+
+	if (auto it = std::find(limiters_.begin(), limiters_.end(), &l); it != limiters_.end()) {
+		*it = limiters_.back();
+		limiters_.pop_back();
+	}
+}
+
+void sharded_manager::operator()(const event_base &ev)
+{
+	fz::dispatch<timer_event>(ev, this, &sharded_manager::on_timer);
+}
+
+void sharded_manager::on_timer(timer_id)
+{
+	scoped_lock lock(mutex_);
+
+	auto now = monotonic_clock::now();
+	auto elapsed = (now - last_reconcile_).get_milliseconds();
+	if (elapsed <= 0)
+		return;
+
+	last_reconcile_ = now;
+
+	for (auto l: limiters_)
+		l->reconcile(elapsed);
+}
+
+}
@@ -0,0 +1,65 @@
+#ifndef FZ_RATE_LIMIT_SHARDED_MANAGER_HPP
+#define FZ_RATE_LIMIT_SHARDED_MANAGER_HPP
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <libfilezilla/event_handler.hpp>
+#include <libfilezilla/mutex.hpp>
+#include <libfilezilla/rate_limiter.hpp>
+
+#include "../util/options.hpp"
+
+namespace fz::rate_limit {
+
+class shared_limiter;
+
+/// \brief Keeps one rate_limit_manager per event loop.
+///
+/// A rate_limit_manager refills all of its limiters from the loop it runs on, locking each of them in turn:
+/// with thousands of limited sessions spread among many loops, a single manager becomes a hotspot and the refills get bursty.
+/// Here each loop gets its own manager, so that the limiters of the sessions are refilled by the same loop the sessions run on.
+///
+/// The limits shared by sessions on different loops are handled by shared_limiter objects, which the sharded_manager reconciles periodically.
+class sharded_manager: private event_handler
+{
+public:
+	struct options: util::options<options, sharded_manager>
+	{
+		/// How often the shared limiters move the unused part of the limits to the loops that need more.
+		opt<duration> reconcile_interval = o(duration::from_milliseconds(250));
+
+		options() {}
+	};
+
+	sharded_manager(event_loop &loop, options opts = {});
+	~sharded_manager() override;
+
+	/// \returns the manager for the given loop. It lives as long as the sharded_manager does.
+	rate_limit_manager &get(event_loop &loop);
+
+	/// Drops the manager of \p loop. Must be invoked before the loop is destroyed, once none of the sessions running on it is left.
+	/// The shared limiters' rate_limiter for that loop are left detached from any manager.
+	void release(event_loop &loop);
+
+private:
+	friend shared_limiter;
+
+	void add(shared_limiter &l);
+	void remove(shared_limiter &l);
+
+	void operator()(const event_base &ev) override;
+	void on_timer(timer_id id);
+
+	fz::mutex mutex_;
+	options opts_;
+	monotonic_clock last_reconcile_;
+
+	std::unordered_map<event_loop *, std::unique_ptr<rate_limit_manager>> managers_;
+	std::vector<shared_limiter *> limiters_;
+};
+
+}
+
+#endif // FZ_RATE_LIMIT_SHARDED_MANAGER_HPP
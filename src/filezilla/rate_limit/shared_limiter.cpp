@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <numeric>
+
+#include "shared_limiter.hpp"
+
+namespace fz::rate_limit {
+
+namespace {
+
+// Below this, a loop would hardly be able to make any progress at all.
+constexpr rate::type min_quota = 1024;
+
+constexpr direction::type directions[] = { direction::inbound, direction::outbound };
+
+}
+
+shared_limiter::shared_limiter(sharded_manager &manager)
+	: manager_(manager)
+{
+	manager_.add(*this);
+}
+
+shared_limiter::~shared_limiter()
+{
+	manager_.remove(*this);
+}
+
+void shared_limiter::set_limits(rate::type inbound, rate::type outbound)
+{
+	scoped_lock lock(mutex_);
+
+	limits_[direction::inbound] = inbound;
+	limits_[direction::outbound] = outbound;
+
+	split_evenly();
+	apply();
+}
+
+rate::type shared_limiter::limit(direction::type d) const
+{
+	scoped_lock lock(mutex_);
+
+	return limits_[d];
+}
+
+shared_limiter::shard &shared_limiter::get(event_loop &loop)
+{
+	// The sharded_manager is locked before the shared_limiter when reconciling, hence get hold of the loop's manager first.
+	auto &manager = manager_.get(loop);
+
+	scoped_lock lock(mutex_);
+
+	for (auto &[l, s]: shards_) {
+		if (l == &loop)
+			return *s;
+	}
+
+	auto &s = *shards_.emplace_back(&loop, std::unique_ptr<shard>(new shard(manager))).second;
+
+	split_evenly();
+	apply();
+
+	return s;
+}
+
+void shared_limiter::split_evenly()
+{
+	for (auto d: directions) {
+		auto quota = limits_[d] == rate::unlimited || shards_.empty()
+			? limits_[d]
+			: std::max(limits_[d] / shards_.size(), std::min(min_quota, limits_[d]));
+
+		for (auto &[_, s]: shards_)
+			s->quotas_[d] = quota;
+	}
+}
+
+void shared_limiter::apply()
+{
+	for (auto &[_, s]: shards_)
+		s->limiter_.set_limits(s->quotas_[direction::inbound], s->quotas_[direction::outbound]);
+}
+
+void shared_limiter::reconcile(std::int64_t elapsed_ms)
+{
+	scoped_lock lock(mutex_);
+
+	auto const n = shards_.size();
+
+	std::vector<rate::type> used(n);
+	std::vector<rate::type> wanted(n);
+	std::vector<std::size_t> order(n);
+
+	bool changed = false;
+
+	for (auto d: directions) {
+		for (std::size_t i = 0; i < n; ++i)
+			used[i] = rate::type(std::max<std::int64_t>(shards_[i].second->transferred_[d].exchange(0, std::memory_order_relaxed), 0) * 1000 / elapsed_ms);
+
+		auto const limit = limits_[d];
+
+		if (n < 2 || limit == rate::unlimited)
+			continue;
+
+		// Each loop keeps a floor, so that a session starting to transfer on an otherwise idle loop can make itself noticed.
+		auto const floor = std::max(limit / (8 * n), std::min(min_quota, limit / n));
+		auto remaining = limit - floor * n;
+
+		// The loops that used up their quota want as much as they can get, the others want what they used plus some headroom.
+		for (std::size_t i = 0; i < n; ++i) {
+			auto quota = shards_[i].second->quotas_[d];
+			auto headroom = used[i] + used[i] / 4;
+
+			if (used[i] >= quota - quota / 10)
+				wanted[i] = rate::unlimited;
+			else
+				wanted[i] = headroom > floor ? headroom - floor : 0;
+		}
+
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+			return wanted[a] < wanted[b];
+		});
+
+		// Max-min fairness: the loops that want less than an even part get what they want, the others split evenly what's left.
+		std::vector<rate::type> allocated(n);
+		for (std::size_t k = 0; k < n; ++k) {
+			auto i = order[k];
+
+			allocated[i] = std::min(wanted[i], remaining / (n - k));
+			remaining -= allocated[i];
+		}
+
+		for (std::size_t i = 0; i < n; ++i) {
+			auto quota = floor + allocated[i] + remaining / n;
+
+			if (quota != shards_[i].second->quotas_[d]) {
+				shards_[i].second->quotas_[d] = quota;
+				changed = true;
+			}
+		}
+	}
+
+	if (changed)
+		apply();
+}
+
+}
@@ -0,0 +1,75 @@
+#ifndef FZ_RATE_LIMIT_SHARED_LIMITER_HPP
+#define FZ_RATE_LIMIT_SHARED_LIMITER_HPP
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "sharded_manager.hpp"
+
+namespace fz::rate_limit {
+
+/// \brief Inbound and outbound limits shared by sessions that may run on different event loops.
+///
+/// Each loop gets its own rate_limiter, refilled by that loop's manager, and the limits are split among them.
+/// The sessions report what they transfer, control channel included, by adding to atomic counters.
+/// Periodically the sharded_manager collects the counters and, with the limiter's mutex held,
+/// moves the part of the limits that some loops left unused to the loops that used up all of theirs.
+class shared_limiter
+{
+public:
+	class shard
+	{
+	public:
+		rate_limiter &limiter()
+		{
+			return limiter_;
+		}
+
+		void add_transferred(direction::type d, std::int64_t amount)
+		{
+			transferred_[d].fetch_add(amount, std::memory_order_relaxed);
+		}
+
+	private:
+		friend shared_limiter;
+
+		explicit shard(rate_limit_manager &manager)
+			: limiter_(&manager)
+		{}
+
+		rate_limiter limiter_;
+		std::atomic<std::int64_t> transferred_[2]{};
+		rate::type quotas_[2]{rate::unlimited, rate::unlimited};
+	};
+
+	explicit shared_limiter(sharded_manager &manager);
+	~shared_limiter();
+
+	shared_limiter(const shared_limiter &) = delete;
+	shared_limiter &operator=(const shared_limiter &) = delete;
+
+	void set_limits(rate::type inbound, rate::type outbound);
+	rate::type limit(direction::type d) const;
+
+	/// \returns the shard for the given loop. It lives as long as the shared_limiter does.
+	shard &get(event_loop &loop);
+
+	/// Moves the unused part of the limits to the loops that need more, given what they transferred in the last \p elapsed_ms milliseconds.
+	/// Invoked periodically by the sharded_manager.
+	void reconcile(std::int64_t elapsed_ms);
+
+private:
+	void split_evenly();
+	void apply();
+
+	sharded_manager &manager_;
+
+	mutable fz::mutex mutex_;
+	rate::type limits_[2]{rate::unlimited, rate::unlimited};
+	std::vector<std::pair<event_loop *, std::unique_ptr<shard>>> shards_;
+};
+
+}
+
+#endif // FZ_RATE_LIMIT_SHARED_LIMITER_HPP
@@ -11,7 +11,7 @@ namespace fz::rmp {
 template <typename AnyMessage>
 engine<AnyMessage>::server::server(fz::tcp::server::context &context, dispatcher &dispatcher, logger_interface &logger)
 	: tcp::server::delegate<server>(tcp_server_)
-	, tcp_server_(context, logger, *this)
+	, tcp_server_(context, logger, *this, "admin")
 	, dispatcher_(dispatcher)
 	, logger_(logger)
 {}
@@ -116,8 +116,10 @@ native_string_view argv_input_archive::argv_loader::name() const
 
 	paths = fzT("<command line>");
 
-	for (const auto &f: xml_files_list_)
-		paths.append(fzT(";")).append(f.file_path);
+	for (const auto &f: xml_files_list_) {
+		if (!f.file_path.empty())
+			paths.append(fzT(";")).append(f.file_path);
+	}
 
 	return paths;
 }
@@ -133,6 +135,10 @@ xml_input_archive::error_t argv_input_archive::argv_loader::operator ()(pugi::xm
 		pugi::xml_parse_result result;
 
 		for (auto &file: xml_files_list_) {
+			// The caller has got the values from elsewhere.
+			if (file.file_path.empty())
+				continue;
+
 			native_string backup;
 			bool verify_error_ignored{};
 			xml_input_archive::file_loader file_loader(file.file_path);
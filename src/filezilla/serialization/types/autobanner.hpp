@@ -23,7 +23,12 @@ void serialize(Archive &ar, struct authentication::autobanner::options &o)
 		value_info(optional_nvp(o.max_login_failures(),
 				   "login_failure_time_window"),
 				   "The number of login attempts that are allowed to fail, within the time window specified by the parameter [login_failures_time_window]. "
-				   "The value 0 disables this mechanism.")
+				   "The value 0 disables this mechanism."),
+
+		value_info(optional_nvp(o.max_tracked_addresses(),
+				   "max_tracked_addresses"),
+				   "The maximum number of addresses, per IP family, whose failed logins are tracked. "
+				   "Beyond this number, the least recently seen addresses are forgotten.")
 	);
 }
 
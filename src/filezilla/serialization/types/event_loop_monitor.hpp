@@ -0,0 +1,29 @@
+#ifndef FZ_SERIALIZATION_TYPES_EVENT_LOOP_MONITOR_HPP
+#define FZ_SERIALIZATION_TYPES_EVENT_LOOP_MONITOR_HPP
+
+#include "optional.hpp"
+#include "time.hpp"
+#include "../../event_loop_monitor.hpp"
+
+namespace fz::serialization {
+
+template <typename Archive>
+void serialize(Archive &ar, event_loop_monitor::options &o)
+{
+	using namespace serialization;
+
+	ar(
+		value_info(optional_nvp(o.probe_interval(),
+				   "probe_interval"),
+				   "How often, in milliseconds, the scheduling lag of the event loops is measured."),
+
+		value_info(optional_nvp(o.stall_threshold(),
+				   "stall_threshold"),
+				   "Dispatches of events to their handlers that take longer than this many milliseconds are logged, together with the handler and the session. "
+				   "The value 0 disables the logging.")
+	);
+}
+
+}
+
+#endif // FZ_SERIALIZATION_TYPES_EVENT_LOOP_MONITOR_HPP
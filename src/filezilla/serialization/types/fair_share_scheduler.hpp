@@ -0,0 +1,34 @@
+#ifndef FZ_SERIALIZATION_TYPES_FAIR_SHARE_SCHEDULER_HPP
+#define FZ_SERIALIZATION_TYPES_FAIR_SHARE_SCHEDULER_HPP
+
+#include "optional.hpp"
+#include "time.hpp"
+#include "../../rate_limit/fair_share_scheduler.hpp"
+
+namespace fz::serialization {
+
+template <typename Archive>
+void serialize(Archive &ar, rate_limit::fair_share_scheduler::options &o)
+{
+	using namespace serialization;
+
+	ar(
+		value_info(optional_nvp(with_unlimited{o.inbound_capacity(), rate::unlimited},
+				   "inbound_capacity"),
+				   "The inbound bandwidth, in bytes per second, to be shared among groups, users and sessions according to their weights. "
+				   "Defaults to unlimited, meaning that no sharing happens."),
+
+		value_info(optional_nvp(with_unlimited{o.outbound_capacity(), rate::unlimited},
+				   "outbound_capacity"),
+				   "The outbound bandwidth, in bytes per second, to be shared among groups, users and sessions according to their weights. "
+				   "Defaults to unlimited, meaning that no sharing happens."),
+
+		value_info(optional_nvp(o.tick(),
+				   "tick"),
+				   "How often, in milliseconds, the bandwidth usage is measured and the shares are recomputed.")
+	);
+}
+
+}
+
+#endif // FZ_SERIALIZATION_TYPES_FAIR_SHARE_SCHEDULER_HPP
@@ -0,0 +1,32 @@
+#ifndef FZ_SERIALIZATION_TYPES_HOSTNAME_CACHE_HPP
+#define FZ_SERIALIZATION_TYPES_HOSTNAME_CACHE_HPP
+
+#include "optional.hpp"
+#include "time.hpp"
+#include "../../tcp/hostname_cache.hpp"
+
+namespace fz::serialization {
+
+template <typename Archive>
+void serialize(Archive &ar, tcp::hostname_cache::options &o)
+{
+	using namespace serialization;
+
+	ar(
+		value_info(optional_nvp(o.refresh_interval(),
+				   "refresh_interval"),
+				   "How often, in milliseconds, the addresses of the resolved hostnames are looked up again."),
+
+		value_info(optional_nvp(o.retry_interval(),
+				   "retry_interval"),
+				   "After how many milliseconds a failed lookup is attempted again. Meanwhile, the last known address keeps being used."),
+
+		value_info(optional_nvp(o.expiry_interval(),
+				   "expiry_interval"),
+				   "Hostnames that haven't been needed for this many milliseconds are forgotten.")
+	);
+}
+
+}
+
+#endif // FZ_SERIALIZATION_TYPES_HOSTNAME_CACHE_HPP
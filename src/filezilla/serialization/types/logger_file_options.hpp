@@ -37,7 +37,19 @@ void serialize(Archive &ar, logger::file::options &o) {
 
 		value_info(optional_nvp(o.date_in_name(),
 				   "date_in_name"),
-				   "Append the date of the log file to its name when rotating, before any suffix the name might have.")
+				   "Append the date of the log file to its name when rotating, before any suffix the name might have."),
+
+		value_info(optional_nvp(o.async_queue_size(),
+				   "async_queue_size"),
+				   "If greater than 0, log lines are queued, up to this many, and written out in batches by a dedicated thread. Default is 0, meaning log lines are written by the threads that produce them."),
+
+		value_info(optional_nvp(o.overflow_policy(),
+				   "overflow_policy"),
+				   "What to do with a log line when the queue is full: wait for room (0), drop it (1) or drop it only if it's a debug one (2)."),
+
+		value_info(optional_nvp(o.compress_rotated(),
+				   "compress_rotated"),
+				   "Compress the rotated files with gzip in the background, along with an index that allows to quickly retrieve the logs of a session. Default is false.")
 	);
 }
 
@@ -0,0 +1,29 @@
+#ifndef FZ_SERIALIZATION_TYPES_VERIFIED_CREDENTIALS_CACHE_HPP
+#define FZ_SERIALIZATION_TYPES_VERIFIED_CREDENTIALS_CACHE_HPP
+
+#include "optional.hpp"
+#include "time.hpp"
+#include "../../authentication/verified_credentials_cache.hpp"
+
+namespace fz::serialization {
+
+template <typename Archive>
+void serialize(Archive &ar, authentication::verified_credentials_cache::options &o)
+{
+	using namespace serialization;
+
+	ar(
+		value_info(optional_nvp(o.capacity(),
+				   "capacity"),
+				   "The maximum number of successful password verifications to remember. "
+				   "The value 0, the default, disables the cache, so that each login goes through a full verification."),
+
+		value_info(optional_nvp(o.ttl(),
+				   "ttl"),
+				   "For how long, in milliseconds, a successful password verification is remembered.")
+	);
+}
+
+}
+
+#endif // FZ_SERIALIZATION_TYPES_VERIFIED_CREDENTIALS_CACHE_HPP
@@ -34,7 +34,11 @@ void serialize(Archive &ar, webui::server::options &o)
 
 		value_info(optional_nvp(o.tls,
 								"tls"),
-								"TLS certificate cata")
+								"TLS certificate cata"),
+
+		value_info(optional_nvp(o.expose_metrics,
+								"expose_metrics"),
+								"Whether the metrics of the server are exposed, in the Prometheus text format, at /metrics. Defaults to false.")
 	);
 }
 
@@ -0,0 +1,178 @@
+#include <algorithm>
+
+#include <libfilezilla/encode.hpp>
+#include <libfilezilla/socket.hpp>
+#include <libfilezilla/util.hpp>
+
+#include "hostname_cache.hpp"
+
+namespace fz::tcp {
+
+hostname_cache::hostname_cache(thread_pool &pool, event_loop &loop, logger_interface &logger, options opts, std::function<monotonic_clock()> clock)
+	: event_handler(loop)
+	, pool_(pool)
+	, logger_(logger, "Hostname Cache")
+	, clock_(std::move(clock))
+{
+	set_options(std::move(opts));
+}
+
+hostname_cache::~hostname_cache()
+{
+	remove_handler();
+}
+
+void hostname_cache::set_options(options opts)
+{
+	scoped_lock lock(mutex_);
+
+	opts_ = std::move(opts);
+
+	stop_timer(refresh_timer_id_);
+	refresh_timer_id_ = add_timer(std::min(opts_.refresh_interval(), opts_.retry_interval()), false);
+}
+
+std::optional<std::string> hostname_cache::lookup(const native_string &host, address_type family, event_handler &handler)
+{
+	// Literal addresses need no lookup at all.
+	if (auto type = get_address_type(host); type != address_type::unknown && (family == address_type::unknown || type == family))
+		return fz::to_utf8(host);
+
+	scoped_lock lock(mutex_);
+
+	auto k = key{host, family};
+	auto &e = entries_[k];
+	auto now = clock_();
+
+	e.last_used = now;
+
+	if (!e.ip.empty()) {
+		if (now >= e.refresh_at && !e.lookup_in_progress)
+			start_lookup(k, e);
+
+		return e.ip;
+	}
+
+	if (std::find(e.waiters.begin(), e.waiters.end(), &handler) == e.waiters.end())
+		e.waiters.push_back(&handler);
+
+	if (!e.lookup_in_progress)
+		start_lookup(k, e);
+
+	return std::nullopt;
+}
+
+void hostname_cache::cancel(event_handler &handler)
+{
+	scoped_lock lock(mutex_);
+
+	for (auto &[k, e]: entries_)
+		e.waiters.erase(std::remove(e.waiters.begin(), e.waiters.end(), &handler), e.waiters.end());
+}
+
+void hostname_cache::start_lookup(const key &k, entry &e)
+{
+	if (!e.lookup)
+		e.lookup = std::make_unique<hostname_lookup>(pool_, *this);
+
+	logger_.log(logmsg::debug_info, L"Looking up host '%s'.", k.first);
+
+	if (!e.lookup->lookup(k.first, k.second)) {
+		logger_.log(logmsg::error, L"Host '%s' lookup failed.", k.first);
+
+		e.refresh_at = clock_() + opts_.retry_interval();
+		notify_waiters(e);
+		return;
+	}
+
+	e.lookup_in_progress = true;
+}
+
+void hostname_cache::notify_waiters(entry &e)
+{
+	std::optional<std::string> result;
+	if (!e.ip.empty())
+		result = e.ip;
+
+	for (auto h: e.waiters)
+		h->send_event<result_event>(result);
+
+	e.waiters.clear();
+}
+
+void hostname_cache::operator()(const event_base &ev)
+{
+	fz::dispatch<
+		hostname_lookup_event,
+		timer_event
+	>(ev, this,
+		&hostname_cache::on_hostname_lookup_event,
+		&hostname_cache::on_timer_event
+	);
+}
+
+void hostname_cache::on_hostname_lookup_event(hostname_lookup *source, int error, const std::vector<std::string> &ips)
+{
+	scoped_lock lock(mutex_);
+
+	auto it = std::find_if(entries_.begin(), entries_.end(), [source](const auto &p) {
+		return p.second.lookup.get() == source;
+	});
+
+	if (it == entries_.end())
+		return;
+
+	auto &[k, e] = *it;
+	auto now = clock_();
+
+	e.lookup_in_progress = false;
+
+	if (!error && !ips.empty()) {
+		if (e.ip != ips[0])
+			logger_.log(logmsg::debug_info, L"Host '%s' resolves to %s.", k.first, ips[0]);
+
+		e.ip = ips[0];
+		e.refresh_at = now + opts_.refresh_interval();
+	}
+	else {
+		auto reason = error ? socket_error_description(error) : std::string("no IPs returned");
+
+		if (e.ip.empty())
+			logger_.log(logmsg::error, L"Host '%s' lookup failed. Reason: %s.", k.first, reason);
+		else
+			logger_.log(logmsg::debug_warning, L"Host '%s' lookup failed. Reason: %s. Keeping last known address %s.", k.first, reason, e.ip);
+
+		e.refresh_at = now + opts_.retry_interval();
+	}
+
+	notify_waiters(e);
+}
+
+void hostname_cache::on_timer_event(timer_id)
+{
+	scoped_lock lock(mutex_);
+
+	auto now = clock_();
+
+	for (auto it = entries_.begin(); it != entries_.end();) {
+		auto &[k, e] = *it;
+
+		if (e.lookup_in_progress) {
+			++it;
+			continue;
+		}
+
+		if (now - e.last_used >= opts_.expiry_interval() && e.waiters.empty()) {
+			logger_.log(logmsg::debug_verbose, L"Host '%s' hasn't been needed for a while, forgetting about it.", k.first);
+			it = entries_.erase(it);
+			continue;
+		}
+
+		if (now >= e.refresh_at)
+			start_lookup(k, e);
+
+		++it;
+	}
+}
+
+}
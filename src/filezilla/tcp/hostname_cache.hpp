@@ -0,0 +1,93 @@
+#ifndef FZ_TCP_HOSTNAME_CACHE_HPP
+#define FZ_TCP_HOSTNAME_CACHE_HPP
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <libfilezilla/event_handler.hpp>
+#include <libfilezilla/hostname_lookup.hpp>
+#include <libfilezilla/iputils.hpp>
+#include <libfilezilla/mutex.hpp>
+#include <libfilezilla/thread_pool.hpp>
+
+#include "../logger/modularized.hpp"
+#include "../util/options.hpp"
+
+namespace fz::tcp {
+
+/// \brief Resolves hostnames asynchronously and keeps the results in memory, so that
+/// the many sessions that need the same name don't each have to wait for a DNS round trip.
+///
+/// Entries are refreshed in the background, once refresh_interval has elapsed.
+/// If a refresh fails, the last known good address keeps being served and another attempt is made after retry_interval.
+/// Entries that nobody asked for during the last expiry_interval are dropped.
+///
+/// The system resolver doesn't expose the records' TTL, hence the refresh interval is what bounds their lifetime.
+class hostname_cache: private event_handler
+{
+public:
+	struct options: util::options<options, hostname_cache>
+	{
+		opt<duration> refresh_interval = o(duration::from_minutes(1));
+		opt<duration> retry_interval   = o(duration::from_seconds(5));
+		opt<duration> expiry_interval  = o(duration::from_minutes(30));
+
+		options(){}
+	};
+
+	/// Sent to the handlers waiting for a name that wasn't in the cache yet.
+	/// The address is nullopt if the lookup failed.
+	using result_event = simple_event<hostname_cache, std::optional<std::string> /*ip*/>;
+
+	/// \param clock where the current time is taken from. Tests replace it, to control the passing of time.
+	hostname_cache(thread_pool &pool, event_loop &loop, logger_interface &logger, options opts = {}, std::function<monotonic_clock()> clock = &monotonic_clock::now);
+	~hostname_cache() override;
+
+	void set_options(options opts);
+
+	/// \returns the address \p host resolves to for the given \p family, if it is already known.
+	/// Otherwise a lookup is started and \p handler will receive a result_event when it completes.
+	std::optional<std::string> lookup(const native_string &host, address_type family, event_handler &handler);
+
+	/// Stops delivering results to \p handler. Must be called before \p handler is destroyed.
+	void cancel(event_handler &handler);
+
+private:
+	struct entry
+	{
+		std::unique_ptr<hostname_lookup> lookup;
+		bool lookup_in_progress{};
+
+		std::string ip;
+		monotonic_clock refresh_at;
+		monotonic_clock last_used;
+
+		std::vector<event_handler *> waiters;
+	};
+
+	using key = std::pair<native_string, address_type>;
+	using entries = std::map<key, entry>;
+
+	void start_lookup(const key &k, entry &e);
+	void notify_waiters(entry &e);
+
+	void operator()(const event_base &ev) override;
+	void on_hostname_lookup_event(hostname_lookup *source, int error, const std::vector<std::string> &ips);
+	void on_timer_event(timer_id id);
+
+	thread_pool &pool_;
+	logger::modularized logger_;
+	const std::function<monotonic_clock()> clock_;
+
+	mutable fz::mutex mutex_;
+	options opts_;
+	entries entries_;
+	timer_id refresh_timer_id_{};
+};
+
+}
+
+#endif // FZ_TCP_HOSTNAME_CACHE_HPP
@@ -3,6 +3,7 @@
 #include "../remove_event.hpp"
 #include "../util/parser.hpp"
 #include "../logger/type.hpp"
+#include "../event_loop_monitor.hpp"
 
 fz::tcp::listener::listener(fz::thread_pool &pool,
 							event_loop &loop,
@@ -124,6 +125,7 @@ void fz::tcp::listener::stop()
 }
 
 void fz::tcp::listener::operator ()(const fz::event_base &ev) {
+	event_loop_monitor::dispatch_scope monitored(*this, ev);
 
 	{
 		fz::scoped_lock lock(mutex_);
@@ -4,13 +4,16 @@
 
 namespace fz::tcp {
 
-server::server(server::context &context, logger_interface &logger, session::factory &session_factory)
+server::server(server::context &context, logger_interface &logger, session::factory &session_factory, std::string_view name)
 	: event_handler(context.loop())
 	, context_(context)
 	, logger_(logger)
 	, session_factory_(session_factory)
 	, listeners_loop_(context.pool())
+	, listeners_loop_probe_(context.monitor() ? std::make_unique<event_loop_monitor::probe>(*context.monitor(), listeners_loop_, "listeners") : nullptr)
 	, listeners_(context.pool(), listeners_loop_, *this, logger_, session_factory_, session_factory_)
+	, accepted_metric_(metrics::registry::global().get_counter("fz_tcp_accepted_connections_total", "Connections accepted by the listeners.", {{"server", std::string(name)}}))
+	, active_sessions_metric_(metrics::registry::global().get_gauge("fz_tcp_active_sessions", "Sessions currently active.", {{"server", std::string(name)}}))
 {
 }
 
@@ -80,6 +83,7 @@ bool server::stop(bool destroy_all_sessions)
 	if (destroy_all_sessions) {
 		logger_.log_u(logmsg::debug_debug, L"Destroying sessions.");
 		sessions_to_destroy = std::move(sessions_);
+		active_sessions_metric_.sub(std::int64_t(sessions_to_destroy.size()));
 	}
 
 	return true;
@@ -92,6 +96,8 @@ bool server::is_running() const
 
 void server::operator ()(const event_base &ev)
 {
+	event_loop_monitor::dispatch_scope monitored(*this, ev);
+
 	fz::dispatch<
 		tcp::listener::connected_event,
 		typename session::ended_event
@@ -110,10 +116,13 @@ void server::on_connected_event(tcp::listener &listener)
 		auto id = context_.next_session_id();
 		auto session = session_factory_.make_session(*this, id, std::move(socket), listener.get_user_data(), error);
 
+		accepted_metric_.add();
+
 		if (session) {
 			scoped_lock lock(mutex_);
 			sessions_.insert({id, std::move(session)});
 			num_sessions_ += 1;
+			active_sessions_metric_.add();
 		}
 
 		// Don't starve the event loop
@@ -139,6 +148,8 @@ void server::on_session_ended_event(session::id id, const channel::error_type &e
 	if (!extracted)
 		return;
 
+	active_sessions_metric_.sub();
+
 	if (!error)
 		logger_.log_u(logmsg::status, "Session %d ended gracefully.", id);
 	else
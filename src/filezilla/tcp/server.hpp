@@ -3,6 +3,7 @@
 
 #include <unordered_map>
 #include <set>
+#include <string_view>
 
 #include <libfilezilla/event_handler.hpp>
 #include <libfilezilla/logger.hpp>
@@ -10,6 +11,9 @@
 #include "listener.hpp"
 #include "session.hpp"
 
+#include "../event_loop_monitor.hpp"
+#include "../metrics/registry.hpp"
+
 namespace fz::tcp {
 
 class server: protected event_handler
@@ -20,7 +24,8 @@ public:
 	template <typename Derived>
 	class delegate;
 
-	server(server::context &context, logger_interface &logger, session::factory &session_factory);
+	/// \param name the protocol the server speaks, like "ftp" or "webui". Its metrics are labelled with it.
+	server(server::context &context, logger_interface &logger, session::factory &session_factory, std::string_view name);
 	~server() override;
 
 	bool start();
@@ -69,11 +74,15 @@ private:
 	logger_interface &logger_;
 	session::factory &session_factory_;
 	event_loop listeners_loop_;
+	std::unique_ptr<event_loop_monitor::probe> listeners_loop_probe_;
 
 	listeners_manager listeners_;
 
 	std::unordered_map<session::id, std::unique_ptr<session>> sessions_{};
 	std::atomic<std::size_t> num_sessions_{};
+
+	metrics::counter &accepted_metric_;
+	metrics::gauge &active_sessions_metric_;
 };
 
 template <typename Func, std::enable_if_t<std::is_invocable_v<Func, session&>>*>
@@ -136,10 +145,11 @@ struct has_get_user_data<T, std::void_t<decltype(std::declval<T>().get_user_data
 
 class server::context {
 public:
-	context(thread_pool &pool, event_loop &loop) : pool_(pool), loop_(loop) {}
+	context(thread_pool &pool, event_loop &loop, event_loop_monitor *monitor = nullptr) : pool_(pool), loop_(loop), monitor_(monitor) {}
 
 	thread_pool& pool() const { return pool_; }
 	event_loop& loop() const { return loop_; }
+	event_loop_monitor *monitor() const { return monitor_; }
 
 	session::id next_session_id() {
 		scoped_lock lock(mutex_);
@@ -149,6 +159,7 @@ public:
 private:
 	thread_pool &pool_;
 	event_loop &loop_;
+	event_loop_monitor *monitor_;
 	session::id last_session_id_{};
 	fz::mutex mutex_;
 };
@@ -1,9 +1,51 @@
 #include "engine.hpp"
 #include "backends/local_filesys.hpp"
 #include "../strresult.hpp"
+#include "../metrics/registry.hpp"
 
 namespace fz::tvfs {
 
+namespace {
+
+enum class operation
+{
+	open_file,
+	get_entries,
+	get_entry,
+	make_directory,
+	set_mtime,
+	remove_file,
+	remove_directory,
+	remove_entry,
+	rename,
+	set_current_directory,
+
+	count
+};
+
+void count_operation(operation op)
+{
+	static const auto counters = [] {
+		static constexpr const char *names[] = {
+			"open_file", "get_entries", "get_entry", "make_directory", "set_mtime",
+			"remove_file", "remove_directory", "remove_entry", "rename", "set_current_directory"
+		};
+
+		static_assert(std::size(names) == std::size_t(operation::count));
+
+		std::array<metrics::counter *, std::size_t(operation::count)> c{};
+
+		for (std::size_t i = 0; i < c.size(); ++i)
+			c[i] = &metrics::registry::global().get_counter("fz_tvfs_operations_total", "Operations requested to the virtual file systems.", {{"op", names[i]}});
+
+		return c;
+	}();
+
+	counters[std::size_t(op)]->add();
+}
+
+}
+
 result engine::open_file(file_holder &out_file, std::string_view tvfs_path, file::mode mode, int64_t rest)
 {
 	result res = { result::other, FZ_RESULT_RAW(ERROR_TIMEOUT, ETIMEDOUT) };
@@ -13,6 +55,15 @@ result engine::open_file(file_holder &out_file, std::string_view tvfs_path, file
 	return res;
 }
 
+result engine::open_file_at(file_holder &out_file, std::string_view tvfs_path, int64_t offset)
+{
+	result res = { result::other, FZ_RESULT_RAW(ERROR_TIMEOUT, ETIMEDOUT) };
+
+	async_open_file_at(out_file, tvfs_path, offset, timeout_receive_ >> std::tie(res, std::ignore));
+
+	return res;
+}
+
 result engine::get_entries(entries_iterator &out_iterator, std::string_view tvfs_path, traversal_mode mode)
 {
 	result res = { result::other, FZ_RESULT_RAW(ERROR_TIMEOUT, ETIMEDOUT) };
@@ -100,6 +151,21 @@ result engine::set_current_directory(std::string_view tvfs_path)
 
 void engine::async_open_file(file_holder &out_file, std::string_view tvfs_path, file::mode mode, int64_t rest, receiver_handle<completion_event> r)
 {
+	do_async_open_file(out_file, tvfs_path, mode, rest, true, std::move(r));
+}
+
+void engine::async_open_file_at(file_holder &out_file, std::string_view tvfs_path, int64_t offset, receiver_handle<completion_event> r)
+{
+	if (offset < 0)
+		return r(result{result::invalid}, tvfs_path);
+
+	do_async_open_file(out_file, tvfs_path, file::writing, offset, false, std::move(r));
+}
+
+void engine::do_async_open_file(file_holder &out_file, std::string_view tvfs_path, file::mode mode, int64_t rest, bool truncate, receiver_handle<completion_event> r)
+{
+	count_operation(operation::open_file);
+
 	auto resolved_path = resolve_path(tvfs_path);
 
 	if (!resolved_path)
@@ -120,8 +186,8 @@ void engine::async_open_file(file_holder &out_file, std::string_view tvfs_path,
 	// as order of evaluation is unspecified.
 	// Moving the receiver_handle is safe, because it's used only by async_receive(), which sits on the left side of the
 	// >> operator, which evaluates left-to-right: so first async_receive(r) takes place, then std::move(r).
-	return backend_->open_file(resolved_path.native_path, mode, rest == 0 ? file::empty : file::existing, async_receive(r)
-	>> [this, &out_file, r = std::move(r), path = std::move(resolved_path.tvfs_path), rest, mode](auto res, auto &fd) mutable {
+	return backend_->open_file(resolved_path.native_path, mode, rest == 0 && truncate ? file::empty : file::existing, async_receive(r)
+	>> [this, &out_file, r = std::move(r), path = std::move(resolved_path.tvfs_path), rest, mode, truncate](auto res, auto &fd) mutable {
 		if (!res)
 			return r(res, std::move(path));
 
@@ -141,7 +207,7 @@ void engine::async_open_file(file_holder &out_file, std::string_view tvfs_path,
 
 				||
 
-				((mode == file::mode::writing || mode == file::mode::readwrite) && !out_file->truncate())
+				(truncate && (mode == file::mode::writing || mode == file::mode::readwrite) && !out_file->truncate())
 			) {
 				out_file = {};
 				return r(result{result::other}, path);
@@ -154,6 +220,8 @@ void engine::async_open_file(file_holder &out_file, std::string_view tvfs_path,
 
 void engine::async_get_entries(entries_iterator &out_iterator, std::string_view tvfs_path, traversal_mode mode, receiver_handle<completion_event> r)
 {
+	count_operation(operation::get_entries);
+
 	auto resolved_path = resolve_path(tvfs_path);
 
 	if (!resolved_path)
@@ -164,11 +232,15 @@ void engine::async_get_entries(entries_iterator &out_iterator, std::string_view
 
 void engine::async_get_entry(std::string_view tvfs_path, receiver_handle<entry_result> r)
 {
+	count_operation(operation::get_entry);
+
 	resolve_path(tvfs_path).async_to_entry(backend_, std::move(r));
 }
 
 void engine::async_make_directory(std::string tvfs_path, receiver_handle<completion_event> r)
 {
+	count_operation(operation::make_directory);
+
 	auto resolved_path = resolve_path(tvfs_path);
 
 	if (!resolved_path)
@@ -185,6 +257,8 @@ void engine::async_make_directory(std::string tvfs_path, receiver_handle<complet
 
 void engine::async_set_mtime(std::string_view tvfs_path, entry_time mtime, receiver_handle<entry_result> r)
 {
+	count_operation(operation::set_mtime);
+
 	async_get_entry(tvfs_path, async_receive(r) >> [this, r = std::move(r), mtime](auto res, auto &e) mutable {
 		if (!res)
 			return r(res, std::move(e));
@@ -204,6 +278,8 @@ void engine::async_set_mtime(std::string_view tvfs_path, entry_time mtime, recei
 
 void engine::async_remove_file(std::string_view tvfs_path, receiver_handle<completion_event> r)
 {
+	count_operation(operation::remove_file);
+
 	auto resolved_path = resolve_path(tvfs_path);
 
 	if (!resolved_path)
@@ -220,6 +296,8 @@ void engine::async_remove_file(std::string_view tvfs_path, receiver_handle<compl
 
 void engine::async_remove_directory(std::string_view tvfs_path, bool recursive, receiver_handle<completion_event> r)
 {
+	count_operation(operation::remove_directory);
+
 	auto resolved_path = resolve_path(tvfs_path);
 
 	if (!resolved_path)
@@ -236,6 +314,8 @@ void engine::async_remove_directory(std::string_view tvfs_path, bool recursive,
 
 void engine::async_remove_entry(entry entry, receiver_handle<completion_event> r)
 {
+	count_operation(operation::remove_entry);
+
 	if (!(entry.perms_ & permissions::remove))
 		return r(result{result::noperm}, entry.name());
 
@@ -256,6 +336,8 @@ void engine::async_remove_entry(entry entry, receiver_handle<completion_event> r
 
 void engine::async_rename(std::string_view from, std::string_view to, receiver_handle<completion_event> r)
 {
+	count_operation(operation::rename);
+
 	auto resolved_from = resolve_path(from);
 	auto resolved_to = resolve_path(to);
 
@@ -276,6 +358,8 @@ void engine::async_rename(std::string_view from, std::string_view to, receiver_h
 
 void engine::async_set_current_directory(std::string_view tvfs_path, receiver_handle<simple_completion_event> r)
 {
+	count_operation(operation::set_current_directory);
+
 	resolve_path(tvfs_path).async_to_entry(backend_, async_receive(r) >> [this, r = std::move(r)](result res, entry &e) mutable {
 		if (!res)
 			return r(res);
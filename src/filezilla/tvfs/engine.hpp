@@ -73,6 +73,7 @@ public:
 	void set_open_limits(const open_limits &limits);
 
 	[[nodiscard]] result open_file(file_holder &out_file, std::string_view tvfs_path, file::mode mode, std::int64_t rest);
+	[[nodiscard]] result open_file_at(file_holder &out_file, std::string_view tvfs_path, std::int64_t offset);
 	[[nodiscard]] result get_entries(entries_iterator &out_iterator, std::string_view tvfs_path, traversal_mode mode);
 	[[nodiscard]] std::pair<result, entry> get_entry(std::string_view tvfs_path);
 	[[nodiscard]] std::pair<result, std::string /*canonical path*/> make_directory(std::string tvfs_path);
@@ -84,6 +85,11 @@ public:
 	[[nodiscard]] result set_current_directory(std::string_view tvfs_path);
 
 	void async_open_file(file_holder &out_file, std::string_view tvfs_path, file::mode mode, std::int64_t rest, receiver_handle<completion_event> r);
+
+	/// Opens the existing file at \p tvfs_path for writing at \p offset. Unlike opening it for writing with a rest,
+	/// nothing is truncated: what's there before and after \p offset is left as it is, so that parts of the same file
+	/// can be written independently of each other, through different handles.
+	void async_open_file_at(file_holder &out_file, std::string_view tvfs_path, std::int64_t offset, receiver_handle<completion_event> r);
 	void async_get_entries(entries_iterator &out_iterator, std::string_view tvfs_path, traversal_mode mode, receiver_handle<completion_event> r);
 	void async_get_entry(std::string_view tvfs_path, receiver_handle<entry_result> r);
 	void async_make_directory(std::string tvfs_path, receiver_handle<completion_event> r);
@@ -97,6 +103,7 @@ public:
 	[[nodiscard]] const util::fs::absolute_unix_path &get_current_directory() const;
 
 private:
+	void do_async_open_file(file_holder &out_file, std::string_view tvfs_path, file::mode mode, std::int64_t rest, bool truncate, receiver_handle<completion_event> r);
 	resolved_path resolve_path(std::string_view path);
 	void close_file(file_holder &file);
 
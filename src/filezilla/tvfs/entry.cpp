@@ -286,6 +286,11 @@ void entries_iterator::async_next_to_entry(receiver_handle<entry_result> r)
 
 void entries_iterator::async_load_next_entry(receiver_handle<> r)
 {
+	if (entries_) {
+		next_entry_ = entries_pos_ < entries_->size() ? std::move((*entries_)[entries_pos_++]) : entry();
+		return r();
+	}
+
 	auto iterate_over_mount_nodes = [this](receiver_handle<> r) {
 		if (mount_nodes_it_ == resolved_.node.children->cend()) {
 			next_entry_ = {};
@@ -343,8 +348,27 @@ void entries_iterator::async_next(receiver_handle<entry_result> r)
 	});
 }
 
+entries_iterator entries_iterator::from_entries(std::vector<entry> entries, std::string tvfs_path, datetime mtime)
+{
+	entries_iterator it;
+
+	it.resolved_.tvfs_path = std::move(tvfs_path);
+	it.mtime_ = std::move(mtime);
+	it.mode_ = traversal_mode::only_children;
+	it.entries_ = std::move(entries);
+
+	if (!it.entries_->empty()) {
+		it.next_entry_ = std::move(it.entries_->front());
+		it.entries_pos_ = 1;
+	}
+
+	return it;
+}
+
 void entries_iterator::end_iteration()
 {
+	entries_ = {};
+	entries_pos_ = 0;
 	counter_ = {};
 	lf_.end_find_files();
 	next_entry_ = {};
@@ -4,6 +4,7 @@
 #include <string>
 #include <memory>
 #include <optional>
+#include <vector>
 
 #include <libfilezilla/time.hpp>
 #include <libfilezilla/local_filesys.hpp>
@@ -149,6 +150,10 @@ public:
 	entry next();
 	void async_next(receiver_handle<entry_result> r);
 
+	/// \returns an iterator over \p entries, as if they were the children of the directory at \p tvfs_path, last modified at \p mtime.
+	/// For listings that have been put together by other means than reading the directory, like a page of a cached listing.
+	static entries_iterator from_entries(std::vector<entry> entries, std::string tvfs_path, datetime mtime);
+
 	void end_iteration();
 
 	traversal_mode get_effective_traversal_mode() const
@@ -171,6 +176,9 @@ private:
 	std::optional<mount_tree::nodes::const_iterator> mount_nodes_it_{};
 	entry next_entry_;
 	traversal_mode mode_{traversal_mode::autodetect};
+
+	std::optional<std::vector<entry>> entries_{};
+	std::size_t entries_pos_{};
 };
 
 class entry_facts {
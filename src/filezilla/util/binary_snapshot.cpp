@@ -0,0 +1,152 @@
+#include <libfilezilla/file.hpp>
+#include <libfilezilla/hash.hpp>
+#include <libfilezilla/local_filesys.hpp>
+
+#include "binary_snapshot.hpp"
+#include "io.hpp"
+#include "../build_info.hpp"
+
+namespace fz::util {
+
+namespace {
+
+const std::string snapshot_magic = "FZ-SNAPSHOT";
+constexpr std::uint32_t snapshot_format_version = 1;
+
+std::string current_build()
+{
+	return fz::sprintf("%s/%d/%d", fz::build_info::version, int(fz::build_info::flavour), fz::build_info::datetime.get_time_t());
+}
+
+}
+
+binary_snapshot::binary_snapshot(native_string file_name, std::vector<native_string> sources, logger_interface &logger)
+	: file_name_(std::move(file_name))
+	, sources_(std::move(sources))
+	, logger_(logger)
+{
+}
+
+std::vector<binary_snapshot::source_key> binary_snapshot::compute_keys() const
+{
+	static constexpr std::size_t chunk_size = 128*1024;
+
+	std::vector<source_key> keys;
+	keys.reserve(sources_.size());
+
+	for (auto &s: sources_) {
+		auto &k = keys.emplace_back();
+
+		bool is_link{};
+		fz::datetime mtime;
+
+		if (fz::local_filesys::get_file_info(s, is_link, &k.size, &mtime, nullptr) != fz::local_filesys::file) {
+			// A missing source is part of the state the values were loaded from, too.
+			k = {};
+			continue;
+		}
+
+		if (!mtime.empty())
+			k.mtime_ms = std::int64_t(mtime.get_time_t()) * 1000 + mtime.get_milliseconds();
+
+		fz::file file(s, fz::file::reading);
+		fz::hash_accumulator acc(fz::hash_algorithm::sha256);
+		std::vector<std::uint8_t> chunk(chunk_size);
+
+		for (std::int64_t read; (read = file.read(chunk.data(), std::int64_t(chunk.size()))) != 0;) {
+			if (read < 0) {
+				k = {};
+				break;
+			}
+
+			acc.update(chunk.data(), std::size_t(read));
+		}
+
+		if (k.size >= 0)
+			k.hash = acc.digest();
+	}
+
+	return keys;
+}
+
+bool binary_snapshot::read_if_fresh(fz::buffer &payload)
+{
+	keys_ = compute_keys();
+
+	fz::file file(file_name_, fz::file::reading);
+	if (!file.opened())
+		return false;
+
+	fz::buffer buffer;
+
+	if (int error{}; !io::read(file, buffer, &error)) {
+		logger_.log_u(logmsg::debug_warning, L"Couldn't read the snapshot %s: %d.", file_name_, error);
+		return false;
+	}
+
+	std::string magic;
+	std::uint32_t format_version{};
+	std::string build;
+	std::vector<source_key> keys;
+
+	if (!serialization::binary_input_archive{buffer}(magic, format_version, build, keys) || magic != snapshot_magic) {
+		logger_.log_u(logmsg::debug_warning, L"The snapshot %s is corrupted. Ignoring it.", file_name_);
+		return false;
+	}
+
+	if (format_version != snapshot_format_version || build != current_build()) {
+		logger_.log_u(logmsg::debug_info, L"The snapshot %s was written by a different build. Ignoring it.", file_name_);
+		return false;
+	}
+
+	if (keys != keys_) {
+		logger_.log_u(logmsg::debug_info, L"The files the snapshot %s was made from have changed since. Ignoring it.", file_name_);
+		return false;
+	}
+
+	// What's left is the payload of the values.
+	payload = std::move(buffer);
+	return true;
+}
+
+bool binary_snapshot::write_if_unchanged(const fz::buffer &payload)
+{
+	if (keys_.size() != sources_.size() || compute_keys() != keys_) {
+		logger_.log_u(logmsg::debug_info, L"The files the values have been loaded from have changed in the meanwhile. Not writing the snapshot %s.", file_name_);
+		return false;
+	}
+
+	fz::buffer buffer;
+
+	std::string magic = snapshot_magic;
+	std::uint32_t format_version = snapshot_format_version;
+	std::string build = current_build();
+
+	if (!serialization::binary_output_archive{buffer}(magic, format_version, build, keys_))
+		return false;
+
+	buffer.append(payload);
+
+	// The snapshot holds whatever the sources do, credentials included: it must be as protected as they are.
+	auto const tmp_file_name = native_string(file_name_).append(fzT(".tmp~"));
+
+	fz::file file(tmp_file_name, fz::file::writing, fz::file::empty | fz::file::current_user_and_admins_only);
+
+	int error{};
+	bool success = file.opened() && io::write(file, buffer, &error);
+
+	file.close();
+
+	if (success)
+		success = bool(fz::rename_file(tmp_file_name, file_name_, false));
+
+	if (!success) {
+		fz::remove_file(tmp_file_name, false);
+		logger_.log_u(logmsg::debug_warning, L"Couldn't write the snapshot %s: %d.", file_name_, error);
+		return false;
+	}
+
+	return true;
+}
+
+}
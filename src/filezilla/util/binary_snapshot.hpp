@@ -0,0 +1,94 @@
+#ifndef FZ_UTIL_BINARY_SNAPSHOT_HPP
+#define FZ_UTIL_BINARY_SNAPSHOT_HPP
+
+#include <vector>
+
+#include <libfilezilla/buffer.hpp>
+#include <libfilezilla/logger.hpp>
+
+#include "../serialization/archives/binary.hpp"
+#include "../serialization/types/containers.hpp"
+
+namespace fz::util {
+
+/// \brief A binary copy of values loaded from XML files, which can be loaded back much faster than the files can be parsed.
+///
+/// The snapshot records the size, modification time and SHA-256 hash of each of the source files, as they were when the values
+/// were loaded from them, and it's used only as long as they all still match.
+/// Since the binary format of the values can change between versions of the program, the snapshot is also bound to the build that wrote it.
+///
+/// Usage: call load() first. If it fails, load the values from the source files, then call save().
+class binary_snapshot
+{
+public:
+	struct source_key
+	{
+		std::int64_t size{-1};
+		std::int64_t mtime_ms{};
+		std::vector<std::uint8_t> hash{};
+
+		bool operator==(const source_key &rhs) const
+		{
+			return size == rhs.size && mtime_ms == rhs.mtime_ms && hash == rhs.hash;
+		}
+
+		template <typename Archive>
+		void serialize(Archive &ar)
+		{
+			ar(FZ_NVP(size), FZ_NVP(mtime_ms), FZ_NVP(hash));
+		}
+	};
+
+	binary_snapshot(native_string file_name, std::vector<native_string> sources, logger_interface &logger = get_null_logger());
+
+	/// Loads the values from the snapshot.
+	/// \returns false if the snapshot doesn't exist, can't be read, or doesn't match the current state of the source files.
+	template <typename... Ts>
+	bool load(Ts &... vs)
+	{
+		fz::buffer payload;
+
+		if (!read_if_fresh(payload))
+			return false;
+
+		if (!serialization::binary_input_archive{payload}(vs...)) {
+			logger_.log_u(logmsg::debug_warning, L"The snapshot %s is corrupted. Ignoring it.", file_name_);
+			return false;
+		}
+
+		return true;
+	}
+
+	/// Writes the values into the snapshot.
+	/// Nothing is written if the source files have changed since load() was called, since the values might not reflect them.
+	template <typename... Ts>
+	bool save(const Ts &... vs)
+	{
+		fz::buffer payload;
+
+		if (!serialization::binary_output_archive{payload}(vs...))
+			return false;
+
+		return write_if_unchanged(payload);
+	}
+
+	const native_string &get_file_name() const
+	{
+		return file_name_;
+	}
+
+private:
+	std::vector<source_key> compute_keys() const;
+	bool read_if_fresh(fz::buffer &payload);
+	bool write_if_unchanged(const fz::buffer &payload);
+
+	native_string file_name_;
+	std::vector<native_string> sources_;
+	logger_interface &logger_;
+
+	std::vector<source_key> keys_;
+};
+
+}
+
+#endif // FZ_UTIL_BINARY_SNAPSHOT_HPP
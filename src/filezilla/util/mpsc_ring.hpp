@@ -0,0 +1,104 @@
+#ifndef FZ_UTIL_MPSC_RING_HPP
+#define FZ_UTIL_MPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace fz::util {
+
+/// \brief A bounded, lock-free, multiple producers single consumer queue.
+///
+/// Each cell carries a sequence number telling whether it's ready to be written by a producer or read by the consumer,
+/// so that producers only contend on the index of the next cell to write to, and never wait for each other.
+/// The capacity is rounded up to a power of 2.
+template <typename T>
+class mpsc_ring
+{
+public:
+	explicit mpsc_ring(std::size_t capacity)
+	{
+		std::size_t size = 2;
+		while (size < capacity)
+			size *= 2;
+
+		cells_ = std::make_unique<cell[]>(size);
+		mask_ = size - 1;
+
+		for (std::size_t i = 0; i < size; ++i)
+			cells_[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	mpsc_ring(const mpsc_ring &) = delete;
+	mpsc_ring &operator=(const mpsc_ring &) = delete;
+
+	std::size_t capacity() const
+	{
+		return mask_ + 1;
+	}
+
+	/// Can be invoked concurrently by any number of threads.
+	/// \returns false if the ring is full, in which case \p v is left untouched.
+	bool try_push(T &&v)
+	{
+		auto pos = head_.load(std::memory_order_relaxed);
+
+		for (;;) {
+			auto &c = cells_[pos & mask_];
+			auto diff = std::intptr_t(c.sequence.load(std::memory_order_acquire)) - std::intptr_t(pos);
+
+			if (diff == 0) {
+				if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					c.value = std::move(v);
+					c.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else
+			if (diff < 0)
+				return false;
+			else
+				pos = head_.load(std::memory_order_relaxed);
+		}
+	}
+
+	/// Must only be invoked by the consumer.
+	/// \returns false if there's nothing to pop, or the next element is still being pushed.
+	bool try_pop(T &v)
+	{
+		auto &c = cells_[tail_ & mask_];
+
+		if (c.sequence.load(std::memory_order_acquire) != tail_ + 1)
+			return false;
+
+		v = std::move(c.value);
+		c.sequence.store(tail_ + mask_ + 1, std::memory_order_release);
+		++tail_;
+
+		return true;
+	}
+
+	/// Must only be invoked by the consumer.
+	bool empty() const
+	{
+		return cells_[tail_ & mask_].sequence.load(std::memory_order_acquire) != tail_ + 1;
+	}
+
+private:
+	struct cell
+	{
+		std::atomic<std::size_t> sequence{};
+		T value{};
+	};
+
+	std::unique_ptr<cell[]> cells_;
+	std::size_t mask_{};
+
+	alignas(64) std::atomic<std::size_t> head_{};
+	alignas(64) std::size_t tail_{};
+};
+
+}
+
+#endif // FZ_UTIL_MPSC_RING_HPP
@@ -0,0 +1,123 @@
+#ifndef FZ_UTIL_TIMING_WHEEL_HPP
+#define FZ_UTIL_TIMING_WHEEL_HPP
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace fz::util {
+
+/// \brief A hierarchical timing wheel.
+///
+/// Time is measured in ticks, whose duration is up to the user. Scheduling and expiring an element costs O(1),
+/// regardless of how many elements are scheduled, at the price of a resolution of one tick.
+///
+/// Each level has 64 slots, each one spanning 64 times the slots of the level below.
+/// Elements scheduled too far in the future for the topmost level are parked in its last slot and rescheduled when they get there.
+///
+/// The wheel doesn't cancel elements: whoever schedules them is expected to recognize, and ignore, the stale ones when they expire.
+/// It's not thread safe.
+template <typename T, std::size_t Levels = 4>
+class timing_wheel
+{
+public:
+	using tick_type = std::uint64_t;
+
+	explicit timing_wheel(tick_type now = 0)
+		: now_(now)
+	{}
+
+	tick_type now() const
+	{
+		return now_;
+	}
+
+	/// Schedules \p v to expire at tick \p when. If \p when is not in the future, \p v expires on the next tick.
+	void schedule(T v, tick_type when)
+	{
+		if (when <= now_)
+			when = now_ + 1;
+
+		place(std::move(v), when);
+		++size_;
+	}
+
+	/// Moves time forward up to \p now, invoking \p on_expired(T &&, tick_type when) for each element whose time has come.
+	/// Elements can be scheduled from within \p on_expired.
+	template <typename F>
+	void advance(tick_type now, F &&on_expired)
+	{
+		while (now_ < now) {
+			++now_;
+
+			cascade(1);
+
+			auto &slot = slots_[0][now_ & mask];
+			auto expired = std::move(slot);
+			slot.clear();
+
+			size_ -= expired.size();
+
+			for (auto &e: expired)
+				on_expired(std::move(e.first), e.second);
+		}
+	}
+
+	std::size_t size() const
+	{
+		return size_;
+	}
+
+private:
+	static constexpr unsigned bits = 6;
+	static constexpr tick_type slots_per_level = tick_type(1) << bits;
+	static constexpr tick_type mask = slots_per_level - 1;
+
+	using slot = std::vector<std::pair<T, tick_type>>;
+
+	void place(T v, tick_type when)
+	{
+		auto delta = when - now_;
+
+		for (std::size_t level = 0; level < Levels; ++level) {
+			if (delta < (tick_type(1) << (bits * (level + 1)))) {
+				slots_[level][(when >> (bits * level)) & mask].emplace_back(std::move(v), when);
+				return;
+			}
+		}
+
+		// Too far in the future: park it in the farthest slot, it'll be placed again once there.
+		auto const level = Levels - 1;
+		auto const farthest = now_ + (mask << (bits * level));
+		slots_[level][(farthest >> (bits * level)) & mask].emplace_back(std::move(v), when);
+	}
+
+	// When the lower levels wrap around, the elements of the current slot of the upper level get distributed on the lower levels.
+	void cascade(std::size_t level)
+	{
+		if (level >= Levels || (now_ & ((tick_type(1) << (bits * level)) - 1)) != 0)
+			return;
+
+		cascade(level + 1);
+
+		auto &slot = slots_[level][(now_ >> (bits * level)) & mask];
+		auto elements = std::move(slot);
+		slot.clear();
+
+		for (auto &e: elements) {
+			if (e.second <= now_)
+				slots_[0][now_ & mask].push_back(std::move(e));
+			else
+				place(std::move(e.first), e.second);
+		}
+	}
+
+	tick_type now_;
+	std::size_t size_{};
+	std::array<std::array<slot, slots_per_level>, Levels> slots_{};
+};
+
+}
+
+#endif // FZ_UTIL_TIMING_WHEEL_HPP
@@ -0,0 +1,306 @@
+#include <algorithm>
+
+#include <libfilezilla/local_filesys.hpp>
+
+#include "asset_cache.hpp"
+#include "templated_index_wrapper.hpp"
+
+#include "../http/body_compressor.hpp"
+#include "../http/server/responder.hpp"
+#include "../util/io.hpp"
+
+namespace fz::webui {
+
+namespace {
+
+// How often the app tree is looked at, to find out whether it needs to be loaded again.
+constexpr auto scan_interval = duration::from_seconds(10);
+
+}
+
+asset_cache::asset_cache(thread_pool &pool, event_loop &loop, http::server::transaction_handler &fallback, const http::handlers::file_server::options &opts, logger_interface &logger)
+	: event_handler(loop)
+	, fallback_(fallback)
+	, opts_(opts)
+	, logger_(logger)
+	, pool_(pool)
+{
+}
+
+asset_cache::~asset_cache()
+{
+	remove_handler();
+
+	{
+		scoped_lock lock(mutex_);
+		reload_pending_ = false;
+	}
+
+	task_.join();
+}
+
+void asset_cache::set_root(const util::fs::absolute_native_path &app_root)
+{
+	scoped_lock lock(mutex_);
+
+	root_ = app_root ? app_root.str() : native_string();
+	++root_generation_;
+	tree_.clear();
+	std::atomic_store(&assets_, std::shared_ptr<const assets>());
+
+	if (!timer_id_) {
+		timer_id_ = add_timer(scan_interval, false);
+	}
+
+	lock.unlock();
+
+	request_reload();
+}
+
+void asset_cache::operator()(const event_base &ev)
+{
+	fz::dispatch<timer_event>(ev, [this](timer_id) {
+		request_reload();
+	});
+}
+
+void asset_cache::request_reload()
+{
+	scoped_lock lock(mutex_);
+
+	reload_pending_ = true;
+
+	if (!reloading_) {
+		// Using a separate thread because reading and compressing the whole app can take some time and we don't wanna stall the loop.
+		// The previous task, if any, is done with the lock already: joining it only reclaims its thread.
+		reloading_ = true;
+		task_.join();
+		task_ = pool_.spawn([this] { reload(); });
+	}
+}
+
+void asset_cache::scan(const native_string &dir, const std::string &path, tree &t)
+{
+	local_filesys lfs;
+	if (!lfs.begin_find_files(dir, false, false)) {
+		return;
+	}
+
+	native_string name;
+	bool is_link;
+	local_filesys::type type;
+	std::int64_t size;
+	datetime mtime;
+
+	while (lfs.get_next_file(name, is_link, type, &size, &mtime, nullptr)) {
+		auto native_path = (util::fs::native_path(dir) / name).str();
+		auto entry_path = path + "/" + fz::to_utf8(name);
+
+		// Links to directories aren't followed, so that no loop can ever be walked.
+		if (type == local_filesys::dir && !is_link) {
+			scan(native_path, entry_path, t);
+		}
+		else
+		if (type == local_filesys::file) {
+			t.push_back({std::move(entry_path), std::move(native_path), size, mtime});
+		}
+	}
+}
+
+void asset_cache::reload()
+{
+	scoped_lock lock(mutex_);
+
+	while (reload_pending_) {
+		reload_pending_ = false;
+
+		if (root_.empty()) {
+			continue;
+		}
+
+		auto root = root_;
+		auto generation = root_generation_;
+
+		lock.unlock();
+
+		tree t;
+		scan(root, {}, t);
+
+		std::sort(t.begin(), t.end(), [](const file_info &lhs, const file_info &rhs) {
+			return lhs.path < rhs.path;
+		});
+
+		lock.lock();
+
+		// If the root was changed meanwhile, another reload has been asked for already.
+		if (generation != root_generation_ || (t == tree_ && std::atomic_load(&assets_))) {
+			continue;
+		}
+
+		lock.unlock();
+
+		auto a = load(t);
+
+		lock.lock();
+
+		if (generation == root_generation_) {
+			std::atomic_store(&assets_, std::move(a));
+			tree_ = std::move(t);
+		}
+	}
+
+	reloading_ = false;
+}
+
+std::shared_ptr<const asset_cache::assets> asset_cache::load(const tree &t)
+{
+	auto res = std::make_shared<assets>();
+
+	std::uint64_t total_size = 0;
+
+	for (auto &f: t) {
+		if (f.size > max_file_size || total_size + std::uint64_t(f.size) > max_total_size) {
+			logger_.log_u(logmsg::debug_info, L"Not caching %s, it's too big. It will be served from disk.", f.path);
+			continue;
+		}
+
+		fz::buffer buf;
+		if (!util::io::read(f.native_path, buf)) {
+			logger_.log_u(logmsg::debug_warning, L"Couldn't read %s. It will be served from disk.", f.path);
+			continue;
+		}
+
+		total_size += buf.size();
+
+		auto &a = (*res)[f.path];
+		a.identity.body.assign(buf.to_view());
+		a.mtime = f.mtime;
+	}
+
+	// Precompressed siblings become the variants of the files they are the compressed form of.
+	static constexpr std::pair<std::string_view, std::optional<variant> asset::*> siblings[] = {
+		{ ".gz", &asset::gzip },
+		{ ".br", &asset::br },
+	};
+
+	for (auto it = res->begin(); it != res->end();) {
+		auto erase = false;
+
+		for (auto &[ext, member]: siblings) {
+			if (!fz::ends_with(std::string_view(it->first), ext)) {
+				continue;
+			}
+
+			auto base = res->find(std::string_view(it->first).substr(0, it->first.size() - ext.size()));
+			if (base != res->end()) {
+				(base->second.*member).emplace().body = std::move(it->second.identity.body);
+				erase = true;
+			}
+
+			break;
+		}
+
+		it = erase ? res->erase(it) : std::next(it);
+	}
+
+	for (auto &[path, a]: *res) {
+		if (path == "/index.html") {
+			// The index gets templated, so whatever was precompressed out of it doesn't match it anymore.
+			a.gzip.reset();
+			a.br.reset();
+
+			templated_index_wrapper::apply_template(a.identity.body);
+		}
+
+		a.content_type = http::handlers::file_server::mime_from_name(path);
+		a.cache_control = http::handlers::file_server::cache_control_for(opts_, path);
+
+		if (!a.mtime.empty()) {
+			a.last_modified = a.mtime.get_rfc822();
+		}
+
+		if (!a.gzip && a.identity.body.size() >= http::body_compressor::min_body_size && http::body_compressor::is_compressible(a.content_type)) {
+			fz::buffer compressed;
+			if (http::body_compressor::compress(a.identity.body, compressed) && compressed.size() < a.identity.body.size()) {
+				a.gzip.emplace().body.assign(compressed.to_view());
+			}
+		}
+
+		auto make_tag = [&](variant &v, std::string_view encoding) {
+			v.tag = http::entity_tag::from_entry(v.body.size(), a.mtime, false, encoding);
+			if (v.tag) {
+				v.etag = v.tag.to_string();
+			}
+		};
+
+		make_tag(a.identity, {});
+
+		if (a.gzip) {
+			make_tag(*a.gzip, "gzip");
+		}
+
+		if (a.br) {
+			make_tag(*a.br, "br");
+		}
+	}
+
+	logger_.log_u(logmsg::status, L"Loaded %d files of the WebUI app in memory, %d bytes in total.", res->size(), total_size);
+
+	return res;
+}
+
+void asset_cache::handle_transaction(const http::server::shared_transaction &t)
+{
+	auto &req = t->req();
+	auto &res = t->res();
+
+	auto assets = std::atomic_load(&assets_);
+
+	// Ranges are rarely asked for, and the file server already knows how to deal with them.
+	if (!assets || (req.method != "GET" && req.method != "HEAD") || req.headers.get(http::headers::Range)) {
+		return fallback_.handle_transaction(t);
+	}
+
+	auto it = assets->find(req.uri.path_);
+	if (it == assets->end()) {
+		return fallback_.handle_transaction(t);
+	}
+
+	auto &a = it->second;
+
+	auto [v, encoding] = [&]() -> std::pair<const variant &, std::string_view> {
+		if (a.br && req.headers.accepts_encoding("br")) {
+			return { *a.br, "br" };
+		}
+
+		if (a.gzip && req.headers.accepts_encoding("gzip")) {
+			return { *a.gzip, "gzip" };
+		}
+
+		return { a.identity, {} };
+	}();
+
+	auto send_validators = [&, &v = v] {
+		return
+			(v.etag.empty() || res.send_header(http::headers::ETag, v.etag)) &&
+			(a.last_modified.empty() || res.send_header(http::headers::Last_Modified, a.last_modified)) &&
+			(a.cache_control.empty() || res.send_header(http::headers::Cache_Control, a.cache_control)) &&
+			((!a.gzip && !a.br) || res.send_header(http::headers::Vary, http::headers::Accept_Encoding));
+	};
+
+	if (http::handlers::file_server::is_not_modified(req, v.tag, a.mtime)) {
+		res.send_status(304, "Not Modified") &&
+		send_validators() &&
+		res.send_end();
+
+		return;
+	}
+
+	res.send_status(200, "Ok") &&
+	res.send_header(http::headers::Content_Type, a.content_type) &&
+	(encoding.empty() || res.send_header(http::headers::Content_Encoding, encoding)) &&
+	send_validators() &&
+	res.send_body(v.body);
+}
+
+}
@@ -0,0 +1,104 @@
+#ifndef FZ_WEBUI_ASSET_CACHE_HPP
+#define FZ_WEBUI_ASSET_CACHE_HPP
+
+#include <map>
+#include <optional>
+
+#include <libfilezilla/event_handler.hpp>
+#include <libfilezilla/thread_pool.hpp>
+
+#include "../http/server/transaction.hpp"
+#include "../http/handlers/file_server.hpp"
+#include "../util/filesystem.hpp"
+
+namespace fz::webui {
+
+/// \brief Serves the files of the WebUI app straight from memory.
+///
+/// The whole app tree is loaded at once, together with the entity tags and the compressed variants of its files,
+/// and it's loaded again whenever a periodic scan finds that the tree has changed.
+/// Scanning and loading happen on a thread of the pool, one reload at a time, never on the loop.
+/// Requests are answered without any tvfs or file access. Those the cache can't answer, like requests for ranges
+/// or for files that aren't in the tree, are passed on to the fallback handler.
+class asset_cache: public http::server::transaction_handler, private event_handler
+{
+public:
+	/// Files bigger than this are left to the fallback handler.
+	static inline constexpr std::int64_t max_file_size = 8*1024*1024;
+
+	/// Once the cache holds this much, the remaining files are left to the fallback handler.
+	static inline constexpr std::uint64_t max_total_size = 64*1024*1024;
+
+	asset_cache(thread_pool &pool, event_loop &loop, http::server::transaction_handler &fallback, const http::handlers::file_server::options &opts, logger_interface &logger);
+	~asset_cache() override;
+
+	/// Loads the tree rooted at \p app_root, and keeps watching it. An invalid root empties the cache.
+	void set_root(const util::fs::absolute_native_path &app_root);
+
+	void handle_transaction(const http::server::shared_transaction &t) override;
+
+private:
+	struct variant
+	{
+		std::string body;
+		http::entity_tag tag;
+		std::string etag;
+	};
+
+	struct asset
+	{
+		std::string content_type;
+		std::string cache_control;
+		datetime mtime;
+		std::string last_modified;
+		variant identity;
+		std::optional<variant> gzip;
+		std::optional<variant> br;
+	};
+
+	struct file_info
+	{
+		std::string path;
+		native_string native_path;
+		std::int64_t size{};
+		datetime mtime;
+
+		bool operator==(const file_info &rhs) const
+		{
+			return path == rhs.path && size == rhs.size && mtime == rhs.mtime;
+		}
+	};
+
+	using assets = std::map<std::string, asset, std::less<>>;
+	using tree = std::vector<file_info>;
+
+	static void scan(const native_string &dir, const std::string &path, tree &t);
+	std::shared_ptr<const assets> load(const tree &t);
+
+	/// Has the tree looked at again, on the pool, unless that's already going to happen.
+	void request_reload();
+	void reload();
+
+	void operator()(const event_base &ev) override;
+
+	http::server::transaction_handler &fallback_;
+	http::handlers::file_server::options opts_;
+	logger_interface &logger_;
+
+	thread_pool &pool_;
+
+	fz::mutex mutex_;
+	native_string root_;
+	std::uint64_t root_generation_{}; ///< Tells apart the reloads started before the root was changed.
+	tree tree_;
+	timer_id timer_id_{};
+	bool reload_pending_{};
+	bool reloading_{};
+	async_task task_;
+
+	std::shared_ptr<const assets> assets_;
+};
+
+}
+
+#endif // FZ_WEBUI_ASSET_CACHE_HPP
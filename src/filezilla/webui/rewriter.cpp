@@ -16,7 +16,7 @@ void rewriter::handle_transaction(const http::server::shared_transaction &t) {
 
 	bool should_rewrite = true;
 
-	for (auto p: {"/assets"sv, "/favicon.ico"sv, "/icons"sv, "/index.html"sv, "/api"sv}) {
+	for (auto p: {"/assets"sv, "/favicon.ico"sv, "/icons"sv, "/index.html"sv, "/api"sv, "/metrics"sv}) {
 		if (fz::starts_with(path, p)) {
 			should_rewrite = false;
 			break;
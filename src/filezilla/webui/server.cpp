@@ -8,7 +8,11 @@ namespace fz::webui
 server::server(tcp::server::context &context, event_loop_pool &event_loop_pool, const util::fs::absolute_native_path &app_root, const util::fs::absolute_native_path &tokendb_file, tcp::address_list &disallowed_ips, tcp::address_list &allowed_ips, authentication::autobanner &autobanner, authentication::authenticator &auth, logger_interface &logger, options opts)
 	: logger_(logger, "WebUI")
 	, app_tvfs_(logger_)
-	, app_file_server_(app_tvfs_, logger_, http::handlers::file_server::options().default_index({"index.html"}))
+	, app_file_server_(app_tvfs_, logger_, http::handlers::file_server::options()
+		.default_index({"index.html"})
+		.cache_control("no-cache")
+		.immutable_prefixes({"/assets/"})
+		.precompressed(true))
 	, tdb_(tokendb_file, logger_)
 	, tm_(tokendb_file.str().empty() ? (authentication::token_db&)imtdb_ : tdb_, logger_)
 	, authorizator_(context.loop(), auth, tm_, logger_)
@@ -18,17 +22,23 @@ server::server(tcp::server::context &context, event_loop_pool &event_loop_pool,
 		.can_get(true)
 		.can_put(true)
 		.can_post(true)
-		.honor_406(true))
+		.honor_406(true)
+		.can_zip(true)
+		.cache_control("private, no-cache"))
 	, file_sharer_(authorizator_, logger_, http::handlers::file_server::options()
 		.can_list_dir(true)
 		.can_delete(true)
 		.can_get(true)
 		.can_put(true)
 		.can_post(true)
-		.honor_406(true))
+		.honor_406(true)
+		.can_zip(true)
+		.cache_control("private, no-cache"))
+	, metrics_exporter_(metrics::registry::global())
 	, templated_index_wrapper_(app_file_server_)
+	, asset_cache_(context.pool(), context.loop(), templated_index_wrapper_, app_file_server_.get_options(), logger_)
 	, rewriter_(router_)
-	, http_(context, event_loop_pool, rewriter_, disallowed_ips, allowed_ips, autobanner, logger_)
+	, http_(context, event_loop_pool, rewriter_, disallowed_ips, allowed_ips, autobanner, logger_, "webui")
 {
 	if (!app_root) {
 		logger_.log(logmsg::error, L"app_root is not set or is invalid, this means that the WebUI will not be accessible, but the REST api will still be functional.");
@@ -45,10 +55,13 @@ server::server(tcp::server::context &context, event_loop_pool &event_loop_pool,
 		{ "/", app_root, fz::tvfs::mount_point::read_only, fz::tvfs::mount_point::apply_permissions_recursively }
 	}), tvfs::placeholders::map{}, logger_));
 
-	router_.add_route("/", templated_index_wrapper_);
+	asset_cache_.set_root(app_root);
+
+	router_.add_route("/", asset_cache_);
 	router_.add_route("/api/v1/auth", authorizator_);
 	router_.add_route("/api/v1/files/home", user_file_server_);
 	router_.add_route("/api/v1/files/shares", file_sharer_);
+	router_.add_route("/metrics", metrics_exporter_);
 
 	set_options(std::move(opts));
 }
@@ -59,6 +72,7 @@ void server::set_options(options opts)
 	http_.set_timeouts(opts.http_keepalive_timeout, opts.http_activity_timeout);
 	http_.set_security_info(opts.tls);
 	http_.set_listen_address_infos(opts.listeners_info);
+	metrics_exporter_.set_enabled(opts.expose_metrics);
 
 	scoped_lock lock(mutex_);
 	opts_ = std::move(opts);
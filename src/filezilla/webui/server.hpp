@@ -9,7 +9,9 @@
 #include "../http/handlers/authorizator.hpp"
 #include "../http/handlers/authorized_file_server.hpp"
 #include "../http/handlers/authorized_file_sharer.hpp"
+#include "../http/handlers/metrics_exporter.hpp"
 #include "../http/handlers/router.hpp"
+#include "asset_cache.hpp"
 #include "templated_index_wrapper.hpp"
 #include "rewriter.hpp"
 
@@ -32,6 +34,8 @@ public:
 		std::vector<http::server::address_info> listeners_info {};
 		securable_socket::info tls{};
 
+		/// Whether the metrics of the server are exposed, in the Prometheus text format, at /metrics.
+		bool expose_metrics = false;
 
 		options(){}
 	};
@@ -63,7 +67,9 @@ private:
 	http::handlers::authorizator authorizator_;
 	http::handlers::authorized_file_server user_file_server_;
 	http::handlers::authorized_file_sharer file_sharer_;
+	http::handlers::metrics_exporter metrics_exporter_;
 	webui::templated_index_wrapper templated_index_wrapper_;
+	webui::asset_cache asset_cache_;
 	http::handlers::router router_;
 	webui::rewriter rewriter_;
 	http::server http_;
@@ -1,11 +1,18 @@
 #include "templated_index_wrapper.hpp"
 
 #include "../http/server/responder.hpp"
+#include "../buffer_operator/adder.hpp"
 #include "../build_info.hpp"
 #include "../util/io.hpp"
 
 namespace fz::webui {
 
+void templated_index_wrapper::apply_template(std::string &body)
+{
+	fz::replace_substrings(body, "{{PRODUCT_NAME}}", fz::build_info::package_name);
+	fz::replace_substrings(body, "{{PRODUCT_VERSION}}", fz::to_string(fz::build_info::version));
+}
+
 void templated_index_wrapper::handle_transaction(const http::server::shared_transaction &t) {
 	using namespace std::string_view_literals;
 
@@ -41,8 +48,7 @@ void templated_index_wrapper::handle_transaction(const http::server::shared_tran
 					owner_.mtime_ = file->get_modification_time();
 
 					// Do the proper templating, finally.
-					fz::replace_substrings(owner_.body_, "{{PRODUCT_NAME}}", fz::build_info::package_name);
-					fz::replace_substrings(owner_.body_, "{{PRODUCT_VERSION}}", fz::to_string(fz::build_info::version));
+					apply_template(owner_.body_);
 				}
 
 				return res_.send_body(owner_.body_);
@@ -63,11 +69,22 @@ void templated_index_wrapper::handle_transaction(const http::server::shared_tran
 				return res_.send_body(body);
 			}
 
+			bool send_body(tvfs::file_holder file, const http::byte_ranges &ranges, std::string_view boundary, std::string_view content_type) override
+			{
+				// Never reached for the index, whose Range header is dropped: the ranges would refer to the file, not to its templated version.
+				return res_.send_body(std::move(file), ranges, boundary, content_type);
+			}
+
 			bool send_body(tvfs::entries_iterator it) override
 			{
 				return res_.send_body(std::move(it));
 			}
 
+			bool send_body(std::unique_ptr<buffer_operator::adder_interface> adder) override
+			{
+				return res_.send_body(std::move(adder));
+			}
+
 			bool send_end() override
 			{
 				return res_.send_end();
@@ -86,7 +103,9 @@ void templated_index_wrapper::handle_transaction(const http::server::shared_tran
 		transaction(templated_index_wrapper &owner, http::server::shared_transaction t)
 			: t_(std::move(t))
 			, responder_(owner, t_->res())
-		{}
+		{
+			t_->req().headers.erase(http::headers::Range);
+		}
 
 		http::server::request &req() override
 		{
@@ -15,6 +15,9 @@ struct templated_index_wrapper: http::server::transaction_handler
 
 	void handle_transaction(const http::server::shared_transaction &t) override;
 
+	/// Fills in the placeholders of the index.
+	static void apply_template(std::string &body);
+
 private:
 	http::handlers::file_server &fs_;
 	mutex mutex_;
@@ -12,9 +12,12 @@
 #include "../filezilla/serialization/types/network_interface.hpp"
 #include "../filezilla/serialization/types/json.hpp"
 #include "../filezilla/serialization/types/update.hpp"
+#include "../filezilla/serialization/types/tuple.hpp"
 
 #include "../filezilla/authentication/file_based_authenticator.hpp"
 #include "../filezilla/acme/daemon.hpp"
+#include "../filezilla/metrics/registry.hpp"
+#include "../filezilla/event_loop_monitor.hpp"
 
 #include "../filezilla/rmp/engine.hpp"
 #include "../filezilla/rmp/engine/visitor.hpp"
@@ -36,7 +39,7 @@ namespace administration {
 
 	// Increase this number any time a new message is added/removed/changed
 	// Remember, though, that the admin_login message must come always FIRST and CANNOT be removed (but it can be changed), since it's the only one that does the version check.
-	static constexpr version_t protocol_version { 61 };
+	static constexpr version_t protocol_version { 66 };
 
 	using admin_login = command <versioned<protocol_version, struct admin_login_tag> (std::string password), response(
 		fz::util::fs::path_format,
@@ -85,6 +88,56 @@ namespace administration {
 		using protocol_info  = message <struct protocol_info_tag  (fz::ftp::session::id session_id, fz::duration since_start, any_protocol_info info)>;
 
 		using solicit_info = message <struct solicit_info_tag (std::vector<fz::ftp::session::id> session_ids)>;
+
+		/// Only the sessions matching all the non-empty criteria are reported to a telemetry subscriber.
+		struct telemetry_filter
+		{
+			std::vector<fz::ftp::session::id> session_ids{};
+			std::vector<std::string> user_names{};
+
+			/// In bytes per second. Entries that transferred slower than this during a tick are not reported,
+			/// and what they transferred is accumulated in their next report.
+			std::int64_t min_rate{};
+
+			template <typename Archive>
+			void serialize(Archive &ar)
+			{
+				ar(FZ_NVP(session_ids), FZ_NVP(user_names), FZ_NVP(min_rate));
+			}
+		};
+
+		struct entry_delta
+		{
+			std::uint64_t entry_id{};
+			std::int64_t written{};
+			std::int64_t read{};
+			std::int64_t actual_entry_size{};
+
+			template <typename Archive>
+			void serialize(Archive &ar)
+			{
+				ar(FZ_NVP(entry_id), FZ_NVP(written), FZ_NVP(read), FZ_NVP(actual_entry_size));
+			}
+		};
+
+		struct session_delta
+		{
+			fz::ftp::session::id session_id{};
+			fz::duration since_start{};
+			std::vector<entry_delta> entries{};
+
+			template <typename Archive>
+			void serialize(Archive &ar)
+			{
+				ar(FZ_NVP(session_id), FZ_NVP(since_start), FZ_NVP(entries));
+			}
+		};
+
+		// Once subscribed, a client gets one telemetry message per tick in place of the entry_written and entry_read messages.
+		// If is_keyframe is true, the amounts are the totals of each open entry, otherwise they're what was transferred
+		// since the entry was last reported to the client. Entries that didn't change are left out.
+		using telemetry           = message <struct telemetry_tag (fz::duration interval, bool is_keyframe, std::vector<session_delta> sessions)>;
+		using subscribe_telemetry = command <struct subscribe_telemetry_tag (bool subscribe, telemetry_filter filter), response()>;
 	}
 
 	using log = message <struct log_tag (fz::datetime dt, fz::ftp::session::id session_id, fz::logmsg::type type, std::string module, std::wstring msg)>;
@@ -105,10 +158,25 @@ namespace administration {
 	using get_ftp_options       = command <struct get_ftp_options_tag            (bool export_cert), response(fz::ftp::server::options ftp_options, fz::securable_socket::cert_info::extra tls_extra_certs_info)>;
 	using set_protocols_options = command <struct set_protocols_options_tag      (server_settings::protocols_options), response()>;
 	using get_protocols_options = command <struct get_protocols_options_tag      (), response(server_settings::protocols_options)>;
+	using get_bandwidth_usage   = command <struct get_bandwidth_usage_tag        (), response(std::vector<fz::rate_limit::fair_share_scheduler::class_stats> classes)>;
+	using get_metrics           = command <struct get_metrics_tag                (), response(fz::metrics::snapshot metrics)>;
+
+	// Retrieves, for each monitored event loop, the distribution of its scheduling lag and of the time its handlers take to process a single event.
+	using get_event_loops_summary = command <struct get_event_loops_summary_tag
+		(),
+		response(std::vector<fz::event_loop_monitor::loop_summary> loops)
+	>;
 	using set_admin_options     = command <struct set_admin_options_tag          (server_settings::admin_options admin_options), response()>;
 	using get_admin_options     = command <struct get_admin_options_tag          (bool export_cert), response(server_settings::admin_options admin_options, fz::securable_socket::cert_info::extra tls_extra_certs_info)>;
 	using set_logger_options    = command <struct set_logger_options_tag         (fz::logger::file::options logger_options), response()>;
 	using get_logger_options    = command <struct get_logger_options_tag         (), response(fz::logger::file::options logger_options)>;
+
+	// Retrieves the lines logged by the given session (0 meaning any) within the given time frame (empty meaning unbounded), from the current log file and the rotated ones.
+	// The compressed rotated files are only inflated where their index says the lines can be. The lines are truncated if too many.
+	using get_session_log = command <struct get_session_log_tag
+		(std::uint64_t session_id, fz::datetime from, fz::datetime to),
+		response(std::vector<std::string> lines, bool truncated)
+	>;
 	using get_acme_options      = command <struct get_acme_options_tag           (), response(server_settings::acme_options acme_options, fz::acme::extra_account_info extra)>;
 	using set_acme_options      = command <struct set_acme_options_tag           (server_settings::acme_options acme_options), response()>;
 	using get_pkcs11_options    = command <struct get_pkcs11_options_tag         (), response(server_settings::pkcs11_options pkcs11_options)>;
@@ -211,6 +279,8 @@ namespace administration {
 		session::entry_read,
 		session::protocol_info,
 		session::solicit_info,
+		session::telemetry,
+		session::subscribe_telemetry, session::subscribe_telemetry::response,
 
 		log,
 
@@ -230,10 +300,14 @@ namespace administration {
 		get_ftp_options,       get_ftp_options::response,
 		set_protocols_options, set_protocols_options::response,
 		get_protocols_options, get_protocols_options::response,
+		get_bandwidth_usage,   get_bandwidth_usage::response,
+		get_metrics,           get_metrics::response,
+		get_event_loops_summary, get_event_loops_summary::response,
 		set_admin_options,     set_admin_options::response,
 		get_admin_options,     get_admin_options::response,
 		set_logger_options,    set_logger_options::response,
 		get_logger_options,    get_logger_options::response,
+		get_session_log,       get_session_log::response,
 		set_acme_options,      set_acme_options::response,
 		get_acme_options,      get_acme_options::response,
 		set_pkcs11_options,    set_pkcs11_options::response,
@@ -12,6 +12,7 @@
 #include "administrator/notifier.hpp"
 #include "administrator/update_checker.hpp"
 #include "administrator/ftp_test_creator.hpp"
+#include "administrator/telemetry.hpp"
 
 struct administrator::session_data
 {
@@ -73,6 +74,8 @@ void administrator::disconnection(administration::engine::session &s, int err)
 
 	if (update_checker_)
 		update_checker_->on_disconnection(s.get_id());
+
+	telemetry_->unsubscribe(s.get_id());
 }
 
 bool administrator::have_some_certificates_expired()
@@ -128,6 +131,7 @@ void administrator::send_buffer_is_in_overflow(administration::engine::session &
 			administration::session::entry_close,
 			administration::session::entry_written,
 			administration::session::entry_read,
+			administration::session::telemetry,
 			administration::log,
 			administration::listener_status
 		>(false);
@@ -326,12 +330,16 @@ auto administrator::operator ()(administration::acknowledge_queue_full::response
 			administration::session::entry_close,
 			administration::session::entry_written,
 			administration::session::entry_read,
+			administration::session::telemetry,
 			administration::log,
 			administration::listener_status
 		>(true);
 
 		// Send ftp sessions info to the admin session
 		operator()(administration::session::solicit_info{}, session);
+
+		// Some telemetry deltas might have been lost.
+		telemetry_->resync(session.get_id());
 	}
 }
 
@@ -431,6 +439,7 @@ administrator::administrator(fz::tcp::server::context &context,
 							 fz::tcp::automatically_serializable_binary_address_list &disallowed_ips,
 							 fz::tcp::automatically_serializable_binary_address_list &allowed_ips,
 							 fz::authentication::autobanner &autobanner,
+							 fz::rate_limit::fair_share_scheduler &bandwidth_scheduler,
 							 fz::authentication::file_based_authenticator &authenticator,
 							 fz::util::xml_archiver<server_settings> &server_settings,
 							 fz::acme::daemon &acme,
@@ -450,6 +459,7 @@ administrator::administrator(fz::tcp::server::context &context,
 	, disallowed_ips_(disallowed_ips)
 	, allowed_ips_(allowed_ips)
 	, autobanner_(autobanner)
+	, bandwidth_scheduler_(bandwidth_scheduler)
 	, authenticator_(authenticator)
 	, server_settings_(server_settings)
 	, acme_(acme)
@@ -467,6 +477,7 @@ administrator::administrator(fz::tcp::server::context &context,
 	)
 	, invoke_later_(context.loop())
 	, admin_server_(context, *this, engine_logger_)
+	, telemetry_(new telemetry(*this, server_settings_.lock()->admin.telemetry_interval))
 	, instance_id_(fz::random_bytes(32))
 {
 	log_forwarder_->set_all(fz::logmsg::type(~0));
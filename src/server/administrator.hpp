@@ -40,6 +40,7 @@ public:
 				  fz::tcp::automatically_serializable_binary_address_list &disallowed_ips,
 				  fz::tcp::automatically_serializable_binary_address_list &allowed_ips,
 				  fz::authentication::autobanner &autobanner,
+				  fz::rate_limit::fair_share_scheduler &bandwidth_scheduler,
 				  fz::authentication::file_based_authenticator &authenticator,
 				  fz::util::xml_archiver<server_settings> &server_settings,
 				  fz::acme::daemon &acme,
@@ -70,6 +71,7 @@ private:
 	auto operator()(administration::ban_ip &&);
 	auto operator()(administration::end_sessions &&v);
 	auto operator()(administration::session::solicit_info &&v, administration::engine::session &session);
+	auto operator()(administration::session::subscribe_telemetry &&v, administration::engine::session &session);
 	auto operator()(administration::get_groups_and_users &&v);
 	auto operator()(administration::set_groups_and_users &&v);
 	auto operator()(administration::get_ip_filters &&v);
@@ -78,9 +80,13 @@ private:
 	auto operator()(administration::set_ftp_options &&v);
 	auto operator()(administration::get_protocols_options &&v);
 	auto operator()(administration::set_protocols_options &&v);
+	auto operator()(administration::get_bandwidth_usage &&v);
+	auto operator()(administration::get_metrics &&v);
+	auto operator()(administration::get_event_loops_summary &&v);
 	auto operator()(administration::get_admin_options &&v, administration::engine::session &session);
 	auto operator()(administration::set_admin_options &&v, administration::engine::session &session);
 	auto operator()(administration::get_logger_options &&v);
+	auto operator()(administration::get_session_log &&v, administration::engine::session &session);
 	auto operator()(administration::set_logger_options &&v);
 	auto operator()(administration::get_acme_options &&v);
 	auto operator()(administration::set_acme_options &&v);
@@ -129,6 +135,7 @@ private:
 	class notifier;
 	class update_checker;
 	class ftp_test_creator;
+	class telemetry;
 
 	std::unique_ptr<fz::tcp::session::notifier> make_notifier(fz::ftp::session::id id, const fz::datetime &start, const std::string &peer_ip, fz::address_type peer_address_type, fz::logger_interface &logger) override;
 
@@ -158,6 +165,7 @@ private:
 	fz::tcp::automatically_serializable_binary_address_list &disallowed_ips_;
 	fz::tcp::automatically_serializable_binary_address_list &allowed_ips_;
 	fz::authentication::autobanner &autobanner_;
+	fz::rate_limit::fair_share_scheduler &bandwidth_scheduler_;
 	fz::authentication::file_based_authenticator &authenticator_;
 	fz::util::xml_archiver<server_settings> &server_settings_;
 	fz::acme::daemon &acme_;
@@ -171,6 +179,7 @@ private:
 	fz::util::invoker_handler invoke_later_;
 
 	administration::engine::server admin_server_;
+	std::unique_ptr<telemetry> telemetry_;
 
 	fz::blob_obfuscator blob_obfuscator_;
 	std::vector<uint8_t> instance_id_;
@@ -196,9 +205,13 @@ FZ_RMP_INSTANTIATE_EXTERNALLY_DISPATCHING_FOR(administration::engine, administra
 
 FZ_RMP_INSTANTIATE_EXTERNALLY_DISPATCHING_FOR(administration::engine, administrator, administration::get_protocols_options);
 FZ_RMP_INSTANTIATE_EXTERNALLY_DISPATCHING_FOR(administration::engine, administrator, administration::set_protocols_options);
+FZ_RMP_INSTANTIATE_EXTERNALLY_DISPATCHING_FOR(administration::engine, administrator, administration::get_bandwidth_usage);
+FZ_RMP_INSTANTIATE_EXTERNALLY_DISPATCHING_FOR(administration::engine, administrator, administration::get_metrics);
+FZ_RMP_INSTANTIATE_EXTERNALLY_DISPATCHING_FOR(administration::engine, administrator, administration::get_event_loops_summary);
 
 FZ_RMP_INSTANTIATE_EXTERNALLY_DISPATCHING_FOR(administration::engine, administrator, administration::get_logger_options);
 FZ_RMP_INSTANTIATE_EXTERNALLY_DISPATCHING_FOR(administration::engine, administrator, administration::set_logger_options);
+FZ_RMP_INSTANTIATE_EXTERNALLY_DISPATCHING_FOR(administration::engine, administrator, administration::get_session_log);
 
 FZ_RMP_INSTANTIATE_EXTERNALLY_DISPATCHING_FOR(administration::engine, administrator, administration::get_acme_options);
 FZ_RMP_INSTANTIATE_EXTERNALLY_DISPATCHING_FOR(administration::engine, administrator, administration::set_acme_options);
@@ -221,6 +234,8 @@ FZ_RMP_INSTANTIATE_EXTERNALLY_DISPATCHING_FOR(administration::engine, administra
 FZ_RMP_INSTANTIATE_EXTERNALLY_DISPATCHING_FOR(administration::engine, administrator, administration::retrieve_update_raw_data::response);
 #endif
 
+FZ_RMP_INSTANTIATE_EXTERNALLY_DISPATCHING_FOR(administration::engine, administrator, administration::session::subscribe_telemetry);
+
 FZ_RMP_INSTANTIATE_EXTERNALLY_DISPATCHING_FOR(administration::engine, administrator, administration::create_ftp_test_environment);
 FZ_RMP_INSTANTIATE_EXTERNALLY_DISPATCHING_FOR(administration::engine, administrator, administration::destroy_ftp_test_environment);
 
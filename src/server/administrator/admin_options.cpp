@@ -1,4 +1,5 @@
 #include "../administrator.hpp"
+#include "telemetry.hpp"
 
 auto administrator::operator()(administration::set_admin_options &&v, administration::engine::session &session)
 {
@@ -42,6 +43,8 @@ void administrator::set_admin_options(server_settings::admin_options &&opts)
 		set_acme_certificate_for_renewal(get_admin_cert, false);
 		server_settings->admin = std::move(opts);
 		set_acme_certificate_for_renewal(get_admin_cert, true);
+
+		telemetry_->set_interval(server_settings->admin.telemetry_interval);
 	}
 
 	handle_new_admin_settings();
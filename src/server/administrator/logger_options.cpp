@@ -1,4 +1,5 @@
 #include "../administrator.hpp"
+#include "../../filezilla/logger/archiver.hpp"
 
 auto administrator::operator()(administration::set_logger_options &&v)
 {
@@ -17,6 +18,44 @@ auto administrator::operator()(administration::get_logger_options &&v)
 	return v.success(server_settings_.lock()->logger);
 }
 
+auto administrator::operator()(administration::get_session_log &&v, administration::engine::session &session)
+{
+	auto && [session_id, from, to] = std::move(v).tuple();
+
+	// Using a separate thread because reading the logs can take some time and we don't wanna stall the server.
+	server_context_.pool().spawn([sa = shared_self_, id = session.get_id(), files = file_logger_.log_files(), f = fz::logger::archiver::filter{session_id, from, to}] {
+		// Leave room in the admin buffer for the rest of the message.
+		static constexpr std::size_t max_size = administration::buffer_size_after_login / 2;
+
+		std::vector<std::string> lines;
+		std::size_t size = 0;
+		bool truncated = false;
+
+		for (auto &file: files) {
+			fz::logger::archiver::search(file, f, [&](std::string_view line) {
+				if (size + line.size() > max_size) {
+					truncated = true;
+					return false;
+				}
+
+				size += line.size();
+				lines.emplace_back(line);
+
+				return true;
+			});
+
+			if (truncated)
+				break;
+		}
+
+		auto a = sa.lock();
+		if (!a)
+			return;
+
+		if (auto s = a->admin_server_.get_session(id))
+			s->send<administration::get_session_log::response>(std::move(lines), truncated);
+	}).detach();
+}
 
 void administrator::set_logger_options(fz::logger::file::options &&opts)
 {
@@ -29,3 +68,4 @@ void administrator::set_logger_options(fz::logger::file::options &&opts)
 
 FZ_RMP_INSTANTIATE_HERE_DISPATCHING_FOR(administration::engine, administrator, administration::get_logger_options);
 FZ_RMP_INSTANTIATE_HERE_DISPATCHING_FOR(administration::engine, administrator, administration::set_logger_options);
+FZ_RMP_INSTANTIATE_HERE_DISPATCHING_FOR(administration::engine, administrator, administration::get_session_log);
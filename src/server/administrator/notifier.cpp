@@ -30,6 +30,8 @@ administrator::notifier::~notifier()
 
 	ADMINISTRATOR_DEBUG_LOG(L"%s - ns: %d", __PRETTY_FUNCTION__, num_of_sessions);
 
+	administrator_->telemetry_->forget_session(session_id_);
+
 	if (num_of_sessions > 0)
 		administrator_->admin_server_.broadcast<administration::session::stop>(session_id_, fz::monotonic_clock::now()-monotonic_start_);
 }
@@ -65,7 +67,7 @@ void administrator::notifier::notify_entry_open(std::uint64_t id, std::string_vi
 
 	auto &e = entries_[id];
 	e.path = path;
-	e.size = size;
+	e.size.store(size, std::memory_order_relaxed);
 	e.open_time_ = fz::monotonic_clock::now()-monotonic_start_;
 
 	if (num_of_sessions > 0)
@@ -83,7 +85,24 @@ void administrator::notifier::notify_entry_close(std::uint64_t id, int error)
 
 	ADMINISTRATOR_DEBUG_LOG(L"%s - ns: %d", __PRETTY_FUNCTION__, num_of_sessions);
 
-	entries_.erase(id);
+	std::optional<telemetry::sample> last;
+
+	if (auto it = entries_.find(id); it != entries_.end()) {
+		auto &e = it->second;
+
+		last.emplace();
+		last->session_id = session_id_;
+		last->user_name = user_name_;
+		last->since_start = fz::monotonic_clock::now() - monotonic_start_;
+		last->entries.push_back({
+			id, e.written.load(std::memory_order_relaxed), e.read.load(std::memory_order_relaxed), e.size.load(std::memory_order_relaxed)
+		});
+
+		entries_.erase(it);
+	}
+
+	// The subscribers get the amounts the entry was left with before they're told it's closed.
+	administrator_->telemetry_->forget_entry(session_id_, id, last);
 
 	if (num_of_sessions > 0) {
 		auto now = fz::monotonic_clock::now()-monotonic_start_;
@@ -93,53 +112,31 @@ void administrator::notifier::notify_entry_close(std::uint64_t id, int error)
 
 void administrator::notifier::notify_entry_write(std::uint64_t id, std::int64_t amount, std::int64_t offset)
 {
-	fz::scoped_lock lock(mutex_);
-
-	if (!administrator_)
-		return;
-
 	if (amount < 0)
 		return;
 
+	// This is invoked for every chunk of data transferred: the entry is only looked up and its counters updated,
+	// the telemetry collects them on its own tick. No locking is needed, since only this thread modifies entries_.
 	auto it = entries_.find(id);
 	if (it == entries_.end())
 		return;
 
 	auto &e = it->second;
 
-	auto num_of_sessions = administrator_->admin_server_.get_number_of_sessions();
-
-	ADMINISTRATOR_DEBUG_LOG(L"%s - ns: %d", __PRETTY_FUNCTION__, num_of_sessions);
-
-	auto now = fz::monotonic_clock::now()-monotonic_start_;
-
-	if (e.size >= 0) {
+	if (auto size = e.size.load(std::memory_order_relaxed); size >= 0) {
 		if (offset < 0)
-			offset = e.size;
+			offset = size;
 
-		e.size = std::max(e.size, offset + amount);
+		if (offset + amount > size)
+			e.size.store(offset + amount, std::memory_order_relaxed);
 	}
 
-	e.last_written_time_ = now;
-	e.written += amount;
-
-	if (num_of_sessions > 0) {
-		bool must_report = !e.last_reported_written_time_ || (now - e.last_reported_written_time_).get_milliseconds() >= 200;
-
-		if (must_report) {
-			e.last_reported_written_time_ = now;
-			administrator_->admin_server_.broadcast<administration::session::entry_written>(session_id_, now, id, e.written, e.size);
-		}
-	}
+	e.written.store(e.written.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+	changed_.store(true, std::memory_order_release);
 }
 
 void administrator::notifier::notify_entry_read(std::uint64_t id, std::int64_t amount, std::int64_t)
 {
-	fz::scoped_lock lock(mutex_);
-
-	if (!administrator_)
-		return;
-
 	if (amount < 0)
 		return;
 
@@ -149,22 +146,44 @@ void administrator::notifier::notify_entry_read(std::uint64_t id, std::int64_t a
 
 	auto &e = it->second;
 
-	auto num_of_sessions = administrator_->admin_server_.get_number_of_sessions();
+	e.read.store(e.read.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+	changed_.store(true, std::memory_order_release);
+}
 
-	ADMINISTRATOR_DEBUG_LOG(L"%s - ns: %d", __PRETTY_FUNCTION__, num_of_sessions);
+void administrator::notifier::collect(fz::monotonic_clock now, bool all, std::vector<telemetry::sample> &samples)
+{
+	if (!changed_.exchange(false, std::memory_order_acquire) && !all)
+		return;
 
-	auto now = fz::monotonic_clock::now()-monotonic_start_;
+	fz::scoped_lock lock(mutex_);
 
-	e.last_read_time_ = now;
-	e.read += amount;
+	telemetry::sample *s = nullptr;
 
-	if (num_of_sessions > 0) {
-		bool must_report = !e.last_reported_read_time_ || (now - e.last_reported_read_time_).get_milliseconds() >= 200;
+	for (auto &[id, e]: entries_) {
+		auto written = e.written.load(std::memory_order_relaxed);
+		auto read = e.read.load(std::memory_order_relaxed);
+
+		bool written_changed = written != e.collected_written;
+		bool read_changed = read != e.collected_read;
+
+		if (!all && !written_changed && !read_changed)
+			continue;
 
-		if (must_report) {
-			e.last_reported_read_time_ = now;
-			administrator_->admin_server_.broadcast<administration::session::entry_read>(session_id_, now, id, e.read);
+		if (!s) {
+			s = &samples.emplace_back();
+			s->session_id = session_id_;
+			s->user_name = user_name_;
+			s->since_start = now - monotonic_start_;
 		}
+
+		s->entries.push_back({
+			id, written, read, e.size.load(std::memory_order_relaxed),
+			(written - e.collected_written) + (read - e.collected_read),
+			written_changed, read_changed
+		});
+
+		e.collected_written = written;
+		e.collected_read = read;
 	}
 }
 
@@ -215,14 +234,18 @@ void administrator::notifier::send_session_info(administration::engine::session
 	if (proto_info_)
 		session.send<administration::session::protocol_info>(session_id_, proto_info_set_time_,*proto_info_);
 
+	auto now = fz::monotonic_clock::now()-monotonic_start_;
+
 	for (auto &[id, e]: entries_) {
-		session.send<administration::session::entry_open>(session_id_, e.open_time_, id, e.path, e.size);
+		auto size = e.size.load(std::memory_order_relaxed);
+
+		session.send<administration::session::entry_open>(session_id_, e.open_time_, id, e.path, size);
 
-		if (e.last_written_time_)
-			session.send<administration::session::entry_written>(session_id_, e.last_written_time_, id, e.written, e.size);
+		if (auto written = e.written.load(std::memory_order_relaxed))
+			session.send<administration::session::entry_written>(session_id_, now, id, written, size);
 
-		if (e.last_read_time_)
-			session.send<administration::session::entry_read>(session_id_, e.last_read_time_, id, e.read);
+		if (auto read = e.read.load(std::memory_order_relaxed))
+			session.send<administration::session::entry_read>(session_id_, now, id, read);
 	}
 }
 
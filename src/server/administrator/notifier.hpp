@@ -1,7 +1,10 @@
 #ifndef ADMINISTRATOR_NOTIFIER_HPP
 #define ADMINISTRATOR_NOTIFIER_HPP
 
+#include <atomic>
+
 #include "administrator.hpp"
+#include "telemetry.hpp"
 
 class administrator::log_forwarder: public fz::logger::modularized {
 public:
@@ -39,6 +42,9 @@ public:
 	void send_session_info(administration::engine::session &session) const;
 	void detach_from_administrator();
 
+	/// Appends to \p samples the entries whose amounts changed since the previous collection, or all of them if \p all is true.
+	void collect(fz::monotonic_clock now, bool all, std::vector<telemetry::sample> &samples);
+
 private:
 	administrator *administrator_;
 
@@ -51,20 +57,22 @@ private:
 	std::string user_name_;
 	fz::duration user_name_set_time_{};
 
+	// The counters are only ever updated by the session's own thread, the collector just reads them.
 	struct entry {
 		std::string path{};
-		int64_t size{};
-		int64_t written{};
-		int64_t read{};
 		fz::duration open_time_{};
-		fz::duration last_written_time_{};
-		fz::duration last_read_time_{};
 
-		fz::duration last_reported_written_time_{};
-		fz::duration last_reported_read_time_{};
+		std::atomic<std::int64_t> size{};
+		std::atomic<std::int64_t> written{};
+		std::atomic<std::int64_t> read{};
+
+		std::int64_t collected_written{};
+		std::int64_t collected_read{};
 	};
 
+	// Only modified by the session's thread, with the mutex held.
 	std::map<std::uint64_t, entry> entries_;
+	std::atomic<bool> changed_{};
 
 	std::optional<administration::session::any_protocol_info> proto_info_;
 	fz::duration proto_info_set_time_;
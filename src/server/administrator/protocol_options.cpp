@@ -18,6 +18,26 @@ auto administrator::operator()(administration::get_protocols_options &&v)
 	return v.success(s->protocols);
 }
 
+auto administrator::operator()(administration::get_bandwidth_usage &&v)
+{
+	return v.success(bandwidth_scheduler_.get_stats());
+}
+
+auto administrator::operator()(administration::get_metrics &&v)
+{
+	return v.success(fz::metrics::registry::global().collect());
+}
+
+auto administrator::operator()(administration::get_event_loops_summary &&v)
+{
+	std::vector<fz::event_loop_monitor::loop_summary> loops;
+
+	if (auto monitor = loop_pool_.get_monitor())
+		loops = monitor->get_summary();
+
+	return v.success(std::move(loops));
+}
+
 void administrator::set_protocols_options(server_settings::protocols_options &&opts)
 {
 	auto server_settings = server_settings_.lock();
@@ -25,10 +45,18 @@ void administrator::set_protocols_options(server_settings::protocols_options &&o
 	auto &p = server_settings->protocols = std::move(opts);
 
 	autobanner_.set_options(p.autobanner);
+	bandwidth_scheduler_.set_options(p.bandwidth);
+	authenticator_.set_credentials_cache_options(p.credentials_cache);
 	loop_pool_.set_max_num_of_loops(p.performance.number_of_session_threads);
+	if (auto monitor = loop_pool_.get_monitor())
+		monitor->set_options(p.performance.event_loop_monitor);
 	ftp_server_.set_data_buffer_sizes(p.performance.receive_buffer_size, p.performance.send_buffer_size);
 	ftp_server_.set_timeouts(p.timeouts.login_timeout, p.timeouts.activity_timeout);
+	ftp_server_.set_hostname_cache_options(p.hostname_cache);
 }
 
 FZ_RMP_INSTANTIATE_HERE_DISPATCHING_FOR(administration::engine, administrator, administration::get_protocols_options);
 FZ_RMP_INSTANTIATE_HERE_DISPATCHING_FOR(administration::engine, administrator, administration::set_protocols_options);
+FZ_RMP_INSTANTIATE_HERE_DISPATCHING_FOR(administration::engine, administrator, administration::get_bandwidth_usage);
+FZ_RMP_INSTANTIATE_HERE_DISPATCHING_FOR(administration::engine, administrator, administration::get_metrics);
+FZ_RMP_INSTANTIATE_HERE_DISPATCHING_FOR(administration::engine, administrator, administration::get_event_loops_summary);
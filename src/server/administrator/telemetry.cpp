@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <limits>
+
+#include "telemetry.hpp"
+#include "notifier.hpp"
+
+administrator::telemetry::telemetry(administrator &admin, fz::duration interval)
+	: fz::event_handler(admin.server_context_.loop())
+	, admin_(admin)
+	, last_collection_(fz::monotonic_clock::now())
+{
+	set_interval(interval);
+}
+
+administrator::telemetry::~telemetry()
+{
+	remove_handler();
+}
+
+void administrator::telemetry::set_interval(fz::duration interval)
+{
+	auto const min_interval = fz::duration::from_milliseconds(10);
+
+	if (interval < min_interval)
+		interval = min_interval;
+
+	fz::scoped_lock lock(mutex_);
+
+	stop_timer(timer_id_);
+	timer_id_ = add_timer(interval, false);
+}
+
+void administrator::telemetry::subscribe(administration::engine::session::id id, administration::session::telemetry_filter &&filter)
+{
+	fz::scoped_lock lock(mutex_);
+
+	auto &s = subscribers_[id];
+	s.filter = std::move(filter);
+	s.needs_keyframe = true;
+}
+
+void administrator::telemetry::unsubscribe(administration::engine::session::id id)
+{
+	fz::scoped_lock lock(mutex_);
+
+	subscribers_.erase(id);
+}
+
+void administrator::telemetry::resync(administration::engine::session::id id)
+{
+	fz::scoped_lock lock(mutex_);
+
+	if (auto it = subscribers_.find(id); it != subscribers_.end())
+		it->second.needs_keyframe = true;
+}
+
+void administrator::telemetry::forget_entry(fz::ftp::session::id session_id, std::uint64_t entry_id, const std::optional<sample> &last)
+{
+	std::map<administration::engine::session::id, administration::session::session_delta> flushes;
+	fz::duration interval;
+
+	{
+		fz::scoped_lock lock(mutex_);
+
+		forgotten_entries_.insert({session_id, entry_id});
+		interval = fz::monotonic_clock::now() - last_collection_;
+
+		for (auto &[id, s]: subscribers_) {
+			auto it = s.reported.find({session_id, entry_id});
+
+			// Those waiting for a keyframe never heard of the entry.
+			if (last && !s.needs_keyframe && matches(s.filter, *last)) {
+				for (auto &e: last->entries) {
+					std::int64_t written = it != s.reported.end() ? it->second.first : 0;
+					std::int64_t read = it != s.reported.end() ? it->second.second : 0;
+
+					if (e.written != written || e.read != read)
+						flushes[id] = {session_id, last->since_start, {{e.id, e.written - written, e.read - read, e.size}}};
+				}
+			}
+
+			if (it != s.reported.end())
+				s.reported.erase(it);
+		}
+	}
+
+	if (flushes.empty())
+		return;
+
+	admin_.admin_server_.iterate_over_sessions([&](administration::engine::session &session) {
+		if (auto it = flushes.find(session.get_id()); it != flushes.end())
+			session.send<administration::session::telemetry>(interval, false, std::vector{std::move(it->second)});
+
+		return true;
+	});
+}
+
+void administrator::telemetry::forget_session(fz::ftp::session::id session_id)
+{
+	fz::scoped_lock lock(mutex_);
+
+	forgotten_sessions_.insert(session_id);
+
+	for (auto &[_, s]: subscribers_) {
+		s.reported.erase(
+			s.reported.lower_bound({session_id, 0}),
+			s.reported.upper_bound({session_id, std::numeric_limits<std::uint64_t>::max()})
+		);
+	}
+}
+
+bool administrator::telemetry::matches(const administration::session::telemetry_filter &filter, const sample &s)
+{
+	if (!filter.session_ids.empty() && std::find(filter.session_ids.begin(), filter.session_ids.end(), s.session_id) == filter.session_ids.end())
+		return false;
+
+	if (!filter.user_names.empty() && std::find(filter.user_names.begin(), filter.user_names.end(), s.user_name) == filter.user_names.end())
+		return false;
+
+	return true;
+}
+
+void administrator::telemetry::operator()(const fz::event_base &ev)
+{
+	fz::dispatch<fz::timer_event>(ev, this, &telemetry::on_timer);
+}
+
+void administrator::telemetry::on_timer(fz::timer_id)
+{
+	{
+		fz::scoped_lock lock(mutex_);
+
+		forgotten_entries_.clear();
+		forgotten_sessions_.clear();
+	}
+
+	if (admin_.admin_server_.get_number_of_sessions() == 0)
+		return;
+
+	bool keyframe = false;
+
+	{
+		fz::scoped_lock lock(mutex_);
+
+		for (auto &[_, s]: subscribers_)
+			keyframe |= s.needs_keyframe;
+	}
+
+	auto now = fz::monotonic_clock::now();
+	fz::duration elapsed;
+
+	{
+		fz::scoped_lock lock(mutex_);
+
+		elapsed = now - last_collection_;
+		last_collection_ = now;
+	}
+
+	std::vector<sample> samples;
+
+	admin_.ftp_server_.iterate_over_sessions({}, [&](fz::ftp::session &s) {
+		auto notifier = static_cast<administrator::notifier *>(s.get_notifier());
+		if (notifier)
+			notifier->collect(now, keyframe, samples);
+
+		return true;
+	});
+
+	if (samples.empty() && !keyframe)
+		return;
+
+	struct report
+	{
+		bool is_keyframe{};
+		std::vector<administration::session::session_delta> sessions{};
+	};
+
+	std::map<administration::engine::session::id, report> reports;
+
+	{
+		fz::scoped_lock lock(mutex_);
+
+		for (auto &[id, sub]: subscribers_) {
+			auto &r = reports[id];
+
+			// Those that subscribed after the collection get their keyframe on the next tick.
+			r.is_keyframe = keyframe && sub.needs_keyframe;
+
+			if (r.is_keyframe) {
+				sub.needs_keyframe = false;
+				sub.reported.clear();
+			}
+
+			for (auto &s: samples) {
+				if (!matches(sub.filter, s) || forgotten_sessions_.count(s.session_id))
+					continue;
+
+				administration::session::session_delta *d = nullptr;
+
+				for (auto &e: s.entries) {
+					// Closed while being collected: its forget_entry() already came, nothing must re-insert it.
+					if (forgotten_entries_.count({s.session_id, e.id}))
+						continue;
+
+					if (!r.is_keyframe) {
+						if (!e.written_changed && !e.read_changed)
+							continue;
+
+						// What's left out is accumulated in the next delta.
+						if (sub.filter.min_rate > 0 && e.transferred * 1000 < sub.filter.min_rate * elapsed.get_milliseconds())
+							continue;
+					}
+
+					if (!d)
+						d = &r.sessions.emplace_back(administration::session::session_delta{s.session_id, s.since_start, {}});
+
+					auto &[written, read] = sub.reported[{s.session_id, e.id}];
+					d->entries.push_back({e.id, e.written - written, e.read - read, e.size});
+
+					written = e.written;
+					read = e.read;
+				}
+			}
+		}
+	}
+
+	admin_.admin_server_.iterate_over_sessions([&](administration::engine::session &session) {
+		if (auto it = reports.find(session.get_id()); it != reports.end()) {
+			auto &r = it->second;
+
+			if (r.is_keyframe || !r.sessions.empty())
+				session.send<administration::session::telemetry>(elapsed, r.is_keyframe, std::move(r.sessions));
+
+			return true;
+		}
+
+		// Clients that didn't subscribe keep getting a message per changed entry.
+		for (auto &s: samples) {
+			for (auto &e: s.entries) {
+				if (e.written_changed)
+					session.send<administration::session::entry_written>(s.session_id, s.since_start, e.id, e.written, e.size);
+
+				if (e.read_changed)
+					session.send<administration::session::entry_read>(s.session_id, s.since_start, e.id, e.read);
+			}
+		}
+
+		return true;
+	});
+}
+
+auto administrator::operator()(administration::session::subscribe_telemetry &&v, administration::engine::session &session)
+{
+	auto &&[subscribe, filter] = std::move(v).tuple();
+
+	if (subscribe)
+		telemetry_->subscribe(session.get_id(), std::move(filter));
+	else
+		telemetry_->unsubscribe(session.get_id());
+
+	return v.success();
+}
+
+FZ_RMP_INSTANTIATE_HERE_DISPATCHING_FOR(administration::engine, administrator, administration::session::subscribe_telemetry);
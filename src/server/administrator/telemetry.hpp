@@ -0,0 +1,81 @@
+#ifndef ADMINISTRATOR_TELEMETRY_HPP
+#define ADMINISTRATOR_TELEMETRY_HPP
+
+#include <optional>
+#include <set>
+
+#include "administrator.hpp"
+
+/// Reports the progress of the transfers to the administration clients, on a single tick.
+///
+/// The notifiers of the sessions only update their counters: on each tick the entries that changed are collected
+/// and sent as a single telemetry message to each subscribed client, or as entry_written/entry_read messages to the other clients.
+class administrator::telemetry: public fz::event_handler
+{
+public:
+	struct sample
+	{
+		struct entry
+		{
+			std::uint64_t id{};
+			std::int64_t written{};
+			std::int64_t read{};
+			std::int64_t size{};
+			std::int64_t transferred{}; ///< Since the previous collection.
+			bool written_changed{};
+			bool read_changed{};
+		};
+
+		fz::ftp::session::id session_id{};
+		std::string user_name{};
+		fz::duration since_start{};
+		std::vector<entry> entries{};
+	};
+
+	telemetry(administrator &admin, fz::duration interval);
+	~telemetry() override;
+
+	void set_interval(fz::duration interval);
+
+	void subscribe(administration::engine::session::id id, administration::session::telemetry_filter &&filter);
+	void unsubscribe(administration::engine::session::id id);
+
+	/// The next telemetry sent to the client will be a keyframe.
+	void resync(administration::engine::session::id id);
+
+	/// If the \p last sample of the entry is given, the subscribers first get what it transferred since it was last reported to them,
+	/// which the min_rate filter or the timing of the ticks might have held back.
+	void forget_entry(fz::ftp::session::id session_id, std::uint64_t entry_id, const std::optional<sample> &last = {});
+	void forget_session(fz::ftp::session::id session_id);
+
+private:
+	void operator()(const fz::event_base &ev) override;
+	void on_timer(fz::timer_id);
+
+	using entry_key = std::pair<fz::ftp::session::id, std::uint64_t /*entry_id*/>;
+
+	struct subscriber
+	{
+		administration::session::telemetry_filter filter{};
+		bool needs_keyframe = true;
+
+		/// The written and read amounts last reported to the client, the deltas are relative to them.
+		std::map<entry_key, std::pair<std::int64_t, std::int64_t>> reported{};
+	};
+
+	static bool matches(const administration::session::telemetry_filter &filter, const sample &s);
+
+	administrator &admin_;
+
+	fz::timer_id timer_id_{};
+
+	fz::mutex mutex_;
+	fz::monotonic_clock last_collection_;
+	std::map<administration::engine::session::id, subscriber> subscribers_;
+
+	/// What was forgotten since the current collection started: the samples might still hold it, but it mustn't be reported again.
+	std::set<entry_key> forgotten_entries_;
+	std::set<fz::ftp::session::id> forgotten_sessions_;
+};
+
+#endif // ADMINISTRATOR_TELEMETRY_HPP
@@ -16,8 +16,10 @@
 #include "../filezilla/serialization/archives/xml.hpp"
 #include "../filezilla/serialization/archives/argv.hpp"
 #include "../filezilla/known_paths.hpp"
+#include "../filezilla/metrics/registry.hpp"
 #include "../filezilla/service.hpp"
 #include "../filezilla/util/io.hpp"
+#include "../filezilla/util/binary_snapshot.hpp"
 #include "../filezilla/util/dispatcher.hpp"
 #include "../filezilla/util/tools.hpp"
 #include "../filezilla/build_info.hpp"
@@ -94,6 +96,26 @@ namespace {
 		return logmsg == fz::logmsg::error ? EXIT_FAILURE : EXIT_SUCCESS;
 	}
 
+	// Whether the command line adds or overrides any of the users or groups, in which case they must come from the XML files.
+	template <typename Char>
+	bool users_or_groups_on_command_line(int argc, Char *argv[])
+	{
+		static constexpr std::string_view options[] = { "--user", "--group", "--default_impersonator" };
+
+		for (int i = 1; i < argc; ++i) {
+			auto arg = fz::to_utf8(argv[i]);
+
+			for (auto o: options) {
+				if (arg.size() >= o.size() && std::string_view(arg).substr(0, o.size()) == o) {
+					if (arg.size() == o.size() || std::string_view(".+@:=").find(arg[o.size()]) != std::string_view::npos)
+						return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
 	std::vector<fz::rmp::address_info> sorted_admin_listeners(const server_settings::admin_options &admin)
 	{
 		auto admin_listeners = admin.additional_address_info_list;
@@ -351,11 +373,30 @@ int FZ_SERVICE_PROGRAM_MAIN(argc, argv) {
 		std::vector<fz::native_string> backups_made;
 		bool verify_errors_ignored{};
 
+		// Parsing big users and groups files takes long, so they're loaded from their binary snapshot if it still matches them.
+		// It's not used when the configuration files are being checked, nor when the command line has a say on the users or groups.
+		bool use_users_snapshot = config_version_check.empty() && !users_or_groups_on_command_line(argc, argv);
+
+		fz::util::binary_snapshot users_snapshot(
+			config_paths.users_and_groups_snapshot(fz::file::writing),
+			{ config_paths.groups(fz::file::reading), config_paths.users(fz::file::reading) },
+			logger
+		);
+
+		fz::metrics::stopwatch users_load_time;
+		fz::authentication::file_based_authenticator::groups snapshot_groups;
+		fz::authentication::file_based_authenticator::users snapshot_users;
+
+		bool users_from_snapshot = use_users_snapshot && users_snapshot.load(snapshot_groups, snapshot_users);
+
+		if (users_from_snapshot)
+			fz::authentication::file_based_authenticator::report_load_time(logger, true, users_load_time.elapsed_us(), snapshot_groups, snapshot_users);
+
 		{
 			argv_input_archive ar{argc, argv, {
 				{ config_paths.settings(fz::file::reading), true },
-				{ config_paths.groups(fz::file::reading), false },
-				{ config_paths.users(fz::file::reading), true },
+				{ users_from_snapshot ? fz::native_string() : config_paths.groups(fz::file::reading), false },
+				{ users_from_snapshot ? fz::native_string() : config_paths.users(fz::file::reading), true },
 				{ config_paths.disallowed_ips(fz::file::reading), false },
 				{ config_paths.allowed_ips(fz::file::reading), false }
 			}, verify_version, &backups_made, &verify_errors_ignored};
@@ -390,6 +431,19 @@ int FZ_SERVICE_PROGRAM_MAIN(argc, argv) {
 			}
 		}
 
+		if (users_from_snapshot) {
+			groups = std::move(snapshot_groups);
+			users = std::move(snapshot_users);
+		}
+		else
+		if (use_users_snapshot) {
+			// The time includes the parsing of the other configuration files, which are comparatively small.
+			fz::authentication::file_based_authenticator::report_load_time(logger, false, users_load_time.elapsed_us(), groups, users);
+
+			if (!verify_errors_ignored)
+				users_snapshot.save(groups, users);
+		}
+
 		if (int res = config_checks_result(config_version_check, config_version_check_result_file, true, backups_made, logger); res != -1 && backups_made.empty()) {
 			if (config_version_check != "ignore" || res != EXIT_SUCCESS)
 				return res;
@@ -447,7 +501,8 @@ int FZ_SERVICE_PROGRAM_MAIN(argc, argv) {
 			return defaults_set;
 		};
 
-		fz::rate_limit_manager rate_limit_manager(server_loop);
+		fz::rate_limit::sharded_manager rate_limit_manager(server_loop);
+		fz::rate_limit::fair_share_scheduler bandwidth_scheduler(server_loop, settings.protocols.bandwidth);
 
 		if (impersonator_exe.empty()) {
 			impersonator_exe = fz::util::find_tool(fzT("filezilla-server-impersonator"), fz::util::fs::native_path(fzT("..")) / fzT("tools") / fzT("impersonator"), "FZ_SRVIMPERSONATOR");
@@ -465,7 +520,9 @@ int FZ_SERVICE_PROGRAM_MAIN(argc, argv) {
 			std::move(impersonator_exe)
 		);
 
+		file_auth.set_snapshot_path(config_paths.users_and_groups_snapshot(fz::file::writing));
 		file_auth.set_save_result_event_handler(&server_settings_save_result_catcher);
+		file_auth.set_credentials_cache_options(settings.protocols.credentials_cache);
 
 		fz::tcp::automatically_serializable_binary_address_list automatic_disallowed_ips (
 			server_loop, disallowed_ips, "disallowed_ips", config_paths.disallowed_ips(fz::file::writing), fz::duration::from_milliseconds(100), &server_settings_save_result_catcher
@@ -516,13 +573,20 @@ int FZ_SERVICE_PROGRAM_MAIN(argc, argv) {
 			}
 		}
 
-		fz::authentication::autobanner autobanner(server_loop, settings.protocols.autobanner);
-		fz::event_loop_pool loop_pool(server_loop, pool, settings.protocols.performance.number_of_session_threads);
+		fz::authentication::autobanner autobanner(settings.protocols.autobanner);
+		fz::event_loop_monitor loop_monitor(pool, logger, settings.protocols.performance.event_loop_monitor);
+		fz::event_loop_pool loop_pool(server_loop, pool, settings.protocols.performance.number_of_session_threads, &loop_monitor);
+
+		// The schedulers outlive the pool: what they keep for each of its loops must go before the loop does.
+		loop_pool.add_release_hook([&](fz::event_loop &loop) {
+			bandwidth_scheduler.release(loop);
+			rate_limit_manager.release(loop);
+		});
 		fz::port_manager port_manager;
 
 		fz::authentication::throttled_authenticator authenticator(server_loop, file_auth, file_logger);
 
-		fz::tcp::server::context context{pool, server_loop};
+		fz::tcp::server::context context{pool, server_loop, &loop_monitor};
 
 		auto admin_listeners = sorted_admin_listeners(settings.admin);
 		auto ftp_server_options = settings.ftp_server;
@@ -535,6 +599,7 @@ int FZ_SERVICE_PROGRAM_MAIN(argc, argv) {
 			context, loop_pool, logger, file_logger,
 			authenticator,
 			rate_limit_manager,
+			bandwidth_scheduler,
 			automatic_disallowed_ips, automatic_allowed_ips,
 			autobanner,
 			port_manager,
@@ -542,6 +607,7 @@ int FZ_SERVICE_PROGRAM_MAIN(argc, argv) {
 		);
 		ftp_server.set_data_buffer_sizes(settings.protocols.performance.receive_buffer_size, settings.protocols.performance.send_buffer_size);
 		ftp_server.set_timeouts(settings.protocols.timeouts.login_timeout, settings.protocols.timeouts.activity_timeout);
+		ftp_server.set_hostname_cache_options(settings.protocols.hostname_cache);
 
 		ftp_server.start();
 
@@ -589,6 +655,7 @@ int FZ_SERVICE_PROGRAM_MAIN(argc, argv) {
 			#endif
 			automatic_disallowed_ips, automatic_allowed_ips,
 			autobanner,
+			bandwidth_scheduler,
 			file_auth,
 			delayed_settings,
 			acme,
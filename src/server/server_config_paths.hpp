@@ -12,6 +12,9 @@ struct server_config_paths: fz::known_paths::config {
 	FZ_KNOWN_PATHS_CONFIG_FILE(disallowed_ips);
 	FZ_KNOWN_PATHS_CONFIG_FILE(allowed_ips);
 
+	// A binary copy of users.xml and groups.xml, which is faster to load.
+	file users_and_groups_snapshot = f(fzT("users_and_groups.snapshot"));
+
 	FZ_KNOWN_PATHS_CONFIG_DIR(certificates);
 	FZ_KNOWN_PATHS_CONFIG_DIR(update);
 	FZ_KNOWN_PATHS_CONFIG_DIR(webui);
@@ -16,7 +16,11 @@
 #include "../filezilla/serialization/types/containers.hpp"
 #include "../filezilla/serialization/types/acme.hpp"
 #include "../filezilla/serialization/types/autobanner.hpp"
+#include "../filezilla/serialization/types/fair_share_scheduler.hpp"
 #include "../filezilla/serialization/types/update.hpp"
+#include "../filezilla/serialization/types/verified_credentials_cache.hpp"
+#include "../filezilla/serialization/types/event_loop_monitor.hpp"
+#include "../filezilla/serialization/types/hostname_cache.hpp"
 #include "../filezilla/rmp/address_info.hpp"
 #include "../filezilla/serialization/types/webui_server_options.hpp"
 
@@ -37,6 +41,7 @@ struct server_settings {
 		std::vector<fz::rmp::address_info> additional_address_info_list;
 		fz::authentication::any_password   password = {};
 		fz::securable_socket::info         tls = {};
+		fz::duration                       telemetry_interval = fz::duration::from_milliseconds(200);
 
 		template <typename Archive>
 		void serialize(Archive &ar) {
@@ -47,7 +52,9 @@ struct server_settings {
 				optional_nvp(enable_local_ipv6, "enable_local_ipv6"),
 				nvp(unique(additional_address_info_list), "", "listener"),
 				optional_nvp(password, "password"),
-				optional_nvp(tls, "tls")
+				optional_nvp(tls, "tls"),
+				value_info(optional_nvp(telemetry_interval, "telemetry_interval"),
+					"How often the progress of the transfers is reported to the administration clients (fz::duration).")
 			);
 		}
 	};
@@ -61,6 +68,7 @@ struct server_settings {
 			std::uint16_t number_of_session_threads = 0;
 			std::int32_t receive_buffer_size        = -1;
 			std::int32_t send_buffer_size           = -1;
+			fz::event_loop_monitor::options event_loop_monitor{};
 
 			template <typename Archive>
 			void serialize(Archive &ar) {
@@ -77,7 +85,11 @@ struct server_settings {
 
 					value_info(optional_nvp(send_buffer_size,
 							   "send_buffer_size"),
-							   "Size of sending data socket buffer. Numbers < 0 mean use system defaults. Defaults to -1.")
+							   "Size of sending data socket buffer. Numbers < 0 mean use system defaults. Defaults to -1."),
+
+					value_info(optional_nvp(event_loop_monitor,
+							   "event_loop_monitor"),
+							   "Options for the measurement of the lag of the event loops and of the time taken by their handlers.")
 				);
 			}
 		};
@@ -105,6 +117,9 @@ struct server_settings {
 		fz::authentication::autobanner::options autobanner = {};
 		performance_options performance = {};
 		timeout_options timeouts = {};
+		fz::rate_limit::fair_share_scheduler::options bandwidth = {};
+		fz::authentication::verified_credentials_cache::options credentials_cache = {};
+		fz::tcp::hostname_cache::options hostname_cache = {};
 
 		template <typename Archive>
 		void serialize(Archive &ar) {
@@ -121,7 +136,19 @@ struct server_settings {
 
 				value_info(optional_nvp(timeouts,
 					"timeouts"),
-					"Timeout options.")
+					"Timeout options."),
+
+				value_info(optional_nvp(bandwidth,
+					"bandwidth"),
+					"Options for the fair sharing of the bandwidth among groups, users and sessions."),
+
+				value_info(optional_nvp(credentials_cache,
+					"credentials_cache"),
+					"Options for the cache of the recently verified passwords."),
+
+				value_info(optional_nvp(hostname_cache,
+					"hostname_cache"),
+					"Options for the cache of the resolved hostnames, like the PASV host override.")
 			);
 		}
 	};
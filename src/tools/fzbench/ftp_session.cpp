@@ -0,0 +1,579 @@
+#include <cctype>
+#include <cstring>
+
+#include <libfilezilla/format.hpp>
+
+#include "../../filezilla/remove_event.hpp"
+
+#include "ftp_session.hpp"
+#include "runner.hpp"
+
+namespace fz::fzbench {
+
+namespace {
+
+constexpr std::size_t data_chunk_size = 64*1024;
+
+bool is_upload(scenario s)
+{
+	return s == scenario::stor || s == scenario::churn;
+}
+
+std::string join_path(std::string_view dir, std::string_view name)
+{
+	if (dir.empty())
+		return std::string(name);
+
+	if (dir.back() == '/')
+		return fz::sprintf("%s%s", dir, name);
+
+	return fz::sprintf("%s/%s", dir, name);
+}
+
+}
+
+int ftp_session::data_sink::consume_buffer()
+{
+	auto buffer = get_buffer();
+	if (!buffer)
+		return EFAULT;
+
+	owner_.count_bytes(buffer->size());
+	owner_.touch();
+	buffer->clear();
+
+	return 0;
+}
+
+int ftp_session::data_source::add_to_buffer()
+{
+	if (!left_)
+		return ENODATA;
+
+	auto buffer = get_buffer();
+	if (!buffer)
+		return EFAULT;
+
+	if (buffer->size() >= 2*data_chunk_size)
+		return ENOBUFS;
+
+	auto size = std::size_t(std::min<std::uint64_t>(left_, data_chunk_size));
+	std::memset(buffer->get(size), 'z', size);
+	buffer->add(size);
+	left_ -= size;
+
+	owner_.count_bytes(size);
+	owner_.touch();
+
+	return 0;
+}
+
+ftp_session::ftp_session(event_loop &loop, runner &runner, fzbench::stats &stats, std::size_t index)
+	: session(loop, runner, stats)
+	, index_(index)
+	, sink_(*this)
+	, source_(*this)
+	, data_channel_(*this, 4*data_chunk_size, 5, false)
+{
+}
+
+ftp_session::~ftp_session()
+{
+	remove_handler();
+}
+
+void ftp_session::setup()
+{
+	if (runner_.get_scenario() == scenario::login)
+		return next();
+
+	connect();
+}
+
+void ftp_session::begin_operation()
+{
+	auto &opts = runner_.get_options();
+
+	switch (runner_.get_scenario()) {
+		case scenario::login:
+			return connect();
+
+		case scenario::retr:
+		case scenario::mlsd:
+			remote_file_ = opts.path;
+			break;
+
+		case scenario::stor:
+			remote_file_ = join_path(opts.path, fz::sprintf("fzbench-%d.bin", index_));
+			break;
+
+		case scenario::churn:
+			remote_file_ = join_path(opts.path, fz::sprintf("fzbench-%d-%d.dat", index_, operation_count_));
+			break;
+
+		case scenario::http:
+			return fail("Not an FTP scenario");
+	}
+
+	operation_count_ += 1;
+
+	step_ = step::epsv;
+	send_command("EPSV");
+}
+
+void ftp_session::operator()(const event_base &ev)
+{
+	if (!fz::dispatch<
+		socket_event,
+		certificate_verification_event,
+		channel::done_event
+	>(ev, this,
+		&ftp_session::on_socket_event,
+		&ftp_session::on_certificate_verification_event,
+		&ftp_session::on_channel_done_event
+	))
+		session::operator()(ev);
+}
+
+void ftp_session::on_timer(timer_id id)
+{
+	if (id == timeout_id_) {
+		timeout_id_ = {};
+		return fail("Timed out");
+	}
+
+	if (id == reconnect_id_) {
+		reconnect_id_ = {};
+
+		if (runner_.get_scenario() == scenario::login || is_stopping())
+			return next();
+
+		return connect();
+	}
+
+	session::on_timer(id);
+}
+
+void ftp_session::on_certificate_verification_event(tls_layer *tls, tls_session_info &)
+{
+	// The server is expected to use a self-signed certificate.
+	tls->set_verification_result(true);
+}
+
+void ftp_session::on_socket_event(socket_event_source *source, socket_event_flag type, int error)
+{
+	if (control_ && source->root() == control_->root()) {
+		if (error) {
+			if (step_ == step::quit) {
+				disconnect();
+				return next();
+			}
+
+			return fail(fz::sprintf("Control connection error: %s", socket_error_description(error)));
+		}
+
+		if (type == socket_event_flag::read)
+			return read_control();
+
+		if (type == socket_event_flag::connection && step_ == step::securing) {
+			step_ = step::user;
+			send_command(fz::sprintf("USER %s", runner_.get_options().user));
+			return;
+		}
+
+		// Connection events double as write events.
+		return flush_control();
+	}
+
+	if (data_ && source->root() == data_->root()) {
+		if (error) {
+			data_done_ = true;
+			data_failed_ = true;
+			return end_transfer_if_done();
+		}
+
+		if (type != socket_event_flag::connection)
+			return;
+
+		if (runner_.get_options().tls && data_->get_securable_state() == securable_socket_state::insecure) {
+			// The server wants the TLS session of the control connection to be resumed.
+			if (!data_->make_secure_client(tls_ver::v1_2, {}, {}, control_.get())) {
+				data_done_ = true;
+				data_failed_ = true;
+				return end_transfer_if_done();
+			}
+
+			return;
+		}
+
+		attach_data_channel();
+	}
+}
+
+void ftp_session::on_channel_done_event(channel &, channel::error_type error)
+{
+	if (step_ != step::transfer)
+		return;
+
+	data_done_ = true;
+
+	if (error)
+		data_failed_ = true;
+
+	end_transfer_if_done();
+}
+
+void ftp_session::connect()
+{
+	auto &opts = runner_.get_options();
+
+	control_in_.clear();
+	control_out_.clear();
+	multiline_code_ = 0;
+
+	control_ = std::make_unique<securable_socket>(event_loop_, this, std::make_unique<socket>(runner_.pool(), this), runner_.logger());
+
+	step_ = step::greeting;
+	touch();
+
+	if (int error = control_->connect(fz::to_native(opts.host), opts.port))
+		return fail(fz::sprintf("Could not connect to %s:%d: %s", opts.host, opts.port, socket_error_description(error)));
+}
+
+void ftp_session::disconnect()
+{
+	data_channel_.clear();
+	remove_events<channel::done_event>(this, data_channel_);
+	data_.reset();
+	control_.reset();
+
+	step_ = step::disconnected;
+
+	stop_timer(timeout_id_);
+	timeout_id_ = {};
+}
+
+void ftp_session::fail(std::string_view reason)
+{
+	runner_.logger().log_u(logmsg::debug_warning, L"Session %d: %s.", index_, reason);
+
+	count_error();
+	disconnect();
+
+	// Don't hammer a server that refuses the connections.
+	reconnect_id_ = add_timer(duration::from_milliseconds(100), true);
+}
+
+void ftp_session::touch()
+{
+	timeout_id_ = stop_add_timer(timeout_id_, duration::from_seconds(runner_.get_options().timeout), true);
+}
+
+void ftp_session::send_command(std::string_view cmd)
+{
+	control_out_.append(cmd);
+	control_out_.append("\r\n");
+
+	touch();
+	flush_control();
+}
+
+void ftp_session::flush_control()
+{
+	if (step_ == step::securing)
+		return;
+
+	while (control_ && control_out_.size() > 0) {
+		int error = 0;
+		int written = control_->write(control_out_.get(), static_cast<unsigned int>(control_out_.size()), error);
+
+		if (written > 0) {
+			control_out_.consume(std::size_t(written));
+			continue;
+		}
+
+		if (error != EAGAIN)
+			return fail(fz::sprintf("Could not write to the control connection: %s", socket_error_description(error)));
+
+		break;
+	}
+}
+
+void ftp_session::read_control()
+{
+	bool eof = false;
+
+	for (;;) {
+		int error = 0;
+		int read = control_->read(control_in_.get(4096), 4096, error);
+
+		if (read > 0) {
+			control_in_.add(std::size_t(read));
+			continue;
+		}
+
+		if (read == 0) {
+			eof = true;
+			break;
+		}
+
+		if (error != EAGAIN)
+			return fail(fz::sprintf("Could not read from the control connection: %s", socket_error_description(error)));
+
+		break;
+	}
+
+	// The reply handlers may close the connection.
+	while (control_) {
+		auto view = control_in_.to_view();
+
+		auto eol = view.find('\n');
+		if (eol == std::string_view::npos)
+			break;
+
+		auto line = std::string(view.substr(0, eol > 0 && view[eol - 1] == '\r' ? eol - 1 : eol));
+		control_in_.consume(eol + 1);
+
+		bool has_code = line.size() >= 3 && std::isdigit((unsigned char)line[0]) && std::isdigit((unsigned char)line[1]) && std::isdigit((unsigned char)line[2]);
+		int code = has_code ? (line[0] - '0') * 100 + (line[1] - '0') * 10 + (line[2] - '0') : 0;
+
+		if (multiline_code_) {
+			// Multiline replies end with a line that starts with the same code, followed by a space.
+			if (code == multiline_code_ && (line.size() == 3 || line[3] == ' ')) {
+				multiline_code_ = 0;
+				on_reply(code, line);
+			}
+
+			continue;
+		}
+
+		if (!has_code)
+			return fail(fz::sprintf("Malformed reply: %s", line));
+
+		if (line.size() > 3 && line[3] == '-') {
+			multiline_code_ = code;
+			continue;
+		}
+
+		on_reply(code, line);
+	}
+
+	if (eof && control_) {
+		if (step_ == step::quit) {
+			disconnect();
+			return next();
+		}
+
+		return fail("Connection closed by the server");
+	}
+}
+
+void ftp_session::on_reply(int code, std::string_view line)
+{
+	auto &opts = runner_.get_options();
+
+	touch();
+
+	// Preliminary replies, like the 150 that precedes the transfers.
+	if (code < 200)
+		return;
+
+	switch (step_) {
+		case step::greeting:
+			if (code != 220)
+				break;
+
+			if (opts.tls) {
+				step_ = step::auth;
+				return send_command("AUTH TLS");
+			}
+
+			step_ = step::user;
+			return send_command(fz::sprintf("USER %s", opts.user));
+
+		case step::auth:
+			if (code != 234)
+				break;
+
+			step_ = step::securing;
+
+			if (!control_->make_secure_client(tls_ver::v1_2))
+				return fail("Could not secure the control connection");
+
+			return;
+
+		case step::user:
+			if (code == 230)
+				return on_logged_in();
+
+			if (code != 331)
+				break;
+
+			step_ = step::pass;
+			return send_command(fz::sprintf("PASS %s", opts.password));
+
+		case step::pass:
+			if (code != 230)
+				break;
+
+			return on_logged_in();
+
+		case step::pbsz:
+			if (code != 200)
+				break;
+
+			step_ = step::prot;
+			return send_command("PROT P");
+
+		case step::prot:
+			if (code != 200)
+				break;
+
+			step_ = step::type;
+			return send_command("TYPE I");
+
+		case step::type:
+			if (code != 200)
+				break;
+
+			return on_ready();
+
+		case step::epsv:
+			if (code != 229)
+				break;
+
+			return open_data_connection(line);
+
+		case step::transfer:
+			transfer_reply_received_ = true;
+
+			if (code != 226 && code != 250) {
+				// The data connection, if any, is of no use anymore.
+				data_done_ = true;
+				data_failed_ = true;
+			}
+
+			return end_transfer_if_done();
+
+		case step::dele:
+			end_operation(code == 250);
+			return on_ready();
+
+		case step::quit:
+			disconnect();
+			return next();
+
+		case step::disconnected:
+		case step::securing:
+		case step::ready:
+			break;
+	}
+
+	fail(fz::sprintf("Unexpected reply: %s", line));
+}
+
+void ftp_session::on_logged_in()
+{
+	if (runner_.get_scenario() == scenario::login) {
+		end_operation(true);
+
+		step_ = step::quit;
+		return send_command("QUIT");
+	}
+
+	if (runner_.get_options().tls) {
+		step_ = step::pbsz;
+		return send_command("PBSZ 0");
+	}
+
+	step_ = step::type;
+	send_command("TYPE I");
+}
+
+void ftp_session::on_ready()
+{
+	step_ = step::ready;
+
+	stop_timer(timeout_id_);
+	timeout_id_ = {};
+
+	next();
+}
+
+void ftp_session::open_data_connection(std::string_view epsv_reply)
+{
+	auto &opts = runner_.get_options();
+
+	// 229 Entering Extended Passive Mode (|||port|)
+	auto begin = epsv_reply.find("(|||");
+	auto end = begin == std::string_view::npos ? begin : epsv_reply.find('|', begin + 4);
+	auto port = end == std::string_view::npos ? 0 : fz::to_integral<unsigned int>(epsv_reply.substr(begin + 4, end - begin - 4));
+
+	if (!port)
+		return fail(fz::sprintf("Malformed EPSV reply: %s", epsv_reply));
+
+	data_done_ = false;
+	data_failed_ = false;
+	transfer_reply_received_ = false;
+
+	data_ = std::make_unique<securable_socket>(event_loop_, this, std::make_unique<socket>(runner_.pool(), this), runner_.logger());
+
+	if (int error = data_->connect(fz::to_native(opts.host), port))
+		return fail(fz::sprintf("Could not open the data connection: %s", socket_error_description(error)));
+
+	step_ = step::transfer;
+
+	switch (runner_.get_scenario()) {
+		case scenario::retr:
+			return send_command(fz::sprintf("RETR %s", remote_file_));
+
+		case scenario::mlsd:
+			return send_command(remote_file_.empty() ? std::string("MLSD") : fz::sprintf("MLSD %s", remote_file_));
+
+		case scenario::stor:
+		case scenario::churn:
+			source_.reset(opts.file_size);
+			return send_command(fz::sprintf("STOR %s", remote_file_));
+
+		case scenario::login:
+		case scenario::http:
+			break;
+	}
+
+	fail("Not a transfer scenario");
+}
+
+void ftp_session::attach_data_channel()
+{
+	if (is_upload(runner_.get_scenario()))
+		data_channel_.set_buffer_adder(&source_);
+	else
+		data_channel_.set_buffer_consumer(&sink_);
+
+	data_channel_.set_socket(data_.get());
+}
+
+void ftp_session::end_transfer_if_done()
+{
+	if (!data_done_ || !transfer_reply_received_)
+		return;
+
+	data_channel_.clear();
+	remove_events<channel::done_event>(this, data_channel_);
+	data_.reset();
+
+	if (data_failed_) {
+		end_operation(false);
+		return on_ready();
+	}
+
+	if (runner_.get_scenario() == scenario::churn) {
+		step_ = step::dele;
+		return send_command(fz::sprintf("DELE %s", remote_file_));
+	}
+
+	end_operation(true);
+	on_ready();
+}
+
+}
@@ -0,0 +1,117 @@
+#ifndef FZ_TOOLS_FZBENCH_FTP_SESSION_HPP
+#define FZ_TOOLS_FZBENCH_FTP_SESSION_HPP
+
+#include <libfilezilla/buffer.hpp>
+
+#include "../../filezilla/channel.hpp"
+#include "../../filezilla/securable_socket.hpp"
+
+#include "session.hpp"
+
+namespace fz::fzbench {
+
+/// \brief An FTP client session, performing the operation of an FTP scenario.
+///
+/// Apart from the login scenario, the session logs in once and then performs its operations on the same control connection,
+/// each over a new passive data connection. Failures close the session, which logs in again after a short delay.
+class ftp_session final: public session
+{
+public:
+	ftp_session(event_loop &loop, runner &runner, fzbench::stats &stats, std::size_t index);
+	~ftp_session() override;
+
+private:
+	enum class step
+	{
+		disconnected,
+		greeting,
+		auth,
+		securing,
+		user,
+		pass,
+		pbsz,
+		prot,
+		type,
+		ready,
+		epsv,
+		transfer,
+		dele,
+		quit
+	};
+
+	/// Counts the bytes received on the data connection, and throws them away.
+	class data_sink final: public buffer_operator::consumer
+	{
+	public:
+		explicit data_sink(ftp_session &owner): owner_(owner) {}
+
+		int consume_buffer() override;
+
+	private:
+		ftp_session &owner_;
+	};
+
+	/// Provides the bytes of the uploaded files.
+	class data_source final: public buffer_operator::adder
+	{
+	public:
+		explicit data_source(ftp_session &owner): owner_(owner) {}
+
+		void reset(std::uint64_t size) { left_ = size; }
+		int add_to_buffer() override;
+
+	private:
+		ftp_session &owner_;
+		std::uint64_t left_{};
+	};
+
+	void setup() override;
+	void begin_operation() override;
+	void operator()(const event_base &ev) override;
+	void on_timer(timer_id id) override;
+
+	void on_socket_event(socket_event_source *source, socket_event_flag type, int error);
+	void on_certificate_verification_event(tls_layer *tls, tls_session_info &info);
+	void on_channel_done_event(channel &c, channel::error_type error);
+
+	void connect();
+	void disconnect();
+	void fail(std::string_view reason);
+
+	void send_command(std::string_view cmd);
+	void flush_control();
+	void read_control();
+	void on_reply(int code, std::string_view line);
+	void on_logged_in();
+	void on_ready();
+
+	void open_data_connection(std::string_view epsv_reply);
+	void attach_data_channel();
+	void end_transfer_if_done();
+	void touch();
+
+	const std::size_t index_;
+	std::uint64_t operation_count_{};
+	std::string remote_file_{};
+
+	step step_{step::disconnected};
+	timer_id timeout_id_{};
+	timer_id reconnect_id_{};
+
+	std::unique_ptr<securable_socket> control_;
+	fz::buffer control_in_;
+	fz::buffer control_out_;
+	int multiline_code_{};
+
+	data_sink sink_;
+	data_source source_;
+	std::unique_ptr<securable_socket> data_;
+	channel data_channel_;
+	bool data_done_{};
+	bool data_failed_{};
+	bool transfer_reply_received_{};
+};
+
+}
+
+#endif // FZ_TOOLS_FZBENCH_FTP_SESSION_HPP
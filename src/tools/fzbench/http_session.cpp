@@ -0,0 +1,43 @@
+#include "http_session.hpp"
+#include "runner.hpp"
+
+namespace fz::fzbench {
+
+http_session::http_session(event_loop &loop, runner &runner, fzbench::stats &stats)
+	: session(loop, runner, stats)
+	, client_(runner.pool(), loop, runner.logger(), http::client::options()
+		.cert_verifier(http::client::do_not_verify)
+		.default_timeout(duration::from_seconds(runner.get_options().timeout))
+	)
+	, uri_(runner.get_options().url)
+{
+}
+
+http_session::~http_session()
+{
+	remove_handler();
+}
+
+void http_session::begin_operation()
+{
+	client_.perform("GET", uri_).and_then([this](http::response::status status, http::response &r) {
+		return on_response(status, r);
+	});
+}
+
+int http_session::on_response(http::response::status status, http::response &r)
+{
+	if (status == http::response::got_body) {
+		count_bytes(r.body.size());
+		r.body.clear();
+	}
+	else
+	if (status == http::response::got_end) {
+		end_operation(r.code_type() == http::response::successful);
+		next();
+	}
+
+	return 0;
+}
+
+}
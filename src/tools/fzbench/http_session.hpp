@@ -0,0 +1,28 @@
+#ifndef FZ_TOOLS_FZBENCH_HTTP_SESSION_HPP
+#define FZ_TOOLS_FZBENCH_HTTP_SESSION_HPP
+
+#include "../../filezilla/http/client.hpp"
+
+#include "session.hpp"
+
+namespace fz::fzbench {
+
+/// GETs the URL over and over. Each GET is an operation.
+/// The http::client closes the connection after each response, hence every operation includes the TCP and TLS handshakes.
+class http_session final: public session
+{
+public:
+	http_session(event_loop &loop, runner &runner, fzbench::stats &stats);
+	~http_session() override;
+
+private:
+	void begin_operation() override;
+	int on_response(http::response::status status, http::response &r);
+
+	http::client client_;
+	fz::uri uri_;
+};
+
+}
+
+#endif // FZ_TOOLS_FZBENCH_HTTP_SESSION_HPP
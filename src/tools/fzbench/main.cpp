@@ -0,0 +1,126 @@
+#include <clocale>
+#include <iostream>
+
+#include <libfilezilla/format.hpp>
+#include <libfilezilla/thread_pool.hpp>
+
+#include "../../filezilla/build_info.hpp"
+#include "../../filezilla/logger/stdio.hpp"
+#include "../../filezilla/serialization/archives/argv.hpp"
+#include "../../filezilla/service.hpp"
+
+#include "runner.hpp"
+
+int FZ_SERVICE_PROGRAM_MAIN(argc, argv)
+{
+	using namespace fz::serialization;
+
+	std::setlocale(LC_ALL, "");
+
+	// Numbers must stay in the format JSON expects.
+	std::setlocale(LC_NUMERIC, "C");
+
+	fz::fzbench::options opts;
+	fz::fzbench::scenario scenario{};
+	bool print_help = false;
+
+	{
+		argv_input_archive ar{argc, argv};
+
+		ar(
+			optional_nvp{opts.scenario, "scenario"},
+			optional_nvp{opts.host, "host"},
+			optional_nvp{opts.port, "port"},
+			optional_nvp{opts.tls, "tls"},
+			optional_nvp{opts.user, "user"},
+			optional_nvp{opts.password, "password"},
+			optional_nvp{opts.path, "path"},
+			optional_nvp{opts.file_size, "file-size"},
+			optional_nvp{opts.url, "url"},
+			optional_nvp{opts.sessions, "sessions"},
+			optional_nvp{opts.threads, "threads"},
+			optional_nvp{opts.rate, "rate"},
+			optional_nvp{opts.duration, "duration"},
+			optional_nvp{opts.warmup, "warmup"},
+			optional_nvp{opts.timeout, "timeout"},
+			optional_nvp{opts.server_pid, "server-pid"},
+			optional_nvp{opts.json, "json"},
+			optional_nvp{opts.verbose, "verbose"},
+			optional_nvp{print_help, "help"}
+		).check_for_unhandled_options();
+
+		if (!ar) {
+			std::cerr << ar.error().description() << "\n";
+			print_help = true;
+		}
+		else
+		if (!fz::fzbench::from_string(opts.scenario, scenario)) {
+			std::cerr << "Unknown scenario: " << opts.scenario << "\n";
+			print_help = true;
+		}
+		else
+		if (scenario == fz::fzbench::scenario::http && opts.url.empty()) {
+			std::cerr << "The http scenario needs the --url option.\n";
+			print_help = true;
+		}
+		else
+		if ((scenario == fz::fzbench::scenario::retr) && opts.path.empty()) {
+			std::cerr << "The retr scenario needs the --path option.\n";
+			print_help = true;
+		}
+		else
+		if (!opts.sessions || opts.duration <= 0 || opts.warmup < 0 || opts.timeout <= 0 || opts.rate < 0) {
+			std::cerr << "Invalid number of sessions, rate or times.\n";
+			print_help = true;
+		}
+
+		if (print_help) {
+			std::cerr
+				<< fz::sprintf("fzbench v%s. Built for the %s flavour, on %s.", fz::build_info::version, fz::build_info::flavour, fz::build_info::datetime.get_rfc822()) << "\n"
+				<< "Usage: fzbench [options]\n"
+				<< "\n"
+				<< "  --scenario=<name>    login (default), churn, retr, stor, mlsd or http.\n"
+				<< "                         login: connect, log in and quit.\n"
+				<< "                         churn: upload a file of --file-size bytes into --path, then delete it.\n"
+				<< "                         retr:  download the file at --path.\n"
+				<< "                         stor:  upload a file of --file-size bytes into --path.\n"
+				<< "                         mlsd:  list the directory at --path.\n"
+				<< "                         http:  GET --url.\n"
+				<< "  --host=<host>        FTP server host. Default: 127.0.0.1.\n"
+				<< "  --port=<port>        FTP server port. Default: 21.\n"
+				<< "  --tls                Use explicit FTP over TLS. Any certificate is accepted, self-signed ones included.\n"
+				<< "  --user=<name>        Default: bench.\n"
+				<< "  --password=<pass>    Default: bench.\n"
+				<< "  --path=<path>        See the scenarios.\n"
+				<< "  --file-size=<bytes>  Default: 4096.\n"
+				<< "  --url=<url>          See the scenarios.\n"
+				<< "  --sessions=<n>       Concurrent sessions. Default: 10.\n"
+				<< "  --threads=<n>        Event loops the sessions are spread over. Default: as many as the CPUs.\n"
+				<< "  --rate=<ops/s>       Operations per second, over all sessions. Default: 0, as many as possible.\n"
+				<< "  --duration=<s>       Measurement window. Default: 30.\n"
+				<< "  --warmup=<s>         Time spent running before measuring. Default: 2.\n"
+				<< "  --timeout=<s>        Inactivity after which an operation fails. Default: 30.\n"
+				<< "  --server-pid=<pid>   Report the CPU used by the server process, where /proc is available.\n"
+				<< "  --json               Print the results as a single line of JSON.\n"
+				<< "  --verbose            Log what the sessions do.\n"
+				<< std::endl;
+
+			return EXIT_FAILURE;
+		}
+	}
+
+	fz::thread_pool pool;
+	fz::logger::stdio logger{stderr};
+
+	if (opts.verbose)
+		logger.set_all(fz::logmsg::type(~0));
+
+	auto report = fz::fzbench::runner(pool, logger, opts, scenario).run();
+
+	if (opts.json)
+		report.print_json();
+	else
+		report.print_text();
+
+	return report.operations > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,53 @@
+#ifndef FZ_TOOLS_FZBENCH_OPTIONS_HPP
+#define FZ_TOOLS_FZBENCH_OPTIONS_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace fz::fzbench {
+
+enum class scenario
+{
+	login, ///< Connect, log in and quit, over and over. Each login is an operation.
+	churn, ///< Upload a small file and delete it.
+	retr,  ///< Download a file.
+	stor,  ///< Upload a file, overwriting the one uploaded by the previous operation.
+	mlsd,  ///< List a directory.
+	http   ///< GET a URL, typically from the WebUI.
+};
+
+std::string_view to_string(scenario s);
+bool from_string(std::string_view str, scenario &s);
+
+struct options
+{
+	std::string scenario = "login";
+
+	std::string host = "127.0.0.1";
+	unsigned int port = 21;
+	bool tls = false;           ///< Use explicit FTP over TLS, with protected data connections. Any certificate is accepted, self-signed ones included.
+	std::string user = "bench";
+	std::string password = "bench";
+
+	std::string path{};         ///< The file to download, the directory to list or the directory to upload into.
+	std::uint64_t file_size = 4096; ///< The size of the uploaded files.
+	std::string url{};          ///< What the http scenario GETs.
+
+	std::size_t sessions = 10;
+	std::size_t threads = 0;    ///< 0 means as many as the hardware can run concurrently.
+	double rate = 0;            ///< Operations per second, over all sessions. 0 means no limit.
+
+	std::int64_t duration = 30; ///< Seconds.
+	std::int64_t warmup = 2;    ///< Seconds during which the operations are performed but not measured.
+	std::int64_t timeout = 30;  ///< Seconds of inactivity after which an operation is deemed failed.
+
+	int server_pid = 0;         ///< If not 0, the CPU used by that process is reported. Only where /proc is available.
+
+	bool json = false;
+	bool verbose = false;
+};
+
+}
+
+#endif // FZ_TOOLS_FZBENCH_OPTIONS_HPP
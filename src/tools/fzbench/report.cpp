@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cstdio>
+#include <string_view>
+
+#if !(defined(FZ_WINDOWS) && FZ_WINDOWS)
+#	include <unistd.h>
+#endif
+
+#include <libfilezilla/format.hpp>
+#include <libfilezilla/string.hpp>
+
+#include "report.hpp"
+#include "session.hpp"
+
+namespace fz::fzbench {
+
+namespace {
+
+std::uint64_t percentile(const std::vector<std::uint64_t> &sorted, double p)
+{
+	if (sorted.empty())
+		return 0;
+
+	auto i = std::size_t(p * double(sorted.size() - 1) + 0.5);
+	return sorted[std::min(i, sorted.size() - 1)];
+}
+
+std::string format_us(std::uint64_t us)
+{
+	char buf[32];
+
+	if (us < 1000)
+		std::snprintf(buf, sizeof(buf), "%llu us", (unsigned long long)us);
+	else
+	if (us < 1000*1000)
+		std::snprintf(buf, sizeof(buf), "%.2f ms", double(us) / 1000);
+	else
+		std::snprintf(buf, sizeof(buf), "%.2f s", double(us) / (1000*1000));
+
+	return buf;
+}
+
+std::string format_rate(double bytes_per_s)
+{
+	static const char *units[] = { "B/s", "KiB/s", "MiB/s", "GiB/s" };
+
+	std::size_t u = 0;
+	while (bytes_per_s >= 1024 && u < std::size(units) - 1) {
+		bytes_per_s /= 1024;
+		++u;
+	}
+
+	char buf[32];
+	std::snprintf(buf, sizeof(buf), "%.2f %s", bytes_per_s, units[u]);
+
+	return buf;
+}
+
+std::string format_cpu(const std::optional<double> &cpu)
+{
+	if (!cpu)
+		return "n/a";
+
+	char buf[32];
+	std::snprintf(buf, sizeof(buf), "%.1f%%", *cpu);
+
+	return buf;
+}
+
+std::string json_cpu(const std::optional<double> &cpu)
+{
+	if (!cpu)
+		return "null";
+
+	char buf[32];
+	std::snprintf(buf, sizeof(buf), "%.1f", *cpu);
+
+	return buf;
+}
+
+}
+
+void report::set_stats(stats &s)
+{
+	auto &l = s.latencies_us;
+	std::sort(l.begin(), l.end());
+
+	operations = l.size();
+	errors = s.errors;
+	bytes = s.bytes;
+
+	p50_us = percentile(l, 0.5);
+	p99_us = percentile(l, 0.99);
+	p999_us = percentile(l, 0.999);
+	max_us = l.empty() ? 0 : l.back();
+}
+
+void report::print_text() const
+{
+	auto per_s = [&](double v) { return seconds > 0 ? v / seconds : 0.0; };
+
+	std::printf("Scenario:    %s, %zu sessions, measured for %.1f s\n", scenario.c_str(), sessions, seconds);
+	std::printf("Operations:  %llu (%.1f/s), %llu errors\n", (unsigned long long)operations, per_s(double(operations)), (unsigned long long)errors);
+	std::printf("Throughput:  %s\n", format_rate(per_s(double(bytes))).c_str());
+	std::printf("Latency:     p50 %s, p99 %s, p99.9 %s, max %s\n", format_us(p50_us).c_str(), format_us(p99_us).c_str(), format_us(p999_us).c_str(), format_us(max_us).c_str());
+	std::printf("CPU:         client %s, server %s\n", format_cpu(client_cpu).c_str(), format_cpu(server_cpu).c_str());
+	std::fflush(stdout);
+}
+
+void report::print_json() const
+{
+	auto per_s = [&](double v) { return seconds > 0 ? v / seconds : 0.0; };
+
+	std::printf("{\"benchmark\":\"fzbench\",\"case\":\"%s\",\"sessions\":%zu,\"seconds\":%.3f,\"operations\":%llu,\"errors\":%llu,\"ops_per_s\":%.1f,\"bytes_per_s\":%.1f,"
+				"\"p50_us\":%llu,\"p99_us\":%llu,\"p999_us\":%llu,\"max_us\":%llu,\"client_cpu_percent\":%s,\"server_cpu_percent\":%s}\n",
+		scenario.c_str(), sessions, seconds, (unsigned long long)operations, (unsigned long long)errors, per_s(double(operations)), per_s(double(bytes)),
+		(unsigned long long)p50_us, (unsigned long long)p99_us, (unsigned long long)p999_us, (unsigned long long)max_us,
+		json_cpu(client_cpu).c_str(), json_cpu(server_cpu).c_str());
+	std::fflush(stdout);
+}
+
+std::optional<std::int64_t> cpu_time_ms(int pid)
+{
+#if !(defined(FZ_WINDOWS) && FZ_WINDOWS)
+	auto path = pid ? fz::sprintf("/proc/%d/stat", pid) : std::string("/proc/self/stat");
+
+	std::FILE *f = std::fopen(path.c_str(), "r");
+	if (!f)
+		return {};
+
+	char buf[1024];
+	auto size = std::fread(buf, 1, sizeof(buf) - 1, f);
+	std::fclose(f);
+
+	// The name of the command, in the second field, can contain anything: the fields that follow are counted from its closing parenthesis.
+	std::string_view stat(buf, size);
+	auto pos = stat.rfind(')');
+	if (pos == std::string_view::npos)
+		return {};
+
+	auto fields = fz::strtok_view(stat.substr(pos + 1), " ");
+
+	// utime and stime are the 14th and 15th fields, the first one after the parenthesis being the 3rd.
+	if (fields.size() < 13)
+		return {};
+
+	auto utime = fz::to_integral<std::int64_t>(fields[11], -1);
+	auto stime = fz::to_integral<std::int64_t>(fields[12], -1);
+	auto ticks_per_s = sysconf(_SC_CLK_TCK);
+
+	if (utime < 0 || stime < 0 || ticks_per_s <= 0)
+		return {};
+
+	return (utime + stime) * 1000 / ticks_per_s;
+#else
+	(void)pid;
+	return {};
+#endif
+}
+
+}
@@ -0,0 +1,46 @@
+#ifndef FZ_TOOLS_FZBENCH_REPORT_HPP
+#define FZ_TOOLS_FZBENCH_REPORT_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace fz::fzbench {
+
+struct stats;
+
+struct report
+{
+	std::string scenario{};
+	std::size_t sessions{};
+	double seconds{};
+
+	std::uint64_t operations{};
+	std::uint64_t errors{};
+	std::uint64_t bytes{};
+
+	std::uint64_t p50_us{};
+	std::uint64_t p99_us{};
+	std::uint64_t p999_us{};
+	std::uint64_t max_us{};
+
+	/// In percent of a single core.
+	std::optional<double> client_cpu{};
+	std::optional<double> server_cpu{};
+
+	/// Sorts the latencies of \p s.
+	void set_stats(stats &s);
+
+	void print_text() const;
+
+	/// Prints a single JSON object on a line, in the same format as the microbenchmarks.
+	void print_json() const;
+};
+
+/// \returns the CPU time, in milliseconds, used so far by the process \p pid, or by the calling one if \p pid is 0.
+/// nullopt if it cannot be known, which is the case where /proc is not available.
+std::optional<std::int64_t> cpu_time_ms(int pid);
+
+}
+
+#endif // FZ_TOOLS_FZBENCH_REPORT_HPP
@@ -0,0 +1,172 @@
+#include <thread>
+
+#include "runner.hpp"
+#include "ftp_session.hpp"
+#include "http_session.hpp"
+
+namespace fz::fzbench {
+
+std::string_view to_string(scenario s)
+{
+	switch (s) {
+		case scenario::login: return "login";
+		case scenario::churn: return "churn";
+		case scenario::retr: return "retr";
+		case scenario::stor: return "stor";
+		case scenario::mlsd: return "mlsd";
+		case scenario::http: return "http";
+	}
+
+	return {};
+}
+
+bool from_string(std::string_view str, scenario &s)
+{
+	for (auto c: { scenario::login, scenario::churn, scenario::retr, scenario::stor, scenario::mlsd, scenario::http }) {
+		if (str == to_string(c)) {
+			s = c;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+runner::runner(thread_pool &pool, logger_interface &logger, const options &opts, fzbench::scenario scenario)
+	: pool_(pool)
+	, logger_(logger)
+	, opts_(opts)
+	, scenario_(scenario)
+{
+	std::size_t num_loops = opts_.threads ? opts_.threads : std::max(std::thread::hardware_concurrency(), 1u);
+	num_loops = std::min(num_loops, std::max(opts_.sessions, std::size_t(1)));
+
+	for (std::size_t i = 0; i < num_loops; ++i)
+		loops_.push_back(std::make_unique<event_loop>(pool_));
+
+	stats_.resize(opts_.sessions);
+}
+
+runner::~runner()
+{
+	// The sessions must be gone before the loops they run on.
+	sessions_.clear();
+	loops_.clear();
+}
+
+std::unique_ptr<session> runner::make_session(event_loop &loop, std::size_t index)
+{
+	if (scenario_ == scenario::http)
+		return std::make_unique<http_session>(loop, *this, stats_[index]);
+
+	return std::make_unique<ftp_session>(loop, *this, stats_[index], index);
+}
+
+void runner::wait_until(const monotonic_clock &deadline, std::size_t stopped_sessions)
+{
+	scoped_lock lock(mutex_);
+
+	while (stopped_sessions_ < stopped_sessions) {
+		auto left = deadline - monotonic_clock::now();
+		if (left <= duration())
+			break;
+
+		condition_.wait(lock, left);
+	}
+}
+
+report runner::run()
+{
+	for (std::size_t i = 0; i < opts_.sessions; ++i) {
+		sessions_.push_back(make_session(*loops_[i % loops_.size()], i));
+		sessions_.back()->start();
+	}
+
+	wait_until(monotonic_clock::now() + duration::from_seconds(opts_.warmup));
+
+	auto client_cpu_start = cpu_time_ms(0);
+	auto server_cpu_start = opts_.server_pid ? cpu_time_ms(opts_.server_pid) : std::nullopt;
+	metrics::stopwatch window;
+
+	measuring_ = true;
+	wait_until(monotonic_clock::now() + duration::from_seconds(opts_.duration));
+	measuring_ = false;
+
+	auto elapsed_us = window.elapsed_us();
+	auto client_cpu_end = cpu_time_ms(0);
+	auto server_cpu_end = opts_.server_pid ? cpu_time_ms(opts_.server_pid) : std::nullopt;
+
+	stopping_ = true;
+	wait_until(monotonic_clock::now() + duration::from_seconds(opts_.timeout), sessions_.size());
+
+	{
+		scoped_lock lock(mutex_);
+		if (stopped_sessions_ < sessions_.size())
+			logger_.log_u(logmsg::debug_warning, L"%d sessions did not stop in time.", sessions_.size() - stopped_sessions_);
+	}
+
+	// Only now the statistics are not being updated anymore.
+	sessions_.clear();
+
+	stats all;
+	for (auto &s: stats_)
+		all.merge(s);
+
+	report r;
+	r.scenario = std::string(to_string(scenario_));
+	r.sessions = opts_.sessions;
+	r.seconds = double(elapsed_us) / (1000*1000);
+	r.set_stats(all);
+
+	auto cpu_percent = [&](const std::optional<std::int64_t> &start, const std::optional<std::int64_t> &end) -> std::optional<double> {
+		if (!start || !end || !elapsed_us)
+			return {};
+
+		return double(*end - *start) * 1000 * 100 / double(elapsed_us);
+	};
+
+	r.client_cpu = cpu_percent(client_cpu_start, client_cpu_end);
+	r.server_cpu = cpu_percent(server_cpu_start, server_cpu_end);
+
+	return r;
+}
+
+std::optional<duration> runner::next_operation_delay()
+{
+	if (stopping_)
+		return {};
+
+	if (opts_.rate <= 0)
+		return duration();
+
+	// Hands out slots, evenly spaced, in turn to whichever session asks first.
+	auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1 / opts_.rate));
+	auto now = std::chrono::steady_clock::now();
+
+	scoped_lock lock(mutex_);
+
+	auto slot = std::max(next_slot_, now);
+	next_slot_ = slot + interval;
+
+	return duration::from_milliseconds(std::chrono::duration_cast<std::chrono::milliseconds>(slot - now).count());
+}
+
+bool runner::is_measuring() const
+{
+	return measuring_;
+}
+
+bool runner::is_stopping() const
+{
+	return stopping_;
+}
+
+void runner::session_stopped()
+{
+	scoped_lock lock(mutex_);
+
+	stopped_sessions_ += 1;
+	condition_.signal(lock);
+}
+
+}
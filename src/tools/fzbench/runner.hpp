@@ -0,0 +1,83 @@
+#ifndef FZ_TOOLS_FZBENCH_RUNNER_HPP
+#define FZ_TOOLS_FZBENCH_RUNNER_HPP
+
+#include <atomic>
+#include <optional>
+
+#include <libfilezilla/event_loop.hpp>
+#include <libfilezilla/logger.hpp>
+#include <libfilezilla/thread_pool.hpp>
+
+#include "options.hpp"
+#include "report.hpp"
+#include "session.hpp"
+
+namespace fz::fzbench {
+
+/// \brief Runs the sessions of a scenario, spread over a number of event loops, and measures them.
+///
+/// The sessions first run for the warmup time, then for the measurement window, after which they're told to stop
+/// and given up to the operations timeout to complete the operations they're performing.
+class runner
+{
+public:
+	runner(thread_pool &pool, logger_interface &logger, const options &opts, fzbench::scenario scenario);
+	~runner();
+
+	/// Blocks until the scenario has been run.
+	report run();
+
+	/// \returns how long the calling session must wait before beginning its next operation, so that the rate is respected,
+	/// or nullopt if the session must stop instead.
+	std::optional<duration> next_operation_delay();
+
+	bool is_measuring() const;
+	bool is_stopping() const;
+
+	void session_stopped();
+
+	const options &get_options() const
+	{
+		return opts_;
+	}
+
+	fzbench::scenario get_scenario() const
+	{
+		return scenario_;
+	}
+
+	thread_pool &pool()
+	{
+		return pool_;
+	}
+
+	logger_interface &logger()
+	{
+		return logger_;
+	}
+
+private:
+	std::unique_ptr<session> make_session(event_loop &loop, std::size_t index);
+	void wait_until(const monotonic_clock &deadline, std::size_t stopped_sessions = std::size_t(-1));
+
+	thread_pool &pool_;
+	logger_interface &logger_;
+	const options &opts_;
+	const fzbench::scenario scenario_;
+
+	std::vector<std::unique_ptr<event_loop>> loops_;
+	std::vector<stats> stats_;
+	std::vector<std::unique_ptr<session>> sessions_;
+
+	std::atomic<bool> measuring_{};
+	std::atomic<bool> stopping_{};
+
+	fz::mutex mutex_;
+	fz::condition condition_;
+	std::size_t stopped_sessions_{};
+	std::chrono::steady_clock::time_point next_slot_{};
+};
+
+}
+
+#endif // FZ_TOOLS_FZBENCH_RUNNER_HPP
@@ -0,0 +1,123 @@
+#include "session.hpp"
+#include "runner.hpp"
+
+namespace fz::fzbench {
+
+namespace {
+
+struct start_event_tag{};
+using start_event = simple_event<start_event_tag>;
+
+}
+
+void stats::merge(const stats &rhs)
+{
+	latencies_us.insert(latencies_us.end(), rhs.latencies_us.begin(), rhs.latencies_us.end());
+	errors += rhs.errors;
+	bytes += rhs.bytes;
+}
+
+session::session(event_loop &loop, runner &runner, fzbench::stats &stats)
+	: event_handler(loop)
+	, runner_(runner)
+	, stats_(stats)
+{
+}
+
+session::~session()
+{
+	remove_handler();
+}
+
+void session::start()
+{
+	send_event<start_event>();
+}
+
+void session::setup()
+{
+	next();
+}
+
+void session::next()
+{
+	if (stopped_)
+		return;
+
+	auto delay = runner_.next_operation_delay();
+	if (!delay) {
+		stopped_ = true;
+		runner_.session_stopped();
+		return;
+	}
+
+	if (*delay) {
+		pacing_timer_id_ = add_timer(*delay, true);
+		return;
+	}
+
+	operation_stopwatch_ = {};
+	operation_in_progress_ = true;
+	begin_operation();
+}
+
+void session::end_operation(bool success)
+{
+	if (!operation_in_progress_)
+		return;
+
+	operation_in_progress_ = false;
+
+	if (!runner_.is_measuring())
+		return;
+
+	if (success)
+		stats_.latencies_us.push_back(operation_stopwatch_.elapsed_us());
+	else
+		stats_.errors += 1;
+}
+
+void session::count_error()
+{
+	if (operation_in_progress_)
+		return end_operation(false);
+
+	if (runner_.is_measuring())
+		stats_.errors += 1;
+}
+
+void session::count_bytes(std::uint64_t amount)
+{
+	if (runner_.is_measuring())
+		stats_.bytes += amount;
+}
+
+bool session::is_stopping() const
+{
+	return runner_.is_stopping();
+}
+
+void session::operator()(const event_base &ev)
+{
+	fz::dispatch<
+		start_event,
+		timer_event
+	>(ev, this,
+		&session::setup,
+		&session::on_timer
+	);
+}
+
+void session::on_timer(timer_id id)
+{
+	if (id != pacing_timer_id_)
+		return;
+
+	pacing_timer_id_ = {};
+
+	operation_stopwatch_ = {};
+	operation_in_progress_ = true;
+	begin_operation();
+}
+
+}
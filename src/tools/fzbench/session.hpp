@@ -0,0 +1,71 @@
+#ifndef FZ_TOOLS_FZBENCH_SESSION_HPP
+#define FZ_TOOLS_FZBENCH_SESSION_HPP
+
+#include <vector>
+
+#include <libfilezilla/event_handler.hpp>
+
+#include "../../filezilla/metrics/registry.hpp"
+
+namespace fz::fzbench {
+
+class runner;
+
+/// What the sessions measured. Only what happens within the measurement window is accounted for.
+struct stats
+{
+	std::vector<std::uint64_t> latencies_us{};
+	std::uint64_t errors{};
+	std::uint64_t bytes{};
+
+	void merge(const stats &rhs);
+};
+
+/// \brief A client session, performing the operation of the scenario over and over.
+///
+/// The derived classes get ready to perform the operations in setup(), then invoke next().
+/// The session then paces the operations according to the rate, invoking begin_operation() for each of them,
+/// and stops once the runner tells it to, at the first invocation of next() that follows.
+class session: public event_handler
+{
+public:
+	session(event_loop &loop, runner &runner, fzbench::stats &stats);
+	~session() override;
+
+	void start();
+
+protected:
+	/// Gets the session ready to perform its operations. By default, the first one is started right away.
+	virtual void setup();
+	virtual void begin_operation() = 0;
+
+	/// To be invoked once the session is ready to perform another operation.
+	void next();
+
+	/// Records the outcome of the operation begun last.
+	void end_operation(bool success);
+
+	/// Counts an error that happened outside of any operation.
+	void count_error();
+
+	void count_bytes(std::uint64_t amount);
+
+	bool is_stopping() const;
+
+	/// The derived classes must hand the events they don't handle over to this.
+	void operator()(const event_base &ev) override;
+	virtual void on_timer(timer_id id);
+
+	runner &runner_;
+
+private:
+	fzbench::stats &stats_;
+	metrics::stopwatch operation_stopwatch_;
+	timer_id pacing_timer_id_{};
+	bool operation_in_progress_{};
+	bool stopped_{};
+};
+
+}
+
+#endif // FZ_TOOLS_FZBENCH_SESSION_HPP
@@ -0,0 +1,73 @@
+#include <random>
+
+#include <libfilezilla/format.hpp>
+
+#include "bench.hpp"
+
+#include "../../src/filezilla/tcp/binary_address_list.hpp"
+
+/*
+ * Measures the allowed/disallowed IPs lists, which are looked up on every incoming connection
+ * and added to by the autobanner, at sizes from a hand written list up to a big imported blocklist.
+ *
+ * The lists hold one entry every 4 addresses, so that the entries don't get coalesced into ranges.
+ */
+
+namespace {
+
+constexpr std::size_t sizes[] = { 1000, 10000, 100000, 1000000 };
+constexpr std::size_t lookups = 1000000;
+constexpr std::size_t adds = 1000;
+
+std::string ipv4(std::uint32_t i)
+{
+	i += 10u << 24;
+	return fz::sprintf("%d.%d.%d.%d", i >> 24, (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+}
+
+std::string ipv6(std::uint32_t i)
+{
+	return fz::sprintf("2001:db8::%x:%x", i >> 16, i & 0xffff);
+}
+
+template <typename ToString>
+void measure_list(fz::bench::state &state, std::string_view family_name, fz::address_type family, ToString to_string)
+{
+	std::mt19937 rng(42);
+
+	for (auto size: sizes) {
+		fz::tcp::binary_address_list list;
+
+		for (std::size_t i = 0; i < size; ++i)
+			list.add(to_string(std::uint32_t(i * 4)), family);
+
+		std::uniform_int_distribution<std::uint32_t> dist(0, std::uint32_t(size * 4 - 1));
+
+		// Formatting the addresses would dwarf the lookups: prepare them beforehand.
+		std::vector<std::string> addresses(4096);
+		for (auto &a: addresses)
+			a = to_string(dist(rng));
+
+		state.measure_batched(fz::sprintf("contains %s, %d entries", family_name, size), lookups, 1000, [&](std::size_t i) {
+			fz::bench::do_not_optimize(list.contains(addresses[i & 4095], family));
+		});
+
+		// Each add lands in between existing entries, so that the ones after it have to be moved.
+		for (auto &a: addresses)
+			a = to_string(dist(rng) | 1);
+
+		state.measure(fz::sprintf("add %s, %d entries", family_name, size), adds, [&](std::size_t i) {
+			fz::bench::do_not_optimize(list.add(addresses[i], family));
+		});
+	}
+}
+
+void address_list_lookup(fz::bench::state &state)
+{
+	measure_list(state, "ipv4", fz::address_type::ipv4, ipv4);
+	measure_list(state, "ipv6", fz::address_type::ipv6, ipv6);
+}
+
+FZ_BENCHMARK(address_list_lookup);
+
+}
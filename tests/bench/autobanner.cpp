@@ -0,0 +1,109 @@
+#include <thread>
+
+#include <sys/resource.h>
+
+#include <libfilezilla/format.hpp>
+
+#include "bench.hpp"
+
+#include "../../src/filezilla/authentication/autobanner.hpp"
+
+/*
+ * Replays a distributed brute-force wave: 1M distinct IPv4 addresses each failing to log in
+ * as many times as it takes to get banned, interleaved with each other, first from a single thread
+ * and then from several threads at once, as it happens with many session threads.
+ */
+
+namespace {
+
+constexpr std::size_t addresses_count = 1000 * 1000;
+constexpr std::uint16_t max_login_failures = 3;
+
+std::vector<std::string> make_addresses()
+{
+	std::vector<std::string> addresses;
+	addresses.reserve(addresses_count);
+
+	for (std::size_t i = 0; i < addresses_count; ++i)
+		addresses.push_back(fz::sprintf("10.%d.%d.%d", (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff));
+
+	return addresses;
+}
+
+fz::authentication::autobanner::options banner_options()
+{
+	return fz::authentication::autobanner::options()
+		.max_login_failures(max_login_failures)
+		.login_failures_time_window(fz::duration::from_seconds(60))
+		.ban_duration(fz::duration::from_minutes(5))
+		.max_tracked_addresses(addresses_count);
+}
+
+double max_rss_mb()
+{
+	rusage ru{};
+	getrusage(RUSAGE_SELF, &ru);
+
+	return double(ru.ru_maxrss) / 1024;
+}
+
+void autobanner_1m_addresses(fz::bench::state &state)
+{
+	auto addresses = make_addresses();
+
+	{
+		fz::authentication::autobanner banner(banner_options());
+		fz::bench::samples samples(addresses_count * max_login_failures);
+
+		auto start = fz::bench::clock::now();
+
+		for (std::uint16_t round = 0; round < max_login_failures; ++round) {
+			for (auto &a: addresses)
+				fz::bench::do_not_optimize(samples.time([&] { return banner.set_failed_login(a, fz::address_type::ipv4); }));
+		}
+
+		state.report("set_failed_login, 1 thread", samples, fz::bench::clock::now() - start);
+
+		state.measure("is_banned, 1 thread", addresses_count, [&](std::size_t i) {
+			fz::bench::do_not_optimize(banner.is_banned(addresses[i], fz::address_type::ipv4));
+		});
+
+		state.report("1 thread", "max_rss_mb", max_rss_mb());
+	}
+
+	{
+		fz::authentication::autobanner banner(banner_options());
+
+		auto threads_count = std::max(std::thread::hardware_concurrency(), 2u);
+		std::vector<fz::bench::samples> samples(threads_count);
+		std::vector<std::thread> threads;
+
+		auto start = fz::bench::clock::now();
+
+		for (unsigned t = 0; t < threads_count; ++t) {
+			threads.emplace_back([&, t] {
+				auto &s = samples[t];
+
+				for (std::uint16_t round = 0; round < max_login_failures; ++round) {
+					for (auto i = t; i < addresses.size(); i += threads_count)
+						fz::bench::do_not_optimize(s.time([&] { return banner.set_failed_login(addresses[i], fz::address_type::ipv4); }));
+				}
+			});
+		}
+
+		for (auto &t: threads)
+			t.join();
+
+		auto total = fz::bench::clock::now() - start;
+
+		fz::bench::samples all(addresses_count * max_login_failures);
+		for (auto &s: samples)
+			all.merge(s);
+
+		state.report(fz::sprintf("set_failed_login, %d threads", threads_count), all, total);
+	}
+}
+
+FZ_BENCHMARK(autobanner_1m_addresses);
+
+}
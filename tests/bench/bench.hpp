@@ -0,0 +1,157 @@
+#ifndef FZ_TESTS_BENCH_BENCH_HPP
+#define FZ_TESTS_BENCH_BENCH_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * A minimal benchmarking harness.
+ *
+ * Benchmarks are plain functions taking a fz::bench::state, registered with FZ_BENCHMARK().
+ * Results are written to stdout as one JSON object per line, so that they can be collected and compared between releases.
+ */
+
+namespace fz::bench {
+
+using clock = std::chrono::steady_clock;
+
+/// Collects the duration of timed operations.
+class samples
+{
+public:
+	explicit samples(std::size_t reserve = 0)
+	{
+		ns_.reserve(reserve);
+	}
+
+	template <typename F>
+	decltype(auto) time(F &&f)
+	{
+		struct guard
+		{
+			~guard()
+			{
+				self.add(clock::now() - start);
+			}
+
+			samples &self;
+			clock::time_point start;
+		} g{*this, clock::now()};
+
+		return std::forward<F>(f)();
+	}
+
+	void add(clock::duration d)
+	{
+		ns_.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+	}
+
+	void merge(const samples &rhs)
+	{
+		ns_.insert(ns_.end(), rhs.ns_.begin(), rhs.ns_.end());
+	}
+
+	std::size_t size() const
+	{
+		return ns_.size();
+	}
+
+private:
+	friend class state;
+
+	std::vector<std::int64_t> ns_;
+};
+
+class state
+{
+public:
+	explicit state(std::string name)
+		: name_(std::move(name))
+	{}
+
+	/// Runs \p f \p iterations times, timing each call, and reports the latency distribution under \p label.
+	/// If \p f accepts an argument, it's passed the index of the iteration.
+	template <typename F>
+	void measure(std::string_view label, std::size_t iterations, F &&f)
+	{
+		samples s(iterations);
+
+		auto start = clock::now();
+
+		for (std::size_t i = 0; i < iterations; ++i) {
+			if constexpr (std::is_invocable_v<F&, std::size_t>)
+				s.time([&] { return f(i); });
+			else
+				s.time(f);
+		}
+
+		report(label, s, clock::now() - start);
+	}
+
+	/// Like measure(), but times \p batch_size calls at once and records their average duration.
+	/// Meant for operations so short that timing them one by one would mostly measure the clock.
+	template <typename F>
+	void measure_batched(std::string_view label, std::size_t iterations, std::size_t batch_size, F &&f)
+	{
+		samples s(iterations / batch_size + 1);
+
+		auto start = clock::now();
+
+		for (std::size_t i = 0; i < iterations;) {
+			auto const n = std::min(batch_size, iterations - i);
+			auto const batch_start = clock::now();
+
+			for (auto const end = i + n; i < end; ++i) {
+				if constexpr (std::is_invocable_v<F&, std::size_t>)
+					f(i);
+				else
+					f();
+			}
+
+			s.add((clock::now() - batch_start) / clock::rep(n));
+		}
+
+		report(label, s, clock::now() - start, iterations);
+	}
+
+	/// Reports the latency distribution of \p s, under \p label.
+	/// If \p total is not zero, the throughput is reported as well, computed over \p operations, or over the number of samples if that's zero.
+	void report(std::string_view label, samples &s, clock::duration total = {}, std::size_t operations = 0);
+
+	/// Reports an arbitrary \p metric. By convention, the name of the metric ends with its unit, like in "cpu_ms".
+	void report(std::string_view label, std::string_view metric, double value);
+
+	const std::string &name() const
+	{
+		return name_;
+	}
+
+private:
+	std::string name_;
+};
+
+using function = void (*)(state &);
+
+struct registration
+{
+	registration(const char *name, function f);
+};
+
+/// Prevents the compiler from optimizing away the computation of \p v.
+template <typename T>
+inline void do_not_optimize(T const& v)
+{
+	asm volatile("" : : "r,m"(v) : "memory");
+}
+
+}
+
+#define FZ_BENCHMARK(f) static const ::fz::bench::registration f##_registration_(#f, &f)
+
+#endif // FZ_TESTS_BENCH_BENCH_HPP
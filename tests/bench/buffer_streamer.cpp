@@ -0,0 +1,80 @@
+#include <libfilezilla/format.hpp>
+
+#include "bench.hpp"
+
+#include "../../src/filezilla/tvfs/entry.hpp"
+#include "../../src/filezilla/util/buffer_streamer.hpp"
+
+/*
+ * Measures the formatting of the numbers and times that make up the replies and the directory listings.
+ */
+
+namespace {
+
+constexpr std::size_t iterations = 1000000;
+constexpr std::size_t batch_size = 1000;
+
+template <typename F>
+void measure_streaming(fz::bench::state &state, std::string_view label, F &&f)
+{
+	fz::buffer buffer;
+
+	state.measure_batched(label, iterations, batch_size, [&](std::size_t i) {
+		if ((i % batch_size) == 0)
+			buffer.clear();
+
+		fz::util::buffer_streamer bs(buffer);
+		f(bs, i);
+	});
+
+	fz::bench::do_not_optimize(buffer.size());
+}
+
+void buffer_streamer_integers(fz::bench::state &state)
+{
+	measure_streaming(state, "int64", [](fz::util::buffer_streamer &bs, std::size_t i) {
+		bs << std::int64_t(i * 2654435761u);
+	});
+
+	measure_streaming(state, "dec, width 3", [](fz::util::buffer_streamer &bs, std::size_t i) {
+		bs << bs.dec(int(i % 1000), 3, '0');
+	});
+
+	measure_streaming(state, "hex, width 16", [](fz::util::buffer_streamer &bs, std::size_t i) {
+		bs << bs.hex(std::uint64_t(i) * 0x9e3779b97f4a7c15u, 16, '0');
+	});
+
+	measure_streaming(state, "reply code and size", [](fz::util::buffer_streamer &bs, std::size_t i) {
+		bs << 213 << ' ' << std::uint64_t(i * 104729) << "\r\n";
+	});
+}
+
+FZ_BENCHMARK(buffer_streamer_integers);
+
+void buffer_streamer_times(fz::bench::state &state)
+{
+	std::vector<fz::datetime> seconds;
+	std::vector<fz::datetime> milliseconds;
+
+	auto const now = fz::datetime::now();
+
+	for (int i = 0; i < 256; ++i) {
+		auto const t = now - fz::duration::from_milliseconds(std::int64_t(i) * 86400037);
+
+		milliseconds.push_back(t);
+		seconds.emplace_back(t.get_time_t(), fz::datetime::seconds);
+	}
+
+	// The time-val of the MLSD modify fact and of the MDTM reply.
+	measure_streaming(state, "time-val, seconds", [&](fz::util::buffer_streamer &bs, std::size_t i) {
+		bs << fz::tvfs::entry::timeval(seconds[i & 255]);
+	});
+
+	measure_streaming(state, "time-val, milliseconds", [&](fz::util::buffer_streamer &bs, std::size_t i) {
+		bs << fz::tvfs::entry::timeval(milliseconds[i & 255]);
+	});
+}
+
+FZ_BENCHMARK(buffer_streamer_times);
+
+}
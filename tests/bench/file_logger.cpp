@@ -0,0 +1,69 @@
+#include <filesystem>
+#include <thread>
+
+#include "bench.hpp"
+
+#include "../../src/filezilla/logger/file.hpp"
+
+/*
+ * Several threads, standing for the session threads, log debug-level messages as fast as they can.
+ * The time each log call takes is what a session would be stalled for, and the overall throughput is what the logger sustains.
+ * Reported for the synchronous mode and for the asynchronous one, with each of its overflow policies.
+ */
+
+namespace {
+
+constexpr std::size_t messages_per_thread = 100 * 1000;
+
+void log_from_threads(fz::bench::state &state, std::string_view label, fz::logger::file::options opts)
+{
+	auto name = (std::filesystem::temp_directory_path() / "fz_bench_file_logger.log").native();
+
+	auto threads_count = std::max(std::thread::hardware_concurrency(), 2u);
+	std::vector<fz::bench::samples> samples(threads_count, fz::bench::samples(messages_per_thread));
+
+	auto start = fz::bench::clock::now();
+
+	{
+		fz::logger::file logger(std::move(opts.name(name).enabled_types(fz::logmsg::type(~0)).start_line(false)));
+		std::vector<std::thread> threads;
+
+		for (unsigned t = 0; t < threads_count; ++t) {
+			threads.emplace_back([&, t] {
+				for (std::size_t i = 0; i < messages_per_thread; ++i)
+					samples[t].time([&] { logger.log_u(fz::logmsg::debug_debug, L"Session %d: transferred chunk %d of the file being downloaded", t, i); });
+			});
+		}
+
+		for (auto &t: threads)
+			t.join();
+
+		if (auto dropped = logger.dropped())
+			state.report(label, "dropped_messages", double(dropped));
+	}
+
+	// The destructor writes out what's still queued: that's part of the cost.
+	auto total = fz::bench::clock::now() - start;
+
+	fz::bench::samples all(threads_count * messages_per_thread);
+	for (auto &s: samples)
+		all.merge(s);
+
+	state.report(label, all, total);
+
+	fz::remove_file(name, false);
+}
+
+void file_logger(fz::bench::state &state)
+{
+	using options = fz::logger::file::options;
+
+	log_from_threads(state, "sync", options());
+	log_from_threads(state, "async, block", options().async_queue_size(64 * 1024).overflow_policy(fz::logger::file::block));
+	log_from_threads(state, "async, drop", options().async_queue_size(64 * 1024).overflow_policy(fz::logger::file::drop));
+	log_from_threads(state, "async, drop_debug", options().async_queue_size(64 * 1024).overflow_policy(fz::logger::file::drop_debug));
+}
+
+FZ_BENCHMARK(file_logger);
+
+}
@@ -0,0 +1,227 @@
+#include <memory>
+#include <string>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <libfilezilla/event_handler.hpp>
+#include <libfilezilla/event_loop.hpp>
+#include <libfilezilla/format.hpp>
+#include <libfilezilla/socket.hpp>
+#include <libfilezilla/thread_pool.hpp>
+
+#include "bench.hpp"
+
+#include "../../src/filezilla/http/server/session.hpp"
+#include "../../src/filezilla/http/server/transaction.hpp"
+#include "../../src/filezilla/logger/null.hpp"
+
+/*
+ * Measures how many requests per second a single keep-alive HTTP connection serves, when the client
+ * waits for each response before sending the next request, and when it pipelines them in bursts.
+ * Both ends run in the same process, over the loopback interface, and the responses are small,
+ * so that what's measured is mostly the round trips and the per request work of the session.
+ */
+
+namespace {
+
+constexpr std::size_t requests_count = 4096;
+constexpr std::string_view request = "GET /index.txt HTTP/1.1\r\nHost: localhost\r\n\r\n";
+constexpr std::string_view response_start = "HTTP/1.1 200 ";
+
+class hello_handler final: public fz::http::server::transaction_handler
+{
+public:
+	void handle_transaction(const fz::http::server::shared_transaction &t) override
+	{
+		t->res().send_status(200, "OK") &&
+		t->res().send_header(fz::http::headers::Content_Type, "text/plain") &&
+		t->res().send_body("Hello, world!\n");
+	}
+};
+
+class acceptor final: public fz::event_handler
+{
+public:
+	acceptor(fz::event_loop &loop, fz::thread_pool &pool)
+		: fz::event_handler(loop)
+		, listen_socket_(pool, this)
+	{}
+
+	~acceptor() override
+	{
+		remove_handler();
+	}
+
+	int listen()
+	{
+		if (listen_socket_.listen(fz::address_type::ipv4, 0) != 0) {
+			return -1;
+		}
+
+		int error = 0;
+		return listen_socket_.local_port(error);
+	}
+
+private:
+	void operator()(const fz::event_base &ev) override
+	{
+		fz::dispatch<fz::socket_event>(ev, this, &acceptor::on_socket_event);
+	}
+
+	void on_socket_event(fz::socket_event_source *, fz::socket_event_flag type, int error)
+	{
+		if (type != fz::socket_event_flag::connection || error) {
+			return;
+		}
+
+		auto socket = listen_socket_.accept(error);
+		if (!socket) {
+			return;
+		}
+
+		// Each measurement uses a connection of its own: the one of the previous measurement is over.
+		session_ = std::make_unique<fz::http::server::session>(*this, event_loop_, 1, std::move(socket), nullptr, handler_, fz::logger::null);
+		session_->set_timeouts(fz::duration::from_seconds(60), fz::duration::from_seconds(60));
+	}
+
+	fz::listen_socket listen_socket_;
+	hello_handler handler_;
+	std::unique_ptr<fz::http::server::session> session_;
+};
+
+class client
+{
+public:
+	explicit client(int port)
+	{
+		fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+
+		int one = 1;
+		setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		sockaddr_in addr{};
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(std::uint16_t(port));
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		if (::connect(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+			::close(fd_);
+			fd_ = -1;
+		}
+	}
+
+	~client()
+	{
+		if (fd_ != -1) {
+			::close(fd_);
+		}
+	}
+
+	explicit operator bool() const
+	{
+		return fd_ != -1;
+	}
+
+	bool send(std::size_t count)
+	{
+		std::string data;
+		data.reserve(request.size() * count);
+
+		for (std::size_t i = 0; i < count; ++i) {
+			data += request;
+		}
+
+		for (std::size_t sent = 0; sent < data.size();) {
+			auto res = ::send(fd_, data.data() + sent, data.size() - sent, 0);
+			if (res <= 0) {
+				return false;
+			}
+
+			sent += std::size_t(res);
+		}
+
+		return true;
+	}
+
+	/// Reads until \p count more responses have been received.
+	/// Responses are told apart by their status line, which is enough here, since the bodies are known not to contain it.
+	bool receive(std::size_t count)
+	{
+		char buf[64*1024];
+
+		while (count > 0) {
+			auto res = ::recv(fd_, buf, sizeof(buf), 0);
+			if (res <= 0) {
+				return false;
+			}
+
+			pending_.append(buf, std::size_t(res));
+
+			std::size_t consumed = 0;
+
+			for (std::size_t pos; count > 0 && (pos = pending_.find(response_start, consumed)) != std::string::npos; --count) {
+				consumed = pos + response_start.size();
+			}
+
+			// Keep what could be the beginning of a status line not received whole yet.
+			consumed = std::max(consumed, pending_.size() - std::min(pending_.size(), response_start.size() - 1));
+			pending_.erase(0, consumed);
+		}
+
+		return true;
+	}
+
+private:
+	int fd_ = -1;
+	std::string pending_;
+};
+
+void measure_depth(fz::bench::state &state, int port, std::size_t depth)
+{
+	client c(port);
+	if (!c) {
+		state.report("connect", "failed", 1);
+		return;
+	}
+
+	fz::bench::samples samples(requests_count / depth + 1);
+	auto start = fz::bench::clock::now();
+
+	for (std::size_t done = 0; done < requests_count; done += depth) {
+		bool ok = samples.time([&] {
+			return c.send(depth) && c.receive(depth);
+		});
+
+		if (!ok) {
+			state.report(fz::sprintf("depth %d", depth), "failed", 1);
+			return;
+		}
+	}
+
+	state.report(depth == 1 ? std::string("one request at a time") : fz::sprintf("bursts of %d pipelined requests", depth), samples, fz::bench::clock::now() - start, requests_count);
+}
+
+void http_pipelining(fz::bench::state &state)
+{
+	fz::thread_pool pool;
+	fz::event_loop loop(pool);
+	acceptor a(loop, pool);
+
+	int port = a.listen();
+	if (port <= 0) {
+		state.report("listen", "failed", 1);
+		return;
+	}
+
+	for (std::size_t depth: {1, 4, 8, 32}) {
+		measure_depth(state, port, depth);
+	}
+}
+
+FZ_BENCHMARK(http_pipelining);
+
+}
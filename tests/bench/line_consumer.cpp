@@ -0,0 +1,87 @@
+#include <libfilezilla/format.hpp>
+
+#include "bench.hpp"
+
+#include "../../src/filezilla/buffer_operator/line_consumer.hpp"
+
+/*
+ * Measures the splitting into lines of what the FTP control connections and the HTTP headers are made of.
+ * Each sample is the time taken to consume a whole buffer, as it arrives from the socket.
+ */
+
+namespace {
+
+constexpr std::size_t rounds = 10000;
+
+class line_counter final: public fz::buffer_operator::line_consumer<fz::buffer_line_eol::cr_lf>
+{
+public:
+	line_counter()
+		: line_consumer(4096)
+	{}
+
+	std::size_t lines{};
+	std::size_t bytes{};
+
+private:
+	int process_buffer_line(buffer_string_view line, bool) override
+	{
+		++lines;
+		bytes += line.size();
+		return 0;
+	}
+};
+
+void measure_scanning(fz::bench::state &state, std::string_view label, const std::string &data)
+{
+	fz::buffer_operator::unsafe_locking_buffer buffer;
+	line_counter counter;
+	counter.set_buffer(&buffer);
+
+	fz::buffer_operator::consumer_interface &consumer = counter;
+
+	fz::bench::samples samples(rounds);
+
+	for (std::size_t i = 0; i < rounds; ++i) {
+		buffer.lock()->append(data);
+
+		samples.time([&] {
+			while (consumer.consume_buffer() == 0);
+		});
+	}
+
+	state.report(label, samples);
+	state.report(label, "lines", double(counter.lines / rounds));
+	fz::bench::do_not_optimize(counter.bytes);
+}
+
+void line_consumer_crlf(fz::bench::state &state)
+{
+	std::string commands;
+
+	// A pipelined burst of commands, like the ones sent when transferring many small files.
+	while (commands.size() < 16 * 1024) {
+		auto n = commands.size();
+		commands += fz::sprintf("PASV\r\nTYPE I\r\nREST 0\r\nRETR /data/files/document %d.pdf\r\nMDTM /data/files/document %d.pdf\r\n", n, n);
+	}
+
+	measure_scanning(state, "FTP commands, 16 KiB", commands);
+
+	std::string headers;
+
+	while (headers.size() < 16 * 1024)
+		headers += "Accept-Language: en-US,en;q=0.9,it;q=0.8,de;q=0.7,fr;q=0.6,es;q=0.5,ja;q=0.4\r\n";
+
+	measure_scanning(state, "HTTP headers, 16 KiB", headers);
+
+	std::string long_lines;
+
+	while (long_lines.size() < 16 * 1024)
+		long_lines += std::string(4000, 'x') + "\r\n";
+
+	measure_scanning(state, "4000 byte lines, 16 KiB", long_lines);
+}
+
+FZ_BENCHMARK(line_consumer_crlf);
+
+}
@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <locale.h>
+
+#include "bench.hpp"
+
+namespace fz::bench {
+
+namespace {
+
+std::vector<std::pair<const char *, function>> &registry()
+{
+	static std::vector<std::pair<const char *, function>> r;
+	return r;
+}
+
+std::string json_escape(std::string_view s)
+{
+	std::string ret;
+	ret.reserve(s.size());
+
+	for (char c: s) {
+		if (c == '"' || c == '\\')
+			ret += '\\';
+
+		if (static_cast<unsigned char>(c) < 0x20)
+			continue;
+
+		ret += c;
+	}
+
+	return ret;
+}
+
+std::int64_t percentile(const std::vector<std::int64_t> &sorted, double p)
+{
+	if (sorted.empty())
+		return 0;
+
+	auto i = std::size_t(p * double(sorted.size() - 1) + 0.5);
+	return sorted[std::min(i, sorted.size() - 1)];
+}
+
+}
+
+registration::registration(const char *name, function f)
+{
+	registry().emplace_back(name, f);
+}
+
+void state::report(std::string_view label, samples &s, clock::duration total, std::size_t operations)
+{
+	auto &ns = s.ns_;
+	std::sort(ns.begin(), ns.end());
+
+	double sum = 0;
+	for (auto v: ns)
+		sum += double(v);
+
+	double mean = ns.empty() ? 0 : sum / double(ns.size());
+
+	std::printf("{\"benchmark\":\"%s\",\"case\":\"%s\",\"samples\":%zu,\"mean_ns\":%.1f,\"p50_ns\":%lld,\"p99_ns\":%lld,\"p999_ns\":%lld,\"max_ns\":%lld",
+		json_escape(name_).c_str(), json_escape(label).c_str(), ns.size(), mean,
+		(long long)percentile(ns, 0.5), (long long)percentile(ns, 0.99), (long long)percentile(ns, 0.999),
+		(long long)(ns.empty() ? 0 : ns.back()));
+
+	if (auto total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(total).count(); total_ns > 0)
+		std::printf(",\"ops_per_s\":%.1f", double(operations ? operations : ns.size()) * 1e9 / double(total_ns));
+
+	std::printf("}\n");
+	std::fflush(stdout);
+}
+
+void state::report(std::string_view label, std::string_view metric, double value)
+{
+	std::printf("{\"benchmark\":\"%s\",\"case\":\"%s\",\"%s\":%.3f}\n",
+		json_escape(name_).c_str(), json_escape(label).c_str(), json_escape(metric).c_str(), value);
+	std::fflush(stdout);
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	setlocale(LC_ALL, "");
+
+	// Numbers must stay in the format JSON expects.
+	setlocale(LC_NUMERIC, "C");
+
+	// Only run the benchmarks whose name contains the given string, if any.
+	const char *filter = argc > 1 ? argv[1] : "";
+
+	for (auto &[name, f]: fz::bench::registry()) {
+		if (!std::strstr(name, filter))
+			continue;
+
+		fz::bench::state s(name);
+		f(s);
+	}
+
+	return 0;
+}
@@ -0,0 +1,113 @@
+#include <thread>
+
+#include <libfilezilla/buffer.hpp>
+#include <libfilezilla/format.hpp>
+
+#include "bench.hpp"
+
+#include "../../src/filezilla/metrics/registry.hpp"
+
+/*
+ * Measures the cost of updating the metrics from the hot paths, with several threads updating the same ones
+ * as the sessions of different event loops do, and relates it to the cost of moving a 64 KiB chunk of data,
+ * which is what a channel does between two updates of its byte counters.
+ */
+
+namespace {
+
+constexpr std::size_t threads_count = 4;
+constexpr std::size_t iterations = 1000000;
+constexpr std::size_t chunk_size = 64*1024;
+
+template <typename F>
+fz::bench::samples run_threads(F &&f)
+{
+	std::vector<fz::bench::samples> per_thread(threads_count);
+	std::vector<std::thread> threads;
+
+	for (std::size_t t = 0; t < threads_count; ++t) {
+		threads.emplace_back([&, t] {
+			auto &s = per_thread[t];
+
+			// Timing each update on its own would mostly measure the clock: time batches instead.
+			for (std::size_t i = 0; i < iterations / 100; ++i) {
+				auto start = fz::bench::clock::now();
+
+				for (std::size_t j = 0; j < 100; ++j)
+					f(i * 100 + j);
+
+				s.add((fz::bench::clock::now() - start) / 100);
+			}
+		});
+	}
+
+	for (auto &t: threads)
+		t.join();
+
+	fz::bench::samples all;
+	for (auto &s: per_thread)
+		all.merge(s);
+
+	return all;
+}
+
+void metrics_update(fz::bench::state &state)
+{
+	fz::metrics::registry r;
+
+	auto &c = r.get_counter("bench_total", "");
+	auto &h = r.get_histogram("bench_seconds", "", fz::metrics::unit::microseconds);
+
+	auto counter_samples = run_threads([&](std::size_t) {
+		c.add(chunk_size);
+	});
+
+	state.report(fz::sprintf("counter add, %d threads", threads_count), counter_samples);
+
+	auto histogram_samples = run_threads([&](std::size_t i) {
+		h.record(std::uint64_t(i & 0xffff));
+	});
+
+	state.report(fz::sprintf("histogram record, %d threads", threads_count), histogram_samples);
+
+	// The data path: copying a chunk between buffers, as the channel does, with and without accounting for it.
+	fz::buffer from, to;
+	from.append(std::string(chunk_size, 'x'));
+
+	auto copy = [&] {
+		to.clear();
+		to.append(from.get(), from.size());
+		fz::bench::do_not_optimize(to.get());
+	};
+
+	fz::bench::samples plain, counted;
+
+	for (std::size_t i = 0; i < 20000; ++i) {
+		plain.time(copy);
+		counted.time([&] {
+			copy();
+			c.add(chunk_size);
+		});
+	}
+
+	state.report("64 KiB chunk copy", plain);
+	state.report("64 KiB chunk copy, counted", counted);
+
+	auto start = fz::bench::clock::now();
+	for (std::size_t i = 0; i < 20000; ++i)
+		copy();
+	auto plain_ns = std::chrono::duration<double, std::nano>(fz::bench::clock::now() - start).count();
+
+	start = fz::bench::clock::now();
+	for (std::size_t i = 0; i < 20000; ++i) {
+		copy();
+		c.add(chunk_size);
+	}
+	auto counted_ns = std::chrono::duration<double, std::nano>(fz::bench::clock::now() - start).count();
+
+	state.report("64 KiB chunk copy", "overhead_percent", (counted_ns - plain_ns) * 100 / plain_ns);
+}
+
+}
+
+FZ_BENCHMARK(metrics_update);
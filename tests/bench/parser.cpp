@@ -0,0 +1,108 @@
+#include <libfilezilla/format.hpp>
+
+#include "bench.hpp"
+
+#include "../../src/filezilla/util/parser.hpp"
+#include "../../src/filezilla/hostaddress.hpp"
+
+/*
+ * Measures the parsers the FTP commands and the IP filters go through: bare IPs, PORT/EPRT arguments,
+ * whole host addresses and the address ranges of the allowed/disallowed lists.
+ */
+
+namespace {
+
+constexpr std::size_t iterations = 1000000;
+constexpr std::size_t batch_size = 1000;
+
+// Different inputs per iteration, so that the branch predictor can't learn a single one.
+template <typename F>
+std::vector<std::string> make_inputs(F &&f)
+{
+	std::vector<std::string> v;
+	v.reserve(256);
+
+	for (int i = 0; i < 256; ++i)
+		v.push_back(f(i));
+
+	return v;
+}
+
+void parser_ip(fz::bench::state &state)
+{
+	auto ipv4s = make_inputs([](int i) { return fz::sprintf("%d.%d.%d.%d", i, 255 - i, (i * 7) & 0xff, (i * 13) & 0xff); });
+
+	state.measure_batched("parse_ip ipv4", iterations, batch_size, [&](std::size_t i) {
+		fz::hostaddress::ipv4_host ipv4;
+		fz::util::parseable_range r(ipv4s[i & 0xff]);
+
+		fz::bench::do_not_optimize(fz::parse_ip(r, ipv4) && eol(r));
+		fz::bench::do_not_optimize(ipv4);
+	});
+
+	auto ipv6s = make_inputs([](int i) { return fz::sprintf("2001:db8:%x:%x::%x:%x", i, 255 - i, i * 97, i * 31); });
+
+	state.measure_batched("parse_ip ipv6", iterations, batch_size, [&](std::size_t i) {
+		fz::hostaddress::ipv6_host ipv6;
+		fz::util::parseable_range r(ipv6s[i & 0xff]);
+
+		fz::bench::do_not_optimize(fz::parse_ip(r, ipv6) && eol(r));
+		fz::bench::do_not_optimize(ipv6);
+	});
+
+	auto eprts = make_inputs([](int i) { return fz::sprintf("|1|10.%d.%d.%d|%d|", i, 255 - i, (i * 7) & 0xff, 1024 + i * 97); });
+
+	state.measure_batched("parse_eprt_cmd", iterations, batch_size, [&](std::size_t i) {
+		fz::address_type ipv{};
+		fz::hostaddress::ipv4_host ipv4;
+		fz::hostaddress::ipv6_host ipv6;
+		std::uint16_t port{};
+
+		fz::util::parseable_range r(eprts[i & 0xff]);
+
+		fz::bench::do_not_optimize(fz::parse_eprt_cmd(r, ipv, ipv4, ipv6, port));
+		fz::bench::do_not_optimize(port);
+	});
+}
+
+FZ_BENCHMARK(parser_ip);
+
+void hostaddress_parse(fz::bench::state &state)
+{
+	auto ipv4s = make_inputs([](int i) { return fz::sprintf("%d.%d.%d.%d", i, 255 - i, (i * 7) & 0xff, (i * 13) & 0xff); });
+	auto ipv6s = make_inputs([](int i) { return fz::sprintf("2001:db8:%x:%x::%x", i, 255 - i, i * 97); });
+	auto ports = make_inputs([](int i) { return fz::sprintf("10,%d,%d,%d,4,1", i, 255 - i, (i * 7) & 0xff); });
+
+	state.measure_batched("hostaddress ipvx, ipv4", iterations, batch_size, [&](std::size_t i) {
+		fz::hostaddress h(ipv4s[i & 0xff], fz::hostaddress::format::ipvx, 21);
+		fz::bench::do_not_optimize(h.is_valid());
+	});
+
+	state.measure_batched("hostaddress ipvx, ipv6", iterations, batch_size, [&](std::size_t i) {
+		fz::hostaddress h(ipv6s[i & 0xff], fz::hostaddress::format::ipvx, 21);
+		fz::bench::do_not_optimize(h.is_valid());
+	});
+
+	state.measure_batched("hostaddress port_cmd", iterations, batch_size, [&](std::size_t i) {
+		fz::hostaddress h(ports[i & 0xff], fz::hostaddress::format::port_cmd);
+		fz::bench::do_not_optimize(h.is_valid());
+	});
+
+	auto ranges = make_inputs([](int i) { return fz::sprintf("10.%d.0.0-10.%d.255.255", i, i); });
+
+	state.measure_batched("hostaddress::range ipv4", iterations, batch_size, [&](std::size_t i) {
+		fz::hostaddress::range<> r(ranges[i & 0xff]);
+		fz::bench::do_not_optimize(r.is_valid());
+	});
+
+	auto cidrs = make_inputs([](int i) { return fz::sprintf("2001:db8:%x:%x::/%d", i, 255 - i, 32 + i % 96); });
+
+	state.measure_batched("hostaddress::range ipv6 cidr", iterations, batch_size, [&](std::size_t i) {
+		fz::hostaddress::range<> r(cidrs[i & 0xff]);
+		fz::bench::do_not_optimize(r.is_valid());
+	});
+}
+
+FZ_BENCHMARK(hostaddress_parse);
+
+}
@@ -0,0 +1,69 @@
+#include <memory>
+
+#include <libfilezilla/format.hpp>
+
+#include "bench.hpp"
+
+#include "../../src/filezilla/port_randomizer.hpp"
+
+namespace {
+
+std::string peer_ip(std::size_t i)
+{
+	return fz::sprintf("10.%d.%d.%d", (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+}
+
+/*
+ * Measures how long it takes to get a passive mode port while the range fills up,
+ * from the given occupancy percentage up to the whole range.
+ * The ports are leased by distinct peers and kept connected, as it happens with many parallel transfers.
+ */
+void measure_at_occupancy(fz::bench::state &state, int percentage)
+{
+	constexpr int min_port = 1024;
+	constexpr int max_port = 65535;
+	constexpr int range = max_port - min_port + 1;
+	constexpr int rounds = 5;
+
+	int const prefilled = range * percentage / 100;
+	int const measured = percentage < 95 ? range / 20 : range - prefilled;
+
+	fz::bench::samples samples(std::size_t(rounds * measured));
+
+	for (int round = 0; round < rounds; ++round) {
+		auto manager = std::make_unique<fz::port_manager>();
+
+		std::vector<fz::port_lease> leases;
+		leases.reserve(std::size_t(range));
+
+		for (int i = 0; i < prefilled; ++i) {
+			fz::port_randomizer r(*manager, peer_ip(std::size_t(i)), min_port, max_port);
+			leases.emplace_back(r.get_port()).set_connected();
+		}
+
+		for (int i = prefilled; i < prefilled + measured; ++i) {
+			auto ip = peer_ip(std::size_t(i));
+
+			auto &l = leases.emplace_back(samples.time([&] {
+				fz::port_randomizer r(*manager, ip, min_port, max_port);
+				return r.get_port();
+			}));
+
+			fz::bench::do_not_optimize(l.get_port());
+			l.set_connected();
+		}
+	}
+
+	state.report(fz::sprintf("PASV at %d%% occupancy", percentage), samples);
+}
+
+void port_randomizer_get_port(fz::bench::state &state)
+{
+	measure_at_occupancy(state, 0);
+	measure_at_occupancy(state, 50);
+	measure_at_occupancy(state, 95);
+}
+
+FZ_BENCHMARK(port_randomizer_get_port);
+
+}
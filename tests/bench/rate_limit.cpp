@@ -0,0 +1,268 @@
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include <sys/resource.h>
+
+#include <libfilezilla/event_handler.hpp>
+#include <libfilezilla/event_loop.hpp>
+#include <libfilezilla/format.hpp>
+#include <libfilezilla/rate_limiter.hpp>
+
+#include "bench.hpp"
+
+#include "../../src/filezilla/rate_limit/shared_limiter.hpp"
+
+/*
+ * Simulates thousands of rate limited sessions spread among several event loops, each one subject
+ * to its own limit and to the limit of its user, the latter shared by many sessions.
+ *
+ * The sessions transfer as much as their buckets allow, and wait for the next wakeup when they run dry,
+ * as a compound_rate_limited_layer does. The intervals between wakeups, the delay with which they get delivered
+ * to the sessions and the CPU time spent by the whole process are reported, once with all the limiters
+ * refilled by a single rate_limit_manager and once with a sharded_manager.
+ */
+
+namespace {
+
+constexpr std::size_t loops_count = 4;
+constexpr std::size_t sessions_count = 5000;
+constexpr std::size_t sessions_per_user = 50;
+constexpr fz::rate::type session_limit = 32 * 1024;
+constexpr fz::rate::type user_limit = 512 * 1024;
+constexpr auto run_time = std::chrono::seconds(3);
+
+struct wakeup_event_type{};
+using wakeup_event = fz::simple_event<wakeup_event_type, fz::bench::clock::time_point>;
+
+class session final: public fz::event_handler
+{
+	class bucket final: public fz::bucket
+	{
+	public:
+		bucket(session &owner)
+			: owner_(owner)
+		{}
+
+		~bucket() override
+		{
+			remove_bucket();
+		}
+
+	private:
+		void wakeup(fz::direction::type d) override
+		{
+			if (d == fz::direction::outbound)
+				owner_.send_event<wakeup_event>(fz::bench::clock::now());
+		}
+
+		session &owner_;
+	};
+
+public:
+	session(fz::event_loop &loop, fz::rate_limiter &session_limiter, fz::rate_limiter &user_limiter, std::function<void(std::uint64_t)> on_transferred = {})
+		: fz::event_handler(loop)
+		, on_transferred_(std::move(on_transferred))
+		, session_bucket_(*this)
+		, user_bucket_(*this)
+	{
+		session_limiter.add(&session_bucket_);
+		user_limiter.add(&user_bucket_);
+
+		send_event<wakeup_event>(fz::bench::clock::now());
+	}
+
+	~session() override
+	{
+		session_bucket_.remove_bucket();
+		user_bucket_.remove_bucket();
+		remove_handler();
+	}
+
+	void stop()
+	{
+		stopped_ = true;
+	}
+
+	std::vector<std::int64_t> intervals_ns;
+	std::vector<std::int64_t> delays_ns;
+	std::atomic<std::uint64_t> transferred{};
+
+private:
+	void operator()(const fz::event_base &ev) override
+	{
+		fz::dispatch<wakeup_event>(ev, this, &session::on_wakeup);
+	}
+
+	void on_wakeup(fz::bench::clock::time_point sent)
+	{
+		if (stopped_)
+			return;
+
+		auto now = fz::bench::clock::now();
+
+		delays_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(now - sent).count());
+		if (last_wakeup_ != fz::bench::clock::time_point{})
+			intervals_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_wakeup_).count());
+
+		last_wakeup_ = now;
+
+		// Whichever bucket runs dry wakes the session up once refilled.
+		auto amount = std::min(session_bucket_.available(fz::direction::outbound), user_bucket_.available(fz::direction::outbound));
+		if (amount == 0)
+			return;
+
+		session_bucket_.consume(fz::direction::outbound, amount);
+		user_bucket_.consume(fz::direction::outbound, amount);
+		transferred.fetch_add(amount, std::memory_order_relaxed);
+
+		if (on_transferred_)
+			on_transferred_(amount);
+
+		send_event<wakeup_event>(now);
+	}
+
+	std::function<void(std::uint64_t)> on_transferred_;
+	bucket session_bucket_;
+	bucket user_bucket_;
+	fz::bench::clock::time_point last_wakeup_{};
+	std::atomic<bool> stopped_{};
+};
+
+double cpu_ms()
+{
+	rusage ru{};
+	getrusage(RUSAGE_SELF, &ru);
+
+	auto ms = [](const timeval &tv) {
+		return double(tv.tv_sec) * 1000 + double(tv.tv_usec) / 1000;
+	};
+
+	return ms(ru.ru_utime) + ms(ru.ru_stime);
+}
+
+void report(fz::bench::state &state, std::string_view label, std::vector<std::unique_ptr<session>> &sessions, double cpu)
+{
+	fz::bench::samples intervals;
+	fz::bench::samples delays;
+	std::uint64_t transferred = 0;
+
+	for (auto &s: sessions) {
+		for (auto ns: s->intervals_ns)
+			intervals.add(std::chrono::nanoseconds(ns));
+
+		for (auto ns: s->delays_ns)
+			delays.add(std::chrono::nanoseconds(ns));
+
+		transferred += s->transferred;
+	}
+
+	state.report(fz::sprintf("%s, interval between wakeups", label), intervals);
+	state.report(fz::sprintf("%s, wakeup delivery delay", label), delays);
+	state.report(label, "cpu_ms", cpu);
+	state.report(label, "throughput_bytes_per_s", double(transferred) / std::chrono::duration<double>(run_time).count());
+}
+
+template <typename Setup>
+void run(fz::bench::state &state, std::string_view label, Setup &&setup)
+{
+	std::vector<std::unique_ptr<fz::event_loop>> loops;
+	for (std::size_t i = 0; i < loops_count; ++i)
+		loops.push_back(std::make_unique<fz::event_loop>());
+
+	auto cpu_start = cpu_ms();
+
+	// The setup returns the sessions together with whatever owns the limiters, which must outlive the sessions.
+	auto [owner, sessions] = setup(loops);
+
+	std::this_thread::sleep_for(run_time);
+
+	for (auto &s: sessions)
+		s->stop();
+
+	auto cpu = cpu_ms() - cpu_start;
+
+	// Let the wakeups already being handled complete.
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	report(state, label, sessions, cpu);
+
+	sessions.clear();
+	owner.reset();
+}
+
+struct single_manager_setup
+{
+	single_manager_setup(fz::event_loop &loop)
+		: manager(loop)
+	{}
+
+	fz::rate_limit_manager manager;
+	std::vector<std::unique_ptr<fz::rate_limiter>> limiters;
+};
+
+struct sharded_manager_setup
+{
+	sharded_manager_setup(fz::event_loop &loop)
+		: manager(loop)
+	{}
+
+	fz::rate_limit::sharded_manager manager;
+	std::vector<std::unique_ptr<fz::rate_limit::shared_limiter>> user_limiters;
+	std::vector<std::unique_ptr<fz::rate_limiter>> session_limiters;
+};
+
+void rate_limit_5k_sessions(fz::bench::state &state)
+{
+	run(state, "single rate_limit_manager", [](auto &loops) {
+		auto setup = std::make_unique<single_manager_setup>(*loops[0]);
+		std::vector<std::unique_ptr<session>> sessions;
+
+		fz::rate_limiter *user = nullptr;
+
+		for (std::size_t i = 0; i < sessions_count; ++i) {
+			if (i % sessions_per_user == 0) {
+				user = setup->limiters.emplace_back(std::make_unique<fz::rate_limiter>(&setup->manager)).get();
+				user->set_limits(fz::rate::unlimited, user_limit);
+			}
+
+			auto &limiter = *setup->limiters.emplace_back(std::make_unique<fz::rate_limiter>(&setup->manager));
+			limiter.set_limits(fz::rate::unlimited, session_limit);
+
+			sessions.push_back(std::make_unique<session>(*loops[i % loops.size()], limiter, *user));
+		}
+
+		return std::make_pair(std::move(setup), std::move(sessions));
+	});
+
+	run(state, "sharded_manager", [](auto &loops) {
+		auto setup = std::make_unique<sharded_manager_setup>(*loops[0]);
+		std::vector<std::unique_ptr<session>> sessions;
+
+		fz::rate_limit::shared_limiter *user = nullptr;
+
+		for (std::size_t i = 0; i < sessions_count; ++i) {
+			if (i % sessions_per_user == 0) {
+				user = setup->user_limiters.emplace_back(std::make_unique<fz::rate_limit::shared_limiter>(setup->manager)).get();
+				user->set_limits(fz::rate::unlimited, user_limit);
+			}
+
+			auto &loop = *loops[i % loops.size()];
+			auto &shard = user->get(loop);
+
+			auto &limiter = *setup->session_limiters.emplace_back(std::make_unique<fz::rate_limiter>(&setup->manager.get(loop)));
+			limiter.set_limits(fz::rate::unlimited, session_limit);
+
+			sessions.push_back(std::make_unique<session>(loop, limiter, shard.limiter(), [&shard](std::uint64_t amount) {
+				shard.add_transferred(fz::direction::outbound, std::int64_t(amount));
+			}));
+		}
+
+		return std::make_pair(std::move(setup), std::move(sessions));
+	});
+}
+
+FZ_BENCHMARK(rate_limit_5k_sessions);
+
+}
@@ -0,0 +1,134 @@
+#include <libfilezilla/format.hpp>
+
+#include "bench.hpp"
+
+#include "../../src/filezilla/authentication/file_based_authenticator.hpp"
+#include "../../src/filezilla/serialization/archives/binary.hpp"
+#include "../../src/filezilla/serialization/archives/xml.hpp"
+
+/*
+ * Measures the archives on the users and groups, which are loaded from and saved to XML at startup and on every change,
+ * and which go through the binary archive whenever the administration interface gets or sets them.
+ */
+
+namespace {
+
+using groups_t = fz::authentication::file_based_authenticator::groups;
+using users_t = fz::authentication::file_based_authenticator::users;
+
+constexpr std::size_t groups_count = 20;
+constexpr std::size_t users_counts[] = { 100, 1000, 10000 };
+
+#ifdef FZ_WINDOWS
+const fz::native_string native_root = fzT("C:\\srv\\ftp");
+#else
+const fz::native_string native_root = fzT("/srv/ftp");
+#endif
+
+groups_t make_groups()
+{
+	groups_t groups;
+
+	for (std::size_t i = 0; i < groups_count; ++i) {
+		auto &g = groups[fz::sprintf("group %d", i)];
+
+		g.mount_table.push_back({ fz::sprintf("/shared/%d", i), fz::sprintf(fzT("%s/groups/%d"), native_root, i), fz::tvfs::mount_point::read_only });
+		g.mount_table.push_back({ fz::sprintf("/shared/%d/incoming", i), fz::sprintf(fzT("%s/groups/%d/incoming"), native_root, i) });
+		g.rate_limits.inbound = 10 * 1024 * 1024;
+		g.rate_limits.outbound = 10 * 1024 * 1024;
+		g.description = fz::sprintf("Members of department %d", i);
+	}
+
+	return groups;
+}
+
+users_t make_users(std::size_t count)
+{
+	users_t users;
+
+	// PBKDF2 is slow by design: hash once, and give all the users the same password.
+	fz::authentication::credentials credentials;
+	credentials.password = fz::authentication::password::pbkdf2::hmac_sha256("correct horse battery staple");
+
+	for (std::size_t i = 0; i < count; ++i) {
+		auto &u = users[fz::sprintf("user%d", i)];
+
+		u.mount_table.push_back({ "/", fz::sprintf(fzT("%s/users/%d"), native_root, i) });
+		u.groups.push_back(fz::sprintf("group %d", i % groups_count));
+
+		if (i % 4 == 0)
+			u.groups.push_back(fz::sprintf("group %d", (i + 1) % groups_count));
+
+		if (i % 10 == 0)
+			fz::tcp::convert(fz::sprintf("10.%d.0.0/16 192.168.%d.1-192.168.%d.254", i % 256, i % 256, i % 256), u.allowed_ips);
+
+		u.credentials = credentials;
+		u.methods = u.credentials.get_most_secure_methods();
+		u.session_count_limit = 10;
+		u.description = fz::sprintf("Account of customer n. %d", i);
+	}
+
+	return users;
+}
+
+void serialization_users_and_groups(fz::bench::state &state)
+{
+	using namespace fz::serialization;
+
+	auto groups = make_groups();
+
+	for (auto count: users_counts) {
+		auto users = make_users(count);
+		auto const iterations = 100000 / count;
+
+		fz::buffer buffer;
+
+		state.measure(fz::sprintf("binary save, %d users", count), iterations, [&] {
+			buffer.clear();
+			fz::bench::do_not_optimize(bool(binary_output_archive{buffer}(groups, users)));
+		});
+
+		state.report(fz::sprintf("binary save, %d users", count), "size_bytes", double(buffer.size()));
+
+		state.measure(fz::sprintf("binary load, %d users", count), iterations, [&] {
+			fz::buffer copy = buffer;
+			groups_t g;
+			users_t u;
+
+			fz::bench::do_not_optimize(bool(binary_input_archive{copy}(g, u)));
+		});
+
+		fz::buffer groups_xml, users_xml;
+
+		state.measure(fz::sprintf("xml save, %d users", count), iterations, [&] {
+			groups_xml.clear();
+			users_xml.clear();
+
+			xml_output_archive::buffer_saver groups_saver(groups_xml);
+			xml_output_archive::buffer_saver users_saver(users_xml);
+
+			fz::bench::do_not_optimize(bool(xml_output_archive{groups_saver}(nvp{groups, ""})));
+			fz::bench::do_not_optimize(bool(xml_output_archive{users_saver}(nvp{users, ""})));
+		});
+
+		state.report(fz::sprintf("xml save, %d users", count), "size_bytes", double(groups_xml.size() + users_xml.size()));
+
+		state.measure(fz::sprintf("xml load, %d users", count), iterations, [&] {
+			fz::buffer groups_copy = groups_xml;
+			fz::buffer users_copy = users_xml;
+
+			xml_input_archive::buffer_loader groups_loader(groups_copy, true);
+			xml_input_archive::buffer_loader users_loader(users_copy, true);
+
+			groups_t g;
+			users_t u;
+
+			fz::bench::do_not_optimize(bool(xml_input_archive{groups_loader}(nvp{g, ""})));
+			fz::bench::do_not_optimize(bool(xml_input_archive{users_loader}(nvp{u, ""})));
+		});
+	}
+}
+
+FZ_BENCHMARK(serialization_users_and_groups);
+
+}
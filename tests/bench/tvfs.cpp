@@ -0,0 +1,140 @@
+#include <libfilezilla/format.hpp>
+
+#include "bench.hpp"
+
+#include "../../src/filezilla/tvfs/entry.hpp"
+#include "../../src/filezilla/tvfs/mount.hpp"
+
+/*
+ * Measures what every directory listing and every path based command go through:
+ * the rendering of the MLSD facts and of the LIST lines, and the resolution of a virtual path into a native one.
+ */
+
+namespace {
+
+constexpr std::size_t iterations = 1000000;
+
+#ifdef FZ_WINDOWS
+const fz::native_string native_root = fzT("C:\\srv\\ftp");
+#else
+const fz::native_string native_root = fzT("/srv/ftp");
+#endif
+
+// The entries are otherwise only made by the tvfs engine while iterating over a directory.
+struct listed_entry: fz::tvfs::entry
+{
+	listed_entry(std::string name, fz::tvfs::entry_type type, fz::tvfs::entry_size size, fz::datetime mtime)
+	{
+		name_ = std::move(name);
+		type_ = type;
+		size_ = size;
+		mtime_ = mtime;
+		perms_ = fz::tvfs::permissions::read | fz::tvfs::permissions::write;
+	}
+};
+
+std::vector<listed_entry> make_entries()
+{
+	std::vector<listed_entry> entries;
+	entries.reserve(256);
+
+	auto const now = fz::datetime::now();
+
+	for (int i = 0; i < 256; ++i) {
+		auto const is_dir = i % 8 == 0;
+
+		entries.emplace_back(
+			fz::sprintf("%s %d.%s", is_dir ? "folder" : "document", i, is_dir ? "d" : "pdf"),
+			is_dir ? fz::tvfs::entry_type::dir : fz::tvfs::entry_type::file,
+			is_dir ? -1 : fz::tvfs::entry_size(i) * 104729,
+			now - fz::duration::from_seconds(i * 86400 + i * 37)
+		);
+	}
+
+	return entries;
+}
+
+template <typename Line>
+void measure_lines(fz::bench::state &state, std::string_view label, const std::vector<listed_entry> &entries, Line line)
+{
+	fz::buffer buffer;
+
+	state.measure_batched(label, iterations, 256, [&](std::size_t i) {
+		// Like the listers do, once the socket has taken the data.
+		if ((i & 255) == 0)
+			buffer.clear();
+
+		fz::util::buffer_streamer bs(buffer);
+		line(bs, entries[i & 255]);
+	});
+
+	fz::bench::do_not_optimize(buffer.size());
+}
+
+void tvfs_entry_rendering(fz::bench::state &state)
+{
+	auto entries = make_entries();
+
+	measure_lines(state, "MLSD facts", entries, [](fz::util::buffer_streamer &bs, const fz::tvfs::entry &e) {
+		bs << fz::tvfs::entry_facts(e) << "\r\n";
+	});
+
+	measure_lines(state, "LIST stats", entries, [](fz::util::buffer_streamer &bs, const fz::tvfs::entry &e) {
+		bs << fz::tvfs::entry_stats(e) << "\r\n";
+	});
+
+	measure_lines(state, "NLST name", entries, [](fz::util::buffer_streamer &bs, const fz::tvfs::entry &e) {
+		bs << fz::tvfs::entry_name(e) << "\r\n";
+	});
+}
+
+FZ_BENCHMARK(tvfs_entry_rendering);
+
+/*
+ * A mount tree with the given number of mount points, half of them nested into the other half,
+ * as it happens with per-user folders mounted inside a shared one.
+ */
+fz::tvfs::mount_tree make_mount_tree(std::size_t count)
+{
+	fz::tvfs::mount_table mt;
+
+	mt.push_back({ "/", native_root });
+
+	for (std::size_t i = 0; i < count / 2; ++i) {
+		mt.push_back({ fz::sprintf("/share %d", i), fz::sprintf(fzT("%s/shares/%d"), native_root, i), fz::tvfs::mount_point::read_only });
+		mt.push_back({ fz::sprintf("/share %d/incoming", i), fz::sprintf(fzT("%s/incoming/%d"), native_root, i) });
+	}
+
+	return fz::tvfs::mount_tree(mt);
+}
+
+void tvfs_resolve_path(fz::bench::state &state)
+{
+	for (std::size_t count: { 2, 16, 256 }) {
+		auto tree = make_mount_tree(count);
+
+		std::vector<fz::util::fs::absolute_unix_path> paths;
+		paths.reserve(256);
+
+		for (std::size_t i = 0; i < 256; ++i) {
+			auto const share = i % (count / 2);
+
+			switch (i % 4) {
+				case 0: paths.emplace_back(fz::sprintf("/share %d", share)); break;
+				case 1: paths.emplace_back(fz::sprintf("/share %d/reports/2024/q%d.pdf", share, i % 4)); break;
+				case 2: paths.emplace_back(fz::sprintf("/share %d/incoming/upload %d.bin", share, i)); break;
+				case 3: paths.emplace_back(fz::sprintf("/private/user %d/a/b/c/d/file.txt", i)); break;
+			}
+		}
+
+		state.measure_batched(fz::sprintf("resolve_path, %d mount points", count), iterations, 256, [&](std::size_t i) {
+			auto [node, level, native] = tree.resolve_path(paths[i & 255]);
+			fz::bench::do_not_optimize(level);
+			fz::bench::do_not_optimize(native.str().size());
+		});
+	}
+}
+
+FZ_BENCHMARK(tvfs_resolve_path);
+
+}
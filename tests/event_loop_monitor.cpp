@@ -0,0 +1,129 @@
+#include <libfilezilla/event_loop.hpp>
+#include <libfilezilla/util.hpp>
+
+#include "test_utils.hpp"
+
+#include "../src/filezilla/event_loop_monitor.hpp"
+
+using fz::event_loop_monitor;
+
+class event_loop_monitor_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(event_loop_monitor_test);
+	CPPUNIT_TEST(test_stall);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_stall();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(event_loop_monitor_test);
+
+namespace {
+
+struct capturing_logger: fz::logger_interface
+{
+	capturing_logger()
+	{
+		set_all(fz::logmsg::type(~0));
+	}
+
+	void do_log(fz::logmsg::type, std::wstring &&msg) override
+	{
+		fz::scoped_lock lock(mutex);
+		messages.push_back(fz::to_utf8(msg));
+	}
+
+	bool contains(std::string_view s)
+	{
+		fz::scoped_lock lock(mutex);
+
+		for (auto &m: messages) {
+			if (m.find(s) != std::string::npos)
+				return true;
+		}
+
+		return false;
+	}
+
+	fz::mutex mutex;
+	std::vector<std::string> messages;
+};
+
+struct work_event_tag{};
+using work_event = fz::simple_event<work_event_tag>;
+
+class slow_handler final: public fz::event_handler
+{
+public:
+	slow_handler(fz::event_loop &loop)
+		: fz::event_handler(loop)
+	{}
+
+	~slow_handler() override
+	{
+		remove_handler();
+	}
+
+	void wait()
+	{
+		fz::scoped_lock lock(mutex_);
+		while (!done_)
+			condition_.wait(lock);
+	}
+
+private:
+	void operator()(const fz::event_base &ev) override
+	{
+		{
+			event_loop_monitor::dispatch_scope monitored(*this, ev, 42);
+			fz::sleep(fz::duration::from_milliseconds(150));
+		}
+
+		fz::scoped_lock lock(mutex_);
+		done_ = true;
+		condition_.signal(lock);
+	}
+
+	fz::mutex mutex_;
+	fz::condition condition_;
+	bool done_{};
+};
+
+}
+
+void event_loop_monitor_test::test_stall()
+{
+	fz::thread_pool pool;
+	capturing_logger logger;
+
+	event_loop_monitor monitor(pool, logger, event_loop_monitor::options()
+		.probe_interval(fz::duration::from_milliseconds(10))
+		.stall_threshold(fz::duration::from_milliseconds(50)));
+
+	fz::event_loop loop(pool);
+
+	{
+		event_loop_monitor::probe probe(monitor, loop, "test");
+		slow_handler handler(loop);
+
+		// Queued after the probe's first event, which tells the monitor what loop the thread runs.
+		handler.send_event<work_event>();
+		handler.wait();
+
+		auto summary = monitor.get_summary();
+		CPPUNIT_ASSERT_EQUAL(std::size_t(1), summary.size());
+		CPPUNIT_ASSERT_EQUAL(std::string("test"), summary[0].name);
+		CPPUNIT_ASSERT_EQUAL(std::uint64_t(1), summary[0].dispatches);
+		CPPUNIT_ASSERT_EQUAL(std::uint64_t(1), summary[0].stalls);
+		CPPUNIT_ASSERT(summary[0].dispatch_max_us >= 150000);
+
+		// Both the watchdog, while the handler was busy, and the scope, once done, have logged it.
+		CPPUNIT_ASSERT(logger.contains("has been busy for"));
+		CPPUNIT_ASSERT(logger.contains("slow_handler"));
+		CPPUNIT_ASSERT(logger.contains("of session 42"));
+	}
+
+	// Loops that are no longer probed are left out.
+	CPPUNIT_ASSERT(monitor.get_summary().empty());
+}
@@ -0,0 +1,107 @@
+#include <libfilezilla/event_loop.hpp>
+
+#include "test_utils.hpp"
+
+#include "../src/filezilla/authentication/failure_tracker.hpp"
+
+using fz::authentication::failure_tracker;
+
+class failure_tracker_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(failure_tracker_test);
+	CPPUNIT_TEST(test_timing_wheel);
+	CPPUNIT_TEST(test_window);
+	CPPUNIT_TEST(test_expiry);
+	CPPUNIT_TEST(test_max_entries);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_timing_wheel();
+	void test_window();
+	void test_expiry();
+	void test_max_entries();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(failure_tracker_test);
+
+void failure_tracker_test::test_timing_wheel()
+{
+	fz::util::timing_wheel<int> wheel;
+
+	// Spans all the levels, and beyond.
+	std::vector<std::uint64_t> whens = { 1, 63, 64, 65, 4095, 4096, 4097, 300000, 20000000 };
+	for (std::size_t i = 0; i < whens.size(); ++i)
+		wheel.schedule(int(i), whens[i]);
+
+	CPPUNIT_ASSERT_EQUAL(whens.size(), wheel.size());
+
+	std::size_t expired = 0;
+	wheel.advance(whens.back(), [&](int i, std::uint64_t when) {
+		CPPUNIT_ASSERT_EQUAL(whens[std::size_t(i)], when);
+		CPPUNIT_ASSERT_EQUAL(when, wheel.now());
+		++expired;
+	});
+
+	CPPUNIT_ASSERT_EQUAL(whens.size(), expired);
+	CPPUNIT_ASSERT_EQUAL(std::size_t(0), wheel.size());
+}
+
+void failure_tracker_test::test_window()
+{
+	fz::event_loop loop;
+	failure_tracker<std::uint32_t> tracker(loop, failure_tracker<std::uint32_t>::options().window(fz::duration::from_milliseconds(320)));
+
+	auto now = fz::monotonic_clock::now();
+
+	tracker.with(1, [&](auto &e) {
+		CPPUNIT_ASSERT_EQUAL(std::size_t(1), e.add_failure(now));
+		CPPUNIT_ASSERT_EQUAL(std::size_t(2), e.add_failure(now + fz::duration::from_milliseconds(100)));
+		CPPUNIT_ASSERT_EQUAL(std::size_t(3), e.add_failure(now + fz::duration::from_milliseconds(200)));
+
+		// The first failure falls out of the window.
+		CPPUNIT_ASSERT_EQUAL(std::size_t(2), e.failures(now + fz::duration::from_milliseconds(360)));
+		CPPUNIT_ASSERT_EQUAL(std::size_t(0), e.failures(now + fz::duration::from_milliseconds(1000)));
+		return 0;
+	});
+}
+
+void failure_tracker_test::test_expiry()
+{
+	// The loop doesn't run, the test advances the expiry by itself.
+	fz::event_loop loop{fz::event_loop::threadless};
+
+	auto start = fz::monotonic_clock::now();
+	auto now = start;
+
+	failure_tracker<std::uint32_t> tracker(loop, failure_tracker<std::uint32_t>::options().window(fz::duration::from_milliseconds(200)), [&now]{ return now; });
+
+	tracker.with(1, [&](auto &e) { return e.add_failure(now); });
+	tracker.with(2, [&](auto &e) { e.hold(now + fz::duration::from_milliseconds(800)); return 0; });
+
+	CPPUNIT_ASSERT_EQUAL(std::size_t(2), tracker.size());
+
+	now = start + fz::duration::from_milliseconds(500);
+	tracker.expire();
+	CPPUNIT_ASSERT_EQUAL(std::size_t(1), tracker.size());
+	CPPUNIT_ASSERT(tracker.with_existing(2, [](auto *e) { return e != nullptr; }));
+
+	now = start + fz::duration::from_milliseconds(1100);
+	tracker.expire();
+	CPPUNIT_ASSERT_EQUAL(std::size_t(0), tracker.size());
+}
+
+void failure_tracker_test::test_max_entries()
+{
+	fz::event_loop loop;
+	failure_tracker<std::uint32_t> tracker(loop, failure_tracker<std::uint32_t>::options().max_entries(failure_tracker<std::uint32_t>::shards * 4));
+
+	auto now = fz::monotonic_clock::now();
+
+	for (std::uint32_t ip = 0; ip < 100000; ++ip)
+		tracker.with(ip, [&](auto &e) { return e.add_failure(now); });
+
+	CPPUNIT_ASSERT(tracker.size() <= failure_tracker<std::uint32_t>::shards * 4);
+
+	// The most recently seen are kept.
+	CPPUNIT_ASSERT(tracker.with_existing(99999, [](auto *e) { return e != nullptr; }));
+}
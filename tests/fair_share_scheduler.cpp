@@ -0,0 +1,150 @@
+#include <memory>
+#include <vector>
+
+#include <libfilezilla/event_loop.hpp>
+
+#include "test_utils.hpp"
+
+#include "../src/filezilla/rate_limit/fair_share_scheduler.hpp"
+
+/*
+ * This testsuite asserts that the bandwidth is shared fairly among users, regardless of the number of their sessions.
+ * Sessions are simulated: each one reports it has transferred as much as its current limit allowed.
+ * Time is simulated too: the scheduler's timers never fire, it's stepped explicitly once per tick of the fake clock.
+ */
+
+namespace {
+
+using scheduler = fz::rate_limit::fair_share_scheduler;
+
+constexpr fz::rate::type capacity = 1000 * 1000;
+
+struct simulation
+{
+	simulation(std::uint32_t greedy_weight = 1)
+		: manager(loop)
+		, now(fz::monotonic_clock::now())
+		, sched(loop, scheduler::options()
+			.outbound_capacity(capacity)
+			.tick(fz::duration::from_hours(1)),
+			[this]{ return now; })
+		, greedy_weight(greedy_weight)
+	{}
+
+	std::size_t add_session(const std::string &user)
+	{
+		auto &limiter = *limiters.emplace_back(std::make_unique<fz::rate_limiter>(&manager));
+		auto &leaf = *leaves.emplace_back(std::make_unique<scheduler::leaf>(sched, loop, limiter));
+		active.push_back(true);
+
+		leaf.set_class({user, user == "greedy" ? greedy_weight : 1}, {}, fz::rate::unlimited, fz::rate::unlimited);
+
+		return leaves.size() - 1;
+	}
+
+	void run(fz::duration d)
+	{
+		for (auto elapsed = fz::duration(); elapsed < d; elapsed += tick) {
+			for (std::size_t i = 0; i < leaves.size(); ++i) {
+				if (active[i])
+					leaves[i]->add_transferred(fz::direction::outbound, std::int64_t(limit(i) * fz::rate::type(tick.get_milliseconds()) / 1000));
+			}
+
+			now = now + tick;
+			sched.step();
+		}
+	}
+
+	fz::rate::type limit(std::size_t i)
+	{
+		return std::min(limiters[i]->limit(fz::direction::outbound), capacity);
+	}
+
+	static inline const fz::duration tick = fz::duration::from_milliseconds(100);
+
+	fz::event_loop loop;
+	fz::rate_limit_manager manager;
+	fz::monotonic_clock now;
+	scheduler sched;
+	std::uint32_t greedy_weight;
+
+	std::vector<std::unique_ptr<fz::rate_limiter>> limiters;
+	std::vector<std::unique_ptr<scheduler::leaf>> leaves;
+	std::vector<bool> active;
+};
+
+void assert_about(double expected, double actual)
+{
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(expected, actual, expected / 4);
+}
+
+}
+
+class fair_share_scheduler_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(fair_share_scheduler_test);
+	CPPUNIT_TEST(test_sessions_dont_multiply_the_share);
+	CPPUNIT_TEST(test_weights);
+	CPPUNIT_TEST(test_idle_capacity_is_borrowed);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_sessions_dont_multiply_the_share();
+	void test_weights();
+	void test_idle_capacity_is_borrowed();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(fair_share_scheduler_test);
+
+void fair_share_scheduler_test::test_sessions_dont_multiply_the_share()
+{
+	simulation s;
+
+	std::vector<std::size_t> greedy;
+	for (int i = 0; i < 20; ++i)
+		greedy.push_back(s.add_session("greedy"));
+
+	auto modest = s.add_session("modest");
+
+	s.run(fz::duration::from_milliseconds(1500));
+
+	double greedy_total = 0;
+	for (auto i: greedy)
+		greedy_total += double(s.limit(i));
+
+	assert_about(capacity / 2, greedy_total);
+	assert_about(capacity / 2, double(s.limit(modest)));
+}
+
+void fair_share_scheduler_test::test_weights()
+{
+	simulation s(3);
+
+	auto greedy = s.add_session("greedy");
+	auto modest = s.add_session("modest");
+
+	s.run(fz::duration::from_milliseconds(1500));
+
+	assert_about(capacity * 3 / 4, double(s.limit(greedy)));
+	assert_about(capacity / 4, double(s.limit(modest)));
+}
+
+void fair_share_scheduler_test::test_idle_capacity_is_borrowed()
+{
+	simulation s;
+
+	auto greedy = s.add_session("greedy");
+	auto modest = s.add_session("modest");
+
+	s.active[modest] = false;
+	s.run(fz::duration::from_milliseconds(1500));
+
+	assert_about(capacity, double(s.limit(greedy)));
+
+	// Once the idle user starts transferring, it gets its share back.
+	s.active[modest] = true;
+	s.run(fz::duration::from_milliseconds(1500));
+
+	assert_about(capacity / 2, double(s.limit(greedy)));
+	assert_about(capacity / 2, double(s.limit(modest)));
+}
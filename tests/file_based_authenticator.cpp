@@ -0,0 +1,130 @@
+#include <libfilezilla/event_loop.hpp>
+#include <libfilezilla/thread_pool.hpp>
+
+#include "test_utils.hpp"
+
+#include "../src/filezilla/authentication/file_based_authenticator.hpp"
+#include "../src/filezilla/authentication/password.hpp"
+#include "../src/filezilla/logger/null.hpp"
+#include "../src/filezilla/rate_limit/sharded_manager.hpp"
+
+using fz::authentication::file_based_authenticator;
+using fz::authentication::authenticator;
+using fz::authentication::error;
+
+class file_based_authenticator_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(file_based_authenticator_test);
+	CPPUNIT_TEST(test_swap_and_lookup);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_swap_and_lookup();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(file_based_authenticator_test);
+
+namespace {
+
+/// Waits for the outcome of an authentication.
+class waiter final: public fz::event_handler
+{
+public:
+	waiter(fz::event_loop &loop)
+		: fz::event_handler(loop)
+	{}
+
+	~waiter() override
+	{
+		remove_handler();
+	}
+
+	error authenticate(authenticator &auth, std::string_view name, std::string_view ip)
+	{
+		fz::scoped_lock lock(mutex_);
+		result_.reset();
+
+		auth.authenticate(name, {fz::authentication::method::password{"pw"}}, fz::address_type::ipv4, ip, *this);
+
+		while (!result_)
+			condition_.wait(lock);
+
+		return *result_;
+	}
+
+private:
+	void operator()(const fz::event_base &ev) override
+	{
+		fz::dispatch<authenticator::operation::result_event>(ev, this, &waiter::on_result);
+	}
+
+	void on_result(authenticator &, std::unique_ptr<authenticator::operation> &op)
+	{
+		fz::scoped_lock lock(mutex_);
+
+		result_ = op ? op->get_error() : error(error::internal);
+		if (!*result_ && !op->get_user())
+			result_ = error::internal;
+
+		condition_.signal(lock);
+	}
+
+	fz::mutex mutex_;
+	fz::condition condition_;
+	std::optional<error> result_;
+};
+
+file_based_authenticator::groups make_groups(bool with_filter)
+{
+	file_based_authenticator::group_entry g;
+	if (with_filter)
+		g.disallowed_ips.add("10.0.0.0/8", fz::address_type::ipv4);
+
+	file_based_authenticator::groups groups;
+	groups.emplace("staff", std::move(g));
+
+	return groups;
+}
+
+file_based_authenticator::users make_users(bool with_alice)
+{
+	file_based_authenticator::users users;
+
+	if (with_alice) {
+		file_based_authenticator::user_entry u;
+		u.groups = { "staff" };
+		u.credentials.password = fz::authentication::default_password("pw");
+		u.methods = u.credentials.get_most_secure_methods();
+
+		users.emplace("alice", std::move(u));
+	}
+
+	return users;
+}
+
+}
+
+void file_based_authenticator_test::test_swap_and_lookup()
+{
+	fz::thread_pool pool;
+	fz::event_loop loop(pool);
+	fz::rate_limit::sharded_manager rlm(loop);
+
+	file_based_authenticator auth(pool, loop, fz::logger::null, rlm);
+	waiter w(loop);
+
+	auth.set_groups_and_users(make_groups(true), make_users(true));
+
+	// The group's filter applies to its users.
+	CPPUNIT_ASSERT_EQUAL(error::ip_disallowed, error::type(w.authenticate(auth, "alice", "10.1.2.3")));
+	CPPUNIT_ASSERT_EQUAL(error::none, error::type(w.authenticate(auth, "alice", "192.168.1.1")));
+
+	// Lookups after the swap see the new database.
+	auth.set_groups_and_users(make_groups(false), make_users(true));
+	CPPUNIT_ASSERT_EQUAL(error::none, error::type(w.authenticate(auth, "alice", "10.1.2.3")));
+
+	auth.set_groups_and_users(make_groups(false), make_users(false));
+	CPPUNIT_ASSERT_EQUAL(error::user_nonexisting, error::type(w.authenticate(auth, "alice", "192.168.1.1")));
+
+	auth.stop_ongoing_authentications(w);
+}
@@ -0,0 +1,138 @@
+#include <atomic>
+
+#include <libfilezilla/event_loop.hpp>
+#include <libfilezilla/util.hpp>
+
+#include "test_utils.hpp"
+
+#include "../src/filezilla/tcp/hostname_cache.hpp"
+#include "../src/filezilla/logger/null.hpp"
+
+using fz::tcp::hostname_cache;
+
+class hostname_cache_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(hostname_cache_test);
+	CPPUNIT_TEST(test_literal);
+	CPPUNIT_TEST(test_resolve_and_expiry);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_literal();
+	void test_resolve_and_expiry();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(hostname_cache_test);
+
+namespace {
+
+/// Waits for the results of the cache and for its own timer.
+/// It lives on the same loop as the cache, hence a timer that expires after the cache's one is dispatched after it.
+class waiter final: public fz::event_handler
+{
+public:
+	waiter(fz::event_loop &loop)
+		: fz::event_handler(loop)
+	{}
+
+	~waiter() override
+	{
+		remove_handler();
+	}
+
+	std::optional<std::string> wait_result()
+	{
+		fz::scoped_lock lock(mutex_);
+		while (!result_)
+			condition_.wait(lock);
+
+		auto r = std::move(*result_);
+		result_.reset();
+		return r;
+	}
+
+	void wait_for(fz::duration d)
+	{
+		fz::scoped_lock lock(mutex_);
+		timed_out_ = false;
+		add_timer(d, true);
+
+		while (!timed_out_)
+			condition_.wait(lock);
+	}
+
+private:
+	void operator()(const fz::event_base &ev) override
+	{
+		fz::scoped_lock lock(mutex_);
+
+		if (ev.derived_type() == hostname_cache::result_event::type())
+			result_ = std::get<0>(static_cast<const hostname_cache::result_event &>(ev).v_);
+		else
+			timed_out_ = true;
+
+		condition_.signal(lock);
+	}
+
+	fz::mutex mutex_;
+	fz::condition condition_;
+	std::optional<std::optional<std::string>> result_;
+	bool timed_out_{};
+};
+
+}
+
+void hostname_cache_test::test_literal()
+{
+	fz::thread_pool pool;
+	fz::event_loop loop(pool);
+
+	hostname_cache cache(pool, loop, fz::logger::null);
+	waiter w(loop);
+
+	CPPUNIT_ASSERT(cache.lookup(fzT("127.0.0.1"), fz::address_type::ipv4, w) == std::string("127.0.0.1"));
+	CPPUNIT_ASSERT(cache.lookup(fzT("::1"), fz::address_type::unknown, w) == std::string("::1"));
+
+	cache.cancel(w);
+}
+
+void hostname_cache_test::test_resolve_and_expiry()
+{
+	fz::thread_pool pool;
+	fz::event_loop loop(pool);
+
+	// The timer ticks every retry_interval, in real time; the entries age according to the fake clock.
+	// The clock is read from the loop's thread, hence the atomic.
+	auto start = fz::monotonic_clock::now();
+	std::atomic<std::int64_t> elapsed_ms{};
+
+	hostname_cache cache(pool, loop, fz::logger::null, hostname_cache::options()
+		.refresh_interval(fz::duration::from_hours(1))
+		.retry_interval(fz::duration::from_milliseconds(10))
+		.expiry_interval(fz::duration::from_minutes(1)),
+		[&]{ return start + fz::duration::from_milliseconds(elapsed_ms); });
+
+	waiter w(loop);
+
+	CPPUNIT_ASSERT(!cache.lookup(fzT("localhost"), fz::address_type::ipv4, w));
+
+	auto ip = w.wait_result();
+	CPPUNIT_ASSERT(ip == std::string("127.0.0.1"));
+
+	// Served from the cache now.
+	CPPUNIT_ASSERT(cache.lookup(fzT("localhost"), fz::address_type::ipv4, w) == ip);
+
+	// Still used recently enough: it survives a few ticks of the timer.
+	elapsed_ms += 30 * 1000;
+	w.wait_for(fz::duration::from_milliseconds(50));
+	CPPUNIT_ASSERT(cache.lookup(fzT("localhost"), fz::address_type::ipv4, w) == ip);
+
+	// Not needed for longer than the expiry interval: it's forgotten, and needs another lookup.
+	elapsed_ms += 2 * 60 * 1000;
+	w.wait_for(fz::duration::from_milliseconds(50));
+	CPPUNIT_ASSERT(!cache.lookup(fzT("localhost"), fz::address_type::ipv4, w));
+
+	CPPUNIT_ASSERT(w.wait_result() == ip);
+
+	cache.cancel(w);
+}
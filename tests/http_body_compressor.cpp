@@ -0,0 +1,197 @@
+#include <vector>
+
+#include <zlib.h>
+
+#include <libfilezilla/format.hpp>
+
+#include "test_utils.hpp"
+
+#include "../src/filezilla/http/body_compressor.hpp"
+#include "../src/filezilla/http/headers.hpp"
+
+using fz::http::body_compressor;
+
+class http_body_compressor_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(http_body_compressor_test);
+	CPPUNIT_TEST(test_compress);
+	CPPUNIT_TEST(test_streaming);
+	CPPUNIT_TEST(test_idle_ticket);
+	CPPUNIT_TEST(test_is_compressible);
+	CPPUNIT_TEST(test_accepts_encoding);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_compress();
+	void test_streaming();
+	void test_idle_ticket();
+	void test_is_compressible();
+	void test_accepts_encoding();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(http_body_compressor_test);
+
+namespace {
+
+std::string gunzip(const fz::buffer &in)
+{
+	z_stream zs{};
+	if (inflateInit2(&zs, MAX_WBITS + 16) != Z_OK)
+		return {};
+
+	std::string out;
+	char chunk[4096];
+
+	zs.next_in = const_cast<unsigned char *>(in.get());
+	zs.avail_in = uInt(in.size());
+
+	int res;
+
+	do {
+		zs.next_out = reinterpret_cast<unsigned char *>(chunk);
+		zs.avail_out = sizeof(chunk);
+
+		res = inflate(&zs, Z_NO_FLUSH);
+		out.append(chunk, sizeof(chunk) - zs.avail_out);
+	} while (res == Z_OK);
+
+	inflateEnd(&zs);
+
+	return res == Z_STREAM_END ? out : "<corrupted>";
+}
+
+std::string make_listing(std::size_t lines)
+{
+	std::string s;
+
+	for (std::size_t i = 0; i < lines; ++i)
+		s += fz::sprintf(R"({"name":"file %d.txt","size":%d,"mtime":"20240101120000"})" "\n", i, i * 997);
+
+	return s;
+}
+
+class string_adder final: public fz::buffer_operator::adder
+{
+public:
+	string_adder(std::string_view data, std::size_t chunk_size)
+		: data_(data)
+		, chunk_size_(chunk_size)
+	{}
+
+	int add_to_buffer() override
+	{
+		if (data_.empty())
+			return ENODATA;
+
+		auto n = std::min(data_.size(), chunk_size_);
+		get_buffer()->append(data_.substr(0, n));
+		data_.remove_prefix(n);
+
+		return 0;
+	}
+
+private:
+	std::string_view data_;
+	std::size_t chunk_size_;
+};
+
+}
+
+void http_body_compressor_test::test_compress()
+{
+	auto listing = make_listing(1000);
+
+	fz::buffer compressed;
+	CPPUNIT_ASSERT(body_compressor::compress(listing, compressed));
+	CPPUNIT_ASSERT(compressed.size() < listing.size() / 4);
+	CPPUNIT_ASSERT(gunzip(compressed) == listing);
+
+	fz::buffer empty;
+	CPPUNIT_ASSERT(body_compressor::compress({}, empty));
+	CPPUNIT_ASSERT(gunzip(empty).empty());
+}
+
+void http_body_compressor_test::test_streaming()
+{
+	auto listing = make_listing(5000);
+
+	string_adder adder(listing, 1000);
+	body_compressor compressor(adder, body_compressor::ticket::acquire());
+
+	fz::buffer_operator::unsafe_locking_buffer out;
+	compressor.set_buffer(&out);
+
+	int res;
+	while ((res = compressor.add_to_buffer()) == 0);
+
+	CPPUNIT_ASSERT_EQUAL(ENODATA, res);
+	CPPUNIT_ASSERT_EQUAL(ENODATA, compressor.add_to_buffer());
+	CPPUNIT_ASSERT(gunzip(*out.lock()) == listing);
+}
+
+void http_body_compressor_test::test_idle_ticket()
+{
+	// Take all the tickets there are.
+	std::vector<body_compressor::ticket> tickets;
+	while (auto t = body_compressor::ticket::acquire())
+		tickets.push_back(std::move(t));
+
+	CPPUNIT_ASSERT(!tickets.empty());
+
+	auto listing = make_listing(5000);
+
+	string_adder adder(listing, 1000);
+	body_compressor compressor(adder, std::move(tickets.back()));
+	tickets.pop_back();
+
+	fz::buffer_operator::unsafe_locking_buffer out;
+	compressor.set_buffer(&out);
+
+	// Between calls the compressor doesn't hold its ticket.
+	CPPUNIT_ASSERT_EQUAL(0, compressor.add_to_buffer());
+	auto t = body_compressor::ticket::acquire();
+	CPPUNIT_ASSERT(bool(t));
+
+	// It goes on compressing even with no tickets left, since its client was promised a compressed body.
+	int res;
+	while ((res = compressor.add_to_buffer()) == 0);
+
+	CPPUNIT_ASSERT_EQUAL(ENODATA, res);
+	CPPUNIT_ASSERT(gunzip(*out.lock()) == listing);
+
+	// The compressor gave its own back once done, the test holds all the others.
+	CPPUNIT_ASSERT(!body_compressor::ticket::acquire());
+}
+
+void http_body_compressor_test::test_is_compressible()
+{
+	CPPUNIT_ASSERT(body_compressor::is_compressible("text/html; charset=utf-8"));
+	CPPUNIT_ASSERT(body_compressor::is_compressible("Text/Plain"));
+	CPPUNIT_ASSERT(body_compressor::is_compressible("application/ndjson"));
+	CPPUNIT_ASSERT(body_compressor::is_compressible("application/json"));
+	CPPUNIT_ASSERT(body_compressor::is_compressible("image/svg+xml"));
+
+	CPPUNIT_ASSERT(!body_compressor::is_compressible(""));
+	CPPUNIT_ASSERT(!body_compressor::is_compressible("application/octet-stream"));
+	CPPUNIT_ASSERT(!body_compressor::is_compressible("application/zip"));
+	CPPUNIT_ASSERT(!body_compressor::is_compressible("image/png"));
+}
+
+void http_body_compressor_test::test_accepts_encoding()
+{
+	fz::http::headers h;
+	CPPUNIT_ASSERT(!h.accepts_encoding("gzip"));
+
+	h[fz::http::headers::Accept_Encoding] = "gzip, deflate, br";
+	CPPUNIT_ASSERT(h.accepts_encoding("gzip"));
+	CPPUNIT_ASSERT(h.accepts_encoding("br"));
+	CPPUNIT_ASSERT(!h.accepts_encoding("zstd"));
+
+	h[fz::http::headers::Accept_Encoding] = "br;q=1.0, gzip;q=0, *;q=0.1";
+	CPPUNIT_ASSERT(h.accepts_encoding("br"));
+	CPPUNIT_ASSERT(!h.accepts_encoding("gzip"));
+	CPPUNIT_ASSERT(h.accepts_encoding("zstd"));
+
+	h[fz::http::headers::Accept_Encoding] = "identity";
+	CPPUNIT_ASSERT(!h.accepts_encoding("gzip"));
+}
@@ -0,0 +1,71 @@
+#include "test_utils.hpp"
+
+#include "../src/filezilla/http/entity_tag.hpp"
+
+using fz::http::entity_tag;
+
+class http_entity_tag_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(http_entity_tag_test);
+	CPPUNIT_TEST(test_from_entry);
+	CPPUNIT_TEST(test_if_none_match);
+	CPPUNIT_TEST(test_if_range);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_from_entry();
+	void test_if_none_match();
+	void test_if_range();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(http_entity_tag_test);
+
+namespace {
+
+const fz::datetime mtime(1700000000, fz::datetime::milliseconds);
+
+}
+
+void http_entity_tag_test::test_from_entry()
+{
+	CPPUNIT_ASSERT(!entity_tag::from_entry(100, {}));
+
+	auto tag = entity_tag::from_entry(100, mtime);
+	CPPUNIT_ASSERT(tag && !tag.is_weak());
+	CPPUNIT_ASSERT_EQUAL(std::string("\"64-18bcfe56800\""), tag.to_string());
+
+	CPPUNIT_ASSERT_EQUAL(std::string("W/\"0-18bcfe56800-html\""), entity_tag::from_entry(0, mtime, true, "html").to_string());
+
+	// Any change to either the size or the modification time changes the tag.
+	CPPUNIT_ASSERT(entity_tag::from_entry(101, mtime).to_string() != tag.to_string());
+	CPPUNIT_ASSERT(entity_tag::from_entry(100, mtime + fz::duration::from_milliseconds(1)).to_string() != tag.to_string());
+}
+
+void http_entity_tag_test::test_if_none_match()
+{
+	entity_tag tag("abc", false);
+	entity_tag weak_tag("abc", true);
+
+	CPPUNIT_ASSERT(tag.matches_any_of("\"abc\""));
+	CPPUNIT_ASSERT(tag.matches_any_of(" \"xyz\" , W/\"abc\""));
+	CPPUNIT_ASSERT(weak_tag.matches_any_of("\"abc\""));
+	CPPUNIT_ASSERT(tag.matches_any_of("*"));
+
+	CPPUNIT_ASSERT(!tag.matches_any_of(""));
+	CPPUNIT_ASSERT(!tag.matches_any_of("\"ab\", \"abcd\""));
+	CPPUNIT_ASSERT(!tag.matches_any_of("abc"));
+
+	// Whatever follows a malformed tag isn't looked at.
+	CPPUNIT_ASSERT(!tag.matches_any_of("\"xyz\", abc, \"abc\""));
+
+	// An empty tag matches nothing, not even *.
+	CPPUNIT_ASSERT(!entity_tag().matches_any_of("*"));
+}
+
+void http_entity_tag_test::test_if_range()
+{
+	CPPUNIT_ASSERT(entity_tag("abc", false).strongly_matches("\"abc\""));
+	CPPUNIT_ASSERT(!entity_tag("abc", false).strongly_matches("W/\"abc\""));
+	CPPUNIT_ASSERT(!entity_tag("abc", true).strongly_matches("\"abc\""));
+	CPPUNIT_ASSERT(!entity_tag("abc", false).strongly_matches("Tue, 14 Nov 2023 22:13:20 GMT"));
+}
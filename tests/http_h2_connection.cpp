@@ -0,0 +1,560 @@
+#include <algorithm>
+#include <deque>
+#include <optional>
+
+#include <libfilezilla/event_loop.hpp>
+#include <libfilezilla/socket.hpp>
+#include <libfilezilla/thread_pool.hpp>
+#include <libfilezilla/tls_layer.hpp>
+
+#include "test_utils.hpp"
+
+#include "../src/filezilla/http/h2.hpp"
+#include "../src/filezilla/http/hpack.hpp"
+#include "../src/filezilla/http/server/session.hpp"
+#include "../src/filezilla/http/server/transaction.hpp"
+#include "../src/filezilla/logger/null.hpp"
+#include "../src/filezilla/securable_socket.hpp"
+
+/*
+ * These tests speak HTTP/2 frames to a server session, over TLS on the loopback interface,
+ * and check how it reacts to what a misbehaving client could send it.
+ */
+
+namespace h2 = fz::http::h2;
+
+class http_h2_connection_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(http_h2_connection_test);
+	CPPUNIT_TEST(test_preface);
+	CPPUNIT_TEST(test_settings_overflow);
+	CPPUNIT_TEST(test_window_update_overflow);
+	CPPUNIT_TEST(test_continuation_interleaving);
+	CPPUNIT_TEST(test_reset_flood);
+	CPPUNIT_TEST(test_content_length);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp() override;
+	void tearDown() override;
+
+	void test_preface();
+	void test_settings_overflow();
+	void test_window_update_overflow();
+	void test_continuation_interleaving();
+	void test_reset_flood();
+	void test_content_length();
+
+private:
+	fz::native_string dir_;
+	fz::securable_socket::info security_info_;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(http_h2_connection_test);
+
+namespace {
+
+/// Answers the requests for "/body" once their body has been received, and any other request straight away.
+class responder final: public fz::http::server::transaction_handler
+{
+public:
+	void handle_transaction(const fz::http::server::shared_transaction &t) override
+	{
+		auto &res = t->res();
+
+		if (t->req().uri.path_ != "/body") {
+			res.send_status(200, "OK") && res.send_body("ok\n");
+			return;
+		}
+
+		t->req().receive_body(std::string(), [&res](std::string body, bool success) {
+			if (success) {
+				res.send_status(200, "OK") && res.send_body(body);
+			}
+		});
+	}
+};
+
+struct frame
+{
+	h2::frame_header header;
+	std::string payload;
+
+	/// The error code of a RST_STREAM frame, or of a GOAWAY one, as a number that assertions can print.
+	std::uint32_t error_code() const
+	{
+		auto offset = header.type == h2::frame_type::goaway ? 4u : 0u;
+		if (payload.size() < offset + 4) {
+			return std::uint32_t(h2::error_code::no_error);
+		}
+
+		return h2::frame_header::parse_uint32(reinterpret_cast<const unsigned char *>(payload.data() + offset));
+	}
+};
+
+void append_frame(fz::buffer &out, h2::frame_type type, std::uint8_t flags, std::uint32_t stream_id, const fz::buffer &payload = {})
+{
+	h2::frame_header{std::uint32_t(payload.size()), type, flags, stream_id}.append_to(out);
+	out.append(payload);
+}
+
+fz::buffer uint32_payload(std::uint32_t v)
+{
+	fz::buffer out;
+	h2::frame_header::append_uint32(out, v);
+	return out;
+}
+
+fz::buffer setting_payload(h2::setting id, std::uint32_t value)
+{
+	fz::buffer out;
+	out.append(std::uint8_t(std::uint16_t(id) >> 8));
+	out.append(std::uint8_t(id));
+	h2::frame_header::append_uint32(out, value);
+	return out;
+}
+
+fz::buffer request_block(std::string_view method, std::string_view path, std::optional<std::string_view> content_length = {})
+{
+	fz::buffer out;
+	fz::http::hpack::encoder::encode(":method", method, out);
+	fz::http::hpack::encoder::encode(":scheme", "https", out);
+	fz::http::hpack::encoder::encode(":path", path, out);
+	fz::http::hpack::encoder::encode(":authority", "localhost", out);
+
+	if (content_length) {
+		fz::http::hpack::encoder::encode("content-length", *content_length, out);
+	}
+
+	return out;
+}
+
+/// The client end of a connection to a server session, which it also owns.
+/// What it's given to send is sent once the connection is secure, and the frames it receives are queued for the test to wait for.
+class h2_peer final: public fz::event_handler
+{
+public:
+	h2_peer(fz::thread_pool &pool, fz::event_loop &loop, const fz::securable_socket::info &security_info)
+		: fz::event_handler(loop)
+		, security_info_(security_info)
+		, listen_socket_(pool, this)
+	{
+		fz::scoped_lock lock(mutex_);
+
+		int error = 0;
+		if (listen_socket_.bind("127.0.0.1") && listen_socket_.listen(fz::address_type::ipv4, 0) == 0) {
+			auto port = listen_socket_.local_port(error);
+
+			socket_ = std::make_unique<fz::securable_socket>(loop, this, std::make_unique<fz::socket>(pool, this), fz::logger::null);
+			error = socket_->connect(fzT("127.0.0.1"), unsigned(port));
+		}
+		else {
+			error = EINVAL;
+		}
+
+		closed_ = error != 0;
+	}
+
+	~h2_peer() override
+	{
+		std::unique_ptr<fz::http::server::session> session;
+
+		{
+			fz::scoped_lock lock(mutex_);
+			session = std::move(session_);
+			socket_.reset();
+		}
+
+		session.reset();
+		remove_handler();
+	}
+
+	/// Sends the connection preface and an empty SETTINGS frame.
+	void start()
+	{
+		fz::buffer b;
+		b.append(h2::preface);
+		append_frame(b, h2::frame_type::settings, 0, 0);
+
+		send(std::move(b));
+	}
+
+	void send(fz::buffer b)
+	{
+		send_event<send_data_event>(std::move(b));
+	}
+
+	/// Waits for a frame of the given type on the given stream, leaving the others queued.
+	/// \returns nullopt if the connection is closed, or nothing comes within a few seconds.
+	std::optional<frame> wait_frame(h2::frame_type type, std::uint32_t stream_id)
+	{
+		fz::scoped_lock lock(mutex_);
+
+		while (true) {
+			auto it = std::find_if(frames_.begin(), frames_.end(), [&](const frame &f) {
+				return f.header.type == type && f.header.stream_id == stream_id;
+			});
+
+			if (it != frames_.end()) {
+				auto f = std::move(*it);
+				frames_.erase(it);
+				return f;
+			}
+
+			if (closed_ || !condition_.wait(lock, fz::duration::from_seconds(10))) {
+				return std::nullopt;
+			}
+		}
+	}
+
+private:
+	using send_data_event = fz::simple_event<struct send_data_event_tag, fz::buffer>;
+
+	void operator()(const fz::event_base &ev) override
+	{
+		fz::dispatch<
+			fz::socket_event,
+			fz::certificate_verification_event,
+			send_data_event
+		>(ev, this,
+			&h2_peer::on_socket_event,
+			&h2_peer::on_certificate_verification_event,
+			&h2_peer::on_send_data
+		);
+	}
+
+	void on_certificate_verification_event(fz::tls_layer *tls, fz::tls_session_info &)
+	{
+		// The certificate is the self signed one the session has been given.
+		tls->set_verification_result(true);
+	}
+
+	void on_send_data(fz::buffer &b)
+	{
+		fz::scoped_lock lock(mutex_);
+
+		out_.append(b);
+		flush(lock);
+	}
+
+	void on_socket_event(fz::socket_event_source *source, fz::socket_event_flag type, int error)
+	{
+		fz::scoped_lock lock(mutex_);
+
+		if (source == &listen_socket_) {
+			if (type != fz::socket_event_flag::connection || error || session_) {
+				return;
+			}
+
+			auto s = listen_socket_.accept(error);
+			if (!s) {
+				return;
+			}
+
+			session_ = std::make_unique<fz::http::server::session>(*this, event_loop_, 1, std::move(s), &security_info_, handler_, fz::logger::null);
+			session_->set_timeouts(fz::duration::from_seconds(60), fz::duration::from_seconds(60));
+
+			return;
+		}
+
+		if (!socket_) {
+			return;
+		}
+
+		if (error) {
+			return close(lock);
+		}
+
+		if (type == fz::socket_event_flag::connection) {
+			if (!must_secure_) {
+				secured_ = true;
+				return flush(lock);
+			}
+
+			must_secure_ = false;
+
+			if (!socket_->make_secure_client(fz::tls_ver::v1_2, {}, {}, {}, {"h2"})) {
+				return close(lock);
+			}
+
+			return;
+		}
+
+		if (type == fz::socket_event_flag::read) {
+			return read(lock);
+		}
+
+		if (type == fz::socket_event_flag::write) {
+			return flush(lock);
+		}
+	}
+
+	void read(fz::scoped_lock &lock)
+	{
+		while (true) {
+			unsigned char data[16*1024];
+
+			int error = 0;
+			int r = socket_->read(data, sizeof(data), error);
+
+			if (r < 0 && error == EAGAIN) {
+				break;
+			}
+
+			if (r <= 0) {
+				return close(lock);
+			}
+
+			in_.append(data, std::size_t(r));
+		}
+
+		while (in_.size() >= h2::frame_header::size) {
+			auto h = h2::frame_header::parse(in_.get());
+			if (in_.size() < h2::frame_header::size + h.length) {
+				break;
+			}
+
+			std::string payload(reinterpret_cast<const char *>(in_.get() + h2::frame_header::size), h.length);
+			in_.consume(h2::frame_header::size + h.length);
+
+			// The server's settings are acknowledged, as a well behaved client would.
+			if (h.type == h2::frame_type::settings && !(h.flags & h2::flags::ack)) {
+				append_frame(out_, h2::frame_type::settings, h2::flags::ack, 0);
+				flush(lock);
+			}
+
+			frames_.push_back({h, std::move(payload)});
+		}
+
+		condition_.signal(lock);
+	}
+
+	void flush(fz::scoped_lock &lock)
+	{
+		if (!secured_) {
+			return;
+		}
+
+		while (!out_.empty()) {
+			int error = 0;
+			int w = socket_->write(out_.get(), static_cast<unsigned int>(out_.size()), error);
+
+			if (w < 0 && error == EAGAIN) {
+				return;
+			}
+
+			if (w <= 0) {
+				return close(lock);
+			}
+
+			out_.consume(std::size_t(w));
+		}
+	}
+
+	void close(fz::scoped_lock &lock)
+	{
+		closed_ = true;
+		condition_.signal(lock);
+	}
+
+	fz::securable_socket::info security_info_;
+	responder handler_;
+
+	fz::mutex mutex_;
+	fz::condition condition_;
+
+	fz::listen_socket listen_socket_;
+	std::unique_ptr<fz::securable_socket> socket_;
+	std::unique_ptr<fz::http::server::session> session_;
+
+	bool must_secure_{true};
+	bool secured_{};
+	bool closed_{};
+
+	fz::buffer in_;
+	fz::buffer out_;
+	std::deque<frame> frames_;
+};
+
+}
+
+void http_h2_connection_test::setUp()
+{
+	dir_ = make_tests_dir(fzT("fz_test_h2_connection_"));
+	security_info_.cert = fz::securable_socket::cert_info::generate_selfsigned({}, fz::util::fs::native_path(dir_), fz::logger::null);
+	security_info_.min_tls_ver = fz::tls_ver::v1_2;
+}
+
+void http_h2_connection_test::tearDown()
+{
+	remove_tests_dir(dir_);
+}
+
+void http_h2_connection_test::test_preface()
+{
+	fz::thread_pool pool;
+	fz::event_loop loop(pool);
+
+	{
+		h2_peer p(pool, loop, security_info_);
+
+		fz::buffer b;
+		b.append("PRI * HTTP/2.0\r\n\r\nXX\r\n\r\n");
+		p.send(std::move(b));
+
+		auto f = p.wait_frame(h2::frame_type::goaway, 0);
+		CPPUNIT_ASSERT(f);
+		CPPUNIT_ASSERT_EQUAL(std::uint32_t(h2::error_code::protocol_error), f->error_code());
+	}
+
+	{
+		h2_peer p(pool, loop, security_info_);
+		p.start();
+
+		auto f = p.wait_frame(h2::frame_type::settings, 0);
+		CPPUNIT_ASSERT(f);
+		CPPUNIT_ASSERT_EQUAL(std::uint8_t(0), f->header.flags);
+
+		// The server acknowledges the client's settings too.
+		f = p.wait_frame(h2::frame_type::settings, 0);
+		CPPUNIT_ASSERT(f);
+		CPPUNIT_ASSERT_EQUAL(h2::flags::ack, f->header.flags);
+	}
+}
+
+void http_h2_connection_test::test_settings_overflow()
+{
+	fz::thread_pool pool;
+	fz::event_loop loop(pool);
+	h2_peer p(pool, loop, security_info_);
+
+	p.start();
+
+	fz::buffer b;
+	append_frame(b, h2::frame_type::settings, 0, 0, setting_payload(h2::setting::initial_window_size, h2::max_window_size + 1));
+	p.send(std::move(b));
+
+	auto f = p.wait_frame(h2::frame_type::goaway, 0);
+	CPPUNIT_ASSERT(f);
+	CPPUNIT_ASSERT_EQUAL(std::uint32_t(h2::error_code::flow_control_error), f->error_code());
+}
+
+void http_h2_connection_test::test_window_update_overflow()
+{
+	fz::thread_pool pool;
+	fz::event_loop loop(pool);
+	h2_peer p(pool, loop, security_info_);
+
+	p.start();
+
+	// The connection window starts at 65535, and can't grow past 2^31-1.
+	fz::buffer b;
+	append_frame(b, h2::frame_type::window_update, 0, 0, uint32_payload(h2::max_window_size));
+	p.send(std::move(b));
+
+	auto f = p.wait_frame(h2::frame_type::goaway, 0);
+	CPPUNIT_ASSERT(f);
+	CPPUNIT_ASSERT_EQUAL(std::uint32_t(h2::error_code::flow_control_error), f->error_code());
+}
+
+void http_h2_connection_test::test_continuation_interleaving()
+{
+	fz::thread_pool pool;
+	fz::event_loop loop(pool);
+	h2_peer p(pool, loop, security_info_);
+
+	p.start();
+
+	// A header block must be continued on its own stream, by nothing but CONTINUATION frames.
+	fz::buffer b;
+	append_frame(b, h2::frame_type::headers, 0, 1, request_block("GET", "/"));
+	append_frame(b, h2::frame_type::headers, h2::flags::end_headers | h2::flags::end_stream, 3, request_block("GET", "/"));
+	p.send(std::move(b));
+
+	auto f = p.wait_frame(h2::frame_type::goaway, 0);
+	CPPUNIT_ASSERT(f);
+	CPPUNIT_ASSERT_EQUAL(std::uint32_t(h2::error_code::protocol_error), f->error_code());
+}
+
+void http_h2_connection_test::test_reset_flood()
+{
+	fz::thread_pool pool;
+	fz::event_loop loop(pool);
+	h2_peer p(pool, loop, security_info_);
+
+	p.start();
+
+	// The streams wait for a body that never comes, so that they're still there to be reset.
+	// They're opened and reset in batches smaller than the limit of concurrent streams, and each batch is
+	// acknowledged by a PING before the next is sent, so that no stream is refused for lack of room.
+	std::uint32_t id = 1;
+	std::optional<frame> goaway;
+
+	for (int batch = 0; batch < 5 && !goaway; ++batch) {
+		fz::buffer b;
+
+		for (int i = 0; i < 50; ++i, id += 2) {
+			append_frame(b, h2::frame_type::headers, h2::flags::end_headers, id, request_block("POST", "/"));
+			append_frame(b, h2::frame_type::rst_stream, 0, id, uint32_payload(std::uint32_t(h2::error_code::cancel)));
+		}
+
+		fz::buffer ping;
+		ping.append("12345678");
+		append_frame(b, h2::frame_type::ping, 0, 0, ping);
+
+		p.send(std::move(b));
+
+		if (!p.wait_frame(h2::frame_type::ping, 0)) {
+			goaway = p.wait_frame(h2::frame_type::goaway, 0);
+		}
+	}
+
+	if (!goaway) {
+		goaway = p.wait_frame(h2::frame_type::goaway, 0);
+	}
+
+	CPPUNIT_ASSERT(goaway);
+	CPPUNIT_ASSERT_EQUAL(std::uint32_t(h2::error_code::enhance_your_calm), goaway->error_code());
+}
+
+void http_h2_connection_test::test_content_length()
+{
+	fz::thread_pool pool;
+	fz::event_loop loop(pool);
+	h2_peer p(pool, loop, security_info_);
+
+	p.start();
+
+	auto data = [](std::string_view s) {
+		fz::buffer b;
+		b.append(s);
+		return b;
+	};
+
+	fz::buffer b;
+
+	// More than declared.
+	append_frame(b, h2::frame_type::headers, h2::flags::end_headers, 1, request_block("POST", "/body", "4"));
+	append_frame(b, h2::frame_type::data, h2::flags::end_stream, 1, data("toolong"));
+
+	// Less than declared.
+	append_frame(b, h2::frame_type::headers, h2::flags::end_headers, 3, request_block("POST", "/body", "10"));
+	append_frame(b, h2::frame_type::data, h2::flags::end_stream, 3, data("abc"));
+
+	// A body declared, and none sent.
+	append_frame(b, h2::frame_type::headers, h2::flags::end_headers | h2::flags::end_stream, 5, request_block("POST", "/body", "5"));
+
+	// Just as much as declared.
+	append_frame(b, h2::frame_type::headers, h2::flags::end_headers, 7, request_block("POST", "/body", "3"));
+	append_frame(b, h2::frame_type::data, h2::flags::end_stream, 7, data("abc"));
+
+	p.send(std::move(b));
+
+	for (std::uint32_t id: {1u, 3u, 5u}) {
+		auto f = p.wait_frame(h2::frame_type::rst_stream, id);
+		CPPUNIT_ASSERT(f);
+		CPPUNIT_ASSERT_EQUAL(std::uint32_t(h2::error_code::protocol_error), f->error_code());
+	}
+
+	CPPUNIT_ASSERT(p.wait_frame(h2::frame_type::headers, 7));
+}
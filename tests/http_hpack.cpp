@@ -0,0 +1,190 @@
+#include "test_utils.hpp"
+
+#include "../src/filezilla/http/hpack.hpp"
+
+using namespace fz::http::hpack;
+
+class http_hpack_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(http_hpack_test);
+	CPPUNIT_TEST(test_huffman);
+	CPPUNIT_TEST(test_decode_requests);
+	CPPUNIT_TEST(test_table_size_update);
+	CPPUNIT_TEST(test_malformed);
+	CPPUNIT_TEST(test_round_trip);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_huffman();
+	void test_decode_requests();
+	void test_table_size_update();
+	void test_malformed();
+	void test_round_trip();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(http_hpack_test);
+
+namespace {
+
+std::string from_hex(std::string_view hex)
+{
+	std::string ret;
+
+	for (std::size_t i = 0; i + 1 < hex.size(); i += 2) {
+		ret += char(fz::hex_char_to_int(hex[i]) << 4 | fz::hex_char_to_int(hex[i+1]));
+	}
+
+	return ret;
+}
+
+std::string to_string(const fz::buffer &b)
+{
+	return { reinterpret_cast<const char *>(b.get()), b.size() };
+}
+
+}
+
+void http_hpack_test::test_huffman()
+{
+	// RFC 7541, C.4.1 and C.6.1.
+	const std::pair<std::string_view, std::string_view> vectors[] = {
+		{ "www.example.com", "f1e3c2e5f23a6ba0ab90f4ff" },
+		{ "no-cache", "a8eb10649cbf" },
+		{ "custom-key", "25a849e95ba97d7f" },
+		{ "custom-value", "25a849e95bb8e8b4bf" },
+		{ "302", "6402" },
+		{ "Mon, 21 Oct 2013 20:13:21 GMT", "d07abe941054d444a8200595040b8166e082a62d1bff" },
+	};
+
+	for (auto &[plain, coded]: vectors) {
+		fz::buffer out;
+		huffman_encode(plain, out);
+		CPPUNIT_ASSERT_EQUAL(from_hex(coded), to_string(out));
+		CPPUNIT_ASSERT_EQUAL(out.size(), huffman_encoded_size(plain));
+
+		std::string decoded;
+		CPPUNIT_ASSERT(huffman_decode(from_hex(coded), decoded));
+		CPPUNIT_ASSERT_EQUAL(std::string(plain), decoded);
+	}
+
+	// Every octet survives a round trip, including those with the longest codes.
+	std::string all;
+	for (int i = 0; i < 256; ++i) {
+		all += char(i);
+	}
+
+	fz::buffer out;
+	huffman_encode(all, out);
+
+	std::string decoded;
+	CPPUNIT_ASSERT(huffman_decode(to_string(out), decoded));
+	CPPUNIT_ASSERT(all == decoded);
+
+	// Padding longer than 7 bits, or not made of the most significant bits of EOS, is an error.
+	decoded.clear();
+	CPPUNIT_ASSERT(!huffman_decode(from_hex("6402ff"), decoded));
+	CPPUNIT_ASSERT(!huffman_decode(from_hex("00"), decoded));
+}
+
+void http_hpack_test::test_decode_requests()
+{
+	// RFC 7541, C.4: three requests on the same connection, Huffman coded, sharing the dynamic table.
+	decoder d;
+
+	std::vector<header_field> fields;
+	CPPUNIT_ASSERT(d.decode(from_hex("828684418cf1e3c2e5f23a6ba0ab90f4ff"), fields));
+	CPPUNIT_ASSERT_EQUAL(std::size_t(4), fields.size());
+	CPPUNIT_ASSERT_EQUAL(std::string(":method"), fields[0].name);
+	CPPUNIT_ASSERT_EQUAL(std::string("GET"), fields[0].value);
+	CPPUNIT_ASSERT_EQUAL(std::string(":scheme"), fields[1].name);
+	CPPUNIT_ASSERT_EQUAL(std::string("http"), fields[1].value);
+	CPPUNIT_ASSERT_EQUAL(std::string(":path"), fields[2].name);
+	CPPUNIT_ASSERT_EQUAL(std::string("/"), fields[2].value);
+	CPPUNIT_ASSERT_EQUAL(std::string(":authority"), fields[3].name);
+	CPPUNIT_ASSERT_EQUAL(std::string("www.example.com"), fields[3].value);
+
+	fields.clear();
+	CPPUNIT_ASSERT(d.decode(from_hex("828684be5886a8eb10649cbf"), fields));
+	CPPUNIT_ASSERT_EQUAL(std::size_t(5), fields.size());
+	CPPUNIT_ASSERT_EQUAL(std::string("www.example.com"), fields[3].value);
+	CPPUNIT_ASSERT_EQUAL(std::string("cache-control"), fields[4].name);
+	CPPUNIT_ASSERT_EQUAL(std::string("no-cache"), fields[4].value);
+
+	fields.clear();
+	CPPUNIT_ASSERT(d.decode(from_hex("828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf"), fields));
+	CPPUNIT_ASSERT_EQUAL(std::size_t(5), fields.size());
+	CPPUNIT_ASSERT_EQUAL(std::string("https"), fields[1].value);
+	CPPUNIT_ASSERT_EQUAL(std::string("/index.html"), fields[2].value);
+	CPPUNIT_ASSERT_EQUAL(std::string("www.example.com"), fields[3].value);
+	CPPUNIT_ASSERT_EQUAL(std::string("custom-key"), fields[4].name);
+	CPPUNIT_ASSERT_EQUAL(std::string("custom-value"), fields[4].value);
+}
+
+void http_hpack_test::test_table_size_update()
+{
+	decoder d;
+
+	std::vector<header_field> fields;
+	CPPUNIT_ASSERT(d.decode(from_hex("400a637573746f6d2d6b65790d637573746f6d2d686561646572"), fields));
+
+	// Emptying the table evicts the entry added above: referencing it afterwards is an error.
+	fields.clear();
+	CPPUNIT_ASSERT(d.decode(from_hex("20"), fields));
+	CPPUNIT_ASSERT(fields.empty());
+	CPPUNIT_ASSERT(!d.decode(from_hex("be"), fields));
+
+	// The table can't be made bigger than allowed by the settings.
+	decoder small(100);
+	CPPUNIT_ASSERT(!small.decode(from_hex("3f46"), fields));
+
+	// Size updates must come first in a block.
+	decoder late;
+	CPPUNIT_ASSERT(!late.decode(from_hex("8220"), fields));
+}
+
+void http_hpack_test::test_malformed()
+{
+	std::vector<header_field> fields;
+
+	// Index 0, past the end of the tables, truncated literal, integer overflow.
+	CPPUNIT_ASSERT(!decoder().decode(from_hex("80"), fields));
+	CPPUNIT_ASSERT(!decoder().decode(from_hex("ff00"), fields));
+	CPPUNIT_ASSERT(!decoder().decode(from_hex("400a6375"), fields));
+	CPPUNIT_ASSERT(!decoder().decode(from_hex("ffffffffffffff7f"), fields));
+
+	// Fields bigger than what the list is allowed to be.
+	fz::buffer block;
+	encoder::encode("x-big", std::string(1000, 'a'), block);
+	CPPUNIT_ASSERT(!decoder(4096, 512).decode(to_string(block), fields));
+	CPPUNIT_ASSERT(decoder(4096, 2048).decode(to_string(block), fields));
+}
+
+void http_hpack_test::test_round_trip()
+{
+	const header_field sent[] = {
+		{ ":status", "200" },
+		{ ":status", "207" },
+		{ "content-type", "text/html; charset=utf-8" },
+		{ "content-length", "1234" },
+		{ "set-cookie", "session=abc" },
+		{ "x-custom", "" },
+		{ "etag", "\"64-18bcfe56800\"" },
+	};
+
+	fz::buffer block;
+	for (auto &f: sent) {
+		encoder::encode(f.name, f.value, block);
+	}
+
+	// The exact match of the static table takes a single octet.
+	CPPUNIT_ASSERT_EQUAL(std::uint8_t(0x88), block.get()[0]);
+
+	std::vector<header_field> received;
+	CPPUNIT_ASSERT(decoder().decode(to_string(block), received));
+	CPPUNIT_ASSERT_EQUAL(std::size(sent), received.size());
+
+	for (std::size_t i = 0; i < received.size(); ++i) {
+		CPPUNIT_ASSERT_EQUAL(sent[i].name, received[i].name);
+		CPPUNIT_ASSERT_EQUAL(sent[i].value, received[i].value);
+	}
+}
@@ -0,0 +1,216 @@
+#include <algorithm>
+
+#include "../src/filezilla/http/listing_cache.hpp"
+#include "../src/filezilla/logger/null.hpp"
+#include "../src/filezilla/tvfs/engine.hpp"
+
+#include "test_utils.hpp"
+
+using fz::http::listing_cache;
+
+class http_listing_cache_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(http_listing_cache_test);
+	CPPUNIT_TEST(test_parse);
+	CPPUNIT_TEST(test_pages);
+	CPPUNIT_TEST(test_filter);
+	CPPUNIT_TEST(test_cursor_across_snapshots);
+	CPPUNIT_TEST(test_invalid_cursor);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	http_listing_cache_test();
+
+	void setUp() override;
+	void tearDown() override;
+
+	void test_parse();
+	void test_pages();
+	void test_filter();
+	void test_cursor_across_snapshots();
+	void test_invalid_cursor();
+
+private:
+	void write_file(std::string_view name, std::size_t size);
+	std::shared_ptr<const listing_cache::snapshot> snapshot();
+	std::vector<std::string> list_all(listing_cache::page_request req);
+
+	fz::tvfs::engine tvfs_;
+	fz::util::fs::native_path native_root_;
+	listing_cache cache_;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(http_listing_cache_test);
+
+http_listing_cache_test::http_listing_cache_test()
+	: tvfs_(fz::logger::null)
+{
+}
+
+void http_listing_cache_test::setUp()
+{
+	native_root_ = make_tests_dir(fzT("listing_cache_test"));
+
+	// 50 files, whose sizes go the other way around their names, with a few ties.
+	for (std::size_t i = 0; i < 50; ++i) {
+		write_file(fz::sprintf("file%02d.txt", i), (50 - i) / 2);
+	}
+
+	write_file("Other.bin", 7);
+
+	tvfs_.set_mount_tree(std::make_shared<fz::tvfs::mount_tree>(fz::tvfs::mount_table{
+		{ "/", native_root_, fz::tvfs::mount_point::read_only, fz::tvfs::mount_point::apply_permissions_recursively }
+	}));
+}
+
+void http_listing_cache_test::tearDown()
+{
+	remove_tests_dir(native_root_);
+}
+
+void http_listing_cache_test::write_file(std::string_view name, std::size_t size)
+{
+	auto f = (native_root_ / fz::to_native(name)).open(fz::file::writing, fz::file::creation_flags::empty);
+	CPPUNIT_ASSERT(f.opened());
+
+	std::string content(size, 'x');
+	CPPUNIT_ASSERT(f.write(content.data(), std::int64_t(content.size())) == std::int64_t(content.size()));
+}
+
+std::shared_ptr<const listing_cache::snapshot> http_listing_cache_test::snapshot()
+{
+	fz::tvfs::entries_iterator it;
+	CPPUNIT_ASSERT(tvfs_.get_entries(it, "/", fz::tvfs::traversal_mode::only_children));
+
+	return cache_.get("/", it);
+}
+
+std::vector<std::string> http_listing_cache_test::list_all(listing_cache::page_request req)
+{
+	std::vector<std::string> names;
+	std::vector<fz::tvfs::entry> page;
+	std::string next;
+
+	do {
+		CPPUNIT_ASSERT(snapshot()->get_page(req, page, next));
+		CPPUNIT_ASSERT(!req.limit || page.size() <= req.limit);
+		CPPUNIT_ASSERT(next.empty() || page.size() == req.limit);
+
+		for (auto &e: page) {
+			names.push_back(e.name());
+		}
+
+		req.cursor = next;
+	} while (!next.empty());
+
+	return names;
+}
+
+void http_listing_cache_test::test_parse()
+{
+	listing_cache::page_request req;
+
+	CPPUNIT_ASSERT(req.parse("") == req.ignored);
+	CPPUNIT_ASSERT(req.parse("download=1") == req.ignored);
+
+	CPPUNIT_ASSERT(req.parse("limit=10&sort=mtime&order=desc&filter=%2A.txt") == req.valid);
+	CPPUNIT_ASSERT_EQUAL(std::size_t(10), req.limit);
+	CPPUNIT_ASSERT(req.key == listing_cache::sort_key::mtime);
+	CPPUNIT_ASSERT(req.descending);
+	CPPUNIT_ASSERT_EQUAL(std::string("*.txt"), req.filter);
+
+	CPPUNIT_ASSERT(req.parse("limit=ten") == req.invalid);
+	CPPUNIT_ASSERT(req.parse("sort=color") == req.invalid);
+	CPPUNIT_ASSERT(req.parse("order=up") == req.invalid);
+}
+
+void http_listing_cache_test::test_pages()
+{
+	listing_cache::page_request req;
+	req.limit = 7;
+
+	auto by_name = list_all(req);
+	CPPUNIT_ASSERT_EQUAL(std::size_t(51), by_name.size());
+	CPPUNIT_ASSERT(std::is_sorted(by_name.begin(), by_name.end()));
+	CPPUNIT_ASSERT_EQUAL(std::string("Other.bin"), by_name.front());
+
+	req.descending = true;
+	auto by_name_desc = list_all(req);
+	CPPUNIT_ASSERT(std::equal(by_name.rbegin(), by_name.rend(), by_name_desc.begin(), by_name_desc.end()));
+
+	// Sizes go the other way around names, and ties are broken by name.
+	req.key = listing_cache::sort_key::size;
+	req.descending = false;
+	auto by_size = list_all(req);
+	CPPUNIT_ASSERT_EQUAL(std::size_t(51), by_size.size());
+	CPPUNIT_ASSERT_EQUAL(std::string("file49.txt"), by_size[0]);
+	CPPUNIT_ASSERT_EQUAL(std::string("file47.txt"), by_size[1]);
+	CPPUNIT_ASSERT_EQUAL(std::string("file48.txt"), by_size[2]);
+	CPPUNIT_ASSERT_EQUAL(std::string("file00.txt"), by_size.back());
+
+	// No limit: everything in one page.
+	req.limit = 0;
+	CPPUNIT_ASSERT(by_size == list_all(req));
+}
+
+void http_listing_cache_test::test_filter()
+{
+	listing_cache::page_request req;
+	req.limit = 3;
+	req.filter = "FILE1?.*";
+
+	auto names = list_all(req);
+	CPPUNIT_ASSERT_EQUAL(std::size_t(10), names.size());
+	CPPUNIT_ASSERT_EQUAL(std::string("file10.txt"), names.front());
+	CPPUNIT_ASSERT_EQUAL(std::string("file19.txt"), names.back());
+
+	req.filter = "*.bin";
+	CPPUNIT_ASSERT(list_all(req) == std::vector<std::string>{"Other.bin"});
+
+	req.filter = "nothing*";
+	CPPUNIT_ASSERT(list_all(req).empty());
+}
+
+void http_listing_cache_test::test_cursor_across_snapshots()
+{
+	listing_cache::page_request req;
+	req.limit = 2;
+
+	std::vector<fz::tvfs::entry> page;
+	std::string next;
+
+	CPPUNIT_ASSERT(snapshot()->get_page(req, page, next));
+	CPPUNIT_ASSERT_EQUAL(std::string("file00.txt"), page.back().name());
+
+	// The cursor points to an entry, not to a position: an entry added before it doesn't shift the following page.
+	write_file("a.txt", 1);
+
+	fz::tvfs::entries_iterator it;
+	CPPUNIT_ASSERT(tvfs_.get_entries(it, "/", fz::tvfs::traversal_mode::only_children));
+
+	listing_cache fresh;
+	req.cursor = next;
+	CPPUNIT_ASSERT(fresh.get("/", it)->get_page(req, page, next));
+	CPPUNIT_ASSERT_EQUAL(std::size_t(2), page.size());
+	CPPUNIT_ASSERT_EQUAL(std::string("file01.txt"), page.front().name());
+}
+
+void http_listing_cache_test::test_invalid_cursor()
+{
+	listing_cache::page_request req;
+	req.limit = 2;
+
+	std::vector<fz::tvfs::entry> page;
+	std::string next;
+
+	CPPUNIT_ASSERT(snapshot()->get_page(req, page, next));
+	CPPUNIT_ASSERT(!next.empty());
+
+	// A cursor belongs to the order it was returned for.
+	req.cursor = next;
+	req.key = listing_cache::sort_key::size;
+	CPPUNIT_ASSERT(!snapshot()->get_page(req, page, next));
+
+	req.cursor = "garbage";
+	CPPUNIT_ASSERT(!snapshot()->get_page(req, page, next));
+}
@@ -0,0 +1,135 @@
+#include "test_utils.hpp"
+
+#include "../src/filezilla/http/ranges.hpp"
+
+using fz::http::byte_range;
+using fz::http::byte_ranges;
+
+class http_ranges_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(http_ranges_test);
+	CPPUNIT_TEST(test_single_ranges);
+	CPPUNIT_TEST(test_multiple_ranges);
+	CPPUNIT_TEST(test_unsatisfiable);
+	CPPUNIT_TEST(test_ignored);
+	CPPUNIT_TEST(test_content_range);
+	CPPUNIT_TEST(test_add);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_single_ranges();
+	void test_multiple_ranges();
+	void test_unsatisfiable();
+	void test_ignored();
+	void test_content_range();
+	void test_add();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(http_ranges_test);
+
+void http_ranges_test::test_single_ranges()
+{
+	byte_ranges r;
+
+	CPPUNIT_ASSERT(r.parse("bytes=0-499", 10000) == byte_ranges::satisfiable);
+	CPPUNIT_ASSERT(r == byte_ranges({{0, 499}}));
+
+	// The last byte position is clamped to the size.
+	CPPUNIT_ASSERT(r.parse("bytes=9500-20000", 10000) == byte_ranges::satisfiable);
+	CPPUNIT_ASSERT(r == byte_ranges({{9500, 9999}}));
+
+	// Open ended.
+	CPPUNIT_ASSERT(r.parse("bytes=9500-", 10000) == byte_ranges::satisfiable);
+	CPPUNIT_ASSERT(r == byte_ranges({{9500, 9999}}));
+
+	// Suffix, also longer than the whole representation.
+	CPPUNIT_ASSERT(r.parse("bytes=-500", 10000) == byte_ranges::satisfiable);
+	CPPUNIT_ASSERT(r == byte_ranges({{9500, 9999}}));
+
+	CPPUNIT_ASSERT(r.parse("bytes=-20000", 10000) == byte_ranges::satisfiable);
+	CPPUNIT_ASSERT(r == byte_ranges({{0, 9999}}));
+
+	// The unit is case insensitive, and whitespace is allowed around the elements.
+	CPPUNIT_ASSERT(r.parse(" Bytes= 1 - 2 ", 10) == byte_ranges::satisfiable);
+	CPPUNIT_ASSERT(r == byte_ranges({{1, 2}}));
+}
+
+void http_ranges_test::test_multiple_ranges()
+{
+	byte_ranges r;
+
+	CPPUNIT_ASSERT(r.parse("bytes=500-599,0-99", 10000) == byte_ranges::satisfiable);
+	CPPUNIT_ASSERT(r == byte_ranges({{0, 99}, {500, 599}}));
+
+	// Overlapping and adjacent ranges are merged.
+	CPPUNIT_ASSERT(r.parse("bytes=0-99, 50-149, 150-199, 300-", 1000) == byte_ranges::satisfiable);
+	CPPUNIT_ASSERT(r == byte_ranges({{0, 199}, {300, 999}}));
+
+	// Unsatisfiable ranges are dropped, as long as any other is satisfiable.
+	CPPUNIT_ASSERT(r.parse("bytes=2000-3000,0-0,,", 1000) == byte_ranges::satisfiable);
+	CPPUNIT_ASSERT(r == byte_ranges({{0, 0}}));
+}
+
+void http_ranges_test::test_unsatisfiable()
+{
+	byte_ranges r;
+
+	CPPUNIT_ASSERT(r.parse("bytes=1000-", 1000) == byte_ranges::unsatisfiable);
+	CPPUNIT_ASSERT(r.parse("bytes=-0", 1000) == byte_ranges::unsatisfiable);
+	CPPUNIT_ASSERT(r.parse("bytes=0-10", 0) == byte_ranges::unsatisfiable);
+	CPPUNIT_ASSERT(r.parse("bytes=-10", 0) == byte_ranges::unsatisfiable);
+	CPPUNIT_ASSERT(r.empty());
+}
+
+void http_ranges_test::test_ignored()
+{
+	byte_ranges r;
+
+	CPPUNIT_ASSERT(r.parse("", 1000) == byte_ranges::ignored);
+	CPPUNIT_ASSERT(r.parse("bytes=", 1000) == byte_ranges::ignored);
+	CPPUNIT_ASSERT(r.parse("items=0-10", 1000) == byte_ranges::ignored);
+	CPPUNIT_ASSERT(r.parse("bytes=10-5", 1000) == byte_ranges::ignored);
+	CPPUNIT_ASSERT(r.parse("bytes=a-5", 1000) == byte_ranges::ignored);
+	CPPUNIT_ASSERT(r.parse("bytes=5", 1000) == byte_ranges::ignored);
+	CPPUNIT_ASSERT(r.parse("bytes=-", 1000) == byte_ranges::ignored);
+	CPPUNIT_ASSERT(r.parse("bytes=0-1,2-3,x", 1000) == byte_ranges::ignored);
+	CPPUNIT_ASSERT(r.parse("bytes=99999999999999999999-", 1000) == byte_ranges::ignored);
+
+	// Too many ranges.
+	CPPUNIT_ASSERT(r.parse("bytes=0-0,2-2,4-4", 1000, 2) == byte_ranges::ignored);
+	CPPUNIT_ASSERT(r.empty());
+}
+
+void http_ranges_test::test_content_range()
+{
+	CPPUNIT_ASSERT_EQUAL(std::string("bytes 0-499/10000"), (byte_range{0, 499}.content_range(10000)));
+	CPPUNIT_ASSERT_EQUAL(std::uint64_t(500), (byte_range{0, 499}.size()));
+}
+
+void http_ranges_test::test_add()
+{
+	byte_ranges r;
+
+	CPPUNIT_ASSERT(r.covers(0));
+	CPPUNIT_ASSERT(!r.covers(1));
+	CPPUNIT_ASSERT_EQUAL(std::string(), r.to_string());
+
+	// Ranges may come in any order, as parallel chunks do.
+	r.add({200, 299});
+	r.add({0, 99});
+	CPPUNIT_ASSERT(r == byte_ranges({{0, 99}, {200, 299}}));
+	CPPUNIT_ASSERT_EQUAL(std::string("0-99, 200-299"), r.to_string());
+	CPPUNIT_ASSERT(!r.covers(300));
+
+	// Overlapping and adjacent ones are merged.
+	r.add({50, 149});
+	r.add({150, 199});
+	CPPUNIT_ASSERT(r == byte_ranges({{0, 299}}));
+	CPPUNIT_ASSERT(r.covers(300));
+	CPPUNIT_ASSERT(r.covers(100));
+	CPPUNIT_ASSERT(!r.covers(301));
+
+	// Empty ranges are ignored.
+	r.add({500, 499});
+	CPPUNIT_ASSERT(r == byte_ranges({{0, 299}}));
+}
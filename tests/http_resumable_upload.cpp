@@ -0,0 +1,198 @@
+#include "../src/filezilla/http/resumable_upload.hpp"
+#include "../src/filezilla/logger/null.hpp"
+#include "../src/filezilla/util/io.hpp"
+
+#include "test_utils.hpp"
+
+using fz::http::byte_ranges;
+using fz::http::resumable_upload;
+
+class http_resumable_upload_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(http_resumable_upload_test);
+	CPPUNIT_TEST(test_out_of_order);
+	CPPUNIT_TEST(test_abort);
+	CPPUNIT_TEST(test_invalid);
+	CPPUNIT_TEST(test_remove_stale);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	http_resumable_upload_test();
+
+	void setUp() override;
+	void tearDown() override;
+
+	void test_out_of_order();
+	void test_abort();
+	void test_invalid();
+	void test_remove_stale();
+
+private:
+	void write_part(resumable_upload &u, std::uint64_t offset, std::string_view data);
+	std::size_t count_entries();
+
+	fz::tvfs::engine tvfs_;
+	fz::util::fs::native_path native_root_;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(http_resumable_upload_test);
+
+http_resumable_upload_test::http_resumable_upload_test()
+	: tvfs_(fz::logger::null)
+{
+}
+
+void http_resumable_upload_test::setUp()
+{
+	native_root_ = make_tests_dir(fzT("resumable_upload_test"));
+
+	tvfs_.set_mount_tree(std::make_shared<fz::tvfs::mount_tree>(fz::tvfs::mount_table{
+		{ "/", native_root_, fz::tvfs::mount_point::read_write, fz::tvfs::mount_point::apply_permissions_recursively }
+	}));
+}
+
+void http_resumable_upload_test::tearDown()
+{
+	remove_tests_dir(native_root_);
+}
+
+void http_resumable_upload_test::write_part(resumable_upload &u, std::uint64_t offset, std::string_view data)
+{
+	fz::tvfs::file_holder f;
+	CPPUNIT_ASSERT(u.open_part(f, offset));
+	CPPUNIT_ASSERT(fz::util::io::write(*f, data));
+	CPPUNIT_ASSERT(f->fsync());
+
+	CPPUNIT_ASSERT(u.add_received({offset, offset + data.size() - 1}));
+}
+
+std::size_t http_resumable_upload_test::count_entries()
+{
+	fz::tvfs::entries_iterator it;
+	CPPUNIT_ASSERT(tvfs_.get_entries(it, "/", fz::tvfs::traversal_mode::only_children));
+
+	std::size_t count = 0;
+	while (it.has_next()) {
+		it.next();
+		++count;
+	}
+
+	return count;
+}
+
+void http_resumable_upload_test::test_out_of_order()
+{
+	resumable_upload u;
+	CPPUNIT_ASSERT(resumable_upload::begin(u, tvfs_, "/file.bin", 12, 1024));
+	CPPUNIT_ASSERT(resumable_upload::is_valid_id(u.id()));
+	CPPUNIT_ASSERT_EQUAL(std::uint64_t(12), u.size());
+
+	// The last chunk first, so that the file must already have its whole size.
+	write_part(u, 8, "9abc");
+	write_part(u, 0, "1234");
+
+	// As if the server had been restarted: all that's known is the id.
+	resumable_upload found;
+	CPPUNIT_ASSERT(resumable_upload::find(found, tvfs_, "/file.bin", u.id()));
+	CPPUNIT_ASSERT_EQUAL(std::uint64_t(12), found.size());
+
+	byte_ranges received;
+	CPPUNIT_ASSERT(found.get_received(received));
+	CPPUNIT_ASSERT_EQUAL(std::string("0-3, 8-11"), received.to_string());
+	CPPUNIT_ASSERT(!received.covers(found.size()));
+
+	// The target doesn't exist until the upload ends.
+	CPPUNIT_ASSERT(!tvfs_.get_entry("/file.bin").first);
+
+	write_part(found, 4, "5678");
+
+	CPPUNIT_ASSERT(found.get_received(received));
+	CPPUNIT_ASSERT(received.covers(found.size()));
+
+	CPPUNIT_ASSERT(found.end());
+	CPPUNIT_ASSERT(!found);
+
+	fz::buffer content;
+	CPPUNIT_ASSERT(fz::util::io::read((native_root_ / fzT("file.bin")).str(), content));
+	CPPUNIT_ASSERT_EQUAL(std::string("123456789abc"), std::string(content.to_view()));
+
+	// Nothing of the upload is left behind.
+	CPPUNIT_ASSERT_EQUAL(std::size_t(1), count_entries());
+	CPPUNIT_ASSERT(!resumable_upload::find(found, tvfs_, "/file.bin", u.id()));
+}
+
+void http_resumable_upload_test::test_abort()
+{
+	resumable_upload u;
+	CPPUNIT_ASSERT(resumable_upload::begin(u, tvfs_, "/file.bin", 1024, 1024));
+	write_part(u, 0, "data");
+
+	CPPUNIT_ASSERT_EQUAL(std::size_t(2), count_entries());
+
+	auto id = u.id();
+	CPPUNIT_ASSERT(u.abort());
+
+	CPPUNIT_ASSERT_EQUAL(std::size_t(0), count_entries());
+	CPPUNIT_ASSERT(!resumable_upload::find(u, tvfs_, "/file.bin", id));
+}
+
+void http_resumable_upload_test::test_invalid()
+{
+	resumable_upload u;
+	CPPUNIT_ASSERT(resumable_upload::begin(u, tvfs_, "/file.bin", 10, 1024));
+
+	// An upload is found only for the path it was started for.
+	resumable_upload found;
+	CPPUNIT_ASSERT(!resumable_upload::find(found, tvfs_, "/other.bin", u.id()));
+	CPPUNIT_ASSERT(!resumable_upload::find(found, tvfs_, "/file.bin", "../../etc/passwd"));
+	CPPUNIT_ASSERT(!resumable_upload::find(found, tvfs_, "/file.bin", ""));
+
+	// Chunks can't go past the end of the upload.
+	fz::tvfs::file_holder f;
+	CPPUNIT_ASSERT(!u.open_part(f, 11));
+	CPPUNIT_ASSERT(!u.add_received({5, 10}));
+
+	CPPUNIT_ASSERT(!resumable_upload::begin(found, tvfs_, "/dir/", 10, 1024));
+
+	// Nor can uploads be bigger than allowed.
+	CPPUNIT_ASSERT_EQUAL(fz::result::resource_limit, resumable_upload::begin(found, tvfs_, "/big.bin", 1025, 1024).error_);
+}
+
+void http_resumable_upload_test::test_remove_stale()
+{
+	resumable_upload u;
+	CPPUNIT_ASSERT(resumable_upload::begin(u, tvfs_, "/file.bin", 10, 1024));
+	write_part(u, 0, "data");
+
+	auto id = u.id();
+
+	// Looks like the file of an upload, but isn't one.
+	{
+		auto f = (native_root_ / fzT(".file.bin.fzupload")).open(fz::file::writing, fz::file::creation_flags::empty);
+		CPPUNIT_ASSERT(f.opened());
+	}
+
+	CPPUNIT_ASSERT_EQUAL(std::size_t(3), count_entries());
+
+	// Recently written to: the upload is kept.
+	resumable_upload::remove_stale(tvfs_, "/", fz::duration::from_days(1));
+	CPPUNIT_ASSERT_EQUAL(std::size_t(3), count_entries());
+
+	std::vector<std::string> names;
+	{
+		fz::tvfs::entries_iterator it;
+		CPPUNIT_ASSERT(tvfs_.get_entries(it, "/", fz::tvfs::traversal_mode::only_children));
+
+		while (it.has_next()) {
+			if (auto e = it.next())
+				names.push_back(e.name());
+		}
+	}
+
+	for (auto &name: names)
+		CPPUNIT_ASSERT(tvfs_.set_mtime("/" + name, fz::datetime::now() - fz::duration::from_days(2)).first);
+
+	resumable_upload::remove_stale(tvfs_, "/", fz::duration::from_days(1));
+	CPPUNIT_ASSERT_EQUAL(std::size_t(1), count_entries());
+	CPPUNIT_ASSERT(!resumable_upload::find(u, tvfs_, "/file.bin", id));
+}
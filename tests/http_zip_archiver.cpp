@@ -0,0 +1,250 @@
+#include <map>
+
+#include <zlib.h>
+
+#include "../src/filezilla/http/zip_archiver.hpp"
+#include "../src/filezilla/logger/null.hpp"
+
+#include "test_utils.hpp"
+
+using fz::http::zip_archiver;
+
+class http_zip_archiver_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(http_zip_archiver_test);
+	CPPUNIT_TEST(test_stored);
+	CPPUNIT_TEST(test_deflated);
+	CPPUNIT_TEST(test_selection);
+#ifndef FZ_WINDOWS
+	CPPUNIT_TEST(test_links);
+#endif
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	http_zip_archiver_test();
+
+	void setUp() override;
+	void tearDown() override;
+
+	void test_stored();
+	void test_deflated();
+	void test_selection();
+	void test_links();
+
+private:
+	void write_file(const fz::util::fs::native_path &path, std::string_view content);
+
+	fz::tvfs::engine tvfs_;
+	fz::util::fs::native_path native_root_;
+	std::string big_content_;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(http_zip_archiver_test);
+
+namespace {
+
+std::uint64_t le(const std::string &s, std::size_t pos, std::size_t size)
+{
+	std::uint64_t v = 0;
+
+	for (std::size_t i = size; i-- > 0;) {
+		v = (v << 8) | static_cast<unsigned char>(s.at(pos + i));
+	}
+
+	return v;
+}
+
+std::string inflate_raw(std::string_view in)
+{
+	z_stream zs{};
+	if (inflateInit2(&zs, -MAX_WBITS) != Z_OK)
+		return {};
+
+	std::string out;
+	char chunk[4096];
+
+	zs.next_in = reinterpret_cast<unsigned char *>(const_cast<char *>(in.data()));
+	zs.avail_in = uInt(in.size());
+
+	int res;
+
+	do {
+		zs.next_out = reinterpret_cast<unsigned char *>(chunk);
+		zs.avail_out = sizeof(chunk);
+
+		res = inflate(&zs, Z_NO_FLUSH);
+		out.append(chunk, sizeof(chunk) - zs.avail_out);
+	} while (res == Z_OK);
+
+	inflateEnd(&zs);
+
+	return res == Z_STREAM_END ? out : "<corrupted>";
+}
+
+std::string archive(zip_archiver &&archiver)
+{
+	fz::buffer_operator::unsafe_locking_buffer buffer;
+	archiver.set_buffer(&buffer);
+
+	std::string out;
+	int res;
+
+	while ((res = archiver.add_to_buffer()) == 0 || res == ENOBUFS) {
+		auto b = buffer.lock();
+		out.append(b->to_view());
+		b->clear();
+	}
+
+	CPPUNIT_ASSERT_EQUAL(ENODATA, res);
+
+	return out;
+}
+
+// Walks the central directory, the way unzip does, and returns the uncompressed content of each entry.
+std::map<std::string, std::string> extract(const std::string &zip)
+{
+	std::map<std::string, std::string> entries;
+
+	CPPUNIT_ASSERT(zip.size() >= 22+20+56);
+
+	auto eocd = zip.size() - 22;
+	CPPUNIT_ASSERT_EQUAL(std::uint64_t(0x06054b50), le(zip, eocd, 4));
+
+	auto locator = eocd - 20;
+	CPPUNIT_ASSERT_EQUAL(std::uint64_t(0x07064b50), le(zip, locator, 4));
+
+	auto zip64_eocd = std::size_t(le(zip, locator + 8, 8));
+	CPPUNIT_ASSERT_EQUAL(std::uint64_t(0x06064b50), le(zip, zip64_eocd, 4));
+
+	auto count = le(zip, zip64_eocd + 32, 8);
+	auto pos = std::size_t(le(zip, zip64_eocd + 48, 8));
+
+	for (std::uint64_t i = 0; i < count; ++i) {
+		CPPUNIT_ASSERT_EQUAL(std::uint64_t(0x02014b50), le(zip, pos, 4));
+
+		auto method = le(zip, pos + 10, 2);
+		auto crc = le(zip, pos + 16, 4);
+		auto name_size = std::size_t(le(zip, pos + 28, 2));
+		auto extra_size = std::size_t(le(zip, pos + 30, 2));
+		auto name = zip.substr(pos + 46, name_size);
+
+		// The ZIP64 extra field comes first.
+		auto extra = pos + 46 + name_size;
+		CPPUNIT_ASSERT_EQUAL(std::uint64_t(1), le(zip, extra, 2));
+
+		auto uncompressed_size = std::size_t(le(zip, extra + 4, 8));
+		auto compressed_size = std::size_t(le(zip, extra + 12, 8));
+		auto offset = std::size_t(le(zip, extra + 20, 8));
+
+		CPPUNIT_ASSERT_EQUAL(std::uint64_t(0x04034b50), le(zip, offset, 4));
+		CPPUNIT_ASSERT_EQUAL(name, zip.substr(offset + 30, le(zip, offset + 26, 2)));
+
+		auto data = std::string_view(zip).substr(offset + 30 + le(zip, offset + 26, 2) + le(zip, offset + 28, 2), compressed_size);
+		auto content = method == 8 ? inflate_raw(data) : std::string(data);
+
+		CPPUNIT_ASSERT_EQUAL(uncompressed_size, content.size());
+		CPPUNIT_ASSERT_EQUAL(crc, std::uint64_t(crc32(0, reinterpret_cast<const unsigned char *>(content.data()), uInt(content.size()))));
+
+		entries[name] = content;
+		pos += 46 + name_size + extra_size;
+	}
+
+	return entries;
+}
+
+}
+
+http_zip_archiver_test::http_zip_archiver_test()
+	: tvfs_(fz::logger::null)
+{
+}
+
+void http_zip_archiver_test::setUp()
+{
+	native_root_ = make_tests_dir(fzT("zip_archiver_test"));
+	CPPUNIT_ASSERT(fz::mkdir(native_root_ / fzT("sub"), true));
+	CPPUNIT_ASSERT(fz::mkdir(native_root_ / fzT("empty"), true));
+
+	// Big enough to span many reads, and repetitive enough to be deflated.
+	for (int i = 0; big_content_.size() < 300*1024; ++i) {
+		big_content_ += fz::sprintf("line %d of the big file\n", i);
+	}
+
+	write_file(native_root_ / fzT("a.txt"), "hello");
+	write_file(native_root_ / fzT("sub") / fzT("big.txt"), big_content_);
+	write_file(native_root_ / fzT("sub") / fzT("empty.txt"), {});
+
+	tvfs_.set_mount_tree(std::make_shared<fz::tvfs::mount_tree>(fz::tvfs::mount_table{
+		{ "/", native_root_, fz::tvfs::mount_point::read_only, fz::tvfs::mount_point::apply_permissions_recursively }
+	}));
+}
+
+void http_zip_archiver_test::tearDown()
+{
+	remove_tests_dir(native_root_);
+}
+
+void http_zip_archiver_test::write_file(const fz::util::fs::native_path &path, std::string_view content)
+{
+	auto f = path.open(fz::file::writing, fz::file::creation_flags::empty);
+	CPPUNIT_ASSERT(f.opened());
+	CPPUNIT_ASSERT(f.write(content.data(), std::int64_t(content.size())) == std::int64_t(content.size()));
+}
+
+void http_zip_archiver_test::test_stored()
+{
+	auto zip = archive(zip_archiver(tvfs_, "/", {}, zip_archiver::method::stored, fz::logger::null));
+	auto entries = extract(zip);
+
+	CPPUNIT_ASSERT_EQUAL(std::size_t(5), entries.size());
+	CPPUNIT_ASSERT_EQUAL(std::string("hello"), entries["a.txt"]);
+	CPPUNIT_ASSERT(entries.count("empty/"));
+	CPPUNIT_ASSERT(entries.count("sub/"));
+	CPPUNIT_ASSERT(entries["sub/big.txt"] == big_content_);
+	CPPUNIT_ASSERT(entries.count("sub/empty.txt") && entries["sub/empty.txt"].empty());
+
+	// Stored files take as much room in the archive as they take on disk.
+	CPPUNIT_ASSERT(zip.size() > big_content_.size());
+}
+
+void http_zip_archiver_test::test_deflated()
+{
+	auto zip = archive(zip_archiver(tvfs_, "/sub", {}, zip_archiver::method::deflated, fz::logger::null));
+	auto entries = extract(zip);
+
+	CPPUNIT_ASSERT_EQUAL(std::size_t(2), entries.size());
+	CPPUNIT_ASSERT(entries["big.txt"] == big_content_);
+	CPPUNIT_ASSERT(entries.count("empty.txt") && entries["empty.txt"].empty());
+
+	CPPUNIT_ASSERT(zip.size() < big_content_.size() / 4);
+}
+
+void http_zip_archiver_test::test_selection()
+{
+	auto zip = archive(zip_archiver(tvfs_, "/", {"sub", "a.txt", "missing"}, zip_archiver::method::stored, fz::logger::null));
+	auto entries = extract(zip);
+
+	CPPUNIT_ASSERT_EQUAL(std::size_t(4), entries.size());
+	CPPUNIT_ASSERT(entries.count("sub/"));
+	CPPUNIT_ASSERT(entries["sub/big.txt"] == big_content_);
+	CPPUNIT_ASSERT(entries.count("sub/empty.txt"));
+	CPPUNIT_ASSERT_EQUAL(std::string("hello"), entries["a.txt"]);
+}
+
+#ifndef FZ_WINDOWS
+void http_zip_archiver_test::test_links()
+{
+	auto links = native_root_ / fzT("links");
+	CPPUNIT_ASSERT(fz::mkdir(links, true));
+
+	CPPUNIT_ASSERT_EQUAL(0, symlink("../a.txt", (links / fzT("file")).str().c_str()));
+	CPPUNIT_ASSERT_EQUAL(0, symlink("..", (links / fzT("up")).str().c_str()));
+	CPPUNIT_ASSERT_EQUAL(0, symlink("nowhere", (links / fzT("dangling")).str().c_str()));
+
+	// Only the link to the file makes it, as the file it points to: the link to the directory would make a loop.
+	auto entries = extract(archive(zip_archiver(tvfs_, "/links", {}, zip_archiver::method::stored, fz::logger::null)));
+
+	CPPUNIT_ASSERT_EQUAL(std::size_t(1), entries.size());
+	CPPUNIT_ASSERT_EQUAL(std::string("hello"), entries["file"]);
+}
+#endif
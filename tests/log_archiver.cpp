@@ -0,0 +1,165 @@
+#include <filesystem>
+#include <vector>
+
+#include <zlib.h>
+
+#include "test_utils.hpp"
+
+#include "../src/filezilla/logger/archiver.hpp"
+#include "../src/filezilla/util/io.hpp"
+
+using fz::logger::archiver;
+
+class log_archiver_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(log_archiver_test);
+	CPPUNIT_TEST(test_parse_line);
+	CPPUNIT_TEST(test_gzip_compatible);
+	CPPUNIT_TEST(test_read_session);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp() override;
+	void tearDown() override;
+
+	void test_parse_line();
+	void test_gzip_compatible();
+	void test_read_session();
+
+private:
+	fz::native_string name_;
+	std::string content_;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(log_archiver_test);
+
+namespace {
+
+constexpr std::uint64_t sessions_count = 7;
+constexpr std::size_t lines_count = 20000;
+
+// Line i is logged at 2024-01-01T00:00:00.000Z plus i seconds, by session i % sessions_count, if any.
+std::string make_line(std::size_t i)
+{
+	auto s = i % sessions_count;
+	auto t = std::int64_t(i);
+
+	char time[32];
+	std::snprintf(time, sizeof(time), "2024-01-01T%02d:%02d:%02d.000Z", int(t / 3600), int(t / 60 % 60), int(t % 60));
+
+	if (s == 0)
+		return std::string(time) + " == Server is listening, line " + std::to_string(i);
+
+	return std::string(time) + " >> [FTP Session " + std::to_string(s) + " 10.0.0." + std::to_string(s) + " user] RETR file_" + std::to_string(i);
+}
+
+}
+
+void log_archiver_test::setUp()
+{
+	name_ = (std::filesystem::temp_directory_path() / "fz_test_log_archiver.log").native();
+
+	content_.clear();
+	for (std::size_t i = 0; i < lines_count; ++i)
+		content_.append(make_line(i)).append("\n");
+
+	CPPUNIT_ASSERT(fz::util::io::write(name_, content_));
+}
+
+void log_archiver_test::tearDown()
+{
+	fz::remove_file(name_, false);
+	fz::remove_file(archiver::compressed_name(name_), false);
+	fz::remove_file(archiver::index_name(name_), false);
+}
+
+void log_archiver_test::test_parse_line()
+{
+	std::int64_t ms;
+	std::uint64_t session_id;
+
+	archiver::parse_line("2024-01-01T00:00:01.250Z >> [FTP Session 42 10.0.0.1 user] LIST", ms, session_id);
+	CPPUNIT_ASSERT_EQUAL(std::int64_t(1704067201250), ms);
+	CPPUNIT_ASSERT_EQUAL(std::uint64_t(42), session_id);
+
+	archiver::parse_line("2024-01-01T00:00:01.250Z Debug Info: [FTP Session 43 10.0.0.1] Something", ms, session_id);
+	CPPUNIT_ASSERT_EQUAL(std::uint64_t(43), session_id);
+
+	archiver::parse_line("2024-01-01T00:00:01.250Z == Message about [Session 44]", ms, session_id);
+	CPPUNIT_ASSERT_EQUAL(std::uint64_t(0), session_id);
+
+	archiver::parse_line("== [FTP Session 45 10.0.0.1] No header", ms, session_id);
+	CPPUNIT_ASSERT_EQUAL(std::int64_t(0), ms);
+	CPPUNIT_ASSERT_EQUAL(std::uint64_t(45), session_id);
+}
+
+void log_archiver_test::test_gzip_compatible()
+{
+	CPPUNIT_ASSERT(archiver::compress_file(name_, 4096));
+
+	fz::file f(archiver::compressed_name(name_), fz::file::reading, fz::file::existing);
+	fz::buffer compressed;
+	CPPUNIT_ASSERT(fz::util::io::read(f, compressed));
+
+	z_stream zs{};
+	CPPUNIT_ASSERT_EQUAL(Z_OK, inflateInit2(&zs, 16 + MAX_WBITS));
+
+	std::string inflated(content_.size() + 1, '\0');
+
+	zs.next_in = compressed.get();
+	zs.avail_in = uInt(compressed.size());
+	zs.next_out = reinterpret_cast<Bytef *>(inflated.data());
+	zs.avail_out = uInt(inflated.size());
+
+	// Z_STREAM_END means the trailer, with its checksum, was found to be valid.
+	CPPUNIT_ASSERT_EQUAL(Z_STREAM_END, inflate(&zs, Z_FINISH));
+	inflated.resize(zs.total_out);
+	inflateEnd(&zs);
+
+	CPPUNIT_ASSERT(inflated == content_);
+}
+
+void log_archiver_test::test_read_session()
+{
+	CPPUNIT_ASSERT(archiver::compress_file(name_, 4096));
+
+	archiver::index idx;
+	CPPUNIT_ASSERT(archiver::load_index(name_, idx));
+	CPPUNIT_ASSERT(idx.blocks.size() > 100);
+
+	// Lines 3600 to 7199 are logged during the second hour.
+	archiver::filter f;
+	f.session_id = 3;
+	f.from = fz::datetime(fz::datetime::utc, 2024, 1, 1, 1, 0, 0, 0);
+	f.to = fz::datetime(fz::datetime::utc, 2024, 1, 1, 1, 59, 59, 999);
+
+	std::vector<std::string> expected;
+	for (std::size_t i = 3600; i < 7200; ++i) {
+		if (i % sessions_count == f.session_id)
+			expected.push_back(make_line(i));
+	}
+
+	std::vector<std::string> read;
+	CPPUNIT_ASSERT(archiver::read(name_, f, [&](std::string_view line) {
+		read.emplace_back(line);
+		return true;
+	}));
+
+	CPPUNIT_ASSERT(read == expected);
+
+	std::vector<std::string> scanned;
+	CPPUNIT_ASSERT(archiver::scan(name_, f, [&](std::string_view line) {
+		scanned.emplace_back(line);
+		return true;
+	}));
+
+	CPPUNIT_ASSERT(scanned == expected);
+
+	// Stopping early.
+	std::size_t count = 0;
+	CPPUNIT_ASSERT(archiver::read(name_, {}, [&](std::string_view) {
+		return ++count < 10;
+	}));
+
+	CPPUNIT_ASSERT_EQUAL(std::size_t(10), count);
+}
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <thread>
+
+#include "test_utils.hpp"
+
+#include "../src/filezilla/metrics/registry.hpp"
+#include "../src/filezilla/metrics/exposition.hpp"
+
+using fz::metrics::histogram;
+
+class metrics_registry_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(metrics_registry_test);
+	CPPUNIT_TEST(test_bucket_bounds);
+	CPPUNIT_TEST(test_counter_threads);
+	CPPUNIT_TEST(test_collect);
+	CPPUNIT_TEST(test_text);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_bucket_bounds();
+	void test_counter_threads();
+	void test_collect();
+	void test_text();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(metrics_registry_test);
+
+void metrics_registry_test::test_bucket_bounds()
+{
+	std::uint64_t const values[] = {
+		0, 1, 7, 8, 9, 15, 16, 17, 100, 1000, 123456789, std::uint64_t(1) << 40, (std::uint64_t(1) << 63) + 1, ~std::uint64_t(0)
+	};
+
+	for (auto v: values) {
+		auto i = histogram::bucket_index(v);
+		CPPUNIT_ASSERT(i < histogram::buckets_count);
+
+		// Every value falls within its bucket, whose width is at most 1/8th of its lower bound.
+		auto upper = histogram::bucket_upper_bound(i);
+		auto lower = i == 0 ? 0 : histogram::bucket_upper_bound(i - 1);
+
+		CPPUNIT_ASSERT(lower <= v);
+		CPPUNIT_ASSERT(v < upper || (upper == ~std::uint64_t(0) && v == upper));
+		CPPUNIT_ASSERT(upper - lower <= std::max<std::uint64_t>(1, lower / histogram::sub_buckets_count));
+	}
+
+	// Bucket bounds are strictly increasing.
+	for (std::size_t i = 1; i < histogram::buckets_count; ++i)
+		CPPUNIT_ASSERT(histogram::bucket_upper_bound(i - 1) < histogram::bucket_upper_bound(i));
+}
+
+void metrics_registry_test::test_counter_threads()
+{
+	fz::metrics::registry r;
+	auto &c = r.get_counter("c", "");
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 8; ++t) {
+		threads.emplace_back([&] {
+			for (int i = 0; i < 10000; ++i)
+				c.add();
+		});
+	}
+
+	for (auto &t: threads)
+		t.join();
+
+	CPPUNIT_ASSERT_EQUAL(std::uint64_t(80000), c.value());
+}
+
+void metrics_registry_test::test_collect()
+{
+	fz::metrics::registry r;
+
+	r.get_counter("requests_total", "", {{"op", "a"}}).add(3);
+	r.get_counter("requests_total", "", {{"op", "b"}}).add(4);
+	r.get_gauge("sessions", "").set(-2);
+
+	auto &h = r.get_histogram("latency_seconds", "", fz::metrics::unit::microseconds);
+	h.record(5);
+	h.record(5);
+	h.record(fz::duration::from_milliseconds(2));
+
+	// The same name and labels yield the same metric.
+	CPPUNIT_ASSERT(&h == &r.get_histogram("latency_seconds", "", fz::metrics::unit::microseconds));
+
+	auto s = r.collect();
+	CPPUNIT_ASSERT_EQUAL(std::size_t(3), s.size());
+
+	// Families are sorted by name.
+	CPPUNIT_ASSERT_EQUAL(std::string("latency_seconds"), s[0].name);
+	CPPUNIT_ASSERT_EQUAL(std::uint64_t(3), s[0].samples[0].count);
+	CPPUNIT_ASSERT_EQUAL(std::uint64_t(2010), s[0].samples[0].sum);
+	CPPUNIT_ASSERT_EQUAL(std::size_t(2), s[0].samples[0].buckets.size());
+	CPPUNIT_ASSERT_EQUAL(std::uint64_t(2), s[0].samples[0].buckets[0].second);
+
+	CPPUNIT_ASSERT_EQUAL(std::string("requests_total"), s[1].name);
+	CPPUNIT_ASSERT_EQUAL(std::size_t(2), s[1].samples.size());
+	CPPUNIT_ASSERT_EQUAL(std::int64_t(4), s[1].samples[1].value);
+
+	CPPUNIT_ASSERT_EQUAL(std::int64_t(-2), s[2].samples[0].value);
+}
+
+void metrics_registry_test::test_text()
+{
+	fz::metrics::registry r;
+
+	r.get_counter("requests_total", "Requests \\ served.", {{"path", "a\"b"}}).add(3);
+
+	auto &h = r.get_histogram("latency_seconds", "Latency.", fz::metrics::unit::microseconds);
+	h.record(3);
+	h.record(5);
+	h.record(8);
+	h.record(1000000);
+
+	auto text = fz::metrics::to_text(r.collect());
+
+	std::string expected =
+		"# HELP latency_seconds Latency.\n"
+		"# TYPE latency_seconds histogram\n"
+		"latency_seconds_bucket{le=\"3e-06\"} 1\n"
+		"latency_seconds_bucket{le=\"7e-06\"} 2\n"
+		"latency_seconds_bucket{le=\"1.5e-05\"} 3\n"
+		"latency_seconds_bucket{le=\"1.048575\"} 4\n"
+		"latency_seconds_bucket{le=\"+Inf\"} 4\n"
+		"latency_seconds_sum 1.000016\n"
+		"latency_seconds_count 4\n"
+		"# HELP requests_total Requests \\\\ served.\n"
+		"# TYPE requests_total counter\n"
+		"requests_total{path=\"a\\\"b\"} 3\n";
+
+	CPPUNIT_ASSERT_EQUAL(expected, text);
+}
@@ -0,0 +1,91 @@
+#include <thread>
+#include <vector>
+
+#include "test_utils.hpp"
+
+#include "../src/filezilla/util/mpsc_ring.hpp"
+
+using fz::util::mpsc_ring;
+
+class mpsc_ring_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(mpsc_ring_test);
+	CPPUNIT_TEST(test_bounded);
+	CPPUNIT_TEST(test_concurrent_producers);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_bounded();
+	void test_concurrent_producers();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(mpsc_ring_test);
+
+void mpsc_ring_test::test_bounded()
+{
+	mpsc_ring<std::string> ring(3);
+
+	CPPUNIT_ASSERT_EQUAL(std::size_t(4), ring.capacity());
+	CPPUNIT_ASSERT(ring.empty());
+
+	for (int i = 0; i < 4; ++i)
+		CPPUNIT_ASSERT(ring.try_push(std::to_string(i)));
+
+	// A failed push must leave the value alone.
+	std::string rejected = "rejected";
+	CPPUNIT_ASSERT(!ring.try_push(std::move(rejected)));
+	CPPUNIT_ASSERT_EQUAL(std::string("rejected"), rejected);
+
+	std::string v;
+	CPPUNIT_ASSERT(ring.try_pop(v));
+	CPPUNIT_ASSERT_EQUAL(std::string("0"), v);
+	CPPUNIT_ASSERT(ring.try_push(std::string("4")));
+
+	for (int i = 1; i <= 4; ++i) {
+		CPPUNIT_ASSERT(ring.try_pop(v));
+		CPPUNIT_ASSERT_EQUAL(std::to_string(i), v);
+	}
+
+	CPPUNIT_ASSERT(!ring.try_pop(v));
+	CPPUNIT_ASSERT(ring.empty());
+}
+
+void mpsc_ring_test::test_concurrent_producers()
+{
+	static constexpr std::size_t producers_count = 4;
+	static constexpr std::size_t per_producer = 100000;
+
+	mpsc_ring<std::pair<std::size_t, std::size_t>> ring(64);
+	std::vector<std::thread> producers;
+
+	for (std::size_t p = 0; p < producers_count; ++p) {
+		producers.emplace_back([&ring, p] {
+			for (std::size_t i = 0; i < per_producer; ++i) {
+				while (!ring.try_push({p, i}))
+					std::this_thread::yield();
+			}
+		});
+	}
+
+	// Each producer's values must come out in the order they were pushed, and none must be lost.
+	std::vector<std::size_t> next(producers_count);
+	std::size_t popped = 0;
+
+	while (popped < producers_count * per_producer) {
+		std::pair<std::size_t, std::size_t> v;
+
+		if (!ring.try_pop(v)) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		CPPUNIT_ASSERT_EQUAL(next[v.first], v.second);
+		++next[v.first];
+		++popped;
+	}
+
+	for (auto &t: producers)
+		t.join();
+
+	CPPUNIT_ASSERT(ring.empty());
+}
@@ -0,0 +1,101 @@
+#include <set>
+#include <vector>
+
+#include "test_utils.hpp"
+
+#include "../src/filezilla/port_randomizer.hpp"
+
+/*
+ * This testsuite asserts the correctness of the passive mode port allocation.
+ */
+
+class port_randomizer_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(port_randomizer_test);
+	CPPUNIT_TEST(test_unique_ports);
+	CPPUNIT_TEST(test_reuse_other_peer);
+	CPPUNIT_TEST(test_connecting_ports_not_reused);
+	CPPUNIT_TEST(test_release);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_unique_ports();
+	void test_reuse_other_peer();
+	void test_connecting_ports_not_reused();
+	void test_release();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(port_randomizer_test);
+
+void port_randomizer_test::test_unique_ports()
+{
+	fz::port_manager manager;
+
+	std::vector<fz::port_lease> leases;
+	std::set<int> ports;
+
+	for (int i = 0; i < 130; ++i) {
+		fz::port_randomizer r(manager, "192.168.1.1", 50000, 50129);
+
+		auto &l = leases.emplace_back(r.get_port());
+		l.set_connected();
+
+		CPPUNIT_ASSERT(l.get_port() >= 50000 && l.get_port() <= 50129);
+		CPPUNIT_ASSERT(ports.insert(l.get_port()).second);
+	}
+}
+
+void port_randomizer_test::test_reuse_other_peer()
+{
+	fz::port_manager manager;
+
+	std::vector<fz::port_lease> leases;
+
+	for (int i = 0; i < 10; ++i) {
+		fz::port_randomizer r(manager, "10.0.0.1", 60000, 60009);
+		leases.emplace_back(r.get_port()).set_connected();
+	}
+
+	// All ports are taken by the first peer, the second one must share them.
+	fz::port_randomizer r(manager, "::1", 60000, 60009);
+	auto l = r.get_port();
+
+	CPPUNIT_ASSERT(l.get_port() >= 60000 && l.get_port() <= 60009);
+}
+
+void port_randomizer_test::test_connecting_ports_not_reused()
+{
+	fz::port_manager manager;
+
+	std::vector<fz::port_lease> leases;
+
+	for (int i = 0; i < 10; ++i) {
+		fz::port_randomizer r(manager, "10.0.0.1", 60000, 60009);
+		leases.emplace_back(r.get_port());
+	}
+
+	fz::port_randomizer r1(manager, "10.0.0.1", 60000, 60009);
+	CPPUNIT_ASSERT_EQUAL(0, r1.get_port().get_port());
+
+	fz::port_randomizer r2(manager, "10.0.0.2", 60000, 60009);
+	CPPUNIT_ASSERT_EQUAL(0, r2.get_port().get_port());
+}
+
+void port_randomizer_test::test_release()
+{
+	fz::port_manager manager;
+
+	int port{};
+
+	{
+		fz::port_randomizer r(manager, "10.0.0.1", 60000, 60000);
+		auto l = r.get_port();
+		port = l.get_port();
+	}
+
+	CPPUNIT_ASSERT_EQUAL(60000, port);
+
+	// The port was released while still connecting, so it can be handed out again, at the very least as a last resort.
+	fz::port_randomizer r(manager, "10.0.0.1", 60000, 60000);
+	CPPUNIT_ASSERT_EQUAL(60000, r.get_port().get_port());
+}
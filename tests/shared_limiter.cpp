@@ -0,0 +1,98 @@
+#include <libfilezilla/event_loop.hpp>
+
+#include "test_utils.hpp"
+
+#include "../src/filezilla/rate_limit/shared_limiter.hpp"
+
+/*
+ * This testsuite asserts that a limit shared among several event loops ends up where it's actually needed.
+ * Transfers are simulated: each busy loop reports it has transferred as much as its current limit allowed.
+ * The reconciliations are driven by the tests themselves, with a synthetic elapsed time, rather than by the manager's timer.
+ */
+
+namespace {
+
+using fz::rate_limit::sharded_manager;
+using fz::rate_limit::shared_limiter;
+
+constexpr fz::rate::type limit = 1000 * 1000;
+
+struct simulation
+{
+	simulation()
+		: manager(loop, sharded_manager::options().reconcile_interval(fz::duration::from_days(1)))
+		, limiter(manager)
+		, busy(&limiter.get(busy_loop))
+		, idle(&limiter.get(idle_loop))
+	{
+		limiter.set_limits(fz::rate::unlimited, limit);
+	}
+
+	void run(int rounds, bool idle_is_busy)
+	{
+		constexpr std::int64_t elapsed_ms = 100;
+
+		for (int i = 0; i < rounds; ++i) {
+			busy->add_transferred(fz::direction::outbound, std::int64_t(outbound(*busy) * elapsed_ms / 1000));
+			if (idle_is_busy)
+				idle->add_transferred(fz::direction::outbound, std::int64_t(outbound(*idle) * elapsed_ms / 1000));
+
+			limiter.reconcile(elapsed_ms);
+		}
+	}
+
+	static fz::rate::type outbound(shared_limiter::shard &s)
+	{
+		return s.limiter().limit(fz::direction::outbound);
+	}
+
+	fz::event_loop loop;
+	fz::event_loop busy_loop;
+	fz::event_loop idle_loop;
+	sharded_manager manager;
+	shared_limiter limiter;
+	shared_limiter::shard *busy;
+	shared_limiter::shard *idle;
+};
+
+}
+
+class shared_limiter_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(shared_limiter_test);
+	CPPUNIT_TEST(test_split_evenly);
+	CPPUNIT_TEST(test_unused_limit_moves_to_busy_loops);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_split_evenly();
+	void test_unused_limit_moves_to_busy_loops();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(shared_limiter_test);
+
+void shared_limiter_test::test_split_evenly()
+{
+	simulation s;
+
+	CPPUNIT_ASSERT_EQUAL(limit / 2, s.outbound(*s.busy));
+	CPPUNIT_ASSERT_EQUAL(limit / 2, s.outbound(*s.idle));
+	CPPUNIT_ASSERT_EQUAL(fz::rate::unlimited, s.busy->limiter().limit(fz::direction::inbound));
+}
+
+void shared_limiter_test::test_unused_limit_moves_to_busy_loops()
+{
+	simulation s;
+
+	s.run(10, false);
+
+	// The idle loop keeps its floor, an eighth of an even part.
+	CPPUNIT_ASSERT_EQUAL(limit - limit / 16, s.outbound(*s.busy));
+	CPPUNIT_ASSERT_EQUAL(limit / 16, s.outbound(*s.idle));
+
+	// Once the idle loop starts transferring, it gets its part back.
+	s.run(10, true);
+
+	CPPUNIT_ASSERT_EQUAL(limit / 2, s.outbound(*s.busy));
+	CPPUNIT_ASSERT_EQUAL(limit / 2, s.outbound(*s.idle));
+}
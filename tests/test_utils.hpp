@@ -1,7 +1,17 @@
 #ifndef FZ_TEST_UTILS_HEADER
 #define FZ_TEST_UTILS_HEADER
 
+#include <libfilezilla/encode.hpp>
+#include <libfilezilla/local_filesys.hpp>
+#include <libfilezilla/recursive_remove.hpp>
 #include <libfilezilla/string.hpp>
+#include <libfilezilla/util.hpp>
+
+#ifdef FZ_WINDOWS
+#	include <fileapi.h>
+#else
+#	include <unistd.h>
+#endif
 
 #include <cppunit/TestAssert.h>
 #include <cppunit/extensions/HelperMacros.h>
@@ -68,6 +78,62 @@ namespace CppUnit {
 	};
 }
 
+/// \returns the directory the tests are run from, under which they make their own.
+fz::native_string inline get_tests_rootdir()
+{
+	fz::native_string tests_root_dir;
+
+#ifdef FZ_WINDOWS
+	auto size = GetCurrentDirectoryW(0, nullptr);
+	CPPUNIT_ASSERT_MESSAGE("GetCurrentDirectoryW failed", size != 0);
+
+	tests_root_dir.resize(std::size_t(size-1));
+	size = GetCurrentDirectoryW(size, tests_root_dir.data());
+	CPPUNIT_ASSERT_MESSAGE("GetCurrentDirectoryW failed", size != 0);
+#else
+	const char *cwd = nullptr;
+
+	tests_root_dir.resize(64);
+	do {
+		tests_root_dir.resize(tests_root_dir.size()*2);
+		cwd = getcwd(tests_root_dir.data(), tests_root_dir.size()+1);
+	} while (!cwd && errno == ERANGE);
+
+	CPPUNIT_ASSERT_MESSAGE("Couldn't get cwd", cwd != nullptr);
+
+	tests_root_dir.resize(std::char_traits<fz::native_string::value_type>::length(tests_root_dir.data()));
+#endif
+
+	CPPUNIT_ASSERT(!tests_root_dir.empty());
+
+	return tests_root_dir;
+}
+
+/// Makes a new directory under get_tests_rootdir(), named after \p prefix followed by random characters.
+/// \returns its path. Tests remove it, and all that's in it, with remove_tests_dir().
+fz::native_string inline make_tests_dir(const fz::native_string &prefix)
+{
+	int max_num_attempts = 5;
+	int i = 0;
+	fz::native_string dir;
+
+	do {
+		dir = get_tests_rootdir() + fz::local_filesys::path_separator + prefix + fz::to_native(fz::base32_encode(fz::random_bytes(10), fz::base32_type::locale_safe, false));
+
+		if (fz::mkdir(dir, true))
+			break;
+	} while (++i != max_num_attempts);
+
+	CPPUNIT_ASSERT_MESSAGE("Couldn't create the tests directory: maximum number of attempts reached", i != max_num_attempts);
+
+	return dir;
+}
+
+void inline remove_tests_dir(const fz::native_string &dir)
+{
+	fz::recursive_remove r;
+	r.remove(dir);
+}
 
 #define ASSERT_EQUAL_DATA(expected, actual, data) assert_equal_data((expected), (actual), #actual, data, CPPUNIT_SOURCELINE())
 #define ASSERT_EQUAL(expected, actual) assert_equal_data((expected), (actual), #actual, std::string(), CPPUNIT_SOURCELINE())
@@ -1,14 +1,3 @@
-#include <libfilezilla/util.hpp>
-#include <libfilezilla/encode.hpp>
-#include <libfilezilla/local_filesys.hpp>
-#include <libfilezilla/recursive_remove.hpp>
-
-#ifdef FZ_WINDOWS
-#	include <fileapi.h>
-#else
-#	include <unistd.h>
-#endif
-
 #include "../src/filezilla/logger/null.hpp"
 #include "../src/filezilla/tvfs/engine.hpp"
 
@@ -50,7 +39,6 @@ public:
 	void test_limits();
 
 private:
-	fz::native_string get_tests_rootdir();
 	void set_mount_table(fz::tvfs::mount_table &&table);
 
 	fz::tvfs::engine tvfs_;
@@ -76,25 +64,11 @@ tvfs_test::~tvfs_test()
 {}
 
 void tvfs_test::setUp() {
-
-	int max_num_attempts = 5;
-	int i = 0;
-	do {
-		auto root_name = fzT("tvfs_test") + fz::to_native(fz::base32_encode(fz::random_bytes(10), fz::base32_type::locale_safe, false));
-
-		native_root_ = get_tests_rootdir();
-		native_root_ /= root_name;
-
-		if (fz::mkdir(native_root_, true))
-			break;
-	} while (++i != max_num_attempts);
-
-	CPPUNIT_ASSERT_MESSAGE("Couldn't create tvfs native root directory: maximum number of attempts reached", i != max_num_attempts);
+	native_root_ = make_tests_dir(fzT("tvfs_test"));
 }
 
 void tvfs_test::tearDown() {
-	fz::recursive_remove r;
-	r.remove(native_root_);
+	remove_tests_dir(native_root_);
 }
 
 void tvfs_test::test_read_only_root()
@@ -431,36 +405,6 @@ void tvfs_test::test_limits()
 	tvfs_.set_open_limits({});
 }
 
-fz::native_string tvfs_test::get_tests_rootdir()
-{
-	fz::native_string tests_root_dir;
-
-#ifdef FZ_WINDOWS
-	auto size = GetCurrentDirectoryW(0, nullptr);
-	CPPUNIT_ASSERT_MESSAGE("GetCurrentDirectoryW failed", size != 0);
-
-	tests_root_dir.resize(std::size_t(size-1));
-	size = GetCurrentDirectoryW(size, tests_root_dir.data());
-	CPPUNIT_ASSERT_MESSAGE("GetCurrentDirectoryW failed", size != 0);
-#else
-	const char *cwd = nullptr;
-
-	tests_root_dir.resize(64);
-	do {
-		tests_root_dir.resize(tests_root_dir.size()*2);
-		cwd = getcwd(tests_root_dir.data(), tests_root_dir.size()+1);
-	} while (!cwd && errno == ERANGE);
-
-	CPPUNIT_ASSERT_MESSAGE("Couldn't get cwd", cwd != nullptr);
-
-	tests_root_dir.resize(std::char_traits<fz::native_string::value_type>::length(tests_root_dir.data()));
-#endif
-
-	CPPUNIT_ASSERT(!tests_root_dir.empty());
-
-	return tests_root_dir;
-}
-
 void tvfs_test::set_mount_table(fz::tvfs::mount_table &&table)
 {
 	tvfs_.set_mount_tree(std::make_shared<fz::tvfs::mount_tree>(std::move(table)));
@@ -0,0 +1,84 @@
+#include "test_utils.hpp"
+
+#include "../src/filezilla/authentication/verified_credentials_cache.hpp"
+
+using fz::authentication::verified_credentials_cache;
+
+class verified_credentials_cache_test final : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(verified_credentials_cache_test);
+	CPPUNIT_TEST(test_disabled_by_default);
+	CPPUNIT_TEST(test_only_exact_credentials_match);
+	CPPUNIT_TEST(test_ttl);
+	CPPUNIT_TEST(test_capacity);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_disabled_by_default();
+	void test_only_exact_credentials_match();
+	void test_ttl();
+	void test_capacity();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(verified_credentials_cache_test);
+
+void verified_credentials_cache_test::test_disabled_by_default()
+{
+	verified_credentials_cache c;
+
+	c.insert("user", "password", 0);
+	CPPUNIT_ASSERT(!c.contains("user", "password", 0));
+}
+
+void verified_credentials_cache_test::test_only_exact_credentials_match()
+{
+	verified_credentials_cache c(verified_credentials_cache::options().capacity(10));
+
+	c.insert("user", "password", 1);
+
+	CPPUNIT_ASSERT(c.contains("user", "password", 1));
+	CPPUNIT_ASSERT(!c.contains("user", "Password", 1));
+	CPPUNIT_ASSERT(!c.contains("user", "password", 2));
+	CPPUNIT_ASSERT(!c.contains("other", "password", 1));
+
+	// Moving characters between username and password must not make a match.
+	CPPUNIT_ASSERT(!c.contains("userp", "assword", 1));
+
+	c.clear();
+	CPPUNIT_ASSERT(!c.contains("user", "password", 1));
+}
+
+void verified_credentials_cache_test::test_ttl()
+{
+	auto now = fz::monotonic_clock::now();
+	verified_credentials_cache c(verified_credentials_cache::options().capacity(10).ttl(fz::duration::from_milliseconds(100)), [&now] { return now; });
+
+	c.insert("user", "password", 0);
+	CPPUNIT_ASSERT(c.contains("user", "password", 0));
+
+	now = now + fz::duration::from_milliseconds(99);
+	CPPUNIT_ASSERT(c.contains("user", "password", 0));
+
+	// A new verification restarts the ttl.
+	c.insert("user", "password", 0);
+	now = now + fz::duration::from_milliseconds(99);
+	CPPUNIT_ASSERT(c.contains("user", "password", 0));
+
+	now = now + fz::duration::from_milliseconds(1);
+	CPPUNIT_ASSERT(!c.contains("user", "password", 0));
+}
+
+void verified_credentials_cache_test::test_capacity()
+{
+	verified_credentials_cache c(verified_credentials_cache::options().capacity(2));
+
+	c.insert("a", "password", 0);
+	c.insert("b", "password", 0);
+	c.insert("a", "password", 0);
+	c.insert("c", "password", 0);
+
+	// The least recently verified entry is the one that makes room.
+	CPPUNIT_ASSERT(c.contains("a", "password", 0));
+	CPPUNIT_ASSERT(!c.contains("b", "password", 0));
+	CPPUNIT_ASSERT(c.contains("c", "password", 0));
+}